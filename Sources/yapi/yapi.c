@@ -466,7 +466,7 @@ static void logResult(void *context, const u8 *result, u32 resultlen, int retcod
 }
 
 static int yapiRequestOpenWS(YIOHDL_internal *iohdl, HubSt *hub, YAPI_DEVICE dev, int tcpchan, const char *request, int reqlen, u64 mstimeout, yapiRequestAsyncCallback callback, void *context, RequestProgress progress_cb, void *progress_ctx, char *errmsg);
-static int yapiRequestOpenHTTP(YIOHDL_internal *iohdl, HubSt *hub, YAPI_DEVICE dev, const char *request, int reqlen, int wait_for_start, u64 mstimeout, yapiRequestAsyncCallback callback, void *context, char *errmsg);
+static int yapiRequestOpenHTTP(YIOHDL_internal *iohdl, HubSt *hub, YAPI_DEVICE dev, int tcpchan, const char *request, int reqlen, int wait_for_start, u64 mstimeout, yapiRequestAsyncCallback callback, void *context, char *errmsg);
 static int yapiRequestOpenUSB(YIOHDL_internal *iohdl, HubSt *hub, YAPI_DEVICE dev, const char *request, int reqlen, u64 unused_timeout, yapiRequestAsyncCallback callback, void *context, char *errmsg);
 
 
@@ -542,7 +542,7 @@ YRETCODE yapiPullDeviceLogEx(int devydx)
             if (proto == PROTO_WEBSOCKET) {
                 res = yapiRequestOpenWS(&iohdl, hub, dev, 0, request, reqlen, YIO_10_MINUTES_TCP_TIMEOUT, logResult, (void*)gen, NULL, NULL, errmsg);
             } else {
-               res = yapiRequestOpenHTTP(&iohdl, hub, dev, request, reqlen, 0, YIO_10_MINUTES_TCP_TIMEOUT, logResult, (void*)gen, errmsg);
+               res = yapiRequestOpenHTTP(&iohdl, hub, dev, 0, request, reqlen, 0, YIO_10_MINUTES_TCP_TIMEOUT, logResult, (void*)gen, errmsg);
             }
         }
     }
@@ -620,7 +620,14 @@ void wpSafeRegister(HubSt *hub, u8 devYdx, yStrRef serialref,yStrRef lnameref, y
     if( registeredUrl != INVALID_HASH_IDX && wpSafeCheckOverwrite(registeredUrl,hub,devUrl)){
         wpSafeUnregister(serialref);
     }
-    wpRegister(-1, serialref, lnameref, productref, deviceid,devUrl,beacon);
+    if (serialref == INVALID_HASH_IDX || devUrl == INVALID_HASH_IDX) {
+        dbglog("String table full, a new device is ignored\n");
+        return;
+    }
+    if (wpRegister(-1, serialref, lnameref, productref, deviceid,devUrl,beacon) < 0) {
+        dbglog("Too many devices, %s is ignored\n", yHashGetStrPtr(serialref));
+        return;
+    }
     ypRegister(YSTRREF_MODULE_STRING, serialref, YSTRREF_mODULE_STRING, lnameref, YOCTO_AKA_YFUNCTION, -1, NULL);
     if(hub && devYdx < MAX_YDX_PER_HUB) {
         // Update hub-specific devYdx mapping between enus->devYdx and our wp devYdx
@@ -682,7 +689,7 @@ void wpSafeUpdate(HubSt *hub,u8 devYdx, yStrRef serialref,yStrRef lnameref, yUrl
 #endif
         return;
     }
-    if (wpRegister(-1, serialref, lnameref, INVALID_HASH_IDX, 0, devUrl, beacon)) {
+    if (wpRegister(-1, serialref, lnameref, INVALID_HASH_IDX, 0, devUrl, beacon) > 0) {
         ypRegister(YSTRREF_MODULE_STRING, serialref, YSTRREF_mODULE_STRING, lnameref, YOCTO_AKA_YFUNCTION, -1, NULL);
         if(hub && devYdx < MAX_YDX_PER_HUB) {
             // Update hub-specific devYdx mapping between enus->devYdx and our wp devYdx
@@ -747,12 +754,21 @@ static void unregisterNetDevice(yStrRef serialref)
         yReqFree(yContext->tcpreq[devydx]);
         yContext->tcpreq[devydx] = NULL;
     }
+    if(devydx >= 0) {
+        int tcpchan;
+        for (tcpchan = 1; tcpchan < MAX_ASYNC_TCPCHAN; tcpchan++) {
+            if (yContext->tcpreqChan[devydx][tcpchan-1]) {
+                yReqFree(yContext->tcpreqChan[devydx][tcpchan-1]);
+                yContext->tcpreqChan[devydx][tcpchan-1] = NULL;
+            }
+        }
+    }
     wpSafeUnregister(serialref);
 }
 
 static void ypUpdateNet(ENU_CONTEXT *enus)
 {
-    if(ypRegister(enus->ypCateg, enus->serial, enus->funcId, enus->logicalName, enus->funClass, enus->funYdx, enus->advertisedValue)){
+    if(ypRegister(enus->ypCateg, enus->serial, enus->funcId, enus->logicalName, enus->funClass, enus->funYdx, enus->advertisedValue) > 0){
         // Forward high-level notification to API user
         yFunctionUpdate(((s32)enus->funcId << 16) | enus->serial,enus->advertisedValue);
     }
@@ -1088,7 +1104,7 @@ static int yNetHubEnum(HubSt *hub,int forceupdate,char *errmsg)
 {
     ENU_CONTEXT     enus;
     int             i, res;
-    yStrRef         knownDevices[128];
+    yStrRef         knownDevices[ALLOC_YDX_PER_HUB];
 
     //check if the expiration has expired;
     if(!forceupdate && hub->devListExpires > yapiGetTickCount()) {
@@ -1099,8 +1115,8 @@ static int yNetHubEnum(HubSt *hub,int forceupdate,char *errmsg)
     memset(&enus,0,sizeof(enus));
     enus.hub = hub;
     enus.knownDevices = knownDevices;
-    enus.nbKnownDevices = wpGetAllDevUsingHubUrl(hub->url, enus.knownDevices,  128);
-    if(enus.nbKnownDevices >128){
+    enus.nbKnownDevices = wpGetAllDevUsingHubUrl(hub->url, enus.knownDevices, ALLOC_YDX_PER_HUB);
+    if(enus.nbKnownDevices > ALLOC_YDX_PER_HUB){
         return YERRMSG(YAPI_IO_ERROR,"too many device on this Net hub");
     }
 
@@ -1164,7 +1180,7 @@ static HubSt* yapiAllocHub(const char  *url,char *errmsg)
 
     hub = yMalloc(sizeof(HubSt));
     memset(hub,0,sizeof(HubSt));
-    memset(hub->devYdxMap, 255, sizeof(hub->devYdxMap));
+    memset(hub->devYdxMap, 0xff, sizeof(hub->devYdxMap));
     yInitWakeUpSocket(&hub->wuce);
     // compute an hashed url
     hub->url = huburl;
@@ -1173,7 +1189,8 @@ static HubSt* yapiAllocHub(const char  *url,char *errmsg)
     memcpy(name,url,len+1);
     hub->name = name;
     yHashGetUrlPort(huburl, NULL, NULL, &hub->proto, &user, &password);
-    yFifoInit(&(hub->not_fifo), hub->not_buffer, sizeof(hub->not_buffer));
+    hub->not_buffer = (u8*) yMalloc(NET_HUB_NOT_FIFO_SIZE);
+    yFifoInit32(&(hub->not_fifo), hub->not_buffer, NET_HUB_NOT_FIFO_SIZE, YFIFO32_SPSC);
     yInitializeCriticalSection(&hub->access);
 
     if (hub->proto != PROTO_WEBSOCKET) {
@@ -1210,10 +1227,12 @@ static void yapiFreeHub(HubSt *hub)
         }
     }
     yDeleteCriticalSection(&hub->access);
-    yFifoCleanup(&hub->not_fifo);
+    yFifoCleanup32(&hub->not_fifo);
+    if (hub->not_buffer) yFree(hub->not_buffer);
     if (hub->name)   yFree(hub->name);
+    if (hub->loop)   yFree(hub->loop);
     memset(hub, 0, sizeof(HubSt));
-    memset(hub->devYdxMap, 255, sizeof(hub->devYdxMap));
+    memset(hub->devYdxMap, 0xff, sizeof(hub->devYdxMap));
     hub->url = INVALID_HASH_IDX;
     yFree(hub);
 }
@@ -1225,7 +1244,7 @@ static void unregisterNetHub(yUrlRef  huburl)
     int i;
     u64     timeref;
     int      nbKnownDevices;
-    yStrRef  knownDevices[128];
+    yStrRef  knownDevices[ALLOC_YDX_PER_HUB];
     char     errmsg[YOCTO_ERRMSG_LEN];
 
 
@@ -1236,21 +1255,29 @@ static void unregisterNetHub(yUrlRef  huburl)
             dbglog("HUB: unregister %x->%s  \n",huburl,hub->name);
 #endif
             hub->state = NET_HUB_TOCLOSE;
-            yThreadRequestEnd(&hub->net_thread);
-            yDringWakeUpSocket(&hub->wuce, 0, errmsg);
-            // wait for the helper thread to stop monitoring these devices
-            timeref = yapiGetTickCount();
-            while(yThreadIsRunning(&hub->net_thread) && (yapiGetTickCount() - timeref < YIO_DEFAULT_TCP_TIMEOUT) ) {
-                yApproximateSleep(10);
+            if (hub->loop) {
+                // wait for the network loop to stop monitoring these devices
+                yNetLoopDetachHub(hub, i, YIO_DEFAULT_TCP_TIMEOUT);
+            } else {
+                yThreadRequestEnd(&hub->net_thread);
+                yDringWakeUpSocket(&hub->wuce, 0, errmsg);
+                // wait for the helper thread to stop monitoring these devices
+                timeref = yapiGetTickCount();
+                while(yThreadIsRunning(&hub->net_thread) && (yapiGetTickCount() - timeref < YIO_DEFAULT_TCP_TIMEOUT) ) {
+                    yApproximateSleep(10);
+                }
+                yThreadKill(&hub->net_thread);
             }
-            yThreadKill(&hub->net_thread);
             yapiFreeHub(hub);
             yContext->nethub[i] = NULL;
             break;
         }
     }
 
-    nbKnownDevices = wpGetAllDevUsingHubUrl(huburl,knownDevices,128);
+    nbKnownDevices = wpGetAllDevUsingHubUrl(huburl,knownDevices,ALLOC_YDX_PER_HUB);
+    if (nbKnownDevices > ALLOC_YDX_PER_HUB) {
+        nbKnownDevices = ALLOC_YDX_PER_HUB;
+    }
     for(i = 0 ; i < nbKnownDevices; i++) {
         if (knownDevices[i]!=INVALID_HASH_IDX){
             unregisterNetDevice(knownDevices[i]);
@@ -1473,6 +1500,7 @@ static void yapiFreeAPI_internal(void)
             unregisterNetHub(yContext->nethub[i]->url);
         }
     }
+    yNetLoopStop();
 
     yHashFree();
     yTcpShutdown();
@@ -1524,7 +1552,7 @@ static void yapiStartStopDeviceLogCallback_internal(const char *serial,int start
 {
     yStrRef serialref;
     int devydx;
-    serialref = yHashPutStr(serial);
+    serialref = yHashTestStr(serial);
     devydx = wpGetDevYdx(serialref);
     if (devydx < 0 )
         return;
@@ -1641,7 +1669,7 @@ static void wpUpdateTCP(HubSt *hub, const char *serial, const char *name, u8 bea
     yUrlRef devurl;
     int devydx;
 
-    serialref = yHashPutStr(serial);
+    serialref = yHashTestStr(serial);
     devydx = wpGetDevYdx(serialref);
 
     if (devydx < 0) {
@@ -1661,8 +1689,8 @@ static void wpUpdateTCP(HubSt *hub, const char *serial, const char *name, u8 bea
     }
     lnameref    = yHashPutStr(name);
     status = wpRegister(-1, serialref, lnameref, INVALID_HASH_IDX, 0, devurl, beacon);
-    if (status == 0) {
-        return; // no change
+    if (status <= 0) {
+        return; // no change, or device dropped
     }
     ypRegister(YSTRREF_MODULE_STRING, serialref, YSTRREF_mODULE_STRING, lnameref, YOCTO_AKA_YFUNCTION, -1, NULL);
     // Forward high-level notification to API user
@@ -1673,10 +1701,32 @@ static void wpUpdateTCP(HubSt *hub, const char *serial, const char *name, u8 bea
     }
 }
 
+// Make room for len more bytes in the notification fifo, growing it if needed.
+// Must be called by the thread that handles the notifications of this hub.
+int yNetHubReserveNotification(HubSt *hub, u32 len)
+{
+    u32 size = hub->not_fifo.buffsize;
+    u8  *newbuf;
+
+    if (yFifoGetFree32(&hub->not_fifo) >= len) {
+        return 1;
+    }
+    while (size - yFifoGetUsed32(&hub->not_fifo) < len) {
+        size *= 2;
+    }
+    if (size > NET_HUB_NOT_FIFO_MAXSIZE) {
+        return 0;
+    }
+    newbuf = (u8*) yMalloc(size);
+    yFree(yFifoResize32(&hub->not_fifo, newbuf, size));
+    hub->not_buffer = newbuf;
+    return 1;
+}
+
 int handleNetNotification(HubSt *hub)
 {
-    u16             pos;
-    u16             end,size;
+    u32             pos;
+    u32             end,size;
     char            buffer[128];
     char            *p;
     u8              pkttype = 0,devydx,funydx,funclass;
@@ -1693,12 +1743,12 @@ int handleNetNotification(HubSt *hub)
 #endif
 
     // search for start of notification
-    size = yFifoGetUsed(&(hub->not_fifo));
+    size = yFifoGetUsed32(&(hub->not_fifo));
     while(size >= NOTIFY_NETPKT_START_LEN) {
-        yPeekFifo(&(hub->not_fifo), &pkttype, 1, 0);
+        yPeekFifo32(&(hub->not_fifo), &pkttype, 1, 0);
         if(pkttype != NOTIFY_NETPKT_STOP) break;
         // drop newline and loop
-        yPopFifo(&(hub->not_fifo),NULL,1);
+        yPopFifo32(&(hub->not_fifo),NULL,1);
         // note: keep-alive packets don't count in the notification channel position
         size--;
     }
@@ -1706,19 +1756,19 @@ int handleNetNotification(HubSt *hub)
         return 0;
     }
     // make sure we have a full notification
-    end = ySeekFifo(&(hub->not_fifo), (u8*) &netstop, 1, 0, 0, 0);
-    if(end == 0xffff){
-        if (yFifoGetFree(&(hub->not_fifo)) == 0) {
+    end = ySeekFifo32(&(hub->not_fifo), (u8*) &netstop, 1, 0, 0, 0);
+    if(end == YFIFO32_NOT_FOUND){
+        if (yFifoGetFree32(&(hub->not_fifo)) == 0) {
             dbglog("Too many invalid notifications, clearing buffer\n");
-            yFifoEmpty((&(hub->not_fifo)));
+            yFifoEmpty32((&(hub->not_fifo)));
             return 1;
         }
         return 0;
     }
     // make sure we have a full notification
-    if (0xffff != ySeekFifo(&(hub->not_fifo), (u8*) &escapechar, 1, 0, end, 0)) {
+    if (YFIFO32_NOT_FOUND != ySeekFifo32(&(hub->not_fifo), (u8*) &escapechar, 1, 0, end, 0)) {
         // drop notification that contain esc char
-        yPopFifo(&(hub->not_fifo), NULL, end + 1);
+        yPopFifo32(&(hub->not_fifo), NULL, end + 1);
         return 1;
     }
     // handle short funcvalydx notifications
@@ -1729,7 +1779,7 @@ int handleNetNotification(HubSt *hub)
             hub->notifAbsPos += end + 1;
             return 1;
         }
-        yPopFifo(&(hub->not_fifo),(u8*) buffer,end+1);
+        yPopFifo32(&(hub->not_fifo),(u8*) buffer,end+1);
         hub->notifAbsPos += end+1;
         p = buffer+1;
         devydx = (*p++) - 'A';
@@ -1752,7 +1802,7 @@ int handleNetNotification(HubSt *hub)
 #endif
                 // Map hub-specific devydx to our devydx
                 devydx = hub->devYdxMap[devydx];
-                if(devydx < MAX_YDX_PER_HUB) {
+                if(devydx < NB_MAX_DEVICES) {
                     Notification_funydx funInfo;
                     funInfo.raw = funydx;
                     ypUpdateYdx(devydx,funInfo,value);
@@ -1761,7 +1811,7 @@ int handleNetNotification(HubSt *hub)
             case NOTIFY_NETPKT_DEVLOGYDX:
                 // Map hub-specific devydx to our devydx
                 devydx = hub->devYdxMap[devydx];
-                if(devydx < MAX_YDX_PER_HUB) {
+                if(devydx < NB_MAX_DEVICES) {
                     yEnterCriticalSection(&yContext->generic_cs);
                     if (yContext->generic_infos[devydx].flags & DEVGEN_LOG_ACTIVATED) {
                         yContext->generic_infos[devydx].flags |= DEVGEN_LOG_PENDING;
@@ -1777,7 +1827,7 @@ int handleNetNotification(HubSt *hub)
             case NOTIFY_NETPKT_TIMEV2YDX:
                 // Map hub-specific devydx to our devydx
                 devydx = hub->devYdxMap[devydx];
-                if(devydx >= MAX_YDX_PER_HUB) break;
+                if(devydx >= NB_MAX_DEVICES) break;
 
                 report[pos++] = (pkttype == NOTIFY_NETPKT_TIMEVALYDX ? 0 :
                                  (pkttype == NOTIFY_NETPKT_TIMEAVGYDX ? 1 : 2));
@@ -1817,7 +1867,7 @@ int handleNetNotification(HubSt *hub)
                 value[pos] = 0;
                 // Map hub-specific devydx to our devydx
                 devydx = hub->devYdxMap[devydx];
-                if(devydx < MAX_YDX_PER_HUB) {
+                if(devydx < NB_MAX_DEVICES) {
                     Notification_funydx funInfo;
                     unsigned char value8bit[YOCTO_PUBVAL_LEN];
                     memset(value8bit, 0, YOCTO_PUBVAL_LEN);
@@ -1847,20 +1897,20 @@ int handleNetNotification(HubSt *hub)
     }
 
     // make sure packet is a valid notification
-    pos = ySeekFifo(&(hub->not_fifo), (u8*) (NOTIFY_NETPKT_START), NOTIFY_NETPKT_START_LEN, 0, end, 0);
+    pos = ySeekFifo32(&(hub->not_fifo), (u8*) (NOTIFY_NETPKT_START), NOTIFY_NETPKT_START_LEN, 0, end, 0);
     if(pos != 0) {
         // does not start with signature, drop everything until stop marker
 #ifdef DEBUG_NET_NOTIFICATION
         memset(throwbuf, 0, sizeof(throwbuf));
         tmp = (end > 50 ? 50 : end);
-        yPopFifo(&(hub->not_fifo),throwbuf,tmp);
-        yPopFifo(&(hub->not_fifo),NULL,end+1-tmp);
+        yPopFifo32(&(hub->not_fifo),throwbuf,tmp);
+        yPopFifo32(&(hub->not_fifo),NULL,end+1-tmp);
         Dbuffer[1023]=0;
         YSPRINTF(Dbuffer,512,"throw %d / %d [%s]\n",
                  end,pos,throwbuf);
         dumpNotif(Dbuffer);
 #else
-        yPopFifo(&(hub->not_fifo),NULL,end+1);
+        yPopFifo32(&(hub->not_fifo),NULL,end+1);
 #endif
         hub->notifAbsPos += end+1;
         return 0;
@@ -1869,8 +1919,8 @@ int handleNetNotification(HubSt *hub)
     // full packet at start of fifo
     size = end - NOTIFY_NETPKT_START_LEN;
     YASSERT(NOTIFY_NETPKT_MAX_LEN > size);
-    yPopFifo(&(hub->not_fifo),NULL,NOTIFY_NETPKT_START_LEN);
-    yPopFifo(&(hub->not_fifo),(u8*) buffer,size+1);
+    yPopFifo32(&(hub->not_fifo),NULL,NOTIFY_NETPKT_START_LEN);
+    yPopFifo32(&(hub->not_fifo),(u8*) buffer,size+1);
     buffer[size]=0;
     pkttype = *buffer;
     p = buffer+1;
@@ -1884,7 +1934,7 @@ int handleNetNotification(HubSt *hub)
         hub->notifAbsPos = atoi(p);
         //look if we have a \n just after the sync notification
         // if yes this mean that the hub will send some ping notification
-        testPing = ySeekFifo(&(hub->not_fifo), (u8*) &netstop, 1, 0, 1, 0);
+        testPing = ySeekFifo32(&(hub->not_fifo), (u8*) &netstop, 1, 0, 1, 0);
         if(testPing == 0){
 #ifdef DEBUG_NET_NOTIFICATION
             YSPRINTF(Dbuffer,1024,"HUB: %X->%s will send ping notification\n",hub->url,hub->name);
@@ -2016,7 +2066,7 @@ int handleNetNotification(HubSt *hub)
             dumpNotif(Dbuffer);
 #endif
             if ( *p == '0') {
-                unregisterNetDevice(yHashPutStr(children));
+                unregisterNetDevice(yHashTestStr(children));
             }
             break;
         case NOTIFY_NETPKT_LOG:
@@ -2024,7 +2074,7 @@ int handleNetNotification(HubSt *hub)
             dbglog("NOTIFY_NETPKT_LOG %s\n", serial);
 #endif
             {
-                yStrRef serialref = yHashPutStr(serial);
+                yStrRef serialref = yHashTestStr(serial);
                 int devydx = wpGetDevYdx(serialref);
                 if (devydx >= 0) {
                     yEnterCriticalSection(&yContext->generic_cs);
@@ -2065,192 +2115,270 @@ static int yTcpTrafficPending(void)
     return 0;
 }
 
-static void* yhelper_thread(void* ctx)
+/*
+ * Tell if yhelper_connect has something to do: device logs to pull, or the
+ * notification socket to reopen after the retry delay
+ */
+int yhelper_mustConnect(HubSt *hub)
 {
-    int         i,towatch;
-    u8          buffer[512];
-    yThread     *thread=(yThread*)ctx;
+    int i, pending = 0;
+
+    if (hub->state == NET_HUB_DISCONNECTED && (u64)(yapiGetTickCount() - hub->lastAttempt) > hub->attemptDelay) {
+        return 1;
+    }
+    yEnterCriticalSection(&yContext->generic_cs);
+    for (i = 0; i < ALLOC_YDX_PER_HUB && !pending; i++) {
+        int devydx = hub->devYdxMap[i];
+        if (devydx != UNMAPPED_DEVYDX) {
+            u32 flags = yContext->generic_infos[devydx].flags;
+            pending = (flags & DEVGEN_LOG_ACTIVATED) && (flags & DEVGEN_LOG_PENDING) && !(flags & DEVGEN_LOG_PULLING);
+        }
+    }
+    yLeaveCriticalSection(&yContext->generic_cs);
+    return pending;
+}
+
+/*
+ * Pull pending device logs, and reopen the notification socket of an HTTP hub
+ * when the retry delay is elapsed. This connects to the hub and can block for
+ * seconds when it is unreachable, so the network loops run it in a connection
+ * helper (see yNetLoopConnect).
+ */
+void yhelper_connect(HubSt *hub, int *first_notification_connection)
+{
+    int         i, res;
     char        errmsg[YOCTO_ERRMSG_LEN];
-    HubSt    *hub = (HubSt*) thread->ctx;
-    RequestSt    *req, *selectlist[1+ALLOC_YDX_PER_HUB];
-    u32         toread;
-    int         res;
-    int         first_notification_connection=1;
 #ifdef DEBUG_NET_NOTIFICATION
     char        Dbuffer[1024];
 #endif
 
-
-
-    yThreadSignalStart(thread);
-    while (!yThreadMustEnd(thread)) {
-        // Handle async connections as well in this thread
-        for (i = 0; i < ALLOC_YDX_PER_HUB; i++) {
-            int devydx = hub->devYdxMap[i];
-            if (devydx != 0xff){
-                yapiPullDeviceLogEx(devydx);
-            }
+    // Handle async connections as well in this thread
+    for (i = 0; i < ALLOC_YDX_PER_HUB; i++) {
+        int devydx = hub->devYdxMap[i];
+        if (devydx != UNMAPPED_DEVYDX){
+            yapiPullDeviceLogEx(devydx);
         }
-        towatch=0;
-        if (hub->state == NET_HUB_ESTABLISHED || hub->state == NET_HUB_TRYING) {
-            selectlist[towatch] = hub->http.notReq;
-            towatch++;
-        } else if(hub->state == NET_HUB_TOCLOSE) {
-            yReqClose(hub->http.notReq);
-            hub->state = NET_HUB_CLOSED;
-        } else if (hub->state == NET_HUB_DISCONNECTED) {
-            u64 now;
-            if(hub->http.notReq == NULL) {
-                hub->http.notReq = (RequestSt*) yMalloc(sizeof(RequestSt));
-                hub->http.notReq = yReqAlloc(hub);
-            }
-            now = yapiGetTickCount();
-            if ( (u64)( now - hub->lastAttempt ) > hub->attemptDelay) {
-                char request[256];
+    }
+    if (hub->state == NET_HUB_DISCONNECTED) {
+        u64 now;
+        if(hub->http.notReq == NULL) {
+            hub->http.notReq = yReqAlloc(hub);
+        }
+        now = yapiGetTickCount();
+        if ( (u64)( now - hub->lastAttempt ) > hub->attemptDelay) {
+            char request[256];
 #ifdef TRACE_NET_HUB
-                dbglog("TRACE(%X->%s): try to open notification socket at %d\n",hub->url,hub->name, hub->notifAbsPos);
+            dbglog("TRACE(%X->%s): try to open notification socket at %d\n",hub->url,hub->name, hub->notifAbsPos);
 #endif
-                // reset fifo
-                yFifoEmpty(&(hub->not_fifo));
-                if (first_notification_connection) {
-                    YSPRINTF(request, 256, "GET /not.byn HTTP/1.1\r\n\r\n");
-                } else {
-                    YSPRINTF(request, 256, "GET /not.byn?abs=%u HTTP/1.1\r\n\r\n", hub->notifAbsPos);
-                }
-                res = yReqOpen(hub->http.notReq, 2 * YIO_DEFAULT_TCP_TIMEOUT, 0, request, YSTRLEN(request), 0, NULL, NULL, NULL, NULL, errmsg);
-                if (YISERR(res)) {
-                    hub->attemptDelay = 500 << hub->retryCount;
-                    if(hub->attemptDelay > 8000)
-                        hub->attemptDelay = 8000;
-                    hub->lastAttempt = yapiGetTickCount();
-                    hub->retryCount++;
-                    yEnterCriticalSection(&hub->access);
-                    hub->errcode = ySetErr(res, hub->errmsg, errmsg, NULL, 0);
-                    yLeaveCriticalSection(&hub->access);
+            // reset fifo
+            yFifoEmpty32(&(hub->not_fifo));
+            if (*first_notification_connection) {
+                YSPRINTF(request, 256, "GET /not.byn HTTP/1.1\r\n\r\n");
+            } else {
+                YSPRINTF(request, 256, "GET /not.byn?abs=%u HTTP/1.1\r\n\r\n", hub->notifAbsPos);
+            }
+            res = yReqOpen(hub->http.notReq, 2 * YIO_DEFAULT_TCP_TIMEOUT, 0, request, YSTRLEN(request), 0, NULL, NULL, NULL, NULL, errmsg);
+            if (YISERR(res)) {
+                hub->attemptDelay = 500 << hub->retryCount;
+                if(hub->attemptDelay > 8000)
+                    hub->attemptDelay = 8000;
+                hub->lastAttempt = yapiGetTickCount();
+                hub->retryCount++;
+                yEnterCriticalSection(&hub->access);
+                hub->errcode = ySetErr(res, hub->errmsg, errmsg, NULL, 0);
+                yLeaveCriticalSection(&hub->access);
 
 #ifdef TRACE_NET_HUB
-                dbglog("TRACE(%X->%s): unable to open notification socket(%s)\n",hub->url,hub->name,errmsg);
-                dbglog("TRACE(%X->%s): retry in %dms (%d retries)\n",hub->url,hub->name,hub->attemptDelay,hub->retryCount);
+            dbglog("TRACE(%X->%s): unable to open notification socket(%s)\n",hub->url,hub->name,errmsg);
+            dbglog("TRACE(%X->%s): retry in %dms (%d retries)\n",hub->url,hub->name,hub->attemptDelay,hub->retryCount);
 #endif
-                } else {
+            } else {
 #ifdef TRACE_NET_HUB
-                    dbglog("TRACE(%X->%s): notification socket open\n",hub->url,hub->name);
+                dbglog("TRACE(%X->%s): notification socket open\n",hub->url,hub->name);
 #endif
 #ifdef DEBUG_NET_NOTIFICATION
-                    YSPRINTF(Dbuffer,1024,"HUB: %X->%s started\n",hub->url,hub->name);
-                    dumpNotif(Dbuffer);
+                YSPRINTF(Dbuffer,1024,"HUB: %X->%s started\n",hub->url,hub->name);
+                dumpNotif(Dbuffer);
 #endif
-                    hub->state = NET_HUB_TRYING;
-                    hub->retryCount=0;
-                    hub->attemptDelay = 500;
-                    hub->http.lastTraffic = yapiGetTickCount();
-                    hub->send_ping = 0;
-                    selectlist[towatch++] = hub->http.notReq;
-                    first_notification_connection = 0;
-                }
+                hub->state = NET_HUB_TRYING;
+                hub->retryCount=0;
+                hub->attemptDelay = 500;
+                hub->http.lastTraffic = yapiGetTickCount();
+                hub->send_ping = 0;
+                *first_notification_connection = 0;
             }
         }
+    }
+}
+
+// close the notification socket of an HTTP hub being unregistered
+static void yhelper_close(HubSt *hub)
+{
+    if (hub->http.notReq) {
+        yReqClose(hub->http.notReq);
+    }
+    hub->state = NET_HUB_CLOSED;
+}
+
+// open, close or reopen the notification socket of an HTTP hub, and pull pending device logs
+static void yhelper_housekeeping(HubSt *hub, int *first_notification_connection)
+{
+    if (hub->state == NET_HUB_TOCLOSE) {
+        yhelper_close(hub);
+    } else {
+        yhelper_connect(hub, first_notification_connection);
+    }
+}
 
-        // Handle async connections as well in this thread
-        for (i=0; i < ALLOC_YDX_PER_HUB; i++) {
-            req = yContext->tcpreq[i];
-            if(req == NULL || req->hub != hub){
+// list the requests of an HTTP hub that need to be monitored (notification and async requests)
+static int yhelper_selectlist(HubSt *hub, RequestSt **selectlist)
+{
+    int         i, j, tcpchan, towatch = 0;
+    RequestSt   *req;
+
+    // a connection helper may still be setting up the notification request
+    if ((hub->state == NET_HUB_ESTABLISHED || hub->state == NET_HUB_TRYING) && !(hub->loop && hub->loop->connecting)) {
+        selectlist[towatch++] = hub->http.notReq;
+    }
+    // Handle async connections as well in this thread. The request slots are
+    // indexed by WP devYdx for all the hubs: only look at the devices of this
+    // one, an entry left by a device which moved can repeat another one
+    for (i = 0; i < ALLOC_YDX_PER_HUB; i++) {
+        int devydx = hub->devYdxMap[i];
+        if (devydx == UNMAPPED_DEVYDX) {
+            continue;
+        }
+        for (tcpchan = 0; tcpchan < MAX_ASYNC_TCPCHAN; tcpchan++) {
+            req = (tcpchan == 0 ? yContext->tcpreq[devydx] : yContext->tcpreqChan[devydx][tcpchan-1]);
+            if(req == NULL || req->hub != hub || !yReqIsAsync(req)){
                 continue;
             }
-            if(yReqIsAsync(req)) {
+            for (j = 0; j < towatch && selectlist[j] != req; j++);
+            if (j == towatch) {
                 selectlist[towatch++] = req;
             }
         }
+    }
+    return towatch;
+}
 
-        if(YISERR(yReqMultiSelect(selectlist, towatch, 1000, &hub->wuce, errmsg))){
-            dbglog("yTcpMultiSelectReq failed (%s)\n",errmsg);
-            yApproximateSleep(1000);
-        } else {
-            for (i = 0; i < towatch; i++) {
-                req = selectlist[i];
-                if(req == hub->http.notReq) {
-                    toread = yFifoGetFree(&hub->not_fifo);
-                    while(toread > 0) {
-                        if(toread >= sizeof(buffer)) toread = sizeof(buffer)-1;
-                        res = yReqRead(req, buffer, toread);
-                        if(res > 0) {
-                            buffer[res]=0;
+// process the data received on the requests returned by yhelper_selectlist
+static void yhelper_process(HubSt *hub, RequestSt **selectlist, int towatch)
+{
+    int         i, res;
+    u8          buffer[512];
+    char        errmsg[YOCTO_ERRMSG_LEN];
+    RequestSt   *req;
+    u32         toread;
+#ifdef DEBUG_NET_NOTIFICATION
+    char        Dbuffer[1024];
+#endif
+
+    for (i = 0; i < towatch; i++) {
+        req = selectlist[i];
+        if(req == hub->http.notReq) {
+            toread = yFifoGetFree32(&hub->not_fifo);
+            while(toread > 0) {
+                if(toread >= sizeof(buffer)) toread = sizeof(buffer)-1;
+                res = yReqRead(req, buffer, toread);
+                if(res > 0) {
+                    buffer[res]=0;
 #if 0 //def DEBUG_NET_NOTIFICATION
-                            YSPRINTF(Dbuffer,1024,"HUB: %X->%s push %d [\n%s\n]\n",hub->url,hub->name,res,buffer);
-                            dumpNotif(Dbuffer);
+                    YSPRINTF(Dbuffer,1024,"HUB: %X->%s push %d [\n%s\n]\n",hub->url,hub->name,res,buffer);
+                    dumpNotif(Dbuffer);
 #endif
-                            yPushFifo(&(hub->not_fifo), (u8*)buffer, res);
-                            if(hub->state == NET_HUB_TRYING) {
-                                int eoh = ySeekFifo(&(hub->not_fifo), (u8 *)"\r\n\r\n", 4, 0, 0, 0);
-                                if(eoh != 0xffff) {
-                                    if(eoh >= 12) {
-                                        yPopFifo(&(hub->not_fifo), (u8 *)buffer, 12);
-                                        yPopFifo(&(hub->not_fifo), NULL, eoh+4-12);
-                                        if(!memcmp((u8 *)buffer, (u8 *)"HTTP/1.1 200", 12)) {
-                                            hub->state = NET_HUB_ESTABLISHED;
-                                        }
-                                    }
-                                    if(hub->state != NET_HUB_ESTABLISHED) {
-                                        // invalid header received, give up
-                                        char hubname[YOCTO_HOSTNAME_NAME]="";
-                                        hub->state = NET_HUB_TOCLOSE;
-                                        yHashGetUrlPort(hub->url, hubname, NULL, NULL, NULL, NULL);
-                                        dbglog("Network hub %s cannot provide notifications", hubname);
-                                    }
+                    yPushFifo32(&(hub->not_fifo), (u8*)buffer, res);
+                    if(hub->state == NET_HUB_TRYING) {
+                        u32 eoh = ySeekFifo32(&(hub->not_fifo), (u8 *)"\r\n\r\n", 4, 0, 0, 0);
+                        if(eoh != YFIFO32_NOT_FOUND) {
+                            if(eoh >= 12) {
+                                yPopFifo32(&(hub->not_fifo), (u8 *)buffer, 12);
+                                yPopFifo32(&(hub->not_fifo), NULL, eoh+4-12);
+                                if(!memcmp((u8 *)buffer, (u8 *)"HTTP/1.1 200", 12)) {
+                                    hub->state = NET_HUB_ESTABLISHED;
                                 }
                             }
-                            if(hub->state == NET_HUB_ESTABLISHED) {
-                                while(handleNetNotification(hub));
+                            if(hub->state != NET_HUB_ESTABLISHED) {
+                                // invalid header received, give up
+                                char hubname[YOCTO_HOSTNAME_NAME]="";
+                                hub->state = NET_HUB_TOCLOSE;
+                                yHashGetUrlPort(hub->url, hubname, NULL, NULL, NULL, NULL);
+                                dbglog("Network hub %s cannot provide notifications", hubname);
                             }
-                            hub->http.lastTraffic = yapiGetTickCount();
-                        } else {
-                            if (hub->send_ping && ( (u64)(yapiGetTickCount() - hub->http.lastTraffic)) > NET_HUB_NOT_CONNECTION_TIMEOUT){
+                        }
+                    }
+                    if(hub->state == NET_HUB_ESTABLISHED) {
+                        while(handleNetNotification(hub));
+                    }
+                    hub->http.lastTraffic = yapiGetTickCount();
+                } else {
+                    if (hub->send_ping && ( (u64)(yapiGetTickCount() - hub->http.lastTraffic)) > NET_HUB_NOT_CONNECTION_TIMEOUT){
 #ifdef TRACE_NET_HUB
 
-                                dbglog("network hub %s(%x) didn't respond for too long (%d)\n", hub->name, hub->url, res);
+                        dbglog("network hub %s(%x) didn't respond for too long (%d)\n", hub->name, hub->url, res);
 #endif
-                                yReqClose(req);
-                                hub->state = NET_HUB_DISCONNECTED;
-                            }
-                            // nothing more to be read, exit loop
-                            break;
-                        }
-                        toread = yFifoGetFree(&hub->not_fifo);
-                    }
-                    res = yReqIsEof(req, errmsg);
-                    if (res != 0) {
-                        // error or remote close
                         yReqClose(req);
                         hub->state = NET_HUB_DISCONNECTED;
-                        if (res == 1) {
-                            // remote close
-                            YERRMSG(YAPI_IO_ERROR, "Connection closed by remote host");
-                            dbglog("Disconnected from network hub %s (%s)\n", hub->name, errmsg);
-                        } else {
-                            //error
-                            hub->attemptDelay = 500 << hub->retryCount;
-                            if (hub->attemptDelay > 8000)
-                                hub->attemptDelay = 8000;
-                            hub->lastAttempt = yapiGetTickCount();
-                            hub->retryCount++;
-                            yEnterCriticalSection(&hub->access);
-                            hub->errcode = ySetErr(res, hub->errmsg, errmsg, NULL, 0);
-                            yLeaveCriticalSection(&hub->access);
-                        }
-#ifdef DEBUG_NET_NOTIFICATION
-                        YSPRINTF(Dbuffer, 1024, "Network hub %X->%s has closed the connection for notification\n", hub->url, hub->name);
-                        dumpNotif(Dbuffer);
-#endif
-                    }
-                } else if (yReqIsAsync(req)) {
-                    res = yReqIsEof(req, errmsg);
-                    if(res != 0) {
-                        yReqClose(req);
                     }
+                    // nothing more to be read, exit loop
+                    break;
+                }
+                toread = yFifoGetFree32(&hub->not_fifo);
+            }
+            res = yReqIsEof(req, errmsg);
+            if (res != 0) {
+                // error or remote close
+                yReqClose(req);
+                hub->state = NET_HUB_DISCONNECTED;
+                if (res == 1) {
+                    // remote close
+                    YERRMSG(YAPI_IO_ERROR, "Connection closed by remote host");
+                    dbglog("Disconnected from network hub %s (%s)\n", hub->name, errmsg);
+                } else {
+                    //error
+                    hub->attemptDelay = 500 << hub->retryCount;
+                    if (hub->attemptDelay > 8000)
+                        hub->attemptDelay = 8000;
+                    hub->lastAttempt = yapiGetTickCount();
+                    hub->retryCount++;
+                    yEnterCriticalSection(&hub->access);
+                    hub->errcode = ySetErr(res, hub->errmsg, errmsg, NULL, 0);
+                    yLeaveCriticalSection(&hub->access);
                 }
+#ifdef DEBUG_NET_NOTIFICATION
+                YSPRINTF(Dbuffer, 1024, "Network hub %X->%s has closed the connection for notification\n", hub->url, hub->name);
+                dumpNotif(Dbuffer);
+#endif
+            }
+        } else if (yReqIsAsync(req)) {
+            res = yReqIsEof(req, errmsg);
+            if(res != 0) {
+                yReqClose(req);
             }
         }
     }
+}
+
+static void* yhelper_thread(void* ctx)
+{
+    int         towatch;
+    yThread     *thread=(yThread*)ctx;
+    char        errmsg[YOCTO_ERRMSG_LEN];
+    HubSt    *hub = (HubSt*) thread->ctx;
+    RequestSt    *selectlist[1+ALLOC_YDX_PER_HUB*MAX_ASYNC_TCPCHAN];
+    int         first_notification_connection=1;
+
+    yThreadSignalStart(thread);
+    while (!yThreadMustEnd(thread)) {
+        yhelper_housekeeping(hub, &first_notification_connection);
+        towatch = yhelper_selectlist(hub, selectlist);
+        if(YISERR(yReqMultiSelect(selectlist, towatch, 1000, &hub->wuce, errmsg))){
+            dbglog("yTcpMultiSelectReq failed (%s)\n",errmsg);
+            yApproximateSleep(1000);
+        } else {
+            yhelper_process(hub, selectlist, towatch);
+        }
+    }
 
     if (hub->state == NET_HUB_TOCLOSE) {
         yReqClose(hub->http.notReq);
@@ -2261,6 +2389,58 @@ static void* yhelper_thread(void* ctx)
     return NULL;
 }
 
+/*
+ * One non-blocking iteration of yhelper_thread, used when the hub is driven
+ * by a network loop. Store in fds the sockets to monitor until the next call
+ * and return their count.
+ */
+int yhelper_step(HubSt *hub, YSOCKET *fds, char *errmsg)
+{
+    int         i, towatch, nbfds;
+    RequestSt   *selectlist[1+ALLOC_YDX_PER_HUB*MAX_ASYNC_TCPCHAN];
+    u64         now;
+
+    towatch = yhelper_selectlist(hub, selectlist);
+    if (YISERR(yReqMultiPoll(selectlist, towatch, &hub->wuce, errmsg))) {
+        dbglog("yReqMultiPoll failed (%s)\n", errmsg);
+    } else {
+        yhelper_process(hub, selectlist, towatch);
+    }
+    // the blocking part of the housekeeping is left to a connection helper,
+    // the async requests are still processed in the meantime. Done after the
+    // processing, as the thread does, so that the device logs announced by
+    // the notifications just received are pulled right away
+    if (!hub->loop->connecting) {
+        if (hub->state == NET_HUB_TOCLOSE) {
+            yhelper_close(hub);
+        } else if (yhelper_mustConnect(hub)) {
+            yNetLoopConnect(hub);
+        }
+    }
+    nbfds = 0;
+    fds[nbfds++] = hub->wuce.listensock;
+    towatch = yhelper_selectlist(hub, selectlist);
+    now = yapiGetTickCount();
+    if (towatch == 1 && hub->state == NET_HUB_ESTABLISHED && !hub->loop->connecting) {
+        // only the notification socket is monitored: nothing can time out but
+        // the keep-alive of the hub, and the requests opened meanwhile signal
+        // the hub, so the hub does not need the once per second step
+        hub->loop->next_step_tm = now + NET_HUB_NOT_CONNECTION_TIMEOUT;
+        if (hub->send_ping && hub->http.lastTraffic + NET_HUB_NOT_CONNECTION_TIMEOUT + 1 < hub->loop->next_step_tm) {
+            hub->loop->next_step_tm = hub->http.lastTraffic + NET_HUB_NOT_CONNECTION_TIMEOUT + 1;
+        }
+    } else {
+        hub->loop->next_step_tm = now + 1000;
+    }
+    for (i = 0; i < towatch; i++) {
+        YSOCKET skt = yReqGetSocket(selectlist[i]);
+        if (skt != INVALID_SOCKET) {
+            fds[nbfds++] = skt;
+        }
+    }
+    return nbfds;
+}
+
 
 static YRETCODE  yapiLockFunctionCallBack_internal(char *errmsg)
 {
@@ -2299,6 +2479,52 @@ static YRETCODE  yapiUnlockDeviceCallBack_internal(char *errmsg)
 }
 
 
+// Enumeration and event handling run on the thread of the caller of the
+// API, and notify the functions it finds. That thread may be the one which
+// empties the event queue of the C++ layer, so it is recorded while it holds
+// updateDev_cs or handleEv_cs: the events it produces must never wait for
+// room in that queue.
+static void yEnterUpdateDev(void)
+{
+    yEnterCriticalSection(&yContext->updateDev_cs);
+    yContext->updateDevThread = yThreadSelf();
+    yMemoryBarrier();
+    yContext->updateDevDepth++;
+}
+
+static int yTryEnterUpdateDev(void)
+{
+    if (!yTryEnterCriticalSection(&yContext->updateDev_cs)) {
+        return 0;
+    }
+    yContext->updateDevThread = yThreadSelf();
+    yMemoryBarrier();
+    yContext->updateDevDepth++;
+    return 1;
+}
+
+static void yLeaveUpdateDev(void)
+{
+    yContext->updateDevDepth--;
+    yLeaveCriticalSection(&yContext->updateDev_cs);
+}
+
+// Tell if the calling thread is enumerating the devices or handling the
+// events on behalf of the caller of the API
+int yapiIsApiEventThread(void)
+{
+    if (!yContext) {
+        return 0;
+    }
+    if (yContext->updateDevDepth > 0 && yThreadIdEqual(yContext->updateDevThread, yThreadSelf())) {
+        return 1;
+    }
+    if (yContext->handleEvDepth > 0 && yThreadIdEqual(yContext->handleEvThread, yThreadSelf())) {
+        return 1;
+    }
+    return 0;
+}
+
 static YRETCODE yapiRegisterHubEx(const char* url, int checkacces, char* errmsg)
 {
     int i;
@@ -2319,9 +2545,9 @@ static YRETCODE yapiRegisterHubEx(const char* url, int checkacces, char* errmsg)
             YPROPERR(res);
         }
         if  (checkacces) {
-            yEnterCriticalSection(&yContext->updateDev_cs);
+            yEnterUpdateDev();
             res = yUSBUpdateDeviceList(errmsg);
-            yLeaveCriticalSection(&yContext->updateDev_cs);
+            yLeaveUpdateDev();
             return res;
         }
     } else if (YSTRICMP(url,"net") == 0) {
@@ -2371,17 +2597,25 @@ static YRETCODE yapiRegisterHubEx(const char* url, int checkacces, char* errmsg)
                 yLeaveCriticalSection(&yContext->enum_cs);
                 return (YRETCODE)res;
             }
-            if (hubst->proto == PROTO_WEBSOCKET) {
-                thead_handler = ws_thread;
+            if (yContext->nbNetLoops > 0) {
+                // the hub is driven by one of the shared network loops
+                if (YISERR(res = yNetLoopAttachHub(hubst, i, errmsg))) {
+                    yLeaveCriticalSection(&yContext->enum_cs);
+                    return (YRETCODE)res;
+                }
             } else {
-                thead_handler = yhelper_thread;
-            }
-            //yThreadCreate will not create a new thread if there is already one running
-            if (yThreadCreate(&yContext->nethub[i]->net_thread, thead_handler, (void*)yContext->nethub[i]) < 0) {
-                yLeaveCriticalSection(&yContext->enum_cs);
-                return YERRMSG(YAPI_IO_ERROR, "Unable to start helper thread");
+                if (hubst->proto == PROTO_WEBSOCKET) {
+                    thead_handler = ws_thread;
+                } else {
+                    thead_handler = yhelper_thread;
+                }
+                //yThreadCreate will not create a new thread if there is already one running
+                if (yThreadCreate(&yContext->nethub[i]->net_thread, thead_handler, (void*)yContext->nethub[i]) < 0) {
+                    yLeaveCriticalSection(&yContext->enum_cs);
+                    return YERRMSG(YAPI_IO_ERROR, "Unable to start helper thread");
+                }
+                yDringWakeUpSocket(&yContext->nethub[i]->wuce, 1, errmsg);
             }
-            yDringWakeUpSocket(&yContext->nethub[i]->wuce, 1, errmsg);
         }
         yLeaveCriticalSection(&yContext->enum_cs);
         if (i == NBMAX_NET_HUB) {
@@ -2405,9 +2639,9 @@ static YRETCODE yapiRegisterHubEx(const char* url, int checkacces, char* errmsg)
                 unregisterNetHub(hubst->url);
                 return res;
             }
-            yEnterCriticalSection(&yContext->updateDev_cs);
+            yEnterUpdateDev();
             res = yNetHubEnum(hubst, 1, errmsg);
-            yLeaveCriticalSection(&yContext->updateDev_cs);
+            yLeaveUpdateDev();
             if (YISERR(res)) {
                 yapiUnregisterHub_internal(url);
             } else if (hubst->proto != PROTO_WEBSOCKET) {
@@ -2573,6 +2807,37 @@ static YRETCODE  yapiTestHub_internal(const char *url, int mstimeout, char *errm
 }
 
 
+static YRETCODE  yapiSetNetworkReactor_internal(int nbloops, int pincpu, char *errmsg)
+{
+    int i;
+    int res = YAPI_SUCCESS;
+
+    if (!yContext) {
+        YPROPERR(yapiInitAPI_internal(0,errmsg));
+    }
+    if (nbloops < 0) {
+        return YERRMSG(YAPI_INVALID_ARGUMENT, "Invalid number of network loops");
+    }
+    yEnterCriticalSection(&yContext->enum_cs);
+    for (i = 0; i < NBMAX_NET_HUB; i++) {
+        if (yContext->nethub[i]) {
+            yLeaveCriticalSection(&yContext->enum_cs);
+            return YERRMSG(YAPI_INVALID_ARGUMENT, "Network reactor must be configured before registering any hub");
+        }
+    }
+    yNetLoopStop();
+    yContext->nbNetLoops = 0;
+    if (nbloops > 0) {
+        res = yNetLoopStart(nbloops, pincpu, errmsg);
+        if (!YISERR(res)) {
+            yContext->nbNetLoops = nbloops;
+        }
+    }
+    yLeaveCriticalSection(&yContext->enum_cs);
+    return (YRETCODE)res;
+}
+
+
 static YRETCODE  yapiRegisterHub_internal(const char *url, char *errmsg)
 {
     YRETCODE res;
@@ -2628,10 +2893,10 @@ static YRETCODE  yapiUpdateDeviceList_internal(u32 forceupdate, char *errmsg)
         return YERR(YAPI_NOT_INITIALIZED);
 
     if(forceupdate) {
-        yEnterCriticalSection(&yContext->updateDev_cs);
+        yEnterUpdateDev();
     } else {
         // if we do not force an update
-        if(!yTryEnterCriticalSection(&yContext->updateDev_cs)){
+        if(!yTryEnterUpdateDev()){
             return YAPI_SUCCESS;
         }
     }
@@ -2654,7 +2919,7 @@ static YRETCODE  yapiUpdateDeviceList_internal(u32 forceupdate, char *errmsg)
             }
         }
     }
-    yLeaveCriticalSection(&yContext->updateDev_cs);
+    yLeaveUpdateDev();
 
     return err;
 }
@@ -2666,7 +2931,12 @@ static YRETCODE  yapiHandleEvents_internal(char *errmsg)
         return YERR(YAPI_NOT_INITIALIZED);
      // we need only one thread to handle the event at a time
     if(yTryEnterCriticalSection(&yContext->handleEv_cs)){
-        YRETCODE res = (YRETCODE) yUsbIdle();
+        YRETCODE res;
+        yContext->handleEvThread = yThreadSelf();
+        yMemoryBarrier();
+        yContext->handleEvDepth++;
+        res = (YRETCODE) yUsbIdle();
+        yContext->handleEvDepth--;
         yLeaveCriticalSection(&yContext->handleEv_cs);
         return res;
     }
@@ -2703,6 +2973,25 @@ static YRETCODE  yapiSleep_internal(int ms_duration, char *errmsg)
     return err;
 }
 
+// Wait until a USB packet is received or yapiSignalEvents() is called, then
+// perform the same tasks as yapiHandleEvents
+static YRETCODE  yapiWaitForEvents_internal(int ms_duration, char *errmsg)
+{
+    if(!yContext)
+        return YERR(YAPI_NOT_INITIALIZED);
+    if (ms_duration > 0) {
+        yWaitForEvent(&yContext->exitSleepEvent, ms_duration);
+    }
+    return yapiHandleEvents_internal(errmsg);
+}
+
+static void  yapiSignalEvents_internal(void)
+{
+    if(yContext) {
+        ySetEvent(&yContext->exitSleepEvent);
+    }
+}
+
 #ifdef WINDOWS_API
 static int                 tickUseHiRes = -1;
 static u64                 tickOffset = 0;
@@ -3088,21 +3377,28 @@ static int yapiRequestOpenUSB(YIOHDL_internal *iohdl, HubSt *hub, YAPI_DEVICE de
 }
 
 
-static int yapiRequestOpenHTTP(YIOHDL_internal *iohdl, HubSt *hub, YAPI_DEVICE dev, const char *request, int reqlen, int wait_for_start, u64 mstimeout, yapiRequestAsyncCallback callback, void *context, char *errmsg)
+static int yapiRequestOpenHTTP(YIOHDL_internal *iohdl, HubSt *hub, YAPI_DEVICE dev, int tcpchan, const char *request, int reqlen, int wait_for_start, u64 mstimeout, yapiRequestAsyncCallback callback, void *context, char *errmsg)
 {
     YRETCODE    res;
     int         devydx;
-    RequestSt   *tcpreq;
+    RequestSt   *tcpreq, **slot;
 
     devydx = wpGetDevYdx((yStrRef)dev);
     if (devydx < 0) {
         return YERR(YAPI_DEVICE_NOT_FOUND);
     }
     yEnterCriticalSection(&yContext->io_cs);
-    tcpreq = yContext->tcpreq[devydx];
+    if (callback && tcpchan > 0 && tcpchan < MAX_ASYNC_TCPCHAN) {
+        // out-of-band async requests get their own connection per channel,
+        // so that they do not wait for the requests of channel 0
+        slot = &yContext->tcpreqChan[devydx][tcpchan-1];
+    } else {
+        slot = &yContext->tcpreq[devydx];
+    }
+    tcpreq = *slot;
     if (tcpreq == NULL) {
         tcpreq = yReqAlloc(hub);
-        yContext->tcpreq[devydx] = tcpreq;
+        *slot = tcpreq;
     }
     yLeaveCriticalSection(&yContext->io_cs);
     if (callback) {
@@ -3243,7 +3539,7 @@ YRETCODE yapiRequestOpen(YIOHDL_internal *iohdl, int tcpchan, const char *device
         if (proto == PROTO_WEBSOCKET) {
             return yapiRequestOpenWS(iohdl, hub, dev, tcpchan, request, reqlen, mstimeout, callback, context, progress_cb, progress_ctx, errmsg);
         }  else {
-            return yapiRequestOpenHTTP(iohdl, hub, dev, request, reqlen, 2 * YIO_DEFAULT_TCP_TIMEOUT, mstimeout, callback, context, errmsg);
+            return yapiRequestOpenHTTP(iohdl, hub, dev, tcpchan, request, reqlen, 2 * YIO_DEFAULT_TCP_TIMEOUT, mstimeout, callback, context, errmsg);
         }
     }
 }
@@ -3694,9 +3990,12 @@ static int  yapiGetSubdevices_internal(const char *serial, char *buffer, int buf
 
         yHashGetStr(yContext->nethub[i]->serial, hubserial, YOCTO_SERIAL_LEN);
         if (YSTRCMP(serial, hubserial) == 0) {
-            yStrRef  knownDevices[128];
+            yStrRef  knownDevices[ALLOC_YDX_PER_HUB];
             int j, nbKnownDevices;
-            nbKnownDevices = wpGetAllDevUsingHubUrl(yContext->nethub[i]->url, knownDevices, 128);
+            nbKnownDevices = wpGetAllDevUsingHubUrl(yContext->nethub[i]->url, knownDevices, ALLOC_YDX_PER_HUB);
+            if (nbKnownDevices > ALLOC_YDX_PER_HUB) {
+                nbKnownDevices = ALLOC_YDX_PER_HUB;
+            }
             total = nbKnownDevices * YOCTO_SERIAL_LEN + nbKnownDevices;
             if (buffersize > total) {
                 int isfirst = 1;
@@ -4168,7 +4467,10 @@ typedef enum
     trcGetSubdevices,
     trcGetMem,
     trcFreeMem,
-    trcGetSubDevcies
+    trcGetSubDevcies,
+    trcSetNetworkReactor,
+    trcWaitForEvents,
+    trcSignalEvents
 } TRC_FUN;
 
 static const char * trc_funname[] =
@@ -4227,7 +4529,10 @@ static const char * trc_funname[] =
     "GetSubdev",
     "getmem",
     "freemem",
-    "getsubdev"
+    "getsubdev",
+    "SetNetReactor",
+    "WaitEvents",
+    "SignalEvents"
 };
 
 static const char *dlltracefile = YDLL_TRACE_FILE;
@@ -4396,6 +4701,15 @@ YRETCODE YAPI_FUNCTION_EXPORT yapiTestHub(const char *url, int mstimeout, char *
     return res;
 }
 
+YRETCODE YAPI_FUNCTION_EXPORT yapiSetNetworkReactor(int nbloops, int pincpu, char *errmsg)
+{
+    YRETCODE res;
+    YDLL_CALL_ENTER(trcSetNetworkReactor);
+    res = yapiSetNetworkReactor_internal(nbloops, pincpu, errmsg);
+    YDLL_CALL_LEAVE(res);
+    return res;
+}
+
 YRETCODE YAPI_FUNCTION_EXPORT yapiRegisterHub(const char *url, char *errmsg)
 {
     YRETCODE res;
@@ -4448,6 +4762,22 @@ YRETCODE YAPI_FUNCTION_EXPORT yapiSleep(int ms_duration, char *errmsg)
     return res;
 }
 
+YRETCODE YAPI_FUNCTION_EXPORT yapiWaitForEvents(int ms_duration, char *errmsg)
+{
+    YRETCODE res;
+    YDLL_CALL_ENTER(trcWaitForEvents);
+    res = yapiWaitForEvents_internal(ms_duration, errmsg);
+    YDLL_CALL_LEAVE(res);
+    return res;
+}
+
+void YAPI_FUNCTION_EXPORT yapiSignalEvents(void)
+{
+    YDLL_CALL_ENTER(trcSignalEvents);
+    yapiSignalEvents_internal();
+    YDLL_CALL_LEAVEVOID();
+}
+
 int YAPI_FUNCTION_EXPORT yapiCheckLogicalName(const char *name)
 {
     int res;
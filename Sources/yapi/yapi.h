@@ -303,6 +303,32 @@ YRETCODE YAPI_FUNCTION_EXPORT yapiUnlockDeviceCallBack(char *errmsg);
 YRETCODE YAPI_FUNCTION_EXPORT yapiTestHub(const char *rooturl, int mstimeout, char *errmsg);
 
 
+/*****************************************************************************
+ Function:
+   YRETCODE yapiSetNetworkReactor(int nbloops, int pincpu, char *errmsg)
+
+ Description:
+   Drive all network hubs from a fixed pool of event loops instead of using one
+   helper thread per hub. This is intended for applications that monitor several
+   hundreds of hubs. This function must be called before registering any network
+   hub. Only supported on Linux (epoll).
+
+ Parameters:
+   nbloops: number of event loops (threads) to use, 0 to restore one thread per hub
+   pincpu: if not zero, each loop is pinned to its own CPU core
+   errmsg: a pointer to a buffer of YOCTO_ERRMSG_LEN bytes to store any error message
+
+ Returns:
+   on ERROR  : error code
+   on SUCCES : YAPI_SUCCESS
+
+ Remarks:
+   Each hub is assigned to one loop for its whole lifetime.
+
+ ***************************************************************************/
+YRETCODE YAPI_FUNCTION_EXPORT yapiSetNetworkReactor(int nbloops, int pincpu, char *errmsg);
+
+
 /*****************************************************************************
  Function:
    YRETCODE yRegisterHub(const char *rooturl,char *errmsg)
@@ -439,6 +465,42 @@ YRETCODE YAPI_FUNCTION_EXPORT yapiHandleEvents(char *errmsg);
 YRETCODE YAPI_FUNCTION_EXPORT yapiSleep(int duration_ms, char *errmsg);
 
 
+/*****************************************************************************
+ Function:
+ YRETCODE yapiWaitForEvents(int duration_ms,char *errmsg)
+
+ Description:
+ Block until new events may be available, i.e. until a USB packet is received
+ or yapiSignalEvents() is called, or until the timeout expires. Then perform
+ the same polling tasks as yapiHandleEvents.
+
+ Parameters:
+ duration_ms: maximal waiting time, in milliseconds
+ errmsg: a pointer to a buffer of YOCTO_ERRMSG_LEN bytes to store any error message
+
+ Returns:
+ on ERROR   : error code
+ on SUCCESS : YAPI_SUCCESS
+
+ Remarks:
+ The wakeup is not specific to a thread: when several threads wait at the same
+ time, only one of them is woken up.
+ ***************************************************************************/
+YRETCODE YAPI_FUNCTION_EXPORT yapiWaitForEvents(int duration_ms, char *errmsg);
+
+
+/*****************************************************************************
+ Function:
+ void yapiSignalEvents(void)
+
+ Description:
+ Wake up the thread waiting in yapiWaitForEvents, typically after queuing
+ work for it from a callback.
+
+ ***************************************************************************/
+void YAPI_FUNCTION_EXPORT yapiSignalEvents(void);
+
+
 /*****************************************************************************
  Function:
  u64 yGetTickCount()
@@ -1058,6 +1120,10 @@ void yapiRegisterRawNotificationCb(yRawNotificationCb callback);
 void yapiRegisterRawReportCb(yRawReportCb callback);
 void yapiRegisterRawReportV2Cb(yRawReportV2Cb callback);
 
+// Tell if the calling thread enumerates the devices or handles the events
+// on behalf of the caller of the API (used by the data event queue)
+int yapiIsApiEventThread(void);
+
 
 
 
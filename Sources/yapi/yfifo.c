@@ -311,8 +311,64 @@ u16 yPeekContinuousFifo(yFifoBuf *buf, u8 **ptr, u16 startofs)
 #endif
 
 
+#ifndef MICROCHIP_API
+// Search a pattern in a window of a ring buffer, given as the part up to
+// the end of the buffer (seg1) and the part that wrapped around (seg2).
+// Each contiguous part goes through the SIMD-enabled ymemfindEx, and only
+// the few candidates that straddle the wrap point are checked by hand.
+static u32 ySeekSegments(const u8 *seg1, u32 len1, const u8 *seg2, u32 len2, const u8 *pattern, u32 patlen, u8 bTextCompare)
+{
+    int res;
+    u32 pos;
+
+    res = ymemfindEx(seg1, len1, pattern, patlen, bTextCompare);
+    if (res >= 0) {
+        return (u32)res;
+    }
+    if (len2 == 0) {
+        return 0xffffffff;
+    }
+    pos = (len1 >= patlen ? len1 - patlen + 1 : 0);
+    for (; pos < len1 && pos + patlen <= len1 + len2; pos++) {
+        u32 part1 = len1 - pos;
+        if (ymemequal(seg1 + pos, pattern, part1, bTextCompare) &&
+            ymemequal(seg2, pattern + part1, patlen - part1, bTextCompare)) {
+            return pos;
+        }
+    }
+    res = ymemfindEx(seg2, len2, pattern, patlen, bTextCompare);
+    if (res >= 0) {
+        return len1 + (u32)res;
+    }
+    return 0xffffffff;
+}
+#endif
+
 u16 ySeekFifoEx(yFifoBuf *buf, const u8* pattern, u16 patlen,  u16 startofs, u16 searchlen, u8 bTextCompare)
 {
+#ifndef MICROCHIP_API
+    u8 *ptr;
+    u16 len1;
+    u32 res;
+
+    // pattern bigger than our buffer size -> not found
+    if (startofs + patlen > buf->datasize) {
+        return 0xffff;
+    }
+    if (searchlen == 0 || searchlen > buf->datasize - startofs)
+        searchlen = buf->datasize - startofs;
+    ptr = buf->head + startofs;
+    if (ptr >= YFIFOEND(buf))
+        ptr -= buf->buffsize;
+    len1 = (u16)(YFIFOEND(buf) - ptr);
+    if (len1 > searchlen)
+        len1 = searchlen;
+    res = ySeekSegments(ptr, len1, buf->buff, searchlen - len1, pattern, patlen, bTextCompare);
+    if (res == 0xffffffff) {
+        return 0xffff;
+    }
+    return (u16)(startofs + res);
+#else
     u8 *ptr;
     u16 patidx;
     u16 firstmatch = 0xffff;
@@ -359,6 +415,7 @@ u16 ySeekFifoEx(yFifoBuf *buf, const u8* pattern, u16 patlen,  u16 startofs, u16
         return firstmatch;
     }
     return 0xffff;
+#endif
 }
 
 
@@ -409,6 +466,201 @@ u16 yFifoGetFree(yFifoBuf *buf)
 
 #endif
 
+#ifndef MICROCHIP_API
+
+// 32-bit fifo variant: positions are absolute and wrap naturally on u32,
+// the offset in the buffer is obtained by masking with (buffsize - 1)
+
+#define YFIFO32_LOCK(buf)   if(!(buf)->spsc) yEnterCriticalSection(&(buf)->cs)
+#define YFIFO32_UNLOCK(buf) if(!(buf)->spsc) yLeaveCriticalSection(&(buf)->cs)
+#define YFIFO32_PTR(buf, pos)  ((buf)->buff + ((pos) & ((buf)->buffsize - 1)))
+
+void yFifoInit32(yFifoBuf32 *buf, u8 *buffer, u32 bufflen, int mode)
+{
+    YASSERT(bufflen > 0 && (bufflen & (bufflen - 1)) == 0);
+    memset(buf,0,sizeof(yFifoBuf32));
+    buf->buff = buffer;
+    buf->buffsize = bufflen;
+    buf->spsc = (mode == YFIFO32_SPSC);
+    yInitializeCriticalSection(&(buf->cs));
+}
+
+void yFifoCleanup32(yFifoBuf32 *buf)
+{
+    yDeleteCriticalSection(&(buf->cs));
+    memset(buf,0,sizeof(yFifoBuf32));
+}
+
+// copy datalen bytes from the fifo, starting at absolute position pos
+static void yFifoCopyFrom32(yFifoBuf32 *buf, u32 pos, u8 *data, u32 datalen)
+{
+    u32 ofs = pos & (buf->buffsize - 1);
+    u32 firstpart = buf->buffsize - ofs;
+
+    if (firstpart >= datalen) {
+        memcpy(data, buf->buff + ofs, datalen);
+    } else {
+        memcpy(data, buf->buff + ofs, firstpart);
+        memcpy(data + firstpart, buf->buff, datalen - firstpart);
+    }
+}
+
+u8* yFifoResize32(yFifoBuf32 *buf, u8 *newbuffer, u32 newlen)
+{
+    u8  *oldbuffer;
+    u32 used;
+
+    YASSERT(newlen > 0 && (newlen & (newlen - 1)) == 0);
+    YFIFO32_LOCK(buf);
+    used = buf->wrpos - buf->rdpos;
+    if (used > newlen) {
+        YFIFO32_UNLOCK(buf);
+        return NULL;
+    }
+    if (used) {
+        yFifoCopyFrom32(buf, buf->rdpos, newbuffer, used);
+    }
+    oldbuffer = buf->buff;
+    buf->buff = newbuffer;
+    buf->buffsize = newlen;
+    buf->rdpos = 0;
+    buf->wrpos = used;
+    YFIFO32_UNLOCK(buf);
+    return oldbuffer;
+}
+
+void yFifoEmpty32(yFifoBuf32 *buf)
+{
+    YFIFO32_LOCK(buf);
+    buf->rdpos = buf->wrpos;
+    YFIFO32_UNLOCK(buf);
+}
+
+u32 yPushFifo32(yFifoBuf32 *buf, const u8 *data, u32 datalen)
+{
+    u32 wrpos, ofs, firstpart;
+
+    YFIFO32_LOCK(buf);
+    wrpos = buf->wrpos;
+    if (datalen > buf->buffsize - (wrpos - buf->rdpos)) {
+        // not enough space, we do not handle partial push
+        YFIFO32_UNLOCK(buf);
+        return 0;
+    }
+    ofs = wrpos & (buf->buffsize - 1);
+    firstpart = buf->buffsize - ofs;
+    if (firstpart >= datalen) {
+        memcpy(buf->buff + ofs, data, datalen);
+    } else {
+        memcpy(buf->buff + ofs, data, firstpart);
+        memcpy(buf->buff, data + firstpart, datalen - firstpart);
+    }
+    // data must be visible before the new write position
+    yMemoryBarrier();
+    buf->wrpos = wrpos + datalen;
+    YFIFO32_UNLOCK(buf);
+    return datalen;
+}
+
+u32 yPopFifo32(yFifoBuf32 *buf, u8 *data, u32 datalen)
+{
+    u32 rdpos, used;
+
+    YFIFO32_LOCK(buf);
+    rdpos = buf->rdpos;
+    used = buf->wrpos - rdpos;
+    yMemoryBarrier();
+    if (datalen > used)
+        datalen = used;
+    if (data && datalen) {
+        yFifoCopyFrom32(buf, rdpos, data, datalen);
+    }
+    // done with the data before the producer may overwrite it
+    yMemoryBarrier();
+    buf->rdpos = rdpos + datalen;
+    YFIFO32_UNLOCK(buf);
+    return datalen;
+}
+
+u32 yPeekFifo32(yFifoBuf32 *buf, u8 *data, u32 datalen, u32 startofs)
+{
+    u32 used;
+
+    YFIFO32_LOCK(buf);
+    used = buf->wrpos - buf->rdpos;
+    yMemoryBarrier();
+    if (startofs > used) {
+        YFIFO32_UNLOCK(buf);
+        return 0;
+    }
+    if (datalen > used - startofs)
+        datalen = used - startofs;
+    if (data && datalen) {
+        yFifoCopyFrom32(buf, buf->rdpos + startofs, data, datalen);
+    }
+    YFIFO32_UNLOCK(buf);
+    return datalen;
+}
+
+u32 yPeekContinuousFifo32(yFifoBuf32 *buf, u8 **ptr, u32 startofs)
+{
+    u32 used, ofs, toend;
+
+    YFIFO32_LOCK(buf);
+    used = buf->wrpos - buf->rdpos;
+    yMemoryBarrier();
+    if (startofs >= used) {
+        YFIFO32_UNLOCK(buf);
+        return 0;
+    }
+    used -= startofs;
+    ofs = (buf->rdpos + startofs) & (buf->buffsize - 1);
+    toend = buf->buffsize - ofs;
+    if (ptr) {
+        *ptr = buf->buff + ofs;
+    }
+    YFIFO32_UNLOCK(buf);
+    return (toend < used ? toend : used);
+}
+
+u32 ySeekFifo32(yFifoBuf32 *buf, const u8* pattern, u32 patlen,  u32 startofs, u32 searchlen, u8 bTextCompare)
+{
+    u32 used, ofs, len1, res;
+
+    YFIFO32_LOCK(buf);
+    used = buf->wrpos - buf->rdpos;
+    yMemoryBarrier();
+    // pattern bigger than our buffer size -> not found
+    if (startofs + patlen > used) {
+        YFIFO32_UNLOCK(buf);
+        return YFIFO32_NOT_FOUND;
+    }
+    if (searchlen == 0 || searchlen > used - startofs)
+        searchlen = used - startofs;
+    ofs = (buf->rdpos + startofs) & (buf->buffsize - 1);
+    len1 = buf->buffsize - ofs;
+    if (len1 > searchlen)
+        len1 = searchlen;
+    res = ySeekSegments(buf->buff + ofs, len1, buf->buff, searchlen - len1, pattern, patlen, bTextCompare);
+    YFIFO32_UNLOCK(buf);
+    if (res == 0xffffffff) {
+        return YFIFO32_NOT_FOUND;
+    }
+    return startofs + res;
+}
+
+u32 yFifoGetUsed32(yFifoBuf32 *buf)
+{
+    return buf->wrpos - buf->rdpos;
+}
+
+u32 yFifoGetFree32(yFifoBuf32 *buf)
+{
+    return buf->buffsize - (buf->wrpos - buf->rdpos);
+}
+
+#endif
+
 #ifndef REDUCE_COMMON_CODE
 void yxtoa(u32 x, char *buf, u16 len)
 {
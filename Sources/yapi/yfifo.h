@@ -130,6 +130,40 @@ u16  yFifoGetFree(yFifoBuf *buf);
 #define yFifoGetFree(buf)                                                   yFifoGetFreeEx(buf)
 #endif
 
+#ifndef MICROCHIP_API
+// Fifo variant with 32-bit sizes and offsets, for network streams that may
+// receive large bursts. The buffer size must be a power of two.
+// In YFIFO32_SPSC mode no lock is taken: the fifo must then be filled by a
+// single producer (push) and emptied by a single consumer (pop, peek, seek
+// and empty), the read and write positions being published with barriers.
+typedef struct {
+    u32             buffsize;
+    u8              *buff;
+    volatile u32    rdpos;      // absolute read position (consumer)
+    volatile u32    wrpos;      // absolute write position (producer)
+    u8              spsc;
+    yCRITICAL_SECTION cs;
+} yFifoBuf32;
+
+#define YFIFO32_LOCKED      0
+#define YFIFO32_SPSC        1
+#define YFIFO32_NOT_FOUND   0xffffffff
+
+void yFifoInit32(yFifoBuf32 *buf, u8 *buffer, u32 bufflen, int mode);
+void yFifoCleanup32(yFifoBuf32 *buf);
+// move the content to a bigger buffer and return the previous one, or NULL
+// if the content does not fit. The caller must own both ends of the fifo.
+u8*  yFifoResize32(yFifoBuf32 *buf, u8 *newbuffer, u32 newlen);
+void yFifoEmpty32(yFifoBuf32 *buf);
+u32  yPushFifo32(yFifoBuf32 *buf, const u8 *data, u32 datalen);
+u32  yPopFifo32(yFifoBuf32 *buf, u8 *data, u32 datalen);
+u32  yPeekFifo32(yFifoBuf32 *buf, u8 *data, u32 datalen, u32 startofs);
+u32  yPeekContinuousFifo32(yFifoBuf32 *buf, u8 **ptr, u32 startofs);
+u32  ySeekFifo32(yFifoBuf32 *buf, const u8* pattern, u32 patlen,  u32 startofs, u32 searchlen, u8 bTextCompare);
+u32  yFifoGetUsed32(yFifoBuf32 *buf);
+u32  yFifoGetFree32(yFifoBuf32 *buf);
+#endif
+
 // Misc functions needed in yapi, hubs and devices
 void yxtoa(u32 x, char *buf, u16 len);
 void decodePubVal(Notification_funydx funInfo, const char *funcval, char *buffer);
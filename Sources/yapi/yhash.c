@@ -52,11 +52,39 @@ __eds__ __attribute__((far, __section__(".yfar1"))) YHashSlot yHashTable[NB_MAX_
 #include <Windows.h>
 #endif
 #define __eds__
-static YHashSlot  yHashTable[NB_MAX_HASH_ENTRIES];
-yCRITICAL_SECTION yHashMutex;
+// The table grows by chunks that are never moved nor freed before yHashFree,
+// so that pointers and indexes to published entries remain valid without lock
+static YHashSlot  *yHashChunks[NB_MAX_HASH_ENTRIES / HASH_CHUNK_SIZE];
+#define HSLOT(idx)  (yHashChunks[(idx) >> HASH_CHUNK_POW][(idx) & (HASH_CHUNK_SIZE - 1)])
+// writers are serialized per first-level bucket, readers never lock
+#define NB_HASH_SHARDS  16
+static yCRITICAL_SECTION yHashShardMutex[NB_HASH_SHARDS];
+yCRITICAL_SECTION yHashMutex;   // protects nextHashEntry and chunk allocation
 yCRITICAL_SECTION yFreeMutex;
 yCRITICAL_SECTION yWpMutex;
 yCRITICAL_SECTION yYpMutex;
+// an entry is made visible to lock-free readers by a release store of the
+// link to it, once fully written; readers follow the links with acquire loads
+#if defined(_MSC_VER)
+#define yHashStoreNext(idx, val)    do { MemoryBarrier(); *(volatile yHash*)&HSLOT(idx).next = (val); } while(0)
+static __inline yHash yHashLoadNext(yHash idx)
+{
+    yHash next = *(volatile yHash*)&HSLOT(idx).next;
+    MemoryBarrier();
+    return next;
+}
+#elif defined(__GNUC__) || defined(__clang__)
+#define yHashStoreNext(idx, val)    __atomic_store_n(&HSLOT(idx).next, (val), __ATOMIC_RELEASE)
+#define yHashLoadNext(idx)          __atomic_load_n(&HSLOT(idx).next, __ATOMIC_ACQUIRE)
+#else
+#define yHashStoreNext(idx, val)    (HSLOT(idx).next = (val))
+#define yHashLoadNext(idx)          (HSLOT(idx).next)
+#endif
+#endif
+#ifdef MICROCHIP_API
+#define HSLOT(idx)  (yHashTable[idx])
+#define yHashStoreNext(idx, val)    (HSLOT(idx).next = (val))
+#define yHashLoadNext(idx)          (HSLOT(idx).next)
 #endif
 
 //#define DEBUG_YHASH
@@ -72,6 +100,9 @@ static u16 nextDevYdx = 0;
 #endif
 static u8  nextCatYdx = 1;
 static u16 nextHashEntry = 256;
+#ifndef MICROCHIP_API
+static u8  hashFullLogged = 0;
+#endif
 
 static yBlkHdl devYdxPtr[NB_MAX_DEVICES];
 static yBlkHdl funYdxPtr[NB_MAX_DEVICES];
@@ -88,14 +119,40 @@ yBlkHdl yYpListHead = INVALID_BLK_HDL;
 //   Small block (16 bytes) allocator, for white pages and yellow pages
 // =======================================================================
 
-#define BLK(hdl)    (yHashTable[(hdl)>>1].blk[(hdl)&1])
+#define BLK(hdl)    (HSLOT((hdl)>>1).blk[(hdl)&1])
 #define WP(hdl)     (BLK(hdl).wpEntry)
 #define YC(hdl)     (BLK(hdl).ypCateg)
 #define YP(hdl)     (BLK(hdl).ypEntry)
 #define YA(hdl)     (BLK(hdl).ypArray)
+#define WP_DEVYDX(hdl)          (WP(hdl).devYdx | ((u16)WP(hdl).devYdxHi << 8))
+#define WP_SET_DEVYDX(hdl,ydx)  do { WP(hdl).devYdx = (u8)(ydx); WP(hdl).devYdxHi = (u8)((ydx) >> 8); } while(0)
 
 yBlkHdl freeBlks = INVALID_BLK_HDL;
 
+// reserve a new slot in the table (for a string or for two small blocks),
+// return 0 when all the slots below limit are used
+static u16 yHashAllocEntry(u16 limit)
+{
+    u16 res = 0;
+
+#ifndef MICROCHIP_API
+    yEnterCriticalSection(&yHashMutex);
+    if (nextHashEntry < limit) {
+        res = nextHashEntry++;
+        if (yHashChunks[res >> HASH_CHUNK_POW] == NULL) {
+            YHashSlot *chunk = (YHashSlot*)yMalloc(HASH_CHUNK_SIZE * sizeof(YHashSlot));
+            memset(chunk, 0, HASH_CHUNK_SIZE * sizeof(YHashSlot));
+            yHashChunks[res >> HASH_CHUNK_POW] = chunk;
+        }
+    }
+    yLeaveCriticalSection(&yHashMutex);
+#else
+    YASSERT(nextHashEntry < limit);
+    res = nextHashEntry++;
+#endif
+    return res;
+}
+
 static yBlkHdl yBlkAlloc(void)
 {
     yBlkHdl  res;
@@ -105,10 +162,9 @@ static yBlkHdl yBlkAlloc(void)
         res = freeBlks;
         freeBlks = BLK(freeBlks).nextPtr;
     } else {
-        yEnterCriticalSection(&yHashMutex);
-        YASSERT(nextHashEntry < NB_MAX_HASH_ENTRIES);
-        res = ((nextHashEntry++) << 1) + 1;
-        yLeaveCriticalSection(&yHashMutex);
+        u16 entry = yHashAllocEntry(NB_MAX_HASH_ENTRIES);
+        YASSERT(entry != 0);
+        res = (entry << 1) + 1;
         BLK(res).blkId = 0;
         BLK(res).nextPtr = INVALID_BLK_HDL;
         freeBlks = res--;
@@ -186,24 +242,44 @@ static u16 fletcher16(const u8 *data, u16 len, u16 virtlen)
     return ((sum1 & 0xff) << 8) | (sum2 & 0xff);
 }
 
+#ifndef MICROCHIP_API
+static void yIdxInitAll(void);
+static void yIdxFreeAll(void);
+#endif
+
 void yHashInit(void)
 {
     yStrRef empty, Module, module, HubPort,Sensor;
     u16     i;
 
     HLOGF(("yHashInit\n"));
+#ifndef MICROCHIP_API
+    // first-level buckets (0..255) are always allocated
+    yHashChunks[0] = (YHashSlot*)yMalloc(HASH_CHUNK_SIZE * sizeof(YHashSlot));
+    memset(yHashChunks[0], 0, HASH_CHUNK_SIZE * sizeof(YHashSlot));
+#endif
     for(i = 0; i < 256; i++)
-        yHashTable[i].next = 0;
+        HSLOT(i).next = 0;
+    nextHashEntry = 256;
+#ifndef MICROCHIP_API
+    hashFullLogged = 0;
+#endif
+    nextCatYdx = 1;
+    freeBlks = INVALID_BLK_HDL;
+    yWpListHead = INVALID_BLK_HDL;
     for(i = 0; i < NB_MAX_DEVICES; i++)
         devYdxPtr[i] = INVALID_BLK_HDL;
     for(i = 0; i < NB_MAX_DEVICES; i++)
         funYdxPtr[i] = INVALID_BLK_HDL;
 #ifndef MICROCHIP_API
     memset((u8 *)usedDevYdx, 0, sizeof(usedDevYdx));
+    for(i = 0; i < NB_HASH_SHARDS; i++)
+        yInitializeCriticalSection(&yHashShardMutex[i]);
     yInitializeCriticalSection(&yHashMutex);
     yInitializeCriticalSection(&yFreeMutex);
     yInitializeCriticalSection(&yWpMutex);
     yInitializeCriticalSection(&yYpMutex);
+    yIdxInitAll();
 #endif
 
     // Always init hast table with empty string and Module string
@@ -239,73 +315,121 @@ void yHashInit(void)
 #ifndef MICROCHIP_API
 void yHashFree(void)
 {
+    u16     i;
+
     HLOGF(("yHashFree\n"));
+    for(i = 0; i < NB_MAX_HASH_ENTRIES / HASH_CHUNK_SIZE; i++) {
+        if(yHashChunks[i]) {
+            yFree(yHashChunks[i]);
+            yHashChunks[i] = NULL;
+        }
+    }
+    for(i = 0; i < NB_HASH_SHARDS; i++)
+        yDeleteCriticalSection(&yHashShardMutex[i]);
     yDeleteCriticalSection(&yHashMutex);
     yDeleteCriticalSection(&yFreeMutex);
     yDeleteCriticalSection(&yWpMutex);
     yDeleteCriticalSection(&yYpMutex);
+    yIdxFreeAll();
 }
 #endif
 
+// search the chain of a first-level bucket, without lock
+static yHash yHashSearch(u16 hash, const u8 *buf, u16 len, yHash *lasthash)
+{
+    u16     i;
+    yHash   yhash = hash & 0xff;
+    __eds__ u8 *p;
+
+    *lasthash = INVALID_HASH_IDX;
+    if(yHashLoadNext(yhash) == 0) {
+        // first entry not allocated
+        return INVALID_HASH_IDX;
+    }
+    do {
+        if(HSLOT(yhash).hash == hash) {
+            // hash match, perform exact comparison
+            p = HSLOT(yhash).buff;
+            for(i = 0; i < len; i++) if(p[i] != buf[i]) break;
+            if(i == len) {
+                // data match, verify padding zeroes for a full match
+                while(i < HASH_BUF_SIZE) if(p[i++] != 0) break;
+                if(i == HASH_BUF_SIZE) {
+                    // full match
+                    HLOGF(("yHash found at 0x%x\n", yhash));
+                    return yhash;
+                }
+            }
+        }
+        // not a match, try next entry in chain
+        *lasthash = yhash;
+        yhash = yHashLoadNext(yhash);
+    } while(yhash != -1);
+    return INVALID_HASH_IDX;
+}
+
 static yHash yHashPut(const u8 *buf, u16 len, u8 testonly)
 {
     u16     hash,i;
-    yHash   yhash, prevhash = INVALID_HASH_IDX;
+    yHash   yhash, prevhash;
     __eds__ u8 *p;
+#ifndef MICROCHIP_API
+    yCRITICAL_SECTION *shard;
+#endif
 
     hash = fletcher16(buf, len, HASH_BUF_SIZE);
-    yhash = hash & 0xff;
-
-    yEnterCriticalSection(&yHashMutex);
-
-    if(yHashTable[yhash].next != 0) {
-        // first entry is allocated, search chain
-        do {
-            if(yHashTable[yhash].hash == hash) {
-                // hash match, perform exact comparison
-                p = yHashTable[yhash].buff;
-                for(i = 0; i < len; i++) if(p[i] != buf[i]) break;
-                if(i == len) {
-                    // data match, verify padding zeroes for a full match
-                    while(i < HASH_BUF_SIZE) if(p[i++] != 0) break;
-                    if(i == HASH_BUF_SIZE) {
-                        // full match
-                        HLOGF(("yHash found at 0x%x\n", yhash));
-                        goto exit_ok;
-                    }
-                }
+    // entries are never removed nor modified once published,
+    // so lookups of known strings do not need any lock
+    yhash = yHashSearch(hash, buf, len, &prevhash);
+    if(yhash != INVALID_HASH_IDX || testonly) {
+        if(yhash == INVALID_HASH_IDX) {
+            HLOGF(("yHash entry not found\n"));
+        }
+        return yhash;
+    }
+#ifndef MICROCHIP_API
+    shard = &yHashShardMutex[hash & (NB_HASH_SHARDS - 1)];
+    yEnterCriticalSection(shard);
+    // search again, the entry may have been added by another thread
+    yhash = yHashSearch(hash, buf, len, &prevhash);
+    if(yhash != INVALID_HASH_IDX) {
+        yLeaveCriticalSection(shard);
+        return yhash;
+    }
+#endif
+    if(prevhash != INVALID_HASH_IDX) {
+#ifndef MICROCHIP_API
+        yhash = yHashAllocEntry(NB_MAX_HASH_ENTRIES - NB_HASH_BLK_RESERVE);
+        if(yhash == 0) {
+            yLeaveCriticalSection(shard);
+            if(!hashFullLogged) {
+                hashFullLogged = 1;
+                dbglog("yHash table full, strings are no more added\n");
             }
-            // not a match, try next entry in chain
-            prevhash = yhash;
-            yhash = yHashTable[yhash].next;
-        } while(yhash != -1);
-        // not found in chain
-        if(testonly) goto exit_error;
-        YASSERT(nextHashEntry < NB_MAX_HASH_ENTRIES);
-        yhash = nextHashEntry++;
-    } else {
-        // first entry not allocated
-        if(testonly) {
-        exit_error:
-            HLOGF(("yHash entry not found\n", yhash));
-            yLeaveCriticalSection(&yHashMutex);
-            return -1;
+            return INVALID_HASH_IDX;
         }
+#else
+        yhash = yHashAllocEntry(NB_MAX_HASH_ENTRIES);
+#endif
+    } else {
+        yhash = hash & 0xff;
     }
 
     // create new entry
-    yHashTable[yhash].hash = hash;
-    yHashTable[yhash].next = -1;
-    p = yHashTable[yhash].buff;
+    HSLOT(yhash).hash = hash;
+    p = HSLOT(yhash).buff;
     for(i = 0; i < len; i++) p[i] = buf[i];
     while(i < HASH_BUF_SIZE) p[i++] = 0;
     if(prevhash != INVALID_HASH_IDX) {
-        yHashTable[prevhash].next = yhash;
+        HSLOT(yhash).next = -1;
+        yHashStoreNext(prevhash, yhash);
+    } else {
+        yHashStoreNext(yhash, -1);
     }
     HLOGF(("yHash added at 0x%x\n", yhash));
-
-exit_ok:
-    yLeaveCriticalSection(&yHashMutex);
+#ifndef MICROCHIP_API
+    yLeaveCriticalSection(shard);
+#endif
     return yhash;
 }
 
@@ -339,24 +463,22 @@ yHash yHashTestStr(const char *str)
     return yHashPut((const u8 *)str, len, 1);
 }
 
+// INVALID_HASH_IDX is what yHashPutStr returns once the table is full,
+// it reads as an empty string
+#define yHashIsUnallocated(yhash)   ((yhash) < 0 || (yhash) >= nextHashEntry || HSLOT(yhash).next == 0)
+
 void yHashGetBuf(yHash yhash, u8 *destbuf, u16 bufsize)
 {
     __eds__ u8 *p;
 
     HLOGF(("yHashGetBuf(0x%x)\n",yhash));
-    YASSERT(yhash >= 0);
-#ifdef MICROCHIP_API
-    if(yhash >= nextHashEntry || yHashTable[yhash].next == 0) {
-        // should never happen !
+    if(yHashIsUnallocated(yhash)) {
+        // 0 means unallocated, -1 means end of chain
         memset(destbuf, 0, bufsize);
         return;
     }
-#else
-    YASSERT(yhash < nextHashEntry);
-    YASSERT(yHashTable[yhash].next != 0); // 0 means unallocated, -1 means end of chain
-#endif
     if(bufsize > HASH_BUF_SIZE) bufsize = HASH_BUF_SIZE;
-    p = yHashTable[yhash].buff;
+    p = HSLOT(yhash).buff;
     while(bufsize-- > 0) {
         *destbuf++ = *p++;
     }
@@ -381,20 +503,16 @@ u16 yHashGetStrLen(yHash yhash)
 #endif
 
     HLOGF(("yHashGetStrLen(0x%x)\n",yhash));
-    YASSERT(yhash >= 0);
-#ifdef MICROCHIP_API
-    if(yhash >= nextHashEntry || yHashTable[yhash].next == 0) {
-        // should never happen
+    if(yHashIsUnallocated(yhash)) {
         return 0;
     }
+#ifdef MICROCHIP_API
     for(i = 0; i < HASH_BUF_SIZE; i++) {
-        if(!yHashTable[yhash].buff[i]) break;
+        if(!HSLOT(yhash).buff[i]) break;
     }
     return i;
 #else
-    YASSERT(yhash < nextHashEntry);
-    YASSERT(yHashTable[yhash].next != 0); // 0 means unallocated
-    return (u16) YSTRLEN((char *)yHashTable[yhash].buff);
+    return (u16) YSTRLEN((char *)HSLOT(yhash).buff);
 #endif
 }
 
@@ -405,19 +523,19 @@ char *yHashGetStrPtr(yHash yhash)
 #endif
 
     HLOGF(("yHashGetStrPtr(0x%x)\n",yhash));
-    YASSERT(yhash >= 0);
-    YASSERT(yhash < nextHashEntry);
-    YASSERT(yHashTable[yhash].next != 0); // 0 means unallocated
+    if(yHashIsUnallocated(yhash)) {
+        return (char*)"";
+    }
 #ifdef MICROCHIP_API
     for(i = 0; i < HASH_BUF_SIZE; i++) {
-        char c = yHashTable[yhash].buff[i];
+        char c = HSLOT(yhash).buff[i];
         if(!c) break;
         shared_hashbuf[i] = c;
     }
     shared_hashbuf[i] = 0;
     return shared_hashbuf;
 #else
-    return (char *)yHashTable[yhash].buff;
+    return (char *)HSLOT(yhash).buff;
 #endif
 }
 
@@ -627,6 +745,10 @@ int yHashSameHub(yUrlRef url_a, yUrlRef url_b)
 yUrlRef yHashUrlUSB(yHash serial)
 {
     yAbsUrl huburl;
+
+    if(serial == INVALID_HASH_IDX) {
+        return INVALID_HASH_IDX;
+    }
     // set all hash as invalid
     memset(&huburl, 0xff, sizeof(huburl));
     huburl.proto = PROTO_AUTO;
@@ -646,6 +768,212 @@ yUrlRef yHashUrlAPI(void)
     return yHashPut((const u8 *)&huburl, sizeof(huburl), 0);
 }
 
+#ifndef MICROCHIP_API
+// =======================================================================
+//   Secondary indexes on white pages and yellow pages
+// =======================================================================
+
+// Each index maps a 32-bit key (one or two yStrRef) to the blocks registered
+// with this key, so that searches do not depend on the number of devices.
+// An index may hold several blocks for the same key (ex: two devices with
+// the same logical name). In this case the callers fall back to the list
+// scan to keep the same precedence rules as before.
+// wp indexes are protected by yWpMutex and yp indexes by yYpMutex.
+
+typedef struct {
+    u32     key;
+    yBlkHdl hdl;
+    yStrRef categ;      // category of yellow page entries
+    s32     next;       // next node in bucket or in free list
+} yIdxNode;
+
+typedef struct {
+    s32         *buckets;
+    u32         nbuckets;   // always a power of two
+    yIdxNode    *nodes;
+    s32         nbnodes;    // allocated nodes
+    s32         nbused;
+    s32         freenode;
+} yIdx;
+
+#define YIDX_MIN_BUCKETS    256
+
+static yIdx wpSerialIdx;    // serial -> wp entry
+static yIdx wpNameIdx;      // logical name -> wp entry
+static yIdx ypHwIdx;        // serial + (funcId << 16) -> yp entry
+static yIdx ypNameIdx;      // function logical name -> yp entry
+
+#define YIDX_KEY(a,b)   ((u32)(u16)(a) | ((u32)(u16)(b) << 16))
+
+static u32 yIdxBucket(yIdx *idx, u32 key)
+{
+    return (key * 2654435761u) & (idx->nbuckets - 1);
+}
+
+static void yIdxInit(yIdx *idx)
+{
+    memset(idx, 0, sizeof(yIdx));
+    idx->nbuckets = YIDX_MIN_BUCKETS;
+    idx->buckets = (s32*)yMalloc(idx->nbuckets * sizeof(s32));
+    memset(idx->buckets, 0xff, idx->nbuckets * sizeof(s32));
+    idx->freenode = -1;
+}
+
+static void yIdxFree(yIdx *idx)
+{
+    if(idx->buckets) yFree(idx->buckets);
+    if(idx->nodes)   yFree(idx->nodes);
+    memset(idx, 0, sizeof(yIdx));
+}
+
+// keep chains short by doubling the number of buckets when needed
+static void yIdxGrow(yIdx *idx)
+{
+    u32 i, b, nbold = idx->nbuckets;
+    s32 *old = idx->buckets;
+    s32 node, next;
+
+    idx->nbuckets = nbold * 2;
+    idx->buckets = (s32*)yMalloc(idx->nbuckets * sizeof(s32));
+    memset(idx->buckets, 0xff, idx->nbuckets * sizeof(s32));
+    for(i = 0; i < nbold; i++) {
+        // chains are reversed, order of nodes within a chain does not matter
+        for(node = old[i]; node >= 0; node = next) {
+            next = idx->nodes[node].next;
+            b = yIdxBucket(idx, idx->nodes[node].key);
+            idx->nodes[node].next = idx->buckets[b];
+            idx->buckets[b] = node;
+        }
+    }
+    yFree(old);
+}
+
+static void yIdxAdd(yIdx *idx, u32 key, yBlkHdl hdl, yStrRef categ)
+{
+    s32 node;
+    u32 b;
+
+    if((u32)idx->nbused >= idx->nbuckets) {
+        yIdxGrow(idx);
+    }
+    if(idx->freenode < 0) {
+        s32 i, nbnodes = (idx->nbnodes ? idx->nbnodes * 2 : YIDX_MIN_BUCKETS);
+        yIdxNode *nodes = (yIdxNode*)yMalloc(nbnodes * sizeof(yIdxNode));
+        if(idx->nodes) {
+            memcpy(nodes, idx->nodes, idx->nbnodes * sizeof(yIdxNode));
+            yFree(idx->nodes);
+        }
+        for(i = idx->nbnodes; i < nbnodes; i++) {
+            nodes[i].next = (i + 1 < nbnodes ? i + 1 : -1);
+        }
+        idx->freenode = idx->nbnodes;
+        idx->nodes = nodes;
+        idx->nbnodes = nbnodes;
+    }
+    node = idx->freenode;
+    idx->freenode = idx->nodes[node].next;
+    b = yIdxBucket(idx, key);
+    idx->nodes[node].key = key;
+    idx->nodes[node].hdl = hdl;
+    idx->nodes[node].categ = categ;
+    idx->nodes[node].next = idx->buckets[b];
+    idx->buckets[b] = node;
+    idx->nbused++;
+}
+
+static void yIdxRemove(yIdx *idx, u32 key, yBlkHdl hdl)
+{
+    s32 *link = &idx->buckets[yIdxBucket(idx, key)];
+    s32 node;
+
+    while((node = *link) >= 0) {
+        if(idx->nodes[node].key == key && idx->nodes[node].hdl == hdl) {
+            *link = idx->nodes[node].next;
+            idx->nodes[node].next = idx->freenode;
+            idx->freenode = node;
+            idx->nbused--;
+            return;
+        }
+        link = &idx->nodes[node].next;
+    }
+}
+
+// return the first node registered with key, or -1
+static s32 yIdxFirst(yIdx *idx, u32 key)
+{
+    s32 node = idx->buckets[yIdxBucket(idx, key)];
+    while(node >= 0 && idx->nodes[node].key != key) {
+        node = idx->nodes[node].next;
+    }
+    return node;
+}
+
+static s32 yIdxNext(yIdx *idx, s32 node, u32 key)
+{
+    node = idx->nodes[node].next;
+    while(node >= 0 && idx->nodes[node].key != key) {
+        node = idx->nodes[node].next;
+    }
+    return node;
+}
+
+// Yellow pages entry filter: a specific category, or any category matching
+// an abstract base class (when categ is INVALID_HASH_IDX)
+static int ypIdxMatch(yIdxNode *node, yStrRef categ, int abstract)
+{
+    if(categ != INVALID_HASH_IDX) {
+        return node->categ == categ;
+    }
+    return abstract == YOCTO_AKA_YFUNCTION || YP(node->hdl).blkId == YBLKID_YPENTRY + abstract;
+}
+
+// Search a yellow pages index. Return the number of matching entries
+// (1 or 2 meaning "more than one") and store the first match in hdl.
+static int ypIdxSearch(yIdx *idx, u32 key, yStrRef categ, int abstract, yBlkHdl *hdl)
+{
+    int count = 0;
+    s32 node;
+
+    *hdl = INVALID_BLK_HDL;
+    for(node = yIdxFirst(idx, key); node >= 0; node = yIdxNext(idx, node, key)) {
+        if(ypIdxMatch(&idx->nodes[node], categ, abstract)) {
+            if(++count > 1) break;
+            *hdl = idx->nodes[node].hdl;
+        }
+    }
+    return count;
+}
+
+// Search a white pages index, with the same return convention as ypIdxSearch
+static int wpIdxSearch(yIdx *idx, yStrRef ref, yBlkHdl *hdl)
+{
+    u32 key = (u16)ref;
+    s32 node = yIdxFirst(idx, key);
+
+    *hdl = INVALID_BLK_HDL;
+    if(node < 0) return 0;
+    *hdl = idx->nodes[node].hdl;
+    return (yIdxNext(idx, node, key) >= 0 ? 2 : 1);
+}
+
+static void yIdxInitAll(void)
+{
+    yIdxInit(&wpSerialIdx);
+    yIdxInit(&wpNameIdx);
+    yIdxInit(&ypHwIdx);
+    yIdxInit(&ypNameIdx);
+}
+
+static void yIdxFreeAll(void)
+{
+    yIdxFree(&wpSerialIdx);
+    yIdxFree(&wpNameIdx);
+    yIdxFree(&ypHwIdx);
+    yIdxFree(&ypNameIdx);
+}
+
+#endif
+
 // =======================================================================
 //   White pages support
 // =======================================================================
@@ -655,6 +983,24 @@ static void ypUnregister(yStrRef serial);//forward declaration
 static int wpLockCount = 0;
 static int wpSomethingUnregistered = 0;
 
+// This function should only be called after seizing yWpMutex
+static yBlkHdl wpFindBySerial(yStrRef serial)
+{
+    yBlkHdl hdl;
+
+#ifndef MICROCHIP_API
+    wpIdxSearch(&wpSerialIdx, serial, &hdl);
+#else
+    hdl = yWpListHead;
+    while(hdl != INVALID_BLK_HDL) {
+        YASSERT(WP(hdl).blkId == YBLKID_WPENTRY);
+        if(WP(hdl).serial == serial) break;
+        hdl = WP(hdl).nextPtr;
+    }
+#endif
+    return hdl;
+}
+
 static void wpExecuteUnregisterUnsec(void)
 {
     yBlkHdl  prev = INVALID_BLK_HDL, next;
@@ -692,7 +1038,7 @@ static void wpExecuteUnregisterUnsec(void)
             } else {
                 WP(prev).nextPtr = next;
             }
-            devYdx = WP(hdl).devYdx;
+            devYdx = WP_DEVYDX(hdl);
             funHdl = funYdxPtr[devYdx];
             while(funHdl != INVALID_BLK_HDL) {
                 YASSERT(YA(funHdl).blkId == YBLKID_YPARRAY);
@@ -709,6 +1055,10 @@ static void wpExecuteUnregisterUnsec(void)
             usedDevYdx[devYdx>>4] &= ~ (u16)(1 << (devYdx&15));
             //dbglog("wpUnregister serial=%X devYdx=%d (next=%d)\n", WP(hdl).serial, devYdx, nextDevYdx);
             freeDevYdxInfos(devYdx);
+            yIdxRemove(&wpSerialIdx, WP(hdl).serial, hdl);
+            if(WP(hdl).name != YSTRREF_EMPTY_STRING) {
+                yIdxRemove(&wpNameIdx, WP(hdl).name, hdl);
+            }
 #endif
             yBlkFree(hdl);
         } else {
@@ -766,6 +1116,7 @@ void wpAllowUnregisterDbg(const char *file, u32 line)
 #endif
 
 // return :
+//     -1 -> new device dropped, no devYdx left or no room for its serial
 //      0 -> no change
 //      1 -> update
 //      2 -> first register
@@ -776,17 +1127,25 @@ int wpRegister(int devYdx, yStrRef serial, yStrRef logicalName, yStrRef productN
     yBlkHdl  hdl;
     int      changed=0;
 
+    if(serial == INVALID_HASH_IDX || devUrl == INVALID_HASH_IDX) {
+        // the string table is full
+        return -1;
+    }
     yEnterCriticalSection(&yWpMutex);
 
-    YASSERT(devUrl != INVALID_HASH_IDX);
-    hdl = yWpListHead;
-    while(hdl != INVALID_BLK_HDL) {
-        YASSERT(WP(hdl).blkId == YBLKID_WPENTRY);
-        if(WP(hdl).serial == serial) break;
-        prev = hdl;
-        hdl = WP(prev).nextPtr;
-    }
+    hdl = wpFindBySerial(serial);
     if(hdl == INVALID_BLK_HDL) {
+        // new entry, locate the end of the list
+        prev = yWpListHead;
+        while(prev != INVALID_BLK_HDL && WP(prev).nextPtr != INVALID_BLK_HDL) {
+            prev = WP(prev).nextPtr;
+        }
+#ifndef MICROCHIP_API
+        if(devYdx == -1 && nextDevYdx >= NB_MAX_DEVICES) {
+            yLeaveCriticalSection(&yWpMutex);
+            return -1;
+        }
+#endif
         hdl = yBlkAlloc();
         changed = 2;
 #ifndef MICROCHIP_API
@@ -795,8 +1154,7 @@ int wpRegister(int devYdx, yStrRef serial, yStrRef logicalName, yStrRef productN
         usedDevYdx[devYdx>>4] |= 1 << (devYdx&15);
         if(nextDevYdx == devYdx) {
             nextDevYdx++;
-            while(usedDevYdx[nextDevYdx>>4] & (1 << (nextDevYdx&15))) {
-                if(nextDevYdx >= NB_MAX_DEVICES) break;
+            while(nextDevYdx < NB_MAX_DEVICES && (usedDevYdx[nextDevYdx>>4] & (1 << (nextDevYdx&15)))) {
                 nextDevYdx++;
             }
         }
@@ -805,7 +1163,7 @@ int wpRegister(int devYdx, yStrRef serial, yStrRef logicalName, yStrRef productN
 #endif
         YASSERT(devYdx < NB_MAX_DEVICES);
         devYdxPtr[devYdx] = hdl;
-        WP(hdl).devYdx  = (u8)devYdx;
+        WP_SET_DEVYDX(hdl, devYdx);
         WP(hdl).blkId   = YBLKID_WPENTRY;
         WP(hdl).serial  = serial;
         WP(hdl).name    = YSTRREF_EMPTY_STRING;
@@ -818,22 +1176,33 @@ int wpRegister(int devYdx, yStrRef serial, yStrRef logicalName, yStrRef productN
         } else {
             WP(prev).nextPtr = hdl;
         }
+#ifndef MICROCHIP_API
+        yIdxAdd(&wpSerialIdx, serial, hdl, INVALID_HASH_IDX);
+#endif
 #ifdef MICROCHIP_API
-    } else if(devYdx != -1 && WP(hdl).devYdx != devYdx) {
+    } else if(devYdx != -1 && WP_DEVYDX(hdl) != devYdx) {
         // allow change of devYdx based on hub role
-        u16 oldDevYdx = WP(hdl).devYdx;
+        u16 oldDevYdx = WP_DEVYDX(hdl);
         if(oldDevYdx < NB_MAX_DEVICES) {
             funYdxPtr[devYdx] = funYdxPtr[oldDevYdx];
             funYdxPtr[oldDevYdx] = INVALID_BLK_HDL;
             devYdxPtr[devYdx] = hdl;
         }
         devYdxPtr[oldDevYdx] = INVALID_BLK_HDL;
-        WP(hdl).devYdx  = (u8)devYdx;
+        WP_SET_DEVYDX(hdl, devYdx);
 #endif
     }
     if(logicalName != INVALID_HASH_IDX)  {
         if(WP(hdl).name != logicalName){
             if(changed==0) changed=1;
+#ifndef MICROCHIP_API
+            if(WP(hdl).name != YSTRREF_EMPTY_STRING) {
+                yIdxRemove(&wpNameIdx, WP(hdl).name, hdl);
+            }
+            if(logicalName != YSTRREF_EMPTY_STRING) {
+                yIdxAdd(&wpNameIdx, logicalName, hdl, INVALID_HASH_IDX);
+            }
+#endif
             WP(hdl).name = logicalName;
         }
     }
@@ -880,7 +1249,7 @@ yStrRef wpGetAttribute(yBlkHdl hdl, yWPAttribute attridx)
         case Y_WP_PRODUCTID:    res = WP(hdl).devid; break;
         case Y_WP_NETWORKURL:   res = WP(hdl).url; break;
         case Y_WP_BEACON:       res = (WP(hdl).flags & YWP_BEACON_ON ? 1 : 0); break;
-        case Y_WP_INDEX:        res = WP(hdl).devYdx; break;
+        case Y_WP_INDEX:        res = WP_DEVYDX(hdl); break;
         }
     }
     yLeaveCriticalSection(&yWpMutex);
@@ -908,23 +1277,17 @@ void wpGetLogicalName(yBlkHdl hdl, char *logicalName)
 
 int wpMarkForUnregister(yStrRef serial)
 {
-    yBlkHdl  next;
     yBlkHdl  hdl;
     int      retval=0;
     yEnterCriticalSection(&yWpMutex);
 
-    hdl = yWpListHead;
-    while(hdl != INVALID_BLK_HDL) {
-        next = WP(hdl).nextPtr;
-        if(WP(hdl).serial == serial) {
-            if( (WP(hdl).flags & YWP_MARK_FOR_UNREGISTER)==0 ) {
-                WP(hdl).flags |= YWP_MARK_FOR_UNREGISTER;
-                wpSomethingUnregistered = 1;
-                retval = 1;
-            }
-            break;
+    hdl = wpFindBySerial(serial);
+    if(hdl != INVALID_BLK_HDL) {
+        if( (WP(hdl).flags & YWP_MARK_FOR_UNREGISTER)==0 ) {
+            WP(hdl).flags |= YWP_MARK_FOR_UNREGISTER;
+            wpSomethingUnregistered = 1;
+            retval = 1;
         }
-        hdl = next;
     }
 
 #ifdef  DEBUG_WP
@@ -961,14 +1324,9 @@ int wpGetDevYdx(yStrRef serial)
     int     res = -1;
 
     yEnterCriticalSection(&yWpMutex);
-    hdl = yWpListHead;
-    while(hdl != INVALID_BLK_HDL) {
-        YASSERT(WP(hdl).blkId == YBLKID_WPENTRY);
-        if(WP(hdl).serial == serial) {
-            res = WP(hdl).devYdx;
-            break;
-        }
-        hdl = WP(hdl).nextPtr;
+    hdl = wpFindBySerial(serial);
+    if(hdl != INVALID_BLK_HDL) {
+        res = WP_DEVYDX(hdl);
     }
     yLeaveCriticalSection(&yWpMutex);
 
@@ -983,6 +1341,22 @@ YAPI_DEVICE wpSearchEx(yStrRef strref)
     byname = INVALID_BLK_HDL;
 
     yEnterCriticalSection(&yWpMutex);
+#ifndef MICROCHIP_API
+    if(wpFindBySerial(strref) != INVALID_BLK_HDL) {
+        res = strref;
+    } else if(strref == YSTRREF_EMPTY_STRING || wpIdxSearch(&wpNameIdx, strref, &byname) > 1) {
+        // same logical name on several devices, the last one wins
+        byname = INVALID_BLK_HDL;
+        hdl = yWpListHead;
+        while(hdl != INVALID_BLK_HDL) {
+            if(WP(hdl).name == strref) byname = hdl;
+            hdl = WP(hdl).nextPtr;
+        }
+    }
+    if(res == -1 && byname != INVALID_BLK_HDL) {
+        res = WP(byname).serial;
+    }
+#else
     hdl = yWpListHead;
     while(hdl != INVALID_BLK_HDL) {
         YASSERT(WP(hdl).blkId == YBLKID_WPENTRY);
@@ -996,6 +1370,7 @@ YAPI_DEVICE wpSearchEx(yStrRef strref)
     if(hdl == INVALID_BLK_HDL && byname != INVALID_BLK_HDL) {
         res = WP(byname).serial;
     }
+#endif
     yLeaveCriticalSection(&yWpMutex);
 
     return res;
@@ -1019,6 +1394,15 @@ YAPI_DEVICE wpSearchByNameHash(yStrRef strref)
         return -1;
 
     yEnterCriticalSection(&yWpMutex);
+#ifndef MICROCHIP_API
+    if(strref != YSTRREF_EMPTY_STRING && wpIdxSearch(&wpNameIdx, strref, &hdl) < 2) {
+        if(hdl != INVALID_BLK_HDL) {
+            res = WP(hdl).serial;
+        }
+        yLeaveCriticalSection(&yWpMutex);
+        return res;
+    }
+#endif
     hdl = yWpListHead;
     while(hdl != INVALID_BLK_HDL) {
         YASSERT(WP(hdl).blkId == YBLKID_WPENTRY);
@@ -1095,17 +1479,10 @@ yUrlRef wpGetDeviceUrlRef(YAPI_DEVICE devdesc)
     yUrlRef  urlref = INVALID_HASH_IDX;
 
     yEnterCriticalSection(&yWpMutex);
-
-    hdl = yWpListHead;
-    while(hdl != INVALID_BLK_HDL) {
-        YASSERT(WP(hdl).blkId == YBLKID_WPENTRY);
-        if(WP(hdl).serial == (u16)devdesc) {
-            urlref=WP(hdl).url;
-            break;
-        }
-        hdl = WP(hdl).nextPtr;
+    hdl = wpFindBySerial((u16)devdesc);
+    if(hdl != INVALID_BLK_HDL) {
+        urlref = WP(hdl).url;
     }
-
     yLeaveCriticalSection(&yWpMutex);
 
     return urlref;
@@ -1121,16 +1498,11 @@ int wpGetDeviceUrl(YAPI_DEVICE devdesc, char *roothubserial, char *request, int
     int      fullsize, len,idx;
 
     yEnterCriticalSection(&yWpMutex);
-    hdl = yWpListHead;
-    while(hdl != INVALID_BLK_HDL) {
-        YASSERT(WP(hdl).blkId == YBLKID_WPENTRY);
-        if(WP(hdl).serial == (u16)devdesc) {
-            hubref = WP(hdl).url;
-            // store device serial;
-            strref = WP(hdl).serial;
-            break;
-        }
-        hdl = WP(hdl).nextPtr;
+    hdl = wpFindBySerial((u16)devdesc);
+    if(hdl != INVALID_BLK_HDL) {
+        hubref = WP(hdl).url;
+        // store device serial;
+        strref = WP(hdl).serial;
     }
     yLeaveCriticalSection(&yWpMutex);
     if(hubref == INVALID_HASH_IDX)
@@ -1212,22 +1584,15 @@ int wpGetDeviceInfo(YAPI_DEVICE devdesc, u16 *deviceid, char *productname, char
     yBlkHdl  hdl;
 
     yEnterCriticalSection(&yWpMutex);
-
-    hdl = yWpListHead;
-    while(hdl != INVALID_BLK_HDL) {
-        YASSERT(WP(hdl).blkId == YBLKID_WPENTRY);
-        if(WP(hdl).serial == (u16)devdesc) {
-            // entry found
-            if(deviceid)    *deviceid = WP(hdl).devid;
-            if(productname) yHashGetStr(WP(hdl).product, productname, YOCTO_PRODUCTNAME_LEN);
-            if(serial)      yHashGetStr(WP(hdl).serial, serial, YOCTO_SERIAL_LEN);
-            if(logicalname) yHashGetStr(WP(hdl).name, logicalname, YOCTO_LOGICAL_LEN);
-            if(beacon)      *beacon = (WP(hdl).flags & YWP_BEACON_ON ? 1 : 0);
-            break;
-        }
-        hdl = WP(hdl).nextPtr;
+    hdl = wpFindBySerial((u16)devdesc);
+    if(hdl != INVALID_BLK_HDL) {
+        // entry found
+        if(deviceid)    *deviceid = WP(hdl).devid;
+        if(productname) yHashGetStr(WP(hdl).product, productname, YOCTO_PRODUCTNAME_LEN);
+        if(serial)      yHashGetStr(WP(hdl).serial, serial, YOCTO_SERIAL_LEN);
+        if(logicalname) yHashGetStr(WP(hdl).name, logicalname, YOCTO_LOGICAL_LEN);
+        if(beacon)      *beacon = (WP(hdl).flags & YWP_BEACON_ON ? 1 : 0);
     }
-
     yLeaveCriticalSection(&yWpMutex);
 
     return (hdl != INVALID_BLK_HDL ? 0 : -1);
@@ -1239,7 +1604,8 @@ int wpGetDeviceInfo(YAPI_DEVICE devdesc, u16 *deviceid, char *productname, char
 //   Yellow pages support
 // =======================================================================
 
-// return 1 on change 0 if value are the same as the cache
+// return 1 on change 0 if value are the same as the cache,
+// -1 if the function is dropped because the string table is full
 int ypRegister(yStrRef categ, yStrRef serial, yStrRef funcId, yStrRef funcName, int funClass, int funYdx, const char *funcVal)
 {
     yBlkHdl  prev = INVALID_BLK_HDL;
@@ -1250,6 +1616,10 @@ int ypRegister(yStrRef categ, yStrRef serial, yStrRef funcId, yStrRef funcName,
     int      devYdx, changed=0;
     const u16 *funcValWords = (const u16 *)funcVal;
 
+    if(categ == INVALID_HASH_IDX || serial == INVALID_HASH_IDX || funcId == INVALID_HASH_IDX) {
+        // yHashPutStr already logged that the table is full
+        return -1;
+    }
     yEnterCriticalSection(&yYpMutex);
 
     // locate category node
@@ -1276,6 +1646,16 @@ int ypRegister(yStrRef categ, yStrRef serial, yStrRef funcId, yStrRef funcName,
 
     // locate entry node
     prev = INVALID_BLK_HDL;
+#ifndef MICROCHIP_API
+    ypIdxSearch(&ypHwIdx, YIDX_KEY(serial, funcId), categ, 0, &hdl);
+    if(hdl == INVALID_BLK_HDL) {
+        // new entry, locate the end of the list
+        prev = YC(cat_hdl).entries;
+        while(prev != INVALID_BLK_HDL && YP(prev).nextPtr != INVALID_BLK_HDL) {
+            prev = YP(prev).nextPtr;
+        }
+    }
+#else
     hdl = YC(cat_hdl).entries;
     while(hdl != INVALID_BLK_HDL) {
         YASSERT(YP(hdl).blkId >= YBLKID_YPENTRY && YP(hdl).blkId <= YBLKID_YPENTRYEND);
@@ -1283,6 +1663,7 @@ int ypRegister(yStrRef categ, yStrRef serial, yStrRef funcId, yStrRef funcName,
         prev = hdl;
         hdl = YP(prev).nextPtr;
     }
+#endif
     if(hdl == INVALID_BLK_HDL) {
         changed = 1; // new entry-> changed
         hdl = yBlkAlloc();
@@ -1302,10 +1683,21 @@ int ypRegister(yStrRef categ, yStrRef serial, yStrRef funcId, yStrRef funcName,
         } else {
             YP(prev).nextPtr = hdl;
         }
+#ifndef MICROCHIP_API
+        yIdxAdd(&ypHwIdx, YIDX_KEY(serial, funcId), hdl, categ);
+#endif
     }
     if(funcName != INVALID_HASH_IDX)  {
         if(YP(hdl).funcName != funcName){
             changed=1;
+#ifndef MICROCHIP_API
+            if(YP(hdl).funcName != YSTRREF_EMPTY_STRING) {
+                yIdxRemove(&ypNameIdx, YP(hdl).funcName, hdl);
+            }
+            if(funcName != YSTRREF_EMPTY_STRING) {
+                yIdxAdd(&ypNameIdx, funcName, hdl, categ);
+            }
+#endif
             YP(hdl).funcName = funcName;
         }
     }
@@ -1382,7 +1774,7 @@ int ypRegister(yStrRef categ, yStrRef serial, yStrRef funcId, yStrRef funcName,
 
 // return 1 on change 0 if value are the same as the cache
 // WARNING: funcVal MUST BE WORD-ALIGNED
-int ypRegisterByYdx(u8 devYdx, Notification_funydx funInfo, const char *funcVal, YAPI_FUNCTION *fundesc)
+int ypRegisterByYdx(u16 devYdx, Notification_funydx funInfo, const char *funcVal, YAPI_FUNCTION *fundesc)
 {
     yBlkHdl  hdl;
     u16      i;
@@ -1393,7 +1785,7 @@ int ypRegisterByYdx(u8 devYdx, Notification_funydx funInfo, const char *funcVal,
     yEnterCriticalSection(&yYpMutex);
 
     // Ignore unknown devYdx
-    if(devYdxPtr[devYdx] != INVALID_BLK_HDL) {
+    if(devYdx < NB_MAX_DEVICES && devYdxPtr[devYdx] != INVALID_BLK_HDL) {
         hdl = funYdxPtr[devYdx];
         while(hdl != INVALID_BLK_HDL && funYdx >= 6) {
 //          YASSERT(YA(hdl).blkId == YBLKID_YPARRAY);
@@ -1437,7 +1829,7 @@ int ypRegisterByYdx(u8 devYdx, Notification_funydx funInfo, const char *funcVal,
 
 // return -1 on error
 // WARNING: funcVal MUST BE WORD-ALIGNED
-int     ypGetAttributesByYdx(u8 devYdx, u8 funYdx, yStrRef *serial, yStrRef *logicalName, yStrRef *funcId, yStrRef *funcName, Notification_funydx *funcInfo, char *funcVal)
+int     ypGetAttributesByYdx(u16 devYdx, u8 funYdx, yStrRef *serial, yStrRef *logicalName, yStrRef *funcId, yStrRef *funcName, Notification_funydx *funcInfo, char *funcVal)
 {
     yBlkHdl  hdl;
     u16      i;
@@ -1447,7 +1839,7 @@ int     ypGetAttributesByYdx(u8 devYdx, u8 funYdx, yStrRef *serial, yStrRef *log
     yEnterCriticalSection(&yYpMutex);
 
     // Ignore unknown devYdx
-    if (devYdxPtr[devYdx] != INVALID_BLK_HDL) {
+    if (devYdx < NB_MAX_DEVICES && devYdxPtr[devYdx] != INVALID_BLK_HDL) {
         if (logicalName) {
             hdl = devYdxPtr[devYdx];
             *logicalName = WP(hdl).name;
@@ -1575,6 +1967,12 @@ static void ypUnregister(yStrRef serial)
                 } else {
                     YP(prev).nextPtr = next;
                 }
+#ifndef MICROCHIP_API
+                yIdxRemove(&ypHwIdx, YIDX_KEY(serial, YP(hdl).funcId), hdl);
+                if(YP(hdl).funcName != YSTRREF_EMPTY_STRING) {
+                    yIdxRemove(&ypNameIdx, YP(hdl).funcName, hdl);
+                }
+#endif
                 yBlkFree(hdl);
                 // continue search on next entries
             } else {
@@ -1594,7 +1992,7 @@ YAPI_FUNCTION ypSearch(const char *class_str, const char *func_or_name)
 {
     yStrRef     categref = INVALID_HASH_IDX;
     yStrRef     devref, funcref;
-    yBlkHdl     cat_hdl, hdl, byname;
+    yBlkHdl     cat_hdl, hdl;
     int         abstract = 0;
     const char  *dotpos = func_or_name;
     char        categname[HASH_BUF_SIZE];
@@ -1632,7 +2030,12 @@ YAPI_FUNCTION ypSearch(const char *class_str, const char *func_or_name)
         if(funcref == INVALID_HASH_IDX)
             return -1;
         yEnterCriticalSection(&yYpMutex);
-        if(categref != INVALID_HASH_IDX) {
+        if(funcref != YSTRREF_EMPTY_STRING && ypIdxSearch(&ypNameIdx, funcref, categref, abstract, &hdl) < 2) {
+            // zero or one function with this name, no need to scan
+            if(hdl != INVALID_BLK_HDL) {
+                res = YP(hdl).hwId;
+            }
+        } else if(categref != INVALID_HASH_IDX) {
             // search within defined function category
             hdl = YC(cat_hdl).entries;
             while(hdl != INVALID_BLK_HDL) {
@@ -1686,26 +2089,19 @@ YAPI_FUNCTION ypSearch(const char *class_str, const char *func_or_name)
 
     if(devref!= INVALID_HASH_IDX){
         // locate function identified by devref.funcref by first resolving devref
-        byname = INVALID_BLK_HDL;
-        yEnterCriticalSection(&yWpMutex);
-        hdl = yWpListHead;
-        while(hdl != INVALID_BLK_HDL) {
-            YASSERT(WP(hdl).blkId == YBLKID_WPENTRY);
-            if(WP(hdl).serial == devref) break;
-            if(WP(hdl).name == devref) byname = hdl;
-            hdl = WP(hdl).nextPtr;
-        }
-        yLeaveCriticalSection(&yWpMutex);
-        if(hdl == INVALID_BLK_HDL) {
-            if(byname == INVALID_BLK_HDL)
-                return -1;
-            // device found by logicalname
-            devref = WP(byname).serial;
-        }
+        YAPI_DEVICE devdesc = wpSearchEx(devref);
+        if(devdesc < 0)
+            return -1;
+        devref = (yStrRef)devdesc;
     }
     // device found, now we can search for function by serial.funcref
     yEnterCriticalSection(&yYpMutex);
-    if(categref != INVALID_HASH_IDX) {
+    if(devref != INVALID_HASH_IDX && ypIdxSearch(&ypHwIdx, YIDX_KEY(devref, funcref), categref, abstract, &hdl) < 2) {
+        // direct lookup by hardware id
+        if(hdl != INVALID_BLK_HDL) {
+            res = YP(hdl).hwId;
+        }
+    } else if(categref != INVALID_HASH_IDX) {
         // search within defined function category
         hdl = YC(cat_hdl).entries;
         while(hdl != INVALID_BLK_HDL) {
@@ -1834,6 +2230,9 @@ static yBlkHdl functionSearch(YAPI_FUNCTION fundesc)
     if(categref == INVALID_HASH_IDX)
         return INVALID_BLK_HDL; // no device of this type so far, should never happen
 
+    if(ypIdxSearch(&ypHwIdx, (u32)fundesc, categref, 0, &hdl) < 2) {
+        return hdl;
+    }
     cat_hdl = yYpListHead;
     while(cat_hdl != INVALID_BLK_HDL) {
         YASSERT(YC(cat_hdl).blkId == YBLKID_YPCATEG);
@@ -55,8 +55,15 @@ extern "C" {
 #define NB_MAX_HASH_ENTRIES 1023     /* keep hash table size <32KB on Yocto-Hub */
 #define NB_MAX_DEVICES        80     /* base hub + up to 15 shields (up to 4 slave ports) */
 #else
-#define NB_MAX_HASH_ENTRIES 8192
-#define NB_MAX_DEVICES       256
+// A yHash is an s16 and two yStrRef are packed in a YAPI_FUNCTION (s32), so the
+// table cannot grow beyond 32768 slots without changing the API. The last
+// NB_HASH_BLK_RESERVE slots are kept for the white and yellow pages blocks:
+// once the strings have used all the others, yHashPutStr returns INVALID_HASH_IDX.
+#define NB_MAX_HASH_ENTRIES 32768    /* upper bound of a yHash (s16), the table grows by chunks */
+#define NB_HASH_BLK_RESERVE  4096
+#define HASH_CHUNK_POW        10
+#define HASH_CHUNK_SIZE     (1 << HASH_CHUNK_POW)
+#define NB_MAX_DEVICES      2048     /* two devices per hub for NBMAX_NET_HUB hubs, see yWhitePageEntry */
 #endif
 
 #define YSTRREF_EMPTY_STRING   0x00ff /* yStrRef value for the empty string    */
@@ -89,6 +96,8 @@ typedef enum {
 #define YBLKID_YPENTRY    0xf3
 #define YBLKID_YPENTRYEND (YBLKID_YPENTRY+YOCTO_N_BASECLASSES-1)
 
+// The low byte of devYdx is in the common block header, the high byte
+// uses the room left by the flags, so that the entry still fits a block
 typedef struct {
     u8          devYdx;
     u8          blkId;
@@ -98,7 +107,8 @@ typedef struct {
     yStrRef     product;
     u16         devid;
     yUrlRef     url;
-    u16         flags;
+    u8          flags;
+    u8          devYdxHi;
 } yWhitePageEntry;
 
 // WP entry flags
@@ -264,9 +274,9 @@ int     ypGetFunctionsEx(yStrRef categref, YAPI_DEVICE devdesc, YAPI_FUNCTION pr
 int     wpGetDeviceInfo(YAPI_DEVICE devdesc, u16 *deviceid, char *productname, char *serial, char *logicalname, u8 *beacon);
 int     ypRegister(yStrRef categ, yStrRef serial, yStrRef funcId, yStrRef funcName, int funClass, int funYdx, const char *funcVal);
 // WARNING: funcVal MUST BE WORD-ALIGNED
-int     ypRegisterByYdx(u8 devYdx, Notification_funydx funInfo, const char *funcVal, YAPI_FUNCTION *fundesc);
+int     ypRegisterByYdx(u16 devYdx, Notification_funydx funInfo, const char *funcVal, YAPI_FUNCTION *fundesc);
 // WARNING: funcVal MUST BE WORD-ALIGNED
-int     ypGetAttributesByYdx(u8 devYdx, u8 funYdx, yStrRef *serial, yStrRef *logicalName, yStrRef *funcId, yStrRef *funcName, Notification_funydx *funcInfo, char *funcVal);
+int     ypGetAttributesByYdx(u16 devYdx, u8 funYdx, yStrRef *serial, yStrRef *logicalName, yStrRef *funcId, yStrRef *funcName, Notification_funydx *funcInfo, char *funcVal);
 void    ypGetCategory(yBlkHdl hdl, char *name, yBlkHdl *entries);
 int     ypGetAttributes(yBlkHdl hdl, yStrRef *serial, yStrRef *funcId, yStrRef *funcName, Notification_funydx *funcInfo, char *funcVal);
 int     ypGetType(yBlkHdl hdl);
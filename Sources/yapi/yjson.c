@@ -80,6 +80,77 @@ const char* yJsonStateStr[] = {
 };
 #endif
 
+#ifndef YAPI_IN_YDEVICE
+// Host-side fast paths: string bodies are copied by blocks, and containers
+// marked for skipping are jumped over without tokenizing their content.
+// The scans are plain byte loops: in api.json the structural characters
+// are a few bytes apart, too close for 16-byte SIMD scans to pay off.
+#define YJSON_FAST_SCAN
+
+// Return a pointer to the first double-quote or backslash in [src,end), or end
+static _FAR const char* yJsonScanString(_FAR const char *src, _FAR const char *end)
+{
+    while (src < end && *src != '"' && *src != '\\') src++;
+    return src;
+}
+
+// Return a pointer to the first double-quote or bracket in [src,end), or end.
+// Setting bit 5 maps '[' to '{' and ']' to '}', so two compares cover all four.
+static _FAR const char* yJsonScanStructural(_FAR const char *src, _FAR const char *end)
+{
+    while (src < end) {
+        char c = *src | 0x20;
+        if (*src == '"' || c == '{' || c == '}') break;
+        src++;
+    }
+    return src;
+}
+
+// Find the bracket that closes the container the parser has just entered,
+// at stack depth <depth>. Returns NULL when that bracket is not within the
+// available input or when nesting would exceed YJSON_MAX_DEPTH, in which
+// case the caller falls back to the regular token-by-token skip.
+static _FAR const char* yJsonFindContainerEnd(_FAR const char *src, _FAR const char *end, int depth, int maxname)
+{
+    _FAR const char *start;
+    int level = depth, escaped;
+
+    while (1) {
+        src = yJsonScanStructural(src, end);
+        if (src >= end) return NULL;
+        switch (*src) {
+        case '"':
+            start = ++src;
+            escaped = 0;
+            while (1) {
+                src = yJsonScanString(src, end);
+                if (src >= end) return NULL;
+                if (*src == '"') break;
+                src += 2; // skip backslash and quoted character
+                escaped = 1;
+            }
+            if (escaped || src - start >= maxname) {
+                // member names are parsed without escapes and within the
+                // token buffer: let the regular parser handle this one
+                _FAR const char *next = src + 1;
+                while (next < end && (*next == ' ' || *next == '\r' || *next == '\n')) next++;
+                if (next >= end || *next == ':') return NULL;
+            }
+            break;
+        case '{':
+        case '[':
+            if (level >= YJSON_MAX_DEPTH) return NULL;
+            level++;
+            break;
+        default:
+            if (--level < depth) return src;
+            break;
+        }
+        src++;
+    }
+}
+#endif
+
 yJsonRetCode yJsonParse(yJsonStateMachine *j)
 {
     yJsonRetCode    res;
@@ -215,10 +286,21 @@ skip:
                 goto token_done;
             case YJSON_PARSE_STRING:     // parsing a quoted string
             case YJSON_PARSE_STRINGCONT: // parsing the continuation of a quoted string
+#ifdef YJSON_FAST_SCAN
+                {
+                    _FAR const char *lim = (end - src > ept - pt ? src + (ept - pt) : end);
+                    _FAR const char *stop = yJsonScanString(src, lim);
+                    memcpy(pt, src, stop - src);
+                    pt += stop - src;
+                    src = stop;
+                    if (src < lim) c = *src;
+                }
+#else
                 while(src < end && pt < ept && (c = *src) != '"' && c != '\\') {
                     *pt++ = c;
                     src++;
                 }
+#endif
                 if(src >= end) goto done;
                 if(pt >= ept) {
                     *pt = 0;
@@ -351,10 +433,23 @@ done:
             goto skip;
         }
         if(j->skipcnt > 0) {
+            j->skipcnt--;
             if(st == YJSON_PARSE_STRUCT || st == YJSON_PARSE_ARRAY) {
+#ifdef YJSON_FAST_SCAN
+                if (j->token[0] == '{' || j->token[0] == '[') {
+                    _FAR const char *close = yJsonFindContainerEnd(src, end, j->depth, (int)(ept - j->token));
+                    if (close) {
+                        // same outcome as parsing up to the closing bracket
+                        src = close + 1;
+                        j->depth--;
+                        j->next = YJSON_PARSE_DONE;
+                        pt = j->token;
+                        goto skip;
+                    }
+                }
+#endif
                 j->skipdepth = j->depth-1;
             }
-            j->skipcnt--;
             goto skip;
         }
     }
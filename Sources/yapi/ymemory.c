@@ -370,23 +370,108 @@ int yvsprintf_s (char *dst, unsigned dstsize, const char * fmt, va_list arg )
     return len;
 }
 
-int ymemfind(const u8 *haystack, u32 haystack_len, const u8 *needle, u32 needle_len)
+// SSE2 is part of the x86-64 baseline, so no runtime dispatch is needed to
+// use it. Other targets rely on memchr, which the C library already
+// vectorizes for the host CPU.
+#if !defined(YMEMFIND_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define YMEMFIND_SSE2
+#include <emmintrin.h>
+#endif
+
+#define YFOLDCASE(c)    ((c) >= 'a' && (c) <= 'z' ? (u8)((c) - 32) : (c))
+
+int ymemequal(const u8 *a, const u8 *b, u32 len, u8 bTextCompare)
 {
-    u32 abspos = 0;
-    u32 needle_pos = 0;
+    u32 i;
 
-    do {
-        while (needle_pos < needle_len && (abspos + needle_pos)<haystack_len && needle[needle_pos] == haystack[abspos + needle_pos]) {
-            needle_pos++;
+    if (!bTextCompare) {
+        return memcmp(a, b, len) == 0;
+    }
+    for (i = 0; i < len; i++) {
+        if (YFOLDCASE(a[i]) != YFOLDCASE(b[i])) {
+            return 0;
         }
-        if (needle_pos == needle_len) {
-            return abspos;
-        } else {
+    }
+    return 1;
+}
+
+int ymemfindEx(const u8 *haystack, u32 haystack_len, const u8 *needle, u32 needle_len, u8 bTextCompare)
+{
+    u32 abspos = 0, lastpos;
+    u8  first, last;
+
+    if (needle_len == 0) {
+        return 0;
+    }
+    if (needle_len > haystack_len) {
+        return -1;
+    }
+    lastpos = haystack_len - needle_len;
+    first = needle[0];
+    last = needle[needle_len - 1];
+#ifdef YMEMFIND_SSE2
+    {
+        // compare the first and last pattern bytes against 16 candidate
+        // positions at once, and verify the full pattern only on a hit
+        u8 first_alt = first, last_alt = last;
+        __m128i vfirst, vfirst_alt, vlast, vlast_alt;
+
+        if (bTextCompare) {
+            first = YFOLDCASE(first);
+            last = YFOLDCASE(last);
+            first_alt = (first >= 'A' && first <= 'Z' ? first + 32 : first);
+            last_alt = (last >= 'A' && last <= 'Z' ? last + 32 : last);
+        }
+        vfirst = _mm_set1_epi8((char)first);
+        vfirst_alt = _mm_set1_epi8((char)first_alt);
+        vlast = _mm_set1_epi8((char)last);
+        vlast_alt = _mm_set1_epi8((char)last_alt);
+        while (abspos + 16 <= lastpos + 1) {
+            __m128i blkfirst = _mm_loadu_si128((const __m128i*)(haystack + abspos));
+            __m128i blklast = _mm_loadu_si128((const __m128i*)(haystack + abspos + needle_len - 1));
+            __m128i eqfirst = _mm_or_si128(_mm_cmpeq_epi8(blkfirst, vfirst), _mm_cmpeq_epi8(blkfirst, vfirst_alt));
+            __m128i eqlast = _mm_or_si128(_mm_cmpeq_epi8(blklast, vlast), _mm_cmpeq_epi8(blklast, vlast_alt));
+            u32 mask = (u32)_mm_movemask_epi8(_mm_and_si128(eqfirst, eqlast));
+            u32 bit = 0;
+            while (mask) {
+                if ((mask & 1) && ymemequal(haystack + abspos + bit, needle, needle_len, bTextCompare)) {
+                    return (int)(abspos + bit);
+                }
+                mask >>= 1;
+                bit++;
+            }
+            abspos += 16;
+        }
+    }
+#else
+    if (!bTextCompare) {
+        while (abspos <= lastpos) {
+            const u8 *ptr = (const u8*)memchr(haystack + abspos, first, lastpos - abspos + 1);
+            if (ptr == NULL) {
+                return -1;
+            }
+            abspos = (u32)(ptr - haystack);
+            if (haystack[abspos + needle_len - 1] == last && memcmp(ptr, needle, needle_len) == 0) {
+                return (int)abspos;
+            }
             abspos++;
-            needle_pos = 0;
         }
-    } while (abspos + needle_len < haystack_len);
+        return -1;
+    }
+    first = YFOLDCASE(first);
+#endif
+    // remaining positions (or case-insensitive search without SIMD)
+    for (; abspos <= lastpos; abspos++) {
+        if (YFOLDCASE(haystack[abspos]) == YFOLDCASE(first) && ymemequal(haystack + abspos, needle, needle_len, bTextCompare)) {
+            return (int)abspos;
+        }
+    }
     return -1;
 }
 
+int ymemfind(const u8 *haystack, u32 haystack_len, const u8 *needle, u32 needle_len)
+{
+    return ymemfindEx(haystack, haystack_len, needle, needle_len, 0);
+}
+
 
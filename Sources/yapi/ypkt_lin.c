@@ -449,42 +449,56 @@ static void rd_callback(struct libusb_transfer *transfer);
 static void wr_callback(struct libusb_transfer *transfer);
 
 
+// Submit as many queued packets as there are free write transfers.
+// The packets stay in txQueue until their transfer completes, and the
+// first wrCount packets of the queue are always the ones in flight.
 static int sendNextPkt(yInterfaceSt *iface, char *errmsg)
 {
     pktItem *pktitem;
-    yPktQueuePeekH2D(iface, &pktitem);
-    if (pktitem != NULL) {
-        int res;
-        memcpy(&iface->wrTr->tmppkt, &pktitem->pkt, sizeof(USB_Packet));
-        libusb_fill_interrupt_transfer( iface->wrTr->tr,
+    linRdTr *lintr;
+    int      res = YAPI_SUCCESS;
+
+    yEnterCriticalSection(&iface->wrCS);
+    while (iface->wrCount < NB_LINUX_USB_WR_TR) {
+        yPktQueuePeekNthH2D(iface, iface->wrCount, &pktitem);
+        if (pktitem == NULL) {
+            break;
+        }
+        lintr = &iface->wrTr[(iface->wrHead + iface->wrCount) % NB_LINUX_USB_WR_TR];
+        memcpy(&lintr->tmppkt, &pktitem->pkt, sizeof(USB_Packet));
+        libusb_fill_interrupt_transfer( lintr->tr,
                                 iface->hdl,
                                 iface->wrendp,
-                                (u8*)&iface->wrTr->tmppkt,
+                                (u8*)&lintr->tmppkt,
                                 sizeof(USB_Packet),
                                 wr_callback,
-                                iface->wrTr,
+                                lintr,
                                 1000);
-        res = libusb_submit_transfer(iface->wrTr->tr);
+        res = libusb_submit_transfer(lintr->tr);
         if (res < 0) {
-            return yLinSetErr("libusb_submit_transfer(WR) failed", res, errmsg);
+            res = yLinSetErr("libusb_submit_transfer(WR) failed", res, errmsg);
+            break;
         }
+        iface->wrCount++;
     }
-    return YAPI_SUCCESS;
+    yLeaveCriticalSection(&iface->wrCS);
+    return res;
 }
 
 
-static int submitReadPkt(yInterfaceSt *iface, char *errmsg)
+static int submitReadPkt(linRdTr *lintr, char *errmsg)
 {
     int res;
-    libusb_fill_interrupt_transfer( iface->rdTr->tr,
+    yInterfaceSt *iface = lintr->iface;
+    libusb_fill_interrupt_transfer( lintr->tr,
                                     iface->hdl,
                                     iface->rdendp,
-                                    (u8*)&iface->rdTr->tmppkt,
+                                    (u8*)&lintr->tmppkt,
                                     sizeof(USB_Packet),
                                     rd_callback,
-                                    iface->rdTr,
+                                    lintr,
                                     0);
-    res = libusb_submit_transfer(iface->rdTr->tr);
+    res = libusb_submit_transfer(lintr->tr);
     if (res < 0) {
         return yLinSetErr("libusb_submit_transfer(RD) failed", res, errmsg);
     }
@@ -512,6 +526,7 @@ static void rd_callback(struct libusb_transfer *transfer)
     case LIBUSB_TRANSFER_COMPLETED:
         //HALLOG("%s:%d pkt_arrived (len=%d)\n",iface->serial,iface->ifaceno,transfer->actual_length);
         yPktQueuePushD2H(iface,&lintr->tmppkt,NULL);
+        ySetEvent(&yContext->exitSleepEvent);
         break;
     case LIBUSB_TRANSFER_ERROR:
         iface->ioError++;
@@ -524,6 +539,7 @@ static void rd_callback(struct libusb_transfer *transfer)
         HALLOG("CBrd:%s pkt_cancelled (len=%d) \n",iface->serial, transfer->actual_length);
         if (iface->flags.yyySetupDone && transfer->actual_length == 64) {
             yPktQueuePushD2H(iface, &lintr->tmppkt, NULL);
+            ySetEvent(&yContext->exitSleepEvent);
         }
         return;
     case LIBUSB_TRANSFER_STALL:
@@ -544,8 +560,10 @@ static void rd_callback(struct libusb_transfer *transfer)
         return;
     }
 
+    // transfers of the same endpoint complete in order, so resubmitting
+    // at the end of the ring preserves the packet order
     if (iface->flags.yyySetupDone) {
-        res = submitReadPkt(iface, errmsg);
+        res = submitReadPkt(lintr, errmsg);
         if (res < 0) {
             HALLOG("CBrd:%s libusb_submit_transfer errror %X\n", iface->serial, res);
         }
@@ -553,12 +571,28 @@ static void rd_callback(struct libusb_transfer *transfer)
 
 }
 
+// release the oldest write transfer and the packet it was sending
+static void releaseWritePkt(yInterfaceSt *iface)
+{
+    pktItem *pktitem;
+
+    yEnterCriticalSection(&iface->wrCS);
+    if (iface->wrCount > 0) {
+        yPktQueuePopH2D(iface, &pktitem);
+        if (pktitem) {
+            yPktQueueReleaseH2D(iface, pktitem);
+        }
+        iface->wrHead = (iface->wrHead + 1) % NB_LINUX_USB_WR_TR;
+        iface->wrCount--;
+    }
+    yLeaveCriticalSection(&iface->wrCS);
+}
+
 static void wr_callback(struct libusb_transfer *transfer)
 {
     linRdTr      *lintr = (linRdTr*)transfer->user_data;
     yInterfaceSt *iface = lintr->iface;
     char          errmsg[YOCTO_ERRMSG_LEN];
-    pktItem *pktitem;
 
     if (lintr == NULL) {
         HALLOG("CBwr:drop invalid ypkt wr_callback (lintr is null)\n");
@@ -575,8 +609,7 @@ static void wr_callback(struct libusb_transfer *transfer)
     case LIBUSB_TRANSFER_COMPLETED:
         //HALLOG("CBwr:%s pkt_sent (len=%d)\n",iface->serial, transfer->actual_length);
         // remove sent packet
-        yPktQueuePopH2D(iface, &pktitem);
-        yFree(pktitem);
+        releaseWritePkt(iface);
         sendNextPkt(iface, errmsg);
         return;
     case LIBUSB_TRANSFER_ERROR:
@@ -594,6 +627,7 @@ static void wr_callback(struct libusb_transfer *transfer)
         break;
     case LIBUSB_TRANSFER_NO_DEVICE:
         HALLOG("CBwr:%s pkt_cancelled (len=%d)\n",iface->serial, transfer->actual_length);
+        releaseWritePkt(iface);
         return;
     case LIBUSB_TRANSFER_OVERFLOW:
         HALLOG("CBwr:%s pkt_overflow (len=%d)\n",iface->serial, transfer->actual_length);
@@ -602,6 +636,15 @@ static void wr_callback(struct libusb_transfer *transfer)
         HALLOG("CBwr:%s unknown state %X\n",iface->serial, transfer->status);
         break;
     }
+    // the packet cannot be retried, the following ones may already be in
+    // flight: put the queue in error so that the sender sees the failure
+    // (as the Windows I/O thread does), before the packet is released
+    if (iface->flags.yyySetupDone) {
+        YSPRINTF(errmsg, YOCTO_ERRMSG_LEN, "%s:%d USB write failed (status %d)",
+                 iface->serial, iface->ifaceno, transfer->status);
+        yPktQueueSetError(&iface->txQueue, YAPI_IO_ERROR, errmsg);
+    }
+    releaseWritePkt(iface);
 }
 
 
@@ -673,18 +716,27 @@ int yyySetup(yInterfaceSt *iface,char *errmsg)
 
     yPktQueueInit(&iface->rxQueue);
     yPktQueueInit(&iface->txQueue);
-    iface->rdTr = yMalloc(sizeof(linRdTr));
-    iface->wrTr = yMalloc(sizeof(linRdTr));
-    HALLOG("allocate linRdTr=%p linWrTr\n", iface->rdTr, iface->wrTr);
-    iface->wrTr->iface = iface;
-    iface->wrTr->tr = libusb_alloc_transfer(0);
-    iface->rdTr->iface = iface;
-    iface->rdTr->tr = libusb_alloc_transfer(0);
+    yInitializeCriticalSection(&iface->wrCS);
+    iface->wrHead = 0;
+    iface->wrCount = 0;
+    iface->rdTr = yMalloc(sizeof(linRdTr) * NB_LINUX_USB_TR);
+    iface->wrTr = yMalloc(sizeof(linRdTr) * NB_LINUX_USB_WR_TR);
+    HALLOG("allocate linRdTr=%p linWrTr=%p\n", iface->rdTr, iface->wrTr);
+    for (j = 0; j < NB_LINUX_USB_WR_TR; j++) {
+        iface->wrTr[j].iface = iface;
+        iface->wrTr[j].tr = libusb_alloc_transfer(0);
+    }
+    for (j = 0; j < NB_LINUX_USB_TR; j++) {
+        iface->rdTr[j].iface = iface;
+        iface->rdTr[j].tr = libusb_alloc_transfer(0);
+    }
     iface->flags.yyySetupDone = 1;
-    HALLOG("%s both libusbTR allocated (%p /%p)\n",iface->serial, iface->rdTr->tr, iface->wrTr->tr);
-    res = submitReadPkt(iface, errmsg);
-    if (res < 0) {
-        return res;
+    HALLOG("%s %d+%d libusbTR allocated\n",iface->serial, NB_LINUX_USB_TR, NB_LINUX_USB_WR_TR);
+    for (j = 0; j < NB_LINUX_USB_TR; j++) {
+        res = submitReadPkt(&iface->rdTr[j], errmsg);
+        if (res < 0) {
+            return res;
+        }
     }
     HALLOG("%s yyySetup done\n",iface->serial);
 
@@ -707,19 +759,30 @@ int yyySignalOutPkt(yInterfaceSt *iface, char *errmsg)
 void yyyPacketShutdown(yInterfaceSt  *iface)
 {
     if (iface && iface->hdl) {
-        int res;
+        int res, i;
         iface->flags.yyySetupDone = 0;
         HALLOG("%s:%d cancel all transfer\n",iface->serial,iface->ifaceno);
-        if (iface->rdTr->tr) {
-            int count = 10;
-            int res =libusb_cancel_transfer(iface->rdTr->tr);
-            if(res == 0){
-                while(count && iface->rdTr->tr->status != LIBUSB_TRANSFER_CANCELLED){
+        for (i = 0; i < NB_LINUX_USB_TR; i++) {
+            linRdTr *lintr = &iface->rdTr[i];
+            if (lintr->tr) {
+                int count = 10;
+                int res =libusb_cancel_transfer(lintr->tr);
+                if(res == 0){
+                    while(count && lintr->tr->status != LIBUSB_TRANSFER_CANCELLED){
                         usleep(1000);
-                    count--;
+                        count--;
+                    }
                 }
             }
         }
+        for (i = 0; i < NB_LINUX_USB_WR_TR; i++) {
+            if (iface->wrTr[i].tr) {
+                libusb_cancel_transfer(iface->wrTr[i].tr);
+            }
+        }
+        for (i = 10; i > 0 && iface->wrCount > 0; i--) {
+            usleep(1000);
+        }
         HALLOG("%s:%d libusb relase iface\n",iface->serial,iface->ifaceno);
         res = libusb_release_interface(iface->hdl,iface->ifaceno);
         if(res != 0 && res!=LIBUSB_ERROR_NOT_FOUND && res!=LIBUSB_ERROR_NO_DEVICE){
@@ -733,12 +796,24 @@ void yyyPacketShutdown(yInterfaceSt  *iface)
         libusb_close(iface->hdl);
         iface->hdl = NULL;
 
-        if (iface->rdTr->tr) {
-            HALLOG("%s:%d libusb_TR free\n", iface->serial, iface->ifaceno);
-            libusb_free_transfer(iface->rdTr->tr);
-            iface->rdTr->tr = NULL;
+        HALLOG("%s:%d libusb_TR free\n", iface->serial, iface->ifaceno);
+        for (i = 0; i < NB_LINUX_USB_TR; i++) {
+            if (iface->rdTr[i].tr) {
+                libusb_free_transfer(iface->rdTr[i].tr);
+                iface->rdTr[i].tr = NULL;
+            }
+        }
+        for (i = 0; i < NB_LINUX_USB_WR_TR; i++) {
+            if (iface->wrTr[i].tr) {
+                libusb_free_transfer(iface->wrTr[i].tr);
+                iface->wrTr[i].tr = NULL;
+            }
         }
         yFree(iface->rdTr);
+        yFree(iface->wrTr);
+        iface->rdTr = NULL;
+        iface->wrTr = NULL;
+        yDeleteCriticalSection(&iface->wrCS);
         yPktQueueFree(&iface->rxQueue);
         yPktQueueFree(&iface->txQueue);
     }
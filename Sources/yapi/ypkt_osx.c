@@ -391,6 +391,7 @@ static void Handle_IOHIDDeviceIOHIDReportCallback(
     yInterfaceSt *iface= (yInterfaceSt*) inContext;
     yPktQueuePushD2H(iface,&iface->tmprxpkt,NULL);
     memset(&iface->tmprxpkt,0xff,sizeof(USB_Packet));
+    ySetEvent(&yContext->exitSleepEvent);
 }
 
 
@@ -484,14 +485,14 @@ int yyySignalOutPkt(yInterfaceSt *iface, char *errmsg)
     yPktQueuePopH2D(iface, &pktitem);
     while (pktitem!=NULL){
         if(iface->devref==NULL){
-            yFree(pktitem);
+            yPktQueueReleaseH2D(iface, pktitem);
             return YERR(YAPI_IO_ERROR);
         }
         res = IOHIDDeviceSetReport(iface->devref,
                                    kIOHIDReportTypeOutput,
                                    0, /* Report ID*/
                                    (u8*)&pktitem->pkt, sizeof(USB_Packet));
-        yFree(pktitem);
+        yPktQueueReleaseH2D(iface, pktitem);
         if (res != kIOReturnSuccess) {
             dbglog("IOHIDDeviceSetReport failed with 0x%x\n", res);
             return YERRMSG(YAPI_IO_ERROR,"IOHIDDeviceSetReport failed");;
@@ -884,7 +884,7 @@ static void* yyyUsbIoThread(void* thread_void)
             }
             YASSERT(timeAfterWrite >= 0 && timeAfterWrite < 50);
 #endif
-            yFree(pktItem);
+            yPktQueueReleaseH2D(iface, pktItem);
             yPktQueuePeekH2D(iface, &pktItem);
         }
 
@@ -409,7 +409,7 @@ int ypGetBootloaderReply(BootloaderSt *dev, USB_Packet *pkt,char *errmsg)
     if(ptr){
         yTracePtr(ptr);
         memcpy(pkt,&ptr->pkt,sizeof(USB_Packet));
-        yFree(ptr);
+        yPktQueueReleaseD2H(&dev->iface, ptr);
         return 0;
     }
 	return YAPI_TIMEOUT; // not a fatal error, handled by caller
@@ -427,7 +427,7 @@ int BlockingRead(BootloaderSt *dev,USB_Packet *pkt, int maxwait, char *errmsg)
     if (ptr) {
 	    yTracePtr(ptr);
 		memcpy(pkt,&ptr->pkt,sizeof(USB_Packet));
-		yFree(ptr);
+		yPktQueueReleaseD2H(&dev->iface, ptr);
         return YAPI_SUCCESS;
 	}
 	return YERR(YAPI_TIMEOUT);
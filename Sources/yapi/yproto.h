@@ -245,6 +245,8 @@ YRETCODE ystrncat_s(char *dst, unsigned dstsize,const char *src,unsigned len);
 int ysprintf_s(char *dst, unsigned dstsize,const char *fmt ,...);
 int yvsprintf_s (char *dst, unsigned dstsize, const char * fmt, va_list arg );
 int ymemfind(const u8 *haystack, u32 haystack_len, const u8 *needle, u32 needle_len);
+int ymemfindEx(const u8 *haystack, u32 haystack_len, const u8 *needle, u32 needle_len, u8 bTextCompare);
+int ymemequal(const u8 *a, const u8 *b, u32 len, u8 bTextCompare);
 
 
 //#define DEBUG_YAPI_REQ
@@ -514,10 +516,24 @@ typedef struct _pktItem{
 } pktItem;
 
 
+// Packets are stored in a preallocated ring of slots, filled by a single
+// producer and emptied by a single consumer without lock. A popped packet
+// keeps its slot until it is released (in pop order). When the ring is
+// full, packets are allocated and chained in an overflow list protected
+// by cs, which is drained after the ring.
+#ifndef PKT_QUEUE_SLOTS
+#define PKT_QUEUE_SLOTS     64      // must be a power of two
+#endif
+
 typedef struct {
-    pktItem             *first;
+    pktItem             *ring;
+    volatile u32        head;           // next slot to fill (producer)
+    volatile u32        tail;           // next slot to pop (consumer)
+    volatile u32        released;       // slots before this one can be reused
+    pktItem             *first;         // overflow list
     pktItem             *last;
-    int                 count;
+    u32                 highWater;      // max nb of ring slots in use
+    u64                 totalOverflow;  // nb of packets pushed to the overflow list
     u64                 totalPush;
     u64                 totalPop;
     YRETCODE            status;
@@ -531,6 +547,7 @@ typedef struct {
 void yPktQueueInit(pktQueue  *q);
 void yPktQueueFree(pktQueue  *q);
 void yPktQueueSetError(pktQueue  *q,YRETCODE code, const char * msg);
+void yPktQueueGetStats(pktQueue *q, u32 *highWater, u64 *totalOverflow);
 
 #ifdef OSX_API
 
@@ -550,11 +567,18 @@ typedef struct _uwp_enum_item {
 } uwp_enum_item;
 #endif
 
-#define NBMAX_NET_HUB               32
+#define NBMAX_NET_HUB               1024
 #define NBMAX_USB_DEVICE_CONNECTED  256
 #define WIN_DEVICE_PATH_LEN         512
 #define HTTP_RAW_BUFF_SIZE          (8*1024)
-#define NB_LINUX_USB_TR             1
+// number of interrupt transfers kept in flight per interface on Linux,
+// so that reports are not lost when the event thread is late
+#ifndef NB_LINUX_USB_TR
+#define NB_LINUX_USB_TR             4
+#endif
+#ifndef NB_LINUX_USB_WR_TR
+#define NB_LINUX_USB_WR_TR          2
+#endif
 
 #define YWIN_EVENT_READ     0
 #define YWIN_EVENT_INTERRUPT 1
@@ -590,8 +614,11 @@ typedef struct _yInterfaceSt {
     libusb_device_handle    *hdl;
     u8                      rdendp;
     u8                      wrendp;
-    linRdTr                 *rdTr;
-    linRdTr                 *wrTr;
+    linRdTr                 *rdTr;      // NB_LINUX_USB_TR read transfers
+    linRdTr                 *wrTr;      // NB_LINUX_USB_WR_TR write transfers
+    yCRITICAL_SECTION       wrCS;       // protect wrHead and wrCount
+    int                     wrHead;     // oldest write transfer in flight
+    int                     wrCount;    // nb of write transfers in flight
     int                     ioError;
 #endif
 } yInterfaceSt;
@@ -600,7 +627,10 @@ YRETCODE    yPktQueuePushD2H(yInterfaceSt *iface,const USB_Packet *pkt, char * e
 YRETCODE    yPktQueueWaitAndPopD2H(yInterfaceSt *iface,pktItem **pkt,int ms,char * errmsg);
 YRETCODE    yPktQueuePushH2D(yInterfaceSt *iface,const USB_Packet *pkt, char * errmsg);
 YRETCODE    yPktQueuePeekH2D(yInterfaceSt *iface,pktItem **pkt);
+YRETCODE    yPktQueuePeekNthH2D(yInterfaceSt *iface,int n,pktItem **pkt);
 YRETCODE    yPktQueuePopH2D(yInterfaceSt *iface,pktItem **pkt);
+void        yPktQueueReleaseD2H(yInterfaceSt *iface,pktItem *pkt);
+void        yPktQueueReleaseH2D(yInterfaceSt *iface,pktItem *pkt);
 
 #define NBMAX_INTERFACE_PER_DEV     1
 typedef enum
@@ -700,7 +730,7 @@ typedef struct  _yPrivDeviceSt{
     int                 replybufsize;   // allocated size of replybuf
     yFifoBuf            http_fifo;
     u8                  *http_raw_buf;
-    u8                  *devYdxMap;
+    u16                 *devYdxMap;     // maps the devYdx of the children to our WP devYdx
     struct              _yPrivDeviceSt   *next;
 } yPrivDeviceSt;
 
@@ -723,14 +753,20 @@ typedef enum {
     NET_HUB_CLOSED
 } NET_HUB_STATE;
 
-// If made bigger than 255, change plenty of u8 into u16 and pray
+// Devices behind one hub. The devYdx of the whole API (WP devYdx) go up to
+// NB_MAX_DEVICES, see devYdxMap. If made bigger than 255, change plenty of
+// u8 into u16 and pray
 #define MAX_YDX_PER_HUB 255
 #define ALLOC_YDX_PER_HUB 256
+#define UNMAPPED_DEVYDX 0xffff  // devYdxMap entry of an unknown device
 // NetHubSt flags
 //#define NETH_F_MANDATORY                1
 //#define NETH_F_SEND_PING_NOTIFICATION   2
 
 #define NET_HUB_NOT_CONNECTION_TIMEOUT   (6*1024)
+// the notification fifo starts small and doubles when a burst does not fit
+#define NET_HUB_NOT_FIFO_SIZE            2048
+#define NET_HUB_NOT_FIFO_MAXSIZE         (64*1024)
 
 typedef struct _HTTPNetHubSt {
     // the following fields are for the notification helper thread only
@@ -780,7 +816,7 @@ typedef struct _WSNetHubSt {
     yStrRef pass;
     int s_next_async_id;
     YSOCKET skt;
-    yFifoBuf mainfifo;
+    yFifoBuf32 mainfifo;
     u64 bws_open_tm;
     u64 bws_timeout_tm;
     u64 bws_read_tm;
@@ -795,6 +831,23 @@ typedef struct _WSNetHubSt {
 } WSNetHub;
 
 
+// per-hub state used when the hub is driven by a shared network loop
+// instead of its own helper thread (see yNetLoopAttachHub)
+typedef struct _HubLoopSt {
+    int     loopidx;        // index of the network loop driving this hub
+    int     mustclose;      // set when the hub is unregistered
+    int     detached;       // set by the loop once the hub is closed and can be freed
+    int     connecting;     // queued for or processed by a connection helper
+    int     first_notification_connection;
+    int     ws_connected;   // websocket base socket is open
+    int     ws_buffer_ofs;  // size of the pending fragmented websocket frame
+    u64     retry_tm;       // do not try to reconnect before this time (in ms)
+    u64     next_step_tm;   // next time the hub must be processed even without IO (in ms)
+    int     nbfds;          // sockets currently registered in the loop for this hub
+    YSOCKET fds[2 + ALLOC_YDX_PER_HUB * MAX_ASYNC_TCPCHAN];
+    char    ws_buffer[2048];
+} HubLoopSt;
+
 typedef struct _HubSt {
     yUrlRef url;            // hub base URL, or INVALID_HASH_IDX if unused
     // misc flag that are maped to int for efficency and thread safety
@@ -805,17 +858,18 @@ typedef struct _HubSt {
     yStrRef serial;
     WakeUpSocket wuce;
     yThread net_thread;
+    HubLoopSt *loop;        // not NULL when the hub is driven by a network loop
     char *name;
     yAsbUrlProto proto;
     NET_HUB_STATE state;
-    yFifoBuf not_fifo; // notification fifo
-    u8 not_buffer[1024]; // buffer for the fifo
+    yFifoBuf32 not_fifo; // notification fifo
+    u8 *not_buffer;     // buffer for the fifo, grows up to NET_HUB_NOT_FIFO_MAXSIZE
     int retryCount;
     u32 notifAbsPos;
     u64 lastAttempt;    // time of the last connection attempt (in ms)
     u64 attemptDelay;   // delay until next attemps (in ms)
     u64 devListExpires;
-    u8 devYdxMap[ALLOC_YDX_PER_HUB];   // maps hub's internal devYdx to our WP devYdx //fixme:
+    u16 devYdxMap[ALLOC_YDX_PER_HUB];  // maps hub's internal devYdx to our WP devYdx
     int errcode;  // in case an error occured
     char errmsg[YOCTO_ERRMSG_LEN];
     yCRITICAL_SECTION access; // CS for field that need to be protected agains concurency (these filed start with cs_
@@ -923,10 +977,15 @@ typedef struct{
     //yapi CS
     yCRITICAL_SECTION   updateDev_cs;
     yCRITICAL_SECTION   handleEv_cs;
+    // threads holding updateDev_cs and handleEv_cs, see yapiIsApiEventThread
+    yThreadId           updateDevThread;
+    volatile int        updateDevDepth;
+    yThreadId           handleEvThread;
+    volatile int        handleEvDepth;
     yEvent              exitSleepEvent;
     // global inforation on all devices
     yCRITICAL_SECTION   generic_cs;
-    yGenericDeviceSt    generic_infos[ALLOC_YDX_PER_HUB];
+    yGenericDeviceSt    generic_infos[NB_MAX_DEVICES];
     // usb stuff
     yCRITICAL_SECTION   enum_cs;
     int                 detecttype;
@@ -939,7 +998,9 @@ typedef struct{
     u32                 io_counter;
     // network discovery info
     HubSt*              nethub[NBMAX_NET_HUB];
-    RequestSt*          tcpreq[ALLOC_YDX_PER_HUB];  // indexed by our own DevYdx
+    int                 nbNetLoops;      // 0: one helper thread per hub
+    RequestSt*          tcpreq[NB_MAX_DEVICES];  // indexed by our own DevYdx
+    RequestSt*          tcpreqChan[NB_MAX_DEVICES][MAX_ASYNC_TCPCHAN-1]; // async requests of HTTP hubs on channels 1 and up
     yRawNotificationCb  rawNotificationCb;
     yRawReportCb        rawReportCb;
     yRawReportV2Cb      rawReportV2Cb;
@@ -1068,7 +1129,11 @@ int  yUsbClose(YIOHDL_internal *ioghdl,char *errmsg);
 int  yUSBGetBooloader(const char *serial, const char * name,  yInterfaceSt *iface,char *errmsg);
 
 // Misc helper
+int yNetHubReserveNotification(HubSt *hub, u32 len);
 int handleNetNotification(HubSt *hub);
+int yhelper_step(HubSt *hub, YSOCKET *fds, char *errmsg);
+int yhelper_mustConnect(HubSt *hub);
+void yhelper_connect(HubSt *hub, int *first_notification_connection);
 u32 yapiGetCNonce(u32 nc);
 YRETCODE  yapiHTTPRequestSyncStartEx_internal(YIOHDL *iohdl, int tcpchan, const char *device, const char *request, int requestsize, char **reply, int *replysize, yapiRequestProgressCallback progress_cb, void *progress_ctx, char *errmsg);
 YRETCODE  yapiHTTPRequestSyncDone_internal(YIOHDL *iohdl, char *errmsg);
@@ -268,7 +268,7 @@ void ypUpdateUSB(const char *serial, const char *funcid, const char *funcname, i
     serialref = yHashPutStr(serial);
     funcidref = yHashPutStr(funcid);
     if(funcname) funcnameref = yHashPutStr(funcname);
-    if(ypRegister(yHashPutStr(categ), serialref, funcidref, funcnameref, funclass, funydx, funcval)){
+    if(ypRegister(yHashPutStr(categ), serialref, funcidref, funcnameref, funclass, funydx, funcval) > 0){
         // Forward high-level notification to API user
         yFunctionUpdate(((s32)funcidref << 16) | serialref, funcval);
     }
@@ -293,7 +293,7 @@ void ypUpdateHybrid(const char *serial, Notification_funydx funInfo, const char
     int     devydx;
     yStrRef serialref;
 
-    serialref = yHashPutStr(serial);
+    serialref = yHashTestStr(serial);
     devydx = wpGetDevYdx(serialref);
     if(devydx >= 0) {
         ypUpdateYdx(devydx, funInfo, funcval);
@@ -911,6 +911,7 @@ void yPktQueueInit(pktQueue *q)
 {
     memset(q,0,sizeof(pktQueue));
     q->status = YAPI_SUCCESS;
+    q->ring = (pktItem*) yMalloc(PKT_QUEUE_SLOTS * sizeof(pktItem));
     yInitializeCriticalSection(&q->cs);
     yCreateManualEvent(&q->notEmptyEvent,0);
     yCreateManualEvent(&q->emptyEvent,0);
@@ -920,32 +921,69 @@ void yPktQueueFree(pktQueue *q)
 {
     pktItem *p,*t;
 
+    if (q->totalOverflow) {
+        dbglog("PKTs: %lld pkts did not fit in the %d slots ring\n", q->totalOverflow, PKT_QUEUE_SLOTS);
+    }
     p=q->first;
     while(p){
         t=p;
         p=p->next;
         yFree(t);
     }
+    yFree(q->ring);
     yDeleteCriticalSection(&q->cs);
     yCloseEvent(&q->notEmptyEvent);
     yCloseEvent(&q->emptyEvent);
     memset(q,0xca,sizeof(pktQueue));
 }
 
-static YRETCODE  yPktQueuePushEx(pktQueue *q,const USB_Packet *pkt, char * errmsg)
+void yPktQueueGetStats(pktQueue *q, u32 *highWater, u64 *totalOverflow)
+{
+    if (highWater) *highWater = q->highWater;
+    if (totalOverflow) *totalOverflow = q->totalOverflow;
+}
+
+#define PKT_SLOT(q, idx)    (&(q)->ring[(idx) & (PKT_QUEUE_SLOTS - 1)])
+
+static int yPktQueueGetError(pktQueue *q, char * errmsg)
 {
-    pktItem *newpkt;
     YRETCODE res;
+
     yEnterCriticalSection(&q->cs);
+    res = q->status;
+    if(errmsg)
+        YSTRCPY(errmsg,YOCTO_ERRMSG_LEN,q->errmsg);
+    yLeaveCriticalSection(&q->cs);
+    return res;
+}
+
+// must only be called by the producer
+static YRETCODE  yPktQueuePushEx(pktQueue *q,const USB_Packet *pkt, char * errmsg)
+{
+    pktItem *newpkt;
+    u32     head = q->head;
+    u32     used = head - q->released;
 
     if (q->status != YAPI_SUCCESS) {
-        res = q->status;
-        if(errmsg)
-            YSTRCPY(errmsg,YOCTO_ERRMSG_LEN,q->errmsg);
         //dbglog("%X:yPktQueuePush drop pkt\n",q);
+        return yPktQueueGetError(q, errmsg);
+    }
+    if (q->first == NULL && used < PKT_QUEUE_SLOTS) {
+        // fast path: fill a free slot and publish it
+        newpkt = PKT_SLOT(q, head);
+        memcpy(&newpkt->pkt,pkt,sizeof(USB_Packet));
+#ifdef DEBUG_PKT_TIMING
+        newpkt->time = yapiGetTickCount();
+        newpkt->ospktno = q->totalPush;
+#endif
+        newpkt->next = NULL;
+        yMemoryBarrier();
+        q->head = head + 1;
+        if (used + 1 > q->highWater) {
+            q->highWater = used + 1;
+        }
     } else {
-        res = YAPI_SUCCESS;
-         // allocate new buffer
+        // ring is full (or overflow list not yet drained): allocate
         newpkt= ( pktItem *) yMalloc(sizeof(pktItem));
         memcpy(&newpkt->pkt,pkt,sizeof(USB_Packet));
 #ifdef DEBUG_PKT_TIMING
@@ -953,24 +991,20 @@ static YRETCODE  yPktQueuePushEx(pktQueue *q,const USB_Packet *pkt, char * errms
         newpkt->ospktno = q->totalPush;
 #endif
         newpkt->next = NULL;
-        //lock the queue acces
+        yEnterCriticalSection(&q->cs);
         if (q->first == NULL) {
-            //empty queue
             q->first = newpkt;
             q->last = newpkt;
-            yResetEvent(&q->emptyEvent);
-            //dbglog("%X:yPktQueuePush First pkt\n",q);
         } else {
             q->last->next = newpkt;
             q->last = newpkt;
-            //dbglog("%X:yPktQueuePush a pkt\n",q);
         }
-        q->count++;
-        q->totalPush++;
-    }
-        ySetEvent(&q->notEmptyEvent);
+        q->totalOverflow++;
         yLeaveCriticalSection(&q->cs);
-    return res;
+    }
+    q->totalPush++;
+    ySetEvent(&q->notEmptyEvent);
+    return YAPI_SUCCESS;
 }
 
 void  yPktQueueSetError(pktQueue *q, YRETCODE code, const char * msg)
@@ -988,98 +1022,141 @@ void  yPktQueueSetError(pktQueue *q, YRETCODE code, const char * msg)
 
 static int yPktQueueIsEmpty(pktQueue *q, char * errmsg)
 {
-    int retval;
-
-    yEnterCriticalSection(&q->cs);
-    retval = q->status;
-    if(retval !=YAPI_SUCCESS){
+    if(q->status != YAPI_SUCCESS){
         //dbglog("%X:yPktQueuePop error %d:%s\n",q,q->status,q->errmsg);
-        if(errmsg)
-            YSTRCPY(errmsg,YOCTO_ERRMSG_LEN,q->errmsg);
-    }else{
-        if(q->first==NULL)
-            retval=1;
+        return yPktQueueGetError(q, errmsg);
     }
-    yLeaveCriticalSection(&q->cs);
-    return retval;
+    return (q->tail == q->head && q->first == NULL);
 }
 
-static YRETCODE yPktQueuePeek(pktQueue *q, pktItem **pkt, char * errmsg)
+// return the n-th packet of the queue (or NULL), must only be called by the consumer
+static YRETCODE yPktQueuePeekNth(pktQueue *q, int n, pktItem **pkt)
 {
-    YRETCODE retval;
+    u32      tail = q->tail;
+    u32      avail;
+    pktItem  *p;
 
-    yEnterCriticalSection(&q->cs);
-    retval = q->status;
-    if(retval !=YAPI_SUCCESS){
+    *pkt = NULL;
+    if(q->status != YAPI_SUCCESS){
         //dbglog("%X:yPktQueuePop error %d:%s\n",q,q->status,q->errmsg);
-        *pkt = NULL;
-        if(errmsg)
-            YSTRCPY(errmsg,YOCTO_ERRMSG_LEN,q->errmsg);
-    }else{
-        *pkt = q->first;
+        return yPktQueueGetError(q, NULL);
+    }
+    if ((u32)n < q->head - tail) {
+        yMemoryBarrier();
+        *pkt = PKT_SLOT(q, tail + n);
+        return YAPI_SUCCESS;
+    }
+    if (q->first == NULL) {
+        return YAPI_SUCCESS;
+    }
+    yEnterCriticalSection(&q->cs);
+    // the ring is drained before the overflow list, and slots published
+    // before an overflow are visible once cs is taken
+    avail = q->head - tail;
+    if ((u32)n < avail) {
+        p = PKT_SLOT(q, tail + n);
+    } else {
+        p = q->first;
+        for (n -= avail; p != NULL && n > 0; n--) {
+            p = p->next;
+        }
     }
+    *pkt = p;
     yLeaveCriticalSection(&q->cs);
-    return retval;
+    return YAPI_SUCCESS;
 }
 
+static YRETCODE yPktQueuePeek(pktQueue *q, pktItem **pkt, char * errmsg)
+{
+    YRETCODE retval = yPktQueuePeekNth(q, 0, pkt);
+    if (retval != YAPI_SUCCESS) {
+        return yPktQueueGetError(q, errmsg);
+    }
+    return retval;
+}
 
-
+// must only be called by the consumer, the packet must then be released
+// with yPktQueueRelease
 static YRETCODE yPktQueuePop(pktQueue *q, pktItem **pkt, char * errmsg)
 {
-    YRETCODE retval;
+    u32 tail = q->tail;
 
-    yEnterCriticalSection(&q->cs);
-    retval = q->status;
-    if(retval !=YAPI_SUCCESS){
+    *pkt = NULL;
+    if(q->status != YAPI_SUCCESS){
         //dbglog("%X:yPktQueuePop error %d:%s\n",q,q->status,q->errmsg);
-        *pkt = NULL;
-        if(errmsg)
-            YSTRCPY(errmsg,YOCTO_ERRMSG_LEN,q->errmsg);
-    }else{
-        *pkt = q->first;
-        if(q->first!=NULL){
-           if(q->first == q->last){
-                q->first=NULL;
-                q->last=NULL;
-                //dbglog("%X:yPktQueuePop last pkt\n",q);
-                yResetEvent(&q->notEmptyEvent);
-                ySetEvent(&q->emptyEvent);
-            }else{
-                //dbglog("%X:yPktQueuePop a pkt\n",q);
-                q->first = q->first->next;
+        return yPktQueueGetError(q, errmsg);
+    }
+    if (tail != q->head) {
+        yMemoryBarrier();
+        *pkt = PKT_SLOT(q, tail);
+        q->tail = tail + 1;
+    } else if (q->first != NULL) {
+        yEnterCriticalSection(&q->cs);
+        if (tail != q->head) {
+            *pkt = PKT_SLOT(q, tail);
+            q->tail = tail + 1;
+        } else {
+            *pkt = q->first;
+            q->first = q->first->next;
+            if (q->first == NULL) {
+                q->last = NULL;
             }
-            q->count--;
-            q->totalPop++;
         }
+        yLeaveCriticalSection(&q->cs);
+    }
+    if (*pkt != NULL) {
+        q->totalPop++;
+        if (q->tail == q->head && q->first == NULL) {
+            ySetEvent(&q->emptyEvent);
+        }
+    }
+    return YAPI_SUCCESS;
+}
+
+// give back a popped packet, slots are released in pop order
+static void yPktQueueRelease(pktQueue *q, pktItem *pkt)
+{
+    if (pkt >= q->ring && pkt < q->ring + PKT_QUEUE_SLOTS) {
+        YASSERT(pkt == PKT_SLOT(q, q->released));
+        YASSERT(q->released != q->tail);
+        // make sure we are done with the slot before the producer reuses it
+        yMemoryBarrier();
+        q->released++;
+    } else {
+        yFree(pkt);
     }
-    yLeaveCriticalSection(&q->cs);
-    return retval;
 }
 
 
+static void yPktQueueDupCheck(pktItem *pkt, int verifcount, int *expected_pkt_no, const char *file, int line)
+{
+    if (*expected_pkt_no != pkt->pkt.first_stream.pktno) {
+        dbglogf(file, line, "PKTs: invalid pkt %d (no=%d should be %d\n", verifcount, pkt->pkt.first_stream.pktno, *expected_pkt_no);
+    }
+    *expected_pkt_no = NEXT_YPKT_NO(*expected_pkt_no);
+}
+
 static void yPktQueueDup(pktQueue *q, int expected_pkt_no, const char *file, int line)
 {
     int verifcount = 0;
+    int count = (int)(q->totalPush - q->totalPop);
     pktItem *pkt;
+    u32 idx;
 
     yEnterCriticalSection(&q->cs);
-    dbglogf(file, line, "PKTs: %dpkts (%lld in / %lld out)\n", q->count, q->totalPush, q->totalPop);
-    dbglogf(file, line, "PKTs: start %x stop =%X\n", q->first, q->last);
+    dbglogf(file, line, "PKTs: %dpkts (%lld in / %lld out)\n", count, q->totalPush, q->totalPop);
+    dbglogf(file, line, "PKTs: ring %u->%u (hwm=%u) overflow start %x stop =%X\n", q->tail, q->head, q->highWater, q->first, q->last);
     if (q->status != YAPI_SUCCESS) {
         dbglogf(file, line, "PKTs: state = %s\n", q->status, q->errmsg);
     }
-    pkt = q->first;
-    while (pkt != NULL){
-        if (expected_pkt_no != pkt->pkt.first_stream.pktno) {
-            dbglogf(file, line, "PKTs: invalid pkt %d (no=%d should be %d\n", verifcount, pkt->pkt.first_stream.pktno, expected_pkt_no);
-        }
-
-        verifcount++;
-        expected_pkt_no = NEXT_YPKT_NO(expected_pkt_no);
-        pkt = pkt->next;
+    for (idx = q->tail; idx != q->head; idx++) {
+        yPktQueueDupCheck(PKT_SLOT(q, idx), verifcount++, &expected_pkt_no, file, line);
+    }
+    for (pkt = q->first; pkt != NULL; pkt = pkt->next) {
+        yPktQueueDupCheck(pkt, verifcount++, &expected_pkt_no, file, line);
     }
-    if (verifcount != q->count) {
-        dbglogf(file, line, "PKTs: invalid pkt count has %d report %d\n", verifcount, q->count);
+    if (verifcount != count) {
+        dbglogf(file, line, "PKTs: invalid pkt count has %d report %d\n", verifcount, count);
     }
     yLeaveCriticalSection(&q->cs);
 }
@@ -1095,7 +1172,8 @@ YRETCODE  yPktQueuePushD2H(yInterfaceSt *iface,const USB_Packet *pkt, char * err
         int mustdump = 0;
         yEnterCriticalSection(&iface->rxQueue.cs);
         if (pkt->first_stream.pkt != YPKT_CONF) {
-            pktItem *p = iface->rxQueue.last;
+            pktQueue *q = &iface->rxQueue;
+            pktItem *p = (q->last != NULL ? q->last : (q->head != q->released ? PKT_SLOT(q, q->head - 1) : NULL));
             if (p != NULL && p->pkt.first_stream.pkt == YPKT_CONF) {
                 int pktno = p->pkt.first_stream.pktno + 1;
                 if (pktno > 7)
@@ -1122,14 +1200,18 @@ YRETCODE yPktQueueWaitAndPopD2H(yInterfaceSt *iface,pktItem **pkt, int ms, char
     YRETCODE res;
     *pkt = NULL;
     res= yPktQueuePop(&iface->rxQueue,pkt,errmsg);
-    if(res != YAPI_SUCCESS || ms == 0){
+    if(res != YAPI_SUCCESS || ms == 0 || *pkt != NULL){
         return  res;
     }
-    if (*pkt == NULL) {
-        yWaitForEvent(&iface->rxQueue.notEmptyEvent, ms);
-        return  yPktQueuePop(&iface->rxQueue,pkt, errmsg);
+    // the producer sets the event after each push: reset it and check
+    // again before waiting, so that no push can be missed
+    yResetEvent(&iface->rxQueue.notEmptyEvent);
+    res= yPktQueuePop(&iface->rxQueue,pkt,errmsg);
+    if(res != YAPI_SUCCESS || *pkt != NULL){
+        return  res;
     }
-    return res;
+    yWaitForEvent(&iface->rxQueue.notEmptyEvent, ms);
+    return  yPktQueuePop(&iface->rxQueue,pkt, errmsg);
 }
 
 
@@ -1142,6 +1224,13 @@ YRETCODE  yPktQueuePushH2D(yInterfaceSt *iface,const USB_Packet *pkt, char * err
 static int yPktQueueWaitEmptyH2D(yInterfaceSt *iface,int ms, char * errmsg)
 {
     if(ms > 0){
+        int res;
+        // the consumer sets the event when it pops the last packet
+        yResetEvent(&iface->txQueue.emptyEvent);
+        res = yPktQueueIsEmpty(&iface->txQueue,errmsg);
+        if (res != 0) {
+            return res;
+        }
         yWaitForEvent(&iface->txQueue.emptyEvent, ms);
     }
     return yPktQueueIsEmpty(&iface->txQueue,errmsg);
@@ -1164,6 +1253,11 @@ YRETCODE yPktQueuePeekH2D(yInterfaceSt *iface,pktItem **pkt)
 #endif
 }
 
+YRETCODE yPktQueuePeekNthH2D(yInterfaceSt *iface,int n,pktItem **pkt)
+{
+    return yPktQueuePeekNth(&iface->txQueue,n,pkt);
+}
+
 YRETCODE yPktQueuePopH2D(yInterfaceSt *iface,pktItem **pkt)
 {
 
@@ -1180,6 +1274,16 @@ YRETCODE yPktQueuePopH2D(yInterfaceSt *iface,pktItem **pkt)
 #endif
 }
 
+void yPktQueueReleaseD2H(yInterfaceSt *iface,pktItem *pkt)
+{
+    yPktQueueRelease(&iface->rxQueue,pkt);
+}
+
+void yPktQueueReleaseH2D(yInterfaceSt *iface,pktItem *pkt)
+{
+    yPktQueueRelease(&iface->txQueue,pkt);
+}
+
 
 /*****************************************************************************
   yyPACKET ioFUNCTIONS
@@ -1260,7 +1364,7 @@ static int yyWaitOnlyConfPkt(yInterfaceSt *iface, u8 cmdtowait,pktItem **rpkt,u3
             }
 #endif
             dropcount++;
-            yFree(tmp);
+            yPktQueueReleaseD2H(iface, tmp);
         }
     } while(timeout> yapiGetTickCount());
 
@@ -1331,7 +1435,7 @@ static int ySendStart(yPrivDeviceSt *dev,char *errmsg)
         dbglog("Activate USB pkt ack (%dms)\n", dev->pktAckDelay);
     }
     dev->lastpktno = rpkt->pkt.first_stream.pktno;
-    yFree(rpkt);
+    yPktQueueReleaseD2H(&dev->iface, rpkt);
     if(nextiface!=0 ){
         return YERRMSG(YAPI_VERSION_MISMATCH,"Device has not been started correctly");
     }
@@ -1367,7 +1471,7 @@ static int yPacketSetup(yPrivDeviceSt *dev,char *errmsg)
         goto error;
     }
     dev->iface.ifaceno = 0;
-    yFree(rpkt);
+    yPktQueueReleaseD2H(&dev->iface, rpkt);
     rpkt = NULL;
 
     if(!YISERR(res=ySendStart(dev,errmsg))){
@@ -1375,7 +1479,7 @@ static int yPacketSetup(yPrivDeviceSt *dev,char *errmsg)
      }
 error:
     if (rpkt) {
-        yFree(rpkt);
+        yPktQueueReleaseD2H(&dev->iface, rpkt);
     }
     //shutdown all previously started interfaces;
     dbglog("Closing partially opened device %s\n",dev->infos.serial);
@@ -1414,7 +1518,7 @@ again:
         if (dev->pktAckDelay > 0) {
             res = yAckPkt(iface, item->pkt.first_stream.pktno, errmsg);
             if (YISERR(res)){
-                yFree(item);
+                yPktQueueReleaseD2H(iface, item);
                 return res;
             }
         }
@@ -1423,7 +1527,7 @@ again:
 #ifdef DEBUG_DUMP_PKT
             dumpAnyPacket("Drop Late config pkt",iface->ifaceno,&item->pkt);
 #endif
-            yFree(item);
+            yPktQueueReleaseD2H(iface, item);
             dropcount++;
             if(dropcount >10){
                 dbglog("Too many packets dropped, disable %s\n",dev->infos.serial);
@@ -1433,7 +1537,7 @@ again:
         }
         if (item->pkt.first_stream.pktno == dev->lastpktno) {
             //late retry : drop it since we allready have the packet.
-            yFree(item);
+            yPktQueueReleaseD2H(iface, item);
             goto again;
         }
 
@@ -1446,7 +1550,7 @@ again:
             return YAPI_SUCCESS;
         } else {
             yPktQueueDup(&iface->rxQueue, nextpktno, __FILE_ID__, __LINE__);
-            yFree(item);
+            yPktQueueReleaseD2H(iface, item);
             return YERRMSG(YAPI_IO_ERROR, "Missing Packet");
         }
     }
@@ -1503,7 +1607,7 @@ static int yStreamReceived(yPrivDeviceSt *dev, u8 *stream, u8 **data, u8 *size,
     if (dev->curxofs >= USB_PKT_SIZE - sizeof(YSTREAM_Head)) {
         // look if we have the next packet on a interface
         if (dev->currxpkt) {
-            yFree(dev->currxpkt);
+            yPktQueueReleaseD2H(&dev->iface, dev->currxpkt);
             dev->currxpkt=NULL;
         }
         res = yGetNextPktEx(dev, &dev->currxpkt, blockUntilTime, errmsg);
@@ -1609,6 +1713,7 @@ static void yDispatchNotice(yPrivDeviceSt *dev, USB_Notify_Pkt *notify, int pkts
 {
     yPrivDeviceSt *notDev;
     u16 vendorid,deviceid;
+    int devydx;
 
     if(isV2 || notify->firstByte <= NOTIFY_1STBYTE_MAXTINY || notify->firstByte >= NOTIFY_1STBYTE_MINSMALL) {
         // Tiny or small pubval notification:
@@ -1623,7 +1728,7 @@ static void yDispatchNotice(yPrivDeviceSt *dev, USB_Notify_Pkt *notify, int pkts
             smallnot->funInfo.v2.funydx = notify->tinypubvalnot.funInfo.v2.funydx;
             smallnot->funInfo.v2.typeV2 = notify->tinypubvalnot.funInfo.v2.typeV2;
             smallnot->funInfo.v2.isSmall = 1;
-            smallnot->devydx = wpGetDevYdx(yHashPutStr(dev->infos.serial));
+            devydx = wpGetDevYdx(yHashTestStr(dev->infos.serial));
         } else {
 #ifndef __BORLANDC__
             YASSERT(0);
@@ -1632,11 +1737,13 @@ static void yDispatchNotice(yPrivDeviceSt *dev, USB_Notify_Pkt *notify, int pkts
             memcpy(smallnot->pubval,notify->smallpubvalnot.pubval,pktsize - sizeof(Notification_small));
             smallnot->funInfo.raw = notify->smallpubvalnot.funInfo.raw;
             if(dev->devYdxMap) {
-                smallnot->devydx = dev->devYdxMap[notify->smallpubvalnot.devydx];
+                devydx = dev->devYdxMap[notify->smallpubvalnot.devydx];
             } else {
-                smallnot->devydx = 255;
+                devydx = -1;
             }
         }
+        // the packet field is 8 bits wide, 255 when the devYdx does not fit
+        smallnot->devydx = (devydx >= 0 && devydx < 255 ? (u8)devydx : 255);
 #ifdef DEBUG_NOTIFICATION
         if(smallnot->funInfo.v2.typeV2 == NOTIFY_V2_LEGACY) {
             dbglog("notifysmall %d %d %s\n",smallnot->devydx,smallnot->funInfo.v2.funydx,smallnot->pubval);
@@ -1646,9 +1753,9 @@ static void yDispatchNotice(yPrivDeviceSt *dev, USB_Notify_Pkt *notify, int pkts
                    tmpbuff[0],tmpbuff[1],tmpbuff[2],tmpbuff[3],tmpbuff[4],tmpbuff[5]);
         }
 #endif
-        if (smallnot->devydx < 255 && smallnot->funInfo.v2.typeV2 != NOTIFY_V2_FLUSHGROUP) {
-            ypUpdateYdx(smallnot->devydx,smallnot->funInfo,smallnot->pubval);
-            if(yContext->rawNotificationCb){
+        if (devydx >= 0 && devydx < NB_MAX_DEVICES && smallnot->funInfo.v2.typeV2 != NOTIFY_V2_FLUSHGROUP) {
+            ypUpdateYdx(devydx,smallnot->funInfo,smallnot->pubval);
+            if(yContext->rawNotificationCb && smallnot->devydx < 255){
                 yContext->rawNotificationCb((USB_Notify_Pkt *)smallnot);
             }
         }
@@ -1675,7 +1782,7 @@ static void yDispatchNotice(yPrivDeviceSt *dev, USB_Notify_Pkt *notify, int pkts
         dbglog("new beacon %x\n",notify->namenot.beacon);
 #endif
         {
-            yStrRef serialref = yHashPutStr(notify->head.serial);
+            yStrRef serialref = yHashTestStr(notify->head.serial);
             yStrRef lnameref = yHashPutStr(notify->namenot.name);
             wpSafeUpdate(NULL, MAX_YDX_PER_HUB,serialref,lnameref,yHashUrlUSB(serialref),notify->namenot.beacon);
             if(yContext->rawNotificationCb){
@@ -1696,10 +1803,10 @@ static void yDispatchNotice(yPrivDeviceSt *dev, USB_Notify_Pkt *notify, int pkts
         if(notDev == dev) {
             // build devYdx mapping for immediate child hubs
             if(dev->devYdxMap == NULL) {
-                dev->devYdxMap = (u8*) yMalloc(ALLOC_YDX_PER_HUB);
-                memset(dev->devYdxMap, 255, ALLOC_YDX_PER_HUB);
+                dev->devYdxMap = (u16*) yMalloc(ALLOC_YDX_PER_HUB * sizeof(u16));
+                memset(dev->devYdxMap, 0xff, ALLOC_YDX_PER_HUB * sizeof(u16));
             }
-            dev->devYdxMap[notify->childserial.devydx] = wpGetDevYdx(yHashPutStr(notify->childserial.childserial));
+            dev->devYdxMap[notify->childserial.devydx] = wpGetDevYdx(yHashTestStr(notify->childserial.childserial));
         }
         break;
     case NOTIFY_PKT_FIRMWARE:
@@ -1756,7 +1863,7 @@ static void yDispatchNotice(yPrivDeviceSt *dev, USB_Notify_Pkt *notify, int pkts
     case NOTIFY_PKT_LOG:
         {
             if (!strncmp(notify->head.serial, dev->infos.serial, YOCTO_SERIAL_LEN)) {
-                yStrRef serialref = yHashPutStr(notify->head.serial);
+                yStrRef serialref = yHashTestStr(notify->head.serial);
                 int devydx = wpGetDevYdx(serialref);
                 if (devydx >=0 ) {
                     yEnterCriticalSection(&yContext->generic_cs);
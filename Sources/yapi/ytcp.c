@@ -38,6 +38,9 @@
  *********************************************************************/
 
 #define __FILE_ID__  "ytcp"
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE     // CPU_SET() and sched_setaffinity() used to pin network loops
+#endif
 #define _WINSOCK_DEPRECATED_NO_WARNINGS
 
 #include "ydef.h"
@@ -75,6 +78,11 @@ typedef int socklen_t;
     #include <unistd.h>
     #include <fcntl.h>
     #include <netdb.h>
+    #include <poll.h>
+#endif
+#ifdef LINUX_API
+    #include <sys/epoll.h>
+    #include <sched.h>
 #endif
 
 
@@ -278,6 +286,23 @@ int yConsumeWakeUpSocket(WakeUpSocket *wuce, char *errmsg)
     return signal;
 }
 
+// consume all pending signals without blocking (used by the network loops)
+void yDrainWakeUpSocket(WakeUpSocket *wuce)
+{
+    u8 signal[16];
+
+#ifdef WINDOWS_API
+    u_long avail = 0;
+    while (ioctlsocket(wuce->listensock, FIONREAD, &avail) == 0 && avail > 0) {
+        if (yrecv(wuce->listensock, (char*)signal, sizeof(signal), 0) <= 0) {
+            break;
+        }
+    }
+#else
+    while (yrecv(wuce->listensock, (char*)signal, sizeof(signal), MSG_DONTWAIT) > 0);
+#endif
+}
+
 void yFreeWakeUpSocket(WakeUpSocket *wuce)
 {
     if ( wuce->listensock != INVALID_SOCKET) {
@@ -291,6 +316,244 @@ void yFreeWakeUpSocket(WakeUpSocket *wuce)
 }
 
 
+/********************************************************************************
+ * Socket poller
+ *
+ * YPOLLER_POLL keeps the socket list in the structure and hands it to poll()
+ * (select() on Windows) at each wait. It has no FD_SETSIZE limit and is cheap
+ * to rebuild, so it is used for short-lived sets built on the stack. The list
+ * is allocated once it outgrows YPOLLER_INLINE_FDS, call yPollerFree after use.
+ * YPOLLER_EPOLL keeps the set in the kernel (Linux only) so that a wait does
+ * not depend on the number of monitored sockets. It is used for large sets
+ * that change little between two waits (network loops, WebSocket hubs).
+ *******************************************************************************/
+
+int yPollerInit(yPoller *poller, int backend, char *errmsg)
+{
+    memset(poller, 0, sizeof(yPoller));
+    poller->epfd = -1;
+    poller->maxfds = YPOLLER_INLINE_FDS;
+    poller->fds = poller->inl_fds;
+    poller->tags = poller->inl_tags;
+#ifdef LINUX_API
+    if (backend == YPOLLER_EPOLL) {
+        poller->epfd = epoll_create(YPOLLER_INLINE_FDS);
+        if (poller->epfd < 0) {
+            return yNetSetErr();
+        }
+        fcntl(poller->epfd, F_SETFD, FD_CLOEXEC);
+    }
+#else
+    // no persistent kernel set on this platform
+    backend = YPOLLER_POLL;
+#endif
+    poller->backend = backend;
+    return YAPI_SUCCESS;
+}
+
+
+void yPollerFree(yPoller *poller)
+{
+#ifdef LINUX_API
+    if (poller->epfd >= 0) {
+        close(poller->epfd);
+    }
+#endif
+    if (poller->fds != poller->inl_fds) {
+        yFree(poller->fds);
+        yFree(poller->tags);
+    }
+    poller->epfd = -1;
+    poller->nbfds = 0;
+    poller->maxfds = YPOLLER_INLINE_FDS;
+    poller->fds = poller->inl_fds;
+    poller->tags = poller->inl_tags;
+}
+
+
+void yPollerClear(yPoller *poller)
+{
+    YASSERT(poller->backend == YPOLLER_POLL);
+    poller->nbfds = 0;
+}
+
+
+int yPollerAdd(yPoller *poller, YSOCKET skt, u64 tag, char *errmsg)
+{
+    int i;
+#ifdef LINUX_API
+    if (poller->backend == YPOLLER_EPOLL) {
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.u64 = tag;
+        // the socket number may have been reused since it was registered,
+        // so try to update it first and register it if it is unknown
+        if (epoll_ctl(poller->epfd, EPOLL_CTL_MOD, skt, &ev) < 0) {
+            if (epoll_ctl(poller->epfd, EPOLL_CTL_ADD, skt, &ev) < 0) {
+                return yNetSetErr();
+            }
+        }
+        return YAPI_SUCCESS;
+    }
+#endif
+    for (i = 0; i < poller->nbfds; i++) {
+        if (poller->fds[i] == skt) {
+            poller->tags[i] = tag;
+            return YAPI_SUCCESS;
+        }
+    }
+    if (poller->nbfds >= poller->maxfds) {
+        // the set grows as needed, a hub can have a request per device and channel
+        int     newmax = poller->maxfds * 2;
+        YSOCKET *newfds = (YSOCKET*)yMalloc(newmax * sizeof(YSOCKET));
+        u64     *newtags = (u64*)yMalloc(newmax * sizeof(u64));
+        memcpy(newfds, poller->fds, poller->nbfds * sizeof(YSOCKET));
+        memcpy(newtags, poller->tags, poller->nbfds * sizeof(u64));
+        if (poller->fds != poller->inl_fds) {
+            yFree(poller->fds);
+            yFree(poller->tags);
+        }
+        poller->fds = newfds;
+        poller->tags = newtags;
+        poller->maxfds = newmax;
+    }
+    poller->fds[poller->nbfds] = skt;
+    poller->tags[poller->nbfds] = tag;
+    poller->nbfds++;
+    return YAPI_SUCCESS;
+}
+
+
+void yPollerRemove(yPoller *poller, YSOCKET skt)
+{
+    int i;
+#ifdef LINUX_API
+    if (poller->backend == YPOLLER_EPOLL) {
+        struct epoll_event ev;
+        // closed sockets are already removed by the kernel, ignore errors
+        epoll_ctl(poller->epfd, EPOLL_CTL_DEL, skt, &ev);
+        return;
+    }
+#endif
+    for (i = 0; i < poller->nbfds; i++) {
+        if (poller->fds[i] == skt) {
+            poller->nbfds--;
+            poller->fds[i] = poller->fds[poller->nbfds];
+            poller->tags[i] = poller->tags[poller->nbfds];
+            return;
+        }
+    }
+}
+
+
+/*
+ * Wait until at least one socket is readable (or closed) or the timeout expires.
+ * Store the tags of the ready sockets in ready and return their count,
+ * 0 on timeout or an error code.
+ */
+int yPollerWait(yPoller *poller, u64 *ready, int maxready, u64 mstimeout, char *errmsg)
+{
+    int res, i, nbready = 0;
+
+#ifdef LINUX_API
+    if (poller->backend == YPOLLER_EPOLL) {
+        struct epoll_event events[YPOLLER_MAX_EVENTS];
+        if (maxready > YPOLLER_MAX_EVENTS) {
+            maxready = YPOLLER_MAX_EVENTS;
+        }
+        res = epoll_wait(poller->epfd, events, maxready, (int)mstimeout);
+        if (res < 0) {
+            if (SOCK_ERR == EINTR || SOCK_ERR == EAGAIN) {
+                return 0;
+            }
+            return yNetSetErr();
+        }
+        for (i = 0; i < res; i++) {
+            ready[i] = events[i].data.u64;
+        }
+        return res;
+    }
+#endif
+#ifdef WINDOWS_API
+    {
+        fd_set inl_fds;
+        fd_set *fds = &inl_fds;
+        struct timeval timeout;
+        YSOCKET sktmax = 0;
+
+        if (poller->nbfds == 0) {
+            Sleep((DWORD)mstimeout);
+            return 0;
+        }
+        memset(&timeout, 0, sizeof(timeout));
+        timeout.tv_sec = (long)(mstimeout / 1000);
+        timeout.tv_usec = (int)(mstimeout % 1000) * 1000;
+        if (poller->nbfds > FD_SETSIZE) {
+            // a Winsock fd_set is a counted array, it can be allocated larger than FD_SETSIZE
+            fds = (fd_set*)yMalloc(offsetof(fd_set, fd_array) + poller->nbfds * sizeof(SOCKET));
+        }
+        fds->fd_count = 0;
+        for (i = 0; i < poller->nbfds; i++) {
+            fds->fd_array[fds->fd_count++] = poller->fds[i];
+            if (poller->fds[i] > sktmax) {
+                sktmax = poller->fds[i];
+            }
+        }
+        res = select((int)sktmax + 1, fds, NULL, NULL, &timeout);
+        if (res < 0) {
+            if (fds != &inl_fds) {
+                yFree(fds);
+            }
+            return yNetSetErr();
+        }
+        for (i = 0; i < poller->nbfds && nbready < maxready && res > 0; i++) {
+            if (FD_ISSET(poller->fds[i], fds)) {
+                ready[nbready++] = poller->tags[i];
+            }
+        }
+        if (fds != &inl_fds) {
+            yFree(fds);
+        }
+    }
+#else
+    {
+        struct pollfd inl_pfds[YPOLLER_INLINE_FDS];
+        struct pollfd *pfds = inl_pfds;
+
+        if (poller->nbfds > YPOLLER_INLINE_FDS) {
+            pfds = (struct pollfd*)yMalloc(poller->nbfds * sizeof(struct pollfd));
+        }
+        memset(pfds, 0, poller->nbfds * sizeof(struct pollfd));
+        for (i = 0; i < poller->nbfds; i++) {
+            pfds[i].fd = poller->fds[i];
+            pfds[i].events = POLLIN;
+        }
+        res = poll(pfds, poller->nbfds, (int)mstimeout);
+        if (res < 0) {
+            if (pfds != inl_pfds) {
+                yFree(pfds);
+            }
+            if (SOCK_ERR == EINTR || SOCK_ERR == EAGAIN) {
+                return 0;
+            }
+            return yNetSetErr();
+        }
+        for (i = 0; i < poller->nbfds && nbready < maxready && res > 0; i++) {
+            // like select(), report errors and hang-ups as readable sockets
+            if (pfds[i].revents & (POLLIN | POLLERR | POLLHUP | POLLNVAL)) {
+                ready[nbready++] = poller->tags[i];
+            }
+        }
+        if (pfds != inl_pfds) {
+            yFree(pfds);
+        }
+    }
+#endif
+    return nbready;
+}
+
+
 
 
 u32 yResolveDNS(const char *name,char *errmsg)
@@ -392,6 +655,66 @@ void yTcpShutdown(void)
 }
 
 
+#define YSKT_READ       1
+#define YSKT_WRITE      2
+#define YSKT_EXCEPT     4
+
+/*
+ * Wait until a single socket is ready for the operations listed in mask
+ * (a combination of YSKT_READ, YSKT_WRITE and YSKT_EXCEPT). Unlike select(),
+ * poll() does not limit the socket number to FD_SETSIZE, which is required
+ * when many hubs are registered.
+ * Return the mask of ready operations, 0 on timeout, or SOCKET_ERROR (the
+ * cause can be retrieved with SOCK_ERR like for select)
+ */
+static int yTcpWaitSocket(YSOCKET skt, int mask, u64 mstimeout)
+{
+    int res, ready = 0;
+#ifdef WINDOWS_API
+    fd_set      readfds, writefds, exceptfds;
+    struct timeval timeout;
+
+    memset(&timeout, 0, sizeof(timeout));
+    timeout.tv_sec = (long)(mstimeout / 1000);
+    timeout.tv_usec = (int)(mstimeout % 1000) * 1000;
+    FD_ZERO(&readfds);
+    FD_ZERO(&writefds);
+    FD_ZERO(&exceptfds);
+    FD_SET(skt, &readfds);
+    FD_SET(skt, &writefds);
+    FD_SET(skt, &exceptfds);
+    res = select((int)skt + 1, (mask & YSKT_READ) ? &readfds : NULL, (mask & YSKT_WRITE) ? &writefds : NULL,
+                 (mask & YSKT_EXCEPT) ? &exceptfds : NULL, &timeout);
+    if (res <= 0) {
+        return res;
+    }
+    if ((mask & YSKT_READ) && FD_ISSET(skt, &readfds)) ready |= YSKT_READ;
+    if ((mask & YSKT_WRITE) && FD_ISSET(skt, &writefds)) ready |= YSKT_WRITE;
+    if ((mask & YSKT_EXCEPT) && FD_ISSET(skt, &exceptfds)) ready |= YSKT_EXCEPT;
+#else
+    struct pollfd pfd;
+
+    memset(&pfd, 0, sizeof(pfd));
+    pfd.fd = skt;
+    if (mask & YSKT_READ) pfd.events |= POLLIN;
+    if (mask & YSKT_WRITE) pfd.events |= POLLOUT;
+    if (mask & YSKT_EXCEPT) pfd.events |= POLLPRI;
+    res = poll(&pfd, 1, (int)mstimeout);
+    if (res <= 0) {
+        return res;
+    }
+    if (pfd.revents & POLLNVAL) {
+        errno = EBADF;
+        return SOCKET_ERROR;
+    }
+    // select() reports errors and hang-ups as readable/writable sockets
+    if ((mask & YSKT_READ) && (pfd.revents & (POLLIN | POLLERR | POLLHUP))) ready |= YSKT_READ;
+    if ((mask & YSKT_WRITE) && (pfd.revents & (POLLOUT | POLLERR | POLLHUP))) ready |= YSKT_WRITE;
+    if ((mask & YSKT_EXCEPT) && (pfd.revents & POLLPRI)) ready |= YSKT_EXCEPT;
+#endif
+    return ready;
+}
+
 #define DEFAULT_TCP_ROUND_TRIP_TIME  30
 #define DEFAULT_TCP_MAX_WINDOW_SIZE  (4*65536)
 
@@ -401,8 +724,6 @@ static int yTcpOpen(YSOCKET *newskt, u32 ip, u16 port, u64 mstimeout, char *errm
     int iResult;
     u_long flags;
     YSOCKET skt;
-    fd_set      readfds, writefds, exceptfds;
-    struct timeval timeout;
     int tcp_sendbuffer;
 #ifdef WINDOWS_API
     char noDelay=1;
@@ -452,32 +773,18 @@ static int yTcpOpen(YSOCKET *newskt, u32 ip, u16 port, u64 mstimeout, char *errm
     YPERF_TCP_LEAVE(TCPOpen_setsockopt_noblock);
     connect(skt, ( struct sockaddr *) &clientService, sizeof(clientService) );
 
-    // wait for the connection with a select
-    memset(&timeout, 0, sizeof(timeout));
-    if (mstimeout != 0) {
-        u64 nbsec = mstimeout / 1000;
-        timeout.tv_sec = (long)nbsec;
-        timeout.tv_usec = ((int) (mstimeout - (nbsec * 1000))) * 1000;
-    } else {
-        timeout.tv_sec = 20;
-    }
-    FD_ZERO(&readfds);
-    FD_ZERO(&writefds);
-    FD_ZERO(&exceptfds);
-    FD_SET(skt, &readfds);
-    FD_SET(skt, &writefds);
-    FD_SET(skt, &exceptfds);
-    iResult = select((int)skt + 1, &readfds, &writefds, &exceptfds, &timeout);
+    // wait for the connection
+    iResult = yTcpWaitSocket(skt, YSKT_READ | YSKT_WRITE | YSKT_EXCEPT, mstimeout != 0 ? mstimeout : 20000);
     if (iResult < 0) {
         REPORT_ERR("Unable to connect to server");
         yclosesocket(skt);
         return YAPI_IO_ERROR;
     }
-    if (FD_ISSET(skt, &exceptfds)) {
+    if (iResult & YSKT_EXCEPT) {
         yclosesocket(skt);
         return YERRMSG(YAPI_IO_ERROR, "Unable to connect to server");
     }
-    if (!FD_ISSET(skt, &writefds)) {
+    if (!(iResult & YSKT_WRITE)) {
         yclosesocket(skt);
         return YERRMSG(YAPI_IO_ERROR, "Unable to connect to server");
     }
@@ -569,21 +876,12 @@ static void yTcpClose(YSOCKET skt)
 static int yTcpCheckSocketStillValid(YSOCKET skt, char * errmsg)
 {
     int iResult, res;
-    fd_set      readfds,writefds,exceptfds;
-    struct timeval timeout;
 
     // Send an initial buffer
 #ifndef WINDOWS_API
 retry:
 #endif
-    memset(&timeout,0,sizeof(timeout));
-    FD_ZERO(&readfds);
-    FD_ZERO(&writefds);
-    FD_ZERO(&exceptfds);
-    FD_SET(skt,&readfds);
-    FD_SET(skt,&writefds);
-    FD_SET(skt,&exceptfds);
-    res = select((int)skt+1,&readfds,&writefds,&exceptfds,&timeout);
+    res = yTcpWaitSocket(skt, YSKT_READ | YSKT_WRITE | YSKT_EXCEPT, 0);
     if (res<0) {
 #ifndef WINDOWS_API
         if(SOCK_ERR ==  EAGAIN){
@@ -596,16 +894,16 @@ retry:
             return res;
         }
     }
-    if (FD_ISSET(skt,&exceptfds)) {
+    if (res & YSKT_EXCEPT) {
         yTcpClose(skt);
         return YERRMSG(YAPI_IO_ERROR, "Exception on socket");
     }
-    if (!FD_ISSET(skt,&writefds)) {
+    if (!(res & YSKT_WRITE)) {
         yTcpClose(skt);
         return YERRMSG(YAPI_IO_ERROR, "Socket not ready for write");
     }
 
-    if (FD_ISSET(skt,&readfds)) {
+    if (res & YSKT_READ) {
         char buffer[128];
         iResult = (int)yrecv(skt, buffer, sizeof(buffer), 0);
         if (iResult == 0) {
@@ -648,15 +946,9 @@ static int yTcpWrite(YSOCKET skt, const char *buffer, int len,char *errmsg)
             // unable to send all data
             // wait a bit with a select
             if (tosend != res) {
-                struct timeval timeout;
-                fd_set      fds;
-                memset(&timeout,0,sizeof(timeout));
                 // Upload of large files (external firmware updates) may need
                 // a long time to process (on OSX: seen more than 40 seconds !)
-                timeout.tv_sec = 60;
-                FD_ZERO(&fds);
-                FD_SET(skt,&fds);
-                res = select((int)skt+1,NULL,&fds,NULL,&timeout);
+                res = yTcpWaitSocket(skt, YSKT_WRITE, 60000);
                 if (res<0) {
 #ifndef WINDOWS_API
                     if(SOCK_ERR ==  EAGAIN){
@@ -708,7 +1000,6 @@ int yTcpDownload(const char *host, const char *url, u8 **out_buffer, u32 mstimeo
     u8      *replybuf = yMalloc(512);
     int     replybufsize = 512;
     int     replysize = 0;
-    fd_set      fds;
     u64 expiration;
 
     ip = yResolveDNS(host, errmsg);
@@ -730,15 +1021,9 @@ int yTcpDownload(const char *host, const char *url, u8 **out_buffer, u32 mstimeo
         goto exit;
     }
     while(expiration - yapiGetTickCount() > 0) {
-        struct timeval timeout;
         u64 ms = expiration - yapiGetTickCount();
-        memset(&timeout,0,sizeof(timeout));
-        timeout.tv_sec = (long) ms / 1000;
-        timeout.tv_usec = (int)(ms % 1000) *1000;
         /* wait for data */
-        FD_ZERO(&fds);
-        FD_SET(skt,&fds);
-        res = select((int)skt+1,&fds,NULL,NULL,&timeout);
+        res = yTcpWaitSocket(skt, YSKT_READ, ms);
         if (res<0) {
     #ifndef WINDOWS_API
             if(SOCK_ERR ==  EAGAIN){
@@ -987,155 +1272,160 @@ static void yHTTPCloseReqEx(struct _RequestSt *req, int canReuseSocket)
 }
 
 
-static int yHTTPMultiSelectReq(struct _RequestSt **reqs, int size, u64 ms, WakeUpSocket *wuce, char *errmsg)
+// read the data available on the socket of an HTTP request and process the reply header
+static void yHTTPReadReq(struct _RequestSt *req, char *errmsg)
 {
-    fd_set      fds;
-    struct timeval timeout;
-    int         res,i;
-    YSOCKET     sktmax=0;
+    int res;
+
+    yEnterCriticalSection(&req->access);
+    if (req->http.skt == INVALID_SOCKET) {
+        // request closed in the meantime
+        yLeaveCriticalSection(&req->access);
+        return;
+    }
+    if (req->replysize >= req->replybufsize - 256) {
+        // need to grow receive buffer
+        int  newsize = req->replybufsize << 1;
+        u8 *newbuf = (u8*) yMalloc(newsize);
+        memcpy(newbuf, req->replybuf, req->replysize);
+        yFree(req->replybuf);
+        req->replybuf = newbuf;
+        req->replybufsize = newsize;
+    }
+    res = yTcpRead(req->http.skt, req->replybuf + req->replysize, req->replybufsize - req->replysize, errmsg);
+    //dbglog("check %x:%x:%X\n", check, check2, size);
+    if (res == 0) {
+        // nothing available yet (spurious wakeup or non-blocking poll)
+        yLeaveCriticalSection(&req->access);
+        return;
+    }
+    req->read_tm = yapiGetTickCount();
+    if (res < 0) {
+        // any connection closed by peer ends up with YAPI_NO_MORE_DATA
+        req->replypos = 0;
+        req->errcode = YERRTO((YRETCODE) res,req->errmsg);
+        TCPLOG("yHTTPSelectReq %p[%x] connection closed by peer\n",req,req->http.skt);
+        yHTTPCloseReqEx(req, 0);
+    } else if (res > 0) {
+        req->replysize += res;
+        if(req->replypos < 0) {
+            // Need to analyze http headers
+            if(req->replysize == 8 && !memcmp(req->replybuf, "0K\r\n\r\n\r\n", 8)) {
+                TCPLOG("yHTTPSelectReq %p[%x] untrashort reply\n",req,req->http.skt);
+                // successful abbreviated reply (keepalive)
+                req->replypos = 0;
+                req->replybuf[0] = 'O';
+                req->errcode = YERRTO(YAPI_NO_MORE_DATA, req->errmsg);
+                yHTTPCloseReqEx(req, 1);
+            } else if(req->replysize >= 4 && !memcmp(req->replybuf, "OK\r\n", 4)) {
+                // successful short reply, let it go through
+                req->replypos = 0;
+            } else if(req->replysize >= 12) {
+                if(memcmp(req->replybuf, "HTTP/1.1 401", 12) != 0) {
+                    // no authentication required, let it go through
+                    req->replypos = 0;
+                } else {
+                    // authentication required, process authentication headers
+                    char *method = NULL, *realm = NULL, *qop = NULL, *nonce = NULL, *opaque = NULL;
+
+                    if(!req->hub->http.s_user || req->retryCount++ > 3) {
+                        // No credential provided, give up immediately
+                        req->replypos = 0;
+                        req->replysize = 0;
+                        req->errcode = YERRTO(YAPI_UNAUTHORIZED, req->errmsg);
+                        yHTTPCloseReqEx(req, 0);
+                    } else if(yParseWWWAuthenticate((char*)req->replybuf, req->replysize, &method, &realm, &qop, &nonce, &opaque) >= 0) {
+                        // Authentication header fully received, we can close the connection
+                        if (!strcmp(method, "Digest") && !strcmp(qop, "auth")) {
+                            // partial close to reopen with authentication settings
+                            yTcpClose(req->http.skt);
+                            req->http.skt = INVALID_SOCKET;
+                            // device requests Digest qop-authentication, good
+                            yEnterCriticalSection(&req->hub->access);
+                            yDupSet(&req->hub->http.s_realm, realm);
+                            yDupSet(&req->hub->http.s_nonce, nonce);
+                            yDupSet(&req->hub->http.s_opaque, opaque);
+                            if (req->hub->http.s_user && req->hub->http.s_pwd) {
+                                ComputeAuthHA1(req->hub->http.s_ha1, req->hub->http.s_user, req->hub->http.s_pwd, req->hub->http.s_realm);
+                            }
+                            req->hub->http.nc = 0;
+                            yLeaveCriticalSection(&req->hub->access);
+                            // reopen connection with proper auth parameters
+                            // callback and context parameters are preserved
+                            req->errcode = yHTTPOpenReqEx(req, req->timeout_tm, req->errmsg);
+                            if (YISERR(req->errcode)) {
+                                yHTTPCloseReqEx(req, 0);
+                            }
+                        } else {
+                            // unsupported authentication method for devices, give up
+                            req->replypos = 0;
+                            req->errcode = YERRTO(YAPI_UNAUTHORIZED, req->errmsg);
+                            yHTTPCloseReqEx(req, 0);
+                        }
+                    }
+                }
+            }
+        }
+        if (req->errcode == YAPI_SUCCESS) {
+            req->errcode = yTcpCheckReqTimeout(req, req->errmsg);
+        }
+    }
+    yLeaveCriticalSection(&req->access);
+}
 
-    memset(&timeout, 0, sizeof(timeout));
-    timeout.tv_sec = (long)ms/1000;
-    timeout.tv_usec = (int)(ms % 1000) *1000;
-    /* wait for data */
-    //dbglog("select %p\n", reqs);
 
+static int yHTTPMultiSelectReq(struct _RequestSt **reqs, int size, u64 ms, WakeUpSocket *wuce, char *errmsg)
+{
+    yPoller     poller;
+    u64         inl_ready[YPOLLER_INLINE_FDS];
+    u64         *ready = inl_ready;
+    int         i, nbready, res = YAPI_SUCCESS;
 
-    FD_ZERO(&fds);
+    // room for every request and the wake-up socket
+    if (size + 1 > YPOLLER_INLINE_FDS) {
+        ready = (u64*)yMalloc((size + 1) * sizeof(u64));
+    }
+    /* wait for data */
+    yPollerInit(&poller, YPOLLER_POLL, NULL);
     if (wuce) {
         //dbglog("listensock %p %d\n", reqs, wuce->listensock);
-        FD_SET(wuce->listensock, &fds);
-        sktmax = wuce->listensock;
+        res = yPollerAdd(&poller, wuce->listensock, YPOLLER_WAKEUP_TAG, errmsg);
     }
-    for (i = 0; i < size; i++) {
+    for (i = 0; i < size && !YISERR(res); i++) {
         struct _RequestSt *req;
         req = reqs[i];
         YASSERT(req->proto == PROTO_AUTO || req->proto == PROTO_HTTP);
         if(req->http.skt == INVALID_SOCKET) {
-            return YERR(YAPI_INVALID_ARGUMENT);
+            res = YERR(YAPI_INVALID_ARGUMENT);
         } else {
             //dbglog("sock %p %p:%d\n", reqs, req, req->http.skt);
-            FD_SET(req->http.skt, &fds);
-            if(req->http.skt > sktmax)
-                sktmax = req->http.skt;
+            res = yPollerAdd(&poller, req->http.skt, (u64)i, errmsg);
         }
     }
-    if (sktmax == 0) {
-        return YAPI_SUCCESS;
-    }
-    res = select((int)sktmax + 1, &fds, NULL, NULL, &timeout);
-    if (res < 0) {
-#ifndef WINDOWS_API
-        if(SOCK_ERR ==  EAGAIN){
-            return 0;
-        } else
-#endif
-        {
-            res = yNetSetErr();
+    if (!YISERR(res) && poller.nbfds > 0) {
+        nbready = yPollerWait(&poller, ready, size + 1, ms, errmsg);
+        if (nbready < 0) {
             for (i = 0; i < size; i++) {
                 TCPLOG("yHTTPSelectReq %p[%X] (%s)\n", reqs[i], reqs[i]->http.skt, errmsg);
             }
-            return res;
+            res = nbready;
         }
-    }
-    if (res != 0) {
-        if (wuce && FD_ISSET(wuce->listensock,&fds)) {
-            YPROPERR(yConsumeWakeUpSocket(wuce, errmsg));
-        }
-        for (i = 0; i < size; i++) {
-            struct _RequestSt *req;
-            req = reqs[i];
-            if (FD_ISSET(req->http.skt, &fds)) {
-                yEnterCriticalSection(&req->access);
-                if (req->replysize >= req->replybufsize - 256) {
-                    // need to grow receive buffer
-                    int  newsize = req->replybufsize << 1;
-                    u8 *newbuf = (u8*) yMalloc(newsize);
-                    memcpy(newbuf, req->replybuf, req->replysize);
-                    yFree(req->replybuf);
-                    req->replybuf = newbuf;
-                    req->replybufsize = newsize;
-                }
-                res = yTcpRead(req->http.skt, req->replybuf + req->replysize, req->replybufsize - req->replysize, errmsg);
-                //dbglog("check %x:%x:%X\n", check, check2, size);
-
-                req->read_tm = yapiGetTickCount();
-                if (res < 0) {
-                    // any connection closed by peer ends up with YAPI_NO_MORE_DATA
-                    req->replypos = 0;
-                    req->errcode = YERRTO((YRETCODE) res,req->errmsg);
-                    TCPLOG("yHTTPSelectReq %p[%x] connection closed by peer\n",req,req->http.skt);
-                    yHTTPCloseReqEx(req, 0);
-                } else if (res > 0) {
-                    req->replysize += res;
-                    if(req->replypos < 0) {
-                        // Need to analyze http headers
-                        if(req->replysize == 8 && !memcmp(req->replybuf, "0K\r\n\r\n\r\n", 8)) {
-                            TCPLOG("yHTTPSelectReq %p[%x] untrashort reply\n",req,req->http.skt);
-                            // successful abbreviated reply (keepalive)
-                            req->replypos = 0;
-                            req->replybuf[0] = 'O';
-                            req->errcode = YERRTO(YAPI_NO_MORE_DATA, req->errmsg);
-                            yHTTPCloseReqEx(req, 1);
-                        } else if(req->replysize >= 4 && !memcmp(req->replybuf, "OK\r\n", 4)) {
-                            // successful short reply, let it go through
-                            req->replypos = 0;
-                        } else if(req->replysize >= 12) {
-                            if(memcmp(req->replybuf, "HTTP/1.1 401", 12) != 0) {
-                                // no authentication required, let it go through
-                                req->replypos = 0;
-                            } else {
-                                // authentication required, process authentication headers
-                                char *method = NULL, *realm = NULL, *qop = NULL, *nonce = NULL, *opaque = NULL;
-
-                                if(!req->hub->http.s_user || req->retryCount++ > 3) {
-                                    // No credential provided, give up immediately
-                                    req->replypos = 0;
-                                    req->replysize = 0;
-                                    req->errcode = YERRTO(YAPI_UNAUTHORIZED, req->errmsg);
-                                    yHTTPCloseReqEx(req, 0);
-                                } else if(yParseWWWAuthenticate((char*)req->replybuf, req->replysize, &method, &realm, &qop, &nonce, &opaque) >= 0) {
-                                    // Authentication header fully received, we can close the connection
-                                    if (!strcmp(method, "Digest") && !strcmp(qop, "auth")) {
-                                        // partial close to reopen with authentication settings
-                                        yTcpClose(req->http.skt);
-                                        req->http.skt = INVALID_SOCKET;
-                                        // device requests Digest qop-authentication, good
-                                        yEnterCriticalSection(&req->hub->access);
-                                        yDupSet(&req->hub->http.s_realm, realm);
-                                        yDupSet(&req->hub->http.s_nonce, nonce);
-                                        yDupSet(&req->hub->http.s_opaque, opaque);
-                                        if (req->hub->http.s_user && req->hub->http.s_pwd) {
-                                            ComputeAuthHA1(req->hub->http.s_ha1, req->hub->http.s_user, req->hub->http.s_pwd, req->hub->http.s_realm);
-                                        }
-                                        req->hub->http.nc = 0;
-                                        yLeaveCriticalSection(&req->hub->access);
-                                        // reopen connection with proper auth parameters
-                                        // callback and context parameters are preserved
-                                        req->errcode = yHTTPOpenReqEx(req, req->timeout_tm, req->errmsg);
-                                        if (YISERR(req->errcode)) {
-                                            yHTTPCloseReqEx(req, 0);
-                                        }
-                                    } else {
-                                        // unsupported authentication method for devices, give up
-                                        req->replypos = 0;
-                                        req->errcode = YERRTO(YAPI_UNAUTHORIZED, req->errmsg);
-                                        yHTTPCloseReqEx(req, 0);
-                                    }
-                                }
-                            }
-                        }
-                    }
-                    if (req->errcode == YAPI_SUCCESS) {
-                        req->errcode = yTcpCheckReqTimeout(req, req->errmsg);
-                    }
+        for (i = 0; i < nbready && !YISERR(res); i++) {
+            if (ready[i] == YPOLLER_WAKEUP_TAG) {
+                int signal = yConsumeWakeUpSocket(wuce, errmsg);
+                if (YISERR(signal)) {
+                    res = signal;
                 }
-                yLeaveCriticalSection(&req->access);
+            } else {
+                yHTTPReadReq(reqs[ready[i]], errmsg);
             }
         }
     }
-
-    return YAPI_SUCCESS;
+    yPollerFree(&poller);
+    if (ready != inl_ready) {
+        yFree(ready);
+    }
+    return YISERR(res) ? res : YAPI_SUCCESS;
 }
 
 
@@ -1483,6 +1773,39 @@ int  yReqMultiSelect(struct _RequestSt **tcpreq, int size, u64 ms, WakeUpSocket
 }
 
 
+/*
+ * Non-blocking counterpart of yReqMultiSelect used by the network loops:
+ * drain the wakeup socket and read whatever is available on each request.
+ */
+int  yReqMultiPoll(struct _RequestSt **tcpreq, int size, WakeUpSocket *wuce, char *errmsg)
+{
+    int i;
+
+    if (wuce) {
+        yDrainWakeUpSocket(wuce);
+    }
+    for (i = 0; i < size; i++) {
+        YASSERT(tcpreq[i]->proto == PROTO_AUTO || tcpreq[i]->proto == PROTO_HTTP);
+        yHTTPReadReq(tcpreq[i], errmsg);
+    }
+    return YAPI_SUCCESS;
+}
+
+
+YSOCKET yReqGetSocket(struct _RequestSt *req)
+{
+    YSOCKET skt;
+
+    if (req->proto != PROTO_AUTO && req->proto != PROTO_HTTP) {
+        return req->hub->ws.skt;
+    }
+    yEnterCriticalSection(&req->access);
+    skt = req->http.skt;
+    yLeaveCriticalSection(&req->access);
+    return skt;
+}
+
+
 int yReqIsEof(struct _RequestSt *req, char *errmsg)
 {
     int res;
@@ -1628,18 +1951,19 @@ void yReqFree(struct _RequestSt *req)
 
 int yReqHasPending(struct _HubSt *hub)
 {
-    int       i;
+    int       i, tcpchan;
     RequestSt   *req = NULL;
 
     if (hub->proto == PROTO_AUTO || hub->proto == PROTO_HTTP) {
-        for (i = 0; i < ALLOC_YDX_PER_HUB; i++) {
-            req = yContext->tcpreq[i];
-            if (req && yReqIsAsync(req)) {
-                return 1;
+        for (i = 0; i < NB_MAX_DEVICES; i++) {
+            for (tcpchan = 0; tcpchan < MAX_ASYNC_TCPCHAN; tcpchan++) {
+                req = (tcpchan == 0 ? yContext->tcpreq[i] : yContext->tcpreqChan[i][tcpchan-1]);
+                if (req && yReqIsAsync(req)) {
+                    return 1;
+                }
             }
         }
     } else {
-        int  tcpchan;
         for (tcpchan = 0; tcpchan < MAX_ASYNC_TCPCHAN; tcpchan++) {
             yEnterCriticalSection(&hub->ws.chan[tcpchan].access);
             if (hub->ws.chan[tcpchan].requests) {
@@ -1979,7 +2303,11 @@ static int ws_parseIncommingFrame(HubSt *hub, u8 *buffer, int pktlen, char *errm
                 fclose(f);
             }
 #endif
-            yPushFifo(&hub->not_fifo, buffer, pktlen);
+            if (!yNetHubReserveNotification(hub, pktlen)) {
+                dbglog("Notification fifo of %s is full, drop %d bytes\n", hub->name, pktlen);
+            } else {
+                yPushFifo32(&hub->not_fifo, buffer, pktlen);
+            }
             while (handleNetNotification(hub));
         }
         break;
@@ -2423,7 +2751,7 @@ static int ws_openBaseSocket(struct _WSNetHubSt *hub, yUrlRef url, const char *r
     }
 
     hub->fifo_buffer = yMalloc(2048);
-    yFifoInit(&hub->mainfifo, hub->fifo_buffer, 2048);
+    yFifoInit32(&hub->mainfifo, hub->fifo_buffer, 2048, YFIFO32_SPSC);
     for (tcpchan = 0; tcpchan < MAX_ASYNC_TCPCHAN; tcpchan++) {
         yInitializeCriticalSection(&hub->chan[tcpchan].access);
     }
@@ -2444,7 +2772,7 @@ static void ws_closeBaseSocket(struct _WSNetHubSt *base_req)
     for (tcpchan = 0; tcpchan < MAX_ASYNC_TCPCHAN; tcpchan++) {
         yDeleteCriticalSection(&base_req->chan[tcpchan].access);
     }
-    yFifoCleanup(&base_req->mainfifo);
+    yFifoCleanup32(&base_req->mainfifo);
     yFree(base_req->fifo_buffer);
 }
 
@@ -2452,65 +2780,55 @@ static void ws_closeBaseSocket(struct _WSNetHubSt *base_req)
 /*
 *   select used by background thread
 */
-static int ws_thread_select(struct _WSNetHubSt *base_req, u64 ms, WakeUpSocket *wuce, char *errmsg)
+/*
+ * Read available data from the base socket into the main fifo (does not block)
+ * return the number of bytes read or an error code
+ */
+static int ws_readBaseSocket(struct _WSNetHubSt *base_req, char *errmsg)
 {
-    fd_set      fds;
-    struct timeval timeout;
-    int         res;
-    YSOCKET     sktmax = 0;
-
-    memset(&timeout, 0, sizeof(timeout));
-    timeout.tv_sec = (long)ms / 1000;
-    timeout.tv_usec = (int)(ms % 1000) * 1000;
-    /* wait for data */
-    FD_ZERO(&fds);
-    if (wuce) {
-        FD_SET(wuce->listensock, &fds);
-        sktmax = wuce->listensock;
+    int avail = yFifoGetFree32(&base_req->mainfifo);
+    int readed = 0;
+    if (avail) {
+        u8 buffer[2048];
+        if (avail > 2048) {
+            avail = 2048;
+        }
+        readed = yTcpRead(base_req->skt, buffer, avail, errmsg);
+        if (readed > 0) {
+            yPushFifo32(&base_req->mainfifo, buffer, readed);
+        }
     }
+    return readed;
+}
+
+
+static int ws_thread_select(struct _WSNetHubSt *base_req, u64 ms, WakeUpSocket *wuce, char *errmsg)
+{
+    yPoller     poller;
+    u64         ready[2];
+    int         i, nbready;
 
     if (base_req->skt == INVALID_SOCKET) {
         return YERR(YAPI_INVALID_ARGUMENT);
-    } else {
-        FD_SET(base_req->skt, &fds);
-        if (base_req->skt > sktmax)
-            sktmax = base_req->skt;
     }
-    if (sktmax == 0) {
-        return YAPI_SUCCESS;
+    /* wait for data */
+    yPollerInit(&poller, YPOLLER_POLL, NULL);
+    if (wuce) {
+        YPROPERR(yPollerAdd(&poller, wuce->listensock, YPOLLER_WAKEUP_TAG, errmsg));
     }
-    res = select((int)sktmax + 1, &fds, NULL, NULL, &timeout);
-    if (res < 0) {
-#ifndef WINDOWS_API
-        if (SOCK_ERR == EAGAIN) {
-            return 0;
-        } else
-#endif
-        {
-            res = yNetSetErr();
-            return res;
-        }
-    }
-    if (res != 0) {
-        if (wuce && FD_ISSET(wuce->listensock, &fds)) {
+    YPROPERR(yPollerAdd(&poller, base_req->skt, 0, errmsg));
+    nbready = yPollerWait(&poller, ready, 2, ms, errmsg);
+    YPROPERR(nbready);
+    for (i = 0; i < nbready; i++) {
+        if (ready[i] == YPOLLER_WAKEUP_TAG) {
             int signal = yConsumeWakeUpSocket(wuce, errmsg);
             //dbglog("exit from sleep with WUCE (%d)\n", signal);
             YPROPERR(signal);
         }
-        if (FD_ISSET(base_req->skt, &fds)) {
-            int avail = yFifoGetFree(&base_req->mainfifo);
-            int readed = 0;
-            if (avail) {
-                u8 buffer[2048];
-                if (avail > 2048) {
-                    avail = 2048;
-                }
-                readed = yTcpRead(base_req->skt, buffer, avail, errmsg);
-                if (readed > 0) {
-                    yPushFifo(&base_req->mainfifo, buffer, readed);
-                }
-            }
-            return readed;
+    }
+    for (i = 0; i < nbready; i++) {
+        if (ready[i] != YPOLLER_WAKEUP_TAG) {
+            return ws_readBaseSocket(base_req, errmsg);
         }
     }
     return YAPI_SUCCESS;
@@ -2531,18 +2849,228 @@ static void ws_threadUpdateRetryCount(HubSt *hub)
 
 }
 
+/*
+ * Open the base socket of a WebSocket hub and send the upgrade request
+ */
+static int ws_openHubConnection(HubSt *hub, int first_notification_connection, char *errmsg)
+{
+    char request[256];
+    int res;
+
+    WSLOG("hub(%s) try to open WS connection at %d\n", hub->name, hub->notifAbsPos);
+    if (first_notification_connection) {
+        YSPRINTF(request, 256, "GET /not.byn");
+    } else {
+        YSPRINTF(request, 256, "GET /not.byn?abs=%u", hub->notifAbsPos);
+    }
+    res = ws_openBaseSocket(&hub->ws, hub->url, request, YSTRLEN(request), 1000, errmsg);
+    hub->lastAttempt = yapiGetTickCount();
+    if (YISERR(res)) {
+        yEnterCriticalSection(&hub->access);
+        hub->errcode = ySetErr(res, hub->errmsg, errmsg, NULL, 0);
+        yLeaveCriticalSection(&hub->access);
+        ws_threadUpdateRetryCount(hub);
+        return res;
+    }
+    WSLOG("hub(%s) base socket opened (skt=%x)\n", hub->name, hub->ws.skt);
+    hub->state = NET_HUB_TRYING;
+    hub->ws.base_state = WS_BASE_HEADER_SENT;
+    hub->ws.connectionTime = 0;
+    hub->ws.tcpRoundTripTime = DEFAULT_TCP_ROUND_TRIP_TIME;
+    hub->ws.tcpMaxWindowSize = DEFAULT_TCP_MAX_WINDOW_SIZE;
+    return YAPI_SUCCESS;
+}
+
+
+/*
+ * Process all complete frames received on the base socket of a WebSocket hub.
+ * buffer must be 2048 bytes long and keeps fragmented frames between calls.
+ */
+static int ws_processIncomingData(HubSt *hub, char *buffer, int *buffer_ofs, char *errmsg)
+{
+    char *p;
+    u8 header[8];
+    int res = YAPI_SUCCESS;
+    int need_more_data = 0;
+    int avail, rw;
+    int hdrlen;
+    u32 mask;
+    int websocket_ok = 0;
+    int pktlen;
+    do {
+        u32 pos;
+        //something to handle;
+        switch (hub->ws.base_state) {
+        case WS_BASE_HEADER_SENT:
+            pos = ySeekFifo32(&hub->ws.mainfifo, (const u8*)"\r\n\r\n", 4, 0, 0, 0);
+            if (pos == YFIFO32_NOT_FOUND) {
+                if ((u64)(yapiGetTickCount() - hub->lastAttempt) > WS_CONNEXION_TIMEOUT) {
+                    res = YERR(YAPI_TIMEOUT);
+                } else {
+                    need_more_data = 1;
+                }
+                break;
+            } else if (pos >= 2044) {
+                res = YERRMSG(YAPI_IO_ERROR, "Bad reply header");
+                // fatal error do not retry to reconnect
+                hub->state = NET_HUB_TOCLOSE;
+                break;
+            }
+            pos = ySeekFifo32(&hub->ws.mainfifo, (const u8*)"\r\n", 2, 0, 0, 0);
+            yPopFifo32(&hub->ws.mainfifo, (u8*)buffer, pos + 2);
+            if (YSTRNCMP(buffer, "HTTP/1.1 ", 9) != 0) {
+                res = YERRMSG(YAPI_IO_ERROR, "Bad reply header");
+                // fatal error do not retry to reconnect
+                hub->state = NET_HUB_TOCLOSE;
+                break;
+            }
+            p = buffer + 9;
+            if (YSTRNCMP(p, "101", 3) != 0) {
+                res = YERRMSG(YAPI_IO_ERROR, "hub does not support WebSocket");
+                // fatal error do not retry to reconnect
+                hub->state = NET_HUB_TOCLOSE;
+                break;
+            }
+            websocket_ok = 0;
+            pos = ySeekFifo32(&hub->ws.mainfifo, (const u8*)"\r\n", 2, 0, 0, 0);
+            while (pos != 0) {
+                yPopFifo32(&hub->ws.mainfifo, (u8*)buffer, pos + 2);
+                if (pos > 22 && YSTRNICMP(buffer, "Sec-WebSocket-Accept: ", 22) == 0) {
+                    if (!VerifyWebsocketKey(buffer + 22, pos, hub->ws.websocket_key, hub->ws.websocket_key_len)) {
+                        websocket_ok = 1;
+                    } else {
+                        res = YERRMSG(YAPI_IO_ERROR, "hub does not use same WebSocket protocol");
+                        // fatal error do not retry to reconnect
+                        hub->state = NET_HUB_TOCLOSE;
+                        break;
+                    }
+                }
+                if ((u64)(yapiGetTickCount() - hub->lastAttempt) > WS_CONNEXION_TIMEOUT) {
+                    res = YERR(YAPI_TIMEOUT);
+                    break;
+                }
+                pos = ySeekFifo32(&hub->ws.mainfifo, (const u8*)"\r\n", 2, 0, 0, 0);
+            }
+            yPopFifo32(&hub->ws.mainfifo, NULL, 2);
+            if (websocket_ok) {
+                hub->ws.base_state = WS_BASE_SOCKET_UPGRADED;
+                *buffer_ofs = 0;
+            } else {
+                res = YERRMSG(YAPI_IO_ERROR, "Invalid WebSocket header");
+                // fatal error do not retry to reconnect
+                hub->state = NET_HUB_TOCLOSE;
+            }
+            break;
+        case WS_BASE_SOCKET_UPGRADED:
+        case WS_BASE_AUTHENTICATING:
+        case WS_BASE_CONNECTED:
+
+            avail = yFifoGetUsed32(&hub->ws.mainfifo);
+            if (avail < 2) {
+                need_more_data = 1;
+                break;
+            }
+            rw = (avail < 7 ? avail : 7);
+            yPeekFifo32(&hub->ws.mainfifo, header, rw, 0);
+            pktlen = header[1] & 0x7f;
+            if (pktlen > 125) {
+                // Unsupported long frame, drop all incoming data (probably 1+ frame(s))
+                res = YERRMSG(YAPI_IO_ERROR, "Unsupported long websocket frame");
+                break;
+            }
+
+            if (header[1] & 0x80) {
+                // masked frame
+                hdrlen = 6;
+                if (avail < hdrlen + pktlen) {
+                    need_more_data = 1;
+                    break;
+                }
+                memcpy(&mask, header + 2, sizeof(u32));
+            } else {
+                // plain frame
+                hdrlen = 2;
+                if (avail < hdrlen + pktlen) {
+                    need_more_data = 1;
+                    break;
+                }
+                mask = 0;
+            }
+
+            if ((header[0] & 0x7f) != 0x02) {
+                // Non-data frame
+                if (header[0] == 0x88) {
+                    //if (USBTCPIsPutReady(sock) < 8) return;
+                    // websocket close, reply with a close
+                    header[0] = 0x88;
+                    header[1] = 0x82;
+                    mask = YRand32();
+                    memcpy(header + 2, &mask, sizeof(u32));
+                    header[6] = 0x03 ^ ((u8 *)&mask)[0];
+                    header[7] = 0xe8 ^ ((u8 *)&mask)[1];
+                    res = yTcpWrite(hub->ws.skt, (char*)header, 8, errmsg);
+                    if (YISERR(res)) {
+                        break;
+                    }
+                    hub->ws.base_state = WS_BASE_OFFLINE;
+#ifdef DEBUG_WEBSOCKET
+                    dbglog("WS: io error on base socket of %s(%X): %s\n", hub->name, hub->url, errmsg);
+#endif
+                } else {
+                    // unhandled packet
+                    dbglog("unhandled packet:%x%x\n", header[0], header[1]);
+                }
+                yPopFifo32(&hub->ws.mainfifo, NULL, hdrlen + pktlen);
+                break;
+            }
+            // drop frame header
+            yPopFifo32(&hub->ws.mainfifo, NULL, hdrlen);
+            // append
+            yPopFifo32(&hub->ws.mainfifo, (u8*)buffer + *buffer_ofs, pktlen);
+            if (mask) {
+                int i;
+                for (i = 0; i < (pktlen + 1 + 3) >> 2; i++) {
+                    buffer[*buffer_ofs + i] ^= mask;
+                }
+            }
+
+            if (header[0] == 0x02) {
+                //  fragmented binary frame
+                WSStreamHead strym;
+                strym.encaps = buffer[*buffer_ofs];
+                if (strym.stream == YSTREAM_META) {
+                    // unsupported fragmented META stream, should never happen
+                    dbglog("Warning:fragmented META\n");
+                    break;
+                }
+                *buffer_ofs += pktlen;
+                break;
+            }
+
+            res = ws_parseIncommingFrame(hub, (u8*)buffer, *buffer_ofs + pktlen, errmsg);
+            if (YISERR(res)) {
+                WSLOG("hub(%s) ws_parseIncommingFrame error %d:%s\n", hub->name, res, errmsg);
+                break;
+            }
+            *buffer_ofs = 0;
+            break;
+        case  WS_BASE_OFFLINE:
+            break;
+        }
+    } while (!need_more_data && !YISERR(res));
+    return res;
+}
+
 /**
  *   Background  thread for WebSocket Hub
  */
 void* ws_thread(void* ctx)
 {
-    char *p;
     yThread *thread = (yThread*)ctx;
     char errmsg[YOCTO_ERRMSG_LEN];
     HubSt *hub = (HubSt*)thread->ctx;
     int res;
     int first_notification_connection = 1;
-    u8 header[8];
     char buffer[2048];
     int buffer_ofs = 0;
     int continue_processing;
@@ -2552,8 +3080,6 @@ void* ws_thread(void* ctx)
     WSLOG("hub(%s) start thread \n", hub->name);
 
     while (!yThreadMustEnd(thread) && hub->state != NET_HUB_TOCLOSE) {
-        char request[256];
-
         if (hub->retryCount > 0) {
             u64 timeout = yapiGetTickCount() + hub->attemptDelay;
             do {
@@ -2564,27 +3090,10 @@ void* ws_thread(void* ctx)
         if (hub->state == NET_HUB_TOCLOSE) {
             break;
         }
-        WSLOG("hub(%s) try to open WS connection at %d\n", hub->name, hub->notifAbsPos);
-        if (first_notification_connection) {
-            YSPRINTF(request, 256, "GET /not.byn");
-        } else {
-            YSPRINTF(request, 256, "GET /not.byn?abs=%u", hub->notifAbsPos);
-        }
-        res = ws_openBaseSocket(&hub->ws, hub->url, request, YSTRLEN(request), 1000, errmsg);
-        hub->lastAttempt = yapiGetTickCount();
+        res = ws_openHubConnection(hub, first_notification_connection, errmsg);
         if (YISERR(res)) {
-            yEnterCriticalSection(&hub->access);
-            hub->errcode = ySetErr(res, hub->errmsg, errmsg, NULL, 0);
-            yLeaveCriticalSection(&hub->access);
-            ws_threadUpdateRetryCount(hub);
             continue;
         }
-        WSLOG("hub(%s) base socket opened (skt=%x)\n", hub->name, hub->ws.skt);
-        hub->state = NET_HUB_TRYING;
-        hub->ws.base_state = WS_BASE_HEADER_SENT;
-        hub->ws.connectionTime = 0;
-        hub->ws.tcpRoundTripTime = DEFAULT_TCP_ROUND_TRIP_TIME;
-        hub->ws.tcpMaxWindowSize = DEFAULT_TCP_MAX_WINDOW_SIZE;
         errmsg[0] = 0;
         continue_processing = 1;
         do {
@@ -2602,173 +3111,7 @@ void* ws_thread(void* ctx)
             }
 
             if (res > 0) {
-                int need_more_data = 0;
-                int avail, rw;
-                int hdrlen;
-                u32 mask;
-                int websocket_ok = 0;
-                int pktlen;
-                do {
-                    u16 pos;
-                    //something to handle;
-                    switch (hub->ws.base_state) {
-                    case WS_BASE_HEADER_SENT:
-                        pos = ySeekFifo(&hub->ws.mainfifo, (const u8*)"\r\n\r\n", 4, 0, 0, 0);
-                        if (pos == 0xffff) {
-                            if ((u64)(yapiGetTickCount() - hub->lastAttempt) > WS_CONNEXION_TIMEOUT) {
-                                res = YERR(YAPI_TIMEOUT);
-                            } else {
-                                need_more_data = 1;
-                            }
-                            break;
-                        } else if (pos >= 2044) {
-                            res = YERRMSG(YAPI_IO_ERROR, "Bad reply header");
-                            // fatal error do not retry to reconnect
-                            hub->state = NET_HUB_TOCLOSE;
-                            break;
-                        }
-                        pos = ySeekFifo(&hub->ws.mainfifo, (const u8*)"\r\n", 2, 0, 0, 0);
-                        yPopFifo(&hub->ws.mainfifo, (u8*)buffer, pos + 2);
-                        if (YSTRNCMP(buffer, "HTTP/1.1 ", 9) != 0) {
-                            res = YERRMSG(YAPI_IO_ERROR, "Bad reply header");
-                            // fatal error do not retry to reconnect
-                            hub->state = NET_HUB_TOCLOSE;
-                            break;
-                        }
-                        p = buffer + 9;
-                        if (YSTRNCMP(p, "101", 3) != 0) {
-                            res = YERRMSG(YAPI_IO_ERROR, "hub does not support WebSocket");
-                            // fatal error do not retry to reconnect
-                            hub->state = NET_HUB_TOCLOSE;
-                            break;
-                        }
-                        websocket_ok = 0;
-                        pos = ySeekFifo(&hub->ws.mainfifo, (const u8*)"\r\n", 2, 0, 0, 0);
-                        while (pos != 0) {
-                            yPopFifo(&hub->ws.mainfifo, (u8*)buffer, pos + 2);
-                            if (pos > 22 && YSTRNICMP(buffer, "Sec-WebSocket-Accept: ", 22) == 0) {
-                                if (!VerifyWebsocketKey(buffer + 22, pos, hub->ws.websocket_key, hub->ws.websocket_key_len)) {
-                                    websocket_ok = 1;
-                                } else {
-                                    res = YERRMSG(YAPI_IO_ERROR, "hub does not use same WebSocket protocol");
-                                    // fatal error do not retry to reconnect
-                                    hub->state = NET_HUB_TOCLOSE;
-                                    break;
-                                }
-                            }
-                            if ((u64)(yapiGetTickCount() - hub->lastAttempt) > WS_CONNEXION_TIMEOUT) {
-                                res = YERR(YAPI_TIMEOUT);
-                                break;
-                            }
-                            pos = ySeekFifo(&hub->ws.mainfifo, (const u8*)"\r\n", 2, 0, 0, 0);
-                        }
-                        yPopFifo(&hub->ws.mainfifo, NULL, 2);
-                        if (websocket_ok) {
-                            hub->ws.base_state = WS_BASE_SOCKET_UPGRADED;
-                            buffer_ofs = 0;
-                        } else {
-                            res = YERRMSG(YAPI_IO_ERROR, "Invalid WebSocket header");
-                            // fatal error do not retry to reconnect
-                            hub->state = NET_HUB_TOCLOSE;
-                        }
-                        break;
-                    case WS_BASE_SOCKET_UPGRADED:
-                    case WS_BASE_AUTHENTICATING:
-                    case WS_BASE_CONNECTED:
-
-                        avail = yFifoGetUsed(&hub->ws.mainfifo);
-                        if (avail < 2) {
-                            need_more_data = 1;
-                            break;
-                        }
-                        rw = (avail < 7 ? avail : 7);
-                        yPeekFifo(&hub->ws.mainfifo, header, rw, 0);
-                        pktlen = header[1] & 0x7f;
-                        if (pktlen > 125) {
-                            // Unsupported long frame, drop all incoming data (probably 1+ frame(s))
-                            res = YERRMSG(YAPI_IO_ERROR, "Unsupported long websocket frame");
-                            break;
-                        }
-
-                        if (header[1] & 0x80) {
-                            // masked frame
-                            hdrlen = 6;
-                            if (avail < hdrlen + pktlen) {
-                                need_more_data = 1;
-                                break;
-                            }
-                            memcpy(&mask, header + 2, sizeof(u32));
-                        } else {
-                            // plain frame
-                            hdrlen = 2;
-                            if (avail < hdrlen + pktlen) {
-                                need_more_data = 1;
-                                break;
-                            }
-                            mask = 0;
-                        }
-
-                        if ((header[0] & 0x7f) != 0x02) {
-                            // Non-data frame
-                            if (header[0] == 0x88) {
-                                //if (USBTCPIsPutReady(sock) < 8) return;
-                                // websocket close, reply with a close
-                                header[0] = 0x88;
-                                header[1] = 0x82;
-                                mask = YRand32();
-                                memcpy(header + 2, &mask, sizeof(u32));
-                                header[6] = 0x03 ^ ((u8 *)&mask)[0];
-                                header[7] = 0xe8 ^ ((u8 *)&mask)[1];
-                                res = yTcpWrite(hub->ws.skt, (char*)header, 8, errmsg);
-                                if (YISERR(res)) {
-                                    break;
-                                }
-                                hub->ws.base_state = WS_BASE_OFFLINE;
-#ifdef DEBUG_WEBSOCKET
-                                dbglog("WS: io error on base socket of %s(%X): %s\n", hub->name, hub->url, errmsg);
-#endif
-                            } else {
-                                // unhandled packet
-                                dbglog("unhandled packet:%x%x\n", header[0], header[1]);
-                            }
-                            yPopFifo(&hub->ws.mainfifo, NULL, hdrlen + pktlen);
-                            break;
-                        }
-                        // drop frame header
-                        yPopFifo(&hub->ws.mainfifo, NULL, hdrlen);
-                        // append
-                        yPopFifo(&hub->ws.mainfifo, (u8*)buffer + buffer_ofs, pktlen);
-                        if (mask) {
-                            int i;
-                            for (i = 0; i < (pktlen + 1 + 3) >> 2; i++) {
-                                buffer[buffer_ofs + i] ^= mask;
-                            }
-                        }
-
-                        if (header[0] == 0x02) {
-                            //  fragmented binary frame
-                            WSStreamHead strym;
-                            strym.encaps = buffer[buffer_ofs];
-                            if (strym.stream == YSTREAM_META) {
-                                // unsupported fragmented META stream, should never happen
-                                dbglog("Warning:fragmented META\n");
-                                break;
-                            }
-                            buffer_ofs += pktlen;
-                            break;
-                        }
-
-                        res = ws_parseIncommingFrame(hub, (u8*)buffer, buffer_ofs + pktlen, errmsg);
-                        if (YISERR(res)) {
-                            WSLOG("hub(%s) ws_parseIncommingFrame error %d:%s\n", hub->name, res, errmsg);
-                            break;
-                        }
-                        buffer_ofs = 0;
-                        break;
-                    case  WS_BASE_OFFLINE:
-                        break;
-                    }
-                } while (!need_more_data && !YISERR(res));
+                res = ws_processIncomingData(hub, buffer, &buffer_ofs, errmsg);
             }
             if (!YISERR(res)) {
                 res = ws_processRequests(hub, errmsg);
@@ -2804,6 +3147,571 @@ void* ws_thread(void* ctx)
 
 
 
+/********************************************************************************
+ * Network loops
+ *
+ * When enabled with yapiSetNetworkReactor, all registered hubs are driven by a
+ * small set of event loops instead of one helper thread per hub. Each loop
+ * monitors the sockets of its hubs with an epoll poller and runs a non-blocking
+ * step of the hub (yhelper_step or ws_loopStep) when one of them is ready or when the
+ * hub has a pending timeout.
+ *******************************************************************************/
+
+#define NET_LOOP_MAX_LOOPS      64
+// hubs due within this delay [ms] are processed with the one which wakes the
+// loop, so that the once per second steps of idle hubs share the wake-ups
+#define NET_LOOP_TIMER_SLACK    50
+
+typedef struct {
+    int                 index;
+    int                 cpu;            // cpu the loop is pinned to or -1
+    yPoller             poller;
+    WakeUpSocket        wuce;           // signaled when a hub is attached to the loop
+    yCRITICAL_SECTION   access;         // held while the hubs of the loop are processed
+    int                 *fdowner;       // hub slot that registered each socket or -1
+    int                 fdowner_size;
+    yThread             thread;
+} yNetLoop;
+
+static yNetLoop *yNetLoops = NULL;
+static int       yNbNetLoops = 0;
+
+
+/*
+ * Connection helpers
+ *
+ * Connecting to a hub resolves its name and waits for the TCP handshake, which
+ * takes seconds when the hub is unreachable. The loops never do it themselves:
+ * they queue the hub for one of these threads and keep serving their other
+ * hubs. The hub is processed again by its loop once the attempt is over.
+ */
+
+#define NET_LOOP_CONNECT_THREADS    4
+
+static yThread           yNetConnectThreads[NET_LOOP_CONNECT_THREADS];
+static yCRITICAL_SECTION yNetConnectCS;
+static yEvent            yNetConnectEvent;
+static HubSt            *yNetConnectQueue[NBMAX_NET_HUB];  // each hub is queued at most once
+static int               yNetConnectHead = 0;
+static int               yNetConnectCount = 0;
+static int               yNetConnectStarted = 0;
+
+
+// open the base socket of a WebSocket hub (run by a connection helper)
+static void ws_loopConnect(HubSt *hub)
+{
+    char errmsg[YOCTO_ERRMSG_LEN];
+    HubLoopSt *lp = hub->loop;
+
+    if (YISERR(ws_openHubConnection(hub, lp->first_notification_connection, errmsg))) {
+        lp->retry_tm = yapiGetTickCount() + hub->attemptDelay;
+        return;
+    }
+    lp->ws_connected = 1;
+    lp->ws_buffer_ofs = 0;
+}
+
+
+static void* yNetConnect_thread(void* ctx)
+{
+    yThread *thread = (yThread*)ctx;
+    char errmsg[YOCTO_ERRMSG_LEN];
+    yNetLoop *loop;
+    HubSt *hub;
+
+    yThreadSignalStart(thread);
+    while (!yThreadMustEnd(thread)) {
+        hub = NULL;
+        yEnterCriticalSection(&yNetConnectCS);
+        if (yNetConnectCount > 0) {
+            hub = yNetConnectQueue[yNetConnectHead];
+            yNetConnectHead = (yNetConnectHead + 1) % NBMAX_NET_HUB;
+            yNetConnectCount--;
+            if (yNetConnectCount > 0) {
+                // pass the wake-up on to another helper
+                ySetEvent(&yNetConnectEvent);
+            }
+        }
+        yLeaveCriticalSection(&yNetConnectCS);
+        if (hub == NULL) {
+            yWaitForEvent(&yNetConnectEvent, 1000);
+            continue;
+        }
+        if (hub->proto == PROTO_WEBSOCKET) {
+            ws_loopConnect(hub);
+        } else {
+            yhelper_connect(hub, &hub->loop->first_notification_connection);
+        }
+        // the hub can be freed as soon as connecting is cleared
+        loop = &yNetLoops[hub->loop->loopidx];
+        yEnterCriticalSection(&loop->access);
+        hub->loop->connecting = 0;
+        hub->loop->next_step_tm = 0;
+        yLeaveCriticalSection(&loop->access);
+        yDringWakeUpSocket(&loop->wuce, 1, errmsg);
+    }
+    yThreadSignalEnd(thread);
+    return NULL;
+}
+
+
+/*
+ * Queue a hub for a connection helper (called by the loop of the hub). The loop
+ * must not touch the connection of the hub until hub->loop->connecting is cleared.
+ */
+void yNetLoopConnect(HubSt *hub)
+{
+    yEnterCriticalSection(&yNetConnectCS);
+    hub->loop->connecting = 1;
+    yNetConnectQueue[(yNetConnectHead + yNetConnectCount) % NBMAX_NET_HUB] = hub;
+    yNetConnectCount++;
+    yLeaveCriticalSection(&yNetConnectCS);
+    ySetEvent(&yNetConnectEvent);
+}
+
+
+// remove a hub from the queue if no helper has started to connect it yet
+static void yNetConnectCancel(HubSt *hub)
+{
+    int i, j;
+
+    yEnterCriticalSection(&yNetConnectCS);
+    for (i = 0; i < yNetConnectCount; i++) {
+        if (yNetConnectQueue[(yNetConnectHead + i) % NBMAX_NET_HUB] == hub) {
+            for (j = i; j < yNetConnectCount - 1; j++) {
+                yNetConnectQueue[(yNetConnectHead + j) % NBMAX_NET_HUB] = yNetConnectQueue[(yNetConnectHead + j + 1) % NBMAX_NET_HUB];
+            }
+            yNetConnectCount--;
+            hub->loop->connecting = 0;
+            break;
+        }
+    }
+    yLeaveCriticalSection(&yNetConnectCS);
+}
+
+#ifdef LINUX_API
+
+/*
+ * Non-blocking step of a WebSocket hub (same state machine as ws_thread)
+ * Store in fds the sockets to monitor until the next call and return their count.
+ */
+static int ws_loopStep(HubSt *hub, YSOCKET *fds, char *errmsg)
+{
+    HubLoopSt *lp = hub->loop;
+    int res;
+    u64 now = yapiGetTickCount();
+
+    yDrainWakeUpSocket(&hub->wuce);
+    fds[0] = hub->wuce.listensock;
+    if (lp->connecting) {
+        // a connection helper owns the base socket until it is done
+        lp->next_step_tm = now + 1000;
+        return 1;
+    }
+    if (!lp->ws_connected) {
+        if (hub->state == NET_HUB_TOCLOSE || hub->state == NET_HUB_CLOSED) {
+            hub->state = NET_HUB_CLOSED;
+            return 1;
+        }
+        if (hub->retryCount > 0 && now < lp->retry_tm) {
+            lp->next_step_tm = lp->retry_tm;
+            return 1;
+        }
+        yNetLoopConnect(hub);
+        return 1;
+    }
+
+    res = ws_readBaseSocket(&hub->ws, errmsg);
+    if (YISERR(res)) {
+        WSLOG("hub(%s) ws_readBaseSocket error %d:%s\n", hub->name, res, errmsg);
+    } else if (res > 0) {
+        res = ws_processIncomingData(hub, lp->ws_buffer, &lp->ws_buffer_ofs, errmsg);
+    }
+    if (!YISERR(res)) {
+        res = ws_processRequests(hub, errmsg);
+        if (YISERR(res)) {
+            WSLOG("hub(%s) ws_processRequests error %d:%s\n", hub->name, res, errmsg);
+        }
+    }
+
+    if (YISERR(res) || (hub->state == NET_HUB_TOCLOSE && !ws_requestStillPending(hub))) {
+        if (YISERR(res)) {
+            WSLOG("hub(%s) io error %d:%s\n", hub->name, res, errmsg);
+            yEnterCriticalSection(&hub->access);
+            hub->errcode = ySetErr(res, hub->errmsg, errmsg, NULL, 0);
+            yLeaveCriticalSection(&hub->access);
+            ws_threadUpdateRetryCount(hub);
+        }
+        WSLOG("hub(%s) close base socket %d:%s\n", hub->name, res, errmsg);
+        ws_closeBaseSocket(&hub->ws);
+        lp->ws_connected = 0;
+        lp->retry_tm = yapiGetTickCount() + hub->attemptDelay;
+        if (hub->state == NET_HUB_TOCLOSE) {
+            hub->state = NET_HUB_CLOSED;
+        } else {
+            hub->state = NET_HUB_DISCONNECTED;
+        }
+        lp->next_step_tm = yapiGetTickCount();
+        return 1;
+    }
+
+    now = yapiGetTickCount();
+    if (hub->ws.next_transmit_tm >= now) {
+        lp->next_step_tm = hub->ws.next_transmit_tm;
+    } else {
+        lp->next_step_tm = now + 1000;
+    }
+    fds[1] = hub->ws.skt;
+    return 2;
+}
+
+
+static void yNetLoopSetOwner(yNetLoop *loop, YSOCKET skt, int slot)
+{
+    if ((int)skt >= loop->fdowner_size) {
+        int newsize = ((int)skt + 256) & ~255;
+        int *newowner = (int*)yMalloc(newsize * sizeof(int));
+        memset(newowner, 0xff, newsize * sizeof(int));
+        if (loop->fdowner) {
+            memcpy(newowner, loop->fdowner, loop->fdowner_size * sizeof(int));
+            yFree(loop->fdowner);
+        }
+        loop->fdowner = newowner;
+        loop->fdowner_size = newsize;
+    }
+    loop->fdowner[skt] = slot;
+}
+
+
+static int yNetLoopGetOwner(yNetLoop *loop, YSOCKET skt)
+{
+    if ((int)skt >= loop->fdowner_size) {
+        return -1;
+    }
+    return loop->fdowner[skt];
+}
+
+
+// update the sockets registered in the loop poller for a hub
+static void yNetLoopSyncFds(yNetLoop *loop, HubLoopSt *lp, int slot, YSOCKET *fds, int nbfds)
+{
+    char errmsg[YOCTO_ERRMSG_LEN];
+    int i, j;
+
+    for (i = 0; i < lp->nbfds; i++) {
+        YSOCKET skt = lp->fds[i];
+        for (j = 0; j < nbfds; j++) {
+            if (fds[j] == skt) {
+                break;
+            }
+        }
+        if (j == nbfds && yNetLoopGetOwner(loop, skt) == slot) {
+            yPollerRemove(&loop->poller, skt);
+            yNetLoopSetOwner(loop, skt, -1);
+        }
+    }
+    // socket numbers can be reused by a new request between two steps,
+    // so (re)register every socket that is still monitored, except the
+    // first one: the wake-up socket of the hub lives as long as the hub
+    for (j = 0; j < nbfds; j++) {
+        if (j == 0 && lp->nbfds > 0 && lp->fds[0] == fds[0] && yNetLoopGetOwner(loop, fds[0]) == slot) {
+            continue;
+        }
+        if (YISERR(yPollerAdd(&loop->poller, fds[j], (u64)slot, errmsg))) {
+            dbglog("unable to monitor socket %d (%s)\n", fds[j], errmsg);
+            continue;
+        }
+        yNetLoopSetOwner(loop, fds[j], slot);
+    }
+    memcpy(lp->fds, fds, nbfds * sizeof(YSOCKET));
+    lp->nbfds = nbfds;
+}
+
+
+static void yNetLoopStepHub(yNetLoop *loop, HubSt *hub, int slot)
+{
+    YSOCKET fds[2 + ALLOC_YDX_PER_HUB * MAX_ASYNC_TCPCHAN];
+    char errmsg[YOCTO_ERRMSG_LEN];
+    HubLoopSt *lp = hub->loop;
+    int nbfds;
+
+    if (lp->mustclose && !lp->connecting && hub->state != NET_HUB_CLOSED) {
+        // a connection helper may have reopened the hub after it was unregistered
+        hub->state = NET_HUB_TOCLOSE;
+    }
+    if (hub->proto == PROTO_WEBSOCKET) {
+        nbfds = ws_loopStep(hub, fds, errmsg);
+    } else {
+        nbfds = yhelper_step(hub, fds, errmsg);
+    }
+    if (lp->mustclose && hub->state == NET_HUB_CLOSED) {
+        nbfds = 0;
+        lp->detached = 1;
+    }
+    yNetLoopSyncFds(loop, lp, slot, fds, nbfds);
+}
+
+
+static void* yNetLoop_thread(void* ctx)
+{
+    yThread *thread = (yThread*)ctx;
+    yNetLoop *loop = (yNetLoop*)thread->ctx;
+    char errmsg[YOCTO_ERRMSG_LEN];
+    u64 ready[YPOLLER_MAX_EVENTS];
+    u8 pending[NBMAX_NET_HUB];
+    HubSt *hub;
+    int i, nbev, slot, scanall;
+    u64 now, next = 0;
+
+    if (loop->cpu >= 0) {
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(loop->cpu, &cpuset);
+        if (sched_setaffinity(0, sizeof(cpuset), &cpuset) < 0) {
+            dbglog("unable to pin network loop %d to cpu %d (%d)\n", loop->index, loop->cpu, errno);
+        }
+    }
+    memset(pending, 0, sizeof(pending));
+    yThreadSignalStart(thread);
+    while (!yThreadMustEnd(thread)) {
+        // next is the nearest timeout of our hubs. It can only move earlier
+        // when a hub is stepped, or when a hub is attached or done connecting,
+        // which signals the loop: the other hubs are not looked at until then
+        now = yapiGetTickCount();
+        nbev = yPollerWait(&loop->poller, ready, YPOLLER_MAX_EVENTS, next > now ? next - now : 0, errmsg);
+        if (nbev < 0) {
+            dbglog("network loop %d wait failed (%s)\n", loop->index, errmsg);
+            yApproximateSleep(10);
+            nbev = 0;
+        }
+        scanall = 0;
+        for (i = 0; i < nbev; i++) {
+            if (ready[i] == YPOLLER_WAKEUP_TAG) {
+                yDrainWakeUpSocket(&loop->wuce);
+                scanall = 1;
+            } else {
+                pending[ready[i]] = 1;
+            }
+        }
+        now = yapiGetTickCount();
+        if (now >= next) {
+            scanall = 1;
+        }
+        yEnterCriticalSection(&loop->access);
+        if (scanall) {
+            next = now + 1000;
+            for (slot = loop->index; slot < NBMAX_NET_HUB; slot += yNbNetLoops) {
+                hub = yContext->nethub[slot];
+                if (hub && hub->loop && !hub->loop->detached) {
+                    if (pending[slot] || hub->loop->next_step_tm <= now + NET_LOOP_TIMER_SLACK) {
+                        yNetLoopStepHub(loop, hub, slot);
+                    }
+                    if (!hub->loop->detached && hub->loop->next_step_tm < next) {
+                        next = hub->loop->next_step_tm;
+                    }
+                }
+                pending[slot] = 0;
+            }
+        } else {
+            // only the hubs with a ready socket
+            for (i = 0; i < nbev; i++) {
+                if (ready[i] == YPOLLER_WAKEUP_TAG || !pending[ready[i]]) {
+                    continue;
+                }
+                slot = (int)ready[i];
+                pending[slot] = 0;
+                hub = yContext->nethub[slot];
+                if (hub && hub->loop && !hub->loop->detached) {
+                    yNetLoopStepHub(loop, hub, slot);
+                    if (!hub->loop->detached && hub->loop->next_step_tm < next) {
+                        next = hub->loop->next_step_tm;
+                    }
+                }
+            }
+        }
+        yLeaveCriticalSection(&loop->access);
+    }
+    yThreadSignalEnd(thread);
+    return NULL;
+}
+
+#endif
+
+
+int yNetLoopStart(int nbloops, int pincpu, char *errmsg)
+{
+#ifdef LINUX_API
+    int i, res, nbcpu;
+
+    if (yNbNetLoops > 0) {
+        return YERRMSG(YAPI_INVALID_ARGUMENT, "Network loops are already started");
+    }
+    if (nbloops < 1 || nbloops > NET_LOOP_MAX_LOOPS) {
+        return YERRMSG(YAPI_INVALID_ARGUMENT, "Invalid number of network loops");
+    }
+    nbcpu = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (nbcpu < 1) {
+        nbcpu = 1;
+    }
+    yNetLoops = (yNetLoop*)yMalloc(nbloops * sizeof(yNetLoop));
+    memset(yNetLoops, 0, nbloops * sizeof(yNetLoop));
+    for (i = 0; i < nbloops; i++) {
+        yNetLoop *loop = &yNetLoops[i];
+        loop->index = i;
+        loop->cpu = pincpu ? i % nbcpu : -1;
+        yInitializeCriticalSection(&loop->access);
+        yInitWakeUpSocket(&loop->wuce);
+        res = yPollerInit(&loop->poller, YPOLLER_EPOLL, errmsg);
+        if (!YISERR(res)) {
+            res = yStartWakeUpSocket(&loop->wuce, errmsg);
+        }
+        if (!YISERR(res)) {
+            res = yPollerAdd(&loop->poller, loop->wuce.listensock, YPOLLER_WAKEUP_TAG, errmsg);
+        }
+        if (YISERR(res)) {
+            yNbNetLoops = i + 1;
+            yNetLoopStop();
+            return res;
+        }
+    }
+    // yNbNetLoops must be set before starting the threads since it is
+    // used to dispatch the hubs between loops
+    yNbNetLoops = nbloops;
+    yInitializeCriticalSection(&yNetConnectCS);
+    yCreateEvent(&yNetConnectEvent);
+    yNetConnectHead = 0;
+    yNetConnectCount = 0;
+    memset(yNetConnectThreads, 0, sizeof(yNetConnectThreads));
+    yNetConnectStarted = 1;
+    for (i = 0; i < NET_LOOP_CONNECT_THREADS; i++) {
+        if (yThreadCreate(&yNetConnectThreads[i], yNetConnect_thread, NULL) < 0) {
+            yNetLoopStop();
+            return YERRMSG(YAPI_IO_ERROR, "Unable to start network connection thread");
+        }
+    }
+    for (i = 0; i < nbloops; i++) {
+        if (yThreadCreate(&yNetLoops[i].thread, yNetLoop_thread, &yNetLoops[i]) < 0) {
+            yNetLoopStop();
+            return YERRMSG(YAPI_IO_ERROR, "Unable to start network loop thread");
+        }
+    }
+    return YAPI_SUCCESS;
+#else
+    return YERRMSG(YAPI_NOT_SUPPORTED, "Network loops are only supported on Linux");
+#endif
+}
+
+
+void yNetLoopStop(void)
+{
+    char errmsg[YOCTO_ERRMSG_LEN];
+    u64 timeref;
+    int i;
+
+    if (yNbNetLoops == 0) {
+        return;
+    }
+    for (i = 0; i < yNbNetLoops; i++) {
+        yThreadRequestEnd(&yNetLoops[i].thread);
+        if (yNetLoops[i].wuce.listensock != INVALID_SOCKET) {
+            yDringWakeUpSocket(&yNetLoops[i].wuce, 0, errmsg);
+        }
+    }
+    for (i = 0; i < yNbNetLoops; i++) {
+        yNetLoop *loop = &yNetLoops[i];
+        timeref = yapiGetTickCount();
+        while (yThreadIsRunning(&loop->thread) && (yapiGetTickCount() - timeref < YIO_DEFAULT_TCP_TIMEOUT)) {
+            yApproximateSleep(10);
+        }
+        if (loop->thread.st != YTHREAD_NOT_STARTED) {
+            yThreadKill(&loop->thread);
+        }
+        yFreeWakeUpSocket(&loop->wuce);
+        yPollerFree(&loop->poller);
+        if (loop->fdowner) {
+            yFree(loop->fdowner);
+        }
+        yDeleteCriticalSection(&loop->access);
+    }
+    if (yNetConnectStarted) {
+        for (i = 0; i < NET_LOOP_CONNECT_THREADS; i++) {
+            yThreadRequestEnd(&yNetConnectThreads[i]);
+        }
+        for (i = 0; i < NET_LOOP_CONNECT_THREADS; i++) {
+            ySetEvent(&yNetConnectEvent);
+            timeref = yapiGetTickCount();
+            while (yThreadIsRunning(&yNetConnectThreads[i]) && (yapiGetTickCount() - timeref < YIO_DEFAULT_TCP_TIMEOUT)) {
+                yApproximateSleep(10);
+            }
+            if (yNetConnectThreads[i].st != YTHREAD_NOT_STARTED) {
+                yThreadKill(&yNetConnectThreads[i]);
+            }
+        }
+        yCloseEvent(&yNetConnectEvent);
+        yDeleteCriticalSection(&yNetConnectCS);
+        yNetConnectStarted = 0;
+    }
+    yFree(yNetLoops);
+    yNetLoops = NULL;
+    yNbNetLoops = 0;
+}
+
+
+int yNetLoopAttachHub(HubSt *hub, int slot, char *errmsg)
+{
+    HubLoopSt *lp;
+
+    if (yNbNetLoops == 0) {
+        return YERRMSG(YAPI_INVALID_ARGUMENT, "Network loops are not started");
+    }
+    lp = (HubLoopSt*)yMalloc(sizeof(HubLoopSt));
+    memset(lp, 0, sizeof(HubLoopSt));
+    lp->loopidx = slot % yNbNetLoops;
+    lp->first_notification_connection = 1;
+    // the hub is processed by the loop as soon as the pointer is set
+    hub->loop = lp;
+    return yDringWakeUpSocket(&yNetLoops[lp->loopidx].wuce, 1, errmsg);
+}
+
+
+/*
+ * Ask the loop to close the hub and wait until it is no more processed.
+ * The hub slot in yContext->nethub is cleared before returning.
+ */
+void yNetLoopDetachHub(HubSt *hub, int slot, u64 mstimeout)
+{
+    char errmsg[YOCTO_ERRMSG_LEN];
+    HubLoopSt *lp = hub->loop;
+    yNetLoop *loop = &yNetLoops[lp->loopidx];
+    u64 timeref;
+
+    lp->mustclose = 1;
+    yNetConnectCancel(hub);
+    lp->next_step_tm = 0;
+    yDringWakeUpSocket(&hub->wuce, 0, errmsg);
+    timeref = yapiGetTickCount();
+    while (!lp->detached && (yapiGetTickCount() - timeref < mstimeout)) {
+        yApproximateSleep(10);
+    }
+    // a connection attempt still in progress uses the hub until its own timeout
+    while (lp->connecting) {
+        yApproximateSleep(10);
+    }
+    yEnterCriticalSection(&loop->access);
+#ifdef LINUX_API
+    // the hub did not close in time: drop its sockets from the loop
+    yNetLoopSyncFds(loop, lp, slot, NULL, 0);
+#endif
+    if (lp->ws_connected) {
+        ws_closeBaseSocket(&hub->ws);
+        lp->ws_connected = 0;
+    }
+    lp->detached = 1;
+    yContext->nethub[slot] = NULL;
+    yLeaveCriticalSection(&loop->access);
+}
+
+
 /********************************************************************************
  * UDP funtions
  *******************************************************************************/
@@ -3160,11 +4068,12 @@ static void* ySSDP_thread(void* ctx)
 {
     yThread     *thread=(yThread*)ctx;
     SSDPInfos *SSDP = (SSDPInfos*)thread->ctx;
-    fd_set      fds;
+    yPoller     poller;
+    u64         ready[2 * NB_OS_IFACES];
+    char        errmsg[YOCTO_ERRMSG_LEN];
     u8          buffer[1536];
-    struct timeval timeout;
     int         res, received, i;
-    YSOCKET     sktmax;
+    YSOCKET     skt;
     yFifoBuf    inFifo;
 
 
@@ -3172,55 +4081,28 @@ static void* ySSDP_thread(void* ctx)
     yFifoInit(&inFifo,buffer,sizeof(buffer));
 
     while (!yThreadMustEnd(thread)) {
-        memset(&timeout,0,sizeof(timeout));
-        timeout.tv_sec = (long)1;
-        timeout.tv_usec = (int)0;
         /* wait for data */
-        FD_ZERO(&fds);
-        sktmax = 0;
+        yPollerInit(&poller, YPOLLER_POLL, NULL);
         for (i = 0; i < nbDetectedIfaces; i++) {
-            FD_SET(SSDP->request_sock[i], &fds);
-            if (SSDP->request_sock[i] > sktmax) {
-                sktmax = SSDP->request_sock[i];
-            }
+            yPollerAdd(&poller, SSDP->request_sock[i], (u64)SSDP->request_sock[i], NULL);
             if(SSDP->notify_sock[i] != INVALID_SOCKET) {
-                FD_SET(SSDP->notify_sock[i], &fds);
-                if (SSDP->notify_sock[i] > sktmax) {
-                    sktmax = SSDP->notify_sock[i];
-                }
+                yPollerAdd(&poller, SSDP->notify_sock[i], (u64)SSDP->notify_sock[i], NULL);
             }
         }
-        res = select((int)sktmax + 1, &fds, NULL, NULL, &timeout);
+        res = yPollerWait(&poller, ready, 2 * NB_OS_IFACES, 1000, errmsg);
         if (res<0) {
-    #ifndef WINDOWS_API
-            if(SOCK_ERR ==  EAGAIN){
-                continue;
-            } else
-    #endif
-            {
-                yNetLogErr();
-                break;
-            }
+            dbglog("SSDP: %s\n", errmsg);
+            break;
         }
 
         if(!yContext) continue;
         ySSDPCheckExpiration(SSDP);
-        if (res != 0) {
-            for (i = 0; i < nbDetectedIfaces; i++) {
-                if (FD_ISSET(SSDP->request_sock[i], &fds)) {
-                    received = (int)yrecv(SSDP->request_sock[i], (char*)buffer, sizeof(buffer)-1, 0);
-                    if (received>0) {
-                        buffer[received] = 0;
-                        ySSDP_parseSSPDMessage(SSDP, (char*)buffer, received);
-                    }
-                }
-                if (FD_ISSET(SSDP->notify_sock[i], &fds)) {
-                    received = (int)yrecv(SSDP->notify_sock[i], (char *)buffer, sizeof(buffer)-1, 0);
-                    if (received > 0) {
-                        buffer[received] = 0;
-                        ySSDP_parseSSPDMessage(SSDP, (char*)buffer, received);
-                    }
-                }
+        for (i = 0; i < res; i++) {
+            skt = (YSOCKET)ready[i];
+            received = (int)yrecv(skt, (char*)buffer, sizeof(buffer)-1, 0);
+            if (received>0) {
+                buffer[received] = 0;
+                ySSDP_parseSSPDMessage(SSDP, (char*)buffer, received);
             }
         }
     }
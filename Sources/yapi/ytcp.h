@@ -95,11 +95,37 @@ typedef struct {
     YSOCKET signalsock;
 } WakeUpSocket;
 
+// socket poller (see ytcp.c), YPOLLER_EPOLL falls back to YPOLLER_POLL when unavailable
+#define YPOLLER_POLL        0
+#define YPOLLER_EPOLL       1
+#define YPOLLER_INLINE_FDS  64      // sockets kept in the structure, larger sets are allocated
+#define YPOLLER_MAX_EVENTS  64
+#define YPOLLER_WAKEUP_TAG  ((u64)-1)   // conventional tag for the WakeUpSocket of a set
+
+typedef struct {
+    int     backend;
+    int     epfd;
+    int     nbfds;                      // YPOLLER_POLL only
+    int     maxfds;                     // YPOLLER_POLL only, room in fds and tags
+    YSOCKET *fds;                       // YPOLLER_POLL only, inl_fds or allocated
+    u64     *tags;                      // YPOLLER_POLL only, inl_tags or allocated
+    YSOCKET inl_fds[YPOLLER_INLINE_FDS];
+    u64     inl_tags[YPOLLER_INLINE_FDS];
+} yPoller;
+
+int  yPollerInit(yPoller *poller, int backend, char *errmsg);
+void yPollerFree(yPoller *poller);
+void yPollerClear(yPoller *poller);
+int  yPollerAdd(yPoller *poller, YSOCKET skt, u64 tag, char *errmsg);
+void yPollerRemove(yPoller *poller, YSOCKET skt);
+int  yPollerWait(yPoller *poller, u64 *ready, int maxready, u64 mstimeout, char *errmsg);
+
 void yDupSet(char **storage, const char *val);
 void yInitWakeUpSocket(WakeUpSocket *wuce);
 int  yStartWakeUpSocket(WakeUpSocket *wuce, char *errmsg);
 int  yDringWakeUpSocket(WakeUpSocket *wuce, u8 signal, char *errmsg);
 int  yConsumeWakeUpSocket(WakeUpSocket *wuce, char *errmsg);
+void yDrainWakeUpSocket(WakeUpSocket *wuce);
 void yFreeWakeUpSocket(WakeUpSocket *wuce);
 int yTcpDownload(const char *host, const char *url, u8 **out_buffer, u32 mstimeout, char *errmsg);
 
@@ -114,6 +140,8 @@ int  yReqOpen(struct _RequestSt *tcpreq, int wait_for_start, int tcpchan, const
 int  yReqIsAsync(struct _RequestSt *req);
 int  yReqSelect(struct _RequestSt *tcpreq, u64 ms, char *errmsg);
 int  yReqMultiSelect(struct _RequestSt **tcpreq, int size, u64 ms, WakeUpSocket *wuce, char *errmsg);
+int  yReqMultiPoll(struct _RequestSt **tcpreq, int size, WakeUpSocket *wuce, char *errmsg);
+YSOCKET yReqGetSocket(struct _RequestSt *tcpreq);
 int  yReqIsEof(struct _RequestSt *tcpreq, char *errmsg);
 int  yReqGet(struct _RequestSt *tcpreq, u8 **buffer);
 int  yReqRead(struct _RequestSt *rcoreq, u8 *buffer, int len);
@@ -124,6 +152,13 @@ int  yReqHasPending(struct _HubSt *hub);
 
 void* ws_thread(void* ctx);
 
+// network loops: drive many hubs from a few threads instead of one thread per hub
+int  yNetLoopStart(int nbloops, int pincpu, char *errmsg);
+void yNetLoopStop(void);
+int  yNetLoopAttachHub(struct _HubSt *hub, int slot, char *errmsg);
+void yNetLoopDetachHub(struct _HubSt *hub, int slot, u64 mstimeout);
+void yNetLoopConnect(struct _HubSt *hub);
+
 
 #include "ythread.h"
 
@@ -75,13 +75,52 @@ int    yWaitForEvent(yEvent *ev,int time);
 void   yCloseEvent(yEvent *ev);
 
 
+/*********************************************************************
+ * MEMORY BARRIER (for single producer / single consumer structures)
+ *********************************************************************/
+
+#if defined(_MSC_VER)
+#define yMemoryBarrier()    MemoryBarrier()
+#elif defined(__GNUC__) || defined(__clang__)
+#define yMemoryBarrier()    __sync_synchronize()
+#else
+#define yMemoryBarrier()
+#endif
+
+
+/*********************************************************************
+ * ATOMIC OPERATIONS ON 32-BIT WORDS (for multi-producer structures)
+ * YATOMIC_SUPPORTED is only defined when the compiler provides them
+ *********************************************************************/
+
+#if defined(_MSC_VER)
+#define YATOMIC_SUPPORTED
+#define yAtomicCompareExchange32(ptr,expected,desired) \
+    ((u32)InterlockedCompareExchange((volatile LONG*)(ptr),(LONG)(desired),(LONG)(expected)) == (u32)(expected))
+#define yAtomicIncrement32(ptr)     ((u32)InterlockedIncrement((volatile LONG*)(ptr)))
+#define yAtomicAdd32(ptr,value)     ((u32)InterlockedExchangeAdd((volatile LONG*)(ptr),(LONG)(value)) + (u32)(value))
+#elif defined(__GNUC__) || defined(__clang__)
+#define YATOMIC_SUPPORTED
+#define yAtomicCompareExchange32(ptr,expected,desired) \
+    __sync_bool_compare_and_swap((ptr),(u32)(expected),(u32)(desired))
+#define yAtomicIncrement32(ptr)     __sync_add_and_fetch((ptr),(u32)1)
+#define yAtomicAdd32(ptr,value)     __sync_add_and_fetch((ptr),(u32)(value))
+#endif
+
+
 /*********************************************************************
  * THREAD FUNCTION 
  *********************************************************************/
 #ifdef WIN32
 typedef HANDLE      osThread;
+typedef DWORD       yThreadId;
+#define yThreadSelf()           GetCurrentThreadId()
+#define yThreadIdEqual(a,b)     ((a) == (b))
 #else
 typedef pthread_t   osThread;
+typedef pthread_t   yThreadId;
+#define yThreadSelf()           pthread_self()
+#define yThreadIdEqual(a,b)     pthread_equal((a),(b))
 #endif
 
 typedef enum {
@@ -46,6 +46,10 @@
 #define yySleep(ms)          Sleep(ms)
 #else
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #define yySleep(ms)          usleep(ms*1000)
 #endif
 
@@ -57,13 +61,503 @@
 #include <time.h>
 #include <stdarg.h>
 #include <math.h>
+#include <algorithm>
+#include <deque>
 #include "yapi/yproto.h"
 
 static  yCRITICAL_SECTION   _updateDeviceList_CS;
 static  yCRITICAL_SECTION   _handleEvent_CS;
 
-static  std::vector<YFunction*>     _FunctionCallbacks;
-static  std::vector<YFunction*>     _TimedReportCallbackList;
+// Functions with a value callback (resp. timed report callback), indexed by
+// their function descriptor so that notifications are dispatched without
+// scanning all registered functions. Functions that have not been resolved yet
+// are indexed under Y_FUNCTIONDESCRIPTOR_INVALID. Both indexes, as well as the
+// descriptor of a registered function, are only modified while holding the
+// function callback lock, under which notifications are forwarded.
+typedef std::multimap<YFUN_DESCR,YFunction*> yCallbackIndex;
+
+static  yCallbackIndex              _FunctionCallbacks;
+static  yCallbackIndex              _TimedReportCallbackList;
+
+static yCallbackIndex::iterator yCallbackIndexFind(yCallbackIndex& index, YFUN_DESCR fundescr, YFunction *func)
+{
+    yCallbackIndex::iterator it = index.lower_bound(fundescr);
+
+    while (it != index.end() && it->first == fundescr) {
+        if (it->second == func) {
+            return it;
+        }
+        it++;
+    }
+    return index.end();
+}
+
+static void yCallbackIndexUpdate(yCallbackIndex& index, YFUN_DESCR fundescr, YFunction *func, bool add)
+{
+    yCallbackIndex::iterator it = yCallbackIndexFind(index, fundescr, func);
+
+    if (add) {
+        if (it == index.end()) {
+            index.insert(yCallbackIndex::value_type(fundescr, func));
+        }
+    } else if (it != index.end()) {
+        index.erase(it);
+    }
+}
+
+static void yCallbackIndexMove(yCallbackIndex& index, YFunction *func, YFUN_DESCR olddescr, YFUN_DESCR newdescr)
+{
+    yCallbackIndex::iterator it = yCallbackIndexFind(index, olddescr, func);
+
+    if (it != index.end()) {
+        index.erase(it);
+        index.insert(yCallbackIndex::value_type(newdescr, func));
+    }
+}
+
+// Value and timed report events are passed from the hub and USB threads to
+// yHandleEvents() through a bounded multi-producer ring. Each cell carries a
+// sequence number telling whether it can be written (seq == pos) or read
+// (seq == pos + 1) at a given absolute position, so that producers and the
+// consumer only synchronize through compare-and-swap on the positions.
+// Only the hub and network threads wait for room when the ring is full: the
+// thread of the caller of the API produces events too (device list updates,
+// event handling of the library) and would wait for itself, so its events go
+// to an unbounded overflow list, which yHandleEvents() empties after the ring.
+typedef struct {
+    volatile u32    seq;
+    yapiDataEvent   ev;
+} yDataEventCell;
+
+#define YAPI_DATAEVENT_QUEUE_MASK   (YAPI_DATAEVENT_QUEUE_SIZE - 1)
+#define YAPI_DATAEVENT_BATCH        32
+
+static  yDataEventCell      _evq_cells[YAPI_DATAEVENT_QUEUE_SIZE];
+static  volatile u32        _evq_wrpos;
+static  volatile u32        _evq_rdpos;
+static  volatile u32        _evq_dropped;
+static  volatile u32        _evq_peak;
+static  volatile int        _evq_consuming; // set while a thread runs yHandleEvents
+static  yThreadId           _evq_consumer;  // thread running yHandleEvents, valid when _evq_consuming
+static  std::deque<yapiDataEvent> _evq_overflow;
+static  volatile u32        _evq_overflowCount;
+static  yCRITICAL_SECTION   _evq_overflow_cs;
+
+#ifndef YATOMIC_SUPPORTED
+// no compiler support for atomic operations: emulate them with a lock
+static  yCRITICAL_SECTION   _evq_cs;
+
+static int yEvqCompareExchange(volatile u32 *ptr, u32 expected, u32 desired)
+{
+    int res;
+    yEnterCriticalSection(&_evq_cs);
+    res = (*ptr == expected);
+    if (res) {
+        *ptr = desired;
+    }
+    yLeaveCriticalSection(&_evq_cs);
+    return res;
+}
+
+static u32 yEvqAdd(volatile u32 *ptr, u32 value)
+{
+    u32 res;
+    yEnterCriticalSection(&_evq_cs);
+    res = *ptr + value;
+    *ptr = res;
+    yLeaveCriticalSection(&_evq_cs);
+    return res;
+}
+#define yAtomicCompareExchange32(ptr,expected,desired)  yEvqCompareExchange(ptr,expected,desired)
+#define yAtomicIncrement32(ptr)                         yEvqAdd(ptr,1)
+#define yAtomicAdd32(ptr,value)                         yEvqAdd(ptr,value)
+#endif
+
+static volatile u32  _evq_handled = 0;  // number of events taken by YAPI::HandleEvents
+static volatile u32  _evq_waiting = 0;  // set while a thread is blocked in yapiWaitForEvents
+
+static void yDataEventQueueReset(void)
+{
+    u32 i;
+    for (i = 0; i < YAPI_DATAEVENT_QUEUE_SIZE; i++) {
+        _evq_cells[i].seq = i;
+    }
+    _evq_wrpos = 0;
+    _evq_rdpos = 0;
+    _evq_dropped = 0;
+    _evq_peak = 0;
+    _evq_consuming = 0;
+    _evq_overflow.clear();
+    _evq_overflowCount = 0;
+    yMemoryBarrier();
+}
+
+// Pop the oldest event, return false if the queue is empty
+static bool yDataEventPop(yapiDataEvent *ev)
+{
+    yDataEventCell  *cell;
+    u32             pos = _evq_rdpos;
+    s32             dif;
+
+    for (;;) {
+        cell = &_evq_cells[pos & YAPI_DATAEVENT_QUEUE_MASK];
+        dif = (s32)(cell->seq - (pos + 1));
+        if (dif == 0) {
+            if (yAtomicCompareExchange32(&_evq_rdpos, pos, pos + 1)) {
+                break;
+            }
+        } else if (dif < 0) {
+            return false;
+        }
+        pos = _evq_rdpos;
+    }
+    *ev = cell->ev;
+    yMemoryBarrier();
+    cell->seq = pos + YAPI_DATAEVENT_QUEUE_SIZE;
+    return true;
+}
+
+// Tell if the calling thread is the one running yHandleEvents. The consumer
+// identity is only written by that thread, so it can always recognize itself.
+static bool yIsEventConsumer(void)
+{
+    return _evq_consuming && yThreadIdEqual(_evq_consumer, yThreadSelf());
+}
+
+// Tell if the calling thread may wait for room in the queue: only the hub
+// and network threads may, not the one which has to empty it
+static bool yMayWaitForRoom(void)
+{
+    return !yIsEventConsumer() && !yapiIsApiEventThread();
+}
+
+// Append an event to the overflow list, for the threads which may not wait
+static void yDataEventOverflowPush(const yapiDataEvent *ev)
+{
+    u32 depth;
+
+    yEnterCriticalSection(&_evq_overflow_cs);
+    _evq_overflow.push_back(*ev);
+    _evq_overflowCount = (u32)_evq_overflow.size();
+    yLeaveCriticalSection(&_evq_overflow_cs);
+    depth = YAPI::GetEventQueueDepth();
+    if (depth > _evq_peak) {
+        _evq_peak = depth;
+    }
+    yapiSignalEvents();
+}
+
+// Push an event, applying YAPI::EventQueuePolicy when the queue is full.
+// Return false when the queue is full and the producer must wait for room.
+static bool yDataEventTryPush(const yapiDataEvent *ev)
+{
+    yDataEventCell  *cell;
+    yapiDataEvent   discarded;
+    u32             pos = _evq_wrpos;
+    u32             depth;
+    s32             dif;
+
+    if (_evq_overflowCount > 0 && YAPI::EventQueuePolicy == YAPI::EVENTQUEUE_BLOCK && !yMayWaitForRoom()) {
+        // keep the order of the events of this thread until the list is emptied
+        yDataEventOverflowPush(ev);
+        return true;
+    }
+    for (;;) {
+        cell = &_evq_cells[pos & YAPI_DATAEVENT_QUEUE_MASK];
+        dif = (s32)(cell->seq - pos);
+        if (dif == 0) {
+            if (yAtomicCompareExchange32(&_evq_wrpos, pos, pos + 1)) {
+                break;
+            }
+        } else if (dif < 0) {
+            // queue is full
+            if (YAPI::EventQueuePolicy == YAPI::EVENTQUEUE_DROP_OLDEST) {
+                if (yDataEventPop(&discarded)) {
+                    yAtomicIncrement32(&_evq_dropped);
+                }
+            } else if (YAPI::EventQueuePolicy == YAPI::EVENTQUEUE_BLOCK) {
+                if (yMayWaitForRoom()) {
+                    return false;
+                }
+                // never wait on the thread that is supposed to empty the queue
+                yDataEventOverflowPush(ev);
+                return true;
+            } else {
+                yAtomicIncrement32(&_evq_dropped);
+                return true;
+            }
+        }
+        pos = _evq_wrpos;
+    }
+    cell->ev = *ev;
+    yMemoryBarrier();
+    cell->seq = pos + 1;
+    // approximate high-water mark, only used for monitoring
+    depth = pos + 1 - _evq_rdpos;
+    if ((s32)depth > 0 && depth > _evq_peak) {
+        _evq_peak = depth;
+    }
+    // wake up the thread blocked in YAPI::WaitForEvents, if any
+    yapiSignalEvents();
+    return true;
+}
+
+// Push an event, waiting for room for at most YAPI_DATAEVENT_BLOCK_TIMEOUT ms
+// when the queue is full. yHandleEvents needs the function callback lock to
+// resolve functions, so a producer holding it releases it while waiting.
+static void yDataEventPush(const yapiDataEvent *ev, bool callbackLockHeld)
+{
+    u64 deadline = 0;
+
+    while (!yDataEventTryPush(ev)) {
+        if (deadline == 0) {
+            deadline = yapiGetTickCount() + YAPI_DATAEVENT_BLOCK_TIMEOUT;
+        } else if (yapiGetTickCount() > deadline) {
+            yAtomicIncrement32(&_evq_dropped);
+            return;
+        }
+        if (callbackLockHeld) {
+            yapiUnlockFunctionCallBack(NULL);
+        }
+        yApproximateSleep(1);
+        if (callbackLockHeld) {
+            yapiLockFunctionCallBack(NULL);
+        }
+    }
+}
+
+// Invoke the user callback corresponding to a data event
+static void yDispatchDataEvent(yapiDataEvent *ev)
+{
+    YSensor         *sensor;
+    vector<int>     report;
+
+    switch (ev->type) {
+        case YAPI_FUN_VALUE:
+            ev->fun->_invokeValueCallback((string)ev->value);
+            break;
+        case YAPI_FUN_TIMEDREPORT:
+            if(ev->report[0] <= 2) {
+                sensor = ev->sensor;
+                report.assign(ev->report, ev->report + ev->len);
+                sensor->_invokeTimedReportCallback(sensor->_decodeTimedReport(ev->timestamp, report));
+            }
+            break;
+        case YAPI_FUN_REFRESH:
+            ev->fun->isOnline();
+            break;
+        default:
+            break;
+    }
+}
+
+// Optional pool of threads running the user callbacks (see YAPI::SetCallbackWorkers).
+// Events are routed by function, so that the events of a function are always
+// handled in order by the same worker. The pool is only started, stopped and
+// fed while holding _handleEvent_CS. The worker table is published under
+// _workers_CS, which lets threads check if they are a worker at any time.
+typedef struct {
+    yapiDataEvent   ev;
+    u64             stamp;      // time at which the event was routed to the worker
+} yWorkerEvent;
+
+typedef struct {
+    yThread                     thread;
+    yCRITICAL_SECTION           access;
+    yEvent                      wakeup;     // set when events are queued or when the worker must stop
+    yEvent                      room;       // set when the worker has taken an event
+    std::deque<yWorkerEvent>    queue;
+    yThreadId                   thid;       // identity of the worker thread,
+    bool                        started;    // ... valid once started is set
+    u32                         processed;
+    u64                         totalLatency;
+    u32                         maxLatency;
+    u32                         stalls;
+} yCallbackWorker;
+
+static  yCRITICAL_SECTION   _workers_CS;
+static  yCallbackWorker     *_workers = NULL;
+static  int                 _nbWorkers = 0;
+
+static void* yCallbackWorker_thread(void *ctx)
+{
+    yThread         *thread = (yThread*)ctx;
+    yCallbackWorker *worker = (yCallbackWorker*)thread->ctx;
+    yWorkerEvent    wev;
+    u64             latency;
+
+    yEnterCriticalSection(&_workers_CS);
+    worker->thid = yThreadSelf();
+    worker->started = true;
+    yLeaveCriticalSection(&_workers_CS);
+    yThreadSignalStart(thread);
+    // when asked to stop, handle the events already routed to us first
+    for (;;) {
+        yEnterCriticalSection(&worker->access);
+        if (worker->queue.empty()) {
+            yLeaveCriticalSection(&worker->access);
+            if (yThreadMustEnd(thread)) {
+                break;
+            }
+            yWaitForEvent(&worker->wakeup, 100);
+            continue;
+        }
+        wev = worker->queue.front();
+        worker->queue.pop_front();
+        yLeaveCriticalSection(&worker->access);
+        ySetEvent(&worker->room);
+        try {
+            yDispatchDataEvent(&wev.ev);
+        } catch (std::exception&) {
+            // nobody to report the error to: the exception is dropped, as it
+            // would otherwise end the worker thread
+        }
+        latency = yapiGetTickCount() - wev.stamp;
+        yEnterCriticalSection(&worker->access);
+        worker->processed++;
+        worker->totalLatency += latency;
+        if (latency > worker->maxLatency) {
+            worker->maxLatency = (u32)latency;
+        }
+        yLeaveCriticalSection(&worker->access);
+    }
+    yThreadSignalEnd(thread);
+    return NULL;
+}
+
+static bool yIsCallbackWorker(void)
+{
+    yThreadId   self;
+    bool        res = false;
+    int         i;
+
+    if (!YAPI::_apiInitialized) {
+        return false;
+    }
+    self = yThreadSelf();
+    yEnterCriticalSection(&_workers_CS);
+    for (i = 0; i < _nbWorkers; i++) {
+        if (_workers[i].started && yThreadIdEqual(_workers[i].thid, self)) {
+            res = true;
+            break;
+        }
+    }
+    yLeaveCriticalSection(&_workers_CS);
+    return res;
+}
+
+// Route an event to the worker in charge of its function, waiting for room
+// in the worker queue when it is full (back-pressure on yHandleEvents)
+static void yRouteDataEvent(const yapiDataEvent *ev)
+{
+    YFunction       *fun = (ev->type == YAPI_FUN_TIMEDREPORT ? (YFunction*)ev->sensor : ev->fun);
+    u32             hash = (u32)(((size_t)fun) >> 4) * 2654435761u;
+    yCallbackWorker *worker = &_workers[(hash >> 16) % (u32)_nbWorkers];
+    yWorkerEvent    wev;
+
+    wev.ev = *ev;
+    wev.stamp = yapiGetTickCount();
+    yEnterCriticalSection(&worker->access);
+    if (worker->queue.size() >= YAPI_CALLBACK_WORKER_QUEUE) {
+        worker->stalls++;
+        while (worker->queue.size() >= YAPI_CALLBACK_WORKER_QUEUE && yThreadIsRunning(&worker->thread)) {
+            yLeaveCriticalSection(&worker->access);
+            yWaitForEvent(&worker->room, 100);
+            yEnterCriticalSection(&worker->access);
+        }
+    }
+    worker->queue.push_back(wev);
+    yLeaveCriticalSection(&worker->access);
+    ySetEvent(&worker->wakeup);
+}
+
+// Ask the workers to stop and wait for them: each one ends once it has run
+// the events already routed to it. A worker is never killed, which could
+// leave the callback lock or the locks of the application held, so a user
+// callback that never returns blocks this function.
+static void yStopCallbackWorkers(void)
+{
+    yCallbackWorker *workers = _workers;
+    int             nbWorkers = _nbWorkers;
+    int             i;
+
+    for (i = 0; i < nbWorkers; i++) {
+        yThreadRequestEnd(&workers[i].thread);
+        ySetEvent(&workers[i].wakeup);
+    }
+    for (i = 0; i < nbWorkers; i++) {
+        yCallbackWorker *worker = &workers[i];
+        while (yThreadIsRunning(&worker->thread)) {
+            yApproximateSleep(10);
+        }
+        if (worker->thread.st != YTHREAD_NOT_STARTED) {
+            // the thread has ended: this only joins it
+            yThreadKill(&worker->thread);
+        }
+    }
+    // the workers are recognized as such until they have all ended
+    yEnterCriticalSection(&_workers_CS);
+    _workers = NULL;
+    _nbWorkers = 0;
+    yLeaveCriticalSection(&_workers_CS);
+    for (i = 0; i < nbWorkers; i++) {
+        yCloseEvent(&workers[i].wakeup);
+        yCloseEvent(&workers[i].room);
+        yDeleteCriticalSection(&workers[i].access);
+    }
+    delete[] workers;
+}
+
+static YRETCODE yStartCallbackWorkers(int nbWorkers, string& errmsg)
+{
+    yCallbackWorker *workers = new yCallbackWorker[nbWorkers];
+    int             i;
+
+    for (i = 0; i < nbWorkers; i++) {
+        yCallbackWorker *worker = &workers[i];
+        memset(&worker->thread, 0, sizeof(worker->thread));
+        yInitializeCriticalSection(&worker->access);
+        yCreateEvent(&worker->wakeup);
+        yCreateEvent(&worker->room);
+        worker->started = false;
+        worker->processed = 0;
+        worker->totalLatency = 0;
+        worker->maxLatency = 0;
+        worker->stalls = 0;
+    }
+    yEnterCriticalSection(&_workers_CS);
+    _workers = workers;
+    _nbWorkers = nbWorkers;
+    yLeaveCriticalSection(&_workers_CS);
+    for (i = 0; i < nbWorkers; i++) {
+        if (yThreadCreate(&_workers[i].thread, yCallbackWorker_thread, &_workers[i]) < 0) {
+            yStopCallbackWorkers();
+            errmsg = "Unable to start callback worker thread";
+            return YAPI_IO_ERROR;
+        }
+    }
+    return YAPI_SUCCESS;
+}
+
+// Last advertised value pushed by notification for each function descriptor,
+// used by getters when YAPI::NotificationCacheValidity is set
+typedef struct {
+    string  value;
+    u64     stamp;
+} yPushedValue;
+static  yCRITICAL_SECTION                   _pushedValues_CS;
+static  std::map<YFUN_DESCR,yPushedValue>   _pushedValues;
+
+// Drop the pushed value of a function whose state may have been changed by us
+static void yForgetPushedValue(YFUN_DESCR fundescr)
+{
+    if (YAPI::NotificationCacheValidity <= 0 || YISERR(fundescr)) {
+        return;
+    }
+    yEnterCriticalSection(&_pushedValues_CS);
+    _pushedValues.erase(fundescr);
+    yLeaveCriticalSection(&_pushedValues_CS);
+}
 
 
 const string YFunction::HARDWAREID_INVALID = YAPI_INVALID_STRING;
@@ -101,39 +595,123 @@ vector<string> _strsplit(const string& str, char delimiter)
 
 
 
+YJSONBuffer::YJSONBuffer(const string& src) : _refcount(1), data(src)
+{
+    yInitializeCriticalSection(&_lock);
+}
+
+YJSONBuffer::~YJSONBuffer()
+{
+    yDeleteCriticalSection(&_lock);
+}
+
+YJSONBuffer* YJSONBuffer::addRef()
+{
+    yEnterCriticalSection(&_lock);
+    _refcount++;
+    yLeaveCriticalSection(&_lock);
+    return this;
+}
+
+void YJSONBuffer::release()
+{
+    int refcount;
+    yEnterCriticalSection(&_lock);
+    refcount = --_refcount;
+    yLeaveCriticalSection(&_lock);
+    if (refcount == 0) {
+        delete this;
+    }
+}
+
+void YJSONBuffer::lock()
+{
+    yEnterCriticalSection(&_lock);
+}
+
+void YJSONBuffer::unlock()
+{
+    yLeaveCriticalSection(&_lock);
+}
+
+
+
 YJSONContent* YJSONContent::ParseJson(const string& data, int start, int stop)
 {
-    int cur_pos = YJSONContent::SkipGarbage(data, start, stop);
-    YJSONContent* res;
-    if (data[cur_pos] == '[') {
-        res = new YJSONArray(data, start, stop);
-    } else if (data[cur_pos] == '{') {
-        res = new YJSONObject(data, start, stop);
-    } else if (data[cur_pos] == '"') {
-        res = new YJSONString(data, start, stop);
-    } else {
-        res = new YJSONNumber(data, start, stop);
+    YJSONBuffer *buffer = new YJSONBuffer(data);
+    YJSONContent* res = Create(buffer, start, stop);
+    buffer->release();
+    try {
+        res->parse();
+    } catch (...) {
+        delete res;
+        throw;
     }
-    res->parse();
     return res;
 }
 
+// Create an unparsed node for the value at <start> in a shared buffer
+YJSONContent* YJSONContent::Create(YJSONBuffer *buffer, int start, int stop)
+{
+    int cur_pos = YJSONContent::SkipGarbage(buffer->data, start, stop);
+    char c = (cur_pos < (int)buffer->data.length() ? buffer->data[cur_pos] : 0);
+    if (c == '[') {
+        return new YJSONArray(buffer, start, stop);
+    } else if (c == '{') {
+        return new YJSONObject(buffer, start, stop);
+    } else if (c == '"') {
+        return new YJSONString(buffer, start, stop);
+    } else {
+        return new YJSONNumber(buffer, start, stop);
+    }
+}
+
+// Deep copy of a node (parsed content is copied, source buffer is shared)
+YJSONContent* YJSONContent::Copy(YJSONContent *ref)
+{
+    switch (ref->getJSONType()) {
+    case ARRAY:
+        return new YJSONArray((YJSONArray*)ref);
+    case NUMBER:
+        return new YJSONNumber((YJSONNumber*)ref);
+    case STRING:
+        return new YJSONString((YJSONString*)ref);
+    case OBJECT:
+        return new YJSONObject((YJSONObject*)ref);
+    }
+    return NULL;
+}
+
 YJSONContent::YJSONContent(const string& data, int start, int stop, YJSONType type)
 {
-    _data = data;
+    _buffer = new YJSONBuffer(data);
+    _data_start = start;
+    _data_len = 0;
+    _data_boundary = stop;
+    _type = type;
+}
+
+YJSONContent::YJSONContent(YJSONBuffer *buffer, int start, int stop, YJSONType type)
+{
+    _buffer = buffer->addRef();
     _data_start = start;
+    _data_len = 0;
     _data_boundary = stop;
     _type = type;
 }
 
 YJSONContent::YJSONContent(YJSONType type)
 {
-    _data = "";//todo: check not null
+    _buffer = NULL;
+    _data_start = 0;
+    _data_len = 0;
+    _data_boundary = 0;
+    _type = type;
 }
 
 YJSONContent::YJSONContent(YJSONContent *ref)
 {
-    _data = ref->_data;
+    _buffer = (ref->_buffer ? ref->_buffer->addRef() : NULL);
     _data_start = ref->_data_start;
     _data_boundary = ref->_data_boundary;
     _data_len = ref->_data_len;
@@ -143,7 +721,10 @@ YJSONContent::YJSONContent(YJSONContent *ref)
 
 YJSONContent::~YJSONContent()
 {
-    _data = "";
+    if (_buffer) {
+        _buffer->release();
+        _buffer = NULL;
+    }
 }
 
 YJSONType YJSONContent::getJSONType()
@@ -171,10 +752,10 @@ string YJSONContent::FormatError(const string& errmsg, int cur_pos)
         ststart = 0;
     if (stend > _data_boundary)
         stend = _data_boundary;
-    if (_data == "") {//todo: check not null
+    if (_buffer == NULL || _buffer->data == "") {
         return errmsg;
     }
-    return errmsg + " near " + _data.substr(ststart, cur_pos - ststart) + _data.substr(cur_pos, stend - cur_pos);
+    return errmsg + " near " + _buffer->data.substr(ststart, cur_pos - ststart) + _buffer->data.substr(cur_pos, stend - cur_pos);
 }
 
 
@@ -182,6 +763,8 @@ string YJSONContent::FormatError(const string& errmsg, int cur_pos)
 YJSONArray::YJSONArray(const string& data, int start, int stop) : YJSONContent(data, start, stop, ARRAY)
 { }
 
+YJSONArray::YJSONArray(YJSONBuffer *buffer, int start, int stop) : YJSONContent(buffer, start, stop, ARRAY)
+{ }
 
 YJSONArray::YJSONArray() : YJSONContent(ARRAY)
 { }
@@ -189,33 +772,7 @@ YJSONArray::YJSONArray() : YJSONContent(ARRAY)
 YJSONArray::YJSONArray(YJSONArray *ref) : YJSONContent(ref)
 {
     for (unsigned i = 0; i < ref->_arrayValue.size(); i++) {
-        YJSONType type = ref->_arrayValue[i]->getJSONType();
-        switch (type) {
-        case ARRAY:
-            {
-                YJSONArray* tmp = new YJSONArray((YJSONArray*)ref->_arrayValue[i]);
-                _arrayValue.push_back(tmp);
-            }
-            break;
-        case NUMBER:
-            {
-                YJSONNumber* tmp = new YJSONNumber((YJSONNumber*)ref->_arrayValue[i]);
-                _arrayValue.push_back(tmp);
-            }
-            break;
-        case STRING:
-            {
-                YJSONString* tmp = new YJSONString((YJSONString*)ref->_arrayValue[i]);
-                _arrayValue.push_back(tmp);
-            }
-            break;
-        case OBJECT:
-            {
-                YJSONObject* tmp = new YJSONObject((YJSONObject*)ref->_arrayValue[i]);
-                _arrayValue.push_back(tmp);
-            }
-            break;
-        }
+        _arrayValue.push_back(YJSONContent::Copy(ref->_arrayValue[i]));
     }
 }
 
@@ -235,47 +792,23 @@ int YJSONArray::length()
 
 int YJSONArray::parse()
 {
-    int cur_pos = SkipGarbage(_data, _data_start, _data_boundary);
+    const string& data = _buffer->data;
+    int cur_pos = SkipGarbage(data, _data_start, _data_boundary);
 
-    if (_data[cur_pos] != '[') {
+    if (data[cur_pos] != '[') {
         throw YAPI_Exception(YAPI_IO_ERROR, FormatError("Opening braces was expected", cur_pos));
     }
     cur_pos++;
     Tjstate state = JWAITFORDATA;
 
     while (cur_pos < _data_boundary) {
-        char sti = _data[cur_pos];
+        char sti = data[cur_pos];
         switch (state) {
             case JWAITFORDATA:
-                if (sti == '{') {
-                    YJSONObject* jobj = new YJSONObject(_data, cur_pos, _data_boundary);
-                    int len = jobj->parse();
-                    cur_pos += len;
-                    _arrayValue.push_back(jobj);
-                    state = JWAITFORNEXTARRAYITEM;
-                    //cur_pos is already incremented
-                    continue;
-                } else if (sti == '[') {
-                    YJSONArray* jobj = new YJSONArray(_data, cur_pos, _data_boundary);
-                    int len = jobj->parse();
-                    cur_pos += len;
-                    _arrayValue.push_back(jobj);
-                    state = JWAITFORNEXTARRAYITEM;
-                    //cur_pos is already incremented
-                    continue;
-                } else if (sti == '"') {
-                    YJSONString* jobj = new YJSONString(_data, cur_pos, _data_boundary);
-                    int len = jobj->parse();
-                    cur_pos += len;
-                    _arrayValue.push_back(jobj);
-                    state = JWAITFORNEXTARRAYITEM;
-                    //cur_pos is already incremented
-                    continue;
-                } else if (sti == '-' || (sti >= '0' && sti <= '9')) {
-                    YJSONNumber* jobj = new YJSONNumber(_data, cur_pos, _data_boundary);
-                    int len = jobj->parse();
-                    cur_pos += len;
+                if (sti == '{' || sti == '[' || sti == '"' || sti == '-' || (sti >= '0' && sti <= '9')) {
+                    YJSONContent* jobj = YJSONContent::Create(_buffer, cur_pos, _data_boundary);
                     _arrayValue.push_back(jobj);
+                    cur_pos += jobj->parse();
                     state = JWAITFORNEXTARRAYITEM;
                     //cur_pos is already incremented
                     continue;
@@ -306,6 +839,8 @@ int YJSONArray::parse()
     throw YAPI_Exception(YAPI_IO_ERROR, FormatError("unexpected end of data", cur_pos));
 }
 
+
+
 YJSONObject* YJSONArray::getYJSONObject(int i)
 {
     return (YJSONObject*)_arrayValue[i];
@@ -382,6 +917,9 @@ string YJSONArray::toString()
 YJSONString::YJSONString(const string& data, int start, int stop) : YJSONContent(data, start, stop, STRING)
 { }
 
+YJSONString::YJSONString(YJSONBuffer *buffer, int start, int stop) : YJSONContent(buffer, start, stop, STRING)
+{ }
+
 YJSONString::YJSONString() : YJSONContent(STRING)
 { }
 
@@ -392,10 +930,11 @@ YJSONString::YJSONString(YJSONString *ref) : YJSONContent(ref)
 
 int YJSONString::parse()
 {
+    const string& data = _buffer->data;
     string value = "";
-    int cur_pos = SkipGarbage(_data, _data_start, _data_boundary);
+    int cur_pos = SkipGarbage(data, _data_start, _data_boundary);
 
-    if (_data[cur_pos] != '"') {
+    if (data[cur_pos] != '"') {
         throw YAPI_Exception(YAPI_IO_ERROR, FormatError("double quote was expected", cur_pos));
     }
     cur_pos++;
@@ -403,15 +942,15 @@ int YJSONString::parse()
     Tjstate state = JWAITFORSTRINGVALUE;
 
     while (cur_pos < _data_boundary) {
-        unsigned char sti = _data[cur_pos];
+        unsigned char sti = data[cur_pos];
         switch (state) {
         case JWAITFORSTRINGVALUE:
             if (sti == '\\') {
-                value += _data.substr(str_start, cur_pos - str_start);
+                value += data.substr(str_start, cur_pos - str_start);
                 str_start = cur_pos;
                 state = JWAITFORSTRINGVALUE_ESC;
             } else if (sti == '"') {
-                value += _data.substr(str_start, cur_pos - str_start);
+                value += data.substr(str_start, cur_pos - str_start);
                 _stringValue = value;
                 _data_len = (cur_pos + 1) - _data_start;
                 return _data_len;
@@ -492,6 +1031,9 @@ string YJSONString::toJSON()
 YJSONNumber::YJSONNumber(const string& data, int start, int stop) : YJSONContent(data, start, stop, NUMBER), _intValue(0),_doubleValue(0),_isFloat(false)
 { }
 
+YJSONNumber::YJSONNumber(YJSONBuffer *buffer, int start, int stop) : YJSONContent(buffer, start, stop, NUMBER), _intValue(0),_doubleValue(0),_isFloat(false)
+{ }
+
 YJSONNumber::YJSONNumber(YJSONNumber *ref) : YJSONContent(ref)
 {
     _intValue = ref->_intValue;
@@ -503,24 +1045,25 @@ YJSONNumber::YJSONNumber(YJSONNumber *ref) : YJSONContent(ref)
 int YJSONNumber::parse()
 {
 
+    const string& data = _buffer->data;
     bool neg = false;
     int start;
     char sti;
-    int cur_pos = SkipGarbage(_data, _data_start, _data_boundary);
-    sti = _data[cur_pos];
+    int cur_pos = SkipGarbage(data, _data_start, _data_boundary);
+    sti = data[cur_pos];
     if (sti == '-') {
         neg = true;
         cur_pos++;
     }
     start = cur_pos;
     while (cur_pos < _data_boundary) {
-        sti = _data[cur_pos];
+        sti = data[cur_pos];
         if (sti == '.' && _isFloat == false) {
-            string int_part = _data.substr(start, cur_pos - start);
+            string int_part = data.substr(start, cur_pos - start);
             _intValue = atoi((int_part).c_str());
             _isFloat = true;
         } else if (sti < '0' || sti > '9') {
-            string numberpart = _data.substr(start, cur_pos - start);
+            string numberpart = data.substr(start, cur_pos - start);
             if (_isFloat) {
                 _doubleValue = atof((numberpart).c_str());
             } else {
@@ -588,82 +1131,232 @@ YJSONObject::YJSONObject(const string& data) : YJSONContent(data, 0, (int)data.l
 YJSONObject::YJSONObject(const string& data, int start, int len) : YJSONContent(data, start, len, OBJECT)
 { }
 
+YJSONObject::YJSONObject(YJSONBuffer *buffer, int start, int len) : YJSONContent(buffer, start, len, OBJECT)
+{ }
+
 YJSONObject::YJSONObject(YJSONObject *ref) : YJSONContent(ref)
 {
+    vector<YJSONContent*> nodes;
+    unsigned i;
 
-    for (unsigned i = 0; i < ref->_keys.size(); i++) {
-        string key = ref->_keys[i];
-        _keys.push_back(key);
-        YJSONType type = ref->_parsed[key]->getJSONType();
-        switch (type) {
-        case ARRAY:
-            _parsed[key] = new YJSONArray((YJSONArray*)ref->_parsed[key]);
-            break;
-        case NUMBER:
-            _parsed[key] = new YJSONNumber((YJSONNumber*)ref->_parsed[key]);
-            break;
-        case STRING:
-            _parsed[key] = new YJSONString((YJSONString*)ref->_parsed[key]);
-            break;
-        case OBJECT:
-            _parsed[key] = new YJSONObject((YJSONObject*)ref->_parsed[key]);
-            break;
-        }
+    // values not yet accessed in ref stay unparsed in the copy as well
+    ref->_buffer->lock();
+    for (i = 0; i < ref->_members.size(); i++) {
+        nodes.push_back(ref->_members[i].node);
+    }
+    ref->_buffer->unlock();
+    for (i = 0; i < ref->_members.size(); i++) {
+        addMember(ref->_members[i].key, ref->_members[i].value_start, nodes[i] ? YJSONContent::Copy(nodes[i]) : NULL);
     }
+    _index = ref->_index;
 }
 
 YJSONObject::~YJSONObject()
 {
     //printf("relase YJSONObject\n");
-    for (unsigned i = 0; i < _keys.size(); i++) {
-        delete _parsed[_keys[i]];
+    for (unsigned i = 0; i < _members.size(); i++) {
+        if (_members[i].node) {
+            delete _members[i].node;
+        }
     }
-    _parsed.clear();
-    _keys.clear();
+    _members.clear();
+    _index.clear();
 }
 
-int YJSONObject::parse()
+void YJSONObject::addMember(const string& key, int value_start, YJSONContent *node)
 {
-    string current_name = "";
-    int name_start = _data_start;
-    int cur_pos = SkipGarbage(_data, _data_start, _data_boundary);
+    YJSONMember member;
+    member.key = key;
+    member.value_start = value_start;
+    member.node = node;
+    _members.push_back(member);
+}
 
-    if (_data.length() <= (unsigned)cur_pos || _data[cur_pos] != '{') {
-        throw YAPI_Exception(YAPI_IO_ERROR, FormatError("Opening braces was expected", cur_pos));
+static unsigned yJsonKeyHash(const string& key)
+{
+    // FNV-1a
+    unsigned hash = 2166136261u;
+    for (unsigned i = 0; i < key.length(); i++) {
+        hash = (hash ^ (u8)key[i]) * 16777619u;
     }
-    cur_pos++;
-    Tjstate state = JWAITFORNAME;
+    return hash;
+}
 
-    while (cur_pos < _data_boundary) {
-        char sti = _data[cur_pos];
-        switch (state) {
-            case JWAITFORNAME:
-                if (sti == '"') {
-                    state = JWAITFORENDOFNAME;
-                    name_start = cur_pos + 1;
-                } else if (sti == '}') {
-                    _data_len = cur_pos + 1 - _data_start;
-                    return _data_len;
-                } else {
-                    if (sti != ' ' && sti != '\n' && sti != '\r') {
-                        throw YAPI_Exception(YAPI_IO_ERROR, FormatError("invalid char: was expecting \"", cur_pos));
-                    }
-                }
-                break;
-            case JWAITFORENDOFNAME:
-                if (sti == '"') {
-                    current_name = _data.substr(name_start, cur_pos - name_start);
-                    state = JWAITFORCOLON;
+void YJSONObject::buildIndex()
+{
+    unsigned size = 16, mask, i;
 
-                } else {
-                    if (sti < 32) {
-                        throw YAPI_Exception(YAPI_IO_ERROR, FormatError("invalid char: was expecting an identifier compliant char", cur_pos));
-                    }
-                }
-                break;
-            case JWAITFORCOLON:
-                if (sti == ':') {
-                    state = JWAITFORDATA;
+    _index.clear();
+    if (_members.size() <= YJSON_INDEX_THRESHOLD) {
+        return;
+    }
+    while (size < 2 * _members.size()) {
+        size *= 2;
+    }
+    mask = size - 1;
+    _index.resize(size, -1);
+    for (i = 0; i < _members.size(); i++) {
+        unsigned h = yJsonKeyHash(_members[i].key) & mask;
+        // on duplicate keys, the last one wins
+        while (_index[h] >= 0 && _members[_index[h]].key != _members[i].key) {
+            h = (h + 1) & mask;
+        }
+        _index[h] = (int)i;
+    }
+}
+
+int YJSONObject::findMember(const string& key)
+{
+    if (_index.empty()) {
+        for (int i = (int)_members.size() - 1; i >= 0; i--) {
+            if (_members[i].key == key) {
+                return i;
+            }
+        }
+        return -1;
+    }
+    unsigned mask = (unsigned)_index.size() - 1;
+    unsigned h = yJsonKeyHash(key) & mask;
+    while (_index[h] >= 0) {
+        if (_members[_index[h]].key == key) {
+            return _index[h];
+        }
+        h = (h + 1) & mask;
+    }
+    return -1;
+}
+
+// Return the value node of a member, parsing it on first access. Nodes can
+// be shared between threads (device API cache), so the node is published
+// under the buffer lock and a concurrent duplicate is discarded.
+YJSONContent* YJSONObject::getMember(int idx)
+{
+    YJSONMember *member = &_members[idx];
+    YJSONContent *node, *res;
+
+    _buffer->lock();
+    res = member->node;
+    _buffer->unlock();
+    if (res) {
+        return res;
+    }
+    node = YJSONContent::Create(_buffer, member->value_start, _data_boundary);
+    try {
+        node->parse();
+    } catch (...) {
+        delete node;
+        throw;
+    }
+    _buffer->lock();
+    if (member->node == NULL) {
+        member->node = node;
+        node = NULL;
+    }
+    res = member->node;
+    _buffer->unlock();
+    if (node) {
+        delete node;
+    }
+    return res;
+}
+
+YJSONContent* YJSONObject::getExisting(const string& key)
+{
+    int idx = findMember(key);
+    if (idx < 0) {
+        throw YAPI_Exception(YAPI_INVALID_ARGUMENT, "JSON member not found: " + key);
+    }
+    return getMember(idx);
+}
+
+// Return the offset just past the JSON value starting at <pos>, or -1 if the
+// value is truncated
+static int yJsonSkipValue(const string& data, int pos, int boundary)
+{
+    int depth = 0;
+    char c = data[pos];
+
+    if (c == '-' || (c >= '0' && c <= '9')) {
+        while (pos < boundary && ((c = data[pos]) == '-' || c == '.' || (c >= '0' && c <= '9'))) {
+            pos++;
+        }
+        return (pos < boundary ? pos : -1);
+    }
+    while (pos < boundary) {
+        c = data[pos];
+        if (c == '"') {
+            pos++;
+            while (pos < boundary && data[pos] != '"') {
+                if (data[pos] == '\\') pos++;
+                pos++;
+            }
+            if (pos >= boundary) {
+                return -1;
+            }
+        } else if (c == '{' || c == '[') {
+            depth++;
+        } else if (c == '}' || c == ']') {
+            depth--;
+        }
+        pos++;
+        if (depth == 0) {
+            return pos;
+        }
+    }
+    return -1;
+}
+
+int YJSONObject::parse()
+{
+    const string& data = _buffer->data;
+    string current_name = "";
+    int name_start = _data_start;
+    int cur_pos = SkipGarbage(data, _data_start, _data_boundary);
+
+    if (data.length() <= (unsigned)cur_pos || data[cur_pos] != '{') {
+        throw YAPI_Exception(YAPI_IO_ERROR, FormatError("Opening braces was expected", cur_pos));
+    }
+    for (unsigned i = 0; i < _members.size(); i++) {
+        if (_members[i].node) {
+            delete _members[i].node;
+        }
+    }
+    _members.clear();
+    _index.clear();
+    cur_pos++;
+    Tjstate state = JWAITFORNAME;
+
+    while (cur_pos < _data_boundary) {
+        char sti = data[cur_pos];
+        switch (state) {
+            case JWAITFORNAME:
+                if (sti == '"') {
+                    state = JWAITFORENDOFNAME;
+                    name_start = cur_pos + 1;
+                } else if (sti == '}') {
+                    _data_len = cur_pos + 1 - _data_start;
+                    buildIndex();
+                    return _data_len;
+                } else {
+                    if (sti != ' ' && sti != '\n' && sti != '\r') {
+                        throw YAPI_Exception(YAPI_IO_ERROR, FormatError("invalid char: was expecting \"", cur_pos));
+                    }
+                }
+                break;
+            case JWAITFORENDOFNAME:
+                if (sti == '"') {
+                    current_name = data.substr(name_start, cur_pos - name_start);
+                    state = JWAITFORCOLON;
+
+                } else {
+                    if (sti < 32) {
+                        throw YAPI_Exception(YAPI_IO_ERROR, FormatError("invalid char: was expecting an identifier compliant char", cur_pos));
+                    }
+                }
+                break;
+            case JWAITFORCOLON:
+                if (sti == ':') {
+                    state = JWAITFORDATA;
                 } else {
                     if (sti != ' ' && sti != '\n' && sti != '\r') {
                         throw YAPI_Exception(YAPI_IO_ERROR, FormatError("invalid char: was expecting \"", cur_pos));
@@ -671,39 +1364,14 @@ int YJSONObject::parse()
                 }
                 break;
             case JWAITFORDATA:
-                if (sti == '{') {
-                    YJSONObject* jobj = new YJSONObject(_data, cur_pos, _data_boundary);
-                    int len = jobj->parse();
-                    cur_pos += len;
-                    _parsed[current_name] = jobj;
-                    _keys.push_back(current_name);
-                    state = JWAITFORNEXTSTRUCTMEMBER;
-                    //cur_pos is already incremented
-                    continue;
-                } else if (sti == '[') {
-                    YJSONArray* jobj = new YJSONArray(_data, cur_pos, _data_boundary);
-                    int len = jobj->parse();
-                    cur_pos += len;
-                    _parsed[current_name] = jobj;
-                    _keys.push_back(current_name);
-                    state = JWAITFORNEXTSTRUCTMEMBER;
-                    //cur_pos is already incremented
-                    continue;
-                } else if (sti == '"') {
-                    YJSONString* jobj = new YJSONString(_data, cur_pos, _data_boundary);
-                    int len = jobj->parse();
-                    cur_pos += len;
-                    _parsed[current_name] = jobj;
-                    _keys.push_back(current_name);
-                    state = JWAITFORNEXTSTRUCTMEMBER;
-                    //cur_pos is already incremented
-                    continue;
-                } else if (sti == '-' || (sti >= '0' && sti <= '9')) {
-                    YJSONNumber* jobj = new YJSONNumber(_data, cur_pos, _data_boundary);
-                    int len = jobj->parse();
-                    cur_pos += len;
-                    _parsed[current_name] = jobj;
-                    _keys.push_back(current_name);
+                if (sti == '{' || sti == '[' || sti == '"' || sti == '-' || (sti >= '0' && sti <= '9')) {
+                    // only locate the value here, it is parsed on first access
+                    int next_pos = yJsonSkipValue(data, cur_pos, _data_boundary);
+                    if (next_pos < 0) {
+                        throw YAPI_Exception(YAPI_IO_ERROR, FormatError("unexpected end of data", cur_pos));
+                    }
+                    addMember(current_name, cur_pos, NULL);
+                    cur_pos = next_pos;
                     state = JWAITFORNEXTSTRUCTMEMBER;
                     //cur_pos is already incremented
                     continue;
@@ -717,6 +1385,7 @@ int YJSONObject::parse()
                     name_start = cur_pos + 1;
                 } else if (sti == '}') {
                     _data_len = cur_pos + 1 - _data_start;
+                    buildIndex();
                     return _data_len;
                 } else {
                     if (sti != ' ' && sti != '\n' && sti != '\r') {
@@ -734,83 +1403,100 @@ int YJSONObject::parse()
 
 bool YJSONObject::has(const string& key)
 {
-    if (_parsed.find(key) == _parsed.end()) {
-        return false;
-    } else {
-        return true;
-    }
+    return findMember(key) >= 0;
 }
 
 YJSONObject* YJSONObject::getYJSONObject(const string& key)
 {
-    return (YJSONObject*)_parsed[key];
+    return (YJSONObject*)get(key);
 }
 
 YJSONString* YJSONObject::getYJSONString(const string& key)
 {
-    return (YJSONString*)_parsed[key];
+    return (YJSONString*)get(key);
 }
 
 YJSONArray* YJSONObject::getYJSONArray(const string& key)
 {
-    return (YJSONArray*)_parsed[key];
+    return (YJSONArray*)get(key);
 }
 
 vector<string> YJSONObject::keys()
 {
     vector<string> v;
-    for (map<string, YJSONContent*>::iterator it = _parsed.begin(); it != _parsed.end(); ++it) {
-        v.push_back(it->first);
+    for (unsigned i = 0; i < _members.size(); i++) {
+        v.push_back(_members[i].key);
     }
+    // sorted and unique, as returned by earlier versions
+    std::sort(v.begin(), v.end());
+    v.erase(std::unique(v.begin(), v.end()), v.end());
     return v;
 }
 
 YJSONNumber* YJSONObject::getYJSONNumber(const string& key)
 {
-    return (YJSONNumber*)_parsed[key];
+    return (YJSONNumber*)get(key);
 }
 
 string YJSONObject::getString(const string& key)
 {
-    YJSONString* ystr = (YJSONString*)_parsed[key];
+    YJSONString* ystr = (YJSONString*)getExisting(key);
     return ystr->getString();
 }
 
 int YJSONObject::getInt(const string& key)
 {
-    YJSONNumber* yint = (YJSONNumber*)_parsed[key];
+    YJSONNumber* yint = (YJSONNumber*)getExisting(key);
     return yint->getInt();
 }
 
 YJSONContent* YJSONObject::get(const string& key)
 {
-    return _parsed[key];
+    int idx = findMember(key);
+    if (idx < 0) {
+        return NULL;
+    }
+    return getMember(idx);
 }
 
 long YJSONObject::getLong(const string& key)
 {
-    YJSONNumber* yint = (YJSONNumber*)_parsed[key];
+    YJSONNumber* yint = (YJSONNumber*)getExisting(key);
     return yint->getLong();
 }
 
 double YJSONObject::getDouble(const string& key)
 {
-    YJSONNumber* yint = (YJSONNumber*)_parsed[key];
+    YJSONNumber* yint = (YJSONNumber*)getExisting(key);
     return yint->getDouble();
 }
 
+// Replace the value of an existing member. The previous value node (NULL if
+// it was never accessed) is returned to the caller, who becomes its owner.
+bool YJSONObject::replace(const string& key, YJSONContent *node, YJSONContent **previous)
+{
+    int idx = findMember(key);
+    if (idx < 0) {
+        return false;
+    }
+    _buffer->lock();
+    *previous = _members[idx].node;
+    _members[idx].node = node;
+    _buffer->unlock();
+    return true;
+}
+
 string YJSONObject::toJSON()
 {
     string res = "{";
     string sep = "";
     unsigned int i;
-    for (i = 0; i < _keys.size(); i++) {
-        string key = _keys[i];
-        YJSONContent* subContent = _parsed[key];
+    for (i = 0; i < _members.size(); i++) {
+        YJSONContent* subContent = getMember(i);
         string subres = subContent->toJSON();
         res += sep;
         res += '"';
-        res += key;
+        res += _members[i].key;
         res += "\":";
         res += subres;
         sep = ",";
@@ -824,13 +1510,12 @@ string YJSONObject::toString()
     string res = "{";
     string sep = "";
     unsigned int i;
-    for (i = 0; i < _keys.size(); i++) {
-        string key = _keys[i];
-        YJSONContent* subContent = _parsed[key];
+    for (i = 0; i < _members.size(); i++) {
+        YJSONContent* subContent = getMember(i);
         string subres = subContent->toString();
         res += sep;
         res += '"';
-        res += key;
+        res += _members[i].key;
         res += "\":";
         res += subres;
         sep = ",";
@@ -844,14 +1529,14 @@ string YJSONObject::toString()
 void YJSONObject::parseWithRef(YJSONObject* reference)
 {
     if (reference != NULL) {
+        YJSONArray* yzon = new YJSONArray(_buffer, _data_start, _data_boundary);
         try {
-            YJSONArray* yzon = new YJSONArray(_data, _data_start, _data_boundary);
             yzon->parse();
             convert(reference, yzon);
             delete yzon;
             return;
         } catch (std::exception) {
-
+            delete yzon;
         }
     }
     this->parse();
@@ -866,36 +1551,22 @@ void YJSONObject::convert(YJSONObject* reference, YJSONArray* newArray)
         YJSONContent* reference_item = reference->get(key);
         YJSONType type = item->getJSONType();
         if (type == reference_item->getJSONType()) {
-            switch (type) {
-            case ARRAY:
-                _parsed[key] = new YJSONArray((YJSONArray*)item);
-                break;
-            case NUMBER:
-                _parsed[key] = new YJSONNumber((YJSONNumber*)item);
-                break;
-            case STRING:
-                _parsed[key] = new YJSONString((YJSONString*)item);
-                break;
-            case OBJECT:
-                _parsed[key] = new YJSONObject((YJSONObject*)item);
-                break;
-            }
-            _keys.push_back(key);
+            addMember(key, item->_data_start, YJSONContent::Copy(item));
         } else if (type == ARRAY && reference_item->getJSONType() == OBJECT) {
-            YJSONObject* jobj = new YJSONObject(item->_data, item->_data_start, reference_item->_data_boundary);
+            YJSONObject* jobj = new YJSONObject(item->_buffer, item->_data_start, reference_item->_data_boundary);
+            addMember(key, item->_data_start, jobj);
             jobj->convert((YJSONObject*) reference_item, (YJSONArray*) item);
-            _parsed[key] =jobj;
-            _keys.push_back(key);
         } else {
             throw YAPI_Exception(YAPI_IO_ERROR,"Unable to convert yzon struct");
 
         }
     }
+    buildIndex();
 }
 
 string YJSONObject::getKeyFromIdx(int i)
 {
-    return _keys[i];
+    return _members[i].key;
 }
 
 
@@ -906,7 +1577,18 @@ string YJSONObject::getKeyFromIdx(int i)
 YDataStream::YDataStream(YFunction *parent, YDataSet& dataset, const vector<int>& encoded)
 {
     _parent   = parent;
+    _colCount = 0;
+    _colRows  = 0;
     this->_initFromDataSet(&dataset, encoded);
+    // size of a closed stream, as announced in its header
+    _closedWordCount = 0;
+    if (_isClosed) {
+        if (_isAvg) {
+            _closedWordCount = _nRows * (_isScal32 ? 6 : 4);
+        } else {
+            _closedWordCount = _nRows * (_isScal && !(_isScal32) ? 1 : 2);
+        }
+    }
 }
 
 YDataStream::~YDataStream()
@@ -916,6 +1598,206 @@ YDataStream::~YDataStream()
     _calraw.clear();
     _calref.clear();
     _values.clear();
+    _columns.clear();
+    _words.clear();
+}
+
+// Decode the words of a stream, as encoded in its JSON string, into columns
+int YDataStream::_decodeStreamData(const string& encoded)
+{
+    int nwords = (int)encoded.size();
+
+    _values.clear();
+    // shrinking the buffer keeps its capacity, so reloading does not reallocate
+    _words.resize(nwords);
+    if (nwords > 0) {
+        _words.resize(YAPI::_decodeWords(encoded.data(), nwords, &_words[0], nwords));
+    }
+    this->_decodeStreamWords();
+    return YAPI_SUCCESS;
+}
+
+// Decode the raw words in _words into columns
+void YDataStream::_decodeStreamWords(void)
+{
+    const int   *w;
+    double      *mincol, *avgcol, *maxcol;
+    int         nwords, nrows, i, idx;
+
+    nwords = (int)_words.size();
+    w = (nwords > 0 ? &_words[0] : NULL);
+    // same layouts as _decodeVal/_decodeAvg per row, but the raw words are
+    // first gathered into columns, which are then scaled in tight loops
+    if (_isAvg) {
+        nrows = nwords / (_isScal32 ? 6 : 4);
+        _colCount = 3;
+    } else if (_isScal && !(_isScal32)) {
+        nrows = nwords;
+        _colCount = 1;
+    } else {
+        nrows = nwords / 2;
+        _colCount = 1;
+    }
+    // the buffer keeps its capacity, so reloading a stream does not reallocate
+    _columns.resize(_colCount * nrows);
+    _colRows = nrows;
+    _nRows = nrows;
+    if (nrows == 0) {
+        return;
+    }
+    mincol = &_columns[0];
+    if (_isAvg) {
+        avgcol = mincol + nrows;
+        maxcol = avgcol + nrows;
+        if (_isScal32) {
+            for (i = 0, idx = 0; i < nrows; i++, idx += 6) {
+                mincol[i] = w[idx + 2] + (((w[idx + 3]) << (16)));
+                avgcol[i] = w[idx] + (((((w[idx + 1]) ^ (0x8000))) << (16)));
+                maxcol[i] = w[idx + 4] + (((w[idx + 5]) << (16)));
+            }
+        } else {
+            for (i = 0, idx = 0; i < nrows; i++, idx += 4) {
+                mincol[i] = w[idx];
+                avgcol[i] = w[idx + 2] + (((w[idx + 3]) << (16)));
+                maxcol[i] = w[idx + 1];
+            }
+        }
+        this->_scaleValColumn(mincol, nrows);
+        this->_scaleAvgColumn(avgcol, nrows);
+        this->_scaleValColumn(maxcol, nrows);
+    } else if (_isScal && !(_isScal32)) {
+        for (i = 0; i < nrows; i++) {
+            mincol[i] = w[i];
+        }
+        this->_scaleValColumn(mincol, nrows);
+    } else {
+        for (i = 0, idx = 0; i < nrows; i++, idx += 2) {
+            mincol[i] = w[idx] + (((((w[idx + 1]) ^ (0x8000))) << (16)));
+        }
+        this->_scaleAvgColumn(mincol, nrows);
+    }
+}
+
+// Same as _decodeVal, applied in place to a column of raw words
+void YDataStream::_scaleValColumn(double *col, int count)
+{
+    double  offset = _offset;
+    double  scale = _scale;
+    int     i;
+
+    if (_isScal32) {
+        for (i = 0; i < count; i++) {
+            col[i] = col[i] / 1000.0;
+        }
+    } else if (_isScal) {
+        for (i = 0; i < count; i++) {
+            col[i] = (col[i] - offset) / scale;
+        }
+    } else {
+        for (i = 0; i < count; i++) {
+            col[i] = YAPI::_decimalToDouble((s16)(int)col[i]);
+        }
+    }
+    this->_calibrateColumn(col, count);
+}
+
+// Same as _decodeAvg (for a count of 1), applied in place to a column of raw words
+void YDataStream::_scaleAvgColumn(double *col, int count)
+{
+    double  offset = _offset;
+    double  scale = _scale;
+    double  decexp = _decexp;
+    int     i;
+
+    if (_isScal32) {
+        for (i = 0; i < count; i++) {
+            col[i] = col[i] / 1000.0;
+        }
+    } else if (_isScal) {
+        for (i = 0; i < count; i++) {
+            col[i] = (col[i] / 100 - offset) / scale;
+        }
+    } else {
+        for (i = 0; i < count; i++) {
+            col[i] = col[i] / decexp;
+        }
+    }
+    this->_calibrateColumn(col, count);
+}
+
+void YDataStream::_calibrateColumn(double *col, int count)
+{
+    int i;
+
+    if (_caltyp != 0 && _calhdl != NULL) {
+        for (i = 0; i < count; i++) {
+            col[i] = _calhdl(col[i], _caltyp, _calpar, _calraw, _calref);
+        }
+    }
+}
+
+// Number of rows currently decoded, either as columns or as rows
+int YDataStream::_loadedRowCount(void)
+{
+    return (_colCount > 0 ? _colRows : (int)_values.size());
+}
+
+int YDataStream::_get_decodedRowCount(void)
+{
+    return _colRows;
+}
+
+int YDataStream::_get_decodedColumnCount(void)
+{
+    return _colCount;
+}
+
+const double* YDataStream::_get_decodedColumn(int col)
+{
+    if (col < 0 || col >= _colCount || _colRows == 0) {
+        return NULL;
+    }
+    return &_columns[col * _colRows];
+}
+
+const double* YDataStream::get_columnData(int col)
+{
+    int row, c;
+
+    if ((this->_loadedRowCount() == 0) || !(_isClosed)) {
+        this->loadStream();
+    }
+    if (_colCount == 0 && (int)_values.size() > 0) {
+        // streams decoded as rows (old dataloggers): build the columns once
+        _colRows = (int)_values.size();
+        _colCount = (int)_values[0].size();
+        _columns.resize(_colCount * _colRows);
+        for (row = 0; row < _colRows; row++) {
+            for (c = 0; c < _colCount; c++) {
+                _columns[c * _colRows + row] = (c < (int)_values[row].size() ? _values[row][c] : Y_DATA_INVALID);
+            }
+        }
+    }
+    return this->_get_decodedColumn(col);
+}
+
+// Load the stream if needed, and build the rows of get_dataRows() from its columns
+void YDataStream::_loadRows(void)
+{
+    int row, col;
+
+    if ((this->_loadedRowCount() == 0) || !(_isClosed)) {
+        this->loadStream();
+    }
+    if (_colCount > 0 && (int)_values.size() != _colRows) {
+        _values.resize(_colRows);
+        for (row = 0; row < _colRows; row++) {
+            _values[row].resize(_colCount);
+            for (col = 0; col < _colCount; col++) {
+                _values[row][col] = _columns[col * _colRows + row];
+            }
+        }
+    }
 }
 
 // YDataSet constructor, when instantiated directly by a function
@@ -928,6 +1810,7 @@ YDataSet::YDataSet(YFunction *parent, const string& functionId, const string& un
     _endTime    = endTime;
     _summary = YMeasure(0, 0, 0, 0, 0);
     _progress   = -1;
+    _parallelDownloads = 1;
 }
 
 // YDataSet constructor for the new datalogger
@@ -937,26 +1820,791 @@ YDataSet::YDataSet(YFunction *parent)
     _startTime = 0;
     _endTime   = 0;
     _summary = YMeasure(0, 0, 0, 0, 0);
+    _parallelDownloads = 1;
 }
 
-// YDataSet parser for stream list
-int YDataSet::_parse(const string& json)
+// Optional on-disk cache of closed datalogger streams (see YAPI::SetDataLoggerCache).
+// Each function (SERIAL.functionId) has its own file, made of an 8-byte header
+// followed by one record per stream: run number, UTC stamp, word count and flags
+// as little-endian u32, then the raw stream words as little-endian u16, padded to
+// a multiple of 4 bytes. The files are mapped read-only and used in place.
+//
+// Several applications can share the directory. Records are only appended, under
+// an exclusive lock on the file, after mapping it again to see the records added
+// by the others. A record truncated by an interrupted write is overwritten by the
+// next one. Readers look at the file again when a stream is not found.
+#define YDLCACHE_MAGIC          0x59444c43u     // "CLDY"
+#define YDLCACHE_VERSION        1
+#define YDLCACHE_HEADER_SIZE    8
+#define YDLCACHE_RECORD_SIZE    16
+#define YDLCACHE_RECORD_LEN(nwords)  (YDLCACHE_RECORD_SIZE + ((((nwords) * 2) + 3) & ~3u))
+
+#ifdef WINDOWS_API
+typedef HANDLE  yDlFile;
+#define YDL_INVALID_FILE    INVALID_HANDLE_VALUE
+#else
+typedef int     yDlFile;
+#define YDL_INVALID_FILE    (-1)
+#endif
+
+typedef struct {
+    string                          path;
+    const u8                        *data;      // mapped file content, or NULL if empty
+    u32                             size;       // size of the mapping
+    u32                             validSize;  // end of the last complete record, 0 if no valid header
+    std::map<std::pair<u32,u32>,u32> index;     // (run, utc) => offset of the record in data
+} yDlCacheFile;
+
+static  yCRITICAL_SECTION                   _dlcache_CS;
+static  string                              _dlcache_dir;
+static  std::map<string,yDlCacheFile*>      _dlcache_files;
+
+static yDlFile yDlFileOpen(const string& path, bool forWrite)
 {
-    yJsonStateMachine j;
-    double summaryMinVal=DBL_MAX;
-    double summaryMaxVal=-DBL_MAX;
-    double summaryTotalTime=0;
-    double summaryTotalAvg=0;
+#ifdef WINDOWS_API
+    return CreateFileA(path.c_str(), GENERIC_READ | (forWrite ? GENERIC_WRITE : 0),
+                       FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+                       (forWrite ? OPEN_ALWAYS : OPEN_EXISTING), FILE_ATTRIBUTE_NORMAL, NULL);
+#else
+    return open(path.c_str(), (forWrite ? O_RDWR | O_CREAT : O_RDONLY), 0666);
+#endif
+}
 
+static void yDlFileClose(yDlFile fd)
+{
+#ifdef WINDOWS_API
+    CloseHandle(fd);
+#else
+    close(fd);
+#endif
+}
 
-    // Parse JSON data
-    j.src = json.c_str();
-    j.end = j.src + strlen(j.src);
-    j.st = YJSON_START;
-    if(yJsonParse(&j) != YJSON_PARSE_AVAIL || j.st != YJSON_PARSE_STRUCT) {
-        return YAPI_NOT_SUPPORTED;
+// Advisory lock shared by all the applications using the file. On Windows, the
+// locked byte is far beyond the data, since locks there also apply to reads.
+static bool yDlFileLock(yDlFile fd, bool exclusive)
+{
+#ifdef WINDOWS_API
+    OVERLAPPED ov;
+    memset(&ov, 0, sizeof(ov));
+    ov.Offset = 0xffffffff;
+    return LockFileEx(fd, (exclusive ? LOCKFILE_EXCLUSIVE_LOCK : 0), 0, 1, 0, &ov) != 0;
+#else
+    return flock(fd, (exclusive ? LOCK_EX : LOCK_SH)) == 0;
+#endif
+}
+
+static void yDlFileUnlock(yDlFile fd)
+{
+#ifdef WINDOWS_API
+    OVERLAPPED ov;
+    memset(&ov, 0, sizeof(ov));
+    ov.Offset = 0xffffffff;
+    UnlockFileEx(fd, 0, 1, 0, &ov);
+#else
+    flock(fd, LOCK_UN);
+#endif
+}
+
+static u32 yDlFileSize(yDlFile fd)
+{
+#ifdef WINDOWS_API
+    DWORD high = 0, low = GetFileSize(fd, &high);
+    return (low == INVALID_FILE_SIZE || high != 0 ? 0 : (u32)low);
+#else
+    struct stat st;
+    return (fstat(fd, &st) != 0 || st.st_size > 0x7fffffff ? 0 : (u32)st.st_size);
+#endif
+}
+
+static bool yDlFileWriteAt(yDlFile fd, u32 ofs, const string& data)
+{
+#ifdef WINDOWS_API
+    OVERLAPPED ov;
+    DWORD written = 0;
+    memset(&ov, 0, sizeof(ov));
+    ov.Offset = ofs;
+    return WriteFile(fd, data.data(), (DWORD)data.size(), &written, &ov) && written == data.size();
+#else
+    return pwrite(fd, data.data(), data.size(), (off_t)ofs) == (ssize_t)data.size();
+#endif
+}
+
+static void yDlFileTruncate(yDlFile fd, u32 size)
+{
+#ifdef WINDOWS_API
+    LARGE_INTEGER pos;
+    pos.QuadPart = size;
+    // fails while another application maps the file: the bytes left after
+    // the last record are then ignored, and overwritten by the next one
+    if (SetFilePointerEx(fd, pos, NULL, FILE_BEGIN)) {
+        SetEndOfFile(fd);
     }
-    while(yJsonParse(&j) == YJSON_PARSE_AVAIL && j.st == YJSON_PARSE_MEMBNAME) {
+#else
+    if (ftruncate(fd, (off_t)size) != 0) {
+        // same as above, the bytes left after the last record are ignored
+    }
+#endif
+}
+
+static const u8* yDlFileMap(yDlFile fd, u32 size)
+{
+#ifdef WINDOWS_API
+    HANDLE  mapping = CreateFileMappingA(fd, NULL, PAGE_READONLY, 0, size, NULL);
+    void    *ptr;
+    if (mapping == NULL) {
+        return NULL;
+    }
+    // the view keeps a reference to the mapping object
+    ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, size);
+    CloseHandle(mapping);
+    return (const u8*)ptr;
+#else
+    void *ptr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    return (ptr == MAP_FAILED ? NULL : (const u8*)ptr);
+#endif
+}
+
+static void yDlFileUnmap(const u8 *data, u32 size)
+{
+#ifdef WINDOWS_API
+    UnmapViewOfFile(data);
+#else
+    munmap((void*)data, size);
+#endif
+}
+
+static u32 yDlCacheGetU32(const u8 *ptr)
+{
+    return ptr[0] + ((u32)ptr[1] << 8) + ((u32)ptr[2] << 16) + ((u32)ptr[3] << 24);
+}
+
+static void yDlCacheAddU32(string& buf, u32 val)
+{
+    buf += (char)(val & 0xff);
+    buf += (char)((val >> 8) & 0xff);
+    buf += (char)((val >> 16) & 0xff);
+    buf += (char)((val >> 24) & 0xff);
+}
+
+static void yDlCacheUnmap(yDlCacheFile *file)
+{
+    if (file->data != NULL) {
+        yDlFileUnmap(file->data, file->size);
+    }
+    file->data = NULL;
+    file->size = 0;
+    file->validSize = 0;
+    file->index.clear();
+}
+
+// Map the file open in fd and index its complete records. The caller holds
+// a lock on the file, so that no record is being appended meanwhile. Return
+// false if the file could not be mapped.
+static bool yDlCacheLoad(yDlCacheFile *file, yDlFile fd)
+{
+    u32 size, ofs, nwords, reclen;
+
+    yDlCacheUnmap(file);
+    size = yDlFileSize(fd);
+    if (size < YDLCACHE_HEADER_SIZE) {
+        return true;
+    }
+    if ((file->data = yDlFileMap(fd, size)) == NULL) {
+        return false;
+    }
+    file->size = size;
+    if (yDlCacheGetU32(file->data) != YDLCACHE_MAGIC || yDlCacheGetU32(file->data + 4) != YDLCACHE_VERSION) {
+        return true;
+    }
+    ofs = YDLCACHE_HEADER_SIZE;
+    while (ofs + YDLCACHE_RECORD_SIZE <= size) {
+        nwords = yDlCacheGetU32(file->data + ofs + 8);
+        reclen = YDLCACHE_RECORD_LEN(nwords);
+        if (nwords > size || ofs + reclen > size) {
+            break;
+        }
+        file->index[std::make_pair(yDlCacheGetU32(file->data + ofs), yDlCacheGetU32(file->data + ofs + 4))] = ofs;
+        ofs += reclen;
+    }
+    file->validSize = ofs;
+    return true;
+}
+
+// Map the file again if its size changed, since other applications may have
+// appended records
+static void yDlCacheRefresh(yDlCacheFile *file)
+{
+    yDlFile fd = yDlFileOpen(file->path, false);
+
+    if (fd == YDL_INVALID_FILE) {
+        yDlCacheUnmap(file);
+        return;
+    }
+    if (yDlFileSize(fd) != file->size && yDlFileLock(fd, false)) {
+        yDlCacheLoad(file, fd);
+        yDlFileUnlock(fd);
+    }
+    yDlFileClose(fd);
+}
+
+// Return the cache file of a function, mapping it on first use. Must be called
+// with _dlcache_CS held, and only when the cache is enabled.
+static yDlCacheFile* yDlCacheOpen(const string& hwid)
+{
+    std::map<string,yDlCacheFile*>::iterator it = _dlcache_files.find(hwid);
+    yDlCacheFile    *file;
+
+    if (it != _dlcache_files.end()) {
+        return it->second;
+    }
+    file = new yDlCacheFile;
+    file->path = _dlcache_dir + "/" + hwid + ".ydl";
+    file->data = NULL;
+    file->size = 0;
+    file->validSize = 0;
+    yDlCacheRefresh(file);
+    _dlcache_files[hwid] = file;
+    return file;
+}
+
+// Return the offset of a record in the mapping, or 0 if not cached
+static u32 yDlCacheFind(yDlCacheFile *file, u32 runNo, u32 utcStamp)
+{
+    std::pair<u32,u32> key = std::make_pair(runNo, utcStamp);
+    std::map<std::pair<u32,u32>,u32>::iterator it = file->index.find(key);
+
+    if (it == file->index.end()) {
+        // may have been added by another application
+        yDlCacheRefresh(file);
+        it = file->index.find(key);
+        if (it == file->index.end()) {
+            return 0;
+        }
+    }
+    return it->second;
+}
+
+static bool yDlCacheHas(const string& hwid, u32 runNo, u32 utcStamp)
+{
+    bool res = false;
+
+    yEnterCriticalSection(&_dlcache_CS);
+    if (_dlcache_dir != "") {
+        res = (yDlCacheFind(yDlCacheOpen(hwid), runNo, utcStamp) != 0);
+    }
+    yLeaveCriticalSection(&_dlcache_CS);
+    return res;
+}
+
+// Copy the words of a cached stream into words, and return their count (-1 if not cached)
+static int yDlCacheGet(const string& hwid, u32 runNo, u32 utcStamp, vector<int>& words)
+{
+    yDlCacheFile *file;
+    const u8    *ptr;
+    u32         ofs;
+    int         nwords = -1, i;
+
+    yEnterCriticalSection(&_dlcache_CS);
+    if (_dlcache_dir != "") {
+        file = yDlCacheOpen(hwid);
+        ofs = yDlCacheFind(file, runNo, utcStamp);
+        if (ofs != 0) {
+            nwords = (int)yDlCacheGetU32(file->data + ofs + 8);
+            ptr = file->data + ofs + YDLCACHE_RECORD_SIZE;
+            words.resize(nwords);
+            for (i = 0; i < nwords; i++, ptr += 2) {
+                words[i] = ptr[0] + (ptr[1] << 8);
+            }
+        }
+    }
+    yLeaveCriticalSection(&_dlcache_CS);
+    return nwords;
+}
+
+static void yDlCachePut(const string& hwid, u32 runNo, u32 utcStamp, const vector<int>& words)
+{
+    std::pair<u32,u32> key = std::make_pair(runNo, utcStamp);
+    yDlCacheFile    *file;
+    yDlFile         fd;
+    string          record;
+    u32             ofs;
+    size_t          i;
+
+    yEnterCriticalSection(&_dlcache_CS);
+    if (_dlcache_dir == "") {
+        yLeaveCriticalSection(&_dlcache_CS);
+        return;
+    }
+    file = yDlCacheOpen(hwid);
+    if (file->index.find(key) != file->index.end()) {
+        yLeaveCriticalSection(&_dlcache_CS);
+        return;
+    }
+    fd = yDlFileOpen(file->path, true);
+    if (fd == YDL_INVALID_FILE) {
+        yLeaveCriticalSection(&_dlcache_CS);
+        return;
+    }
+    if (!yDlFileLock(fd, true)) {
+        yDlFileClose(fd);
+        yLeaveCriticalSection(&_dlcache_CS);
+        return;
+    }
+    // see the records appended by the other applications since the last mapping
+    if (yDlCacheLoad(file, fd) && file->index.find(key) == file->index.end()) {
+        ofs = file->validSize;
+        if (ofs == 0) {
+            // new file, or not a valid cache file: start over
+            yDlCacheAddU32(record, YDLCACHE_MAGIC);
+            yDlCacheAddU32(record, YDLCACHE_VERSION);
+        }
+        yDlCacheAddU32(record, runNo);
+        yDlCacheAddU32(record, utcStamp);
+        yDlCacheAddU32(record, (u32)words.size());
+        yDlCacheAddU32(record, 0);
+        for (i = 0; i < words.size(); i++) {
+            record += (char)(words[i] & 0xff);
+            record += (char)((words[i] >> 8) & 0xff);
+        }
+        record.resize((ofs == 0 ? YDLCACHE_HEADER_SIZE : 0) + YDLCACHE_RECORD_LEN(words.size()), 0);
+        // written after the last complete record, over any truncated one
+        if (yDlFileWriteAt(fd, ofs, record) && file->size > ofs + record.size()) {
+            yDlFileTruncate(fd, ofs + (u32)record.size());
+        }
+        yDlCacheLoad(file, fd);
+    }
+    yDlFileUnlock(fd);
+    yDlFileClose(fd);
+    yLeaveCriticalSection(&_dlcache_CS);
+}
+
+static void yDlCacheFree(void)
+{
+    std::map<string,yDlCacheFile*>::iterator it;
+
+    for (it = _dlcache_files.begin(); it != _dlcache_files.end(); it++) {
+        yDlCacheUnmap(it->second);
+        delete it->second;
+    }
+    _dlcache_files.clear();
+}
+
+bool YDataStream::_isCached(const string& hwid)
+{
+    if (hwid == "" || _closedWordCount == 0) {
+        return false;
+    }
+    return yDlCacheHas(hwid, (u32)_runNo, (u32)_utcStamp);
+}
+
+void YDataStream::_releaseData(void)
+{
+    vector< vector<double> > novalues;
+    vector<double> nocolumns;
+    vector<int> nowords;
+
+    // swap with empty vectors, as clear() would keep the memory allocated
+    _values.swap(novalues);
+    _columns.swap(nocolumns);
+    _words.swap(nowords);
+    _colCount = 0;
+    _colRows = 0;
+}
+
+// Load the stream from the datalogger cache, if it has been stored there when closed
+bool YDataStream::_loadFromCache(const string& hwid)
+{
+    if (hwid == "" || _closedWordCount == 0) {
+        return false;
+    }
+    if (yDlCacheGet(hwid, (u32)_runNo, (u32)_utcStamp, _words) != _closedWordCount) {
+        return false;
+    }
+    _values.clear();
+    this->_decodeStreamWords();
+    return true;
+}
+
+// Store the stream in the datalogger cache once it is closed and completely loaded
+void YDataStream::_saveToCache(const string& hwid)
+{
+    if (hwid == "" || _closedWordCount == 0 || (int)_words.size() != _closedWordCount) {
+        return;
+    }
+    yDlCachePut(hwid, (u32)_runNo, (u32)_utcStamp, _words);
+}
+
+// A data stream download in flight. It is shared by the data set waiting for
+// it and by the completion callback of the request, and freed by the last one
+// to release it.
+struct yStreamDownloadSt {
+    yCRITICAL_SECTION   lock;
+    yEvent              doneEvent;
+    int                 refcount;
+    bool                done;
+    YRETCODE            res;
+    string              reply;
+    string              errmsg;
+};
+
+static void yStreamDownloadRelease(yStreamDownloadSt *dl)
+{
+    int refcount;
+
+    yEnterCriticalSection(&dl->lock);
+    refcount = --dl->refcount;
+    yLeaveCriticalSection(&dl->lock);
+    if (refcount == 0) {
+        yDeleteCriticalSection(&dl->lock);
+        yCloseEvent(&dl->doneEvent);
+        delete dl;
+    }
+}
+
+static void yStreamDownloadDone(void *context, const u8 *result, u32 resultlen, int retcode, const char *errmsg)
+{
+    yStreamDownloadSt *dl = (yStreamDownloadSt*)context;
+
+    yEnterCriticalSection(&dl->lock);
+    dl->res = (YRETCODE)retcode;
+    if (result != NULL && resultlen > 0) {
+        dl->reply.assign((const char*)result, resultlen);
+    }
+    if (errmsg != NULL) {
+        dl->errmsg = errmsg;
+    }
+    dl->done = true;
+    ySetEvent(&dl->doneEvent);
+    yLeaveCriticalSection(&dl->lock);
+    yStreamDownloadRelease(dl);
+}
+
+// Start the download of an url, return NULL if the request could not be sent
+static yStreamDownloadSt* yStreamDownloadStart(YFunction *parent, int tcpchan, const string& url)
+{
+    yStreamDownloadSt   *dl = new yStreamDownloadSt;
+    string              errmsg;
+
+    yInitializeCriticalSection(&dl->lock);
+    yCreateManualEvent(&dl->doneEvent, 0);
+    dl->refcount = 2;   // one for us, one for the completion callback
+    dl->done = false;
+    dl->res = YAPI_SUCCESS;
+    if (YISERR(parent->_downloadStart(tcpchan, url, yStreamDownloadDone, dl, errmsg))) {
+        dl->refcount = 1;
+        yStreamDownloadRelease(dl);
+        return NULL;
+    }
+    return dl;
+}
+
+// Wait for the end of a download and extract the body of the reply
+static YRETCODE yStreamDownloadWait(yStreamDownloadSt *dl, string& body, string& errmsg)
+{
+    u64     timeout = yapiGetTickCount() + YIO_10_MINUTES_TCP_TIMEOUT;
+    string  handle_errmsg;
+    size_t  found;
+    bool    done;
+
+    for (;;) {
+        yEnterCriticalSection(&dl->lock);
+        done = dl->done;
+        yLeaveCriticalSection(&dl->lock);
+        if (done) {
+            break;
+        }
+        if (yapiGetTickCount() > timeout) {
+            errmsg = "Timeout while downloading a data stream";
+            return YAPI_TIMEOUT;
+        }
+        // requests to USB devices only progress when events are handled
+        YapiWrapper::handleEvents(handle_errmsg);
+        yWaitForEvent(&dl->doneEvent, 5);
+    }
+    if (YISERR(dl->res)) {
+        errmsg = dl->errmsg;
+        return dl->res;
+    }
+    // same checks as YFunction::_requestEx() and YFunction::_download()
+    if (0 != dl->reply.find("OK\r\n") && 0 != dl->reply.find("HTTP/1.1 200 OK\r\n")) {
+        errmsg = "http request failed";
+        return YAPI_IO_ERROR;
+    }
+    found = dl->reply.find("\r\n\r\n");
+    if (string::npos == found) {
+        errmsg = "http request failed";
+        return YAPI_IO_ERROR;
+    }
+    body = dl->reply.substr(found + 4);
+    return YAPI_SUCCESS;
+}
+
+YStreamDownloads& YStreamDownloads::operator=(const YStreamDownloads& other)
+{
+    // the downloads in flight belong to the data set being replaced
+    if (this != &other) {
+        clear();
+    }
+    return *this;
+}
+
+YStreamDownloads::~YStreamDownloads()
+{
+    clear();
+}
+
+void YStreamDownloads::clear(void)
+{
+    map<int,yStreamDownloadSt*>::iterator it;
+
+    // requests still in flight release their own reference when done
+    for (it = pending.begin(); it != pending.end(); it++) {
+        yStreamDownloadRelease(it->second);
+    }
+    pending.clear();
+}
+
+// Key of this data set in the datalogger cache, or an empty string when the cache is disabled
+string YDataSet::_cacheKey(void)
+{
+    bool enabled;
+
+    yEnterCriticalSection(&_dlcache_CS);
+    enabled = (_dlcache_dir != "");
+    yLeaveCriticalSection(&_dlcache_CS);
+    if (!enabled) {
+        return "";
+    }
+    return this->get_hardwareId();
+}
+
+void YDataSet::set_parallelDownloads(int nbDownloads)
+{
+    _parallelDownloads = (nbDownloads < 1 ? 1 : nbDownloads);
+}
+
+int YDataSet::get_parallelDownloads(void)
+{
+    return _parallelDownloads;
+}
+
+// Download the next stream while keeping up to _parallelDownloads downloads in
+// flight, so that the next streams are transferred while this one is decoded
+int YDataSet::_downloadPipelined(string& data)
+{
+    map<int,yStreamDownloadSt*>::iterator it;
+    yStreamDownloadSt   *dl;
+    string              errmsg;
+    string              cacheKey = this->_cacheKey();
+    int                 idx;
+    YRETCODE            res;
+
+    for (idx = _progress; idx < (int)_streams.size() && idx < _progress + _parallelDownloads; idx++) {
+        if (_downloads.pending.find(idx) == _downloads.pending.end() && !_streams[idx]->_isCached(cacheKey)) {
+            // spread the downloads over the channels of websocket hubs
+            dl = yStreamDownloadStart(_parent, idx % MAX_ASYNC_TCPCHAN, _streams[idx]->_get_url());
+            if (dl == NULL) {
+                break;
+            }
+            _downloads.pending[idx] = dl;
+        }
+    }
+    it = _downloads.pending.find(_progress);
+    if (it == _downloads.pending.end()) {
+        // could not be started asynchronously, use a plain request
+        data = _parent->_download(_streams[_progress]->_get_url());
+        return YAPI_SUCCESS;
+    }
+    dl = it->second;
+    _downloads.pending.erase(it);
+    res = yStreamDownloadWait(dl, data, errmsg);
+    yStreamDownloadRelease(dl);
+    if (YISERR(res)) {
+        _parent->_throw(res, errmsg);
+        return res;
+    }
+    return YAPI_SUCCESS;
+}
+
+// Load the stream at _progress, from the datalogger cache or from the device,
+// and append its measures
+int YDataSet::_loadStream(vector<YMeasure>& measures)
+{
+    YDataStream *stream = _streams[_progress];
+    string      data;
+    int         res;
+
+    if (stream->_loadFromCache(this->_cacheKey())) {
+        return this->_processStream(stream, measures);
+    }
+    if (_parallelDownloads > 1) {
+        res = this->_downloadPipelined(data);
+        if (YISERR(res)) {
+            return res;
+        }
+    } else {
+        data = _parent->_download(stream->_get_url());
+    }
+    return this->_decodeStream(stream, data, measures);
+}
+
+// Decode the downloaded stream at _progress, keep it in the datalogger cache
+// and append its measures
+int YDataSet::_decodeStream(YDataStream *stream, const string& data, vector<YMeasure>& measures)
+{
+    stream->_parseStream(data);
+    stream->_saveToCache(this->_cacheKey());
+    return this->_processStream(stream, measures);
+}
+
+// Append the measures of the stream at _progress, once loaded, and move to the next one
+int YDataSet::_processStream(YDataStream *stream, vector<YMeasure>& measures)
+{
+    const double *minVals, *avgVals, *maxVals;
+    double tim = 0.0;
+    double itv = 0.0;
+    int nRows = 0;
+    int nCols = 0;
+    int minCol = 0;
+    int avgCol = 0;
+    int maxCol = 0;
+
+    minVals = stream->get_columnData(0);
+    _progress = _progress + 1;
+    if (minVals == NULL) {
+        return this->get_progress();
+    }
+    nRows = stream->_get_decodedRowCount();
+    tim = (double) stream->get_startTimeUTC();
+    itv = stream->get_dataSamplesInterval();
+    if (tim < itv) {
+        tim = itv;
+    }
+    nCols = stream->_get_decodedColumnCount();
+    minCol = 0;
+    if (nCols > 2) {
+        avgCol = 1;
+    } else {
+        avgCol = 0;
+    }
+    if (nCols > 2) {
+        maxCol = 2;
+    } else {
+        maxCol = 0;
+    }
+    minVals = stream->_get_decodedColumn(minCol);
+    avgVals = stream->_get_decodedColumn(avgCol);
+    maxVals = stream->_get_decodedColumn(maxCol);
+
+    for (int ii = 0; ii < nRows; ii++) {
+        if ((tim >= _startTime) && ((_endTime == 0) || (tim <= _endTime))) {
+            measures.push_back(YMeasure(tim - itv, tim,
+            minVals[ii],
+            avgVals[ii],maxVals[ii]));
+        }
+        tim = tim + itv;
+        tim = floor(tim * 1000+0.5) / 1000.0;
+    }
+    return this->get_progress();
+}
+
+int YDataSet::loadNextMeasures(vector<YMeasure>& batch)
+{
+    YDataStream *stream;
+    int         res;
+
+    batch.clear();
+    if (_progress < 0) {
+        // first load the list of streams
+        return this->loadMore();
+    }
+    if (_progress >= (int)_streams.size()) {
+        return 100;
+    }
+    stream = _streams[_progress];
+    res = this->_loadStream(batch);
+    stream->_releaseData();
+    return res;
+}
+
+// Return the url of the next download of loadMore(), or an empty string if
+// there is none: the data set is complete, or the next stream has just been
+// loaded from the datalogger cache
+string YDataSet::_nextDownloadUrl(void)
+{
+    string url;
+
+    if (_progress < 0) {
+        url = YapiWrapper::ysprintf("logger.json?id=%s",_functionId.c_str());
+        if (_startTime != 0) {
+            url = YapiWrapper::ysprintf("%s&from=%u",url.c_str(),_startTime);
+        }
+        if (_endTime != 0) {
+            url = YapiWrapper::ysprintf("%s&to=%u",url.c_str(),_endTime);
+        }
+        return url;
+    }
+    if (_progress >= (int)_streams.size() || _streams[_progress]->_loadFromCache(this->_cacheKey())) {
+        return "";
+    }
+    return _streams[_progress]->_get_url();
+}
+
+// Complete the step of loadMoreAsync() started at the given progress
+int YDataSet::_loadMoreDone(int progress, const string& url, YAsyncRequest& request)
+{
+    YRETCODE res;
+
+    if (url == "") {
+        if (progress >= (int)_streams.size()) {
+            return 100;
+        }
+        return this->_processStream(_streams[progress], _measures);
+    }
+    res = request.get_errorType();
+    if (YISERR(res)) {
+        _parent->_throw(res, request.get_errorMessage());
+        return res;
+    }
+    return this->processMore(progress, request.get_content());
+}
+
+bool YMeasureCursor::next(YMeasure& measure)
+{
+    while (_pos >= _batch.size()) {
+        if (_progress < 0 || _progress >= 100) {
+            return false;
+        }
+        _pos = 0;
+        _progress = _dataset->loadNextMeasures(_batch);
+    }
+    measure = _batch[_pos++];
+    return true;
+}
+
+int YMeasureCursor::get_progress(void)
+{
+    return _progress;
+}
+
+// YDataSet parser for stream list
+int YDataSet::_parse(const string& json)
+{
+    yJsonStateMachine j;
+    double summaryMinVal=DBL_MAX;
+    double summaryMaxVal=-DBL_MAX;
+    double summaryTotalTime=0;
+    double summaryTotalAvg=0;
+
+
+    // Parse JSON data
+    j.src = json.c_str();
+    j.end = j.src + strlen(j.src);
+    j.st = YJSON_START;
+    if(yJsonParse(&j) != YJSON_PARSE_AVAIL || j.st != YJSON_PARSE_STRUCT) {
+        return YAPI_NOT_SUPPORTED;
+    }
+    while(yJsonParse(&j) == YJSON_PARSE_AVAIL && j.st == YJSON_PARSE_MEMBNAME) {
         if (!strcmp(j.token, "id")) {
             if (yJsonParse(&j) != YJSON_PARSE_AVAIL) {
                 return YAPI_NOT_SUPPORTED;
@@ -1379,1912 +3027,3202 @@ int YDataStream::_initFromDataSet(YDataSet* dataset,vector<int> encoded)
             _avgVal = this->_decodeAvg(encoded[10] + (((encoded[11]) << (16))), _nRows);
         }
     }
-    return 0;
+    return 0;
+}
+
+int YDataStream::_parseStream(string sdata)
+{
+    if ((int)(sdata).size() == 0) {
+        _nRows = 0;
+        return YAPI_SUCCESS;
+    }
+
+    return this->_decodeStreamData(_parent->_json_get_string(sdata));
+}
+
+string YDataStream::_get_url(void)
+{
+    string url;
+    url = YapiWrapper::ysprintf("logger.json?id=%s&run=%d&utc=%u",
+    _functionId.c_str(),_runNo,_utcStamp);
+    return url;
+}
+
+int YDataStream::loadStream(void)
+{
+    return this->_parseStream(_parent->_download(this->_get_url()));
+}
+
+double YDataStream::_decodeVal(int w)
+{
+    double val = 0.0;
+    val = w;
+    if (_isScal32) {
+        val = val / 1000.0;
+    } else {
+        if (_isScal) {
+            val = (val - _offset) / _scale;
+        } else {
+            val = YAPI::_decimalToDouble(w);
+        }
+    }
+    if (_caltyp != 0) {
+        if (_calhdl != NULL) {
+            val = _calhdl(val, _caltyp, _calpar, _calraw, _calref);
+        }
+    }
+    return val;
+}
+
+double YDataStream::_decodeAvg(int dw,int count)
+{
+    double val = 0.0;
+    val = dw;
+    if (_isScal32) {
+        val = val / 1000.0;
+    } else {
+        if (_isScal) {
+            val = (val / (100 * count) - _offset) / _scale;
+        } else {
+            val = val / (count * _decexp);
+        }
+    }
+    if (_caltyp != 0) {
+        if (_calhdl != NULL) {
+            val = _calhdl(val, _caltyp, _calpar, _calraw, _calref);
+        }
+    }
+    return val;
+}
+
+bool YDataStream::isClosed(void)
+{
+    return _isClosed;
+}
+
+/**
+ * Returns the run index of the data stream. A run can be made of
+ * multiple datastreams, for different time intervals.
+ *
+ * @return an unsigned number corresponding to the run index.
+ */
+int YDataStream::get_runIndex(void)
+{
+    return _runNo;
+}
+
+/**
+ * Returns the relative start time of the data stream, measured in seconds.
+ * For recent firmwares, the value is relative to the present time,
+ * which means the value is always negative.
+ * If the device uses a firmware older than version 13000, value is
+ * relative to the start of the time the device was powered on, and
+ * is always positive.
+ * If you need an absolute UTC timestamp, use get_startTimeUTC().
+ *
+ * @return an unsigned number corresponding to the number of seconds
+ *         between the start of the run and the beginning of this data
+ *         stream.
+ */
+int YDataStream::get_startTime(void)
+{
+    return (int)(_utcStamp - ((unsigned)time(NULL)));
+}
+
+/**
+ * Returns the start time of the data stream, relative to the Jan 1, 1970.
+ * If the UTC time was not set in the datalogger at the time of the recording
+ * of this data stream, this method returns 0.
+ *
+ * @return an unsigned number corresponding to the number of seconds
+ *         between the Jan 1, 1970 and the beginning of this data
+ *         stream (i.e. Unix time representation of the absolute time).
+ */
+s64 YDataStream::get_startTimeUTC(void)
+{
+    return _utcStamp;
+}
+
+/**
+ * Returns the number of milliseconds between two consecutive
+ * rows of this data stream. By default, the data logger records one row
+ * per second, but the recording frequency can be changed for
+ * each device function
+ *
+ * @return an unsigned number corresponding to a number of milliseconds.
+ */
+int YDataStream::get_dataSamplesIntervalMs(void)
+{
+    return ((3600000) / (_samplesPerHour));
+}
+
+double YDataStream::get_dataSamplesInterval(void)
+{
+    return 3600.0 / _samplesPerHour;
+}
+
+/**
+ * Returns the number of data rows present in this stream.
+ *
+ * If the device uses a firmware older than version 13000,
+ * this method fetches the whole data stream from the device
+ * if not yet done, which can cause a little delay.
+ *
+ * @return an unsigned number corresponding to the number of rows.
+ *
+ * On failure, throws an exception or returns zero.
+ */
+int YDataStream::get_rowCount(void)
+{
+    if ((_nRows != 0) && _isClosed) {
+        return _nRows;
+    }
+    this->loadStream();
+    return _nRows;
+}
+
+/**
+ * Returns the number of data columns present in this stream.
+ * The meaning of the values present in each column can be obtained
+ * using the method get_columnNames().
+ *
+ * If the device uses a firmware older than version 13000,
+ * this method fetches the whole data stream from the device
+ * if not yet done, which can cause a little delay.
+ *
+ * @return an unsigned number corresponding to the number of columns.
+ *
+ * On failure, throws an exception or returns zero.
+ */
+int YDataStream::get_columnCount(void)
+{
+    if (_nCols != 0) {
+        return _nCols;
+    }
+    this->loadStream();
+    return _nCols;
+}
+
+/**
+ * Returns the title (or meaning) of each data column present in this stream.
+ * In most case, the title of the data column is the hardware identifier
+ * of the sensor that produced the data. For streams recorded at a lower
+ * recording rate, the dataLogger stores the min, average and max value
+ * during each measure interval into three columns with suffixes _min,
+ * _avg and _max respectively.
+ *
+ * If the device uses a firmware older than version 13000,
+ * this method fetches the whole data stream from the device
+ * if not yet done, which can cause a little delay.
+ *
+ * @return a list containing as many strings as there are columns in the
+ *         data stream.
+ *
+ * On failure, throws an exception or returns an empty array.
+ */
+vector<string> YDataStream::get_columnNames(void)
+{
+    if ((int)_columnNames.size() != 0) {
+        return _columnNames;
+    }
+    this->loadStream();
+    return _columnNames;
+}
+
+/**
+ * Returns the smallest measure observed within this stream.
+ * If the device uses a firmware older than version 13000,
+ * this method will always return Y_DATA_INVALID.
+ *
+ * @return a floating-point number corresponding to the smallest value,
+ *         or Y_DATA_INVALID if the stream is not yet complete (still recording).
+ *
+ * On failure, throws an exception or returns Y_DATA_INVALID.
+ */
+double YDataStream::get_minValue(void)
+{
+    return _minVal;
+}
+
+/**
+ * Returns the average of all measures observed within this stream.
+ * If the device uses a firmware older than version 13000,
+ * this method will always return Y_DATA_INVALID.
+ *
+ * @return a floating-point number corresponding to the average value,
+ *         or Y_DATA_INVALID if the stream is not yet complete (still recording).
+ *
+ * On failure, throws an exception or returns Y_DATA_INVALID.
+ */
+double YDataStream::get_averageValue(void)
+{
+    return _avgVal;
+}
+
+/**
+ * Returns the largest measure observed within this stream.
+ * If the device uses a firmware older than version 13000,
+ * this method will always return Y_DATA_INVALID.
+ *
+ * @return a floating-point number corresponding to the largest value,
+ *         or Y_DATA_INVALID if the stream is not yet complete (still recording).
+ *
+ * On failure, throws an exception or returns Y_DATA_INVALID.
+ */
+double YDataStream::get_maxValue(void)
+{
+    return _maxVal;
+}
+
+/**
+ * Returns the approximate duration of this stream, in seconds.
+ *
+ * @return the number of seconds covered by this stream.
+ *
+ * On failure, throws an exception or returns Y_DURATION_INVALID.
+ */
+int YDataStream::get_duration(void)
+{
+    if (_isClosed) {
+        return _duration;
+    }
+    return (int)(((unsigned)time(NULL)) - _utcStamp);
 }
 
-int YDataStream::_parseStream(string sdata)
+/**
+ * Returns the whole data set contained in the stream, as a bidimensional
+ * table of numbers.
+ * The meaning of the values present in each column can be obtained
+ * using the method get_columnNames().
+ *
+ * This method fetches the whole data stream from the device,
+ * if not yet done.
+ *
+ * @return a list containing as many elements as there are rows in the
+ *         data stream. Each row itself is a list of floating-point
+ *         numbers.
+ *
+ * On failure, throws an exception or returns an empty array.
+ */
+vector< vector<double> > YDataStream::get_dataRows(void)
 {
-    int idx = 0;
-    vector<int> udat;
-    vector<double> dat;
-    if ((int)(sdata).size() == 0) {
-        _nRows = 0;
-        return YAPI_SUCCESS;
+    if (((int)_values.size() == 0) || !(_isClosed)) {
+        this->_loadRows();
     }
+    return _values;
+}
 
-    udat = YAPI::_decodeWords(_parent->_json_get_string(sdata));
-    _values.clear();
-    idx = 0;
-    if (_isAvg) {
-        while (idx + 3 < (int)udat.size()) {
-            dat.clear();
-            if (_isScal32) {
-                dat.push_back(this->_decodeVal(udat[idx + 2] + (((udat[idx + 3]) << (16)))));
-                dat.push_back(this->_decodeAvg(udat[idx] + (((((udat[idx + 1]) ^ (0x8000))) << (16))), 1));
-                dat.push_back(this->_decodeVal(udat[idx + 4] + (((udat[idx + 5]) << (16)))));
-                idx = idx + 6;
-            } else {
-                dat.push_back(this->_decodeVal(udat[idx]));
-                dat.push_back(this->_decodeAvg(udat[idx + 2] + (((udat[idx + 3]) << (16))), 1));
-                dat.push_back(this->_decodeVal(udat[idx + 1]));
-                idx = idx + 4;
-            }
-            _values.push_back(dat);
-        }
-    } else {
-        if (_isScal && !(_isScal32)) {
-            while (idx < (int)udat.size()) {
-                dat.clear();
-                dat.push_back(this->_decodeVal(udat[idx]));
-                _values.push_back(dat);
-                idx = idx + 1;
-            }
-        } else {
-            while (idx + 1 < (int)udat.size()) {
-                dat.clear();
-                dat.push_back(this->_decodeAvg(udat[idx] + (((((udat[idx + 1]) ^ (0x8000))) << (16))), 1));
-                _values.push_back(dat);
-                idx = idx + 2;
-            }
-        }
+/**
+ * Returns a single measure from the data stream, specified by its
+ * row and column index.
+ * The meaning of the values present in each column can be obtained
+ * using the method get_columnNames().
+ *
+ * This method fetches the whole data stream from the device,
+ * if not yet done.
+ *
+ * @param row : row index
+ * @param col : column index
+ *
+ * @return a floating-point number
+ *
+ * On failure, throws an exception or returns Y_DATA_INVALID.
+ */
+double YDataStream::get_data(int row,int col)
+{
+    if (((int)_values.size() == 0) || !(_isClosed)) {
+        this->_loadRows();
+    }
+    if (row >= (int)_values.size()) {
+        return Y_DATA_INVALID;
+    }
+    if (col >= (int)_values[row].size()) {
+        return Y_DATA_INVALID;
     }
+    return _values[row][col];
+}
+//--- (end of generated code: YDataStream implementation)
 
-    _nRows = (int)_values.size();
-    return YAPI_SUCCESS;
+
+//--- (generated code: YMeasure implementation)
+// static attributes
+
+
+/**
+ * Returns the start time of the measure, relative to the Jan 1, 1970 UTC
+ * (Unix timestamp). When the recording rate is higher then 1 sample
+ * per second, the timestamp may have a fractional part.
+ *
+ * @return an floating point number corresponding to the number of seconds
+ *         between the Jan 1, 1970 UTC and the beginning of this measure.
+ */
+double YMeasure::get_startTimeUTC(void)
+{
+    return _start;
 }
 
-string YDataStream::_get_url(void)
+/**
+ * Returns the end time of the measure, relative to the Jan 1, 1970 UTC
+ * (Unix timestamp). When the recording rate is higher than 1 sample
+ * per second, the timestamp may have a fractional part.
+ *
+ * @return an floating point number corresponding to the number of seconds
+ *         between the Jan 1, 1970 UTC and the end of this measure.
+ */
+double YMeasure::get_endTimeUTC(void)
 {
-    string url;
-    url = YapiWrapper::ysprintf("logger.json?id=%s&run=%d&utc=%u",
-    _functionId.c_str(),_runNo,_utcStamp);
-    return url;
+    return _end;
 }
 
-int YDataStream::loadStream(void)
+/**
+ * Returns the smallest value observed during the time interval
+ * covered by this measure.
+ *
+ * @return a floating-point number corresponding to the smallest value observed.
+ */
+double YMeasure::get_minValue(void)
 {
-    return this->_parseStream(_parent->_download(this->_get_url()));
+    return _minVal;
 }
 
-double YDataStream::_decodeVal(int w)
+/**
+ * Returns the average value observed during the time interval
+ * covered by this measure.
+ *
+ * @return a floating-point number corresponding to the average value observed.
+ */
+double YMeasure::get_averageValue(void)
 {
-    double val = 0.0;
-    val = w;
-    if (_isScal32) {
-        val = val / 1000.0;
-    } else {
-        if (_isScal) {
-            val = (val - _offset) / _scale;
-        } else {
-            val = YAPI::_decimalToDouble(w);
-        }
+    return _avgVal;
+}
+
+/**
+ * Returns the largest value observed during the time interval
+ * covered by this measure.
+ *
+ * @return a floating-point number corresponding to the largest value observed.
+ */
+double YMeasure::get_maxValue(void)
+{
+    return _maxVal;
+}
+//--- (end of generated code: YMeasure implementation)
+
+time_t*   YMeasure::get_startTimeUTC_asTime_t(time_t *time)
+{
+    if(time){
+        memcpy(time,&this->_stopTime_t,sizeof(time_t));
     }
-    if (_caltyp != 0) {
-        if (_calhdl != NULL) {
-            val = _calhdl(val, _caltyp, _calpar, _calraw, _calref);
-        }
+    return &this->_startTime_t;
+
+}
+time_t*   YMeasure::get_endTimeUTC_asTime_t(time_t *time)
+{
+    if(time){
+        memcpy(time,&this->_stopTime_t,sizeof(time_t));
     }
-    return val;
+    return &this->_stopTime_t;
 }
 
-double YDataStream::_decodeAvg(int dw,int count)
+//--- (generated code: YDataSet implementation)
+// static attributes
+
+
+vector<int> YDataSet::_get_calibration(void)
 {
-    double val = 0.0;
-    val = dw;
-    if (_isScal32) {
-        val = val / 1000.0;
-    } else {
-        if (_isScal) {
-            val = (val / (100 * count) - _offset) / _scale;
-        } else {
-            val = val / (count * _decexp);
-        }
+    return _calib;
+}
+
+int YDataSet::processMore(int progress,string data)
+{
+    string strdata;
+
+    if (progress != _progress) {
+        return _progress;
     }
-    if (_caltyp != 0) {
-        if (_calhdl != NULL) {
-            val = _calhdl(val, _caltyp, _calpar, _calraw, _calref);
+    if (_progress < 0) {
+        strdata = data;
+        if (strdata == "{}") {
+            _parent->_throw(YAPI_VERSION_MISMATCH, "device firmware is too old");
+            return YAPI_VERSION_MISMATCH;
         }
+        return this->_parse(strdata);
     }
-    return val;
+    return this->_decodeStream(_streams[_progress], data, _measures);
 }
 
-bool YDataStream::isClosed(void)
+vector<YDataStream*> YDataSet::get_privateDataStreams(void)
+{
+    return _streams;
+}
+
+/**
+ * Returns the unique hardware identifier of the function who performed the measures,
+ * in the form SERIAL.FUNCTIONID. The unique hardware identifier is composed of the
+ * device serial number and of the hardware identifier of the function
+ * (for example THRMCPL1-123456.temperature1)
+ *
+ * @return a string that uniquely identifies the function (ex: THRMCPL1-123456.temperature1)
+ *
+ * On failure, throws an exception or returns  Y_HARDWAREID_INVALID.
+ */
+string YDataSet::get_hardwareId(void)
+{
+    YModule* mo = NULL;
+    if (!(_hardwareId == "")) {
+        return _hardwareId;
+    }
+    mo = _parent->get_module();
+    _hardwareId = YapiWrapper::ysprintf("%s.%s", mo->get_serialNumber().c_str(),this->get_functionId().c_str());
+    return _hardwareId;
+}
+
+/**
+ * Returns the hardware identifier of the function that performed the measure,
+ * without reference to the module. For example temperature1.
+ *
+ * @return a string that identifies the function (ex: temperature1)
+ */
+string YDataSet::get_functionId(void)
+{
+    return _functionId;
+}
+
+/**
+ * Returns the measuring unit for the measured value.
+ *
+ * @return a string that represents a physical unit.
+ *
+ * On failure, throws an exception or returns  Y_UNIT_INVALID.
+ */
+string YDataSet::get_unit(void)
+{
+    return _unit;
+}
+
+/**
+ * Returns the start time of the dataset, relative to the Jan 1, 1970.
+ * When the YDataSet is created, the start time is the value passed
+ * in parameter to the get_dataSet() function. After the
+ * very first call to loadMore(), the start time is updated
+ * to reflect the timestamp of the first measure actually found in the
+ * dataLogger within the specified range.
+ *
+ * @return an unsigned number corresponding to the number of seconds
+ *         between the Jan 1, 1970 and the beginning of this data
+ *         set (i.e. Unix time representation of the absolute time).
+ */
+s64 YDataSet::get_startTimeUTC(void)
 {
-    return _isClosed;
+    return _startTime;
 }
 
 /**
- * Returns the run index of the data stream. A run can be made of
- * multiple datastreams, for different time intervals.
+ * Returns the end time of the dataset, relative to the Jan 1, 1970.
+ * When the YDataSet is created, the end time is the value passed
+ * in parameter to the get_dataSet() function. After the
+ * very first call to loadMore(), the end time is updated
+ * to reflect the timestamp of the last measure actually found in the
+ * dataLogger within the specified range.
  *
- * @return an unsigned number corresponding to the run index.
+ * @return an unsigned number corresponding to the number of seconds
+ *         between the Jan 1, 1970 and the end of this data
+ *         set (i.e. Unix time representation of the absolute time).
  */
-int YDataStream::get_runIndex(void)
+s64 YDataSet::get_endTimeUTC(void)
 {
-    return _runNo;
+    return _endTime;
 }
 
 /**
- * Returns the relative start time of the data stream, measured in seconds.
- * For recent firmwares, the value is relative to the present time,
- * which means the value is always negative.
- * If the device uses a firmware older than version 13000, value is
- * relative to the start of the time the device was powered on, and
- * is always positive.
- * If you need an absolute UTC timestamp, use get_startTimeUTC().
+ * Returns the progress of the downloads of the measures from the data logger,
+ * on a scale from 0 to 100. When the object is instantiated by get_dataSet,
+ * the progress is zero. Each time loadMore() is invoked, the progress
+ * is updated, to reach the value 100 only once all measures have been loaded.
  *
- * @return an unsigned number corresponding to the number of seconds
- *         between the start of the run and the beginning of this data
- *         stream.
+ * @return an integer in the range 0 to 100 (percentage of completion).
  */
-int YDataStream::get_startTime(void)
+int YDataSet::get_progress(void)
 {
-    return (int)(_utcStamp - ((unsigned)time(NULL)));
+    if (_progress < 0) {
+        return 0;
+    }
+    // index not yet loaded
+    if (_progress >= (int)_streams.size()) {
+        return 100;
+    }
+    return ((1 + (1 + _progress) * 98) / ((1 + (int)_streams.size())));
 }
 
 /**
- * Returns the start time of the data stream, relative to the Jan 1, 1970.
- * If the UTC time was not set in the datalogger at the time of the recording
- * of this data stream, this method returns 0.
+ * Loads the the next block of measures from the dataLogger, and updates
+ * the progress indicator.
  *
- * @return an unsigned number corresponding to the number of seconds
- *         between the Jan 1, 1970 and the beginning of this data
- *         stream (i.e. Unix time representation of the absolute time).
+ * @return an integer in the range 0 to 100 (percentage of completion),
+ *         or a negative error code in case of failure.
+ *
+ * On failure, throws an exception or returns a negative error code.
  */
-s64 YDataStream::get_startTimeUTC(void)
+int YDataSet::loadMore(void)
 {
-    return _utcStamp;
+    string url;
+    if (_progress < 0) {
+        url = YapiWrapper::ysprintf("logger.json?id=%s",_functionId.c_str());
+        if (_startTime != 0) {
+            url = YapiWrapper::ysprintf("%s&from=%u",url.c_str(),_startTime);
+        }
+        if (_endTime != 0) {
+            url = YapiWrapper::ysprintf("%s&to=%u",url.c_str(),_endTime);
+        }
+    } else {
+        if (_progress >= (int)_streams.size()) {
+            return 100;
+        } else {
+            return this->_loadStream(_measures);
+        }
+    }
+    return this->processMore(_progress, _parent->_download(url));
 }
 
 /**
- * Returns the number of milliseconds between two consecutive
- * rows of this data stream. By default, the data logger records one row
- * per second, but the recording frequency can be changed for
- * each device function
+ * Returns an YMeasure object which summarizes the whole
+ * DataSet. In includes the following information:
+ * - the start of a time interval
+ * - the end of a time interval
+ * - the minimal value observed during the time interval
+ * - the average value observed during the time interval
+ * - the maximal value observed during the time interval
  *
- * @return an unsigned number corresponding to a number of milliseconds.
+ * This summary is available as soon as loadMore() has
+ * been called for the first time.
+ *
+ * @return an YMeasure object
  */
-int YDataStream::get_dataSamplesIntervalMs(void)
+YMeasure YDataSet::get_summary(void)
 {
-    return ((3600000) / (_samplesPerHour));
+    return _summary;
 }
 
-double YDataStream::get_dataSamplesInterval(void)
+/**
+ * Returns a condensed version of the measures that can
+ * retrieved in this YDataSet, as a list of YMeasure
+ * objects. Each item includes:
+ * - the start of a time interval
+ * - the end of a time interval
+ * - the minimal value observed during the time interval
+ * - the average value observed during the time interval
+ * - the maximal value observed during the time interval
+ *
+ * This preview is available as soon as loadMore() has
+ * been called for the first time.
+ *
+ * @return a table of records, where each record depicts the
+ *         measured values during a time interval
+ *
+ * On failure, throws an exception or returns an empty array.
+ */
+vector<YMeasure> YDataSet::get_preview(void)
 {
-    return 3600.0 / _samplesPerHour;
+    return _preview;
 }
 
 /**
- * Returns the number of data rows present in this stream.
+ * Returns the detailed set of measures for the time interval corresponding
+ * to a given condensed measures previously returned by get_preview().
+ * The result is provided as a list of YMeasure objects.
  *
- * If the device uses a firmware older than version 13000,
- * this method fetches the whole data stream from the device
- * if not yet done, which can cause a little delay.
+ * @param measure : condensed measure from the list previously returned by
+ *         get_preview().
  *
- * @return an unsigned number corresponding to the number of rows.
+ * @return a table of records, where each record depicts the
+ *         measured values during a time interval
  *
- * On failure, throws an exception or returns zero.
+ * On failure, throws an exception or returns an empty array.
  */
-int YDataStream::get_rowCount(void)
+vector<YMeasure> YDataSet::get_measuresAt(YMeasure measure)
 {
-    if ((_nRows != 0) && _isClosed) {
-        return _nRows;
+    s64 startUtc = 0;
+    YDataStream* stream = NULL;
+    vector< vector<double> > dataRows;
+    vector<YMeasure> measures;
+    double tim = 0.0;
+    double itv = 0.0;
+    int nCols = 0;
+    int minCol = 0;
+    int avgCol = 0;
+    int maxCol = 0;
+
+    startUtc = (s64) floor(measure.get_startTimeUTC()+0.5);
+    stream = NULL;
+    for (unsigned ii = 0; ii < _streams.size(); ii++) {
+        if (_streams[ii]->get_startTimeUTC() == startUtc) {
+            stream = _streams[ii];
+        }
     }
-    this->loadStream();
-    return _nRows;
+    if (stream == NULL) {
+        return measures;
+    }
+    dataRows = stream->get_dataRows();
+    if ((int)dataRows.size() == 0) {
+        return measures;
+    }
+    tim = (double) stream->get_startTimeUTC();
+    itv = stream->get_dataSamplesInterval();
+    if (tim < itv) {
+        tim = itv;
+    }
+    nCols = (int)dataRows[0].size();
+    minCol = 0;
+    if (nCols > 2) {
+        avgCol = 1;
+    } else {
+        avgCol = 0;
+    }
+    if (nCols > 2) {
+        maxCol = 2;
+    } else {
+        maxCol = 0;
+    }
+
+    for (unsigned ii = 0; ii < dataRows.size(); ii++) {
+        if ((tim >= _startTime) && ((_endTime == 0) || (tim <= _endTime))) {
+            measures.push_back(YMeasure(tim - itv, tim,
+            dataRows[ii][minCol],
+            dataRows[ii][avgCol],dataRows[ii][maxCol]));
+        }
+        tim = tim + itv;
+    }
+    return measures;
 }
 
 /**
- * Returns the number of data columns present in this stream.
- * The meaning of the values present in each column can be obtained
- * using the method get_columnNames().
+ * Returns all measured values currently available for this DataSet,
+ * as a list of YMeasure objects. Each item includes:
+ * - the start of the measure time interval
+ * - the end of the measure time interval
+ * - the minimal value observed during the time interval
+ * - the average value observed during the time interval
+ * - the maximal value observed during the time interval
  *
- * If the device uses a firmware older than version 13000,
- * this method fetches the whole data stream from the device
- * if not yet done, which can cause a little delay.
+ * Before calling this method, you should call loadMore()
+ * to load data from the device. You may have to call loadMore()
+ * several time until all rows are loaded, but you can start
+ * looking at available data rows before the load is complete.
  *
- * @return an unsigned number corresponding to the number of columns.
+ * The oldest measures are always loaded first, and the most
+ * recent measures will be loaded last. As a result, timestamps
+ * are normally sorted in ascending order within the measure table,
+ * unless there was an unexpected adjustment of the datalogger UTC
+ * clock.
  *
- * On failure, throws an exception or returns zero.
+ * @return a table of records, where each record depicts the
+ *         measured value for a given time interval
+ *
+ * On failure, throws an exception or returns an empty array.
  */
-int YDataStream::get_columnCount(void)
+vector<YMeasure> YDataSet::get_measures(void)
+{
+    return _measures;
+}
+//--- (end of generated code: YDataSet implementation)
+
+
+std::map<string,YFunction*> YFunction::_cache;
+
+
+// Constructor is protected. Use the device-specific factory function to instantiate
+YFunction::YFunction(const string& func):
+    _className("Function"),_func(func),
+    _lastErrorType(YAPI_SUCCESS),_lastErrorMsg(""),
+    _fundescr(Y_FUNCTIONDESCRIPTOR_INVALID), _userData(NULL), _batching(false),
+    _asyncWrites(false), _loadedAt(0)
+
+//--- (generated code: Function initialization)
+    ,_logicalName(LOGICALNAME_INVALID)
+    ,_advertisedValue(ADVERTISEDVALUE_INVALID)
+    ,_valueCallbackFunction(NULL)
+    ,_cacheExpiration(0)
+//--- (end of generated code: Function initialization)
+{
+    yInitializeCriticalSection(&_this_cs);
+}
+
+YFunction::~YFunction()
+{
+//--- (generated code: Function cleanup)
+//--- (end of generated code: Function cleanup)
+    _clearDataStreamCache();
+    yDeleteCriticalSection(&_this_cs);
+}
+
+
+// function cache methods
+YFunction*  YFunction::_FindFromCache(const string& classname, const string& func)
 {
-    if (_nCols != 0) {
-        return _nCols;
-    }
-    this->loadStream();
-    return _nCols;
+     if(_cache.find(classname + "_" + func) != _cache.end())
+        return _cache[classname + "_" + func];
+     return NULL;
 }
 
-/**
- * Returns the title (or meaning) of each data column present in this stream.
- * In most case, the title of the data column is the hardware identifier
- * of the sensor that produced the data. For streams recorded at a lower
- * recording rate, the dataLogger stores the min, average and max value
- * during each measure interval into three columns with suffixes _min,
- * _avg and _max respectively.
- *
- * If the device uses a firmware older than version 13000,
- * this method fetches the whole data stream from the device
- * if not yet done, which can cause a little delay.
- *
- * @return a list containing as many strings as there are columns in the
- *         data stream.
- *
- * On failure, throws an exception or returns an empty array.
- */
-vector<string> YDataStream::get_columnNames(void)
+void        YFunction::_AddToCache(const string& classname, const string& func, YFunction *obj)
 {
-    if ((int)_columnNames.size() != 0) {
-        return _columnNames;
+    _cache[classname + "_" + func] = obj;
+}
+
+void YFunction::_ClearCache()
+{
+    for (std::map<string, YFunction*>::iterator cache_iterator = _cache.begin();
+             cache_iterator != _cache.end(); ++cache_iterator){
+        delete cache_iterator->second;
     }
-    this->loadStream();
-    return _columnNames;
+    _cache.clear();
+    _cache = std::map<string, YFunction*>();
 }
 
-/**
- * Returns the smallest measure observed within this stream.
- * If the device uses a firmware older than version 13000,
- * this method will always return Y_DATA_INVALID.
- *
- * @return a floating-point number corresponding to the smallest value,
- *         or Y_DATA_INVALID if the stream is not yet complete (still recording).
- *
- * On failure, throws an exception or returns Y_DATA_INVALID.
- */
-double YDataStream::get_minValue(void)
+
+
+//--- (generated code: YFunction implementation)
+// static attributes
+const string YFunction::LOGICALNAME_INVALID = YAPI_INVALID_STRING;
+const string YFunction::ADVERTISEDVALUE_INVALID = YAPI_INVALID_STRING;
+
+int YFunction::_parseAttr(YJSONObject* json_val)
 {
-    return _minVal;
+    if(json_val->has("logicalName")) {
+        _logicalName =  json_val->getString("logicalName");
+    }
+    if(json_val->has("advertisedValue")) {
+        _advertisedValue =  json_val->getString("advertisedValue");
+    }
+    return 0;
 }
 
+
 /**
- * Returns the average of all measures observed within this stream.
- * If the device uses a firmware older than version 13000,
- * this method will always return Y_DATA_INVALID.
+ * Returns the logical name of the function.
  *
- * @return a floating-point number corresponding to the average value,
- *         or Y_DATA_INVALID if the stream is not yet complete (still recording).
+ * @return a string corresponding to the logical name of the function
  *
- * On failure, throws an exception or returns Y_DATA_INVALID.
+ * On failure, throws an exception or returns Y_LOGICALNAME_INVALID.
  */
-double YDataStream::get_averageValue(void)
+string YFunction::get_logicalName(void)
 {
-    return _avgVal;
+    string res;
+    yEnterCriticalSection(&_this_cs);
+    try {
+        if (_cacheExpiration <= YAPI::GetTickCount()) {
+            if (this->_load_unsafe(YAPI::DefaultCacheValidity) != YAPI_SUCCESS) {
+                {
+                    yLeaveCriticalSection(&_this_cs);
+                    return YFunction::LOGICALNAME_INVALID;
+                }
+            }
+        }
+        res = _logicalName;
+    } catch (std::exception) {
+        yLeaveCriticalSection(&_this_cs);
+        throw;
+    }
+    yLeaveCriticalSection(&_this_cs);
+    return res;
 }
 
 /**
- * Returns the largest measure observed within this stream.
- * If the device uses a firmware older than version 13000,
- * this method will always return Y_DATA_INVALID.
+ * Changes the logical name of the function. You can use yCheckLogicalName()
+ * prior to this call to make sure that your parameter is valid.
+ * Remember to call the saveToFlash() method of the module if the
+ * modification must be kept.
  *
- * @return a floating-point number corresponding to the largest value,
- *         or Y_DATA_INVALID if the stream is not yet complete (still recording).
+ * @param newval : a string corresponding to the logical name of the function
  *
- * On failure, throws an exception or returns Y_DATA_INVALID.
+ * @return YAPI_SUCCESS if the call succeeds.
+ *
+ * On failure, throws an exception or returns a negative error code.
  */
-double YDataStream::get_maxValue(void)
+int YFunction::set_logicalName(const string& newval)
 {
-    return _maxVal;
+    string rest_val;
+    int res;
+    if (!YAPI::CheckLogicalName(newval)) {
+        _throw(YAPI_INVALID_ARGUMENT, "Invalid name :" + newval);
+        return YAPI_INVALID_ARGUMENT;
+    }
+    yEnterCriticalSection(&_this_cs);
+    try {
+        rest_val = newval;
+        res = _setAttr("logicalName", rest_val);
+    } catch (std::exception) {
+         yLeaveCriticalSection(&_this_cs);
+         throw;
+    }
+    yLeaveCriticalSection(&_this_cs);
+    return res;
 }
 
 /**
- * Returns the approximate duration of this stream, in seconds.
+ * Returns a short string representing the current state of the function.
  *
- * @return the number of seconds covered by this stream.
+ * @return a string corresponding to a short string representing the current state of the function
  *
- * On failure, throws an exception or returns Y_DURATION_INVALID.
+ * On failure, throws an exception or returns Y_ADVERTISEDVALUE_INVALID.
  */
-int YDataStream::get_duration(void)
+string YFunction::get_advertisedValue(void)
 {
-    if (_isClosed) {
-        return _duration;
+    string res;
+    yEnterCriticalSection(&_this_cs);
+    try {
+        if (_cacheExpiration <= YAPI::GetTickCount()) {
+            if (this->_load_unsafe(YAPI::DefaultCacheValidity) != YAPI_SUCCESS) {
+                {
+                    yLeaveCriticalSection(&_this_cs);
+                    return YFunction::ADVERTISEDVALUE_INVALID;
+                }
+            }
+        }
+        res = _advertisedValue;
+    } catch (std::exception) {
+        yLeaveCriticalSection(&_this_cs);
+        throw;
     }
-    return (int)(((unsigned)time(NULL)) - _utcStamp);
+    yLeaveCriticalSection(&_this_cs);
+    return res;
 }
 
-/**
- * Returns the whole data set contained in the stream, as a bidimensional
- * table of numbers.
- * The meaning of the values present in each column can be obtained
- * using the method get_columnNames().
- *
- * This method fetches the whole data stream from the device,
- * if not yet done.
- *
- * @return a list containing as many elements as there are rows in the
- *         data stream. Each row itself is a list of floating-point
- *         numbers.
- *
- * On failure, throws an exception or returns an empty array.
- */
-vector< vector<double> > YDataStream::get_dataRows(void)
+int YFunction::set_advertisedValue(const string& newval)
 {
-    if (((int)_values.size() == 0) || !(_isClosed)) {
-        this->loadStream();
+    string rest_val;
+    int res;
+    yEnterCriticalSection(&_this_cs);
+    try {
+        rest_val = newval;
+        res = _setAttr("advertisedValue", rest_val);
+    } catch (std::exception) {
+         yLeaveCriticalSection(&_this_cs);
+         throw;
     }
-    return _values;
+    yLeaveCriticalSection(&_this_cs);
+    return res;
 }
 
 /**
- * Returns a single measure from the data stream, specified by its
- * row and column index.
- * The meaning of the values present in each column can be obtained
- * using the method get_columnNames().
+ * Retrieves a function for a given identifier.
+ * The identifier can be specified using several formats:
+ * <ul>
+ * <li>FunctionLogicalName</li>
+ * <li>ModuleSerialNumber.FunctionIdentifier</li>
+ * <li>ModuleSerialNumber.FunctionLogicalName</li>
+ * <li>ModuleLogicalName.FunctionIdentifier</li>
+ * <li>ModuleLogicalName.FunctionLogicalName</li>
+ * </ul>
  *
- * This method fetches the whole data stream from the device,
- * if not yet done.
+ * This function does not require that the function is online at the time
+ * it is invoked. The returned object is nevertheless valid.
+ * Use the method YFunction.isOnline() to test if the function is
+ * indeed online at a given time. In case of ambiguity when looking for
+ * a function by logical name, no error is notified: the first instance
+ * found is returned. The search is performed first by hardware name,
+ * then by logical name.
  *
- * @param row : row index
- * @param col : column index
+ * If a call to this object's is_online() method returns FALSE although
+ * you are certain that the matching device is plugged, make sure that you did
+ * call registerHub() at application initialization time.
  *
- * @return a floating-point number
+ * @param func : a string that uniquely characterizes the function
  *
- * On failure, throws an exception or returns Y_DATA_INVALID.
+ * @return a YFunction object allowing you to drive the function.
  */
-double YDataStream::get_data(int row,int col)
+YFunction* YFunction::FindFunction(string func)
 {
-    if (((int)_values.size() == 0) || !(_isClosed)) {
-        this->loadStream();
-    }
-    if (row >= (int)_values.size()) {
-        return Y_DATA_INVALID;
-    }
-    if (col >= (int)_values[row].size()) {
-        return Y_DATA_INVALID;
+    YFunction* obj = NULL;
+    int taken = 0;
+    if (YAPI::_apiInitialized) {
+        yEnterCriticalSection(&YAPI::_global_cs);
+        taken = 1;
+    }try {
+        obj = (YFunction*) YFunction::_FindFromCache("Function", func);
+        if (obj == NULL) {
+            obj = new YFunction(func);
+            YFunction::_AddToCache("Function", func, obj);
+        }
+    } catch (std::exception) {
+        if (taken) yLeaveCriticalSection(&YAPI::_global_cs);
+        throw;
     }
-    return _values[row][col];
-}
-//--- (end of generated code: YDataStream implementation)
-
-
-//--- (generated code: YMeasure implementation)
-// static attributes
-
+    if (taken) yLeaveCriticalSection(&YAPI::_global_cs);
+    return obj;
+}
 
 /**
- * Returns the start time of the measure, relative to the Jan 1, 1970 UTC
- * (Unix timestamp). When the recording rate is higher then 1 sample
- * per second, the timestamp may have a fractional part.
+ * Registers the callback function that is invoked on every change of advertised value.
+ * The callback is invoked only during the execution of ySleep or yHandleEvents.
+ * This provides control over the time when the callback is triggered. For good responsiveness, remember to call
+ * one of these two functions periodically. To unregister a callback, pass a NULL pointer as argument.
  *
- * @return an floating point number corresponding to the number of seconds
- *         between the Jan 1, 1970 UTC and the beginning of this measure.
+ * @param callback : the callback function to call, or a NULL pointer. The callback function should take two
+ *         arguments: the function object of which the value has changed, and the character string describing
+ *         the new advertised value.
+ * @noreturn
  */
-double YMeasure::get_startTimeUTC(void)
+int YFunction::registerValueCallback(YFunctionValueCallback callback)
 {
-    return _start;
+    string val;
+    if (callback != NULL) {
+        YFunction::_UpdateValueCallbackList(this, true);
+    } else {
+        YFunction::_UpdateValueCallbackList(this, false);
+    }
+    _valueCallbackFunction = callback;
+    // Immediately invoke value callback with current value
+    if (callback != NULL && this->isOnline()) {
+        val = _advertisedValue;
+        if (!(val == "")) {
+            this->_invokeValueCallback(val);
+        }
+    }
+    return 0;
 }
 
-/**
- * Returns the end time of the measure, relative to the Jan 1, 1970 UTC
- * (Unix timestamp). When the recording rate is higher than 1 sample
- * per second, the timestamp may have a fractional part.
- *
- * @return an floating point number corresponding to the number of seconds
- *         between the Jan 1, 1970 UTC and the end of this measure.
- */
-double YMeasure::get_endTimeUTC(void)
+int YFunction::_invokeValueCallback(string value)
 {
-    return _end;
+    if (_valueCallbackFunction != NULL) {
+        _valueCallbackFunction(this, value);
+    } else {
+    }
+    return 0;
 }
 
 /**
- * Returns the smallest value observed during the time interval
- * covered by this measure.
+ * Disables the propagation of every new advertised value to the parent hub.
+ * You can use this function to save bandwidth and CPU on computers with limited
+ * resources, or to prevent unwanted invocations of the HTTP callback.
+ * Remember to call the saveToFlash() method of the module if the
+ * modification must be kept.
  *
- * @return a floating-point number corresponding to the smallest value observed.
+ * @return YAPI_SUCCESS when the call succeeds.
+ *
+ * On failure, throws an exception or returns a negative error code.
  */
-double YMeasure::get_minValue(void)
+int YFunction::muteValueCallbacks(void)
 {
-    return _minVal;
+    return this->set_advertisedValue("SILENT");
 }
 
 /**
- * Returns the average value observed during the time interval
- * covered by this measure.
+ * Re-enables the propagation of every new advertised value to the parent hub.
+ * This function reverts the effect of a previous call to muteValueCallbacks().
+ * Remember to call the saveToFlash() method of the module if the
+ * modification must be kept.
  *
- * @return a floating-point number corresponding to the average value observed.
+ * @return YAPI_SUCCESS when the call succeeds.
+ *
+ * On failure, throws an exception or returns a negative error code.
  */
-double YMeasure::get_averageValue(void)
+int YFunction::unmuteValueCallbacks(void)
 {
-    return _avgVal;
+    return this->set_advertisedValue("");
 }
 
 /**
- * Returns the largest value observed during the time interval
- * covered by this measure.
+ * Returns the current value of a single function attribute, as a text string, as quickly as
+ * possible but without using the cached value.
  *
- * @return a floating-point number corresponding to the largest value observed.
+ * @param attrName : the name of the requested attribute
+ *
+ * @return a string with the value of the the attribute
+ *
+ * On failure, throws an exception or returns an empty string.
  */
-double YMeasure::get_maxValue(void)
+string YFunction::loadAttribute(string attrName)
 {
-    return _maxVal;
+    string url;
+    string attrVal;
+    url = YapiWrapper::ysprintf("api/%s/%s", this->get_functionId().c_str(),attrName.c_str());
+    attrVal = this->_download(url);
+    return attrVal;
 }
-//--- (end of generated code: YMeasure implementation)
 
-time_t*   YMeasure::get_startTimeUTC_asTime_t(time_t *time)
+int YFunction::_parserHelper(void)
 {
-    if(time){
-        memcpy(time,&this->_stopTime_t,sizeof(time_t));
-    }
-    return &this->_startTime_t;
+    return 0;
+}
 
+YFunction *YFunction::nextFunction(void)
+{
+    string  hwid;
+
+    if(YISERR(_nextFunction(hwid)) || hwid=="") {
+        return NULL;
+    }
+    return YFunction::FindFunction(hwid);
 }
-time_t*   YMeasure::get_endTimeUTC_asTime_t(time_t *time)
+
+YFunction* YFunction::FirstFunction(void)
 {
-    if(time){
-        memcpy(time,&this->_stopTime_t,sizeof(time_t));
+    vector<YFUN_DESCR>   v_fundescr;
+    YDEV_DESCR             ydevice;
+    string              serial, funcId, funcName, funcVal, errmsg;
+
+    if(YISERR(YapiWrapper::getFunctionsByClass("Function", 0, v_fundescr, sizeof(YFUN_DESCR), errmsg)) ||
+       v_fundescr.size() == 0 ||
+       YISERR(YapiWrapper::getFunctionInfo(v_fundescr[0], ydevice, serial, funcId, funcName, funcVal, errmsg))) {
+        return NULL;
     }
-    return &this->_stopTime_t;
+    return YFunction::FindFunction(serial+"."+funcId);
 }
 
-//--- (generated code: YDataSet implementation)
-// static attributes
+//--- (end of generated code: YFunction implementation)
 
+//--- (generated code: Function functions)
+//--- (end of generated code: Function functions)
 
-vector<int> YDataSet::_get_calibration(void)
+void YFunction::_throw(YRETCODE errType, string errMsg)
 {
-    return _calib;
+    _lastErrorType = errType;
+    _lastErrorMsg = errMsg;
+    // Method used to throw exceptions or save error type/message
+    if(!YAPI::ExceptionsDisabled) {
+        throw YAPI_Exception(errType, errMsg);
+    }
 }
 
-int YDataSet::processMore(int progress,string data)
+// Method used to resolve our name to our unique function descriptor (may trigger a hub scan)
+YRETCODE YFunction::_getDescriptor(YFUN_DESCR& fundescr, string& errmsg)
 {
-    YDataStream* stream = NULL;
-    vector< vector<double> > dataRows;
-    string strdata;
-    double tim = 0.0;
-    double itv = 0.0;
-    int nCols = 0;
-    int minCol = 0;
-    int avgCol = 0;
-    int maxCol = 0;
+    int res;
+    YFUN_DESCR tmp_fundescr;
 
-    if (progress != _progress) {
-        return _progress;
-    }
-    if (_progress < 0) {
-        strdata = data;
-        if (strdata == "{}") {
-            _parent->_throw(YAPI_VERSION_MISMATCH, "device firmware is too old");
-            return YAPI_VERSION_MISMATCH;
+    tmp_fundescr = YapiWrapper::getFunction(_className, _func, errmsg);
+    if(YISERR(tmp_fundescr)) {
+        res = YapiWrapper::updateDeviceList(true,errmsg);
+        if(YISERR(res)) {
+            return (YRETCODE)res;
+        }
+        tmp_fundescr = YapiWrapper::getFunction(_className, _func, errmsg);
+        if(YISERR(tmp_fundescr)) {
+            return (YRETCODE)tmp_fundescr;
         }
-        return this->_parse(strdata);
-    }
-    stream = _streams[_progress];
-    stream->_parseStream(data);
-    dataRows = stream->get_dataRows();
-    _progress = _progress + 1;
-    if ((int)dataRows.size() == 0) {
-        return this->get_progress();
     }
-    tim = (double) stream->get_startTimeUTC();
-    itv = stream->get_dataSamplesInterval();
-    if (tim < itv) {
-        tim = itv;
+    if (_fundescr != tmp_fundescr) {
+        // keep the callback indexes in sync with our descriptor
+        yapiLockFunctionCallBack(NULL);
+        yCallbackIndexMove(_FunctionCallbacks, this, _fundescr, tmp_fundescr);
+        yCallbackIndexMove(_TimedReportCallbackList, this, _fundescr, tmp_fundescr);
+        _fundescr = tmp_fundescr;
+        yapiUnlockFunctionCallBack(NULL);
     }
-    nCols = (int)dataRows[0].size();
-    minCol = 0;
-    if (nCols > 2) {
-        avgCol = 1;
-    } else {
-        avgCol = 0;
+    fundescr = tmp_fundescr;
+    return YAPI_SUCCESS;
+}
+
+// Method used to get the advertised value last pushed by notification, if
+// YAPI::NotificationCacheValidity is set and the value is recent enough.
+// Only used once the function has been loaded, so that its descriptor (and
+// its sensor resolution) are known without triggering any hub traffic, and
+// while that load is itself younger than NotificationCacheValidity.
+bool YFunction::_getPushedValue(string& value)
+{
+    std::map<YFUN_DESCR,yPushedValue>::const_iterator it;
+    bool found = false;
+
+    if (YAPI::NotificationCacheValidity <= 0 || _cacheExpiration == 0 || YISERR(_fundescr) ||
+        yapiGetTickCount() - _loadedAt >= (u64)YAPI::NotificationCacheValidity) {
+        return false;
     }
-    if (nCols > 2) {
-        maxCol = 2;
-    } else {
-        maxCol = 0;
+    yEnterCriticalSection(&_pushedValues_CS);
+    it = _pushedValues.find(_fundescr);
+    if (it != _pushedValues.end() && yapiGetTickCount() - it->second.stamp < (u64)YAPI::NotificationCacheValidity) {
+        value = it->second.value;
+        found = true;
     }
+    yLeaveCriticalSection(&_pushedValues_CS);
+    return found;
+}
 
-    for (unsigned ii = 0; ii < dataRows.size(); ii++) {
-        if ((tim >= _startTime) && ((_endTime == 0) || (tim <= _endTime))) {
-            _measures.push_back(YMeasure(tim - itv, tim,
-            dataRows[ii][minCol],
-            dataRows[ii][avgCol],dataRows[ii][maxCol]));
-        }
-        tim = tim + itv;
-        tim = floor(tim * 1000+0.5) / 1000.0;
+// Method used to update the attributes carried by a pushed advertised value,
+// returns false when the value cannot replace a load from the device
+bool YFunction::_applyPushedValue(const string& pushed)
+{
+    _advertisedValue = pushed;
+    return true;
+}
+
+// Return a pointer to our device caching object (may trigger a hub scan)
+YRETCODE YFunction::_getDevice(YDevice*& dev, string& errmsg)
+{
+    YFUN_DESCR   fundescr;
+    YDEV_DESCR     devdescr;
+    YRETCODE    res;
+
+    // Resolve function name
+    res = _getDescriptor(fundescr, errmsg);
+    if(YISERR(res)) return res;
+
+    // Get device descriptor
+    devdescr = YapiWrapper::getDeviceByFunction(fundescr, errmsg);
+    if(YISERR(devdescr)) return (YRETCODE)devdescr;
+
+    // Get device object
+    dev = YDevice::getDevice(devdescr);
+
+    return YAPI_SUCCESS;
+}
+
+// Return the next known function of current class listed in the yellow pages
+YRETCODE YFunction::_nextFunction(string& hwid)
+{
+    vector<YFUN_DESCR>   v_fundescr;
+    YFUN_DESCR           fundescr;
+    YDEV_DESCR           devdescr;
+    string               serial, funcId, funcName, funcVal, errmsg;
+    int                  res;
+
+    res = _getDescriptor(fundescr, errmsg);
+    if(YISERR(res)) {
+        _throw((YRETCODE)res, errmsg);
+        return (YRETCODE)res;
+    }
+    res = YapiWrapper::getFunctionsByClass(_className, fundescr, v_fundescr, sizeof(YFUN_DESCR), errmsg);
+    if(YISERR((YRETCODE)res)) {
+        _throw((YRETCODE)res, errmsg);
+        return (YRETCODE)res;
+    }
+    if(v_fundescr.size() == 0) {
+        hwid = "";
+        return YAPI_SUCCESS;
     }
-    return this->get_progress();
+    res = YapiWrapper::getFunctionInfo(v_fundescr[0], devdescr, serial, funcId, funcName, funcVal, errmsg);
+    if(YISERR(res)) {
+        _throw((YRETCODE)res, errmsg);
+        return (YRETCODE)res;
+    }
+    hwid = serial+"."+funcId;
+
+    return YAPI_SUCCESS;
 }
 
-vector<YDataStream*> YDataSet::get_privateDataStreams(void)
+// Parse a long JSON string
+string  YFunction::_parseString(yJsonStateMachine& j)
 {
-    return _streams;
+    string  res;
+
+    do {
+#ifdef WINDOWS_API
+        res += j.token;
+#else
+        char buffer[128];
+        char *pt, *s;
+        s = j.token;
+        pt = buffer;
+        while (*s) {
+            unsigned char c = *s++;
+            if (c < 128) {
+                *pt++ = c;
+            } else {
+                // UTF8-encode character
+                *pt++ = 0xc2 + (c>0xbf ? 1 : 0);
+                *pt++ = (c & 0x3f) + 0x80;
+            }
+        }
+        *pt = 0;
+        res += buffer;
+#endif
+    } while (j.next == YJSON_PARSE_STRINGCONT && yJsonParse(&j) == YJSON_PARSE_AVAIL);
+
+    return res;
 }
 
-/**
- * Returns the unique hardware identifier of the function who performed the measures,
- * in the form SERIAL.FUNCTIONID. The unique hardware identifier is composed of the
- * device serial number and of the hardware identifier of the function
- * (for example THRMCPL1-123456.temperature1)
- *
- * @return a string that uniquely identifies the function (ex: THRMCPL1-123456.temperature1)
- *
- * On failure, throws an exception or returns  Y_HARDWAREID_INVALID.
- */
-string YDataSet::get_hardwareId(void)
+string      YFunction::_json_get_key(const string& json, const string& key)
 {
-    YModule* mo = NULL;
-    if (!(_hardwareId == "")) {
-        return _hardwareId;
+    yJsonStateMachine j;
+
+    // Parse JSON data for the device and locate our function in it
+    j.src = json.c_str();
+    j.end = j.src + strlen(j.src);
+    j.st = YJSON_START;
+    if(yJsonParse(&j) != YJSON_PARSE_AVAIL || j.st != YJSON_PARSE_STRUCT) {
+        this->_throw(YAPI_IO_ERROR,"JSON structure expected");
+        return YAPI_INVALID_STRING;
     }
-    mo = _parent->get_module();
-    _hardwareId = YapiWrapper::ysprintf("%s.%s", mo->get_serialNumber().c_str(),this->get_functionId().c_str());
-    return _hardwareId;
+    while(yJsonParse(&j) == YJSON_PARSE_AVAIL && j.st == YJSON_PARSE_MEMBNAME) {
+        if (!strcmp(j.token, key.c_str())) {
+            if (yJsonParse(&j) != YJSON_PARSE_AVAIL) {
+                this->_throw(YAPI_IO_ERROR,"JSON structure expected");
+                return YAPI_INVALID_STRING;
+            }
+            return  _parseString(j);
+        }
+        yJsonSkip(&j, 1);
+    }
+    this->_throw(YAPI_IO_ERROR,"invalid JSON structure");
+    return YAPI_INVALID_STRING;
 }
 
-/**
- * Returns the hardware identifier of the function that performed the measure,
- * without reference to the module. For example temperature1.
- *
- * @return a string that identifies the function (ex: temperature1)
- */
-string YDataSet::get_functionId(void)
+string YFunction::_json_get_string(const string& json)
 {
-    return _functionId;
+    yJsonStateMachine j;
+    j.src = json.c_str();
+    j.end = j.src + strlen(j.src);
+    j.st = YJSON_START;
+    if(yJsonParse(&j) != YJSON_PARSE_AVAIL || j.st != YJSON_PARSE_STRING) {
+        this->_throw(YAPI_IO_ERROR,"JSON string expected");
+        return "";
+    }
+    return _parseString(j);
 }
 
-/**
- * Returns the measuring unit for the measured value.
- *
- * @return a string that represents a physical unit.
- *
- * On failure, throws an exception or returns  Y_UNIT_INVALID.
- */
-string YDataSet::get_unit(void)
+vector<string> YFunction::_json_get_array(const string& json)
 {
-    return _unit;
-}
+    vector<string> res;
+    yJsonStateMachine j;
+    const char *json_cstr,*last;
+    string backup = json;
+    j.src = json_cstr = json.c_str();
+    j.end = j.src + strlen(j.src);
+    j.st = YJSON_START;
+    if(yJsonParse(&j) != YJSON_PARSE_AVAIL || j.st != YJSON_PARSE_ARRAY) {
+        this->_throw(YAPI_IO_ERROR,"JSON structure expected");
+        return res;
+    }
+    int depth = j.depth;
+    do {
+        last = j.src;
+        while (yJsonParse(&j) == YJSON_PARSE_AVAIL) {
+            if (j.next == YJSON_PARSE_STRINGCONT || j.depth > depth){
+                continue;
+            }
+            break;
+        }
+        if (j.st == YJSON_PARSE_ERROR) {
+            this->_throw(YAPI_IO_ERROR, "invalid JSON structure");
+            return res;
+        }
 
-/**
- * Returns the start time of the dataset, relative to the Jan 1, 1970.
- * When the YDataSet is created, the start time is the value passed
- * in parameter to the get_dataSet() function. After the
- * very first call to loadMore(), the start time is updated
- * to reflect the timestamp of the first measure actually found in the
- * dataLogger within the specified range.
- *
- * @return an unsigned number corresponding to the number of seconds
- *         between the Jan 1, 1970 and the beginning of this data
- *         set (i.e. Unix time representation of the absolute time).
- */
-s64 YDataSet::get_startTimeUTC(void)
-{
-    return _startTime;
+        if (j.depth == depth) {
+            long location, length;
+            while (*last == ',' || *last == '\n'){
+                last++;
+            }
+            location = (long)(last - json_cstr);
+            length = (long)(j.src - last);
+            string item = json.substr(location, length);
+            res.push_back(item);
+        }
+    } while (j.st != YJSON_PARSE_ARRAY );
+    return res;
 }
 
-/**
- * Returns the end time of the dataset, relative to the Jan 1, 1970.
- * When the YDataSet is created, the end time is the value passed
- * in parameter to the get_dataSet() function. After the
- * very first call to loadMore(), the end time is updated
- * to reflect the timestamp of the last measure actually found in the
- * dataLogger within the specified range.
- *
- * @return an unsigned number corresponding to the number of seconds
- *         between the Jan 1, 1970 and the end of this data
- *         set (i.e. Unix time representation of the absolute time).
- */
-s64 YDataSet::get_endTimeUTC(void)
+string YFunction::_get_json_path(const string& json, const string& path)
 {
-    return _endTime;
+    const char *json_data = json.c_str();
+    int len = (int)(json.length() & 0x0fffffff);
+    const char *p;
+    char        errbuff[YOCTO_ERRMSG_LEN];
+    int res;
+
+    res = yapiJsonGetPath(path.c_str(), json_data, len, &p, errbuff);
+    if (res >= 0) {
+        string result = string(p, res);
+        if (res > 0) {
+            yapiFreeMem((void*)p);
+        }
+        return result;
+    }
+    return "";
 }
 
-/**
- * Returns the progress of the downloads of the measures from the data logger,
- * on a scale from 0 to 100. When the object is instantiated by get_dataSet,
- * the progress is zero. Each time loadMore() is invoked, the progress
- * is updated, to reach the value 100 only once all measures have been loaded.
- *
- * @return an integer in the range 0 to 100 (percentage of completion).
- */
-int YDataSet::get_progress(void)
+string YFunction::_decode_json_string(const string& json)
 {
-    if (_progress < 0) {
-        return 0;
+    int len = (int)(json.length() & 0x0fffffff);
+    char buffer[128];
+    char *p = buffer;
+    int decoded_len;
+
+    if (len >= 127){
+        p = (char*) malloc(len + 1);
+
     }
-    // index not yet loaded
-    if (_progress >= (int)_streams.size()) {
-        return 100;
+    decoded_len = yapiJsonDecodeString(json.c_str(), p);
+    string result = string(p, decoded_len);
+    if (len >= 127){
+        free(p);
     }
-    return ((1 + (1 + _progress) * 98) / ((1 + (int)_streams.size())));
+    return result;
 }
 
-/**
- * Loads the the next block of measures from the dataLogger, and updates
- * the progress indicator.
- *
- * @return an integer in the range 0 to 100 (percentage of completion),
- *         or a negative error code in case of failure.
- *
- * On failure, throws an exception or returns a negative error code.
- */
-int YDataSet::loadMore(void)
+
+string  YFunction::_escapeAttr(const string& changeval)
 {
-    string url;
-    YDataStream* stream = NULL;
-    if (_progress < 0) {
-        url = YapiWrapper::ysprintf("logger.json?id=%s",_functionId.c_str());
-        if (_startTime != 0) {
-            url = YapiWrapper::ysprintf("%s&from=%u",url.c_str(),_startTime);
-        }
-        if (_endTime != 0) {
-            url = YapiWrapper::ysprintf("%s&to=%u",url.c_str(),_endTime);
-        }
-    } else {
-        if (_progress >= (int)_streams.size()) {
-            return 100;
+    const char *p;
+    unsigned char c;
+    unsigned char esc[3];
+    string escaped = "";
+    esc[0] = '%';
+    for (p = changeval.c_str(); (c = *p) != 0; p++) {
+        if (c <= ' ' || (c > 'z' && c != '~') || c == '"' || c == '%' || c == '&' ||
+            c == '+' || c == '<' || c == '=' || c == '>' || c == '\\' || c == '^' || c == '`') {
+            if ((c==0xc2 || c==0xc3) && (p[1] & 0xc0)==0x80) {
+                // UTF8-encoded ISO-8859-1 character: translate to plain ISO-8859-1
+                c = (c & 1) * 0x40;
+                p++;
+                c += *p;
+            }
+            esc[1] = (c >= 0xa0 ? (c >> 4) - 10 + 'A' : (c >> 4) + '0');
+            c &= 0xf;
+            esc[2] = (c >= 0xa ? c - 10 + 'A' : c + '0');
+            escaped.append((char*)esc, 3);
         } else {
-            stream = _streams[_progress];
-            url = stream->_get_url();
+            escaped.append((char*)&c, 1);
         }
     }
-    return this->processMore(_progress, _parent->_download(url));
+    return escaped;
 }
 
-/**
- * Returns an YMeasure object which summarizes the whole
- * DataSet. In includes the following information:
- * - the start of a time interval
- * - the end of a time interval
- * - the minimal value observed during the time interval
- * - the average value observed during the time interval
- * - the maximal value observed during the time interval
- *
- * This summary is available as soon as loadMore() has
- * been called for the first time.
- *
- * @return an YMeasure object
- */
-YMeasure YDataSet::get_summary(void)
+
+YRETCODE  YFunction::_buildSetRequest( const string& changeattr, const string  *changeval, string& request, string& errmsg)
 {
-    return _summary;
+    int res;
+    YFUN_DESCR fundesc;
+    char        funcid[YOCTO_FUNCTION_LEN];
+    char        errbuff[YOCTO_ERRMSG_LEN];
+
+
+    // Resolve the function name
+    res = _getDescriptor(fundesc, errmsg);
+    if(YISERR(res)) {
+        return (YRETCODE)res;
+    }
+
+    if(YISERR(res=yapiGetFunctionInfo(fundesc, NULL, NULL, funcid, NULL, NULL,errbuff))){
+        errmsg = errbuff;
+        _throw((YRETCODE)res, errmsg);
+        return (YRETCODE)res;
+    }
+    request = "GET /api/";
+    request.append(funcid);
+    request.append("/");
+    //request.append(".json/");
+
+    if(changeattr!="") {
+        request.append(changeattr);
+        if(changeval) {
+            request.append("?");
+            request.append(changeattr);
+            request.append("=");
+            request.append(_escapeAttr(*changeval));
+        }
+    }
+    // don't append HTTP/1.1 so that we get light headers from hub
+    // but append &. suffix to enable connection keepalive on newer hubs
+    request.append("&. \r\n\r\n");
+    return YAPI_SUCCESS;
 }
 
-/**
- * Returns a condensed version of the measures that can
- * retrieved in this YDataSet, as a list of YMeasure
- * objects. Each item includes:
- * - the start of a time interval
- * - the end of a time interval
- * - the minimal value observed during the time interval
- * - the average value observed during the time interval
- * - the maximal value observed during the time interval
- *
- * This preview is available as soon as loadMore() has
- * been called for the first time.
- *
- * @return a table of records, where each record depicts the
- *         measured values during a time interval
- *
- * On failure, throws an exception or returns an empty array.
- */
-vector<YMeasure> YDataSet::get_preview(void)
+
+
+int YFunction::_parse(YJSONObject *j)
 {
-    return _preview;
+    this->_parseAttr(j);
+    this->_parserHelper();
+    return 0;
 }
 
-/**
- * Returns the detailed set of measures for the time interval corresponding
- * to a given condensed measures previously returned by get_preview().
- * The result is provided as a list of YMeasure objects.
- *
- * @param measure : condensed measure from the list previously returned by
- *         get_preview().
- *
- * @return a table of records, where each record depicts the
- *         measured values during a time interval
- *
- * On failure, throws an exception or returns an empty array.
- */
-vector<YMeasure> YDataSet::get_measuresAt(YMeasure measure)
+// Set an attribute in the function, and parse the resulting new function state
+YRETCODE YFunction::_setAttr(string attrname, string newvalue)
 {
-    s64 startUtc = 0;
-    YDataStream* stream = NULL;
-    vector< vector<double> > dataRows;
-    vector<YMeasure> measures;
-    double tim = 0.0;
-    double itv = 0.0;
-    int nCols = 0;
-    int minCol = 0;
-    int avgCol = 0;
-    int maxCol = 0;
+    string      errmsg, request;
+    int         res;
+    YDevice     *dev;
 
-    startUtc = (s64) floor(measure.get_startTimeUTC()+0.5);
-    stream = NULL;
-    for (unsigned ii = 0; ii < _streams.size(); ii++) {
-        if (_streams[ii]->get_startTimeUTC() == startUtc) {
-            stream = _streams[ii];
+    // the batch may be committed or cancelled by another thread
+    yEnterCriticalSection(&_this_cs);
+    if (_batching) {
+        // sent later by commitBatch()
+        yapiAttrWrite write;
+        write.attrName = attrname;
+        write.attrValue = newvalue;
+        write.errorType = YAPI_SUCCESS;
+        _batchWrites.push_back(write);
+        yLeaveCriticalSection(&_this_cs);
+        return YAPI_SUCCESS;
+    }
+    yLeaveCriticalSection(&_this_cs);
+    if (_asyncWrites) {
+        res = _setAttrAsync(attrname, newvalue, _lastWrite, errmsg);
+        if (YISERR(res)) {
+            _throw((YRETCODE)res, errmsg);
         }
+        return (YRETCODE)res;
     }
-    if (stream == NULL) {
-        return measures;
+    // Execute http request
+    res = _buildSetRequest(attrname, &newvalue, request, errmsg);
+    if(YISERR(res)) {
+        _throw((YRETCODE)res, errmsg);
+        return (YRETCODE)res;
     }
-    dataRows = stream->get_dataRows();
-    if ((int)dataRows.size() == 0) {
-        return measures;
+    // Get device Object
+    res = _getDevice(dev,  errmsg);
+    if(YISERR(res)) {
+        _throw((YRETCODE)res, errmsg);
+        return (YRETCODE)res;
     }
-    tim = (double) stream->get_startTimeUTC();
-    itv = stream->get_dataSamplesInterval();
-    if (tim < itv) {
-        tim = itv;
+
+    res = dev->HTTPRequestAsync(0, request, NULL, NULL, errmsg);
+    if(YISERR(res)) {
+        // Check if an update of the device list does not solve the issue
+        res = YapiWrapper::updateDeviceList(true,errmsg);
+        if(YISERR(res)) {
+            _throw((YRETCODE)res, errmsg);
+            return (YRETCODE)res;
+        }
+        res = dev->HTTPRequestAsync(0, request, NULL, NULL, errmsg);
+        if(YISERR(res)) {
+            _throw((YRETCODE)res, errmsg);
+            return (YRETCODE)res;
+        }
     }
-    nCols = (int)dataRows[0].size();
-    minCol = 0;
-    if (nCols > 2) {
-        avgCol = 1;
-    } else {
-        avgCol = 0;
+    if (_cacheExpiration != 0) {
+        _cacheExpiration=0;
     }
-    if (nCols > 2) {
-        maxCol = 2;
-    } else {
-        maxCol = 0;
+    yForgetPushedValue(_fundescr);
+    return YAPI_SUCCESS;
+
+}
+
+
+// Append a change to the query string of a multi-attribute write, unless the
+// query would exceed YAPI_BATCH_MAX_QUERY bytes or already changes the same
+// attribute, since the device applies the changes in query order.
+static bool yAppendWriteQuery(string& query, vector<string>& attrs, const string& attrName, const string& escapedValue)
+{
+    size_t  itemlen = attrName.length() + 1 + escapedValue.length();
+
+    if (!attrs.empty()) {
+        if (query.length() + 1 + itemlen > YAPI_BATCH_MAX_QUERY) {
+            return false;
+        }
+        if (std::find(attrs.begin(), attrs.end(), attrName) != attrs.end()) {
+            return false;
+        }
+        query.append("&");
     }
+    attrs.push_back(attrName);
+    query.append(attrName);
+    query.append("=");
+    query.append(escapedValue);
+    return true;
+}
 
-    for (unsigned ii = 0; ii < dataRows.size(); ii++) {
-        if ((tim >= _startTime) && ((_endTime == 0) || (tim <= _endTime))) {
-            measures.push_back(YMeasure(tim - itv, tim,
-            dataRows[ii][minCol],
-            dataRows[ii][avgCol],dataRows[ii][maxCol]));
+// Send the changes from writes[start] on in a single request, and return the
+// index of the first change left for the next request.
+YRETCODE YFunction::_sendBatchRequest(YDevice *dev, const char *funcid, vector<yapiAttrWrite>& writes, size_t start, size_t& end, string& errmsg)
+{
+    string          query, request, buffer;
+    vector<string>  attrs;
+    YRETCODE        res;
+
+    for (end = start; end < writes.size(); end++) {
+        if (!yAppendWriteQuery(query, attrs, writes[end].attrName, _escapeAttr(writes[end].attrValue))) {
+            break;
         }
-        tim = tim + itv;
     }
-    return measures;
+    // light reply with the first attribute only, as in _buildSetRequest
+    request = "GET /api/";
+    request.append(funcid);
+    request.append("/");
+    request.append(writes[start].attrName);
+    request.append("?");
+    request.append(query);
+    request.append("&. \r\n\r\n");
+    res = dev->HTTPRequest(0, request, buffer, NULL, NULL, errmsg);
+    if (YISERR(res)) {
+        // Check if an update of the device list does not solve the issue
+        res = YapiWrapper::updateDeviceList(true, errmsg);
+        if (YISERR(res)) {
+            return res;
+        }
+        res = dev->HTTPRequest(0, request, buffer, NULL, NULL, errmsg);
+        if (YISERR(res)) {
+            return res;
+        }
+    }
+    if (0 != buffer.find("OK\r\n") && 0 != buffer.find("HTTP/1.1 200 OK\r\n")) {
+        errmsg = "http request failed";
+        return YAPI_IO_ERROR;
+    }
+    return YAPI_SUCCESS;
 }
 
-/**
- * Returns all measured values currently available for this DataSet,
- * as a list of YMeasure objects. Each item includes:
- * - the start of the measure time interval
- * - the end of the measure time interval
- * - the minimal value observed during the time interval
- * - the average value observed during the time interval
- * - the maximal value observed during the time interval
- *
- * Before calling this method, you should call loadMore()
- * to load data from the device. You may have to call loadMore()
- * several time until all rows are loaded, but you can start
- * looking at available data rows before the load is complete.
- *
- * The oldest measures are always loaded first, and the most
- * recent measures will be loaded last. As a result, timestamps
- * are normally sorted in ascending order within the measure table,
- * unless there was an unexpected adjustment of the datalogger UTC
- * clock.
- *
- * @return a table of records, where each record depicts the
- *         measured value for a given time interval
- *
- * On failure, throws an exception or returns an empty array.
- */
-vector<YMeasure> YDataSet::get_measures(void)
+
+// An attribute change sent asynchronously. It is shared by the YAsyncWrite
+// tokens and by the queue or request carrying it, and freed by the last one
+// to release it. All fields are protected by _async_cs.
+struct yAsyncWriteSt {
+    int         refcount;
+    bool        done;
+    YRETCODE    res;
+    string      errmsg;
+    YDEV_DESCR  devdescr;
+    string      funcid;
+    string      attrName;
+    string      attrValue;  // already escaped
+};
+
+// A request sent without waiting for the reply. It is shared by the
+// YAsyncRequest tokens and by the queue or request carrying it (then by the
+// list of coroutines to resume), and freed by the last one to release it.
+// The fields describing the request are set before it is queued, the others
+// are protected by _async_cs.
+struct yAsyncRequestSt {
+    int         refcount;
+    bool        done;
+    YRETCODE    res;
+    string      errmsg;
+    string      content;
+    void        (*resume)(void*);
+    void        *resumeCtx;
+    YDEV_DESCR  devdescr;
+    string      device;         // empty if the request was never queued
+    int         tcpchan;
+    string      request;
+    bool        bodyOnly;       // strip the HTTP header from the reply
+};
+
+// An entry of a queue: either a write, or a request
+struct yAsyncQueued {
+    yAsyncWriteSt   *write;
+    yAsyncRequestSt *request;
+};
+
+// Asynchronous writes and requests not sent yet to a device, in order. Over
+// HTTP or USB, a device has at most one asynchronous request in flight, which
+// keeps them in order. Behind an HTTP hub, this request is sent on a
+// connection of the device, not on the ones of the hub, so that the devices
+// of a hub are served in parallel. Over a websocket, the next request is sent
+// without waiting for the reply, on the same channel, which keeps them in
+// order (the hub still processes them one at a time).
+struct yAsyncQueue {
+    bool                        pipelined;
+    bool                        busy;
+    std::deque<yAsyncQueued>    items;
+
+    yAsyncQueue() : pipelined(false), busy(false) {}
+};
+
+// A request carrying consecutive writes to the same function
+struct yAsyncWriteReq {
+    string                  device;
+    vector<yAsyncWriteSt*>  writes;
+};
+
+// The asynchronous writes and requests share a lock and a completion event
+static  yCRITICAL_SECTION                   _async_cs;
+static  yEvent                              _async_event;       // set when an asynchronous request ends
+static  bool                                _async_active = false;
+static  std::map<string,yAsyncQueue>        _async_queues;      // by device serial
+static  int                                 _async_pending = 0; // entries waiting in the queues
+static  std::deque<yAsyncRequestSt*>        _async_ready;       // coroutines to resume
+
+// Tokens may outlive YAPI::FreeAPI(), and the lock with it
+static void yAsyncEnter(void)
+{
+    if (_async_active) {
+        yEnterCriticalSection(&_async_cs);
+    }
+}
+
+static void yAsyncLeave(void)
 {
-    return _measures;
+    if (_async_active) {
+        yLeaveCriticalSection(&_async_cs);
+    }
 }
-//--- (end of generated code: YDataSet implementation)
 
+static void yAsyncWriteRelease(yAsyncWriteSt *w)
+{
+    int refcount;
 
-std::map<string,YFunction*> YFunction::_cache;
+    yAsyncEnter();
+    refcount = --w->refcount;
+    yAsyncLeave();
+    if (refcount == 0) {
+        delete w;
+    }
+}
 
+static void yAsyncRequestRelease(yAsyncRequestSt *r)
+{
+    int refcount;
 
-// Constructor is protected. Use the device-specific factory function to instantiate
-YFunction::YFunction(const string& func):
-    _className("Function"),_func(func),
-    _lastErrorType(YAPI_SUCCESS),_lastErrorMsg(""),
-    _fundescr(Y_FUNCTIONDESCRIPTOR_INVALID), _userData(NULL)
+    yAsyncEnter();
+    refcount = --r->refcount;
+    yAsyncLeave();
+    if (refcount == 0) {
+        delete r;
+    }
+}
 
-//--- (generated code: Function initialization)
-    ,_logicalName(LOGICALNAME_INVALID)
-    ,_advertisedValue(ADVERTISEDVALUE_INVALID)
-    ,_valueCallbackFunction(NULL)
-    ,_cacheExpiration(0)
-//--- (end of generated code: Function initialization)
+// Find whether the requests to a device can be pipelined
+static YRETCODE yAsyncRoute(const char *serial, bool& pipelined, string& errmsg)
 {
-    yInitializeCriticalSection(&_this_cs);
+    char        rootdevice[YOCTO_SERIAL_LEN];
+    char        url[512];
+    char        errbuff[YOCTO_ERRMSG_LEN];
+    int         neededsize = 0;
+    YRETCODE    res;
+
+    res = yapiGetDevicePathEx(serial, rootdevice, url, sizeof(url), &neededsize, errbuff);
+    if (YISERR(res)) {
+        errmsg = errbuff;
+        return res;
+    }
+    pipelined = (strncmp(url, "ws://", 5) == 0);
+    return YAPI_SUCCESS;
 }
 
-YFunction::~YFunction()
+// Append a write or a request to the queue of its device, which takes
+// over the reference of the caller
+static void yAsyncPush(const string& device, bool pipelined, yAsyncWriteSt *write, yAsyncRequestSt *request)
 {
-//--- (generated code: Function cleanup)
-//--- (end of generated code: Function cleanup)
-    _clearDataStreamCache();
-    yDeleteCriticalSection(&_this_cs);
+    yAsyncQueued item;
+
+    item.write = write;
+    item.request = request;
+    yEnterCriticalSection(&_async_cs);
+    _async_queues[device].pipelined = pipelined;
+    _async_queues[device].items.push_back(item);
+    _async_pending++;
+    yLeaveCriticalSection(&_async_cs);
 }
 
+// Report the outcome of a write request and let the device take the next one
+static void yAsyncWriteFinish(yAsyncWriteReq *req, YRETCODE res, const string& errmsg)
+{
+    size_t  i;
 
-// function cache methods
-YFunction*  YFunction::_FindFromCache(const string& classname, const string& func)
+    yEnterCriticalSection(&_async_cs);
+    for (i = 0; i < req->writes.size(); i++) {
+        req->writes[i]->res = res;
+        req->writes[i]->errmsg = (YISERR(res) ? errmsg : "");
+        req->writes[i]->done = true;
+    }
+    _async_queues[req->device].busy = false;
+    yLeaveCriticalSection(&_async_cs);
+    for (i = 0; i < req->writes.size(); i++) {
+        yAsyncWriteRelease(req->writes[i]);
+    }
+    delete req;
+}
+
+static void yAsyncWriteDone(void *context, const u8 *result, u32 resultlen, int retcode, const char *errmsg)
 {
-     if(_cache.find(classname + "_" + func) != _cache.end())
-        return _cache[classname + "_" + func];
-     return NULL;
+    yAsyncWriteReq  *req = (yAsyncWriteReq*)context;
+    string          reply;
+
+    // the next request cannot be sent from here, as the request of the device
+    // is not released yet: wake up the threads handling events instead
+    if (YISERR(retcode)) {
+        yAsyncWriteFinish(req, (YRETCODE)retcode, (errmsg && *errmsg ? errmsg : "http request failed"));
+    } else {
+        if (result != NULL && resultlen > 0) {
+            reply.assign((const char*)result, resultlen);
+        }
+        // same checks as YFunction::_requestEx()
+        if (0 != reply.find("OK\r\n") && 0 != reply.find("HTTP/1.1 200 OK\r\n")) {
+            yAsyncWriteFinish(req, YAPI_IO_ERROR, "http request failed");
+        } else {
+            yAsyncWriteFinish(req, YAPI_SUCCESS, "");
+        }
+    }
+    ySetEvent(&_async_event);
+    yapiSignalEvents();
 }
 
-void        YFunction::_AddToCache(const string& classname, const string& func, YFunction *obj)
+static yAsyncRequestSt *yAsyncRequestNew(void)
 {
-    _cache[classname + "_" + func] = obj;
+    yAsyncRequestSt *r = new yAsyncRequestSt;
+
+    r->refcount = 2;    // one for the token, one for the queue
+    r->done = false;
+    r->res = YAPI_SUCCESS;
+    r->resume = NULL;
+    r->resumeCtx = NULL;
+    r->devdescr = 0;
+    r->tcpchan = 0;
+    r->bodyOnly = false;
+    return r;
 }
 
-void YFunction::_ClearCache()
+// Store the outcome of a request and let the device take the next one. The
+// reference of the queue is released, unless it is handed over to the list
+// of coroutines to resume.
+static void yAsyncRequestComplete(yAsyncRequestSt *r, YRETCODE res, const string& errmsg, const string& content)
 {
-    for (std::map<string, YFunction*>::iterator cache_iterator = _cache.begin();
-             cache_iterator != _cache.end(); ++cache_iterator){
-        delete cache_iterator->second;
+    bool resume;
+
+    // also used for the requests failing before the API is initialized
+    yAsyncEnter();
+    r->res = res;
+    r->errmsg = (YISERR(res) ? errmsg : "");
+    r->content = content;
+    r->done = true;
+    if (r->device != "") {
+        _async_queues[r->device].busy = false;
+    }
+    resume = (r->resume != NULL);
+    if (resume) {
+        _async_ready.push_back(r);
+    }
+    yAsyncLeave();
+    if (!resume) {
+        yAsyncRequestRelease(r);
+    }
+    if (_async_active) {
+        ySetEvent(&_async_event);
+        yapiSignalEvents();
     }
-    _cache.clear();
-    _cache = std::map<string, YFunction*>();
 }
 
+static void yAsyncRequestDone(void *context, const u8 *result, u32 resultlen, int retcode, const char *errmsg)
+{
+    yAsyncRequestSt *r = (yAsyncRequestSt*)context;
+    string          reply;
+    size_t          found;
 
+    if (YISERR(retcode)) {
+        yAsyncRequestComplete(r, (YRETCODE)retcode, (errmsg && *errmsg ? errmsg : "http request failed"), "");
+        return;
+    }
+    if (result != NULL && resultlen > 0) {
+        reply.assign((const char*)result, resultlen);
+    }
+    // same checks as YFunction::_requestEx() and YFunction::_download()
+    if (0 != reply.find("OK\r\n") && 0 != reply.find("HTTP/1.1 200 OK\r\n")) {
+        yAsyncRequestComplete(r, YAPI_IO_ERROR, "http request failed", "");
+        return;
+    }
+    if (r->bodyOnly) {
+        found = reply.find("\r\n\r\n");
+        if (string::npos == found) {
+            yAsyncRequestComplete(r, YAPI_IO_ERROR, "http request failed", "");
+            return;
+        }
+        reply = reply.substr(found + 4);
+    }
+    yAsyncRequestComplete(r, YAPI_SUCCESS, "", reply);
+}
+
+// Send the queued writes and requests that their device can take.
+// Consecutive writes to a function share the same request.
+static void yAsyncFlush(void)
+{
+    std::map<string,yAsyncQueue>::iterator it;
+    yAsyncWriteReq  *req;
+    yAsyncRequestSt *r;
+    yAsyncWriteSt   *w;
+    vector<string>  attrs;
+    string          query, request, errmsg;
+    YRETCODE        res;
+    int             pending;
+
+    yAsyncEnter();
+    pending = _async_pending;
+    yAsyncLeave();
+    while (pending > 0) {
+        req = NULL;
+        r = NULL;
+        yEnterCriticalSection(&_async_cs);
+        for (it = _async_queues.begin(); it != _async_queues.end(); it++) {
+            if (!it->second.busy && !it->second.items.empty()) {
+                break;
+            }
+        }
+        if (it != _async_queues.end()) {
+            if (it->second.items.front().request != NULL) {
+                r = it->second.items.front().request;
+                it->second.items.pop_front();
+                _async_pending--;
+            } else {
+                req = new yAsyncWriteReq;
+                req->device = it->first;
+                query = "";
+                attrs.clear();
+                while (!it->second.items.empty() && it->second.items.front().write != NULL) {
+                    w = it->second.items.front().write;
+                    if (!req->writes.empty() && (w->devdescr != req->writes[0]->devdescr || w->funcid != req->writes[0]->funcid)) {
+                        break;
+                    }
+                    if (!yAppendWriteQuery(query, attrs, w->attrName, w->attrValue)) {
+                        break;
+                    }
+                    req->writes.push_back(w);
+                    it->second.items.pop_front();
+                }
+                _async_pending -= (int)req->writes.size();
+            }
+            it->second.busy = !it->second.pipelined;
+        }
+        pending = _async_pending;
+        yLeaveCriticalSection(&_async_cs);
+        if (r != NULL) {
+            res = YDevice::getDevice(r->devdescr)->HTTPRequestStartOwnConnection(r->tcpchan, r->request, yAsyncRequestDone, r, errmsg);
+            if (YISERR(res)) {
+                // the callback is not called on failure
+                yAsyncRequestComplete(r, res, errmsg, "");
+            }
+        } else if (req != NULL) {
+            request = "GET /api/" + req->writes[0]->funcid + "/" + req->writes[0]->attrName + "?" + query + "&. \r\n\r\n";
+            res = YDevice::getDevice(req->writes[0]->devdescr)->HTTPRequestStartOwnConnection(0, request, yAsyncWriteDone, req, errmsg);
+            if (YISERR(res)) {
+                yAsyncWriteFinish(req, res, errmsg);
+            }
+        } else {
+            // the remaining entries wait for the end of a request
+            break;
+        }
+    }
+}
 
-//--- (generated code: YFunction implementation)
-// static attributes
-const string YFunction::LOGICALNAME_INVALID = YAPI_INVALID_STRING;
-const string YFunction::ADVERTISEDVALUE_INVALID = YAPI_INVALID_STRING;
+// Return a request that has failed before being queued
+static YAsyncRequest yAsyncRequestFailed(YRETCODE res, const string& errmsg)
+{
+    yAsyncRequestSt *r = yAsyncRequestNew();
 
-int YFunction::_parseAttr(YJSONObject* json_val)
+    yAsyncRequestComplete(r, res, errmsg, "");
+    return YAsyncRequest(r);
+}
+
+// Queue a request to a function's device behind the other asynchronous
+// writes and requests to its device, and start sending it if the device
+// is idle
+static YAsyncRequest yAsyncRequestStart(YFUN_DESCR fundesc, int tcpchan, const string& request, bool bodyOnly)
 {
-    if(json_val->has("logicalName")) {
-        _logicalName =  json_val->getString("logicalName");
+    yAsyncRequestSt *r;
+    YDEV_DESCR      devdesc;
+    char            serial[YOCTO_SERIAL_LEN];
+    char            errbuff[YOCTO_ERRMSG_LEN];
+    string          errmsg;
+    bool            pipelined;
+    YRETCODE        res;
+
+    res = (YRETCODE)yapiGetFunctionInfo(fundesc, &devdesc, serial, NULL, NULL, NULL, errbuff);
+    if (YISERR(res)) {
+        return yAsyncRequestFailed(res, errbuff);
     }
-    if(json_val->has("advertisedValue")) {
-        _advertisedValue =  json_val->getString("advertisedValue");
+    res = yAsyncRoute(serial, pipelined, errmsg);
+    if (YISERR(res)) {
+        return yAsyncRequestFailed(res, errmsg);
     }
-    return 0;
+    r = yAsyncRequestNew();
+    r->devdescr = devdesc;
+    r->device = serial;
+    r->tcpchan = tcpchan;
+    r->request = request;
+    r->bodyOnly = bodyOnly;
+    yAsyncPush(serial, pipelined, NULL, r);
+    yAsyncFlush();
+    return YAsyncRequest(r);
 }
 
+// Resume the coroutines awaiting a completed request (from YAPI::HandleEvents)
+static void yAsyncResumeReady(void)
+{
+    yAsyncRequestSt *r;
 
-/**
- * Returns the logical name of the function.
- *
- * @return a string corresponding to the logical name of the function
- *
- * On failure, throws an exception or returns Y_LOGICALNAME_INVALID.
- */
-string YFunction::get_logicalName(void)
+    while (true) {
+        yEnterCriticalSection(&_async_cs);
+        if (_async_ready.empty()) {
+            yLeaveCriticalSection(&_async_cs);
+            break;
+        }
+        r = _async_ready.front();
+        _async_ready.pop_front();
+        yLeaveCriticalSection(&_async_cs);
+        r->resume(r->resumeCtx);
+        yAsyncRequestRelease(r);
+    }
+}
+
+// Fail the writes and requests that have not been sent yet, and drop the
+// coroutines not resumed yet (used only on YAPI::FreeAPI)
+static void yAsyncFree(void)
 {
-    string res;
-    yEnterCriticalSection(&_this_cs);
-    try {
-        if (_cacheExpiration <= YAPI::GetTickCount()) {
-            if (this->_load_unsafe(YAPI::DefaultCacheValidity) != YAPI_SUCCESS) {
-                {
-                    yLeaveCriticalSection(&_this_cs);
-                    return YFunction::LOGICALNAME_INVALID;
-                }
+    std::map<string,yAsyncQueue>::iterator it;
+    yAsyncWriteSt   *w;
+    yAsyncRequestSt *r;
+
+    for (it = _async_queues.begin(); it != _async_queues.end(); it++) {
+        while (!it->second.items.empty()) {
+            w = it->second.items.front().write;
+            r = it->second.items.front().request;
+            it->second.items.pop_front();
+            if (w != NULL) {
+                w->res = YAPI_NOT_INITIALIZED;
+                w->errmsg = "API has been freed";
+                w->done = true;
+                yAsyncWriteRelease(w);
+            } else {
+                r->res = YAPI_NOT_INITIALIZED;
+                r->errmsg = "API has been freed";
+                r->done = true;
+                yAsyncRequestRelease(r);
             }
         }
-        res = _logicalName;
-    } catch (std::exception) {
-        yLeaveCriticalSection(&_this_cs);
-        throw;
     }
-    yLeaveCriticalSection(&_this_cs);
-    return res;
+    _async_queues.clear();
+    _async_pending = 0;
+    while (!_async_ready.empty()) {
+        yAsyncRequestRelease(_async_ready.front());
+        _async_ready.pop_front();
+    }
 }
 
-/**
- * Changes the logical name of the function. You can use yCheckLogicalName()
- * prior to this call to make sure that your parameter is valid.
- * Remember to call the saveToFlash() method of the module if the
- * modification must be kept.
- *
- * @param newval : a string corresponding to the logical name of the function
- *
- * @return YAPI_SUCCESS if the call succeeds.
- *
- * On failure, throws an exception or returns a negative error code.
- */
-int YFunction::set_logicalName(const string& newval)
+YAsyncWrite::YAsyncWrite() : _write(NULL)
 {
-    string rest_val;
-    int res;
-    if (!YAPI::CheckLogicalName(newval)) {
-        _throw(YAPI_INVALID_ARGUMENT, "Invalid name :" + newval);
-        return YAPI_INVALID_ARGUMENT;
+}
+
+YAsyncWrite::YAsyncWrite(yAsyncWriteSt *write) : _write(write)
+{
+}
+
+YAsyncWrite::YAsyncWrite(const YAsyncWrite& other) : _write(NULL)
+{
+    *this = other;
+}
+
+YAsyncWrite& YAsyncWrite::operator=(const YAsyncWrite& other)
+{
+    if (other._write != NULL) {
+        yAsyncEnter();
+        other._write->refcount++;
+        yAsyncLeave();
     }
-    yEnterCriticalSection(&_this_cs);
-    try {
-        rest_val = newval;
-        res = _setAttr("logicalName", rest_val);
-    } catch (std::exception) {
-         yLeaveCriticalSection(&_this_cs);
-         throw;
+    if (_write != NULL) {
+        yAsyncWriteRelease(_write);
     }
-    yLeaveCriticalSection(&_this_cs);
-    return res;
+    _write = other._write;
+    return *this;
 }
 
-/**
- * Returns a short string representing the current state of the function.
- *
- * @return a string corresponding to a short string representing the current state of the function
- *
- * On failure, throws an exception or returns Y_ADVERTISEDVALUE_INVALID.
- */
-string YFunction::get_advertisedValue(void)
+YAsyncWrite::~YAsyncWrite()
 {
-    string res;
-    yEnterCriticalSection(&_this_cs);
-    try {
-        if (_cacheExpiration <= YAPI::GetTickCount()) {
-            if (this->_load_unsafe(YAPI::DefaultCacheValidity) != YAPI_SUCCESS) {
-                {
-                    yLeaveCriticalSection(&_this_cs);
-                    return YFunction::ADVERTISEDVALUE_INVALID;
-                }
-            }
-        }
-        res = _advertisedValue;
-    } catch (std::exception) {
-        yLeaveCriticalSection(&_this_cs);
-        throw;
+    if (_write != NULL) {
+        yAsyncWriteRelease(_write);
     }
-    yLeaveCriticalSection(&_this_cs);
-    return res;
 }
 
-int YFunction::set_advertisedValue(const string& newval)
+bool YAsyncWrite::isDone(void)
 {
-    string rest_val;
-    int res;
-    yEnterCriticalSection(&_this_cs);
-    try {
-        rest_val = newval;
-        res = _setAttr("advertisedValue", rest_val);
-    } catch (std::exception) {
-         yLeaveCriticalSection(&_this_cs);
-         throw;
+    bool done;
+
+    if (_write == NULL) {
+        return true;
     }
-    yLeaveCriticalSection(&_this_cs);
-    return res;
+    yAsyncEnter();
+    done = _write->done;
+    yAsyncLeave();
+    return done;
 }
 
-/**
- * Retrieves a function for a given identifier.
- * The identifier can be specified using several formats:
- * <ul>
- * <li>FunctionLogicalName</li>
- * <li>ModuleSerialNumber.FunctionIdentifier</li>
- * <li>ModuleSerialNumber.FunctionLogicalName</li>
- * <li>ModuleLogicalName.FunctionIdentifier</li>
- * <li>ModuleLogicalName.FunctionLogicalName</li>
- * </ul>
- *
- * This function does not require that the function is online at the time
- * it is invoked. The returned object is nevertheless valid.
- * Use the method YFunction.isOnline() to test if the function is
- * indeed online at a given time. In case of ambiguity when looking for
- * a function by logical name, no error is notified: the first instance
- * found is returned. The search is performed first by hardware name,
- * then by logical name.
- *
- * If a call to this object's is_online() method returns FALSE although
- * you are certain that the matching device is plugged, make sure that you did
- * call registerHub() at application initialization time.
- *
- * @param func : a string that uniquely characterizes the function
- *
- * @return a YFunction object allowing you to drive the function.
- */
-YFunction* YFunction::FindFunction(string func)
+YRETCODE YAsyncWrite::wait(int msTimeout)
 {
-    YFunction* obj = NULL;
-    int taken = 0;
-    if (YAPI::_apiInitialized) {
-        yEnterCriticalSection(&YAPI::_global_cs);
-        taken = 1;
-    }try {
-        obj = (YFunction*) YFunction::_FindFromCache("Function", func);
-        if (obj == NULL) {
-            obj = new YFunction(func);
-            YFunction::_AddToCache("Function", func, obj);
+    u64     timeout = yapiGetTickCount() + msTimeout;
+    string  errmsg;
+
+    while (!this->isDone()) {
+        if (yapiGetTickCount() >= timeout) {
+            return YAPI_TIMEOUT;
         }
-    } catch (std::exception) {
-        if (taken) yLeaveCriticalSection(&YAPI::_global_cs);
-        throw;
+        // the queued writes are sent, and the requests to USB devices
+        // progress, only when events are handled
+        YapiWrapper::handleEvents(errmsg);
+        if (this->isDone()) {
+            break;
+        }
+        yWaitForEvent(&_async_event, 5);
     }
-    if (taken) yLeaveCriticalSection(&YAPI::_global_cs);
-    return obj;
+    return this->get_errorType();
 }
 
-/**
- * Registers the callback function that is invoked on every change of advertised value.
- * The callback is invoked only during the execution of ySleep or yHandleEvents.
- * This provides control over the time when the callback is triggered. For good responsiveness, remember to call
- * one of these two functions periodically. To unregister a callback, pass a NULL pointer as argument.
- *
- * @param callback : the callback function to call, or a NULL pointer. The callback function should take two
- *         arguments: the function object of which the value has changed, and the character string describing
- *         the new advertised value.
- * @noreturn
- */
-int YFunction::registerValueCallback(YFunctionValueCallback callback)
+YRETCODE YAsyncWrite::get_errorType(void)
 {
-    string val;
-    if (callback != NULL) {
-        YFunction::_UpdateValueCallbackList(this, true);
-    } else {
-        YFunction::_UpdateValueCallbackList(this, false);
-    }
-    _valueCallbackFunction = callback;
-    // Immediately invoke value callback with current value
-    if (callback != NULL && this->isOnline()) {
-        val = _advertisedValue;
-        if (!(val == "")) {
-            this->_invokeValueCallback(val);
-        }
+    YRETCODE res;
+
+    if (_write == NULL) {
+        return YAPI_SUCCESS;
     }
-    return 0;
+    yAsyncEnter();
+    res = (_write->done ? _write->res : YAPI_SUCCESS);
+    yAsyncLeave();
+    return res;
 }
 
-int YFunction::_invokeValueCallback(string value)
+string YAsyncWrite::get_errorMessage(void)
 {
-    if (_valueCallbackFunction != NULL) {
-        _valueCallbackFunction(this, value);
-    } else {
+    string res;
+
+    if (_write == NULL) {
+        return "";
     }
-    return 0;
+    yAsyncEnter();
+    res = (_write->done ? _write->errmsg : "");
+    yAsyncLeave();
+    return res;
 }
 
-/**
- * Disables the propagation of every new advertised value to the parent hub.
- * You can use this function to save bandwidth and CPU on computers with limited
- * resources, or to prevent unwanted invocations of the HTTP callback.
- * Remember to call the saveToFlash() method of the module if the
- * modification must be kept.
- *
- * @return YAPI_SUCCESS when the call succeeds.
- *
- * On failure, throws an exception or returns a negative error code.
- */
-int YFunction::muteValueCallbacks(void)
+// Queue an attribute change behind the other asynchronous writes and
+// requests to the device, and start sending it if possible
+YRETCODE YFunction::_setAttrAsync(const string& attrname, const string& newvalue, YAsyncWrite& write, string& errmsg)
 {
-    return this->set_advertisedValue("SILENT");
+    YFUN_DESCR      fundesc;
+    YDEV_DESCR      devdesc;
+    YDevice         *dev;
+    char            serial[YOCTO_SERIAL_LEN];
+    char            funcid[YOCTO_FUNCTION_LEN];
+    char            errbuff[YOCTO_ERRMSG_LEN];
+    bool            pipelined;
+    yAsyncWriteSt   *w;
+    YRETCODE        res;
+
+    res = _getDescriptor(fundesc, errmsg);
+    if (YISERR(res)) {
+        return res;
+    }
+    res = (YRETCODE)yapiGetFunctionInfo(fundesc, &devdesc, serial, funcid, NULL, NULL, errbuff);
+    if (YISERR(res)) {
+        errmsg = errbuff;
+        return res;
+    }
+    res = _getDevice(dev, errmsg);
+    if (YISERR(res)) {
+        return res;
+    }
+    res = yAsyncRoute(serial, pipelined, errmsg);
+    if (YISERR(res)) {
+        return res;
+    }
+    w = new yAsyncWriteSt;
+    w->refcount = 2;    // one for the token, one for the queue
+    w->done = false;
+    w->res = YAPI_SUCCESS;
+    w->devdescr = devdesc;
+    w->funcid = funcid;
+    w->attrName = attrname;
+    w->attrValue = _escapeAttr(newvalue);
+    yAsyncPush(serial, pipelined, w, NULL);
+    write = YAsyncWrite(w);
+    // same cache invalidation as _setAttr
+    dev->invalidateCache();
+    if (_cacheExpiration != 0) {
+        _cacheExpiration = 0;
+    }
+    yForgetPushedValue(_fundescr);
+    yAsyncFlush();
+    return YAPI_SUCCESS;
 }
 
-/**
- * Re-enables the propagation of every new advertised value to the parent hub.
- * This function reverts the effect of a previous call to muteValueCallbacks().
- * Remember to call the saveToFlash() method of the module if the
- * modification must be kept.
- *
- * @return YAPI_SUCCESS when the call succeeds.
- *
- * On failure, throws an exception or returns a negative error code.
- */
-int YFunction::unmuteValueCallbacks(void)
+
+YAsyncRequest::YAsyncRequest() : _req(NULL)
 {
-    return this->set_advertisedValue("");
 }
 
-/**
- * Returns the current value of a single function attribute, as a text string, as quickly as
- * possible but without using the cached value.
- *
- * @param attrName : the name of the requested attribute
- *
- * @return a string with the value of the the attribute
- *
- * On failure, throws an exception or returns an empty string.
- */
-string YFunction::loadAttribute(string attrName)
+YAsyncRequest::YAsyncRequest(yAsyncRequestSt *req) : _req(req)
 {
-    string url;
-    string attrVal;
-    url = YapiWrapper::ysprintf("api/%s/%s", this->get_functionId().c_str(),attrName.c_str());
-    attrVal = this->_download(url);
-    return attrVal;
 }
 
-int YFunction::_parserHelper(void)
+YAsyncRequest::YAsyncRequest(const YAsyncRequest& other) : _req(NULL)
 {
-    return 0;
+    *this = other;
 }
 
-YFunction *YFunction::nextFunction(void)
+YAsyncRequest& YAsyncRequest::operator=(const YAsyncRequest& other)
 {
-    string  hwid;
+    if (other._req != NULL) {
+        yAsyncEnter();
+        other._req->refcount++;
+        yAsyncLeave();
+    }
+    if (_req != NULL) {
+        yAsyncRequestRelease(_req);
+    }
+    _req = other._req;
+    return *this;
+}
 
-    if(YISERR(_nextFunction(hwid)) || hwid=="") {
-        return NULL;
+YAsyncRequest::~YAsyncRequest()
+{
+    if (_req != NULL) {
+        yAsyncRequestRelease(_req);
     }
-    return YFunction::FindFunction(hwid);
 }
 
-YFunction* YFunction::FirstFunction(void)
+bool YAsyncRequest::isDone(void)
 {
-    vector<YFUN_DESCR>   v_fundescr;
-    YDEV_DESCR             ydevice;
-    string              serial, funcId, funcName, funcVal, errmsg;
+    bool done;
 
-    if(YISERR(YapiWrapper::getFunctionsByClass("Function", 0, v_fundescr, sizeof(YFUN_DESCR), errmsg)) ||
-       v_fundescr.size() == 0 ||
-       YISERR(YapiWrapper::getFunctionInfo(v_fundescr[0], ydevice, serial, funcId, funcName, funcVal, errmsg))) {
-        return NULL;
+    if (_req == NULL) {
+        return true;
     }
-    return YFunction::FindFunction(serial+"."+funcId);
+    yAsyncEnter();
+    done = _req->done;
+    yAsyncLeave();
+    return done;
 }
 
-//--- (end of generated code: YFunction implementation)
+YRETCODE YAsyncRequest::wait(int msTimeout)
+{
+    u64     timeout = yapiGetTickCount() + msTimeout;
+    string  errmsg;
 
-//--- (generated code: Function functions)
-//--- (end of generated code: Function functions)
+    while (!this->isDone()) {
+        if (yapiGetTickCount() >= timeout) {
+            return YAPI_TIMEOUT;
+        }
+        YapiWrapper::handleEvents(errmsg);
+        if (this->isDone()) {
+            break;
+        }
+        yWaitForEvent(&_async_event, 5);
+    }
+    return this->get_errorType();
+}
 
-void YFunction::_throw(YRETCODE errType, string errMsg)
+YRETCODE YAsyncRequest::get_errorType(void)
 {
-    _lastErrorType = errType;
-    _lastErrorMsg = errMsg;
-    // Method used to throw exceptions or save error type/message
-    if(!YAPI::ExceptionsDisabled) {
-        throw YAPI_Exception(errType, errMsg);
+    YRETCODE res;
+
+    if (_req == NULL) {
+        return YAPI_SUCCESS;
     }
+    yAsyncEnter();
+    res = (_req->done ? _req->res : YAPI_SUCCESS);
+    yAsyncLeave();
+    return res;
 }
 
-// Method used to resolve our name to our unique function descriptor (may trigger a hub scan)
-YRETCODE YFunction::_getDescriptor(YFUN_DESCR& fundescr, string& errmsg)
+string YAsyncRequest::get_errorMessage(void)
 {
-    int res;
-    YFUN_DESCR tmp_fundescr;
+    string res;
 
-    tmp_fundescr = YapiWrapper::getFunction(_className, _func, errmsg);
-    if(YISERR(tmp_fundescr)) {
-        res = YapiWrapper::updateDeviceList(true,errmsg);
-        if(YISERR(res)) {
-            return (YRETCODE)res;
-        }
-        tmp_fundescr = YapiWrapper::getFunction(_className, _func, errmsg);
-        if(YISERR(tmp_fundescr)) {
-            return (YRETCODE)tmp_fundescr;
-        }
+    if (_req == NULL) {
+        return "";
     }
-    _fundescr =  fundescr = tmp_fundescr;
-    return YAPI_SUCCESS;
+    yAsyncEnter();
+    res = (_req->done ? _req->errmsg : "");
+    yAsyncLeave();
+    return res;
 }
 
-// Return a pointer to our device caching object (may trigger a hub scan)
-YRETCODE YFunction::_getDevice(YDevice*& dev, string& errmsg)
+string YAsyncRequest::get_content(void)
 {
-    YFUN_DESCR   fundescr;
-    YDEV_DESCR     devdescr;
-    YRETCODE    res;
-
-    // Resolve function name
-    res = _getDescriptor(fundescr, errmsg);
-    if(YISERR(res)) return res;
+    string res;
 
-    // Get device descriptor
-    devdescr = YapiWrapper::getDeviceByFunction(fundescr, errmsg);
-    if(YISERR(devdescr)) return (YRETCODE)devdescr;
+    if (_req == NULL) {
+        return "";
+    }
+    yAsyncEnter();
+    res = (_req->done ? _req->content : "");
+    yAsyncLeave();
+    return res;
+}
 
-    // Get device object
-    dev = YDevice::getDevice(devdescr);
+bool YAsyncRequest::_resumeOnEvents(void (*resume)(void*), void *context)
+{
+    bool pending;
 
-    return YAPI_SUCCESS;
+    if (_req == NULL) {
+        return false;
+    }
+    yAsyncEnter();
+    pending = !_req->done;
+    if (pending) {
+        _req->resume = resume;
+        _req->resumeCtx = context;
+    }
+    yAsyncLeave();
+    return pending;
 }
 
-// Return the next known function of current class listed in the yellow pages
-YRETCODE YFunction::_nextFunction(string& hwid)
+
+// Method used to send http request to the device (not the function)
+string      YFunction::_requestEx(int channel, const string& request, yapiRequestProgressCallback callback, void *context)
 {
-    vector<YFUN_DESCR>   v_fundescr;
-    YFUN_DESCR           fundescr;
-    YDEV_DESCR           devdescr;
-    string               serial, funcId, funcName, funcVal, errmsg;
-    int                  res;
+    YDevice     *dev;
+    string      errmsg, buffer;
+    int         res;
 
-    res = _getDescriptor(fundescr, errmsg);
-    if(YISERR(res)) {
+
+    // Resolve our reference to our device, load REST API
+    res = _getDevice(dev, errmsg);
+    if (YISERR(res)) {
         _throw((YRETCODE)res, errmsg);
-        return (YRETCODE)res;
+        return YAPI_INVALID_STRING;
     }
-    res = YapiWrapper::getFunctionsByClass(_className, fundescr, v_fundescr, sizeof(YFUN_DESCR), errmsg);
-    if(YISERR((YRETCODE)res)) {
-        _throw((YRETCODE)res, errmsg);
-        return (YRETCODE)res;
+    res = dev->HTTPRequest(channel, request, buffer, callback, context, errmsg);
+    if (YISERR(res)) {
+        // Check if an update of the device list does notb solve the issue
+        res = YapiWrapper::updateDeviceList(true, errmsg);
+        if (YISERR(res)) {
+            this->_throw((YRETCODE)res, errmsg);
+            return YAPI_INVALID_STRING;
+        }
+        res = dev->HTTPRequest(channel, request, buffer, callback, context, errmsg);
+        if (YISERR(res)) {
+            this->_throw((YRETCODE)res, errmsg);
+            return YAPI_INVALID_STRING;
+        }
     }
-    if(v_fundescr.size() == 0) {
-        hwid = "";
-        return YAPI_SUCCESS;
+    if (0 != buffer.find("OK\r\n")) {
+        if (0 != buffer.find("HTTP/1.1 200 OK\r\n")) {
+            this->_throw(YAPI_IO_ERROR, "http request failed");
+            return YAPI_INVALID_STRING;
+        }
     }
-    res = YapiWrapper::getFunctionInfo(v_fundescr[0], devdescr, serial, funcId, funcName, funcVal, errmsg);
-    if(YISERR(res)) {
-        _throw((YRETCODE)res, errmsg);
-        return (YRETCODE)res;
+    return buffer;
+}
+
+string      YFunction::_request(const string& request)
+{
+    return _requestEx(0, request, NULL, NULL);
+}
+
+
+// Method used to send http request to the device (not the function)
+string      YFunction::_download(const string& url)
+{
+    string      request,buffer;
+	size_t      found;
+
+    request = "GET /"+url+" HTTP/1.1\r\n\r\n";
+    buffer = this->_request(request);
+    found = buffer.find("\r\n\r\n");
+    if(string::npos == found){
+        this->_throw(YAPI_IO_ERROR,"http request failed");
+        return YAPI_INVALID_STRING;
     }
-    hwid = serial+"."+funcId;
 
-    return YAPI_SUCCESS;
+    return buffer.substr(found+4);
 }
 
-// Parse a long JSON string
-string  YFunction::_parseString(yJsonStateMachine& j)
+// Method used to start a download from the device (not the function) without
+// waiting for the reply, which is passed to the callback with its HTTP header
+YRETCODE    YFunction::_downloadStart(int tcpchan, const string& url, yapiRequestAsyncCallback callback, void *context, string& errmsg)
 {
-    string  res;
-
-    do {
-#ifdef WINDOWS_API
-        res += j.token;
-#else
-        char buffer[128];
-        char *pt, *s;
-        s = j.token;
-        pt = buffer;
-        while (*s) {
-            unsigned char c = *s++;
-            if (c < 128) {
-                *pt++ = c;
-            } else {
-                // UTF8-encode character
-                *pt++ = 0xc2 + (c>0xbf ? 1 : 0);
-                *pt++ = (c & 0x3f) + 0x80;
-            }
-        }
-        *pt = 0;
-        res += buffer;
-#endif
-    } while (j.next == YJSON_PARSE_STRINGCONT && yJsonParse(&j) == YJSON_PARSE_AVAIL);
+    YDevice     *dev;
+    string      request;
+    YRETCODE    res;
 
-    return res;
+    res = _getDevice(dev, errmsg);
+    if (YISERR(res)) {
+        return res;
+    }
+    request = "GET /"+url+" HTTP/1.1\r\n\r\n";
+    return dev->HTTPRequestStart(tcpchan, request, callback, context, errmsg);
 }
 
-string      YFunction::_json_get_key(const string& json, const string& key)
+// Method used to send http request to the device (not the function) without
+// waiting for the reply
+YAsyncRequest YFunction::_requestAsync(int tcpchan, const string& request)
 {
-    yJsonStateMachine j;
+    YFUN_DESCR  fundescr;
+    string      errmsg;
+    YRETCODE    res;
 
-    // Parse JSON data for the device and locate our function in it
-    j.src = json.c_str();
-    j.end = j.src + strlen(j.src);
-    j.st = YJSON_START;
-    if(yJsonParse(&j) != YJSON_PARSE_AVAIL || j.st != YJSON_PARSE_STRUCT) {
-        this->_throw(YAPI_IO_ERROR,"JSON structure expected");
-        return YAPI_INVALID_STRING;
-    }
-    while(yJsonParse(&j) == YJSON_PARSE_AVAIL && j.st == YJSON_PARSE_MEMBNAME) {
-        if (!strcmp(j.token, key.c_str())) {
-            if (yJsonParse(&j) != YJSON_PARSE_AVAIL) {
-                this->_throw(YAPI_IO_ERROR,"JSON structure expected");
-                return YAPI_INVALID_STRING;
-            }
-            return  _parseString(j);
-        }
-        yJsonSkip(&j, 1);
+    res = _getDescriptor(fundescr, errmsg);
+    if (YISERR(res)) {
+        return yAsyncRequestFailed(res, errmsg);
     }
-    this->_throw(YAPI_IO_ERROR,"invalid JSON structure");
-    return YAPI_INVALID_STRING;
+    return yAsyncRequestStart(fundescr, tcpchan, request, false);
 }
 
-string YFunction::_json_get_string(const string& json)
+// Method used to download a file from the device without waiting for the
+// reply, which is stripped from its HTTP header
+YAsyncRequest YFunction::_downloadAsync(const string& url)
 {
-    yJsonStateMachine j;
-    j.src = json.c_str();
-    j.end = j.src + strlen(j.src);
-    j.st = YJSON_START;
-    if(yJsonParse(&j) != YJSON_PARSE_AVAIL || j.st != YJSON_PARSE_STRING) {
-        this->_throw(YAPI_IO_ERROR,"JSON string expected");
-        return "";
+    YFUN_DESCR  fundescr;
+    string      errmsg;
+    YRETCODE    res;
+
+    res = _getDescriptor(fundescr, errmsg);
+    if (YISERR(res)) {
+        return yAsyncRequestFailed(res, errmsg);
     }
-    return _parseString(j);
+    return yAsyncRequestStart(fundescr, 0, "GET /"+url+" HTTP/1.1\r\n\r\n", true);
 }
 
-vector<string> YFunction::_json_get_array(const string& json)
+
+// Build the multipart request uploading a file to the device
+static string yUploadRequest(const string& path, const string& content)
 {
-    vector<string> res;
-    yJsonStateMachine j;
-    const char *json_cstr,*last;
-    string backup = json;
-    j.src = json_cstr = json.c_str();
-    j.end = j.src + strlen(j.src);
-    j.st = YJSON_START;
-    if(yJsonParse(&j) != YJSON_PARSE_AVAIL || j.st != YJSON_PARSE_ARRAY) {
-        this->_throw(YAPI_IO_ERROR,"JSON structure expected");
-        return res;
-    }
-    int depth = j.depth;
-    do {
-        last = j.src;
-        while (yJsonParse(&j) == YJSON_PARSE_AVAIL) {
-            if (j.next == YJSON_PARSE_STRINGCONT || j.depth > depth){
-                continue;
-            }
-            break;
-        }
-        if (j.st == YJSON_PARSE_ERROR) {
-            this->_throw(YAPI_IO_ERROR, "invalid JSON structure");
-            return res;
-        }
+    string      request;
+    string      boundary;
 
-        if (j.depth == depth) {
-            long location, length;
-            while (*last == ',' || *last == '\n'){
-                last++;
-            }
-            location = (long)(last - json_cstr);
-            length = (long)(j.src - last);
-            string item = json.substr(location, length);
-            res.push_back(item);
-        }
-    } while (j.st != YJSON_PARSE_ARRAY );
-    return res;
+    request = "POST /upload.html HTTP/1.1\r\n";
+    string body = "Content-Disposition: form-data; name=\"" + path + "\"; filename=\"api\"\r\n" +
+        "Content-Type: application/octet-stream\r\n" +
+        "Content-Transfer-Encoding: binary\r\n\r\n" + content;
+    do {
+        boundary = YapiWrapper::ysprintf("Zz%06xzZ", rand() & 0xffffff);
+    } while (body.find(boundary) != string::npos);
+    request += "Content-Type: multipart/form-data; boundary=" + boundary + "\r\n";
+    request += "\r\n--" + boundary + "\r\n" + body + "\r\n--" + boundary + "--\r\n";
+    return request;
 }
 
-string YFunction::_get_json_path(const string& json, const string& path)
+
+// Method used to upload a file to the device
+YRETCODE    YFunction::_uploadWithProgress(const string& path, const string& content, yapiRequestProgressCallback callback, void *context)
 {
-    const char *json_data = json.c_str();
-    int len = (int)(json.length() & 0x0fffffff);
-    const char *p;
-    char        errbuff[YOCTO_ERRMSG_LEN];
-    int res;
 
-    res = yapiJsonGetPath(path.c_str(), json_data, len, &p, errbuff);
-    if (res >= 0) {
-        string result = string(p, res);
-        if (res > 0) {
-            yapiFreeMem((void*)p);
-        }
-        return result;
+    string      request, buffer;
+    size_t      found;
+
+    request = yUploadRequest(path, content);
+    buffer = this->_requestEx(0, request, callback, context);
+    found = buffer.find("\r\n\r\n");
+    if (string::npos == found) {
+        this->_throw(YAPI_IO_ERROR, "http request failed");
+        return YAPI_IO_ERROR;
     }
-    return "";
+    return YAPI_SUCCESS;
 }
 
-string YFunction::_decode_json_string(const string& json)
+
+// Method used to upload a file to the device
+YRETCODE    YFunction::_upload(const string& path, const string& content)
 {
-    int len = (int)(json.length() & 0x0fffffff);
-    char buffer[128];
-    char *p = buffer;
-    int decoded_len;
+    return this->_uploadWithProgress(path, content, NULL, NULL);
+}
 
-    if (len >= 127){
-        p = (char*) malloc(len + 1);
 
+// Method used to upload a file to the device without waiting for the reply
+YAsyncRequest YFunction::_uploadAsync(const string& path, const string& content)
+{
+    YFUN_DESCR  fundescr;
+    string      errmsg;
+    YRETCODE    res;
+
+    res = _getDescriptor(fundescr, errmsg);
+    if (YISERR(res)) {
+        return yAsyncRequestFailed(res, errmsg);
     }
-    decoded_len = yapiJsonDecodeString(json.c_str(), p);
-    string result = string(p, decoded_len);
-    if (len >= 127){
-        free(p);
+    return yAsyncRequestStart(fundescr, 0, yUploadRequest(path, content), true);
+}
+
+
+// Method used to cache DataStream objects (new DataLogger)
+YDataStream *YFunction::_findDataStream(YDataSet& dataset, const string& def)
+{
+    string key = dataset.get_functionId()+":"+def;
+    if(_dataStreams.find(key) != _dataStreams.end())
+        return _dataStreams[key];
+
+    YDataStream *newDataStream = new YDataStream(this, dataset, YAPI::_decodeWords(def));
+    _dataStreams[key] = newDataStream;
+    return newDataStream;
+}
+
+// Method used to clear cache of DataStream object (undocumented)
+void YFunction::_clearDataStreamCache()
+{
+    std::map<string, YDataStream*>::iterator it;
+    for (it = _dataStreams.begin(); it != _dataStreams.end(); ++it) {
+        YDataStream *ds = it->second;
+
+        delete(ds);
     }
-    return result;
+    _dataStreams.clear();
 }
 
 
-string  YFunction::_escapeAttr(const string& changeval)
+
+// Return a string that describes the function (class and logical name or hardware id)
+string YFunction::describe(void)
 {
-    const char *p;
-    unsigned char c;
-    unsigned char esc[3];
-    string escaped = "";
-    esc[0] = '%';
-    for (p = changeval.c_str(); (c = *p) != 0; p++) {
-        if (c <= ' ' || (c > 'z' && c != '~') || c == '"' || c == '%' || c == '&' ||
-            c == '+' || c == '<' || c == '=' || c == '>' || c == '\\' || c == '^' || c == '`') {
-            if ((c==0xc2 || c==0xc3) && (p[1] & 0xc0)==0x80) {
-                // UTF8-encoded ISO-8859-1 character: translate to plain ISO-8859-1
-                c = (c & 1) * 0x40;
-                p++;
-                c += *p;
+    YFUN_DESCR  fundescr;
+    YDEV_DESCR  devdescr;
+    string      errmsg, serial, funcId, funcName, funcValue;
+    string      descr =  _func;
+    string res;
+
+    yEnterCriticalSection(&_this_cs);
+    fundescr = YapiWrapper::getFunction(_className, _func, errmsg);
+    if(!YISERR(fundescr) && !YISERR(YapiWrapper::getFunctionInfo(fundescr, devdescr, serial, funcId, funcName, funcValue, errmsg))) {
+        res = _className + "(" + _func + ")=" + serial + "." + funcId;
+    } else {
+        res = _className + "(" + _func + ")=unresolved";
+    }
+    yLeaveCriticalSection(&_this_cs);
+    return res;
+}
+
+// Return a string that describes the function (class and logical name or hardware id)
+string YFunction::get_friendlyName(void)
+{
+    YFUN_DESCR   fundescr,moddescr;
+    YDEV_DESCR   devdescr;
+    YRETCODE     retcode;
+    string       errmsg, serial, funcId, funcName, funcValue;
+    string       mod_serial, mod_funcId,mod_funcname;
+
+    yEnterCriticalSection(&_this_cs);
+    // Resolve the function name
+    retcode = _getDescriptor(fundescr, errmsg);
+    if(!YISERR(retcode) && !YISERR(YapiWrapper::getFunctionInfo(fundescr, devdescr, serial, funcId, funcName, funcValue, errmsg))) {
+        if(funcName!="") {
+            funcId = funcName;
+        }
+
+        moddescr = YapiWrapper::getFunction("Module", serial, errmsg);
+        if(!YISERR(moddescr) && !YISERR(YapiWrapper::getFunctionInfo(moddescr, devdescr, mod_serial, mod_funcId, mod_funcname, funcValue, errmsg))) {
+            if(mod_funcname!="") {
+                yLeaveCriticalSection(&_this_cs);
+                return mod_funcname+"."+funcId;
             }
-            esc[1] = (c >= 0xa0 ? (c >> 4) - 10 + 'A' : (c >> 4) + '0');
-            c &= 0xf;
-            esc[2] = (c >= 0xa ? c - 10 + 'A' : c + '0');
-            escaped.append((char*)esc, 3);
-        } else {
-            escaped.append((char*)&c, 1);
         }
+        yLeaveCriticalSection(&_this_cs);
+        return serial+"."+funcId;
     }
-    return escaped;
+    yLeaveCriticalSection(&_this_cs);
+    _throw((YRETCODE)YAPI::DEVICE_NOT_FOUND, errmsg);
+    return Y_FRIENDLYNAME_INVALID;
 }
 
 
-YRETCODE  YFunction::_buildSetRequest( const string& changeattr, const string  *changeval, string& request, string& errmsg)
+
+
+/**
+ * Returns the unique hardware identifier of the function in the form SERIAL.FUNCTIONID.
+ * The unique hardware identifier is composed of the device serial
+ * number and of the hardware identifier of the function (for example RELAYLO1-123456.relay1).
+ *
+ * @return a string that uniquely identifies the function (ex: RELAYLO1-123456.relay1)
+ *
+ * On failure, throws an exception or returns  Y_HARDWAREID_INVALID.
+ */
+string YFunction::get_hardwareId(void)
 {
-    int res;
-    YFUN_DESCR fundesc;
+    YRETCODE    retcode;
+    YFUN_DESCR  fundesc;
+    string      errmsg;
+    char        snum[YOCTO_SERIAL_LEN];
     char        funcid[YOCTO_FUNCTION_LEN];
     char        errbuff[YOCTO_ERRMSG_LEN];
 
-
+    yEnterCriticalSection(&_this_cs);
     // Resolve the function name
-    res = _getDescriptor(fundesc, errmsg);
-    if(YISERR(res)) {
-        return (YRETCODE)res;
+    retcode = _getDescriptor(fundesc, errmsg);
+    if(YISERR(retcode)) {
+        yLeaveCriticalSection(&_this_cs);
+        _throw(retcode, errmsg);
+        return HARDWAREID_INVALID;
     }
-
-    if(YISERR(res=yapiGetFunctionInfo(fundesc, NULL, NULL, funcid, NULL, NULL,errbuff))){
+    if(YISERR(retcode=yapiGetFunctionInfo(fundesc, NULL, snum, funcid, NULL, NULL,errbuff))){
         errmsg = errbuff;
-        _throw((YRETCODE)res, errmsg);
-        return (YRETCODE)res;
+        yLeaveCriticalSection(&_this_cs);
+        _throw(retcode, errmsg);
+        return HARDWAREID_INVALID;
     }
-    request = "GET /api/";
-    request.append(funcid);
-    request.append("/");
-    //request.append(".json/");
+    yLeaveCriticalSection(&_this_cs);
+    return string(snum)+string(".")+string(funcid);
+}
 
-    if(changeattr!="") {
-        request.append(changeattr);
-        if(changeval) {
-            request.append("?");
-            request.append(changeattr);
-            request.append("=");
-            request.append(_escapeAttr(*changeval));
-        }
+/**
+ * Returns the hardware identifier of the function, without reference to the module. For example
+ * relay1
+ *
+ * @return a string that identifies the function (ex: relay1)
+ *
+ * On failure, throws an exception or returns  Y_FUNCTIONID_INVALID.
+ */
+string YFunction::get_functionId(void)
+{
+    YRETCODE    retcode;
+    YFUN_DESCR  fundesc;
+    string      errmsg;
+    char        funcid[YOCTO_FUNCTION_LEN];
+    char        errbuff[YOCTO_ERRMSG_LEN];
+
+    yEnterCriticalSection(&_this_cs);
+    // Resolve the function name
+    retcode = _getDescriptor(fundesc, errmsg);
+    if(YISERR(retcode)) {
+        yLeaveCriticalSection(&_this_cs);
+        _throw(retcode, errmsg);
+        return HARDWAREID_INVALID;
     }
-    // don't append HTTP/1.1 so that we get light headers from hub
-    // but append &. suffix to enable connection keepalive on newer hubs
-    request.append("&. \r\n\r\n");
-    return YAPI_SUCCESS;
+    if(YISERR(retcode=yapiGetFunctionInfo(fundesc, NULL, NULL, funcid, NULL, NULL,errbuff))){
+        errmsg = errbuff;
+        yLeaveCriticalSection(&_this_cs);
+        _throw(retcode, errmsg);
+        return HARDWAREID_INVALID;
+    }
+    yLeaveCriticalSection(&_this_cs);
+    return string(funcid);
 }
 
 
+/**
+ * Returns the numerical error code of the latest error with the function.
+ * This method is mostly useful when using the Yoctopuce library with
+ * exceptions disabled.
+ *
+ * @return a number corresponding to the code of the latest error that occurred while
+ *         using the function object
+ */
+YRETCODE YFunction::get_errorType(void)
+{
+    return _lastErrorType;
+}
 
-int YFunction::_parse(YJSONObject *j)
+/**
+ * Returns the error message of the latest error with the function.
+ * This method is mostly useful when using the Yoctopuce library with
+ * exceptions disabled.
+ *
+ * @return a string corresponding to the latest error message that occured while
+ *         using the function object
+ */
+string YFunction::get_errorMessage(void)
 {
-    this->_parseAttr(j);
-    this->_parserHelper();
-    return 0;
+    return _lastErrorMsg;
 }
 
-// Set an attribute in the function, and parse the resulting new function state
-YRETCODE YFunction::_setAttr(string attrname, string newvalue)
+/**
+ * Checks if the function is currently reachable, without raising any error.
+ * If there is a cached value for the function in cache, that has not yet
+ * expired, the device is considered reachable.
+ * No exception is raised if there is an error while trying to contact the
+ * device hosting the function.
+ *
+ * @return true if the function can be reached, and false otherwise
+ */
+bool YFunction::isOnline(void)
 {
-    string      errmsg, request;
-    int         res;
     YDevice     *dev;
+    string      errmsg;
+    YJSONObject *apires;
 
-    // Execute http request
-    res = _buildSetRequest(attrname, &newvalue, request, errmsg);
-    if(YISERR(res)) {
-        _throw((YRETCODE)res, errmsg);
-        return (YRETCODE)res;
+    yEnterCriticalSection(&_this_cs);
+    try {
+    // A valid value in cache means that the device is online
+    if (_cacheExpiration > yapiGetTickCount()) {
+        yLeaveCriticalSection(&_this_cs);
+        return true;
     }
-    // Get device Object
-    res = _getDevice(dev,  errmsg);
+
+    // Check that the function is available, without throwing exceptions
+    if (YISERR(_getDevice(dev, errmsg))) {
+        yLeaveCriticalSection(&_this_cs);
+        return false;
+    }
+
+    // Try to execute a function request to be positively sure that the device is ready
+    if(YISERR(dev->requestAPI(apires, errmsg))) {
+        yLeaveCriticalSection(&_this_cs);
+        return false;
+	}
+
+    // Preload the function data, since we have it in device cache
+    this->_load_unsafe(YAPI::DefaultCacheValidity);
+    } catch (std::exception) {
+        yLeaveCriticalSection(&_this_cs);
+        return false;
+    }
+    yLeaveCriticalSection(&_this_cs);
+    return true;
+}
+
+YRETCODE YFunction::_load_unsafe(int msValidity)
+{
+    YJSONObject *node;
+    YDevice     *dev;
+    string      errmsg;
+    YFUN_DESCR   fundescr;
+    int         res;
+    char        errbuf[YOCTO_ERRMSG_LEN];
+    char        serial[YOCTO_SERIAL_LEN];
+    char        funcId[YOCTO_FUNCTION_LEN];
+    string      pushed;
+
+    // While values are pushed by notification, refresh only the attributes
+    // they carry, the others stay as loaded (see _getPushedValue)
+    if (this->_getPushedValue(pushed) && this->_applyPushedValue(pushed)) {
+        return YAPI_SUCCESS;
+    }
+
+    // Resolve our reference to our device, load REST API
+    res = _getDevice(dev, errmsg);
     if(YISERR(res)) {
         _throw((YRETCODE)res, errmsg);
         return (YRETCODE)res;
     }
 
-    res = dev->HTTPRequestAsync(0, request, NULL, NULL, errmsg);
+    // Get our function Id
+    fundescr = YapiWrapper::getFunction(_className, _func, errmsg);
+    if(YISERR(fundescr)) {
+        _throw((YRETCODE)fundescr, errmsg);
+        return (YRETCODE)fundescr;
+    }
+    res = yapiGetFunctionInfo(fundescr, NULL, serial, funcId, NULL, NULL, errbuf);
     if(YISERR(res)) {
-        // Check if an update of the device list does not solve the issue
-        res = YapiWrapper::updateDeviceList(true,errmsg);
-        if(YISERR(res)) {
-            _throw((YRETCODE)res, errmsg);
-            return (YRETCODE)res;
-        }
-        res = dev->HTTPRequestAsync(0, request, NULL, NULL, errmsg);
-        if(YISERR(res)) {
-            _throw((YRETCODE)res, errmsg);
-            return (YRETCODE)res;
-        }
+        _throw((YRETCODE)res, errbuf);
+        return (YRETCODE)res;
     }
-    if (_cacheExpiration != 0) {
-        _cacheExpiration=0;
+    res = dev->requestFunctionAPI(funcId, msValidity, node, errmsg);
+    if(YISERR(res)) {
+        _throw((YRETCODE)res, errmsg);
+        return (YRETCODE)res;
     }
+    _cacheExpiration = yapiGetTickCount() + msValidity;
+    _loadedAt = yapiGetTickCount();
+    _serial = serial;
+    _funId = funcId;
+    _hwId = _serial + '.' + _funId;
+    _parse(node);
     return YAPI_SUCCESS;
+}
 
+
+/**
+ * Preloads the function cache with a specified validity duration.
+ * By default, whenever accessing a device, all function attributes
+ * are kept in cache for the standard duration (5 ms). This method can be
+ * used to temporarily mark the cache as valid for a longer period, in order
+ * to reduce network traffic for instance.
+ *
+ * @param msValidity : an integer corresponding to the validity attributed to the
+ *         loaded function parameters, in milliseconds
+ *
+ * @return YAPI_SUCCESS when the call succeeds.
+ *
+ * On failure, throws an exception or returns a negative error code.
+ */
+YRETCODE YFunction::load(int msValidity)
+{
+    YRETCODE res;
+    yEnterCriticalSection(&_this_cs);
+    try{
+       res = this->_load_unsafe(msValidity);
+    } catch (std::exception) {
+        yLeaveCriticalSection(&_this_cs);
+        throw;
+    }
+    yLeaveCriticalSection(&_this_cs);
+    return res;
 }
 
 
-// Method used to send http request to the device (not the function)
-string      YFunction::_requestEx(int channel, const string& request, yapiRequestProgressCallback callback, void *context)
+// Start loading the function attributes, like load(), without waiting for
+// the reply of the device (light reply, as in YDevice::requestFunctionAPI)
+YAsyncRequest YFunction::_loadAsyncStart(void)
 {
-    YDevice     *dev;
-    string      errmsg, buffer;
+    string      errmsg;
+    YFUN_DESCR  fundescr;
     int         res;
+    char        errbuf[YOCTO_ERRMSG_LEN];
+    char        funcId[YOCTO_FUNCTION_LEN];
 
-
-    // Resolve our reference to our device, load REST API
-    res = _getDevice(dev, errmsg);
+    res = _getDescriptor(fundescr, errmsg);
     if (YISERR(res)) {
-        _throw((YRETCODE)res, errmsg);
-        return YAPI_INVALID_STRING;
+        return yAsyncRequestFailed((YRETCODE)res, errmsg);
     }
-    res = dev->HTTPRequest(channel, request, buffer, callback, context, errmsg);
+    res = yapiGetFunctionInfo(fundescr, NULL, NULL, funcId, NULL, NULL, errbuf);
     if (YISERR(res)) {
-        // Check if an update of the device list does notb solve the issue
-        res = YapiWrapper::updateDeviceList(true, errmsg);
-        if (YISERR(res)) {
-            this->_throw((YRETCODE)res, errmsg);
-            return YAPI_INVALID_STRING;
-        }
-        res = dev->HTTPRequest(channel, request, buffer, callback, context, errmsg);
-        if (YISERR(res)) {
-            this->_throw((YRETCODE)res, errmsg);
-            return YAPI_INVALID_STRING;
-        }
-    }
-    if (0 != buffer.find("OK\r\n")) {
-        if (0 != buffer.find("HTTP/1.1 200 OK\r\n")) {
-            this->_throw(YAPI_IO_ERROR, "http request failed");
-            return YAPI_INVALID_STRING;
-        }
+        return yAsyncRequestFailed((YRETCODE)res, errbuf);
     }
-    return buffer;
+    return yAsyncRequestStart(fundescr, 0, "GET /api/" + string(funcId) + ".json \r\n\r\n", false);
 }
 
-string      YFunction::_request(const string& request)
-{
-    return _requestEx(0, request, NULL, NULL);
-}
 
+static YRETCODE _parseJsonReply(const string& buffer, string& json_str, string& errmsg);
 
-// Method used to send http request to the device (not the function)
-string      YFunction::_download(const string& url)
+// Update the function attributes from the reply to _loadAsyncStart()
+YRETCODE YFunction::_loadAsyncDone(YAsyncRequest& request, int msValidity)
 {
-    string      request,buffer;
-	size_t      found;
+    YJSONObject *node;
+    string      errmsg, json_str;
+    YFUN_DESCR  fundescr;
+    int         res;
+    char        errbuf[YOCTO_ERRMSG_LEN];
+    char        serial[YOCTO_SERIAL_LEN];
+    char        funcId[YOCTO_FUNCTION_LEN];
 
-    request = "GET /"+url+" HTTP/1.1\r\n\r\n";
-    buffer = this->_request(request);
-    found = buffer.find("\r\n\r\n");
-    if(string::npos == found){
-        this->_throw(YAPI_IO_ERROR,"http request failed");
-        return YAPI_INVALID_STRING;
+    res = request.get_errorType();
+    if (YISERR(res)) {
+        _throw((YRETCODE)res, request.get_errorMessage());
+        return (YRETCODE)res;
     }
-
-    return buffer.substr(found+4);
-}
-
-
-// Method used to upload a file to the device
-YRETCODE    YFunction::_uploadWithProgress(const string& path, const string& content, yapiRequestProgressCallback callback, void *context)
-{
-
-    string      request, buffer;
-    string      boundary;
-    size_t      found;
-
-    request = "POST /upload.html HTTP/1.1\r\n";
-    string body = "Content-Disposition: form-data; name=\"" + path + "\"; filename=\"api\"\r\n" +
-        "Content-Type: application/octet-stream\r\n" +
-        "Content-Transfer-Encoding: binary\r\n\r\n" + content;
-    do {
-        boundary = YapiWrapper::ysprintf("Zz%06xzZ", rand() & 0xffffff);
-    } while (body.find(boundary) != string::npos);
-    request += "Content-Type: multipart/form-data; boundary=" + boundary + "\r\n";
-    request += "\r\n--" + boundary + "\r\n" + body + "\r\n--" + boundary + "--\r\n";
-    buffer = this->_requestEx(0, request, callback, context);
-    found = buffer.find("\r\n\r\n");
-    if (string::npos == found) {
-        this->_throw(YAPI_IO_ERROR, "http request failed");
+    res = _parseJsonReply(request.get_content(), json_str, errmsg);
+    if (YISERR(res)) {
+        _throw((YRETCODE)res, errmsg);
+        return (YRETCODE)res;
+    }
+    fundescr = YapiWrapper::getFunction(_className, _func, errmsg);
+    if (YISERR(fundescr)) {
+        _throw((YRETCODE)fundescr, errmsg);
+        return (YRETCODE)fundescr;
+    }
+    res = yapiGetFunctionInfo(fundescr, NULL, serial, funcId, NULL, NULL, errbuf);
+    if (YISERR(res)) {
+        _throw((YRETCODE)res, errbuf);
+        return (YRETCODE)res;
+    }
+    node = new YJSONObject(json_str, 0, (int)json_str.length());
+    try {
+        node->parse();
+    } catch (std::exception ex) {
+        delete node;
+        _throw(YAPI_IO_ERROR, "unexpected JSON structure: " + string(ex.what()));
         return YAPI_IO_ERROR;
     }
+    _loadFromNode(node, serial, funcId, msValidity);
+    delete node;
     return YAPI_SUCCESS;
 }
 
 
-// Method used to upload a file to the device
-YRETCODE    YFunction::_upload(const string& path, const string& content)
+// Update the function attributes from its node of the device API
+void YFunction::_loadFromNode(YJSONObject *node, const string& serial, const string& funcId, int msValidity)
 {
-    return this->_uploadWithProgress(path, content, NULL, NULL);
+    yEnterCriticalSection(&_this_cs);
+    _cacheExpiration = yapiGetTickCount() + msValidity;
+    _loadedAt = yapiGetTickCount();
+    _serial = serial;
+    _funId = funcId;
+    _hwId = _serial + '.' + _funId;
+    _parse(node);
+    yLeaveCriticalSection(&_this_cs);
 }
 
 
-// Method used to cache DataStream objects (new DataLogger)
-YDataStream *YFunction::_findDataStream(YDataSet& dataset, const string& def)
+/**
+ * Invalidates the cache. Invalidates the cache of the function attributes. Forces the
+ * next call to get_xxx() or loadxxx() to use values that come from the device.
+ *
+ * @noreturn
+ */
+void YFunction::clearCache()
 {
-    string key = dataset.get_functionId()+":"+def;
-    if(_dataStreams.find(key) != _dataStreams.end())
-        return _dataStreams[key];
-
-    YDataStream *newDataStream = new YDataStream(this, dataset, YAPI::_decodeWords(def));
-    _dataStreams[key] = newDataStream;
-    return newDataStream;
-}
+    YDevice     *dev;
+    string      errmsg, apires;
 
-// Method used to clear cache of DataStream object (undocumented)
-void YFunction::_clearDataStreamCache()
-{
-    std::map<string, YDataStream*>::iterator it;
-    for (it = _dataStreams.begin(); it != _dataStreams.end(); ++it) {
-        YDataStream *ds = it->second;
 
-        delete(ds);
+    yEnterCriticalSection(&_this_cs);
+    // Resolve our reference to our device, load REST API
+    int res = _getDevice(dev, errmsg);
+    if (YISERR(res)) {
+        yLeaveCriticalSection(&_this_cs);
+        return;
     }
-    _dataStreams.clear();
+    dev->clearCache(false);
+    if (_cacheExpiration){
+        _cacheExpiration = yapiGetTickCount();
+    }
+    yForgetPushedValue(_fundescr);
+    yLeaveCriticalSection(&_this_cs);
 }
 
 
-
-// Return a string that describes the function (class and logical name or hardware id)
-string YFunction::describe(void)
+/**
+ * Starts a write batch on the function. Until commitBatch() is called,
+ * attribute changes made with the set_xxx() methods are only recorded,
+ * and are then sent to the device in as few requests as possible
+ * (usually a single one). The batch belongs to the object, not to
+ * the calling thread. Calling this method while a batch is already
+ * open has no effect.
+ *
+ * @return YAPI_SUCCESS when the call succeeds.
+ */
+int YFunction::beginBatch(void)
 {
-    YFUN_DESCR  fundescr;
-    YDEV_DESCR  devdescr;
-    string      errmsg, serial, funcId, funcName, funcValue;
-    string      descr =  _func;
-    string res;
-
     yEnterCriticalSection(&_this_cs);
-    fundescr = YapiWrapper::getFunction(_className, _func, errmsg);
-    if(!YISERR(fundescr) && !YISERR(YapiWrapper::getFunctionInfo(fundescr, devdescr, serial, funcId, funcName, funcValue, errmsg))) {
-        res = _className + "(" + _func + ")=" + serial + "." + funcId;
-    } else {
-        res = _className + "(" + _func + ")=unresolved";
-    }
+    _batching = true;
     yLeaveCriticalSection(&_this_cs);
-    return res;
+    return YAPI_SUCCESS;
 }
 
-// Return a string that describes the function (class and logical name or hardware id)
-string YFunction::get_friendlyName(void)
+
+/**
+ * Sends the attribute changes recorded since beginBatch() to the device,
+ * in the order in which they were made, and closes the batch.
+ * The outcome of each change can then be checked with get_batchResults().
+ *
+ * @return YAPI_SUCCESS when all changes have been applied.
+ *
+ * On failure, throws an exception or returns the negative error code
+ * of the first change that could not be applied.
+ */
+int YFunction::commitBatch(void)
 {
-    YFUN_DESCR   fundescr,moddescr;
-    YDEV_DESCR   devdescr;
-    YRETCODE     retcode;
-    string       errmsg, serial, funcId, funcName, funcValue;
-    string       mod_serial, mod_funcId,mod_funcname;
+    vector<yapiAttrWrite> writes;
+    YFUN_DESCR  fundesc;
+    YDevice     *dev = NULL;
+    char        funcid[YOCTO_FUNCTION_LEN];
+    char        errbuff[YOCTO_ERRMSG_LEN];
+    string      errmsg, firstErrmsg;
+    YRETCODE    res, firstErr = YAPI_SUCCESS;
+    size_t      start, end, i;
 
     yEnterCriticalSection(&_this_cs);
-    // Resolve the function name
-    retcode = _getDescriptor(fundescr, errmsg);
-    if(!YISERR(retcode) && !YISERR(YapiWrapper::getFunctionInfo(fundescr, devdescr, serial, funcId, funcName, funcValue, errmsg))) {
-        if(funcName!="") {
-            funcId = funcName;
+    writes.swap(_batchWrites);
+    _batching = false;
+    if (writes.size() > 0) {
+        res = _getDescriptor(fundesc, errmsg);
+        if (!YISERR(res)) {
+            res = (YRETCODE)yapiGetFunctionInfo(fundesc, NULL, NULL, funcid, NULL, NULL, errbuff);
+            if (YISERR(res)) {
+                errmsg = errbuff;
+            }
         }
-
-        moddescr = YapiWrapper::getFunction("Module", serial, errmsg);
-        if(!YISERR(moddescr) && !YISERR(YapiWrapper::getFunctionInfo(moddescr, devdescr, mod_serial, mod_funcId, mod_funcname, funcValue, errmsg))) {
-            if(mod_funcname!="") {
-                yLeaveCriticalSection(&_this_cs);
-                return mod_funcname+"."+funcId;
+        if (!YISERR(res)) {
+            res = _getDevice(dev, errmsg);
+        }
+        for (start = 0; start < writes.size(); start = end) {
+            if (YISERR(res)) {
+                // the function cannot be reached: every change fails
+                end = writes.size();
+            } else {
+                res = _sendBatchRequest(dev, funcid, writes, start, end, errmsg);
+            }
+            for (i = start; i < end; i++) {
+                writes[i].errorType = res;
+                writes[i].errorMessage = (YISERR(res) ? errmsg : "");
+            }
+            if (YISERR(res) && firstErr == YAPI_SUCCESS) {
+                firstErr = res;
+                firstErrmsg = errmsg;
+            }
+            if (YISERR(res) && dev != NULL) {
+                // give the next request its own chance
+                res = YAPI_SUCCESS;
             }
         }
-        yLeaveCriticalSection(&_this_cs);
-        return serial+"."+funcId;
+        if (_cacheExpiration != 0) {
+            _cacheExpiration = 0;
+        }
+        yForgetPushedValue(_fundescr);
     }
+    _batchResults.swap(writes);
     yLeaveCriticalSection(&_this_cs);
-    _throw((YRETCODE)YAPI::DEVICE_NOT_FOUND, errmsg);
-    return Y_FRIENDLYNAME_INVALID;
+    if (YISERR(firstErr)) {
+        _throw(firstErr, firstErrmsg);
+    }
+    return firstErr;
 }
 
 
-
-
 /**
- * Returns the unique hardware identifier of the function in the form SERIAL.FUNCTIONID.
- * The unique hardware identifier is composed of the device serial
- * number and of the hardware identifier of the function (for example RELAYLO1-123456.relay1).
- *
- * @return a string that uniquely identifies the function (ex: RELAYLO1-123456.relay1)
+ * Drops the attribute changes recorded since beginBatch() and closes
+ * the batch, without contacting the device.
  *
- * On failure, throws an exception or returns  Y_HARDWAREID_INVALID.
+ * @return YAPI_SUCCESS when the call succeeds.
  */
-string YFunction::get_hardwareId(void)
+int YFunction::cancelBatch(void)
 {
-    YRETCODE    retcode;
-    YFUN_DESCR  fundesc;
-    string      errmsg;
-    char        snum[YOCTO_SERIAL_LEN];
-    char        funcid[YOCTO_FUNCTION_LEN];
-    char        errbuff[YOCTO_ERRMSG_LEN];
-
     yEnterCriticalSection(&_this_cs);
-    // Resolve the function name
-    retcode = _getDescriptor(fundesc, errmsg);
-    if(YISERR(retcode)) {
-        yLeaveCriticalSection(&_this_cs);
-        _throw(retcode, errmsg);
-        return HARDWAREID_INVALID;
-    }
-    if(YISERR(retcode=yapiGetFunctionInfo(fundesc, NULL, snum, funcid, NULL, NULL,errbuff))){
-        errmsg = errbuff;
-        yLeaveCriticalSection(&_this_cs);
-        _throw(retcode, errmsg);
-        return HARDWAREID_INVALID;
-    }
+    _batchWrites.clear();
+    _batching = false;
     yLeaveCriticalSection(&_this_cs);
-    return string(snum)+string(".")+string(funcid);
+    return YAPI_SUCCESS;
 }
 
+
 /**
- * Returns the hardware identifier of the function, without reference to the module. For example
- * relay1
+ * Returns the outcome of each attribute change sent by the last call to
+ * commitBatch(), in the order in which the changes were made.
  *
- * @return a string that identifies the function (ex: relay1)
- *
- * On failure, throws an exception or returns  Y_FUNCTIONID_INVALID.
+ * @return a vector of yapiAttrWrite records
  */
-string YFunction::get_functionId(void)
+vector<yapiAttrWrite> YFunction::get_batchResults(void)
 {
-    YRETCODE    retcode;
-    YFUN_DESCR  fundesc;
-    string      errmsg;
-    char        funcid[YOCTO_FUNCTION_LEN];
-    char        errbuff[YOCTO_ERRMSG_LEN];
-
-    yEnterCriticalSection(&_this_cs);
-    // Resolve the function name
-    retcode = _getDescriptor(fundesc, errmsg);
-    if(YISERR(retcode)) {
-        yLeaveCriticalSection(&_this_cs);
-        _throw(retcode, errmsg);
-        return HARDWAREID_INVALID;
-    }
-    if(YISERR(retcode=yapiGetFunctionInfo(fundesc, NULL, NULL, funcid, NULL, NULL,errbuff))){
-        errmsg = errbuff;
-        yLeaveCriticalSection(&_this_cs);
-        _throw(retcode, errmsg);
-        return HARDWAREID_INVALID;
-    }
+    vector<yapiAttrWrite> res;
+    yEnterCriticalSection(&_this_cs);
+    res = _batchResults;
     yLeaveCriticalSection(&_this_cs);
-    return string(funcid);
+    return res;
 }
 
 
 /**
- * Returns the numerical error code of the latest error with the function.
- * This method is mostly useful when using the Yoctopuce library with
- * exceptions disabled.
+ * Enables or disables asynchronous writes on the function. When enabled,
+ * the set_xxx() methods return as soon as the change is queued, without
+ * waiting for the device. The changes reach each device in the order in
+ * which they were made, and consecutive changes to the same function are
+ * sent in a single request. The queued changes are sent while events are
+ * handled (YAPI::HandleEvents(), YAPI::Sleep() or YAsyncWrite::wait()).
+ * The outcome of the last change is available from get_lastWrite().
+ * Each device processes one request at a time, but behind an HTTP hub
+ * the devices get their changes in parallel, each on a connection of
+ * its own: the changes to many devices complete much faster than with
+ * synchronous writes. The changes to a single device, or to the devices
+ * of a websocket hub (which processes one request at a time), do not
+ * complete faster: the caller is only spared the wait, and requests
+ * are saved by merging.
  *
- * @return a number corresponding to the code of the latest error that occurred while
- *         using the function object
+ * @param enabled : true to queue the attribute changes
+ *
+ * @return YAPI_SUCCESS when the call succeeds.
  */
-YRETCODE YFunction::get_errorType(void)
+int YFunction::set_asyncWrites(bool enabled)
 {
-    return _lastErrorType;
+    yEnterCriticalSection(&_this_cs);
+    _asyncWrites = enabled;
+    yLeaveCriticalSection(&_this_cs);
+    return YAPI_SUCCESS;
 }
 
+
 /**
- * Returns the error message of the latest error with the function.
- * This method is mostly useful when using the Yoctopuce library with
- * exceptions disabled.
+ * Returns true if the set_xxx() methods of the function queue their
+ * changes instead of waiting for the device.
  *
- * @return a string corresponding to the latest error message that occured while
- *         using the function object
+ * @return true if asynchronous writes are enabled
  */
-string YFunction::get_errorMessage(void)
+bool YFunction::get_asyncWrites(void)
 {
-    return _lastErrorMsg;
+    bool res;
+    yEnterCriticalSection(&_this_cs);
+    res = _asyncWrites;
+    yLeaveCriticalSection(&_this_cs);
+    return res;
 }
 
+
 /**
- * Checks if the function is currently reachable, without raising any error.
- * If there is a cached value for the function in cache, that has not yet
- * expired, the device is considered reachable.
- * No exception is raised if there is an error while trying to contact the
- * device hosting the function.
+ * Returns the completion token of the last attribute change queued on
+ * the function while asynchronous writes are enabled.
  *
- * @return true if the function can be reached, and false otherwise
+ * @return a YAsyncWrite object
  */
-bool YFunction::isOnline(void)
+YAsyncWrite YFunction::get_lastWrite(void)
 {
-    YDevice     *dev;
-    string      errmsg;
-    YJSONObject *apires;
-
+    YAsyncWrite res;
     yEnterCriticalSection(&_this_cs);
-    try {
-    // A valid value in cache means that the device is online
-    if (_cacheExpiration > yapiGetTickCount()) {
-        yLeaveCriticalSection(&_this_cs);
-        return true;
-    }
+    res = _lastWrite;
+    yLeaveCriticalSection(&_this_cs);
+    return res;
+}
 
-    // Check that the function is available, without throwing exceptions
-    if (YISERR(_getDevice(dev, errmsg))) {
-        yLeaveCriticalSection(&_this_cs);
-        return false;
-    }
 
-    // Try to execute a function request to be positively sure that the device is ready
-    if(YISERR(dev->requestAPI(apires, errmsg))) {
-        yLeaveCriticalSection(&_this_cs);
-        return false;
-	}
+int YFunctionGroupBase::get_count(void)
+{
+    return (int)_members.size();
+}
 
-    // Preload the function data, since we have it in device cache
-    this->_load_unsafe(YAPI::DefaultCacheValidity);
-    } catch (std::exception) {
-        yLeaveCriticalSection(&_this_cs);
-        return false;
-    }
-    yLeaveCriticalSection(&_this_cs);
-    return true;
+void YFunctionGroupBase::clear(void)
+{
+    _members.clear();
+    _errorTypes.clear();
+    _errorMessages.clear();
 }
 
-YRETCODE YFunction::_load_unsafe(int msValidity)
+YRETCODE YFunctionGroupBase::get_errorType(int index)
 {
-    YJSONObject *j,*node;
-    YDevice     *dev;
-    string      errmsg;
-    YFUN_DESCR   fundescr;
-    int         res;
-    char        errbuf[YOCTO_ERRMSG_LEN];
-    char        serial[YOCTO_SERIAL_LEN];
-    char        funcId[YOCTO_FUNCTION_LEN];
+    if (index < 0 || index >= (int)_errorTypes.size()) {
+        return YAPI_SUCCESS;
+    }
+    return _errorTypes[index];
+}
 
-    // Resolve our reference to our device, load REST API
-    res = _getDevice(dev, errmsg);
-    if(YISERR(res)) {
-        _throw((YRETCODE)res, errmsg);
-        return (YRETCODE)res;
+string YFunctionGroupBase::get_errorMessage(int index)
+{
+    if (index < 0 || index >= (int)_errorMessages.size()) {
+        return "";
     }
-    res = dev->requestAPI(j, errmsg);
-    if(YISERR(res)) {
-        _throw((YRETCODE)res, errmsg);
-        return (YRETCODE)res;
+    return _errorMessages[index];
+}
+
+void YFunctionGroupBase::_setResult(size_t index, YRETCODE res, const string& errmsg)
+{
+    _errorTypes[index] = res;
+    _errorMessages[index] = (YISERR(res) ? errmsg : "");
+}
+
+// Load all the members with one request per device, all sent before waiting
+// for any of them: the json of the function when the group has a single
+// function on the device, the whole api.json otherwise. The visitor is called
+// on each member once loaded.
+YRETCODE YFunctionGroupBase::_load(int msValidity, YFunctionGroupVisitor *visitor)
+{
+    std::map<YDEV_DESCR,size_t> devIndex;
+    std::map<YDEV_DESCR,size_t>::iterator it;
+    vector<YAsyncRequest>   requests;
+    vector< vector<size_t> > devMembers;
+    vector<bool>            singleFunc;
+    vector<string>          serials, funcIds;
+    YJSONObject             *apires, *node;
+    YFUN_DESCR              fundescr;
+    YDEV_DESCR              devdescr;
+    string                  errmsg, json_str;
+    char                    errbuf[YOCTO_ERRMSG_LEN];
+    char                    serial[YOCTO_SERIAL_LEN];
+    char                    funcId[YOCTO_FUNCTION_LEN];
+    size_t                  d, i, k;
+    YRETCODE                res;
+
+    _errorTypes.assign(_members.size(), YAPI_SUCCESS);
+    _errorMessages.assign(_members.size(), "");
+    serials.resize(_members.size());
+    funcIds.resize(_members.size());
+    for (i = 0; i < _members.size(); i++) {
+        res = _members[i]->_getDescriptor(fundescr, errmsg);
+        if (YISERR(res)) {
+            _setResult(i, res, errmsg);
+            continue;
+        }
+        res = (YRETCODE)yapiGetFunctionInfo(fundescr, &devdescr, serial, funcId, NULL, NULL, errbuf);
+        if (YISERR(res)) {
+            _setResult(i, res, errbuf);
+            continue;
+        }
+        serials[i] = serial;
+        funcIds[i] = funcId;
+        it = devIndex.find(devdescr);
+        if (it == devIndex.end()) {
+            devIndex[devdescr] = devMembers.size();
+            devMembers.push_back(vector<size_t>());
+            devMembers.back().push_back(i);
+            singleFunc.push_back(true);
+        } else {
+            devMembers[it->second].push_back(i);
+            if (funcIds[i] != funcIds[devMembers[it->second][0]]) {
+                singleFunc[it->second] = false;
+            }
+        }
     }
-
-    // Get our function Id
-    fundescr = YapiWrapper::getFunction(_className, _func, errmsg);
-    if(YISERR(fundescr)) {
-        _throw((YRETCODE)fundescr, errmsg);
-        return (YRETCODE)fundescr;
+    for (d = 0; d < devMembers.size(); d++) {
+        i = devMembers[d][0];
+        if (singleFunc[d]) {
+            // only this function is needed, as in YFunction::loadAsync()
+            requests.push_back(_members[i]->_requestAsync(0, "GET /api/" + funcIds[i] + ".json \r\n\r\n"));
+        } else {
+            // light reply, as in YDevice::requestAPI()
+            requests.push_back(_members[i]->_requestAsync(0, "GET /api.json \r\n\r\n"));
+        }
     }
-    res = yapiGetFunctionInfo(fundescr, NULL, serial, funcId, NULL, NULL, errbuf);
-    if(YISERR(res)) {
-        _throw((YRETCODE)res, errbuf);
-        return (YRETCODE)res;
+    for (d = 0; d < requests.size(); d++) {
+        res = requests[d].wait(YAPI_BLOCKING_NET_REQUEST_TIMEOUT);
+        if (YISERR(res)) {
+            errmsg = (res == YAPI_TIMEOUT ? "timeout waiting for the device" : requests[d].get_errorMessage());
+        } else {
+            res = _parseJsonReply(requests[d].get_content(), json_str, errmsg);
+        }
+        apires = NULL;
+        if (!YISERR(res)) {
+            apires = new YJSONObject(json_str, 0, (int)json_str.length());
+            try {
+                apires->parse();
+            } catch (std::exception ex) {
+                delete apires;
+                apires = NULL;
+                res = YAPI_IO_ERROR;
+                errmsg = "unexpected JSON structure: " + string(ex.what());
+            }
+        }
+        for (k = 0; k < devMembers[d].size(); k++) {
+            i = devMembers[d][k];
+            if (apires == NULL) {
+                _setResult(i, res, errmsg);
+                continue;
+            }
+            if (singleFunc[d]) {
+                node = apires;
+            } else {
+                try {
+                    node = apires->getYJSONObject(funcIds[i]);
+                } catch (std::exception) {
+                    node = NULL;
+                }
+            }
+            if (node == NULL) {
+                _setResult(i, YAPI_IO_ERROR, "unexpected JSON structure: missing function " + funcIds[i]);
+                continue;
+            }
+            _members[i]->_loadFromNode(node, serials[i], funcIds[i], msValidity);
+            if (visitor) {
+                visitor->visit(i, _members[i]);
+            }
+        }
+        if (apires) {
+            delete apires;
+        }
     }
-    _cacheExpiration = yapiGetTickCount() + msValidity;
-    _serial = serial;
-    _funId = funcId;
-    _hwId = _serial + '.' + _funId;
-
-    try {
-        node = j->getYJSONObject(funcId);
-    } catch (std::exception ex) {
-        _throw(YAPI_IO_ERROR, "unexpected JSON structure: missing function " + _funId);
-        return YAPI_IO_ERROR;
+    for (i = 0; i < _errorTypes.size(); i++) {
+        if (YISERR(_errorTypes[i])) {
+            return _errorTypes[i];
+        }
     }
-    _parse(node);
     return YAPI_SUCCESS;
 }
 
-
-/**
- * Preloads the function cache with a specified validity duration.
- * By default, whenever accessing a device, all function attributes
- * are kept in cache for the standard duration (5 ms). This method can be
- * used to temporarily mark the cache as valid for a longer period, in order
- * to reduce network traffic for instance.
- *
- * @param msValidity : an integer corresponding to the validity attributed to the
- *         loaded function parameters, in milliseconds
- *
- * @return YAPI_SUCCESS when the call succeeds.
- *
- * On failure, throws an exception or returns a negative error code.
- */
-YRETCODE YFunction::load(int msValidity)
+// Load the members for read(): the getters are called right after each
+// member is loaded, so that the default cache validity is enough
+YRETCODE YFunctionGroupBase::_loadForRead(YFunctionGroupVisitor *visitor)
 {
-    YRETCODE res;
-    yEnterCriticalSection(&_this_cs);
-    try{
-       res = this->_load_unsafe(msValidity);
-    } catch (std::exception) {
-        yLeaveCriticalSection(&_this_cs);
-        throw;
-    }
-    yLeaveCriticalSection(&_this_cs);
-    return res;
+    return this->_load((int)YAPI::DefaultCacheValidity, visitor);
 }
 
+YRETCODE YFunctionGroupBase::load(int msValidity)
+{
+    return this->_load(msValidity, NULL);
+}
 
-/**
- * Invalidates the cache. Invalidates the cache of the function attributes. Forces the
- * next call to get_xxx() or loadxxx() to use values that come from the device.
- *
- * @noreturn
- */
-void YFunction::clearCache()
+// Prepare a write() call: the setters of the members queue their changes.
+// A member with a write batch open would add the change to its batch, and
+// leave no asynchronous write to wait for: it is rejected instead.
+void YFunctionGroupBase::_startWrites(void)
 {
-    YDevice     *dev;
-    string      errmsg, apires;
+    bool    batching;
+    size_t  i;
 
+    _errorTypes.assign(_members.size(), YAPI_SUCCESS);
+    _errorMessages.assign(_members.size(), "");
+    _writes.assign(_members.size(), YAsyncWrite());
+    _wasAsync.resize(_members.size());
+    for (i = 0; i < _members.size(); i++) {
+        yEnterCriticalSection(&_members[i]->_this_cs);
+        batching = _members[i]->_batching;
+        yLeaveCriticalSection(&_members[i]->_this_cs);
+        if (batching) {
+            _setResult(i, YAPI_INVALID_ARGUMENT, "a write batch is open on this function");
+        }
+        _wasAsync[i] = _members[i]->get_asyncWrites();
+        _members[i]->set_asyncWrites(true);
+    }
+}
 
-    yEnterCriticalSection(&_this_cs);
-    // Resolve our reference to our device, load REST API
-    int res = _getDevice(dev, errmsg);
+void YFunctionGroupBase::_queuedWrite(size_t index, int res, const string& errmsg)
+{
     if (YISERR(res)) {
-        yLeaveCriticalSection(&_this_cs);
-        return;
+        _setResult(index, (YRETCODE)res, errmsg);
+    } else {
+        _writes[index] = _members[index]->get_lastWrite();
     }
-    dev->clearCache(false);
-    if (_cacheExpiration){
-        _cacheExpiration = yapiGetTickCount();
+}
+
+// Wait for the changes queued by a write() call and collect their results
+YRETCODE YFunctionGroupBase::_endWrites(void)
+{
+    YRETCODE    res, firstErr = YAPI_SUCCESS;
+    size_t      i;
+
+    for (i = 0; i < _members.size(); i++) {
+        _members[i]->set_asyncWrites(_wasAsync[i]);
     }
-    yLeaveCriticalSection(&_this_cs);
+    for (i = 0; i < _writes.size(); i++) {
+        if (YISERR(_errorTypes[i])) {
+            continue;
+        }
+        res = _writes[i].wait(YAPI_BLOCKING_NET_REQUEST_TIMEOUT);
+        _setResult(i, res, (res == YAPI_TIMEOUT ? "timeout waiting for the device" : _writes[i].get_errorMessage()));
+    }
+    _writes.clear();
+    for (i = 0; i < _errorTypes.size(); i++) {
+        if (YISERR(_errorTypes[i]) && firstErr == YAPI_SUCCESS) {
+            firstErr = _errorTypes[i];
+        }
+    }
+    return firstErr;
 }
 
 
@@ -3368,50 +6306,28 @@ void YFunction::_UpdateValueCallbackList(YFunction* func, bool add)
 {
     if (add) {
         func->isOnline();
-        vector<YFunction*>::iterator it;
-        for ( it=_FunctionCallbacks.begin() ; it < _FunctionCallbacks.end(); it++ ){
-            if (*it == func)
-                return;
-        }
-        _FunctionCallbacks.push_back(func);
-    }else{
-        vector<YFunction*>::iterator it;
-        for ( it=_FunctionCallbacks.begin() ; it < _FunctionCallbacks.end(); it++ ){
-            if (*it == func) {
-                 _FunctionCallbacks.erase(it);
-                 break;
-            }
-        }
     }
+    yapiLockFunctionCallBack(NULL);
+    yCallbackIndexUpdate(_FunctionCallbacks, func->_fundescr, func, add);
+    yapiUnlockFunctionCallBack(NULL);
 }
 
 
 void YFunction::_UpdateTimedReportCallbackList(YFunction* func, bool add)
 {
-  if (add) {
+    if (add) {
         func->isOnline();
-        vector<YFunction*>::iterator it;
-        for ( it=_TimedReportCallbackList.begin() ; it < _TimedReportCallbackList.end(); it++ ){
-            if (*it == func)
-                return;
-        }
-        _TimedReportCallbackList.push_back(func);
-    }else{
-        vector<YFunction*>::iterator it;
-        for ( it=_TimedReportCallbackList.begin() ; it < _TimedReportCallbackList.end(); it++ ){
-            if (*it == func) {
-                 _TimedReportCallbackList.erase(it);
-                 break;
-            }
-        }
     }
+    yapiLockFunctionCallBack(NULL);
+    yCallbackIndexUpdate(_TimedReportCallbackList, func->_fundescr, func, add);
+    yapiUnlockFunctionCallBack(NULL);
 }
 
 
 // This is the internal device cache object
 vector<YDevice*> YDevice::_devCache;
 
-YDevice::YDevice(YDEV_DESCR devdesc): _devdescr(devdesc), _cacheStamp(0), _cacheJson(NULL), _subpath(NULL) {
+YDevice::YDevice(YDEV_DESCR devdesc): _devdescr(devdesc), _cacheStamp(0), _cacheLoaded(0), _cacheJson(NULL), _subpath(NULL) {
     yInitializeCriticalSection(&_lock);
 };
 
@@ -3511,6 +6427,8 @@ YRETCODE    YDevice::HTTPRequestAsync(int channel, const string& request, HTTPRe
     string      fullrequest;
     yEnterCriticalSection(&_lock);
     _cacheStamp     = YAPI::GetTickCount(); //invalidate cache
+    _cacheLoaded    = 0;
+    _funcCacheStamp.clear();
     if(YISERR(res=HTTPRequestPrepare(request, fullrequest, errbuff)) ||
        YISERR(res=yapiHTTPRequestAsyncOutOfBand(channel, _rootdevice, fullrequest.c_str(), (int)fullrequest.length(), NULL, NULL, errbuff))){
         errmsg = (string)errbuff;
@@ -3520,6 +6438,54 @@ YRETCODE    YDevice::HTTPRequestAsync(int channel, const string& request, HTTPRe
 }
 
 
+// Invalidate the cache as a request changing the device would do
+void        YDevice::invalidateCache(void)
+{
+    yEnterCriticalSection(&_lock);
+    _cacheStamp     = YAPI::GetTickCount();
+    _cacheLoaded    = 0;
+    _funcCacheStamp.clear();
+    yLeaveCriticalSection(&_lock);
+}
+
+
+// Start a request without invalidating the cache nor waiting for the reply,
+// which is passed to the callback (the callback is not called on failure)
+YRETCODE    YDevice::HTTPRequestStart(int channel, const string& request, yapiRequestAsyncCallback callback, void *context, string& errmsg)
+{
+    char        errbuff[YOCTO_ERRMSG_LEN]="";
+    YRETCODE    res = YAPI_SUCCESS;
+    string      fullrequest;
+    yEnterCriticalSection(&_lock);
+    if(YISERR(res=HTTPRequestPrepare(request, fullrequest, errbuff)) ||
+       YISERR(res=yapiHTTPRequestAsyncOutOfBand(channel, _rootdevice, fullrequest.c_str(), (int)fullrequest.length(), callback, context, errbuff))){
+        errmsg = (string)errbuff;
+    }
+    yLeaveCriticalSection(&_lock);
+    return res;
+}
+
+
+// Same as HTTPRequestStart, but behind an HTTP hub the request is sent on a
+// connection of the device rather than on the ones of the hub, so that it
+// does not wait for the requests to the other devices of the hub
+YRETCODE    YDevice::HTTPRequestStartOwnConnection(int channel, const string& request, yapiRequestAsyncCallback callback, void *context, string& errmsg)
+{
+    char        errbuff[YOCTO_ERRMSG_LEN]="";
+    YRETCODE    res = YAPI_SUCCESS;
+    string      fullrequest;
+    yDeviceSt   infos;
+    yEnterCriticalSection(&_lock);
+    if(YISERR(res=HTTPRequestPrepare(request, fullrequest, errbuff)) ||
+       YISERR(res=yapiGetDeviceInfo(_devdescr, &infos, errbuff)) ||
+       YISERR(res=yapiHTTPRequestAsyncOutOfBand(channel, infos.serial, fullrequest.c_str(), (int)fullrequest.length(), callback, context, errbuff))){
+        errmsg = (string)errbuff;
+    }
+    yLeaveCriticalSection(&_lock);
+    return res;
+}
+
+
 YRETCODE    YDevice::HTTPRequest(int channel, const string& request, string& buffer, yapiRequestProgressCallback callback, void *context, string& errmsg)
 {
     YRETCODE    res;
@@ -3532,18 +6498,48 @@ YRETCODE    YDevice::HTTPRequest(int channel, const string& request, string& buf
             yApproximateSleep(50);
         }
     }
-    if (!locked) {
-        yEnterCriticalSection(&_lock);
+    if (!locked) {
+        yEnterCriticalSection(&_lock);
+    }
+    res = HTTPRequest_unsafe(channel, request, buffer, callback, context, errmsg);
+    yLeaveCriticalSection(&_lock);
+    return res;
+}
+
+
+// Check the HTTP header of a reply and extract its JSON body
+static YRETCODE _parseJsonReply(const string& buffer, string& json_str, string& errmsg)
+{
+    yJsonStateMachine j;
+
+    j.src = buffer.data();
+    j.end = j.src + buffer.size();
+    j.st = YJSON_HTTP_START;
+    if(yJsonParse(&j) != YJSON_PARSE_AVAIL || j.st != YJSON_HTTP_READ_CODE) {
+        errmsg = "Failed to parse HTTP header";
+        return YAPI_IO_ERROR;
+    }
+    if(string(j.token) != "200") {
+        errmsg = string("Unexpected HTTP return code: ")+j.token;
+        return YAPI_IO_ERROR;
+    }
+    if(yJsonParse(&j) != YJSON_PARSE_AVAIL || j.st != YJSON_HTTP_READ_MSG) {
+        errmsg = "Unexpected HTTP header format";
+        return YAPI_IO_ERROR;
     }
-    res = HTTPRequest_unsafe(channel, request, buffer, callback, context, errmsg);
-    yLeaveCriticalSection(&_lock);
-    return res;
+    if(yJsonParse(&j) != YJSON_PARSE_AVAIL || (j.st != YJSON_PARSE_STRUCT && j.st != YJSON_PARSE_ARRAY)) {
+        errmsg = "Unexpected JSON reply format";
+        return YAPI_IO_ERROR;
+    }
+    // we know for sure that the last character parsed was a '{' or '['
+    do j.src--; while(j.src[0] != '{' && j.src[0] != '[');
+    json_str = string(j.src, j.end - j.src);
+    return YAPI_SUCCESS;
 }
 
 
 YRETCODE YDevice::requestAPI(YJSONObject*& apires, string& errmsg)
 {
-    yJsonStateMachine j;
     string          rootdev,  buffer;
     string          request = "GET /api.json \r\n\r\n";
     string          json_str;
@@ -3580,33 +6576,11 @@ YRETCODE YDevice::requestAPI(YJSONObject*& apires, string& errmsg)
         }
     }
 
-    // Parse HTTP header
-    j.src = buffer.data();
-    j.end = j.src + buffer.size();
-    j.st = YJSON_HTTP_START;
-    if(yJsonParse(&j) != YJSON_PARSE_AVAIL || j.st != YJSON_HTTP_READ_CODE) {
-        errmsg = "Failed to parse HTTP header";
-        yLeaveCriticalSection(&_lock);
-        return YAPI_IO_ERROR;
-    }
-    if(string(j.token) != "200") {
-        errmsg = string("Unexpected HTTP return code: ")+j.token;
-        yLeaveCriticalSection(&_lock);
-        return YAPI_IO_ERROR;
-    }
-    if(yJsonParse(&j) != YJSON_PARSE_AVAIL || j.st != YJSON_HTTP_READ_MSG) {
-        errmsg = "Unexpected HTTP header format";
-        yLeaveCriticalSection(&_lock);
-        return YAPI_IO_ERROR;
-    }
-    if(yJsonParse(&j) != YJSON_PARSE_AVAIL || (j.st != YJSON_PARSE_STRUCT && j.st != YJSON_PARSE_ARRAY)) {
-        errmsg = "Unexpected JSON reply format";
+    res = _parseJsonReply(buffer, json_str, errmsg);
+    if (YISERR(res)) {
         yLeaveCriticalSection(&_lock);
-        return YAPI_IO_ERROR;
+        return (YRETCODE)res;
     }
-    // we know for sure that the last character parsed was a '{' or '['
-    do j.src--; while(j.src[0] != '{' && j.src[0] != '[');
-    json_str = string(j.src);
     try {
         apires = new YJSONObject(json_str, 0, (int)json_str.length());
         apires->parseWithRef(_cacheJson);
@@ -3624,9 +6598,84 @@ YRETCODE YDevice::requestAPI(YJSONObject*& apires, string& errmsg)
         delete _cacheJson;
     }
     _cacheJson = apires;
-    _cacheStamp = yapiGetTickCount() + YAPI::DefaultCacheValidity;
+    _cacheLoaded = yapiGetTickCount();
+    _cacheStamp = _cacheLoaded + YAPI::DefaultCacheValidity;
+    yLeaveCriticalSection(&_lock);
+
+    return YAPI_SUCCESS;
+}
+
+
+// Return the cached JSON object of one function of the device. When
+// YAPI::DifferentialRefresh is set and the cached node is older than
+// msValidity, only this function is reloaded (from /api/<funcId>.json) and
+// patched into the cached api.json tree, each function having its own
+// load time.
+YRETCODE YDevice::requestFunctionAPI(const string& funcId, int msValidity, YJSONObject*& funcres, string& errmsg)
+{
+    YJSONObject     *apires, *node = NULL;
+    YJSONContent    *previous;
+    string          buffer, json_str;
+    u64             now, loaded;
+    int             res;
+
+    yEnterCriticalSection(&_lock);
+    now = YAPI::GetTickCount();
+    if (YAPI::DifferentialRefresh && _cacheJson != NULL && _cacheJson->has(funcId)) {
+        loaded = _cacheLoaded;
+        if (_funcCacheStamp.count(funcId) && _funcCacheStamp[funcId] > loaded) {
+            loaded = _funcCacheStamp[funcId];
+        }
+        if (loaded != 0 && loaded + msValidity > now) {
+            funcres = _cacheJson->getYJSONObject(funcId);
+            yLeaveCriticalSection(&_lock);
+            return YAPI_SUCCESS;
+        }
+        res = this->HTTPRequest_unsafe(0, "GET /api/" + funcId + ".json \r\n\r\n", buffer, NULL, NULL, errmsg);
+        if (!YISERR(res)) {
+            res = _parseJsonReply(buffer, json_str, errmsg);
+        }
+        if (!YISERR(res)) {
+            node = new YJSONObject(json_str, 0, (int)json_str.length());
+            try {
+                node->parse();
+            } catch (std::exception) {
+                delete node;
+                node = NULL;
+            }
+        }
+        if (node && _cacheJson->replace(funcId, node, &previous)) {
+            // A caller may still be reading the node we just replaced: keep it
+            // until this function is refreshed again
+            if (_funcRetired[funcId]) {
+                delete _funcRetired[funcId];
+            }
+            _funcRetired[funcId] = previous;
+            _funcCacheStamp[funcId] = now;
+            funcres = node;
+            yLeaveCriticalSection(&_lock);
+            return YAPI_SUCCESS;
+        }
+        if (node) {
+            delete node;
+        }
+        // fall back to a full api.json reload
+    }
     yLeaveCriticalSection(&_lock);
 
+    res = requestAPI(apires, errmsg);
+    if (YISERR(res)) {
+        return (YRETCODE)res;
+    }
+    try {
+        funcres = apires->getYJSONObject(funcId);
+    } catch (std::exception) {
+        funcres = NULL;
+    }
+    if (funcres == NULL) {
+        errmsg = "unexpected JSON structure: missing function " + funcId;
+        return YAPI_IO_ERROR;
+    }
     return YAPI_SUCCESS;
 }
 
@@ -3638,6 +6687,16 @@ void YDevice::clearCache(bool clearSubpath)
 {
     yEnterCriticalSection(&_lock);
     _cacheStamp = 0;
+    _cacheLoaded = 0;
+    _funcCacheStamp.clear();
+    if (clearSubpath) {
+        for (map<string, YJSONContent*>::iterator it = _funcRetired.begin(); it != _funcRetired.end(); ++it) {
+            if (it->second) {
+                delete it->second;
+            }
+        }
+        _funcRetired.clear();
+    }
     if (clearSubpath)
         if (_cacheJson) {
             delete _cacheJson;
@@ -3665,7 +6724,6 @@ YRETCODE YDevice::getFunctions(vector<YFUN_DESCR> **functions, string& errmsg)
 
 
 queue<yapiGlobalEvent>  YAPI::_plug_events;
-queue<yapiDataEvent>    YAPI::_data_events;
 
 u64         YAPI::_nextEnum         = 0;
 bool        YAPI::_apiInitialized   = false;
@@ -3674,10 +6732,29 @@ std::map<int,yCalibrationHandler> YAPI::_calibHandlers;
 YHubDiscoveryCallback   YAPI::_HubDiscoveryCallback = NULL;
 
 
+// What to do with new value and timed report events when the event queue is
+// full (YAPI_DATAEVENT_QUEUE_SIZE pending events), see YAPI::EVENTQUEUE_xxx
+int YAPI::EventQueuePolicy = YAPI::EVENTQUEUE_BLOCK;
+
 // Default cache validity (in [ms]) before reloading data from device. This saves a lots of trafic.
 // Note that a value undger 2 ms makes little sense since a USB bus itself has a 2ms roundtrip period
 int YAPI::DefaultCacheValidity = 5;
 
+// When set, an expired function cache is refreshed by loading only that function
+// (/api/<funcId>.json) and patching it into the device api.json cache, instead
+// of reloading the whole api.json of the device
+bool YAPI::DifferentialRefresh = false;
+
+// When non-zero, advertised values received by notification are kept in memory
+// and an expired function cache is refreshed from them (advertisedValue, and
+// currentValue or state) as long as they are not older than this number of
+// [ms]; the other attributes are then reloaded from the device at most every
+// this number of [ms]. Notifications are only sent on change, so an older
+// value is read again from the device. A sensor falls back to the device when
+// the value would differ from the loaded one: calibration applied by the
+// library, or decimals lost in the short advertised value.
+int YAPI::NotificationCacheValidity = 0;
+
 // Switch to turn off exceptions and use return codes instead, for source-code compatibility
 // with languages without exception support like pure C
 bool YAPI::ExceptionsDisabled = false;
@@ -3723,16 +6800,24 @@ void YAPI::_yapiDeviceArrivalCallbackFwd(YDEV_DESCR devdesc)
 	yapiDataEvent      dataEv;
     yDeviceSt    infos;
     string       errmsg;
-    vector<YFunction*>::iterator it;
+    yCallbackIndex::iterator it;
+    vector<YFunction*> unresolved;
+    size_t       i;
 
     YDevice *dev = YDevice::getDevice(devdesc);
     dev->clearCache(true);
 	dataEv.type = YAPI_FUN_REFRESH;
-    for ( it=_FunctionCallbacks.begin() ; it < _FunctionCallbacks.end(); it++ ){
-        if ((*it)->functionDescriptor() == Y_FUNCTIONDESCRIPTOR_INVALID){
-			dataEv.fun = *it;
-			_data_events.push(dataEv);
-        }
+    // ask for a resolution of all functions that have not been resolved yet,
+    // posting the events once the callback lock is released
+    yapiLockFunctionCallBack(NULL);
+    for (it = _FunctionCallbacks.lower_bound(Y_FUNCTIONDESCRIPTOR_INVALID);
+         it != _FunctionCallbacks.end() && it->first == Y_FUNCTIONDESCRIPTOR_INVALID; it++) {
+        unresolved.push_back(it->second);
+    }
+    yapiUnlockFunctionCallBack(NULL);
+    for (i = 0; i < unresolved.size(); i++) {
+        dataEv.fun = unresolved[i];
+        yDataEventPush(&dataEv, false);
     }
     if (YAPI::DeviceArrivalCallback == NULL) return;
     ev.type      = YAPI_DEV_ARRIVAL;
@@ -3741,6 +6826,7 @@ void YAPI::_yapiDeviceArrivalCallbackFwd(YDEV_DESCR devdesc)
     ev.module = yFindModule(string(infos.serial)+".module");
     ev.module->setImmutableAttributes(&infos);
     _plug_events.push(ev);
+    yapiSignalEvents();
 }
 
 void YAPI::_yapiDeviceRemovalCallbackFwd(YDEV_DESCR devdesc)
@@ -3755,6 +6841,7 @@ void YAPI::_yapiDeviceRemovalCallbackFwd(YDEV_DESCR devdesc)
     ev.module = yFindModule(string(infos.serial)+".module");
     //the function is allready thread safe (use yapiLockDeviceCallaback)
     _plug_events.push(ev);
+    yapiSignalEvents();
 }
 
 void YAPI::_yapiDeviceChangeCallbackFwd(YDEV_DESCR devdesc)
@@ -3770,12 +6857,27 @@ void YAPI::_yapiDeviceChangeCallbackFwd(YDEV_DESCR devdesc)
     ev.module->setImmutableAttributes(&infos);
     //the function is allready thread safe (use yapiLockDeviceCallaback)
     _plug_events.push(ev);
+    yapiSignalEvents();
 }
 
 void YAPI::_yapiFunctionUpdateCallbackFwd(YAPI_FUNCTION fundesc,const char *value)
 {
 	yapiDataEvent    ev;
-
+    yCallbackIndex::iterator it;
+    vector<YFunction*> targets;
+    size_t           i;
+
+    if (YAPI::NotificationCacheValidity > 0) {
+        yEnterCriticalSection(&_pushedValues_CS);
+        if (value == NULL) {
+            _pushedValues.erase(fundesc);
+        } else {
+            yPushedValue &pushed = _pushedValues[fundesc];
+            pushed.value = (string)value;
+            pushed.stamp = yapiGetTickCount();
+        }
+        yLeaveCriticalSection(&_pushedValues_CS);
+    }
     //the function is allready thread safe (use yapiLockFunctionCallaback)
     if(value==NULL){
         ev.type      = YAPI_FUN_UPDATE;
@@ -3783,10 +6885,21 @@ void YAPI::_yapiFunctionUpdateCallbackFwd(YAPI_FUNCTION fundesc,const char *valu
         ev.type      = YAPI_FUN_VALUE;
         memcpy(ev.value,value,YOCTO_PUBVAL_LEN);
     }
-    for (unsigned i=0 ; i< _FunctionCallbacks.size();i++) {
-        if (_FunctionCallbacks[i]->get_functionDescriptor() == fundesc) {
-            ev.fun = _FunctionCallbacks[i];
-            _data_events.push(ev);
+    for (it = _FunctionCallbacks.lower_bound(fundesc); it != _FunctionCallbacks.end() && it->first == fundesc; it++) {
+        ev.fun = it->second;
+        if (!yDataEventTryPush(&ev)) {
+            break;
+        }
+    }
+    if (it != _FunctionCallbacks.end() && it->first == fundesc) {
+        // the queue is full: the index may change while the callback lock
+        // is released to wait for room, so work on a copy of the targets
+        for (; it != _FunctionCallbacks.end() && it->first == fundesc; it++) {
+            targets.push_back(it->second);
+        }
+        for (i = 0; i < targets.size(); i++) {
+            ev.fun = targets[i];
+            yDataEventPush(&ev, true);
         }
     }
 }
@@ -3794,18 +6907,43 @@ void YAPI::_yapiFunctionUpdateCallbackFwd(YAPI_FUNCTION fundesc,const char *valu
 void YAPI::_yapiFunctionTimedReportCallbackFwd(YAPI_FUNCTION fundesc,double timestamp, const u8 *bytes, u32 len)
 {
 	yapiDataEvent    ev;
+    yCallbackIndex::iterator it;
+    vector<YSensor*> targets;
+    size_t           i;
 
-    for (unsigned i=0 ; i< _TimedReportCallbackList.size();i++) {
-        if (_TimedReportCallbackList[i]->get_functionDescriptor() == fundesc) {
-			u32 p = 0;
-			ev.type = YAPI_FUN_TIMEDREPORT;
-            ev.sensor = (YSensor*)_TimedReportCallbackList[i];
-            ev.timestamp =  timestamp;
-			ev.len = len;
-            while(p < len) {
-				ev.report[p++] = *bytes++;
-            }
-            _data_events.push(ev);
+    it = _TimedReportCallbackList.lower_bound(fundesc);
+    if (it == _TimedReportCallbackList.end() || it->first != fundesc) {
+        return;
+    }
+    if (len > sizeof(ev.report) / sizeof(ev.report[0])) {
+        // decoding part of the report would give a wrong value: drop it
+        yAtomicIncrement32(&_evq_dropped);
+        if (YAPI::LogFunction) {
+            YAPI::LogFunction(YapiWrapper::ysprintf("Dropped a timed report of %u bytes (max %u)\n",
+                              len, (u32)(sizeof(ev.report) / sizeof(ev.report[0]))));
+        }
+        return;
+    }
+    ev.type = YAPI_FUN_TIMEDREPORT;
+    ev.timestamp =  timestamp;
+    ev.len = (int)len;
+    for (i = 0; i < len; i++) {
+        ev.report[i] = bytes[i];
+    }
+    for (; it != _TimedReportCallbackList.end() && it->first == fundesc; it++) {
+        ev.sensor = (YSensor*)it->second;
+        if (!yDataEventTryPush(&ev)) {
+            break;
+        }
+    }
+    if (it != _TimedReportCallbackList.end() && it->first == fundesc) {
+        // same as for values: wait for room on a copy of the targets
+        for (; it != _TimedReportCallbackList.end() && it->first == fundesc; it++) {
+            targets.push_back((YSensor*)it->second);
+        }
+        for (i = 0; i < targets.size(); i++) {
+            ev.sensor = targets[i];
+            yDataEventPush(&ev, true);
         }
     }
 }
@@ -3819,6 +6957,7 @@ void YAPI::_yapiHubDiscoveryCallbackFwd(const char *serial, const char *url)
 	strcpy(ev.serial, serial);
 	strcpy(ev.url, url);
 	_plug_events.push(ev);
+	yapiSignalEvents();
 }
 
 
@@ -3886,12 +7025,14 @@ yCalibrationHandler YAPI::_getCalibrationHandler(int calibType)
 }
 
 
-// Parse an array of u16 encoded in a base64-like string with memory-based compresssion
-vector<int> YAPI::_decodeWords(string sdat)
+// Parse an array of u16 encoded in a base64-like string with memory-based compresssion,
+// into a caller-provided buffer. Returns the number of words stored in udat, which
+// never exceeds maxwords (a buffer of len words is always large enough).
+int YAPI::_decodeWords(const char *sdat, int len, int *udat, int maxwords)
 {
-    vector<int>     udat;
+    int     p = 0, n = 0;
 
-    for(unsigned p = 0; p < sdat.size();) {
+    while (p < len && n < maxwords) {
         unsigned val;
         unsigned c = sdat[p++];
         if(c == '*') {
@@ -3901,13 +7042,14 @@ vector<int> YAPI::_decodeWords(string sdat)
         } else if(c == 'Y') {
             val = 0x7fff;
         } else if(c >= 'a') {
-            int srcpos = (int)udat.size()-1-(c-'a');
-            if(srcpos < 0)
+            // 8-bit characters would point past the last word: treat them as invalid
+            int srcpos = n-1-(int)(c-'a');
+            if(srcpos < 0 || srcpos >= n)
                 val = 0;
             else
                 val = udat[srcpos];
         } else {
-            if(p+2 > sdat.size()) return udat;
+            if(p+2 > len) return n;
             val = (c - '0');
             c = sdat[p++];
             val += (c - '0') << 5;
@@ -3915,34 +7057,49 @@ vector<int> YAPI::_decodeWords(string sdat)
             if(c == 'z') c = '\\';
             val += (c - '0') << 10;
         }
-        udat.push_back((int)val);
+        udat[n++] = (int)val;
+    }
+    return n;
+}
+
+vector<int> YAPI::_decodeWords(string sdat)
+{
+    int             len = (int)sdat.size();
+    vector<int>     udat(len);
+
+    if (len > 0) {
+        udat.resize(YAPI::_decodeWords(sdat.data(), len, &udat[0], len));
     }
     return udat;
 }
 
-// Parse a list of floats and return them as an array of fixed-point 1/1000 numbers
-vector<int> YAPI::_decodeFloats(string sdat)
+// Parse a list of floats into a caller-provided buffer, as fixed-point 1/1000 numbers.
+// Returns the number of values stored in idat, which never exceeds maxvals (a buffer
+// of (len+1)/2 values is always large enough).
+int YAPI::_decodeFloats(const char *sdat, int len, int *idat, int maxvals)
 {
-    vector<int> idat;
+    const char  *ptr = sdat;
+    const char  *end = sdat + len;
+    int         n = 0;
 
-    for(unsigned p = 0; p < sdat.size();) {
+    while (ptr < end && n < maxvals) {
         int val = 0;
         int sign = 1;
         int dec = 0;
         int decInc = 0;
-        unsigned c = sdat[p++];
+        unsigned c = *ptr++;
         while(c != '-' && (c < '0' || c > '9')) {
-            if(p >= sdat.size()) {
-                return idat;
+            if(ptr >= end) {
+                return n;
             }
-            c = sdat[p++];
+            c = *ptr++;
         }
         if(c == '-') {
-            if(p >= sdat.size()) {
-                return idat;
+            if(ptr >= end) {
+                return n;
             }
             sign = -sign;
-            c = sdat[p++];
+            c = *ptr++;
         }
         while((c >= '0' && c <= '9') || c == '.') {
             if(c == '.') {
@@ -3951,8 +7108,8 @@ vector<int> YAPI::_decodeFloats(string sdat)
                 val = val * 10 + (c - '0');
                 dec += decInc;
             }
-            if(p < sdat.size()) {
-                c = sdat[p++];
+            if(ptr < end) {
+                c = *ptr++;
             } else {
                 c = 0;
             }
@@ -3962,7 +7119,19 @@ vector<int> YAPI::_decodeFloats(string sdat)
             else if(dec == 1) val *= 100;
             else val *= 10;
         }
-        idat.push_back(sign*val);
+        idat[n++] = sign*val;
+    }
+    return n;
+}
+
+// Parse a list of floats and return them as an array of fixed-point 1/1000 numbers
+vector<int> YAPI::_decodeFloats(string sdat)
+{
+    int             len = (int)sdat.size();
+    vector<int>     idat((len + 1) / 2);
+
+    if (len > 0) {
+        idat.resize(YAPI::_decodeFloats(sdat.data(), len, &idat[0], (int)idat.size()));
     }
     return idat;
 }
@@ -4078,7 +7247,18 @@ YRETCODE YAPI::InitAPI(int mode, string& errmsg)
 
     yInitializeCriticalSection(&_updateDeviceList_CS);
     yInitializeCriticalSection(&_handleEvent_CS);
+    yInitializeCriticalSection(&_workers_CS);
     yInitializeCriticalSection(&_global_cs);
+    yInitializeCriticalSection(&_pushedValues_CS);
+    yInitializeCriticalSection(&_dlcache_CS);
+    yInitializeCriticalSection(&_async_cs);
+    yCreateEvent(&_async_event);
+    _async_active = true;
+#ifndef YATOMIC_SUPPORTED
+    yInitializeCriticalSection(&_evq_cs);
+#endif
+    yInitializeCriticalSection(&_evq_overflow_cs);
+    yDataEventQueueReset();
     for(i = 0; i <= 20; i++) {
         YAPI::RegisterCalibrationHandler(i, YAPI::LinearCalibrationHandler);
     }
@@ -4099,19 +7279,39 @@ YRETCODE YAPI::InitAPI(int mode, string& errmsg)
 void YAPI::FreeAPI(void)
 {
     if(YAPI::_apiInitialized) {
+        // the workers may still run user callbacks, which need the API
+        yEnterCriticalSection(&_handleEvent_CS);
+        if (_nbWorkers > 0) {
+            yStopCallbackWorkers();
+        }
+        yLeaveCriticalSection(&_handleEvent_CS);
         yapiFreeAPI();
         YAPI::_apiInitialized = false;
+        yDeleteCriticalSection(&_workers_CS);
         yDeleteCriticalSection(&_updateDeviceList_CS);
         yDeleteCriticalSection(&_handleEvent_CS);
         yDeleteCriticalSection(&_global_cs);
+        yDeleteCriticalSection(&_pushedValues_CS);
+        _pushedValues.clear();
+        yDeleteCriticalSection(&_dlcache_CS);
+        yDlCacheFree();
+        _dlcache_dir = "";
+        yAsyncFree();
         YDevice::ClearCache();
         YFunction::_ClearCache();
+        _async_active = false;
+        yDeleteCriticalSection(&_async_cs);
+        yCloseEvent(&_async_event);
+        _FunctionCallbacks.clear();
+        _TimedReportCallbackList.clear();
         while (!_plug_events.empty()) {
             _plug_events.pop();
         }
-        while (!_data_events.empty()) {
-            _data_events.pop();
-        }
+        yDataEventQueueReset();
+#ifndef YATOMIC_SUPPORTED
+        yDeleteCriticalSection(&_evq_cs);
+#endif
+        yDeleteCriticalSection(&_evq_overflow_cs);
         _calibHandlers.clear();
     }
 }
@@ -4299,6 +7499,37 @@ YRETCODE YAPI::TestHub(const string& url, int mstimeout, string& errmsg)
 }
 
 
+/**
+ * Drives all network hubs from a fixed pool of event loops instead of
+ * using one helper thread per hub. This is useful for applications that
+ * monitor several hundreds of hubs. This method must be called before
+ * registering any network hub, and is only supported on Linux.
+ *
+ * @param nbLoops : the number of event loops to use, or 0 to use one
+ *         helper thread per hub (default behavior).
+ * @param pinLoops : true to pin each event loop to its own CPU core.
+ * @param errmsg : a string passed by reference to receive any error message.
+ *
+ * @return YAPI_SUCCESS when the call succeeds.
+ *
+ * On failure returns a negative error code.
+ */
+YRETCODE YAPI::SetNetworkReactor(int nbLoops, bool pinLoops, string& errmsg)
+{
+    char        errbuf[YOCTO_ERRMSG_LEN];
+    YRETCODE    res;
+    if (!YAPI::_apiInitialized) {
+        res = YAPI::InitAPI(0, errmsg);
+        if (YISERR(res)) return res;
+    }
+    res = yapiSetNetworkReactor(nbLoops, pinLoops ? 1 : 0, errbuf);
+    if (YISERR(res)) {
+        errmsg = errbuf;
+    }
+    return res;
+}
+
+
 /**
  * Setup the Yoctopuce library to use modules connected on a given machine. The
  * parameter will determine how the API will work. Use the following values:
@@ -4494,52 +7725,191 @@ YRETCODE YAPI::UpdateDeviceList(string& errmsg)
  */
 YRETCODE YAPI::HandleEvents(string& errmsg)
 {
-    YRETCODE    res;
+    YRETCODE        res;
+    yapiDataEvent   batch[YAPI_DATAEVENT_BATCH];
+    std::deque<yapiDataEvent> overflow;
+    int             count, i;
 
+    if (yIsCallbackWorker()) {
+        // called from a callback (e.g. by ySleep): only handle the communication,
+        // as the events are being dispatched by the thread feeding this worker
+        return YapiWrapper::handleEvents(errmsg);
+    }
     // prevent reentrance into this function
     yEnterCriticalSection(&_handleEvent_CS);
+    _evq_consumer = yThreadSelf();
+    _evq_consuming = 1;
      // handle other notification
     res = YapiWrapper::handleEvents(errmsg);
     if(YISERR(res)) {
+        _evq_consuming = 0;
         yLeaveCriticalSection(&_handleEvent_CS);
         return res;
     }
-    // pop data event and call user callback
-    while (!_data_events.empty()) {
-        yapiDataEvent   ev;
-		YSensor			*sensor;
-		vector<int> report;
-
-		yapiLockFunctionCallBack(NULL);
-        if (_data_events.empty()) {
-            yapiUnlockFunctionCallBack(NULL);
-            break;
+    // pop data events by batch and call user callbacks
+    do {
+        count = 0;
+        while (count < YAPI_DATAEVENT_BATCH && yDataEventPop(&batch[count])) {
+            count++;
         }
-        ev = _data_events.front();
-        _data_events.pop();
-        yapiUnlockFunctionCallBack(NULL);
-        switch (ev.type) {
-            case YAPI_FUN_VALUE:
-                ev.fun->_invokeValueCallback((string)ev.value);
-                break;
-            case YAPI_FUN_TIMEDREPORT:
-                if(ev.report[0] <= 2) {
-                    sensor = ev.sensor;
-                    report.assign(ev.report, ev.report + ev.len);
-                    sensor->_invokeTimedReportCallback(sensor->_decodeTimedReport(ev.timestamp, report));
-                }
-                break;
-            case YAPI_FUN_REFRESH:
-                ev.fun->isOnline();
-                break;
-            default:
-                break;
+        for (i = 0; i < count; i++) {
+            if (_nbWorkers > 0) {
+                yRouteDataEvent(&batch[i]);
+            } else {
+                yDispatchDataEvent(&batch[i]);
+            }
+        }
+        if (count > 0) {
+            yAtomicAdd32(&_evq_handled, (u32)count);
+        }
+    } while (count == YAPI_DATAEVENT_BATCH);
+    // then the events which did not fit in the ring
+    if (_evq_overflowCount > 0) {
+        yEnterCriticalSection(&_evq_overflow_cs);
+        overflow.swap(_evq_overflow);
+        _evq_overflowCount = 0;
+        yLeaveCriticalSection(&_evq_overflow_cs);
+        for (i = 0; i < (int)overflow.size(); i++) {
+            if (_nbWorkers > 0) {
+                yRouteDataEvent(&overflow[i]);
+            } else {
+                yDispatchDataEvent(&overflow[i]);
+            }
         }
+        yAtomicAdd32(&_evq_handled, (u32)overflow.size());
     }
+    // resume the coroutines awaiting a completed request
+    yAsyncResumeReady();
+    _evq_consuming = 0;
     yLeaveCriticalSection(&_handleEvent_CS);
     return YAPI_SUCCESS;
 }
 
+YRETCODE YAPI::SetDataLoggerCache(const string& directory, string& errmsg)
+{
+    YRETCODE res;
+    string   dir, probe;
+    FILE     *fp;
+
+    if (!YAPI::_apiInitialized) {
+        res = YAPI::InitAPI(0, errmsg);
+        if (YISERR(res)) return res;
+    }
+    // accept both separators at the end of the path
+    dir = directory;
+    while (dir.size() > 1 && (dir[dir.size() - 1] == '/' || dir[dir.size() - 1] == '\\')) {
+        dir.resize(dir.size() - 1);
+    }
+    if (dir != "") {
+#ifdef WINDOWS_API
+        DWORD attr = GetFileAttributesA(dir.c_str());
+        if (attr == INVALID_FILE_ATTRIBUTES) {
+            errmsg = "Directory " + dir + " does not exist";
+            return YAPI_INVALID_ARGUMENT;
+        }
+        if ((attr & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+#else
+        struct stat st;
+        if (stat(dir.c_str(), &st) != 0) {
+            errmsg = "Directory " + dir + " does not exist";
+            return YAPI_INVALID_ARGUMENT;
+        }
+        if (!S_ISDIR(st.st_mode)) {
+#endif
+            errmsg = dir + " is not a directory";
+            return YAPI_INVALID_ARGUMENT;
+        }
+        // the cache files are created on demand: check that it will be possible
+        probe = dir + "/.ydlcache-probe";
+        fp = fopen(probe.c_str(), "wb");
+        if (fp == NULL) {
+            errmsg = "Directory " + dir + " is not writable";
+            return YAPI_IO_ERROR;
+        }
+        fclose(fp);
+        remove(probe.c_str());
+    }
+    yEnterCriticalSection(&_dlcache_CS);
+    yDlCacheFree();
+    _dlcache_dir = dir;
+    yLeaveCriticalSection(&_dlcache_CS);
+    return YAPI_SUCCESS;
+}
+
+YRETCODE YAPI::SetCallbackWorkers(int nbWorkers, string& errmsg)
+{
+    YRETCODE res = YAPI_SUCCESS;
+
+    if (nbWorkers < 0) {
+        errmsg = "Invalid number of callback workers";
+        return YAPI_INVALID_ARGUMENT;
+    }
+    if (!YAPI::_apiInitialized) {
+        res = YAPI::InitAPI(0, errmsg);
+        if (YISERR(res)) return res;
+    }
+    if (yIsCallbackWorker()) {
+        errmsg = "Callback workers cannot be changed from a callback";
+        return YAPI_INVALID_ARGUMENT;
+    }
+    yEnterCriticalSection(&_handleEvent_CS);
+    if (nbWorkers != _nbWorkers) {
+        if (_nbWorkers > 0) {
+            yStopCallbackWorkers();
+        }
+        if (nbWorkers > 0) {
+            res = yStartCallbackWorkers(nbWorkers, errmsg);
+        }
+    }
+    yLeaveCriticalSection(&_handleEvent_CS);
+    return res;
+}
+
+int YAPI::GetCallbackWorkerStats(vector<yapiWorkerStats>& stats)
+{
+    yapiWorkerStats st;
+    int             i;
+
+    stats.clear();
+    if (!YAPI::_apiInitialized) {
+        return 0;
+    }
+    // the pool is unpublished under _workers_CS before being freed, and a
+    // callback may call this while FreeAPI holds _handleEvent_CS to stop it
+    yEnterCriticalSection(&_workers_CS);
+    for (i = 0; i < _nbWorkers; i++) {
+        yCallbackWorker *worker = &_workers[i];
+        yEnterCriticalSection(&worker->access);
+        st.pending = (u32)worker->queue.size();
+        st.processed = worker->processed;
+        st.avgLatency = (worker->processed ? (u32)(worker->totalLatency / worker->processed) : 0);
+        st.maxLatency = worker->maxLatency;
+        st.stalls = worker->stalls;
+        yLeaveCriticalSection(&worker->access);
+        stats.push_back(st);
+    }
+    yLeaveCriticalSection(&_workers_CS);
+    return (int)stats.size();
+}
+
+u32 YAPI::GetEventQueueDepth(void)
+{
+    u32 depth = _evq_wrpos - _evq_rdpos;
+
+    // positions are read separately and may be momentarily inconsistent
+    return ((s32)depth < 0 ? 0 : depth) + _evq_overflowCount;
+}
+
+u32 YAPI::GetEventQueuePeak(void)
+{
+    return _evq_peak;
+}
+
+u32 YAPI::GetDroppedEventCount(void)
+{
+    return _evq_dropped;
+}
+
 /**
  * Pauses the execution flow for a specified duration.
  * This function implements a passive waiting loop, meaning that it does not
@@ -4561,27 +7931,75 @@ YRETCODE YAPI::HandleEvents(string& errmsg)
  */
 YRETCODE YAPI::Sleep(unsigned ms_duration, string& errmsg)
 {
-    char errbuf[YOCTO_ERRMSG_LEN];
     YRETCODE res;
     u64 waituntil = YAPI::GetTickCount() + ms_duration;
+    u64 now;
     do{
-       res = YAPI::HandleEvents(errmsg);
+        now = YAPI::GetTickCount();
+        // plug events are left for yUpdateDeviceList()
+        res = YAPI::_waitForEvents(waituntil > now ? (unsigned)(waituntil - now) : 0, false, errmsg);
         if(YISERR(res)) {
-            errmsg = errbuf;
             return res;
         }
-        if(waituntil>YAPI::GetTickCount()){
-            res = yapiSleep(2, errbuf);
-            if(YISERR(res)) {
-                errmsg = errbuf;
-                return res;
-            }
-        }
     }while(waituntil>YAPI::GetTickCount());
 
     return YAPI_SUCCESS;
 }
 
+YRETCODE YAPI::WaitForEvents(unsigned ms_timeout, string& errmsg)
+{
+    return YAPI::_waitForEvents(ms_timeout, true, errmsg);
+}
+
+YRETCODE YAPI::_waitForEvents(unsigned ms_timeout, bool stopOnPlugEvents, string& errmsg)
+{
+    char errbuf[YOCTO_ERRMSG_LEN];
+    YRETCODE res;
+    u64 deadline = YAPI::GetTickCount() + ms_timeout;
+    u64 now;
+    u32 handled;
+    int wait;
+    bool pending;
+
+    for (;;) {
+        handled = _evq_handled;
+        res = YAPI::HandleEvents(errmsg);
+        if (YISERR(res)) {
+            return res;
+        }
+        if (handled != _evq_handled) {
+            return YAPI_SUCCESS;
+        }
+        if (stopOnPlugEvents) {
+            yapiLockDeviceCallBack(NULL);
+            pending = !_plug_events.empty();
+            yapiUnlockDeviceCallBack(NULL);
+            if (pending) {
+                return YAPI_SUCCESS;
+            }
+        }
+        now = YAPI::GetTickCount();
+        if (now >= deadline) {
+            return YAPI_SUCCESS;
+        }
+        // USB devices still need to be polled from time to time
+        wait = (int)(deadline - now < YAPI_WAIT_POLL_PERIOD ? deadline - now : YAPI_WAIT_POLL_PERIOD);
+        // the wakeup signal can only be consumed by one thread: other threads,
+        // such as callbacks calling ySleep(), fall back to short sleeps
+        if (yAtomicCompareExchange32(&_evq_waiting, 0, 1)) {
+            res = yapiWaitForEvents(wait, errbuf);
+            _evq_waiting = 0;
+        } else {
+            yApproximateSleep(wait < 2 ? wait : 2);
+            res = YAPI_SUCCESS;
+        }
+        if (YISERR(res)) {
+            errmsg = errbuf;
+            return res;
+        }
+    }
+}
+
 /**
  * Returns the current value of a monotone millisecond-based time counter.
  * This counter can be used to compute delays in relation with
@@ -4827,6 +8245,7 @@ YRETCODE YapiWrapper::handleEvents(string& errmsg)
         errmsg = errbuf;
         return res;
     }
+    yAsyncFlush();
     return YAPI_SUCCESS;
 }
 
@@ -6833,6 +10252,51 @@ YSensor::~YSensor()
 }
 
 
+// Parse the advertised value of a sensor. The device computes it like the
+// currentValue attribute, but writes it on at most YOCTO_PUBVAL_SIZE chars:
+// a value filling them may have lost decimals below the sensor resolution,
+// in which case it is not used.
+static bool yParseAdvertisedMeasure(const string& pushed, double iresol, double& value)
+{
+    const char  *dot;
+    char        *endptr;
+    int         decimals, needed;
+    double      scale;
+
+    value = strtod(pushed.c_str(), &endptr);
+    if (endptr == pushed.c_str() || *endptr != 0) {
+        return false;
+    }
+    if (pushed.length() >= YOCTO_PUBVAL_SIZE) {
+        dot = strchr(pushed.c_str(), '.');
+        decimals = (dot ? (int)strlen(dot + 1) : 0);
+        for (needed = 0, scale = 1.0; scale < iresol && needed < 9; needed++) {
+            scale *= 10.0;
+        }
+        if (decimals < needed) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The advertised value is the one computed by the device, which is also
+// what get_currentValue() returns unless the calibration is applied here
+bool YSensor::_applyPushedValue(const string& pushed)
+{
+    double value;
+
+    if ((_caltyp > 0 && _calhdl != NULL) || !yParseAdvertisedMeasure(pushed, _iresol, value)) {
+        return false;
+    }
+    _currentValue = value;
+    if (_caltyp == 0) {
+        _currentRawValue = value;
+    }
+    return YFunction::_applyPushedValue(pushed);
+}
+
+
 //--- (generated code: YSensor implementation)
 // static attributes
 const string YSensor::UNIT_INVALID = YAPI_INVALID_STRING;
@@ -8120,6 +11584,8 @@ int YOldDataStream::loadStream(void)
     vector<double>      dat;
 
     _values.clear();
+    _colCount = 0;
+    _colRows = 0;
     if((res = _dataLogger->getData(_runNo, _timeStamp, buffer, j)) != YAPI_SUCCESS) {
         return res;
     }
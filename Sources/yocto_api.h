@@ -50,6 +50,16 @@
 #include <cfloat>
 #include <cmath>
 
+// Awaitable requests for C++20 coroutines, when the compiler supports them.
+// Define YAPI_NO_COROUTINES to leave them out.
+#if !defined(YAPI_NO_COROUTINES) && defined(__cpp_impl_coroutine)
+#if __cpp_impl_coroutine >= 201902L && __has_include(<coroutine>)
+#define YAPI_HAS_COROUTINES
+#include <coroutine>
+#include <functional>
+#endif
+#endif
+
 #if defined(WINDOWS_API)
 #if defined(GENERATE_DLL) || defined(YOCTOPUCEDLL_EXPORTS)
 #define YOCTO_CLASS_EXPORT __declspec(dllexport)
@@ -280,6 +290,44 @@ typedef struct{
 	};
 }yapiDataEvent;
 
+// Capacity of the data event queue (must be a power of two)
+#ifndef YAPI_DATAEVENT_QUEUE_SIZE
+#define YAPI_DATAEVENT_QUEUE_SIZE   4096
+#endif
+// Maximal time a hub thread waits for room in EVENTQUEUE_BLOCK mode, in [ms]
+#define YAPI_DATAEVENT_BLOCK_TIMEOUT  1000
+// Number of events that can wait for each callback worker before
+// yHandleEvents() waits for the worker to catch up
+#ifndef YAPI_CALLBACK_WORKER_QUEUE
+#define YAPI_CALLBACK_WORKER_QUEUE  256
+#endif
+// Maximal time yWaitForEvents() blocks without polling the USB devices, in [ms]
+#ifndef YAPI_WAIT_POLL_PERIOD
+#define YAPI_WAIT_POLL_PERIOD       100
+#endif
+// Maximal length of the query string of one batched write request, in bytes
+#ifndef YAPI_BATCH_MAX_QUERY
+#define YAPI_BATCH_MAX_QUERY        512
+#endif
+
+// Statistics of a callback worker thread (see YAPI::SetCallbackWorkers)
+typedef struct{
+    u32     pending;        // events waiting for this worker
+    u32     processed;      // events handled since the worker was started
+    u32     avgLatency;     // average delay between routing and end of the callback, in [ms]
+    u32     maxLatency;     // maximal delay between routing and end of the callback, in [ms]
+    u32     stalls;         // number of times yHandleEvents() had to wait for room in its queue
+}yapiWorkerStats;
+
+// Attribute change deferred by YFunction::beginBatch, and its outcome once
+// sent by YFunction::commitBatch
+typedef struct{
+    string      attrName;
+    string      attrValue;
+    YRETCODE    errorType;      // result of the request that carried the change
+    string      errorMessage;
+}yapiAttrWrite;
+
 
 // internal helper function
 int _ystrpos(const string& haystack, const string& needle);
@@ -308,16 +356,34 @@ typedef enum {
 
 class YJSONObject;
 
+// Immutable copy of a JSON document, shared by all the nodes parsed from it
+class YJSONBuffer
+{
+        yCRITICAL_SECTION _lock;    // protects refcount and lazy node creation
+        int _refcount;
+        ~YJSONBuffer();
+    public:
+        const string data;
+        YJSONBuffer(const string& src);
+        YJSONBuffer* addRef();
+        void release();
+        void lock();
+        void unlock();
+};
+
 class YJSONContent
 {
     public:
-        string _data;
+        YJSONBuffer *_buffer;
         int _data_start;
         int _data_len;
         int _data_boundary;
         YJSONType _type;
         static YJSONContent* ParseJson(const string& data, int start, int stop);
+        static YJSONContent* Create(YJSONBuffer *buffer, int start, int stop);
+        static YJSONContent* Copy(YJSONContent *ref);
         YJSONContent(const string& data, int start, int stop, YJSONType type);
+        YJSONContent(YJSONBuffer *buffer, int start, int stop, YJSONType type);
         YJSONContent(YJSONContent *ref);
         YJSONContent(YJSONType type);
         virtual ~YJSONContent();
@@ -334,6 +400,7 @@ class YJSONArray : public YJSONContent
         vector<YJSONContent*> _arrayValue;
     public:
         YJSONArray(const string& data, int start, int stop);
+        YJSONArray(YJSONBuffer *buffer, int start, int stop);
         YJSONArray(const string& data);
         YJSONArray(YJSONArray *ref);
         YJSONArray();
@@ -356,6 +423,7 @@ class YJSONString : public YJSONContent
         string _stringValue;
     public:
         YJSONString(const string& data, int start, int stop);
+        YJSONString(YJSONBuffer *buffer, int start, int stop);
         YJSONString(YJSONString *ref);
         YJSONString();
 
@@ -376,6 +444,7 @@ class YJSONNumber : public YJSONContent
         bool _isFloat;
     public:
         YJSONNumber(const string& data, int start, int stop);
+        YJSONNumber(YJSONBuffer *buffer, int start, int stop);
         YJSONNumber(YJSONNumber *ref);
 
         virtual ~YJSONNumber()    { }
@@ -389,14 +458,31 @@ class YJSONNumber : public YJSONContent
 };
 
 
+// Members of an object are located when the object is parsed, but their
+// values are only turned into nodes on first access
+typedef struct {
+    string          key;
+    int             value_start;    // offset of the value in the shared buffer
+    YJSONContent    *node;          // NULL until first access
+} YJSONMember;
+
+// objects with more members than this get a hashed key index
+#define YJSON_INDEX_THRESHOLD 8
+
 class YJSONObject : public YJSONContent
 {
-    map<string, YJSONContent*> _parsed;
-    vector<string> _keys;
+    vector<YJSONMember> _members;
+    vector<int> _index;
+    void addMember(const string& key, int value_start, YJSONContent *node);
+    void buildIndex();
+    int findMember(const string& key);
+    YJSONContent* getMember(int idx);
+    YJSONContent* getExisting(const string& key);
     void convert(YJSONObject* reference, YJSONArray* newArray);
 public:
     YJSONObject(const string& data);
     YJSONObject(const string& data, int start, int len);
+    YJSONObject(YJSONBuffer *buffer, int start, int len);
     YJSONObject(YJSONObject *ref);
     virtual ~YJSONObject();
 
@@ -412,6 +498,7 @@ public:
     YJSONContent* get(const string& key);
     long getLong(const string& key);
     double getDouble(const string& key);
+    bool replace(const string& key, YJSONContent *node, YJSONContent **previous);
     virtual string toJSON();
     virtual string toString();
     void parseWithRef(YJSONObject* reference);
@@ -429,11 +516,11 @@ public:
 class YOCTO_CLASS_EXPORT YAPI {
 private:
     static  queue<yapiGlobalEvent>  _plug_events;
-    static  queue<yapiDataEvent>    _data_events;
     static  YHubDiscoveryCallback   _HubDiscoveryCallback;
     static  u64                 _nextEnum;
 
     static  map<int,yCalibrationHandler> _calibHandlers;
+    static  YRETCODE    _waitForEvents(unsigned ms_timeout, bool stopOnPlugEvents, string& errmsg);
     static  void        _yapiLogFunctionFwd(const char *log, u32 loglen);
     static  void        _yapiDeviceArrivalCallbackFwd(YDEV_DESCR devdesc);
     static  void        _yapiDeviceRemovalCallbackFwd(YDEV_DESCR devdesc);
@@ -448,13 +535,18 @@ public:
     static  s16         _doubleToDecimal(double val);
     static  yCalibrationHandler _getCalibrationHandler(int calibType);
     static  vector<int> _decodeWords(string s);
+    static  int         _decodeWords(const char *sdat, int len, int *udat, int maxwords);
     static  vector<int> _decodeFloats(string sdat);
+    static  int         _decodeFloats(const char *sdat, int len, int *idat, int maxvals);
     static  string      _bin2HexStr(const string& data);
     static  string      _hexStr2Bin(const string& str);
     static  string      _flattenJsonStruct(string jsonbuffer);
     static  string      _checkFirmware(const string& serial, const string& rev, const string& path);
 
     static  int         DefaultCacheValidity;
+    static  bool        DifferentialRefresh;
+    static  int         NotificationCacheValidity;
+    static  int         EventQueuePolicy;
     static  bool        ExceptionsDisabled;
     static  const string      INVALID_STRING;
     static  const int         INVALID_INT = YAPI_INVALID_INT;
@@ -476,6 +568,11 @@ public:
     static const u32 RESEND_MISSING_PKT = 4;
     static const u32 DETECT_ALL  = (Y_DETECT_USB | Y_DETECT_NET);
 
+    // what to do with a new data event when the event queue is full
+    static const int EVENTQUEUE_BLOCK       = 0;   // wait for room (bounded wait)
+    static const int EVENTQUEUE_DROP_OLDEST = 1;   // discard the oldest pending event
+    static const int EVENTQUEUE_DROP_NEWEST = 2;   // discard the new event
+
 //--- (generated code: YFunction return codes)
     static const int SUCCESS               = 0;       // everything worked all right
     static const int NOT_INITIALIZED       = -1;      // call yInitAPI() first !
@@ -642,6 +739,23 @@ public:
      * On failure returns a negative error code.
      */
     static  YRETCODE    TestHub(const string& url, int mstimeout, string& errmsg);
+
+    /**
+     * Drives all network hubs from a fixed pool of event loops instead of
+     * using one helper thread per hub. This is useful for applications that
+     * monitor several hundreds of hubs. This method must be called before
+     * registering any network hub, and is only supported on Linux.
+     *
+     * @param nbLoops : the number of event loops to use, or 0 to use one
+     *         helper thread per hub (default behavior).
+     * @param pinLoops : true to pin each event loop to its own CPU core.
+     * @param errmsg : a string passed by reference to receive any error message.
+     *
+     * @return YAPI_SUCCESS when the call succeeds.
+     *
+     * On failure returns a negative error code.
+     */
+    static  YRETCODE    SetNetworkReactor(int nbLoops, bool pinLoops, string& errmsg);
     /**
      * Setup the Yoctopuce library to use modules connected on a given machine. The
      * parameter will determine how the API will work. Use the following values:
@@ -748,6 +862,78 @@ public:
      * On failure, throws an exception or returns a negative error code.
      */
     static  YRETCODE    HandleEvents(string& errmsg);
+    /**
+     * Returns the number of value and timed report events waiting to be
+     * processed by yHandleEvents().
+     *
+     * @return an integer corresponding to the number of pending events.
+     */
+    static  u32         GetEventQueueDepth(void);
+    /**
+     * Returns the highest number of pending events observed since the
+     * library was initialized.
+     *
+     * @return an integer corresponding to the peak queue depth.
+     */
+    static  u32         GetEventQueuePeak(void);
+    /**
+     * Returns the number of value and timed report events discarded since
+     * the library was initialized, because the event queue was full or
+     * because the timed report was too long to be decoded.
+     *
+     * @return an integer corresponding to the number of dropped events.
+     */
+    static  u32         GetDroppedEventCount(void);
+    /**
+     * Selects how value and timed report callbacks are run. By default (0 worker),
+     * they are run one after the other within yHandleEvents(). With one or more
+     * workers, yHandleEvents() routes the events to a pool of threads: the events
+     * of a given function are always handled in order by the same worker, while
+     * the events of different functions may be handled in parallel. When a worker
+     * has YAPI_CALLBACK_WORKER_QUEUE events waiting, yHandleEvents() waits for it.
+     * Callbacks then run outside of the thread calling yHandleEvents(), and must
+     * be thread-safe. When the workers are stopped, by this function or by
+     * yFreeAPI(), they first run the events already routed to them: a callback
+     * that never returns blocks the call.
+     *
+     * @param nbWorkers : the number of worker threads, or 0 to run callbacks
+     *         within yHandleEvents().
+     * @param errmsg : a string passed by reference to receive any error message.
+     *
+     * @return YAPI_SUCCESS when the call succeeds.
+     *
+     * On failure, throws an exception or returns a negative error code.
+     */
+    static  YRETCODE    SetCallbackWorkers(int nbWorkers, string& errmsg);
+    /**
+     * Returns the statistics of each callback worker thread.
+     *
+     * @param stats : a vector receiving one entry per worker.
+     *
+     * @return the number of callback workers.
+     */
+    static  int         GetCallbackWorkerStats(vector<yapiWorkerStats>& stats);
+    /**
+     * Enables a local cache of the datalogger streams, stored on disk.
+     * Once a stream is closed on the device, its content never changes: the data
+     * sets returned by get_recordedData() and get_dataSets() then load it from
+     * the cache instead of downloading it again, and only the streams that are
+     * new or still being recorded are transferred. Each function has its own
+     * cache file, named after its hardware id (SERIAL.functionId.ydl), which
+     * is mapped in memory. Several applications can use the same directory:
+     * the files are locked while streams are added, and each application
+     * sees the streams added by the others.
+     *
+     * @param directory : the path of an existing, writable directory where the
+     *         cache files are stored, or an empty string to disable the cache
+     *         (default).
+     * @param errmsg : a string passed by reference to receive any error message.
+     *
+     * @return YAPI_SUCCESS when the call succeeds.
+     *
+     * On failure returns a negative error code, and the previous setting is kept.
+     */
+    static  YRETCODE    SetDataLoggerCache(const string& directory, string& errmsg);
     /**
      * Pauses the execution flow for a specified duration.
      * This function implements a passive waiting loop, meaning that it does not
@@ -768,6 +954,22 @@ public:
      * On failure, throws an exception or returns a negative error code.
      */
     static  YRETCODE    Sleep(unsigned ms_duration, string& errmsg);
+    /**
+     * Waits until new events have been handled, or until a timeout expires.
+     * The calling thread is blocked until a notification is received from a
+     * network hub or a USB packet arrives, without polling in between, and the
+     * matching callbacks are called as by yHandleEvents(). The function returns
+     * as soon as some callbacks have been called, or when device plug/unplug
+     * events are waiting for yUpdateDeviceList().
+     *
+     * @param ms_timeout : the maximal waiting time, in milliseconds.
+     * @param errmsg : a string passed by reference to receive any error message.
+     *
+     * @return YAPI_SUCCESS when the call succeeds.
+     *
+     * On failure, throws an exception or returns a negative error code.
+     */
+    static  YRETCODE    WaitForEvents(unsigned ms_timeout, string& errmsg);
     /**
      * Returns the current value of a monotone millisecond-based time counter.
      * This counter can be used to compute delays in relation with
@@ -965,8 +1167,25 @@ protected:
 
     yCalibrationHandler _calhdl;
 
+    // Decoded values, stored column by column in a single buffer (column c
+    // starts at _columns[c * _colRows]). The row view in _values is only
+    // built when requested by get_dataRows().
+    vector<double>  _columns;
+    int             _colCount;
+    int             _colRows;
+    vector<int>     _words;         // raw words of the last parsed stream
+    int             _closedWordCount;
+
+    int             _decodeStreamData(const string& encoded);
+    void            _decodeStreamWords(void);
+    void            _scaleValColumn(double *col, int count);
+    void            _scaleAvgColumn(double *col, int count);
+    void            _calibrateColumn(double *col, int count);
+    int             _loadedRowCount(void);
+    void            _loadRows(void);
+
 public:
-    YDataStream(YFunction *parent): _parent(parent) {};
+    YDataStream(YFunction *parent): _parent(parent), _colCount(0), _colRows(0), _closedWordCount(0) {};
     YDataStream(YFunction *parent, YDataSet &dataset, const vector<int>& encoded);
 
     virtual ~YDataStream();
@@ -974,6 +1193,31 @@ public:
     static const double DATA_INVALID;
     static const int    DURATION_INVALID = -1;
 
+    // Decoded columns as they were last parsed, without triggering any download
+    int             _get_decodedRowCount(void);
+    int             _get_decodedColumnCount(void);
+    const double*   _get_decodedColumn(int col);
+
+    // Datalogger cache (see YAPI::SetDataLoggerCache), keyed by the hardware id of the dataset
+    bool            _isCached(const string& hwid);
+    bool            _loadFromCache(const string& hwid);
+    void            _saveToCache(const string& hwid);
+
+    // Free the decoded values; they are downloaded again if needed
+    void            _releaseData(void);
+
+    /**
+     * Returns the values of one column of the data stream, as a contiguous
+     * array of get_rowCount() floating-point numbers, without copying them.
+     * The array remains valid until the data stream is loaded again.
+     *
+     * @param col : column index
+     *
+     * @return a pointer to the first value of the column, or NULL when
+     *         the column does not exist or the stream is empty.
+     */
+    const double*   get_columnData(int col);
+
     //--- (generated code: YDataStream accessors declaration)
 
 
@@ -1258,6 +1502,126 @@ public:
     //--- (end of generated code: YMeasure accessors declaration)
 };
 
+struct yAsyncRequestSt;
+
+/**
+ * YAsyncRequest Class: request to a device sent without waiting for the reply
+ *
+ * The outcome of the request can be polled, waited for, or awaited from a
+ * C++20 coroutine. Copies of a token refer to the same request.
+ */
+class YOCTO_CLASS_EXPORT YAsyncRequest {
+protected:
+    yAsyncRequestSt *_req;
+
+public:
+    YAsyncRequest();
+    YAsyncRequest(yAsyncRequestSt *req);    // takes over a reference
+    YAsyncRequest(const YAsyncRequest& other);
+    YAsyncRequest& operator=(const YAsyncRequest& other);
+    ~YAsyncRequest();
+
+    /**
+     * Returns true once the reply of the device has been received, or once
+     * the request has failed.
+     *
+     * @return true if the request is completed
+     */
+    bool        isDone(void);
+
+    /**
+     * Waits for the completion of the request, while handling the
+     * communication with the devices (but not the user callbacks).
+     *
+     * @param msTimeout : maximal time to wait, in milliseconds
+     *
+     * @return YAPI_SUCCESS if the request has succeeded, YAPI_TIMEOUT if
+     *         it is still pending, or the negative error code of the request.
+     */
+    YRETCODE    wait(int msTimeout);
+
+    /**
+     * Returns the result of the request, or YAPI_SUCCESS while it is
+     * still pending.
+     *
+     * @return YAPI_SUCCESS or a negative error code
+     */
+    YRETCODE    get_errorType(void);
+
+    /**
+     * Returns the error message of the request, if it has failed.
+     *
+     * @return a string with the error message, or an empty string
+     */
+    string      get_errorMessage(void);
+
+    /**
+     * Returns the reply of the device, once the request has succeeded.
+     *
+     * @return a binary buffer with the reply, or an empty string
+     */
+    string      get_content(void);
+
+    // Have YAPI::HandleEvents() call resume(context) once the request is
+    // completed. Returns false if it is already completed.
+    bool        _resumeOnEvents(void (*resume)(void*), void *context);
+
+#ifdef YAPI_HAS_COROUTINES
+    static void _resumeCoroutine(void *address)
+    { std::coroutine_handle<>::from_address(address).resume(); }
+
+    bool        await_ready(void)
+    { return this->isDone(); }
+    bool        await_suspend(std::coroutine_handle<> handle)
+    { return this->_resumeOnEvents(&YAsyncRequest::_resumeCoroutine, handle.address()); }
+    YRETCODE    await_resume(void)
+    { return this->get_errorType(); }
+#endif
+};
+
+#ifdef YAPI_HAS_COROUTINES
+/**
+ * YAwaitable Class: result of a request, for C++20 coroutines
+ *
+ * Awaiting this object suspends the coroutine until the reply of the device
+ * is received. The coroutine is then resumed by YAPI::HandleEvents() (or
+ * YAPI::Sleep()), which decodes the reply in the thread handling the events.
+ * The object on which the request was made must remain valid until then.
+ */
+template<class T> class YAwaitable {
+protected:
+    YAsyncRequest                       _req;
+    std::function<T(YAsyncRequest&)>    _decode;
+
+public:
+    YAwaitable(const YAsyncRequest& req, const std::function<T(YAsyncRequest&)>& decode)
+    : _req(req), _decode(decode) {}
+
+    bool        await_ready(void)
+    { return _req.await_ready(); }
+    bool        await_suspend(std::coroutine_handle<> handle)
+    { return _req.await_suspend(handle); }
+    T           await_resume(void)
+    { return _decode(_req); }
+};
+#endif
+
+
+
+struct yStreamDownloadSt;    // defined in yocto_api.cpp
+
+// Data stream downloads kept in flight by a YDataSet, by stream index.
+// Copies of a data set do not share them: a copy starts without any.
+class YOCTO_CLASS_EXPORT YStreamDownloads {
+public:
+    map<int,yStreamDownloadSt*> pending;
+
+    YStreamDownloads() {}
+    YStreamDownloads(const YStreamDownloads&) {}
+    YStreamDownloads& operator=(const YStreamDownloads& other);
+    ~YStreamDownloads();
+    void clear(void);
+};
 
 
 //--- (generated code: YDataSet declaration)
@@ -1301,12 +1665,74 @@ protected:
     vector<YMeasure> _preview;
     vector<YMeasure> _measures;
     //--- (end of generated code: YDataSet attributes)
+    int             _parallelDownloads;
+    YStreamDownloads _downloads;
+
+    int _downloadPipelined(string& data);
+    int _loadStream(vector<YMeasure>& measures);
+    int _decodeStream(YDataStream *stream, const string& data, vector<YMeasure>& measures);
+    int _processStream(YDataStream *stream, vector<YMeasure>& measures);
+    string _cacheKey(void);
+    string _nextDownloadUrl(void);
+    int _loadMoreDone(int progress, const string& url, YAsyncRequest& request);
 
 public:
     YDataSet(YFunction *parent, const string& functionId, const string& unit, s64 startTime, s64 endTime);
     YDataSet(YFunction *parent);
     int _parse(const string& json);
 
+    /**
+     * Changes the number of data streams downloaded at the same time by loadMore().
+     * With more than one download, the next streams are transferred while the
+     * current one is decoded, which speeds up the loading of large data sets from
+     * network hubs. Measures are still loaded in time order, one stream per call.
+     * The downloads share the MAX_ASYNC_TCPCHAN (4) channels of the device, so
+     * that more than 4 downloads do not make it faster.
+     *
+     * @param nbDownloads : the number of downloads kept in flight (1 by default,
+     *         to download each stream when it is loaded).
+     */
+    void set_parallelDownloads(int nbDownloads);
+
+    /**
+     * Returns the number of data streams downloaded at the same time by loadMore().
+     *
+     * @return an integer corresponding to the number of downloads kept in flight.
+     */
+    int get_parallelDownloads(void);
+
+    /**
+     * Loads the next stream of the data set and returns its measures, without
+     * keeping them in the data set: unlike loadMore(), the measures are not
+     * added to get_measures(), and the values of the stream are freed once
+     * returned, so that data sets of any size can be processed in bounded memory.
+     * The first call only loads the list of streams, and returns an empty batch.
+     * This method shares its progress with loadMore().
+     *
+     * @param batch : a vector receiving the measures of the next stream
+     *         (previous content is discarded).
+     *
+     * @return an integer in the range 0 to 100 (percentage of completion),
+     *         or a negative error code in case of failure.
+     *
+     * On failure, throws an exception or returns a negative error code.
+     */
+    int loadNextMeasures(vector<YMeasure>& batch);
+
+#ifdef YAPI_HAS_COROUTINES
+    /**
+     * Loads the next block of measures from the dataLogger, like loadMore(),
+     * without blocking the calling thread. The coroutine awaiting the result
+     * is resumed by YAPI::HandleEvents() once the block is loaded.
+     *
+     * @return an awaitable object, giving an integer in the range 0 to 100
+     *         (percentage of completion), or a negative error code.
+     *
+     * On failure, throws an exception or returns a negative error code.
+     */
+    YAwaitable<int> loadMoreAsync(void);
+#endif
+
     //--- (generated code: YDataSet accessors declaration)
 
 
@@ -1478,6 +1904,53 @@ public:
     //--- (end of generated code: YDataSet accessors declaration)
 };
 
+/**
+ * YMeasureCursor Class: forward cursor over the measures of a data set
+ *
+ * A YMeasureCursor returns the measures of a YDataSet one by one, in time
+ * order, loading the data set stream by stream with loadNextMeasures().
+ * Only the measures of the current stream are kept in memory:
+ *
+ *     YMeasureCursor cursor(dataset);
+ *     YMeasure measure;
+ *     while (cursor.next(measure)) {
+ *         ...
+ *     }
+ *
+ * The data set must outlive the cursor, and should not be loaded by other
+ * means while the cursor is in use.
+ */
+class YOCTO_CLASS_EXPORT YMeasureCursor {
+protected:
+    YDataSet*           _dataset;
+    vector<YMeasure>    _batch;
+    size_t              _pos;
+    int                 _progress;
+
+public:
+    YMeasureCursor(YDataSet& dataset): _dataset(&dataset), _pos(0), _progress(0) {};
+
+    /**
+     * Returns the next measure of the data set, loading the next streams as needed.
+     *
+     * @param measure : a YMeasure object receiving the measure.
+     *
+     * @return true when a measure has been returned, false once all the measures
+     *         have been returned, or on error (get_progress() is then negative).
+     *
+     * On failure, throws an exception or returns false.
+     */
+    bool next(YMeasure& measure);
+
+    /**
+     * Returns the loading progress of the underlying data set.
+     *
+     * @return an integer in the range 0 to 100 (percentage of completion),
+     *         or a negative error code if the loading failed.
+     */
+    int get_progress(void);
+};
+
 //
 // YDevice Class (used internally)
 //
@@ -1501,7 +1974,10 @@ private:
     // Device cache entries
     YDEV_DESCR          _devdescr;
     u64                 _cacheStamp; // used only by requestAPI method
+    u64                 _cacheLoaded; // time at which _cacheJson was loaded, 0 once invalidated
     YJSONObject*        _cacheJson;  // used only by requestAPI method
+    map<string, u64>            _funcCacheStamp;    // time at which each function was reloaded alone
+    map<string, YJSONContent*>  _funcRetired;       // used only by requestFunctionAPI method
     vector<YFUN_DESCR>  _functions;
     char                _rootdevice[YOCTO_SERIAL_LEN];
     char                *_subpath;
@@ -1516,14 +1992,73 @@ public:
     static void ClearCache();
     static YDevice *getDevice(YDEV_DESCR devdescr);
     YRETCODE    HTTPRequestAsync(int channel, const string& request, HTTPRequestCallback callback, void *context, string& errmsg);
+    YRETCODE    HTTPRequestStart(int channel, const string& request, yapiRequestAsyncCallback callback, void *context, string& errmsg);
+    YRETCODE    HTTPRequestStartOwnConnection(int channel, const string& request, yapiRequestAsyncCallback callback, void *context, string& errmsg);
     YRETCODE    HTTPRequest(int channel, const string& request, string& buffer, yapiRequestProgressCallback progress_cb, void *progress_ctx, string& errmsg);
     YRETCODE    requestAPI(YJSONObject*& apires, string& errmsg);
+    YRETCODE    requestFunctionAPI(const string& funcId, int msValidity, YJSONObject*& funcres, string& errmsg);
     void        clearCache(bool clearSubpath);
+    void        invalidateCache(void);
     YRETCODE    getFunctions(vector<YFUN_DESCR> **functions, string& errmsg);
     string      getHubSerial(void);
 
 };
 
+struct yAsyncWriteSt;
+
+/**
+ * YAsyncWrite Class: completion token of an asynchronous attribute change
+ *
+ * This token is returned by YFunction::get_lastWrite() when asynchronous
+ * writes are enabled on a function. Copies of a token refer to the same
+ * attribute change.
+ */
+class YOCTO_CLASS_EXPORT YAsyncWrite {
+protected:
+    yAsyncWriteSt   *_write;
+
+public:
+    YAsyncWrite();
+    YAsyncWrite(yAsyncWriteSt *write);  // takes over a reference
+    YAsyncWrite(const YAsyncWrite& other);
+    YAsyncWrite& operator=(const YAsyncWrite& other);
+    ~YAsyncWrite();
+
+    /**
+     * Returns true once the device has replied to the attribute change,
+     * or once the change has failed.
+     *
+     * @return true if the attribute change is completed
+     */
+    bool        isDone(void);
+
+    /**
+     * Waits for the completion of the attribute change, while handling
+     * the communication with the devices (but not the user callbacks).
+     *
+     * @param msTimeout : maximal time to wait, in milliseconds
+     *
+     * @return YAPI_SUCCESS if the change has been applied, YAPI_TIMEOUT if
+     *         it is still pending, or the negative error code of the change.
+     */
+    YRETCODE    wait(int msTimeout);
+
+    /**
+     * Returns the result of the attribute change, or YAPI_SUCCESS while
+     * it is still pending.
+     *
+     * @return YAPI_SUCCESS or a negative error code
+     */
+    YRETCODE    get_errorType(void);
+
+    /**
+     * Returns the error message of the attribute change, if it has failed.
+     *
+     * @return a string with the error message, or an empty string
+     */
+    string      get_errorMessage(void);
+};
+
 //--- (generated code: YFunction declaration)
 /**
  * YFunction Class: Common function interface
@@ -1556,6 +2091,12 @@ protected:
     yCRITICAL_SECTION _this_cs;
     std::map<string,YDataStream*> _dataStreams;
     void*                   _userData;
+    bool                    _batching;
+    vector<yapiAttrWrite>   _batchWrites;   // changes waiting for commitBatch()
+    vector<yapiAttrWrite>   _batchResults;  // outcome of the last commitBatch()
+    bool                    _asyncWrites;
+    YAsyncWrite             _lastWrite;
+    u64                     _loadedAt;      // time of the last load from the device
     //--- (generated code: YFunction attributes)
     // Attributes (function value cache)
     string          _logicalName;
@@ -1577,10 +2118,18 @@ protected:
     //--- (end of generated code: YFunction attributes)
     static  std::map<string,YFunction*> _cache;
 
+    friend class YFunctionGroupBase;
+
 
     // Method used to retrieve our unique function descriptor (may trigger a hub scan)
     YRETCODE    _getDescriptor(YFUN_DESCR& fundescr, string& errMsg);
 
+    // Method used to get the value last pushed by notification, if still valid
+    bool        _getPushedValue(string& value);
+
+    // Method used to update the attributes carried by a pushed value
+    virtual bool _applyPushedValue(const string& pushed);
+
     // Method used to retrieve our device object (may trigger a hub scan)
     YRETCODE    _getDevice(YDevice*& dev, string& errMsg);
 
@@ -1594,7 +2143,10 @@ protected:
 
     // Method used to change attributes
     YRETCODE    _setAttr(string attrname, string newvalue);
+    YRETCODE    _setAttrAsync(const string& attrname, const string& newvalue, YAsyncWrite& write, string& errmsg);
+    YRETCODE    _sendBatchRequest(YDevice *dev, const char *funcid, vector<yapiAttrWrite>& writes, size_t start, size_t& end, string& errmsg);
     YRETCODE    _load_unsafe(int msValidity);
+    void        _loadFromNode(YJSONObject *node, const string& serial, const string& funcId, int msValidity);
 
     static void _UpdateValueCallbackList(YFunction* func, bool add);
     static void _UpdateTimedReportCallbackList(YFunction* func, bool add);
@@ -1616,6 +2168,14 @@ public:
     string      _request(const string& request);
     string      _requestEx(int tcpchan, const string& request, yapiRequestProgressCallback callback, void *context);
     string      _download(const string& url);
+    YRETCODE    _downloadStart(int tcpchan, const string& url, yapiRequestAsyncCallback callback, void *context, string& errmsg);
+
+    // Methods used to send a request without waiting for the reply
+    YAsyncRequest _requestAsync(int tcpchan, const string& request);
+    YAsyncRequest _downloadAsync(const string& url);
+    YAsyncRequest _uploadAsync(const string& path, const string& content);
+    YAsyncRequest _loadAsyncStart(void);
+    YRETCODE    _loadAsyncDone(YAsyncRequest& request, int msValidity);
 
     // Method used to upload a file to the device
     YRETCODE    _uploadWithProgress(const string& path, const string& content, yapiRequestProgressCallback callback, void *context);
@@ -1913,6 +2473,49 @@ public:
      */
     YRETCODE    load(int msValidity);
 
+#ifdef YAPI_HAS_COROUTINES
+    /**
+     * Preloads the function cache with a specified validity duration, like
+     * load(), without blocking the calling thread. The coroutine awaiting the
+     * result is resumed by YAPI::HandleEvents() once the function is loaded.
+     *
+     * @param msValidity : an integer corresponding to the validity attributed to the
+     *         loaded function parameters, in milliseconds
+     *
+     * @return an awaitable object, giving YAPI_SUCCESS when the call succeeds.
+     *
+     * On failure, throws an exception or returns a negative error code.
+     */
+    YAwaitable<int> loadAsync(int msValidity);
+
+    /**
+     * Downloads a file from the device (for instance "logs.txt", or a
+     * JSON file such as "api.json"), without blocking the calling thread.
+     *
+     * @param path : the path of the file to download, relative to the
+     *         root of the device
+     *
+     * @return an awaitable object, giving a binary buffer with the file
+     *         content, or an empty string on failure.
+     *
+     * On failure, throws an exception or returns an empty string.
+     */
+    YAwaitable<string> downloadAsync(const string& path);
+
+    /**
+     * Uploads a file to the device filesystem, without blocking the
+     * calling thread.
+     *
+     * @param path : the path of the file to upload
+     * @param content : a binary buffer with the file content
+     *
+     * @return an awaitable object, giving YAPI_SUCCESS when the call succeeds.
+     *
+     * On failure, throws an exception or returns a negative error code.
+     */
+    YAwaitable<int> uploadAsync(const string& path, const string& content);
+#endif
+
     /**
      * Invalidates the cache. Invalidates the cache of the function attributes. Forces the
      * next call to get_xxx() or loadxxx() to use values that come from the device.
@@ -1921,6 +2524,84 @@ public:
      */
     void    clearCache();
 
+    /**
+     * Starts a write batch on the function. Until commitBatch() is called,
+     * attribute changes made with the set_xxx() methods are only recorded,
+     * and are then sent to the device in as few requests as possible
+     * (usually a single one). The batch belongs to the object, not to
+     * the calling thread. Calling this method while a batch is already
+     * open has no effect.
+     *
+     * @return YAPI_SUCCESS when the call succeeds.
+     */
+    int         beginBatch(void);
+
+    /**
+     * Sends the attribute changes recorded since beginBatch() to the device,
+     * in the order in which they were made, and closes the batch.
+     * The outcome of each change can then be checked with get_batchResults().
+     *
+     * @return YAPI_SUCCESS when all changes have been applied.
+     *
+     * On failure, throws an exception or returns the negative error code
+     * of the first change that could not be applied.
+     */
+    int         commitBatch(void);
+
+    /**
+     * Drops the attribute changes recorded since beginBatch() and closes
+     * the batch, without contacting the device.
+     *
+     * @return YAPI_SUCCESS when the call succeeds.
+     */
+    int         cancelBatch(void);
+
+    /**
+     * Returns the outcome of each attribute change sent by the last call to
+     * commitBatch(), in the order in which the changes were made.
+     *
+     * @return a vector of yapiAttrWrite records
+     */
+    vector<yapiAttrWrite> get_batchResults(void);
+
+    /**
+     * Enables or disables asynchronous writes on the function. When enabled,
+     * the set_xxx() methods return as soon as the change is queued, without
+     * waiting for the device. The changes reach each device in the order in
+     * which they were made, and consecutive changes to the same function are
+     * sent in a single request. The queued changes are sent while events are
+     * handled (YAPI::HandleEvents(), YAPI::Sleep() or YAsyncWrite::wait()).
+     * The outcome of the last change is available from get_lastWrite().
+     * Each device processes one request at a time, but behind an HTTP hub
+     * the devices get their changes in parallel, each on a connection of
+     * its own: the changes to many devices complete much faster than with
+     * synchronous writes. The changes to a single device, or to the devices
+     * of a websocket hub (which processes one request at a time), do not
+     * complete faster: the caller is only spared the wait, and requests
+     * are saved by merging.
+     *
+     * @param enabled : true to queue the attribute changes
+     *
+     * @return YAPI_SUCCESS when the call succeeds.
+     */
+    int         set_asyncWrites(bool enabled);
+
+    /**
+     * Returns true if the set_xxx() methods of the function queue their
+     * changes instead of waiting for the device.
+     *
+     * @return true if asynchronous writes are enabled
+     */
+    bool        get_asyncWrites(void);
+
+    /**
+     * Returns the completion token of the last attribute change queued on
+     * the function while asynchronous writes are enabled.
+     *
+     * @return a YAsyncWrite object
+     */
+    YAsyncWrite get_lastWrite(void);
+
     /**
      * Gets the YModule object for the device on which the function is located.
      * If the function cannot be located on any module, the returned instance of
@@ -1971,6 +2652,195 @@ public:
 };
 
 
+// Called by YFunctionGroupBase::_load() on each member loaded successfully
+class YOCTO_CLASS_EXPORT YFunctionGroupVisitor {
+public:
+    virtual ~YFunctionGroupVisitor() {}
+    virtual void visit(size_t index, YFunction *member) = 0;
+};
+
+// Untyped part of YFunctionGroup, see below
+class YOCTO_CLASS_EXPORT YFunctionGroupBase {
+protected:
+    vector<YFunction*>  _members;
+    vector<YRETCODE>    _errorTypes;    // outcome of the last operation, by member
+    vector<string>      _errorMessages;
+    vector<YAsyncWrite> _writes;        // writes of the current write() call
+    vector<bool>        _wasAsync;
+
+    void        _setResult(size_t index, YRETCODE res, const string& errmsg);
+    YRETCODE    _load(int msValidity, YFunctionGroupVisitor *visitor);
+    YRETCODE    _loadForRead(YFunctionGroupVisitor *visitor);
+    void        _startWrites(void);
+    void        _queuedWrite(size_t index, int res, const string& errmsg);
+    YRETCODE    _endWrites(void);
+
+public:
+    virtual ~YFunctionGroupBase() {}
+
+    /**
+     * Returns the number of functions in the group.
+     *
+     * @return an integer
+     */
+    int         get_count(void);
+
+    /**
+     * Removes all the functions from the group.
+     */
+    void        clear(void);
+
+    /**
+     * Preloads the cache of all the functions of the group with a specified
+     * validity duration, like YFunction::load(). A single request is sent to
+     * each device hosting functions of the group: for the json of the
+     * function when the group has only one function on the device, for the
+     * whole api.json otherwise. These requests are all sent at once: the
+     * devices connected to different hubs or USB ports are queried
+     * concurrently.
+     * Errors are not thrown: they are reported by member, by get_errorType()
+     * and get_errorMessage().
+     *
+     * @param msValidity : an integer corresponding to the validity attributed to the
+     *         loaded function parameters, in milliseconds
+     *
+     * @return YAPI_SUCCESS when all the functions have been loaded, or the
+     *         first error code otherwise.
+     */
+    YRETCODE    load(int msValidity);
+
+    /**
+     * Returns the result of the last operation of the group on a function.
+     *
+     * @param index : the index of the function in the group
+     *
+     * @return YAPI_SUCCESS or a negative error code
+     */
+    YRETCODE    get_errorType(int index);
+
+    /**
+     * Returns the error message of the last operation of the group on a
+     * function, if it has failed.
+     *
+     * @param index : the index of the function in the group
+     *
+     * @return a string with the error message, or an empty string
+     */
+    string      get_errorMessage(int index);
+};
+
+template<class T, class C, class R> class YFunctionGroupReader : public YFunctionGroupVisitor {
+protected:
+    R           (C::*_getter)(void);
+    vector<R>&  _values;
+
+public:
+    YFunctionGroupReader(R (C::*getter)(void), vector<R>& values) : _getter(getter), _values(values) {}
+    virtual void visit(size_t index, YFunction *member)
+    { _values[index] = (static_cast<T*>(member)->*_getter)(); }
+};
+
+/**
+ * YFunctionGroup Class: set of functions read and written together
+ *
+ * The functions of a group are read with a single request per device,
+ * and written with asynchronous writes. The requests to devices
+ * connected to different hubs or USB ports are all in flight at the same
+ * time, so that the duration of an operation on many modules is close to
+ * the one of the slowest device, instead of the sum of all round trips.
+ * The results are given for each member, together with its error, if any.
+ *
+ * For instance, to read all the temperatures and switch all the relays:
+ *     YFunctionGroup<YTemperature> temps;   // temps.add(...)
+ *     vector<double> values = temps.read(&YTemperature::get_currentValue,
+ *                                        YTemperature::CURRENTVALUE_INVALID);
+ *     YFunctionGroup<YRelay> relays;        // relays.add(...)
+ *     relays.write(&YRelay::set_state, Y_STATE_B);
+ */
+template<class T> class YFunctionGroup : public YFunctionGroupBase {
+public:
+    /**
+     * Adds a function to the group.
+     *
+     * @param function : a pointer to the function object
+     */
+    void        add(T *function)
+    { _members.push_back(function); }
+
+    /**
+     * Returns a function of the group.
+     *
+     * @param index : the index of the function in the group
+     *
+     * @return a pointer to the function object
+     */
+    T           *get_function(int index)
+    { return static_cast<T*>(_members[index]); }
+
+    /**
+     * Reads an attribute of all the functions of the group: the functions
+     * are loaded as by load(), and the getter is then called on each
+     * function from its fresh cache.
+     * Errors are not thrown: they are reported by member, by get_errorType()
+     * and get_errorMessage(). The value of a function that could not be
+     * loaded is set to invalidValue.
+     *
+     * @param getter : a get_xxx() method of the functions
+     *         (for instance &YTemperature::get_currentValue)
+     * @param invalidValue : the value given to the functions that could not
+     *         be loaded (for instance YTemperature::CURRENTVALUE_INVALID)
+     *
+     * @return a vector with the value of each function, in group order.
+     */
+    template<class C, class R, class I> vector<R> read(R (C::*getter)(void), const I& invalidValue)
+    {
+        vector<R> values(_members.size(), R(invalidValue));
+        YFunctionGroupReader<T,C,R> reader(getter, values);
+
+        this->_loadForRead(&reader);
+        return values;
+    }
+
+    /**
+     * Changes an attribute of all the functions of the group. The changes
+     * are queued as asynchronous writes (see YFunction::set_asyncWrites()),
+     * so that the devices connected to different hubs or USB ports are
+     * written concurrently, and the method returns once all the devices have
+     * replied. Errors are not thrown: they are reported by member, by
+     * get_errorType() and get_errorMessage(). The functions with a write
+     * batch open (see YFunction::beginBatch()) are not written, and
+     * reported with a YAPI_INVALID_ARGUMENT error.
+     *
+     * @param setter : a set_xxx() method of the functions
+     *         (for instance &YRelay::set_state)
+     * @param value : the new value of the attribute
+     *
+     * @return YAPI_SUCCESS when all the changes have been applied, or the
+     *         first error code otherwise.
+     */
+    template<class C, class V, class A> YRETCODE write(int (C::*setter)(V), const A& value)
+    {
+        size_t  i;
+        int     res;
+
+        this->_startWrites();
+        for (i = 0; i < _members.size(); i++) {
+            if (YISERR(this->_errorTypes[i])) {
+                continue;
+            }
+            try {
+                res = (static_cast<T*>(_members[i])->*setter)(value);
+            } catch (YAPI_Exception& ex) {
+                this->_queuedWrite(i, ex.errorType, ex.what());
+                continue;
+            }
+            this->_queuedWrite(i, res, _members[i]->get_errorMessage());
+        }
+        return this->_endWrites();
+    }
+};
+
+
 typedef void(*YModuleLogCallback)(YModule *module, const string& log);
 
 //--- (generated code: YModule declaration)
@@ -2701,6 +3571,8 @@ protected:
     //--- (generated code: Sensor initialization)
     //--- (end of generated code: Sensor initialization)
 
+    virtual bool _applyPushedValue(const string& pushed);
+
 public:
     ~YSensor();
     //--- (generated code: YSensor accessors declaration)
@@ -3948,5 +4820,52 @@ inline YDataLogger* yFirstDataLogger(void)
 
 //--- (end of generated code: DataLogger functions declaration)
 
+#ifdef YAPI_HAS_COROUTINES
+// The awaitable methods are defined here, so that the library itself
+// does not need to be compiled as C++20
+
+inline YAwaitable<int> YFunction::loadAsync(int msValidity)
+{
+    return YAwaitable<int>(this->_loadAsyncStart(), [this, msValidity](YAsyncRequest& request) {
+        return (int)this->_loadAsyncDone(request, msValidity);
+    });
+}
+
+inline YAwaitable<string> YFunction::downloadAsync(const string& path)
+{
+    return YAwaitable<string>(this->_downloadAsync(path), [this](YAsyncRequest& request) {
+        if (YISERR(request.get_errorType())) {
+            this->_throw(request.get_errorType(), request.get_errorMessage());
+            return string("");
+        }
+        return request.get_content();
+    });
+}
+
+inline YAwaitable<int> YFunction::uploadAsync(const string& path, const string& content)
+{
+    return YAwaitable<int>(this->_uploadAsync(path, content), [this](YAsyncRequest& request) {
+        YRETCODE res = request.get_errorType();
+        if (YISERR(res)) {
+            this->_throw(res, request.get_errorMessage());
+        }
+        return (int)res;
+    });
+}
+
+inline YAwaitable<int> YDataSet::loadMoreAsync(void)
+{
+    int             progress = _progress;
+    string          url = this->_nextDownloadUrl();
+    YAsyncRequest   request;
+
+    if (url != "") {
+        request = _parent->_downloadAsync(url);
+    }
+    return YAwaitable<int>(request, [this, progress, url](YAsyncRequest& request) {
+        return this->_loadMoreDone(progress, url, request);
+    });
+}
+#endif
 
 #endif
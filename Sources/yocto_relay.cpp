@@ -69,6 +69,16 @@ YRelay::~YRelay()
 //--- (YRelay cleanup)
 //--- (end of YRelay cleanup)
 }
+
+// Relays advertise their state as "A" or "B"
+bool YRelay::_applyPushedValue(const string& pushed)
+{
+    if (pushed != "A" && pushed != "B") {
+        return false;
+    }
+    _state = (pushed == "A" ? YRelay::STATE_A : YRelay::STATE_B);
+    return YFunction::_applyPushedValue(pushed);
+}
 //--- (YRelay implementation)
 // static attributes
 const YDelayedPulse YRelay::DELAYEDPULSETIMER_INVALID = YDelayedPulse();
@@ -140,6 +140,8 @@ protected:
     YRelay(const string& func);
     //--- (end of YRelay attributes)
 
+    virtual bool _applyPushedValue(const string& pushed);
+
 public:
     ~YRelay();
     //--- (YRelay accessors declaration)
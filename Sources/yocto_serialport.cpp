@@ -1974,5 +1974,29 @@ YSerialPort* YSerialPort::FirstSerialPort(void)
 
 //--- (end of YSerialPort implementation)
 
+// Decode the reply to the request sent by queryLineAsync(), as queryLine() does
+string YSerialPort::_queryLineDone(YAsyncRequest& request)
+{
+    vector<string> msgarr;
+    int msglen = 0;
+
+    if (YISERR(request.get_errorType())) {
+        this->_throw(request.get_errorType(), request.get_errorMessage());
+        return "";
+    }
+    msgarr = this->_json_get_array(request.get_content());
+    msglen = (int)msgarr.size();
+    if (msglen == 0) {
+        return "";
+    }
+    // last element of array is the new position
+    msglen = msglen - 1;
+    _rxptr = atoi((msgarr[msglen]).c_str());
+    if (msglen == 0) {
+        return "";
+    }
+    return this->_json_get_string(msgarr[0]);
+}
+
 //--- (SerialPort functions)
 //--- (end of SerialPort functions)
@@ -893,6 +893,26 @@ public:
 #pragma option pop
 #endif
     //--- (end of YSerialPort accessors declaration)
+
+    // Decode the reply to the request sent by queryLineAsync()
+    string      _queryLineDone(YAsyncRequest& request);
+
+#ifdef YAPI_HAS_COROUTINES
+    /**
+     * Sends a text line query to the serial port, and reads the reply, like
+     * queryLine(), without blocking the calling thread. The coroutine awaiting
+     * the reply is resumed by YAPI::HandleEvents() once it is received.
+     *
+     * @param query : the line query to send (without CR/LF)
+     * @param maxWait : the maximum number of milliseconds to wait for a reply.
+     *
+     * @return an awaitable object, giving the next text line received after
+     *         sending the text query, as a string.
+     *
+     * On failure, throws an exception or returns an empty string.
+     */
+    YAwaitable<string> queryLineAsync(string query, int maxWait);
+#endif
 };
 
 //--- (SerialPort functions declaration)
@@ -940,4 +960,15 @@ inline YSerialPort* yFirstSerialPort(void)
 
 //--- (end of SerialPort functions declaration)
 
+#ifdef YAPI_HAS_COROUTINES
+inline YAwaitable<string> YSerialPort::queryLineAsync(string query, int maxWait)
+{
+    string url = YapiWrapper::ysprintf("rxmsg.json?len=1&maxw=%d&cmd=!%s", maxWait, query.c_str());
+
+    return YAwaitable<string>(this->_downloadAsync(url), [this](YAsyncRequest& request) {
+        return this->_queryLineDone(request);
+    });
+}
+#endif
+
 #endif
@@ -0,0 +1,107 @@
+/*********************************************************************
+ *
+ * Benchmark of the asynchronous attribute writes (YFunction::set_asyncWrites)
+ *
+ * Switches all the relays of the devices behind a hub a number of
+ * times, and measures the number of changes completed per second:
+ *   - with synchronous writes, each set_state() waiting for the device;
+ *   - with asynchronous writes, all the changes of a round queued, then
+ *     waited for with their completion tokens.
+ * The stand-in hub delays each device request (--latency) as a device
+ * would. Each device takes one request at a time, so the asynchronous
+ * writes can be at most as many times faster as there are devices.
+ * The hub itself sends no notification.
+ * Typical use, 4 relays on each of 25 devices, 10 ms per request,
+ * 5 rounds:
+ *   python3 standin_hub.py --type relay --devices 25 --functions 4 --latency 10 --notify-period 0 \
+ *       -- Binary_Linux/64bits/bench_asyncwrites 127.0.0.1:4444 5
+ *
+ *********************************************************************/
+
+#include "yocto_api.h"
+#include "yocto_relay.h"
+#include <iostream>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool cond, const string& what)
+{
+  cout << (cond ? "ok       " : "FAILED   ") << what << endl;
+  if (!cond) {
+    failures++;
+  }
+}
+
+// monotonic time in [s]
+static double now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, const char * argv[])
+{
+  string errmsg;
+  vector<YRelay*> relays;
+  vector<YAsyncWrite> writes;
+  YRelay *relay;
+  int rounds, r, i;
+  bool ok;
+  double start, syncRate, asyncRate;
+
+  if (argc < 3) {
+    cerr << "usage: bench_asyncwrites <hub_url> <rounds>" << endl;
+    return 1;
+  }
+  rounds = atoi(argv[2]);
+  if (yRegisterHub(argv[1], errmsg) != YAPI_SUCCESS) {
+    cerr << "RegisterHub error: " << errmsg << endl;
+    return 1;
+  }
+  for (relay = yFirstRelay(); relay != NULL; relay = relay->nextRelay()) {
+    relay->isOnline();
+    relays.push_back(relay);
+  }
+  cout << relays.size() << " relays, " << rounds << " rounds" << endl;
+
+  start = now();
+  for (r = 0, ok = true; r < rounds; r++) {
+    for (i = 0; i < (int)relays.size(); i++) {
+      ok = ok && relays[i]->set_state(r % 2 ? Y_STATE_B : Y_STATE_A) == YAPI_SUCCESS;
+    }
+  }
+  syncRate = relays.size() * rounds / (now() - start);
+  cout << "  synchronous writes : " << syncRate << " changes/s" << endl;
+  check(ok, "synchronous changes applied");
+
+  for (i = 0; i < (int)relays.size(); i++) {
+    relays[i]->set_asyncWrites(true);
+  }
+  start = now();
+  for (r = 0, ok = true; r < rounds; r++) {
+    writes.clear();
+    for (i = 0; i < (int)relays.size(); i++) {
+      relays[i]->set_state(r % 2 ? Y_STATE_B : Y_STATE_A);
+      writes.push_back(relays[i]->get_lastWrite());
+    }
+    for (i = 0; i < (int)writes.size(); i++) {
+      ok = ok && writes[i].wait(10000) == YAPI_SUCCESS;
+    }
+  }
+  asyncRate = relays.size() * rounds / (now() - start);
+  cout << "  asynchronous writes: " << asyncRate << " changes/s (x" << asyncRate / syncRate << ")" << endl;
+  check(ok, "asynchronous changes applied");
+  check(asyncRate >= 10 * syncRate, "asynchronous writes at least 10 times faster");
+
+  yFreeAPI();
+  cout << (failures ? "FAILED" : "PASSED") << endl;
+  return failures ? 1 : 0;
+}
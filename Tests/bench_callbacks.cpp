@@ -0,0 +1,147 @@
+/*********************************************************************
+ *
+ * Benchmark of the value callback dispatch (_yapiFunctionUpdateCallbackFwd)
+ *
+ * Registers value callbacks on a growing number of the sensors of a hub,
+ * then forwards notifications for all the sensors, as the hub thread
+ * does, and runs the callbacks with HandleEvents. Measures the
+ * notification throughput against the number of registered callbacks,
+ * and the time to find the targets of a notification, with the index by
+ * function descriptor and with a scan of the registered functions such
+ * as the one it replaces. The hubs send no notification by themselves.
+ * Typical use, 2 hubs of 120 devices with 12 sensors, 10 to 2880
+ * callbacks:
+ *   python3 standin_hub.py --hubs 2 --devices 120 --functions 12 --notify-period 0 \
+ *       -- Binary_Linux/64bits/bench_callbacks 4444 2 100000 10 100 1000 2880
+ *
+ *********************************************************************/
+
+#include "yocto_api.h"
+#include "yocto_temperature.h"
+#include "yapi/yapi.h"
+#include <iostream>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+using namespace std;
+
+#define BATCH   1000
+
+static int failures = 0;
+static volatile u32 delivered = 0;
+
+static void check(bool cond, const string& what)
+{
+  cout << (cond ? "ok       " : "FAILED   ") << what << endl;
+  if (!cond) {
+    failures++;
+  }
+}
+
+// monotonic time in [s]
+static double now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void valueCallback(YTemperature *func, const string& value)
+{
+  delivered++;
+}
+
+int main(int argc, const char * argv[])
+{
+  string errmsg;
+  vector<YTemperature*> sensors;
+  vector<YFUN_DESCR> descrs;
+  YTemperature *sensor;
+  char url[32];
+  int port, nbHubs, nbNotifications, nbCallbacks, registered = 0, a, n, i, k;
+  u32 expected;
+  volatile u32 found;
+  double start, forwardTime, total, scanTime;
+  bool ok = true;
+
+  if (argc < 5) {
+    cerr << "usage: bench_callbacks <first_port> <hubs> <notifications> <callbacks>..." << endl;
+    return 1;
+  }
+  port = atoi(argv[1]);
+  nbHubs = atoi(argv[2]);
+  nbNotifications = atoi(argv[3]);
+  for (i = 0; i < nbHubs; i++) {
+    snprintf(url, sizeof(url), "127.0.0.1:%d", port + i);
+    if (yRegisterHub(url, errmsg) != YAPI_SUCCESS) {
+      cerr << "RegisterHub error: " << errmsg << endl;
+      return 1;
+    }
+  }
+  for (sensor = yFirstTemperature(); sensor != NULL; sensor = sensor->nextTemperature()) {
+    // the descriptor is known once the function is resolved
+    sensor->isOnline();
+    sensors.push_back(sensor);
+    descrs.push_back(sensor->get_functionDescriptor());
+  }
+  cout << sensors.size() << " sensors, " << nbNotifications << " notifications spread over all of them" << endl;
+
+  for (a = 4; a < argc; a++) {
+    nbCallbacks = atoi(argv[a]);
+    if (nbCallbacks > (int)sensors.size()) {
+      nbCallbacks = (int)sensors.size();
+    }
+    while (registered < nbCallbacks) {
+      sensors[registered++]->registerValueCallback(valueCallback);
+    }
+    YAPI::HandleEvents(errmsg);
+    delivered = 0;
+    expected = 0;
+    forwardTime = 0;
+
+    // index by function descriptor
+    start = now();
+    for (n = 0; n < nbNotifications; n += BATCH) {
+      double fwdStart = now();
+      yapiLockFunctionCallBack(NULL);
+      for (i = n; i < n + BATCH && i < nbNotifications; i++) {
+        k = i % (int)sensors.size();
+        YAPI::_yapiFunctionUpdateCallbackFwd(descrs[k], "21.50");
+        if (k < nbCallbacks) {
+          expected++;
+        }
+      }
+      yapiUnlockFunctionCallBack(NULL);
+      forwardTime += now() - fwdStart;
+      YAPI::HandleEvents(errmsg);
+    }
+    total = now() - start;
+    ok = ok && delivered == expected;
+
+    // scan of the registered functions, as before the index
+    start = now();
+    found = 0;
+    for (i = 0; i < nbNotifications; i++) {
+      YFUN_DESCR fundescr = descrs[i % (int)sensors.size()];
+      for (k = 0; k < nbCallbacks; k++) {
+        if (sensors[k]->get_functionDescriptor() == fundescr) {
+          found++;
+        }
+      }
+    }
+    scanTime = now() - start;
+    ok = ok && found == expected;
+
+    cout << "  " << nbCallbacks << " callbacks: " << nbNotifications / total << " notifications/s, "
+         << forwardTime * 1e9 / nbNotifications << " ns to forward one (scan: "
+         << scanTime * 1e9 / nbNotifications << " ns)" << endl;
+  }
+  check(ok, "each notification delivered to the registered callback only");
+
+  yFreeAPI();
+  cout << (failures ? "FAILED" : "PASSED") << endl;
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,79 @@
+/*********************************************************************
+ *
+ * Benchmark of datalogger downloads
+ *
+ * Loads the whole recorded data of a sensor with YDataSet::loadMore(),
+ * for several values of set_parallelDownloads(), and prints the
+ * throughput in samples/s and in MB/s of stream data. The stand-in hub
+ * encodes each measure in 6 bytes.
+ *
+ * Typical use, with 50 streams of one hour and 20 ms per request:
+ *   python3 standin_hub.py --streams 50 --rows 3600 --latency 20 \
+ *       -- Binary_Linux/64bits/bench_datalogger 127.0.0.1:4444
+ *
+ *********************************************************************/
+
+#include "yocto_api.h"
+#include "yocto_temperature.h"
+#include <iostream>
+#include <stdlib.h>
+
+using namespace std;
+
+#define BYTES_PER_SAMPLE  6
+
+// Load the full data set with a number of parallel downloads, return the
+// number of samples and the time spent in [ms]
+static int loadAll(YTemperature *sensor, int parallel, u64& elapsed)
+{
+  YDataSet dataset = sensor->get_recordedData(0, 0);
+  u64 start = yGetTickCount();
+  int progress;
+
+  dataset.set_parallelDownloads(parallel);
+  do {
+    progress = dataset.loadMore();
+  } while (progress >= 0 && progress < 100);
+  elapsed = yGetTickCount() - start;
+  if (progress < 0) {
+    return progress;
+  }
+  return (int)dataset.get_measures().size();
+}
+
+int main(int argc, const char * argv[])
+{
+  string errmsg;
+  YTemperature *sensor;
+  u64 elapsed;
+  int samples, parallel[] = { 1, 2, 4, 8 };
+  size_t i;
+
+  if (argc < 2) {
+    cerr << "usage: bench_datalogger <hub_url>" << endl;
+    return 1;
+  }
+  if (yRegisterHub(argv[1], errmsg) != YAPI_SUCCESS) {
+    cerr << "RegisterHub error: " << errmsg << endl;
+    return 1;
+  }
+  sensor = yFirstTemperature();
+  if (sensor == NULL) {
+    cerr << "No temperature sensor found" << endl;
+    return 1;
+  }
+  // first load not timed, for the connections and the stream list
+  loadAll(sensor, 1, elapsed);
+  for (i = 0; i < sizeof(parallel) / sizeof(parallel[0]); i++) {
+    samples = loadAll(sensor, parallel[i], elapsed);
+    if (samples < 0 || elapsed == 0) {
+      cerr << "Load error: " << samples << endl;
+      return 1;
+    }
+    cout << "parallelDownloads " << parallel[i] << ": " << samples << " samples in " << elapsed << " ms, "
+         << samples * 1000.0 / elapsed << " samples/s, "
+         << samples * (double)BYTES_PER_SAMPLE / 1000.0 / elapsed << " MB/s" << endl;
+  }
+  yFreeAPI();
+  return 0;
+}
@@ -0,0 +1,223 @@
+/*********************************************************************
+ *
+ * Benchmark of the stream decoders (YAPI::_decodeWords, _decodeFloats)
+ *
+ * Decodes 64 KB payloads such as the datalogger streams and calibration
+ * data sent by the devices: words of a slowly changing measure, with some
+ * repeated and special values, and a list of floats. Measures the time
+ * per payload of the vector versions, of the versions which decode into
+ * a buffer of the caller, and of the push_back decoders they replace,
+ * which also give the expected results. No hub is needed. Typical use,
+ * 64 KB payloads, 2000 passes:
+ *   Binary_Linux/64bits/bench_decode 64 2000
+ *
+ *********************************************************************/
+
+#include "yocto_api.h"
+#include <iostream>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool cond, const string& what)
+{
+  cout << (cond ? "ok       " : "FAILED   ") << what << endl;
+  if (!cond) {
+    failures++;
+  }
+}
+
+// monotonic time in [us]
+static double now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// The word decoder used before the buffer versions
+static vector<int> refDecodeWords(const string& sdat)
+{
+  vector<int> udat;
+
+  for (unsigned p = 0; p < sdat.size();) {
+    unsigned val;
+    unsigned c = sdat[p++];
+    if (c == '*') {
+      val = 0;
+    } else if (c == 'X') {
+      val = 0xffff;
+    } else if (c == 'Y') {
+      val = 0x7fff;
+    } else if (c >= 'a') {
+      int srcpos = (int)udat.size() - 1 - (c - 'a');
+      val = (srcpos < 0 ? 0 : udat[srcpos]);
+    } else {
+      if (p + 2 > sdat.size()) {
+        return udat;
+      }
+      val = (c - '0');
+      c = sdat[p++];
+      val += (c - '0') << 5;
+      c = sdat[p++];
+      if (c == 'z') {
+        c = '\\';
+      }
+      val += (c - '0') << 10;
+    }
+    udat.push_back((int)val);
+  }
+  return udat;
+}
+
+// The float decoder used before the buffer versions
+static vector<int> refDecodeFloats(const string& sdat)
+{
+  vector<int> idat;
+
+  for (unsigned p = 0; p < sdat.size();) {
+    int val = 0, sign = 1, dec = 0, decInc = 0;
+    unsigned c = sdat[p++];
+    while (c != '-' && (c < '0' || c > '9')) {
+      if (p >= sdat.size()) {
+        return idat;
+      }
+      c = sdat[p++];
+    }
+    if (c == '-') {
+      if (p >= sdat.size()) {
+        return idat;
+      }
+      sign = -sign;
+      c = sdat[p++];
+    }
+    while ((c >= '0' && c <= '9') || c == '.') {
+      if (c == '.') {
+        decInc = 1;
+      } else if (dec < 3) {
+        val = val * 10 + (c - '0');
+        dec += decInc;
+      }
+      c = (p < sdat.size() ? sdat[p++] : 0);
+    }
+    if (dec < 3) {
+      val *= (dec == 0 ? 1000 : (dec == 1 ? 100 : 10));
+    }
+    idat.push_back(sign * val);
+  }
+  return idat;
+}
+
+// Words of a measure around 20.000, one in eight repeated from the last 4 or special
+static string streamWords(int size)
+{
+  string res;
+  int val = 20000, nwords = 0;
+
+  while ((int)res.size() + 3 <= size) {
+    if (nwords >= 4 && rand() % 8 == 0) {
+      int kind = rand() % 6;
+      res += (kind < 4 ? (char)('a' + kind) : (kind == 4 ? '*' : 'Y'));
+    } else {
+      val = (val + rand() % 41 - 20) & 0xffff;
+      char c = (char)('0' + ((val >> 10) & 63));
+      res += (char)('0' + (val & 31));
+      res += (char)('0' + ((val >> 5) & 31));
+      res += (c == '\\' ? 'z' : c);
+    }
+    nwords++;
+  }
+  return res;
+}
+
+// Calibration-like list of floats
+static string floatList(int size)
+{
+  string res;
+  char buf[32];
+
+  while ((int)res.size() + 12 <= size) {
+    snprintf(buf, sizeof(buf), "%s%d.%03d,", (rand() % 4 ? "" : "-"), rand() % 2000, rand() % 1000);
+    res += buf;
+  }
+  return res;
+}
+
+static void report(const char *name, size_t bytes, int passes, double elapsed)
+{
+  cout << "  " << name << ": " << elapsed / passes << " us per payload, "
+       << (double)bytes * passes / elapsed << " MB/s" << endl;
+}
+
+int main(int argc, const char * argv[])
+{
+  string words, floats;
+  vector<int> expected, res, buffer;
+  int passes, p, n = 0;
+  bool ok;
+  double start;
+
+  if (argc < 3) {
+    cerr << "usage: bench_decode <kilobytes> <passes>" << endl;
+    return 1;
+  }
+  srand(1234);
+  words = streamWords(atoi(argv[1]) * 1024);
+  floats = floatList(atoi(argv[1]) * 1024);
+  passes = atoi(argv[2]);
+
+  expected = refDecodeWords(words);
+  cout << words.size() / 1024 << " KB of stream words (" << expected.size() << " words), " << passes << " passes" << endl;
+  start = now();
+  for (p = 0; p < passes; p++) {
+    res = refDecodeWords(words);
+  }
+  report("push_back decoder         ", words.size(), passes, now() - start);
+  start = now();
+  for (p = 0, ok = true; p < passes; p++) {
+    res = YAPI::_decodeWords(words);
+    ok = ok && res.size() == expected.size();
+  }
+  report("_decodeWords, vector      ", words.size(), passes, now() - start);
+  ok = ok && res == expected;
+  buffer.resize(words.size());
+  start = now();
+  for (p = 0; p < passes; p++) {
+    n = YAPI::_decodeWords(words.data(), (int)words.size(), &buffer[0], (int)buffer.size());
+  }
+  report("_decodeWords, buffer      ", words.size(), passes, now() - start);
+  buffer.resize(n);
+  check(ok && buffer == expected, "words decoded as by the push_back decoder");
+
+  expected = refDecodeFloats(floats);
+  cout << floats.size() / 1024 << " KB of floats (" << expected.size() << " values), " << passes << " passes" << endl;
+  start = now();
+  for (p = 0; p < passes; p++) {
+    res = refDecodeFloats(floats);
+  }
+  report("push_back decoder         ", floats.size(), passes, now() - start);
+  start = now();
+  for (p = 0, ok = true; p < passes; p++) {
+    res = YAPI::_decodeFloats(floats);
+    ok = ok && res.size() == expected.size();
+  }
+  report("_decodeFloats, vector     ", floats.size(), passes, now() - start);
+  ok = ok && res == expected;
+  buffer.resize((floats.size() + 1) / 2);
+  start = now();
+  for (p = 0; p < passes; p++) {
+    n = YAPI::_decodeFloats(floats.data(), (int)floats.size(), &buffer[0], (int)buffer.size());
+  }
+  report("_decodeFloats, buffer     ", floats.size(), passes, now() - start);
+  buffer.resize(n);
+  check(ok && buffer == expected, "floats decoded as by the push_back decoder");
+
+  cout << (failures ? "FAILED" : "PASSED") << endl;
+  return failures ? 1 : 0;
+}
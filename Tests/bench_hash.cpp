@@ -0,0 +1,204 @@
+/*********************************************************************
+ *
+ * Stress benchmark of the string table (yhash.c)
+ *
+ * Several threads intern distinct strings while others look up the
+ * strings already interned, without lock. Measures the insertion and
+ * lookup rates, and checks that every lookup finds the reference given
+ * at insertion. A yStrRef is 16 bits wide (two of them make a
+ * YAPI_FUNCTION), so the table holds about NB_MAX_HASH_ENTRIES -
+ * NB_HASH_BLK_RESERVE strings: with 100000 strings, the bench
+ * checks that every string up to that capacity is interned and reads
+ * back, that the others are refused (INVALID_HASH_IDX) and read back as
+ * an empty string, and that the white and yellow pages refuse to register
+ * a device or a function whose name could not be interned. No hub is
+ * needed. Typical use, 100000 strings, 4 writers and 4 readers:
+ *   Binary_Linux/64bits/bench_hash 100000 4 4
+ *
+ *********************************************************************/
+
+#include "yapi/yapi.h"
+#include "yapi/yhash.h"
+#include <iostream>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+using namespace std;
+
+#define NOT_YET_INTERNED    (-2)
+
+static int failures = 0;
+static int nbStrings, nbWriters, nbReaders;
+static vector<string> strings;
+static vector<yStrRef> refs;         // reference given by yHashPutStr, or NOT_YET_INTERNED
+static volatile int writersDone = 0;
+static u64 nbLookups = 0, nbMismatches = 0;
+
+static void check(bool cond, const string& what)
+{
+  cout << (cond ? "ok       " : "FAILED   ") << what << endl;
+  if (!cond) {
+    failures++;
+  }
+}
+
+// Tell if a lookup of string i agrees with the reference given at insertion
+static bool lookupMatches(int i)
+{
+  yStrRef ref = __atomic_load_n(&refs[i], __ATOMIC_ACQUIRE);
+
+  if (ref == NOT_YET_INTERNED) {
+    return true;
+  }
+  if (yHashTestStr(strings[i].c_str()) != ref) {
+    return false;
+  }
+  return ref == INVALID_HASH_IDX || strings[i] == yHashGetStrPtr(ref);
+}
+
+// Intern the strings i such that i % nbWriters == id
+static void* writerThread(void *arg)
+{
+  int id = (int)(size_t)arg;
+
+  for (int i = id; i < nbStrings; i += nbWriters) {
+    __atomic_store_n(&refs[i], yHashPutStr(strings[i].c_str()), __ATOMIC_RELEASE);
+  }
+  __atomic_add_fetch(&writersDone, 1, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+// Look up random strings until the writers are done
+static void* readerThread(void *arg)
+{
+  unsigned seed = (unsigned)(size_t)arg;
+  u64 lookups = 0, mismatches = 0;
+
+  while (__atomic_load_n(&writersDone, __ATOMIC_ACQUIRE) < nbWriters) {
+    if (!lookupMatches(rand_r(&seed) % nbStrings)) {
+      mismatches++;
+    }
+    lookups++;
+  }
+  __atomic_add_fetch(&nbLookups, lookups, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&nbMismatches, mismatches, __ATOMIC_RELAXED);
+  return NULL;
+}
+
+// Look up all the strings, split among the threads
+static void* scanThread(void *arg)
+{
+  int id = (int)(size_t)arg;
+  u64 mismatches = 0;
+
+  for (int i = id; i < nbStrings; i += nbReaders) {
+    if (!lookupMatches(i)) {
+      mismatches++;
+    }
+  }
+  __atomic_add_fetch(&nbMismatches, mismatches, __ATOMIC_RELAXED);
+  return NULL;
+}
+
+static u64 runThreads(int count, void* (*fn)(void*), vector<pthread_t>& threads)
+{
+  u64 start = yapiGetTickCount();
+
+  for (int i = 0; i < count; i++) {
+    pthread_create(&threads[i], NULL, fn, (void*)(size_t)i);
+  }
+  return start;
+}
+
+int main(int argc, const char * argv[])
+{
+  char errmsg[YOCTO_ERRMSG_LEN];
+  char buf[32];
+  vector<pthread_t> writers, readers;
+  set<yStrRef> distinct;
+  int i, accepted = 0, refused = 0, capacity, nbDevices;
+  u64 start, insertTime, scanTime;
+
+  if (argc < 4) {
+    cerr << "usage: bench_hash <strings> <writer_threads> <reader_threads>" << endl;
+    return 1;
+  }
+  nbStrings = atoi(argv[1]);
+  nbWriters = atoi(argv[2]);
+  nbReaders = atoi(argv[3]);
+  if (yapiInitAPI(Y_DETECT_NONE, errmsg) != YAPI_SUCCESS) {
+    cerr << "InitAPI error: " << errmsg << endl;
+    return 1;
+  }
+  for (i = 0; i < nbStrings; i++) {
+    snprintf(buf, sizeof(buf), "BENCHSTR-%06d.func%d", i, i % 97);
+    strings.push_back(buf);
+  }
+  refs.assign(nbStrings, NOT_YET_INTERNED);
+  nbDevices = wpEntryCount();
+  writers.resize(nbWriters);
+  readers.resize(nbReaders);
+
+  // insertion, with concurrent lookups
+  start = runThreads(nbWriters, writerThread, writers);
+  for (i = 0; i < nbReaders; i++) {
+    pthread_create(&readers[i], NULL, readerThread, (void*)(size_t)(i + 1));
+  }
+  for (i = 0; i < nbWriters; i++) {
+    pthread_join(writers[i], NULL);
+  }
+  insertTime = yapiGetTickCount() - start;
+  for (i = 0; i < nbReaders; i++) {
+    pthread_join(readers[i], NULL);
+  }
+  for (i = 0; i < nbStrings; i++) {
+    if (refs[i] == INVALID_HASH_IDX) {
+      refused++;
+    } else {
+      accepted++;
+      distinct.insert(refs[i]);
+    }
+  }
+  cout << nbStrings << " strings, " << nbWriters << " writers, " << nbReaders << " readers" << endl;
+  cout << "  insert: " << accepted << " strings interned, " << refused << " refused, "
+       << (insertTime ? nbStrings * 1000.0 / insertTime : 0) << " strings/s" << endl;
+  cout << "  concurrent lookups: " << (insertTime ? nbLookups * 1000.0 / insertTime : 0) << " lookups/s" << endl;
+  check(nbMismatches == 0, "concurrent lookups agree with the insertions");
+  check((int)distinct.size() == accepted, "a distinct reference for each string");
+  // the strings given by yHashInit and the blocks of the pages use a few slots
+  capacity = NB_MAX_HASH_ENTRIES - NB_HASH_BLK_RESERVE;
+  check(accepted + refused == nbStrings, "each string either interned or refused");
+  check(accepted >= min(nbStrings, capacity - 64) && accepted <= capacity,
+        "table filled up to its capacity (" + to_string(capacity) + " strings)");
+  check(nbStrings <= capacity || refused >= nbStrings - capacity, "strings beyond the capacity refused");
+  check(yHashGetStrLen(INVALID_HASH_IDX) == 0 && string(yHashGetStrPtr(INVALID_HASH_IDX)) == "",
+        "a refused string reads back as an empty string");
+  if (refused > 0) {
+    yStrRef serial = yHashPutStr("FULLTBL1-00001");
+    yStrRef funcId = yHashPutStr("fulltable1");
+    check(serial == INVALID_HASH_IDX && funcId == INVALID_HASH_IDX, "new names refused once full");
+    check(wpRegister(-1, serial, INVALID_HASH_IDX, INVALID_HASH_IDX, 0, yHashUrlAPI(), 0) < 0 &&
+          wpEntryCount() == nbDevices, "device with a refused serial not registered");
+    check(ypRegister(YSTRREF_SENSOR_STRING, YSTRREF_EMPTY_STRING, funcId, INVALID_HASH_IDX, 0, 1, NULL) < 0,
+          "function with a refused id not registered");
+  }
+
+  // lookups only
+  nbMismatches = 0;
+  start = runThreads(nbReaders, scanThread, readers);
+  for (i = 0; i < nbReaders; i++) {
+    pthread_join(readers[i], NULL);
+  }
+  scanTime = yapiGetTickCount() - start;
+  cout << "  lookups: " << (scanTime ? nbStrings * 1000.0 / scanTime : 0) << " lookups/s" << endl;
+  check(nbMismatches == 0, "all strings found again");
+
+  yapiFreeAPI();
+  cout << (failures ? "FAILED" : "PASSED") << endl;
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,185 @@
+/*********************************************************************
+ *
+ * Benchmark of the JSON parser (yJsonParse in yjson.c)
+ *
+ * Parses an api.json-like document of the given size, with a module,
+ * many functions and the white and yellow pages, and measures the
+ * throughput in MB/s of:
+ *   - a full tokenization, on the whole document and on 1460-byte
+ *     chunks as received from the network (same tokens expected);
+ *   - a walk which skips every top-level member with yJsonSkip;
+ *   - yapiJsonGetPath on an attribute of the last function.
+ * No hub is needed. Typical use, 64 KB document, 2000 passes:
+ *   Binary_Linux/64bits/bench_json 64 2000
+ *
+ *********************************************************************/
+
+#include "yapi/yapi.h"
+#include "yapi/yjson.h"
+#include <iostream>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+using namespace std;
+
+#define CHUNK_SIZE      1460
+
+static int failures = 0;
+
+static void check(bool cond, const string& what)
+{
+  cout << (cond ? "ok       " : "FAILED   ") << what << endl;
+  if (!cond) {
+    failures++;
+  }
+}
+
+// monotonic time in [s]
+static double now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// An api.json-like document of at least size bytes, made of nbFunctions functions
+static string apiJson(int size, int& nbFunctions)
+{
+  string module = "{\"module\":{\"productName\":\"Yocto-Meteo-V2\",\"serialNumber\":\"METEOMK2-12345\","
+                  "\"logicalName\":\"\",\"productId\":119,\"productRelease\":1,\"firmwareRelease\":\"55855\","
+                  "\"persistentSettings\":1,\"luminosity\":50,\"beacon\":0,\"upTime\":123456789,"
+                  "\"usbCurrent\":24,\"rebootCountdown\":0,\"userVar\":0}";
+  string functions, white, yellow;
+  char buf[512];
+  int i;
+
+  for (i = 0; (int)(module.size() + functions.size() + white.size() + yellow.size()) < size; i++) {
+    snprintf(buf, sizeof(buf), ",\"temperature%d\":{\"logicalName\":\"room %d \\\"east\\\"\","
+             "\"advertisedValue\":\"%d.25\",\"unit\":\"'C\",\"currentValue\":%d,\"lowestValue\":1245184,"
+             "\"highestValue\":1638400,\"currentRawValue\":%d,\"logFrequency\":\"1/s\","
+             "\"reportFrequency\":\"OFF\",\"advMode\":0,\"calibrationParam\":\"0,\","
+             "\"resolution\":6,\"sensorState\":0,\"sensorType\":\"PT100_3WIRES\",\"signalValue\":0,"
+             "\"signalUnit\":\"Ohms\",\"command\":\"\"}", i + 1, i + 1, 20 + i % 10, 1310720 + i, 1310720 + i);
+    functions += buf;
+    snprintf(buf, sizeof(buf), "%s{\"serialNumber\":\"METEOMK2-%05d\",\"logicalName\":\"\",\"productName\":"
+             "\"Yocto-Meteo-V2\",\"productId\":119,\"networkUrl\":\"/bySerial/METEOMK2-%05d/api\","
+             "\"beacon\":0,\"index\":%d}", (i ? "," : ""), i, i, i);
+    white += buf;
+    snprintf(buf, sizeof(buf), "%s{\"baseType\":0,\"hardwareId\":\"METEOMK2-%05d.temperature%d\","
+             "\"logicalName\":\"\",\"advertisedValue\":\"%d.25\",\"index\":%d,\"sequence\":%d}",
+             (i ? "," : ""), i, i + 1, 20 + i % 10, i, i);
+    yellow += buf;
+  }
+  nbFunctions = i;
+  return module + functions + ",\"services\":{\"whitePages\":[" + white +
+         "],\"yellowPages\":{\"Temperature\":[" + yellow + "]}}}";
+}
+
+// Number of tokens of the document, fed in chunks of the given size
+static int tokenize(const string& json, int chunk)
+{
+  yJsonStateMachine j;
+  const char *base = json.c_str(), *limit = base + json.size();
+  yJsonRetCode res;
+  int tokens = 0;
+
+  j.src = base;
+  j.end = (chunk && base + chunk < limit ? base + chunk : limit);
+  j.st = YJSON_START;
+  while (1) {
+    res = yJsonParse(&j);
+    if (res == YJSON_PARSE_AVAIL) {
+      tokens++;
+    } else if (res == YJSON_NEED_INPUT && j.end < limit) {
+      j.end = (j.end + chunk < limit ? j.end + chunk : limit);
+    } else {
+      break;
+    }
+  }
+  return (res == YJSON_FAILED ? -1 : tokens);
+}
+
+// Number of top-level members, each of them skipped
+static int skipMembers(const string& json)
+{
+  yJsonStateMachine j;
+  int members = 0;
+
+  j.src = json.c_str();
+  j.end = j.src + json.size();
+  j.st = YJSON_START;
+  if (yJsonParse(&j) != YJSON_PARSE_AVAIL || j.st != YJSON_PARSE_STRUCT) {
+    return -1;
+  }
+  while (yJsonParse(&j) == YJSON_PARSE_AVAIL && j.st == YJSON_PARSE_MEMBNAME) {
+    members++;
+    yJsonSkip(&j, 1);
+  }
+  return members;
+}
+
+static void report(const char *name, size_t bytes, int passes, double elapsed)
+{
+  cout << "  " << name << ": " << (double)bytes * passes / elapsed / 1e6 << " MB/s, "
+       << elapsed * 1e6 / passes << " us per document" << endl;
+}
+
+int main(int argc, const char * argv[])
+{
+  char errmsg[YOCTO_ERRMSG_LEN];
+  char path[64], expected[16];
+  const char *result;
+  string json;
+  int passes, p, nbFunctions, tokens, res = 0;
+  bool ok;
+  double start;
+
+  if (argc < 3) {
+    cerr << "usage: bench_json <kilobytes> <passes>" << endl;
+    return 1;
+  }
+  json = apiJson(atoi(argv[1]) * 1024, nbFunctions);
+  passes = atoi(argv[2]);
+  cout << json.size() / 1024 << " KB api.json-like document, " << nbFunctions << " functions, "
+       << passes << " passes" << endl;
+
+  tokens = tokenize(json, 0);
+  start = now();
+  for (p = 0, ok = true; p < passes; p++) {
+    ok = ok && tokenize(json, 0) == tokens;
+  }
+  report("tokenize, whole document  ", json.size(), passes, now() - start);
+  start = now();
+  for (p = 0; p < passes; p++) {
+    ok = ok && tokenize(json, CHUNK_SIZE) == tokens;
+  }
+  report("tokenize, 1460-byte chunks", json.size(), passes, now() - start);
+  check(tokens > 0 && ok, "same tokens on the whole document and on chunks");
+
+  start = now();
+  for (p = 0, ok = true; p < passes; p++) {
+    ok = ok && skipMembers(json) == nbFunctions + 2;
+  }
+  report("skip top-level members    ", json.size(), passes, now() - start);
+  check(ok, "all top-level members skipped");
+
+  snprintf(path, sizeof(path), "temperature%d|currentValue", nbFunctions);
+  snprintf(expected, sizeof(expected), "%d", 1310720 + nbFunctions - 1);
+  start = now();
+  for (p = 0, ok = true; p < passes; p++) {
+    res = yapiJsonGetPath(path, json.c_str(), (int)json.size(), &result, errmsg);
+    ok = ok && res == (int)strlen(expected) && memcmp(result, expected, res) == 0;
+    if (res > 0) {
+      yapiFreeMem((void*)result);
+    }
+  }
+  report("yapiJsonGetPath, last one ", json.size(), passes, now() - start);
+  check(ok, "attribute of the last function found");
+
+  cout << (failures ? "FAILED" : "PASSED") << endl;
+  return failures ? 1 : 0;
+}
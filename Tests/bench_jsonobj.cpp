@@ -0,0 +1,194 @@
+/*********************************************************************
+ *
+ * Benchmark of the JSON object tree (YJSONObject in yocto_api.cpp)
+ *
+ * Parses an api.json-like document as YDevice::requestAPI does, and
+ * counts the heap allocations and measures the time needed to:
+ *   - read one attribute of one function: only the objects on the way
+ *     are parsed;
+ *   - read every node of the document, which builds the same tree as
+ *     the parser which created all the nodes up front;
+ *   - look up members of an object already parsed, with the hashed
+ *     index (more than YJSON_INDEX_THRESHOLD members) and without.
+ * No hub is needed. Typical use, 64 KB document, 500 passes:
+ *   Binary_Linux/64bits/bench_jsonobj 64 500
+ *
+ *********************************************************************/
+
+#include "yocto_api.h"
+#include <iostream>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+using namespace std;
+
+static int failures = 0;
+static volatile u64 allocations = 0;
+
+void* operator new(size_t size)
+{
+  void *ptr = malloc(size ? size : 1);
+
+  if (!ptr) {
+    throw bad_alloc();
+  }
+  __sync_fetch_and_add(&allocations, 1);
+  return ptr;
+}
+
+void operator delete(void *ptr) throw()
+{
+  free(ptr);
+}
+
+static void check(bool cond, const string& what)
+{
+  cout << (cond ? "ok       " : "FAILED   ") << what << endl;
+  if (!cond) {
+    failures++;
+  }
+}
+
+// monotonic time in [us]
+static double now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// An api.json-like document of at least size bytes, made of nbFunctions functions
+static string apiJson(int size, int& nbFunctions)
+{
+  string module = "{\"module\":{\"productName\":\"Yocto-Meteo-V2\",\"serialNumber\":\"METEOMK2-12345\","
+                  "\"logicalName\":\"\",\"productId\":119,\"productRelease\":1,\"firmwareRelease\":\"55855\","
+                  "\"persistentSettings\":1,\"luminosity\":50,\"beacon\":0,\"upTime\":123456789,"
+                  "\"usbCurrent\":24,\"rebootCountdown\":0,\"userVar\":0}";
+  string functions, white, yellow;
+  char buf[512];
+  int i;
+
+  for (i = 0; (int)(module.size() + functions.size() + white.size() + yellow.size()) < size; i++) {
+    snprintf(buf, sizeof(buf), ",\"temperature%d\":{\"logicalName\":\"room %d\","
+             "\"advertisedValue\":\"%d.25\",\"unit\":\"'C\",\"currentValue\":%d,\"lowestValue\":1245184,"
+             "\"highestValue\":1638400,\"currentRawValue\":%d,\"logFrequency\":\"1/s\","
+             "\"reportFrequency\":\"OFF\",\"advMode\":0,\"calibrationParam\":\"0,\","
+             "\"resolution\":6,\"sensorState\":0,\"sensorType\":\"PT100_3WIRES\",\"signalValue\":0,"
+             "\"signalUnit\":\"Ohms\",\"command\":\"\"}", i + 1, i + 1, 20 + i % 10, 1310720 + i, 1310720 + i);
+    functions += buf;
+    snprintf(buf, sizeof(buf), "%s{\"serialNumber\":\"METEOMK2-%05d\",\"logicalName\":\"\",\"productName\":"
+             "\"Yocto-Meteo-V2\",\"productId\":119,\"networkUrl\":\"/bySerial/METEOMK2-%05d/api\","
+             "\"beacon\":0,\"index\":%d}", (i ? "," : ""), i, i, i);
+    white += buf;
+    snprintf(buf, sizeof(buf), "%s{\"baseType\":0,\"hardwareId\":\"METEOMK2-%05d.temperature%d\","
+             "\"logicalName\":\"\",\"advertisedValue\":\"%d.25\",\"index\":%d,\"sequence\":%d}",
+             (i ? "," : ""), i, i + 1, 20 + i % 10, i, i);
+    yellow += buf;
+  }
+  nbFunctions = i;
+  return module + functions + ",\"services\":{\"whitePages\":[" + white +
+         "],\"yellowPages\":{\"Temperature\":[" + yellow + "]}}}";
+}
+
+// Access every node below node, return their number
+static int walk(YJSONContent *node)
+{
+  int count = 1;
+
+  if (node->getJSONType() == OBJECT) {
+    YJSONObject *obj = (YJSONObject*)node;
+    vector<string> keys = obj->keys();
+    for (size_t i = 0; i < keys.size(); i++) {
+      count += walk(obj->get(keys[i]));
+    }
+  } else if (node->getJSONType() == ARRAY) {
+    YJSONArray *arr = (YJSONArray*)node;
+    for (int i = 0; i < arr->length(); i++) {
+      count += walk(arr->get(i));
+    }
+  }
+  return count;
+}
+
+static void report(const char *name, u64 allocs, int passes, double elapsed)
+{
+  cout << "  " << name << ": " << allocs / passes << " allocations, " << elapsed / passes << " us" << endl;
+}
+
+int main(int argc, const char * argv[])
+{
+  string json, function, value, expected;
+  char buf[64];
+  int passes, p, nbFunctions, nodes = 0;
+  u64 allocs, oneAllocs;
+  bool ok;
+  double start;
+
+  if (argc < 3) {
+    cerr << "usage: bench_jsonobj <kilobytes> <passes>" << endl;
+    return 1;
+  }
+  json = apiJson(atoi(argv[1]) * 1024, nbFunctions);
+  passes = atoi(argv[2]);
+  cout << json.size() / 1024 << " KB api.json-like document, " << nbFunctions << " functions, "
+       << passes << " passes" << endl;
+  snprintf(buf, sizeof(buf), "temperature%d", nbFunctions);
+  function = buf;
+  snprintf(buf, sizeof(buf), "%d.25", 20 + (nbFunctions - 1) % 10);
+  expected = buf;
+
+  // parse, then read one attribute of the last function
+  allocs = allocations;
+  start = now();
+  for (p = 0, ok = true; p < passes; p++) {
+    YJSONObject obj(json);
+    obj.parse();
+    value = obj.getYJSONObject(function)->getString("advertisedValue");
+    ok = ok && value == expected;
+  }
+  oneAllocs = allocations - allocs;
+  report("parse, read one attribute  ", oneAllocs, passes, now() - start);
+  check(ok, "attribute of the last function read");
+
+  // parse, then read every node
+  allocs = allocations;
+  start = now();
+  for (p = 0; p < passes; p++) {
+    YJSONObject obj(json);
+    obj.parse();
+    nodes = walk(&obj);
+  }
+  allocs = allocations - allocs;
+  report("parse, read every node     ", allocs, passes, now() - start);
+  cout << "  " << nodes << " nodes in the tree" << endl;
+  check(oneAllocs * 10 < allocs, "reading one attribute allocates less than a tenth of the whole tree");
+
+  // lookups in objects already parsed
+  {
+    YJSONObject obj(json);
+    YJSONObject *entry;
+    int lookups = passes * 1000;
+
+    obj.parse();
+    obj.has(function);
+    entry = obj.getYJSONObject("services")->getYJSONObject("yellowPages")->getYJSONArray("Temperature")->getYJSONObject(0);
+    entry->has("logicalName");
+    start = now();
+    for (p = 0, ok = true; p < lookups; p++) {
+      ok = ok && obj.has(function);
+    }
+    cout << "  has(), " << nbFunctions + 2 << " members, indexed : " << (now() - start) * 1000 / lookups << " ns" << endl;
+    start = now();
+    for (p = 0; p < lookups; p++) {
+      ok = ok && entry->has("sequence");
+    }
+    cout << "  has(), 6 members, linear     : " << (now() - start) * 1000 / lookups << " ns" << endl;
+    check(ok, "members found again");
+  }
+
+  cout << (failures ? "FAILED" : "PASSED") << endl;
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,184 @@
+/*********************************************************************
+ *
+ * Benchmark of the pattern searches (ymemfindEx, ySeekFifoEx, ySeekFifo32)
+ *
+ * Searches a pattern which is only found at the end of a buffer filled
+ * with datalogger-like text, as when looking for the end of the headers
+ * or for a chunk separator in a large reply, and compares the throughput
+ * with a plain byte-by-byte search. The fifo searches are made on fifos
+ * whose content wraps around the end of their buffer. No hub is needed.
+ * Typical use, 8 MB of text and 20 passes:
+ *   Binary_Linux/64bits/bench_memfind 8 20
+ *
+ *********************************************************************/
+
+extern "C" {
+#include "yapi/yproto.h"
+}
+#include <iostream>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+using namespace std;
+
+#define FIFO16_SIZE     32768
+
+static int failures = 0;
+
+static void check(bool cond, const string& what)
+{
+  cout << (cond ? "ok       " : "FAILED   ") << what << endl;
+  if (!cond) {
+    failures++;
+  }
+}
+
+// monotonic time in [s]
+static double now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static u8 fold(u8 c, bool textCompare)
+{
+  return (textCompare && c >= 'a' && c <= 'z' ? (u8)(c - 32) : c);
+}
+
+// The search used before ymemfindEx
+static int naiveFind(const u8 *data, u32 len, const u8 *pattern, u32 patlen, bool textCompare)
+{
+  for (u32 pos = 0; pos + patlen <= len; pos++) {
+    u32 i = 0;
+    while (i < patlen && fold(data[pos + i], textCompare) == fold(pattern[i], textCompare)) {
+      i++;
+    }
+    if (i == patlen) {
+      return (int)pos;
+    }
+  }
+  return -1;
+}
+
+// Rows of a datalogger stream, as sent by the hub
+static void datalogText(vector<u8>& text, u32 len)
+{
+  char row[64];
+  u32 i = 0;
+
+  text.clear();
+  while (text.size() < len) {
+    int n = snprintf(row, sizeof(row), "%u,%.3f,%.3f,%.3f,\n", 1700000000 + i, 20 + (i % 97) / 10.0,
+                     21 + (i % 89) / 10.0, 19 + (i % 83) / 10.0);
+    text.insert(text.end(), row, row + n);
+    i++;
+  }
+  text.resize(len);
+}
+
+static void report(const char *name, u64 bytes, double elapsed, double naiveRate)
+{
+  double rate = bytes / elapsed / 1e6;
+
+  cout << "  " << name << ": " << rate << " MB/s";
+  if (naiveRate > 0) {
+    cout << " (x" << rate / naiveRate << ")";
+  }
+  cout << endl;
+}
+
+int main(int argc, const char * argv[])
+{
+  static const u8 upper[] = "\r\n\r\nEND-OF-STREAM";
+  static const u8 lower[] = "\r\n\r\nend-of-stream";
+  u32 patlen = sizeof(upper) - 1;
+  vector<u8> text, fifoBuffer, buffer16(FIFO16_SIZE);
+  yFifoBuf32 fifo32;
+  yFifoBuf fifo;
+  u32 len, fifoLen, pos, i;
+  int passes, p, expected, found;
+  bool ok;
+  double start, naiveExact, naiveText;
+
+  if (argc < 3) {
+    cerr << "usage: bench_memfind <megabytes> <passes>" << endl;
+    return 1;
+  }
+  len = (u32)atoi(argv[1]) * 1024 * 1024;
+  passes = atoi(argv[2]);
+  datalogText(text, len);
+  memcpy(&text[len - patlen], upper, patlen);
+  expected = (int)(len - patlen);
+  cout << len / (1024 * 1024) << " MB of datalogger text, pattern at the end, " << passes << " passes" << endl;
+
+  // contiguous buffer
+  start = now();
+  for (p = 0, ok = true; p < passes; p++) {
+    ok = ok && naiveFind(&text[0], len, upper, patlen, false) == expected;
+  }
+  naiveExact = (u64)len * passes / (now() - start) / 1e6;
+  report("byte-by-byte, exact        ", (u64)len * passes, (u64)len * passes / naiveExact / 1e6, 0);
+  start = now();
+  for (p = 0; p < passes; p++) {
+    ok = ok && naiveFind(&text[0], len, lower, patlen, true) == expected;
+  }
+  naiveText = (u64)len * passes / (now() - start) / 1e6;
+  report("byte-by-byte, ignore case  ", (u64)len * passes, (u64)len * passes / naiveText / 1e6, 0);
+  start = now();
+  for (p = 0; p < passes; p++) {
+    ok = ok && ymemfindEx(&text[0], len, upper, patlen, 0) == expected;
+  }
+  report("ymemfindEx, exact          ", (u64)len * passes, now() - start, naiveExact);
+  start = now();
+  for (p = 0; p < passes; p++) {
+    ok = ok && ymemfindEx(&text[0], len, lower, patlen, 1) == expected;
+  }
+  report("ymemfindEx, ignore case    ", (u64)len * passes, now() - start, naiveText);
+  check(ok, "pattern found at the end of the buffer");
+
+  // 32-bit fifo, with its content starting at the middle of its buffer
+  fifoLen = 1;
+  while (fifoLen < len) {
+    fifoLen <<= 1;
+  }
+  fifoBuffer.resize(fifoLen);
+  yFifoInit32(&fifo32, &fifoBuffer[0], fifoLen, YFIFO32_LOCKED);
+  yPushFifo32(&fifo32, &text[0], fifoLen / 2);
+  yPopFifo32(&fifo32, NULL, fifoLen / 2);
+  yPushFifo32(&fifo32, &text[0], len);
+  start = now();
+  for (p = 0, ok = true; p < passes; p++) {
+    ok = ok && ySeekFifo32(&fifo32, lower, patlen, 0, 0, 1) == (u32)expected;
+  }
+  report("ySeekFifo32, ignore case   ", (u64)len * passes, now() - start, naiveText);
+  yFifoCleanup32(&fifo32);
+  check(ok, "pattern found in a wrapped 32-bit fifo");
+
+  // 16-bit fifos, filled again at each step (included in the time) so that
+  // the match moves around the wrap point
+  yFifoInit(&fifo, &buffer16[0], FIFO16_SIZE);
+  memcpy(&text[FIFO16_SIZE - patlen], upper, patlen);
+  start = now();
+  ok = true;
+  for (p = 0, pos = 0; p < passes; p++) {
+    for (i = 0; i < len / FIFO16_SIZE; i++) {
+      yFifoEmptyEx(&fifo);
+      pos = (pos + 4099) % FIFO16_SIZE;
+      yPushFifoEx(&fifo, &text[0], (u16)pos);
+      yPopFifoEx(&fifo, NULL, (u16)pos);
+      yPushFifoEx(&fifo, &text[0], (u16)FIFO16_SIZE);
+      found = ySeekFifoEx(&fifo, lower, (u16)patlen, 0, 0, 1);
+      ok = ok && found == (int)(FIFO16_SIZE - patlen);
+    }
+  }
+  report("ySeekFifoEx, ignore case   ", (u64)(len / FIFO16_SIZE) * FIFO16_SIZE * passes, now() - start, naiveText);
+  yFifoCleanup(&fifo);
+  check(ok, "pattern found in wrapped 16-bit fifos");
+
+  cout << (failures ? "FAILED" : "PASSED") << endl;
+  return failures ? 1 : 0;
+}
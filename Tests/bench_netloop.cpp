@@ -0,0 +1,151 @@
+/*********************************************************************
+ *
+ * Benchmark of many network hubs
+ *
+ * Registers a number of hubs, either with one helper thread per hub or
+ * on the shared network loops (YAPI::SetNetworkReactor), then measures
+ * for a few seconds the CPU used by the process and the delay between
+ * the time a notification is sent by the hub and the time its value
+ * callback is called. The stand-in hub must send the send time of the
+ * notifications (--notify-value stamp).
+ *
+ * Unresponsive hubs can be added: the library keeps trying to connect
+ * to them, which must not delay the notifications of the other hubs.
+ * The number of threads of the process is shown as well.
+ *
+ * Each stand-in hub counts as two devices. The library handles up to
+ * 1024 hubs (NBMAX_NET_HUB) and 2048 devices (NB_MAX_DEVICES).
+ *
+ * Typical use, 500 hubs and 5 unresponsive ones on 4 network loops:
+ *   python3 standin_hub.py --hubs 500 --dead 5 --notify-period 1000 --notify-value stamp \
+ *       -- Binary_Linux/64bits/bench_netloop 4444 500 5 4 10
+ *
+ *********************************************************************/
+
+#include "yocto_api.h"
+#include "yocto_temperature.h"
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+using namespace std;
+
+static vector<int> latencies;
+
+// wall clock time in [ms], modulo 10^6 like the stamps of the stand-in hub
+static int stampNow(void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return (int)(((u64)tv.tv_sec * 1000 + tv.tv_usec / 1000) % 1000000);
+}
+
+// CPU time used by the process in [ms]
+static double cpuTime(void)
+{
+  struct rusage usage;
+
+  getrusage(RUSAGE_SELF, &usage);
+  return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000.0 +
+         (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000.0;
+}
+
+// number of threads of the process, -1 when unknown (Linux only)
+static int threadCount(void)
+{
+  FILE *f = fopen("/proc/self/status", "r");
+  char line[256];
+  int n = -1;
+
+  if (f == NULL) {
+    return -1;
+  }
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (sscanf(line, "Threads: %d", &n) == 1) {
+      break;
+    }
+  }
+  fclose(f);
+  return n;
+}
+
+static void valueCallback(YTemperature *func, const string& value)
+{
+  int delay = (stampNow() - atoi(value.c_str()) + 1000000) % 1000000;
+
+  latencies.push_back(delay);
+}
+
+int main(int argc, const char * argv[])
+{
+  string errmsg;
+  char url[32];
+  YTemperature *sensor;
+  int port, hubs, dead, loops, seconds, i, nbsensors = 0;
+  double cpuStart, cpuUsed;
+  u64 start, elapsed;
+
+  if (argc < 6) {
+    cerr << "usage: bench_netloop <first_port> <hubs> <dead_hubs> <network_loops> <seconds>" << endl;
+    return 1;
+  }
+  port = atoi(argv[1]);
+  hubs = atoi(argv[2]);
+  dead = atoi(argv[3]);
+  loops = atoi(argv[4]);
+  seconds = atoi(argv[5]);
+  if (loops > 0 && YAPI::SetNetworkReactor(loops, false, errmsg) != YAPI_SUCCESS) {
+    cerr << "SetNetworkReactor error: " << errmsg << endl;
+    return 1;
+  }
+  for (i = 0; i < hubs; i++) {
+    snprintf(url, sizeof(url), "127.0.0.1:%d", port + i);
+    if (yRegisterHub(url, errmsg) != YAPI_SUCCESS) {
+      cerr << "RegisterHub error: " << errmsg << endl;
+      return 1;
+    }
+  }
+  for (i = 0; i < dead; i++) {
+    snprintf(url, sizeof(url), "127.0.0.1:%d", port + hubs + i);
+    yPreregisterHub(url, errmsg);
+  }
+  for (sensor = yFirstTemperature(); sensor != NULL; sensor = sensor->nextTemperature()) {
+    sensor->registerValueCallback(valueCallback);
+    nbsensors++;
+  }
+  // let all the notification channels open
+  YAPI::Sleep(3000, errmsg);
+  latencies.clear();
+
+  cpuStart = cpuTime();
+  start = yGetTickCount();
+  while (yGetTickCount() - start < (u64)seconds * 1000) {
+    YAPI::Sleep(100, errmsg);
+  }
+  elapsed = yGetTickCount() - start;
+  cpuUsed = cpuTime() - cpuStart;
+
+  cout << hubs << " hubs, " << dead << " unresponsive, " << nbsensors << " sensors, "
+       << (loops > 0 ? loops : hubs + dead) << (loops > 0 ? " network loops" : " helper threads") << endl;
+  cout << "  " << threadCount() << " threads in the process" << endl;
+  cout << "  CPU: " << cpuUsed * 100.0 / elapsed << "% of one core" << endl;
+  if (latencies.empty()) {
+    cout << "  no notification received" << endl;
+  } else {
+    double sum = 0;
+    sort(latencies.begin(), latencies.end());
+    for (i = 0; i < (int)latencies.size(); i++) {
+      sum += latencies[i];
+    }
+    cout << "  " << latencies.size() * 1000.0 / elapsed << " notifications/s, latency avg "
+         << sum / latencies.size() << " ms, p99 " << latencies[latencies.size() * 99 / 100]
+         << " ms, max " << latencies.back() << " ms" << endl;
+  }
+  yFreeAPI();
+  return 0;
+}
@@ -0,0 +1,240 @@
+/*********************************************************************
+ *
+ * Benchmark of the socket poller (yPoller in ytcp.c)
+ *
+ * A thread waits on a set of idle sockets plus a WakeUpSocket, the way
+ * the network threads do, and the main thread rings the WakeUpSocket.
+ * Measures the delay between the ring and the return of the wait, with
+ * the poll() and epoll backends and with the select() loop that they
+ * replace. As in yHTTPMultiSelectReq, the poll() and select() sets are
+ * built again before each wait, the epoll set is built once. Then a
+ * datagram is sent to every socket and each backend must report all of
+ * them as ready, which checks the sets larger than the inline storage of
+ * yPoller. No hub is needed. Typical use, 1, 64 and 1000 sockets, 2000
+ * wake-ups each:
+ *   Binary_Linux/64bits/bench_poller 2000 1 64 1000
+ *
+ *********************************************************************/
+
+#include "yapi/ytcp.h"
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+using namespace std;
+
+#define MODE_SELECT     -1      // the select() loop used before yPoller
+
+static int mode;
+static vector<int> idle;        // sockets which never get any data
+static WakeUpSocket wuce;
+static volatile int rounds = 0, doneRounds = 0;
+static volatile bool stop = false;
+static vector<double> latencies;
+static double ringTime;
+static int failures = 0;
+
+static void check(bool cond, const string &what)
+{
+  cout << (cond ? "  ok       " : "  FAILED   ") << what << endl;
+  if (!cond) failures++;
+}
+
+// monotonic time in [us]
+static double now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// Wait for the wake-ups and record their latency
+static void* waiterThread(void *arg)
+{
+  char errmsg[YOCTO_ERRMSG_LEN];
+  yPoller poller;
+  u64 ready[YPOLLER_MAX_EVENTS];
+  fd_set fds;
+  struct timeval tv;
+  int res, maxfd;
+  size_t i;
+
+  if (mode == YPOLLER_EPOLL) {
+    yPollerInit(&poller, YPOLLER_EPOLL, errmsg);
+    for (i = 0; i < idle.size(); i++) {
+      yPollerAdd(&poller, idle[i], i, errmsg);
+    }
+    yPollerAdd(&poller, wuce.listensock, YPOLLER_WAKEUP_TAG, errmsg);
+  } else {
+    yPollerInit(&poller, YPOLLER_POLL, errmsg);
+  }
+  while (!stop) {
+    if (mode == MODE_SELECT) {
+      FD_ZERO(&fds);
+      maxfd = wuce.listensock;
+      FD_SET(wuce.listensock, &fds);
+      for (i = 0; i < idle.size(); i++) {
+        FD_SET(idle[i], &fds);
+        maxfd = max(maxfd, idle[i]);
+      }
+      tv.tv_sec = 0;
+      tv.tv_usec = 100000;
+      res = select(maxfd + 1, &fds, NULL, NULL, &tv);
+    } else {
+      if (mode == YPOLLER_POLL) {
+        yPollerClear(&poller);
+        yPollerAdd(&poller, wuce.listensock, YPOLLER_WAKEUP_TAG, errmsg);
+        for (i = 0; i < idle.size(); i++) {
+          yPollerAdd(&poller, idle[i], i, errmsg);
+        }
+      }
+      res = yPollerWait(&poller, ready, YPOLLER_MAX_EVENTS, 100, errmsg);
+    }
+    if (res > 0 && doneRounds < rounds) {
+      latencies.push_back(now() - ringTime);
+      yConsumeWakeUpSocket(&wuce, errmsg);
+      __sync_fetch_and_add(&doneRounds, 1);
+    }
+  }
+  yPollerFree(&poller);
+  return NULL;
+}
+
+static void runMode(int m, const char *name, int nbIdle, int nbWakeups)
+{
+  char errmsg[YOCTO_ERRMSG_LEN];
+  pthread_t waiter;
+  double sum = 0;
+  int i;
+
+  mode = m;
+  rounds = doneRounds = 0;
+  stop = false;
+  latencies.clear();
+  pthread_create(&waiter, NULL, waiterThread, NULL);
+  usleep(10000);
+  for (i = 0; i < nbWakeups; i++) {
+    rounds++;
+    ringTime = now();
+    yDringWakeUpSocket(&wuce, 1, errmsg);
+    while (doneRounds < rounds) {
+      usleep(20);
+    }
+    // let the waiter go back to its wait
+    usleep(200);
+  }
+  stop = true;
+  pthread_join(waiter, NULL);
+  sort(latencies.begin(), latencies.end());
+  for (i = 0; i < (int)latencies.size(); i++) {
+    sum += latencies[i];
+  }
+  cout << "  " << name << ": wake-up latency avg " << sum / latencies.size() << " us, p99 "
+       << latencies[latencies.size() * 99 / 100] << " us" << endl;
+}
+
+// Make every socket readable and check that the backend reports all of them
+static void runLive(int m, const char *name)
+{
+  char errmsg[YOCTO_ERRMSG_LEN];
+  struct sockaddr_in addr;
+  socklen_t addrlen;
+  yPoller poller;
+  vector<u64> ready(idle.size() + 1);
+  vector<bool> seen(idle.size(), false);
+  size_t i, nbseen = 0;
+  double start;
+  int res, tries;
+  char c = 0;
+
+  yPollerInit(&poller, m, errmsg);
+  for (i = 0; i < idle.size(); i++) {
+    yPollerAdd(&poller, idle[i], i, errmsg);
+    addrlen = sizeof(addr);
+    getsockname(idle[i], (struct sockaddr*)&addr, &addrlen);
+    sendto(idle[i], &c, 1, 0, (struct sockaddr*)&addr, addrlen);
+  }
+  start = now();
+  // epoll reports at most YPOLLER_MAX_EVENTS sockets per wait, the data is left
+  // in place so a level-triggered set reports the same sockets until all are seen
+  for (tries = 0; tries < 1000 && nbseen < idle.size(); tries++) {
+    res = yPollerWait(&poller, ready.data(), (int)ready.size(), 100, errmsg);
+    if (res < 0) {
+      cerr << "yPollerWait: " << errmsg << endl;
+      break;
+    }
+    for (int j = 0; j < res; j++) {
+      if (ready[j] < idle.size() && !seen[ready[j]]) {
+        seen[ready[j]] = true;
+        nbseen++;
+        if (m == YPOLLER_EPOLL) {
+          yPollerRemove(&poller, idle[ready[j]]);
+        }
+      }
+    }
+  }
+  cout << "  " << name << ": " << nbseen << " ready sockets reported in " << now() - start << " us" << endl;
+  check(nbseen == idle.size(), string(name) + " reports every live socket");
+  yPollerFree(&poller);
+  for (i = 0; i < idle.size(); i++) {
+    recv(idle[i], &c, 1, MSG_DONTWAIT);
+  }
+}
+
+int main(int argc, const char * argv[])
+{
+  char errmsg[YOCTO_ERRMSG_LEN];
+  struct sockaddr_in addr;
+  int nbWakeups, nbIdle, i, a, skt;
+
+  if (argc < 3) {
+    cerr << "usage: bench_poller <wakeups> <idle_sockets>..." << endl;
+    return 1;
+  }
+  nbWakeups = atoi(argv[1]);
+  yInitWakeUpSocket(&wuce);
+  if (yStartWakeUpSocket(&wuce, errmsg) != YAPI_SUCCESS) {
+    cerr << "WakeUpSocket error: " << errmsg << endl;
+    return 1;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  for (a = 2; a < argc; a++) {
+    nbIdle = atoi(argv[a]);
+    while ((int)idle.size() < nbIdle) {
+      skt = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+      if (skt < 0 || bind(skt, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        cerr << "unable to open " << nbIdle << " sockets" << endl;
+        return 1;
+      }
+      idle.push_back(skt);
+    }
+    cout << nbIdle << " idle sockets + 1 WakeUpSocket, " << nbWakeups << " wake-ups" << endl;
+    if (idle.back() < FD_SETSIZE) {
+      runMode(MODE_SELECT, "select() ", nbIdle, nbWakeups);
+    } else {
+      cout << "  select() : socket numbers above FD_SETSIZE" << endl;
+    }
+    runMode(YPOLLER_POLL, "poll()   ", nbIdle, nbWakeups);
+    runMode(YPOLLER_EPOLL, "epoll    ", nbIdle, nbWakeups);
+    cout << nbIdle << " live sockets" << endl;
+    runLive(YPOLLER_POLL, "poll()   ");
+    runLive(YPOLLER_EPOLL, "epoll    ");
+  }
+  for (i = 0; i < (int)idle.size(); i++) {
+    close(idle[i]);
+  }
+  yFreeWakeUpSocket(&wuce);
+  cout << (failures ? "FAILED" : "PASSED") << endl;
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,106 @@
+/*********************************************************************
+ *
+ * Benchmark of sensor reads served from notifications
+ *
+ * Reads get_currentValue() on all the temperature sensors of a hub, first
+ * from the device (YAPI::NotificationCacheValidity = 0), then from the
+ * values pushed by notification, and prints the average time per read.
+ *
+ * Typical use, with 100 devices of 10 sensors notifying every 500 ms:
+ *   python3 standin_hub.py --devices 100 --functions 10 --notify-period 500 \
+ *       -- Binary_Linux/64bits/bench_pushedvalues 127.0.0.1:4444
+ *
+ *********************************************************************/
+
+#include "yocto_api.h"
+#include "yocto_temperature.h"
+#include <iostream>
+#include <vector>
+#include <stdlib.h>
+#include <math.h>
+
+using namespace std;
+
+// Read all the sensors a number of times, return the average time per read in [us]
+static double timeReads(vector<YTemperature*>& sensors, int rounds, int& invalid)
+{
+  string errmsg;
+  u64    start, elapsed = 0;
+  size_t i;
+  int    r;
+
+  invalid = 0;
+  for (r = 0; r < rounds; r++) {
+    start = yGetTickCount();
+    for (i = 0; i < sensors.size(); i++) {
+      if (sensors[i]->get_currentValue() == Y_CURRENTVALUE_INVALID) {
+        invalid++;
+      }
+    }
+    elapsed += yGetTickCount() - start;
+    // let the library take the notifications received meanwhile
+    yHandleEvents(errmsg);
+  }
+  return elapsed * 1000.0 / ((double)rounds * sensors.size());
+}
+
+int main(int argc, const char * argv[])
+{
+  string errmsg;
+  vector<YTemperature*> sensors;
+  YTemperature *sensor;
+  double usDevice, usPushed, maxDiff = 0;
+  vector<double> fromDevice;
+  size_t i;
+  int invalid, rounds;
+
+  if (argc < 2) {
+    cerr << "usage: bench_pushedvalues <hub_url> [rounds]" << endl;
+    return 1;
+  }
+  rounds = (argc > 2 ? atoi(argv[2]) : 10);
+  if (yRegisterHub(argv[1], errmsg) != YAPI_SUCCESS) {
+    cerr << "RegisterHub error: " << errmsg << endl;
+    return 1;
+  }
+  for (sensor = yFirstTemperature(); sensor != NULL; sensor = sensor->nextTemperature()) {
+    sensors.push_back(sensor);
+  }
+  if (sensors.empty()) {
+    cerr << "No temperature sensor found" << endl;
+    return 1;
+  }
+  // first load of every function, not timed
+  for (i = 0; i < sensors.size(); i++) {
+    fromDevice.push_back(sensors[i]->get_currentValue());
+  }
+
+  YAPI::NotificationCacheValidity = 0;
+  usDevice = timeReads(sensors, rounds, invalid);
+  cout << sensors.size() << " sensors, " << rounds << " rounds" << endl;
+  cout << "from device:        " << usDevice << " us/read (" << invalid << " invalid)" << endl;
+
+  // let every sensor send at least one notification
+  YAPI::NotificationCacheValidity = 2000;
+  ySleep(1500, errmsg);
+  usPushed = timeReads(sensors, rounds, invalid);
+  cout << "from notifications: " << usPushed << " us/read (" << invalid << " invalid)" << endl;
+  if (usPushed > 0) {
+    cout << "speedup:            " << usDevice / usPushed << "x" << endl;
+  }
+
+  // pushed and loaded values must agree (the stand-in hub moves them slowly)
+  for (i = 0; i < sensors.size(); i++) {
+    double pushed = sensors[i]->get_currentValue();
+    sensors[i]->clearCache();
+    YAPI::NotificationCacheValidity = 0;
+    double loaded = sensors[i]->get_currentValue();
+    YAPI::NotificationCacheValidity = 2000;
+    if (fabs(pushed - loaded) > maxDiff) {
+      maxDiff = fabs(pushed - loaded);
+    }
+  }
+  cout << "max difference between pushed and loaded values: " << maxDiff << endl;
+  yFreeAPI();
+  return 0;
+}
@@ -0,0 +1,193 @@
+/*********************************************************************
+ *
+ * Benchmark of the event wait (YAPI::Sleep, YAPI::WaitForEvents)
+ *
+ * Measures the CPU used by a process which only waits for notifications,
+ * and the delay between the time a notification is forwarded by a hub
+ * thread and the time its value callback is called, with:
+ *   - YAPI::Sleep, which blocks until an event is signaled;
+ *   - the loop used before, HandleEvents() and a 2 ms sleep until the
+ *     deadline.
+ * The notifications are forwarded by a thread of the benchmark, as the
+ * hub threads do, at random intervals of 1 to 3 ms. The hub sends no
+ * notification by itself.
+ * Typical use, 5 seconds of idle wait, 2000 notifications:
+ *   python3 standin_hub.py --notify-period 0 -- Binary_Linux/64bits/bench_waitevents 127.0.0.1:4444 5 2000
+ *
+ *********************************************************************/
+
+#include "yocto_api.h"
+#include "yocto_temperature.h"
+#include "yapi/yapi.h"
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+using namespace std;
+
+static int failures = 0;
+static YFUN_DESCR descr;
+static int nbNotifications;
+static volatile bool forwarding = false;
+static volatile double sentAt = 0;
+static volatile int delivered = 0;
+static vector<double> latencies;
+
+static void check(bool cond, const string& what)
+{
+  cout << (cond ? "ok       " : "FAILED   ") << what << endl;
+  if (!cond) {
+    failures++;
+  }
+}
+
+// monotonic time in [us]
+static double now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// CPU time used by the process in [ms]
+static double cpuTime(void)
+{
+  struct rusage usage;
+
+  getrusage(RUSAGE_SELF, &usage);
+  return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000.0 +
+         (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000.0;
+}
+
+static void valueCallback(YTemperature *func, const string& value)
+{
+  if (forwarding) {
+    latencies.push_back(now() - sentAt);
+    delivered++;
+  }
+}
+
+// Forward the notifications one at a time, as a hub thread
+static void* forwarderThread(void *arg)
+{
+  int i, spins;
+
+  for (i = 0; i < nbNotifications; i++) {
+    usleep(1000 + rand() % 2000);
+    sentAt = now();
+    yapiLockFunctionCallBack(NULL);
+    YAPI::_yapiFunctionUpdateCallbackFwd(descr, "21.50");
+    yapiUnlockFunctionCallBack(NULL);
+    for (spins = 0; delivered <= i && spins < 10000; spins++) {
+      usleep(100);
+    }
+  }
+  forwarding = false;
+  return NULL;
+}
+
+// The wait loop of YAPI::Sleep before WaitForEvents
+static void pollingSleep(unsigned ms_duration, string& errmsg)
+{
+  u64 waituntil = YAPI::GetTickCount() + ms_duration;
+
+  do {
+    YAPI::HandleEvents(errmsg);
+    usleep(2000);
+  } while (waituntil > YAPI::GetTickCount());
+}
+
+static double idleCpu(bool polling, int seconds, string& errmsg)
+{
+  double cpuStart = cpuTime();
+
+  if (polling) {
+    pollingSleep(seconds * 1000, errmsg);
+  } else {
+    YAPI::Sleep(seconds * 1000, errmsg);
+  }
+  return (cpuTime() - cpuStart) / seconds;
+}
+
+static double medianLatency(bool polling, string& errmsg)
+{
+  pthread_t forwarder;
+  double p99;
+
+  latencies.clear();
+  delivered = 0;
+  forwarding = true;
+  pthread_create(&forwarder, NULL, forwarderThread, NULL);
+  while (forwarding) {
+    if (polling) {
+      pollingSleep(100, errmsg);
+    } else {
+      YAPI::Sleep(100, errmsg);
+    }
+  }
+  pthread_join(forwarder, NULL);
+  if (latencies.empty()) {
+    return -1;
+  }
+  sort(latencies.begin(), latencies.end());
+  p99 = latencies[latencies.size() * 99 / 100];
+  cout << "    " << latencies.size() << " notifications, latency median "
+       << latencies[latencies.size() / 2] << " us, p99 " << p99 << " us" << endl;
+  return latencies[latencies.size() / 2];
+}
+
+int main(int argc, const char * argv[])
+{
+  string errmsg;
+  YTemperature *sensor;
+  int seconds, received;
+  double cpuSleep, cpuPoll, latSleep, latPoll;
+
+  if (argc < 4) {
+    cerr << "usage: bench_waitevents <hub_url> <seconds> <notifications>" << endl;
+    return 1;
+  }
+  seconds = atoi(argv[2]);
+  nbNotifications = atoi(argv[3]);
+  if (yRegisterHub(argv[1], errmsg) != YAPI_SUCCESS) {
+    cerr << "RegisterHub error: " << errmsg << endl;
+    return 1;
+  }
+  sensor = yFirstTemperature();
+  if (sensor == NULL || !sensor->isOnline()) {
+    cerr << "no sensor found" << endl;
+    return 1;
+  }
+  descr = sensor->get_functionDescriptor();
+  sensor->registerValueCallback(valueCallback);
+  // let the notification channel open
+  YAPI::Sleep(1000, errmsg);
+
+  cout << "idle wait of " << seconds << " s, CPU time per second of wait:" << endl;
+  cpuSleep = idleCpu(false, seconds, errmsg);
+  cout << "  YAPI::Sleep              : " << cpuSleep << " ms" << endl;
+  cpuPoll = idleCpu(true, seconds, errmsg);
+  cout << "  HandleEvents + 2 ms sleep: " << cpuPoll << " ms" << endl;
+  check(cpuSleep < cpuPoll, "less CPU used by YAPI::Sleep than by polling");
+
+  cout << nbNotifications << " notifications forwarded by another thread:" << endl;
+  cout << "  YAPI::Sleep" << endl;
+  latSleep = medianLatency(false, errmsg);
+  received = (int)latencies.size();
+  cout << "  HandleEvents + 2 ms sleep" << endl;
+  latPoll = medianLatency(true, errmsg);
+  check(received == nbNotifications && (int)latencies.size() == nbNotifications, "every notification delivered");
+  check(latSleep >= 0 && latSleep < latPoll, "lower median latency with YAPI::Sleep than with polling");
+
+  yFreeAPI();
+  cout << (failures ? "FAILED" : "PASSED") << endl;
+  return failures ? 1 : 0;
+}
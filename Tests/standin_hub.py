@@ -0,0 +1,360 @@
+#!/usr/bin/env python3
+# *********************************************************************
+#
+#  Stand-in for one or several YoctoHubs / VirtualHubs, used by the
+#  tests and benchmarks of this directory
+#
+#  It serves the small part of the HTTP protocol used by the library:
+#  hub and device api.json, function json, attribute writes, datalogger
+#  streams (logger.json), serial port line queries (rxmsg.json) and the notification channel
+#  (not.byn). The devices are simulated: a write is acknowledged but does not change the reported
+#  state, except for the logical name of functions, and a line query gets "ECHO:" + the query.
+#
+#  Run "standin_hub.py --help" for the options. When a command is given
+#  after "--", the hubs are started, the command is run, and the hubs are
+#  stopped when it ends; the exit code is the one of the command.
+#
+# ********************************************************************
+
+import argparse
+import asyncio
+import json
+import socket
+import sys
+import time
+
+PRODUCTS = {
+    # type: (serial prefix, product name, product id, function class, function id)
+    "temperature": ("TMPSENS1", "Yocto-Temperature", 11, "Temperature", "temperature"),
+    "relay": ("RELAYLO1", "Yocto-Relay", 12, "Relay", "relay"),
+    "serial": ("RS232MK1", "Yocto-RS232", 37, "SerialPort", "serialPort"),
+}
+
+
+class Hub:
+    def __init__(self, args, hubindex):
+        self.args = args
+        self.serial = "VIRTHUB0-%06d" % (hubindex + 1)
+        self.port = args.port + hubindex
+        prefix, self.product, self.productId, self.funClass, funId = PRODUCTS[args.type]
+        first = hubindex * args.devices
+        self.devices = ["%s-%05d" % (prefix, first + d) for d in range(args.devices)]
+        self.funcIds = ["%s%d" % (funId, f + 1) for f in range(args.functions)]
+        self.values = {}
+        for d, serial in enumerate(self.devices):
+            for f, funcId in enumerate(self.funcIds):
+                self.values[(serial, funcId)] = 20.0 + ((d * args.functions + f) % 100) / 10.0
+        self.notifCount = 0
+        self.enumCount = 0
+        self.counters = {}
+        self.names = {}
+        self.devnames = {}
+        if args.names:
+            for d, serial in enumerate(self.devices):
+                self.devnames[serial] = "dev%05d" % (first + d)
+                for f, funcId in enumerate(self.funcIds):
+                    self.names[(serial, funcId)] = "%s-%d" % (self.devnames[serial], f + 1)
+        self.streamCache = None
+
+    # --- JSON contents ---
+
+    def hubApi(self):
+        self.enumCount += 1
+        wp = [{"serialNumber": self.serial, "logicalName": "", "productName": "VirtualHub",
+               "productId": 0, "networkUrl": "/api", "beacon": 0, "index": 0}]
+        yp = {"Module": [{"baseType": 0, "hardwareId": self.serial + ".module", "logicalName": "",
+                          "advertisedValue": "", "index": 0}],
+              self.funClass: []}
+        for d, serial in enumerate(self.devices):
+            wp.append({"serialNumber": serial, "logicalName": self.devnames.get(serial, ""),
+                       "productName": self.product,
+                       "productId": self.productId, "networkUrl": "/bySerial/%s/api" % serial,
+                       "beacon": 0, "index": d + 1})
+            yp["Module"].append({"baseType": 0, "hardwareId": serial + ".module",
+                                 "logicalName": self.devnames.get(serial, ""),
+                                 "advertisedValue": "", "index": 0})
+            for f, funcId in enumerate(self.funcIds):
+                yp[self.funClass].append({"baseType": 1 if self.args.type == "temperature" else 0,
+                                          "hardwareId": "%s.%s" % (serial, funcId),
+                                          "logicalName": self.names.get((serial, funcId), ""),
+                                          "advertisedValue": ("%d" % self.enumCount if self.args.enum_count
+                                                              else self.advertised(serial, funcId)),
+                                          "index": f + 1})
+        return {"module": {"productName": "VirtualHub", "serialNumber": self.serial, "logicalName": "",
+                           "productId": 0, "productRelease": 1, "firmwareRelease": "50000"},
+                "network": {"adminPassword": ""},
+                "services": {"whitePages": wp, "yellowPages": yp}}
+
+    def advertised(self, serial, funcId):
+        if self.args.type == "relay":
+            return "B"
+        if self.args.type == "serial":
+            return "0:0"
+        return "%.2f" % self.values[(serial, funcId)]
+
+    def functionApi(self, serial, funcId):
+        if self.args.type == "relay":
+            return {"logicalName": "", "advertisedValue": "B", "state": 1, "stateAtPowerOn": 0,
+                    "maxTimeOnStateA": 0, "maxTimeOnStateB": 0, "output": 0, "pulseTimer": 0,
+                    "delayedPulseTimer": {"target": 0, "ms": 0, "moving": 0}, "countdown": 0}
+        if self.args.type == "serial":
+            return {"logicalName": self.names.get((serial, funcId), ""), "advertisedValue": "0:0",
+                    "rxCount": 0, "txCount": 0, "errCount": 0, "rxMsgCount": 0, "txMsgCount": 0,
+                    "lastMsg": "", "currentJob": "", "startupJob": "", "jobMaxTask": 0, "jobMaxSize": 0,
+                    "command": "", "protocol": "Line", "voltageLevel": 1, "serialMode": "9600,8N1"}
+        value = int(round(self.values[(serial, funcId)] * 65536))
+        return {"logicalName": self.names.get((serial, funcId), ""),
+                "advertisedValue": self.advertised(serial, funcId), "unit": "'C",
+                "currentValue": value, "lowestValue": value, "highestValue": value,
+                "currentRawValue": value, "logFrequency": "1/s", "reportFrequency": "OFF",
+                "advMode": 0, "calibrationParam": "0", "resolution": 655, "sensorState": 0,
+                "sensorType": 0, "signalValue": value, "signalUnit": "'C", "command": ""}
+
+    def deviceApi(self, serial):
+        api = {"module": {"productName": self.product, "serialNumber": serial,
+                          "logicalName": self.devnames.get(serial, ""),
+                          "productId": self.productId, "productRelease": 1, "firmwareRelease": "50000",
+                          "persistentSettings": 0, "luminosity": 50, "beacon": 0, "upTime": 1000,
+                          "usbCurrent": 20, "rebootCountdown": 0, "userVar": 0}}
+        for funcId in self.funcIds:
+            api[funcId] = self.functionApi(serial, funcId)
+        return api
+
+    # --- datalogger ---
+
+    @staticmethod
+    def encodeWords(words):
+        # inverse of YAPI::_decodeWords, without the back-references
+        res = []
+        for w in words:
+            c2 = chr(48 + ((w >> 10) & 63))
+            res.append(chr(48 + (w & 31)) + chr(48 + ((w >> 5) & 31)) + ("z" if c2 == "\\" else c2))
+        return "".join(res)
+
+    def streamHeader(self, index):
+        # 32-bit scaled stream of one measure per second, values in 1/1000
+        run, utc, rows = 1, 1500000000 + index * self.args.rows, self.args.rows
+        vmin, vmax, vavg = 20000, 20000 + min(rows, 1000) - 1, 20000 + min(rows, 1000) // 2
+        return self.encodeWords([run & 0xffff, run >> 16, utc & 0xffff, utc >> 16, 0x101, 0, 1, rows,
+                                 vavg & 0xffff, (vavg >> 16) ^ 0x8000, vmin & 0xffff, vmin >> 16,
+                                 vmax & 0xffff, vmax >> 16])
+
+    def streamData(self):
+        # all the streams hold the same measures
+        if self.streamCache is None:
+            words = []
+            for r in range(self.args.rows):
+                v = 20000 + r % 1000
+                words += [v & 0xffff, (v >> 16) ^ 0x8000]
+            self.streamCache = json.dumps(self.encodeWords(words))
+        return self.streamCache
+
+    def loggerApi(self, query):
+        params = dict(p.split("=", 1) for p in query.split("&") if "=" in p)
+        if "run" in params:
+            return self.streamData()
+        return json.dumps({"id": params.get("id", ""), "unit": "'C", "calib": "0",
+                           "streams": [self.streamHeader(i) for i in range(self.args.streams)]})
+
+    # --- notifications ---
+
+    def notificationValue(self, serial, funcId):
+        if self.args.notify_value == "stamp":
+            # send time in [ms], modulo 10^6 to fit in an advertised value
+            return "%d" % (int(time.time() * 1000) % 1000000)
+        if self.args.notify_value == "count":
+            # number of notifications sent for this function, from 1
+            self.counters[(serial, funcId)] = self.counters.get((serial, funcId), 0) + 1
+            return "%d" % self.counters[(serial, funcId)]
+        value = self.values[(serial, funcId)] + 0.01
+        if value >= 30.0:
+            value = 20.0
+        self.values[(serial, funcId)] = value
+        return self.advertised(serial, funcId)
+
+    async def notify(self, writer):
+        functions = [(s, f) for s in self.devices for f in self.funcIds]
+        period = self.args.notify_period / 1000.0
+        step = period / len(functions) if functions else period
+        nextKeepAlive = time.time() + 1
+        pos = 0
+        if self.args.notify_delay > 0:
+            await asyncio.sleep(self.args.notify_delay / 1000.0)
+        nextSend = time.time()
+        while True:
+            if self.args.notify_count and self.notifCount >= self.args.notify_count:
+                await asyncio.sleep(0.5)
+            elif period > 0 and functions:
+                # spread the notifications of all the functions over the period
+                serial, funcId = functions[pos]
+                pos = (pos + 1) % len(functions)
+                value = self.notificationValue(serial, funcId)
+                writer.write(("YN015%s,%s,%s\n" % (serial, funcId, value)).encode())
+                self.notifCount += 1
+                # keep the average rate when the step is below the timer resolution,
+                # without bursts after a stall
+                nextSend = max(nextSend + step, time.time() - period)
+                await asyncio.sleep(max(nextSend - time.time(), 0))
+            else:
+                await asyncio.sleep(0.5)
+            if time.time() >= nextKeepAlive:
+                writer.write(b"\n")
+                nextKeepAlive = time.time() + 1
+            await writer.drain()
+
+    # --- requests ---
+
+    def reply(self, path):
+        if path == "/api.json" or path.startswith("/api.json?"):
+            return json.dumps(self.hubApi())
+        if path.startswith("/bySerial/"):
+            parts = path.split("/", 3)
+            serial = parts[2]
+            rest = parts[3] if len(parts) > 3 else ""
+            if serial not in self.devices:
+                return None
+            if rest == "api.json" or rest.startswith("api.json?"):
+                return json.dumps(self.deviceApi(serial))
+            if rest.startswith("logger.json?"):
+                return self.loggerApi(rest.split("?", 1)[1])
+            if rest.startswith("rxmsg.json?") and self.args.type == "serial":
+                query = rest.split("?", 1)[1]
+                params = dict(p.split("=", 1) for p in query.split("&") if "=" in p)
+                cmd = params.get("cmd", "!")[1:]
+                # the reply line, then the position in the receive buffer
+                return json.dumps(["ECHO:" + cmd, 2 * len(cmd) + 7])
+            if rest.startswith("api/"):
+                funcId = rest[4:].split("/")[0].split(".")[0].split("?")[0]
+                if funcId in self.funcIds and "?" in rest:
+                    query = rest.split("?", 1)[1]
+                    params = dict(p.split("=", 1) for p in query.split("&") if "=" in p)
+                    if "logicalName" in params:
+                        self.names[(serial, funcId)] = params["logicalName"]
+                if funcId in self.funcIds:
+                    return json.dumps(self.functionApi(serial, funcId))
+                if funcId == "module":
+                    return json.dumps(self.deviceApi(serial)["module"])
+                return None
+        return "\"0\""
+
+    async def handle(self, reader, writer):
+        try:
+            while True:
+                head = await reader.readuntil(b"\r\n\r\n")
+                line = head.split(b"\r\n")[0].decode(errors="replace")
+                path = line.split(" ")[1] if " " in line else "/"
+                http11 = "HTTP/1.1" in line
+                if path.startswith("/not.byn"):
+                    writer.write(b"HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\n\r\n")
+                    await self.notify(writer)
+                    return
+                if self.args.log:
+                    with open(self.args.log, "a") as log:
+                        log.write("%s %s\n" % (self.serial, path))
+                if self.args.latency > 0 and path.startswith("/bySerial/"):
+                    await asyncio.sleep(self.args.latency / 1000.0)
+                body = self.reply(path)
+                if self.args.fail and self.args.fail in path:
+                    writer.write(b"HTTP/1.1 401 Unauthorized\r\nConnection: close\r\n\r\n")
+                elif body is None:
+                    writer.write(b"HTTP/1.1 404 Not Found\r\nConnection: close\r\n\r\n")
+                elif http11:
+                    writer.write(b"HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+                                 b"Connection: close\r\n\r\n" + body.encode())
+                else:
+                    writer.write(b"OK\r\n\r\n" + body.encode())
+                await writer.drain()
+                writer.close()
+                return
+        except (asyncio.IncompleteReadError, asyncio.CancelledError, ConnectionError):
+            pass
+        finally:
+            writer.close()
+
+
+def deadHub(port):
+    # a listening socket which never accepts: once its queue is filled, the
+    # connection attempts hang like with a hub that does not respond
+    listener = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    listener.bind(("127.0.0.1", port))
+    listener.listen(0)
+    sockets = [listener]
+    for i in range(3):
+        filler = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        filler.setblocking(False)
+        try:
+            filler.connect(("127.0.0.1", port))
+        except BlockingIOError:
+            pass
+        sockets.append(filler)
+    return sockets
+
+
+async def serve(args, command):
+    hubs = [Hub(args, h) for h in range(args.hubs)]
+    servers = []
+    for hub in hubs:
+        servers.append(await asyncio.start_server(hub.handle, "127.0.0.1", hub.port, backlog=128))
+    dead = [deadHub(args.port + args.hubs + d) for d in range(args.dead)]
+    if not command:
+        print("%d stand-in hub(s) listening on ports %d-%d" % (len(hubs), args.port, args.port + len(hubs) - 1),
+              flush=True)
+        await asyncio.Event().wait()
+    proc = await asyncio.create_subprocess_exec(*command)
+    code = await proc.wait()
+    for server in servers:
+        server.close()
+    return code
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Stand-in YoctoHub for tests and benchmarks")
+    parser.add_argument("--port", type=int, default=4444, help="port of the first hub")
+    parser.add_argument("--hubs", type=int, default=1, help="number of hubs, on consecutive ports")
+    parser.add_argument("--dead", type=int, default=0,
+                        help="unresponsive hubs, on the ports after the hubs: connections to them hang")
+    parser.add_argument("--devices", type=int, default=1, help="devices per hub")
+    parser.add_argument("--functions", type=int, default=1, help="functions per device")
+    parser.add_argument("--type", choices=sorted(PRODUCTS.keys()), default="temperature")
+    parser.add_argument("--names", action="store_true",
+                        help="give a logical name to each device (devNNNNN) and function (devNNNNN-F)")
+    parser.add_argument("--latency", type=float, default=0, help="delay of device requests, in ms")
+    parser.add_argument("--notify-period", type=float, default=0,
+                        help="period in ms at which each function sends a notification (0: never)")
+    parser.add_argument("--notify-value", choices=["walk", "stamp", "count"], default="walk",
+                        help="notified values: slowly changing measures, send time in ms modulo 10^6,"
+                             " or number of notifications sent for the function")
+    parser.add_argument("--notify-count", type=int, default=0,
+                        help="notifications sent by each hub before it stops (0: no limit)")
+    parser.add_argument("--notify-delay", type=float, default=0,
+                        help="delay in ms before the first notification")
+    parser.add_argument("--enum-count", action="store_true",
+                        help="advertise in the yellow pages the number of hub enumerations, as value of each function")
+    parser.add_argument("--streams", type=int, default=0, help="datalogger streams per function")
+    parser.add_argument("--rows", type=int, default=3600, help="measures per datalogger stream")
+    parser.add_argument("--log", help="file to which the path of each request is appended")
+    parser.add_argument("--fail", help="reject with 401 the requests which contain this text")
+    argv = sys.argv[1:]
+    command = []
+    if "--" in argv:
+        command = argv[argv.index("--") + 1:]
+        argv = argv[:argv.index("--")]
+    args = parser.parse_args(argv)
+    # each hub takes a listening socket and one per connection, and the command
+    # run after "--" inherits the limit: allow as many sockets as possible
+    try:
+        import resource
+        soft, hard = resource.getrlimit(resource.RLIMIT_NOFILE)
+        resource.setrlimit(resource.RLIMIT_NOFILE, (hard, hard))
+    except (ImportError, ValueError, OSError):
+        pass
+    try:
+        code = asyncio.run(serve(args, command))
+    except KeyboardInterrupt:
+        code = 0
+    sys.exit(code)
+
+
+if __name__ == "__main__":
+    main()
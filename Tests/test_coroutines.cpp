@@ -0,0 +1,297 @@
+/*********************************************************************
+ *
+ * Test of the awaitable requests (YAwaitable), with C++20 coroutines
+ *
+ * Awaits loadAsync(), downloadAsync() and loadMoreAsync() on temperature
+ * sensors, or queryLineAsync() on serial ports, and checks that they give
+ * the same results as the blocking calls, that the coroutines are resumed
+ * by YAPI::Sleep() in the calling thread, and that the failures are
+ * reported like by the blocking calls: a negative error code or an empty
+ * string, or a YAPI_Exception caught in the coroutine once the exceptions
+ * are enabled; both when the request fails at once (unknown device) and
+ * when the hub rejects it. The stand-in hub must reject the requests of
+ * the third sensor, or the queries containing FAIL:
+ *   python3 standin_hub.py --functions 3 --streams 5 --rows 100 --fail temperature3 \
+ *       -- Binary_Linux/64bits/test_coroutines sensor 127.0.0.1:4444
+ *   python3 standin_hub.py --type serial --fail FAIL \
+ *       -- Binary_Linux/64bits/test_coroutines serial 127.0.0.1:4444
+ * This program must be compiled as C++20 (-std=c++20).
+ *
+ *********************************************************************/
+
+#include "yocto_api.h"
+#include "yocto_temperature.h"
+#include "yocto_serialport.h"
+#include <iostream>
+#include <thread>
+#include <math.h>
+
+#ifndef YAPI_HAS_COROUTINES
+#error "test_coroutines must be compiled as C++20, with a compiler supporting coroutines"
+#endif
+
+using namespace std;
+
+static int failures = 0;
+static int pending = 0;
+static std::thread::id mainThread;
+
+static void check(bool cond, const string& what)
+{
+  cout << (cond ? "ok       " : "FAILED   ") << what << endl;
+  if (!cond) {
+    failures++;
+  }
+}
+
+// Coroutine started at once by the caller, which counts it in pending
+// until it returns
+struct Task {
+  struct promise_type {
+    Task get_return_object(void) { pending++; return Task(); }
+    std::suspend_never initial_suspend(void) noexcept { return {}; }
+    std::suspend_never final_suspend(void) noexcept { pending--; return {}; }
+    void return_void(void) {}
+    void unhandled_exception(void) { check(false, "exception caught in the coroutine"); }
+  };
+};
+
+// Handle the events until the coroutines started have returned
+static bool waitTasks(const string& what)
+{
+  string errmsg;
+  u64 timeout = YAPI::GetTickCount() + 10000;
+
+  while (pending > 0 && YAPI::GetTickCount() < timeout) {
+    YAPI::Sleep(2, errmsg);
+  }
+  if (pending > 0) {
+    check(false, what + ": coroutines completed");
+    return false;
+  }
+  return true;
+}
+
+static bool sameMeasures(vector<YMeasure>& a, vector<YMeasure>& b)
+{
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (unsigned i = 0; i < a.size(); i++) {
+    if (a[i].get_startTimeUTC() != b[i].get_startTimeUTC() || a[i].get_endTimeUTC() != b[i].get_endTimeUTC() ||
+        a[i].get_minValue() != b[i].get_minValue() || a[i].get_averageValue() != b[i].get_averageValue() ||
+        a[i].get_maxValue() != b[i].get_maxValue()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// --- temperature sensors ---
+
+static Task loadTask(YTemperature *sensor, YTemperature *rejected, YTemperature *unknown)
+{
+  int res;
+  string content;
+
+  res = co_await sensor->loadAsync(1000);
+  check(res == YAPI_SUCCESS && sensor->get_unit() == "'C" && fabs(sensor->get_currentValue() - 20.0) < 0.01,
+        "loadAsync(): attributes loaded");
+  check(std::this_thread::get_id() == mainThread, "loadAsync(): resumed in the calling thread");
+  content = co_await sensor->downloadAsync("api/" + sensor->get_functionId() + ".json");
+  check(content == sensor->_download("api/" + sensor->get_functionId() + ".json"),
+        "downloadAsync(): same content as download()");
+  res = co_await unknown->loadAsync(1000);
+  check(res == YAPI_DEVICE_NOT_FOUND && unknown->get_errorType() == res, "loadAsync() on an unknown device: " +
+        to_string(res) + ", " + unknown->get_errorMessage());
+  res = co_await rejected->loadAsync(1000);
+  check(YISERR(res) && rejected->get_errorType() == res, "loadAsync() rejected by the hub: " +
+        to_string(res) + ", " + rejected->get_errorMessage());
+  content = co_await rejected->downloadAsync("api/" + rejected->get_functionId() + ".json");
+  check(content == "" && YISERR(rejected->get_errorType()), "downloadAsync() rejected by the hub: empty string");
+}
+
+static Task loadOneTask(YTemperature *sensor, int *res)
+{
+  *res = co_await sensor->loadAsync(1000);
+}
+
+// the parameters are copied: the temporaries of the caller do not survive
+// the first suspension
+static Task loadExceptionTask(YFunction *func, string path, string what)
+{
+  try {
+    co_await func->loadAsync(1000);
+    check(false, what + ": exception thrown");
+  } catch (YAPI_Exception& e) {
+    check(YISERR(e.errorType) && string(e.what()) != "", what + ": exception caught in the coroutine, " +
+          to_string(e.errorType) + ", " + e.what());
+  }
+  try {
+    co_await func->downloadAsync(path);
+    check(false, what + ", downloadAsync(): exception thrown");
+  } catch (YAPI_Exception& e) {
+    check(YISERR(e.errorType), what + ", downloadAsync(): exception caught in the coroutine");
+  }
+}
+
+static Task loadMoreTask(YDataSet *dataset, int *progress)
+{
+  do {
+    *progress = co_await dataset->loadMoreAsync();
+    if (std::this_thread::get_id() != mainThread) {
+      *progress = -1000;
+    }
+  } while (*progress >= 0 && *progress < 100);
+}
+
+static Task loadMoreExceptionTask(YDataSet *dataset)
+{
+  try {
+    co_await dataset->loadMoreAsync();
+    check(false, "loadMoreAsync() rejected by the hub: exception thrown");
+  } catch (YAPI_Exception& e) {
+    check(YISERR(e.errorType), "loadMoreAsync() rejected by the hub: exception caught in the coroutine, " +
+          to_string(e.errorType));
+  }
+}
+
+static void sensorTests(void)
+{
+  YTemperature *sensor, *sensor2, *rejected, *unknown;
+  int res1 = 1, res2 = 1, progress = 0;
+  vector<YMeasure> ref, measures;
+
+  sensor = yFirstTemperature();
+  if (sensor == NULL) {
+    check(false, "temperature sensor found");
+    return;
+  }
+  sensor2 = yFindTemperature(sensor->get_module()->get_serialNumber() + ".temperature2");
+  rejected = yFindTemperature(sensor->get_module()->get_serialNumber() + ".temperature3");
+  unknown = yFindTemperature("NOSUCHDV-00000.temperature1");
+
+  loadTask(sensor, rejected, unknown);
+  waitTasks("loadAsync()");
+
+  // several requests awaited at the same time
+  loadOneTask(sensor, &res1);
+  loadOneTask(sensor2, &res2);
+  if (waitTasks("loadAsync() x 2")) {
+    check(res1 == YAPI_SUCCESS && res2 == YAPI_SUCCESS && fabs(sensor2->get_currentValue() - 20.1) < 0.01,
+          "2 loadAsync() awaited at the same time: both resumed");
+  }
+
+  // exceptions thrown by await_resume()
+  yEnableExceptions();
+  loadExceptionTask(unknown, "api/temperature1.json", "loadAsync() on an unknown device");
+  loadExceptionTask(rejected, "api/temperature3.json", "loadAsync() rejected by the hub");
+  waitTasks("loadAsync() with exceptions");
+  yDisableExceptions();
+
+  // recorded data, compared with loadMore()
+  YDataSet refSet = sensor->get_recordedData(0, 0);
+  do {
+    progress = refSet.loadMore();
+  } while (progress >= 0 && progress < 100);
+  ref = refSet.get_measures();
+  YDataSet dataset = sensor->get_recordedData(0, 0);
+  loadMoreTask(&dataset, &progress);
+  if (waitTasks("loadMoreAsync()")) {
+    check(progress == 100 && ref.size() > 0, "loadMoreAsync(): complete, " + to_string(ref.size()) +
+          " measures, resumed in the calling thread");
+    measures = dataset.get_measures();
+    check(sameMeasures(measures, ref), "loadMoreAsync(): same measures as loadMore()");
+  }
+  YDataSet failedSet = rejected->get_recordedData(0, 0);
+  loadMoreTask(&failedSet, &progress);
+  if (waitTasks("loadMoreAsync() rejected by the hub")) {
+    check(YISERR(progress) && failedSet.get_measures().size() == 0,
+          "loadMoreAsync() rejected by the hub: " + to_string(progress));
+  }
+  YDataSet unknownSet = unknown->get_recordedData(0, 0);
+  loadMoreTask(&unknownSet, &progress);
+  if (waitTasks("loadMoreAsync() on an unknown device")) {
+    check(progress == YAPI_DEVICE_NOT_FOUND, "loadMoreAsync() on an unknown device: " + to_string(progress));
+  }
+  yEnableExceptions();
+  YDataSet thrownSet = rejected->get_recordedData(0, 0);
+  loadMoreExceptionTask(&thrownSet);
+  waitTasks("loadMoreAsync() with exceptions");
+  yDisableExceptions();
+}
+
+// --- serial ports ---
+
+static Task queryTask(YSerialPort *port, YSerialPort *unknown)
+{
+  string line;
+
+  line = co_await port->queryLineAsync("PING", 100);
+  check(line == "ECHO:PING" && line == port->queryLine("PING", 100), "queryLineAsync(): same line as queryLine()");
+  check(std::this_thread::get_id() == mainThread, "queryLineAsync(): resumed in the calling thread");
+  line = co_await port->queryLineAsync("FAIL", 100);
+  check(line == "" && YISERR(port->get_errorType()), "queryLineAsync() rejected by the hub: empty string, " +
+        to_string(port->get_errorType()));
+  line = co_await unknown->queryLineAsync("PING", 100);
+  check(line == "" && unknown->get_errorType() == YAPI_DEVICE_NOT_FOUND,
+        "queryLineAsync() on an unknown device: empty string");
+}
+
+static Task queryExceptionTask(YSerialPort *port, string query, string what)
+{
+  try {
+    co_await port->queryLineAsync(query, 100);
+    check(false, what + ": exception thrown");
+  } catch (YAPI_Exception& e) {
+    check(YISERR(e.errorType), what + ": exception caught in the coroutine, " + to_string(e.errorType));
+  }
+}
+
+static void serialTests(void)
+{
+  YSerialPort *port, *unknown;
+
+  port = yFirstSerialPort();
+  if (port == NULL) {
+    check(false, "serial port found");
+    return;
+  }
+  unknown = yFindSerialPort("NOSUCHDV-00000.serialPort1");
+  queryTask(port, unknown);
+  waitTasks("queryLineAsync()");
+  yEnableExceptions();
+  queryExceptionTask(port, "FAIL", "queryLineAsync() rejected by the hub");
+  queryExceptionTask(unknown, "PING", "queryLineAsync() on an unknown device");
+  waitTasks("queryLineAsync() with exceptions");
+  yDisableExceptions();
+}
+
+int main(int argc, const char * argv[])
+{
+  string errmsg, mode;
+
+  if (argc < 3) {
+    cerr << "usage: test_coroutines sensor|serial <hub_url>" << endl;
+    return 1;
+  }
+  mode = argv[1];
+  mainThread = std::this_thread::get_id();
+  yDisableExceptions();
+  if (yRegisterHub(argv[2], errmsg) != YAPI_SUCCESS) {
+    cerr << "RegisterHub error: " << errmsg << endl;
+    return 1;
+  }
+  if (mode == "sensor") {
+    sensorTests();
+  } else if (mode == "serial") {
+    serialTests();
+  } else {
+    cerr << "unknown mode: " << mode << endl;
+    return 1;
+  }
+
+  yFreeAPI();
+  cout << (failures ? "FAILED" : "PASSED") << endl;
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,124 @@
+/*********************************************************************
+ *
+ * Test of the streaming measure cursor (YMeasureCursor)
+ *
+ * Reads the recorded data of the first temperature sensor through a
+ * YMeasureCursor, with one and with 4 parallel downloads, and checks
+ * that it returns the same measures, in the same order, as loadMore()
+ * and get_measures(), that the measures are not kept in the data set,
+ * and that the values of each stream are released once returned. The
+ * stand-in hub must record some streams (--streams):
+ *   python3 standin_hub.py --streams 10 --rows 600 \
+ *       -- Binary_Linux/64bits/test_cursor 127.0.0.1:4444
+ *
+ *********************************************************************/
+
+#include "yocto_api.h"
+#include "yocto_temperature.h"
+#include <iostream>
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool cond, const string& what)
+{
+  cout << (cond ? "ok       " : "FAILED   ") << what << endl;
+  if (!cond) {
+    failures++;
+  }
+}
+
+static bool sameMeasure(YMeasure& a, YMeasure& b)
+{
+  return a.get_startTimeUTC() == b.get_startTimeUTC() && a.get_endTimeUTC() == b.get_endTimeUTC() &&
+         a.get_minValue() == b.get_minValue() && a.get_averageValue() == b.get_averageValue() &&
+         a.get_maxValue() == b.get_maxValue();
+}
+
+// Number of decoded rows still held by the streams of a data set
+static int heldRows(YDataSet& dataset)
+{
+  vector<YDataStream*> streams = dataset.get_privateDataStreams();
+  int rows = 0;
+
+  for (unsigned i = 0; i < streams.size(); i++) {
+    rows += streams[i]->_get_decodedRowCount();
+  }
+  return rows;
+}
+
+// Read the data set with a cursor
+static void cursorTest(YTemperature *sensor, int parallel, vector<YMeasure>& measures)
+{
+  YDataSet dataset = sensor->get_recordedData(0, 0);
+  YMeasureCursor cursor(dataset);
+  YMeasure measure;
+  string name = "cursor with " + to_string(parallel) + " download(s)";
+  int maxHeld = 0;
+
+  dataset.set_parallelDownloads(parallel);
+  measures.clear();
+  while (cursor.next(measure)) {
+    measures.push_back(measure);
+    maxHeld = max(maxHeld, heldRows(dataset));
+  }
+  cout << "  " << measures.size() << " measures, " << dataset.get_privateDataStreams().size() << " streams" << endl;
+  check(cursor.get_progress() == 100, name + ": complete");
+  check(dataset.get_measures().size() == 0, name + ": measures not kept in the data set");
+  check(maxHeld == 0, name + ": values of each stream released once returned");
+}
+
+static bool sameMeasures(vector<YMeasure>& a, vector<YMeasure>& b)
+{
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (unsigned i = 0; i < a.size(); i++) {
+    if (!sameMeasure(a[i], b[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, const char * argv[])
+{
+  string errmsg;
+  YTemperature *sensor;
+  vector<YMeasure> ref, measures1, measures4;
+  int progress;
+
+  if (argc < 2) {
+    cerr << "usage: test_cursor <hub_url>" << endl;
+    return 1;
+  }
+  yDisableExceptions();
+  if (yRegisterHub(argv[1], errmsg) != YAPI_SUCCESS) {
+    cerr << "RegisterHub error: " << errmsg << endl;
+    return 1;
+  }
+  sensor = yFirstTemperature();
+  if (sensor == NULL) {
+    cerr << "no temperature sensor found" << endl;
+    return 1;
+  }
+
+  // the cursors come first: the streams are shared by the data sets of the
+  // sensor, and loadMore() keeps their values
+  cursorTest(sensor, 1, measures1);
+  cursorTest(sensor, 4, measures4);
+  YDataSet dataset = sensor->get_recordedData(0, 0);
+  do {
+    progress = dataset.loadMore();
+  } while (progress >= 0 && progress < 100);
+  ref = dataset.get_measures();
+  check(progress == 100 && ref.size() > 0, "loadMore(): " + to_string(ref.size()) + " measures");
+  check(heldRows(dataset) > 0, "loadMore(): values of the streams kept");
+  check(sameMeasures(measures1, ref), "cursor with 1 download: same measures as get_measures(), in order");
+  check(sameMeasures(measures4, ref), "cursor with 4 downloads: same measures as get_measures(), in order");
+
+  yFreeAPI();
+  cout << (failures ? "FAILED" : "PASSED") << endl;
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,209 @@
+/*********************************************************************
+ *
+ * Test of the columnar datalogger stream decoder (YDataStream)
+ *
+ * Builds data streams in each encoding of the dataloggers: 16-bit
+ * decimal values of the oldest devices, fixed-point values with an
+ * offset and a scale, and 32-bit values in 1/1000; each with min, avg
+ * and max columns or with a single column, without and with a linear
+ * calibration. Parses random words as a downloaded stream, and checks
+ * that the columns, get_dataRows() and get_data() give exactly the
+ * values of the row by row decoder they replace, also once the stream
+ * is parsed again with other words. No hub is needed:
+ *   Binary_Linux/64bits/test_decode
+ *
+ *********************************************************************/
+
+#include "yocto_api.h"
+#include "yocto_temperature.h"
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+#define ROWS    1000
+
+static int failures = 0;
+
+static void check(bool cond, const string& what)
+{
+  cout << (cond ? "ok       " : "FAILED   ") << what << endl;
+  if (!cond) {
+    failures++;
+  }
+}
+
+static u32 seed = 12345;
+
+static int randomWord(void)
+{
+  seed = seed * 1103515245 + 12345;
+  return (seed >> 8) & 0xffff;
+}
+
+// Inverse of YAPI::_decodeWords, without the back-references
+static string encodeWords(const vector<int>& words)
+{
+  string res;
+
+  for (unsigned i = 0; i < words.size(); i++) {
+    char c2 = (char)(48 + ((words[i] >> 10) & 63));
+    res += (char)(48 + (words[i] & 31));
+    res += (char)(48 + ((words[i] >> 5) & 31));
+    res += (c2 == '\\' ? 'z' : c2);
+  }
+  return res;
+}
+
+// The row by row decoder used before the columns
+static vector< vector<double> > refDecode(YDataStream *stream, const vector<int>& udat, bool isAvg, bool isScal, bool isScal32)
+{
+  vector< vector<double> > values;
+  vector<double> dat;
+  int idx = 0;
+
+  if (isAvg) {
+    while (idx + 3 < (int)udat.size()) {
+      dat.clear();
+      if (isScal32) {
+        dat.push_back(stream->_decodeVal(udat[idx + 2] + (((udat[idx + 3]) << (16)))));
+        dat.push_back(stream->_decodeAvg(udat[idx] + (((((udat[idx + 1]) ^ (0x8000))) << (16))), 1));
+        dat.push_back(stream->_decodeVal(udat[idx + 4] + (((udat[idx + 5]) << (16)))));
+        idx = idx + 6;
+      } else {
+        dat.push_back(stream->_decodeVal(udat[idx]));
+        dat.push_back(stream->_decodeAvg(udat[idx + 2] + (((udat[idx + 3]) << (16))), 1));
+        dat.push_back(stream->_decodeVal(udat[idx + 1]));
+        idx = idx + 4;
+      }
+      values.push_back(dat);
+    }
+  } else if (isScal && !isScal32) {
+    while (idx < (int)udat.size()) {
+      dat.clear();
+      dat.push_back(stream->_decodeVal(udat[idx]));
+      values.push_back(dat);
+      idx = idx + 1;
+    }
+  } else {
+    while (idx + 1 < (int)udat.size()) {
+      dat.clear();
+      dat.push_back(stream->_decodeAvg(udat[idx] + (((((udat[idx + 1]) ^ (0x8000))) << (16))), 1));
+      values.push_back(dat);
+      idx = idx + 2;
+    }
+  }
+  return values;
+}
+
+// Parse words as a downloaded stream, and compare the decoded values with the reference
+static void checkStream(YDataStream *stream, const string& name, bool isAvg, bool isScal, bool isScal32)
+{
+  vector<int> words;
+  vector< vector<double> > ref, rows;
+  int wordsPerRow, nCols, r, c;
+  bool colsOk = true, dataOk = true;
+
+  wordsPerRow = (isAvg ? (isScal32 ? 6 : 4) : (isScal && !isScal32 ? 1 : 2));
+  nCols = (isAvg ? 3 : 1);
+  for (r = 0; r < ROWS * wordsPerRow; r++) {
+    words.push_back(randomWord());
+  }
+  stream->_parseStream("\"" + encodeWords(words) + "\"");
+  ref = refDecode(stream, words, isAvg, isScal, isScal32);
+  for (c = 0; c < nCols; c++) {
+    const double *col = stream->get_columnData(c);
+    if (col == NULL) {
+      colsOk = false;
+      break;
+    }
+    for (r = 0; r < (int)ref.size(); r++) {
+      if (col[r] != ref[r][c]) {
+        colsOk = false;
+      }
+    }
+  }
+  colsOk = colsOk && stream->get_columnData(nCols) == NULL;
+  for (r = 0; r < (int)ref.size(); r++) {
+    for (c = 0; c < nCols; c++) {
+      if (stream->get_data(r, c) != ref[r][c]) {
+        dataOk = false;
+      }
+    }
+  }
+  rows = stream->get_dataRows();
+  check(ref.size() == ROWS && colsOk, name + ": " + to_string(ref.size()) + " rows, columns as decoded row by row");
+  check(rows == ref, name + ": get_dataRows() as decoded row by row");
+  check(dataOk && stream->get_data(ROWS, 0) == Y_DATA_INVALID && stream->get_data(0, nCols) == Y_DATA_INVALID,
+        name + ": get_data() as decoded row by row");
+}
+
+int main(int argc, const char * argv[])
+{
+  const char *modes[] = { "decimal", "fixed-point", "32-bit" };
+  string errmsg, name, json;
+  vector<int> header, cal;
+  YTemperature *func;
+  int mode, avg, calib, utc = 1500000000;
+
+  yDisableExceptions();
+  if (yInitAPI(0, errmsg) != YAPI_SUCCESS) {
+    cerr << "InitAPI error: " << errmsg << endl;
+    return 1;
+  }
+  func = yFindTemperature("DECODE01-12345.temperature1");
+  for (mode = 0; mode < 3; mode++) {
+    for (avg = 1; avg >= 0; avg--) {
+      for (calib = 0; calib < 2; calib++) {
+        bool isScal = (mode > 0), isScal32 = (mode == 2);
+        YDataSet dataset(func);
+        vector<YDataStream*> streams;
+
+        // stream header: run, utc, 1 sample per hour (avg) or per second
+        header.clear();
+        header.push_back(1);
+        header.push_back(0);
+        header.push_back(utc & 0xffff);
+        header.push_back(utc >> 16);
+        header.push_back(avg ? 0x001 : 0x101);
+        header.push_back(mode == 0 ? 2 : (mode == 1 ? 1000 : 0));   // decimals, or offset
+        header.push_back(mode == 0 ? 0 : (mode == 1 ? 100 : 1));    // scale
+        header.push_back(ROWS);
+        for (int i = 0; i < (isScal32 ? 6 : 4); i++) {
+          header.push_back(randomWord());
+        }
+        utc += 3600 * ROWS;
+        // two point linear calibration, in the encoding of the stream
+        cal.clear();
+        cal.push_back(calib ? 2 : 0);
+        if (calib) {
+          double pts[] = { 10.0, 12.0, 30.0, 29.0 };
+          for (int i = 0; i < 4; i++) {
+            if (mode == 0) {
+              cal.push_back(YAPI::_doubleToDecimal(pts[i]) & 0xffff);
+            } else if (mode == 1) {
+              cal.push_back((int)(pts[i] * 100) + 1000);
+            } else {
+              cal.push_back((int)(pts[i] * 1000));
+            }
+          }
+        }
+        json = "{\"id\":\"temperature1\",\"unit\":\"'C\",\"cal\":\"" + encodeWords(cal) +
+               "\",\"streams\":[\"" + encodeWords(header) + "\"]}";
+        dataset._parse(json);
+        streams = dataset.get_privateDataStreams();
+        name = string(modes[mode]) + (avg ? ", min/avg/max" : ", single column") + (calib ? ", calibrated" : "");
+        if (streams.size() != 1) {
+          check(false, name + ": stream created");
+          continue;
+        }
+        checkStream(streams[0], name, avg != 0, isScal, isScal32);
+        checkStream(streams[0], name + ", parsed again", avg != 0, isScal, isScal32);
+      }
+    }
+  }
+
+  yFreeAPI();
+  cout << (failures ? "FAILED" : "PASSED") << endl;
+  return failures ? 1 : 0;
+}
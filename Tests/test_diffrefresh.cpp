@@ -0,0 +1,118 @@
+/*********************************************************************
+ *
+ * Test of the differential refresh of the device cache
+ * (YAPI::DifferentialRefresh)
+ *
+ * The stand-in hub logs the path of each request, and applies the
+ * changes of logical name of the functions:
+ *   python3 standin_hub.py --functions 3 --log /tmp/requests.log \
+ *       -- Binary_Linux/64bits/test_diffrefresh 127.0.0.1:4444 /tmp/requests.log
+ *
+ *********************************************************************/
+
+#include "yocto_api.h"
+#include "yocto_temperature.h"
+#include <iostream>
+#include <fstream>
+#include <vector>
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool cond, const string& what)
+{
+  cout << (cond ? "ok       " : "FAILED   ") << what << endl;
+  if (!cond) {
+    failures++;
+  }
+}
+
+// Return the paths of the requests logged since line "skip"
+static vector<string> loggedPaths(const string& logfile, size_t skip)
+{
+  vector<string> paths;
+  ifstream log(logfile.c_str());
+  string line;
+  size_t lines = 0, pos;
+
+  while (getline(log, line)) {
+    if (lines++ < skip) {
+      continue;
+    }
+    pos = line.find(' ');
+    paths.push_back(pos == string::npos ? line : line.substr(pos + 1));
+  }
+  return paths;
+}
+
+// Count the logged paths which contain the given text
+static int count(const vector<string>& paths, const string& what)
+{
+  int res = 0;
+
+  for (size_t i = 0; i < paths.size(); i++) {
+    if (paths[i].find(what) != string::npos) {
+      res++;
+    }
+  }
+  return res;
+}
+
+int main(int argc, const char * argv[])
+{
+  string errmsg, logfile;
+  YTemperature *t1, *t2, *t3;
+  vector<string> paths;
+  size_t skip;
+
+  if (argc < 3) {
+    cerr << "usage: test_diffrefresh <hub_url> <request_log>" << endl;
+    return 1;
+  }
+  logfile = argv[2];
+  YAPI::DifferentialRefresh = true;
+  yDisableExceptions();
+  if (yRegisterHub(argv[1], errmsg) != YAPI_SUCCESS) {
+    cerr << "RegisterHub error: " << errmsg << endl;
+    return 1;
+  }
+  t1 = yFindTemperature("TMPSENS1-00000.temperature1");
+  t2 = yFindTemperature("TMPSENS1-00000.temperature2");
+  t3 = yFindTemperature("TMPSENS1-00000.temperature3");
+
+  // the first load gets the whole api.json, which serves the other functions
+  skip = loggedPaths(logfile, 0).size();
+  t1->load(1000);
+  t2->load(1000);
+  t3->load(1000);
+  paths = loggedPaths(logfile, skip);
+  check(count(paths, "api.json") == 1 && count(paths, "/api/temperature") == 0,
+        "first load: one api.json for all the functions");
+
+  // a change invalidates the cache: only the function loaded is fetched again
+  t1->set_logicalName("probe");
+  YAPI::Sleep(200, errmsg);
+  skip = loggedPaths(logfile, 0).size();
+  t1->load(1000);
+  paths = loggedPaths(logfile, skip);
+  check(t1->get_logicalName() == "probe", "change: new logical name read back");
+  check(count(paths, "api.json") == 0 && count(paths, "/api/temperature1.json") == 1 &&
+        count(paths, "/api/temperature2") == 0 && count(paths, "/api/temperature3") == 0,
+        "change: only the changed function fetched again");
+
+  // a function node is served from the cache only while younger than msValidity
+  t2->load(1000);
+  YAPI::Sleep(300, errmsg);
+  skip = loggedPaths(logfile, 0).size();
+  t2->load(1000);
+  check(loggedPaths(logfile, skip).empty(), "validity: node younger than msValidity served from the cache");
+  t2->load(100);
+  paths = loggedPaths(logfile, skip);
+  check(paths.size() == 1 && count(paths, "/api/temperature2.json") == 1,
+        "validity: node older than msValidity fetched again");
+
+  yFreeAPI();
+  cout << (failures ? "FAILED" : "PASSED") << endl;
+  return failures ? 1 : 0;
+}
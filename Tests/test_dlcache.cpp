@@ -0,0 +1,136 @@
+/*********************************************************************
+ *
+ * Test of the datalogger cache (YAPI::SetDataLoggerCache)
+ *
+ * "fill" loads the recorded data of the first temperature sensor through
+ * the cache. Run it from several processes at the same time to check that
+ * they share the cache files. "check" then verifies the error cases, that
+ * each stream is stored once, and that no stream is downloaded again:
+ *   python3 standin_hub.py --streams 20 --rows 600 --log /tmp/requests.log \
+ *       -- sh -c "test_dlcache fill ... & test_dlcache fill ...; wait"
+ *   python3 standin_hub.py --streams 20 --rows 600 --log /tmp/requests.log \
+ *       -- test_dlcache check 127.0.0.1:4444 /tmp/requests.log /tmp/cache
+ *
+ *********************************************************************/
+
+#include "yocto_api.h"
+#include "yocto_temperature.h"
+#include <iostream>
+#include <fstream>
+#include <stdio.h>
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool cond, const string& what)
+{
+  cout << (cond ? "ok       " : "FAILED   ") << what << endl;
+  if (!cond) {
+    failures++;
+  }
+}
+
+// Number of stream downloads logged by the stand-in hub
+static int streamDownloads(const string& logfile)
+{
+  ifstream log(logfile.c_str());
+  string line;
+  int count = 0;
+
+  while (getline(log, line)) {
+    if (line.find("logger.json?") != string::npos && line.find("&run=") != string::npos) {
+      count++;
+    }
+  }
+  return count;
+}
+
+static long fileSize(const string& path)
+{
+  FILE *fp = fopen(path.c_str(), "rb");
+  long size;
+
+  if (fp == NULL) {
+    return -1;
+  }
+  fseek(fp, 0, SEEK_END);
+  size = ftell(fp);
+  fclose(fp);
+  return size;
+}
+
+// Load the whole data set, return the number of measures
+static int loadAll(YTemperature *sensor, vector<YDataStream*>& streams)
+{
+  YDataSet dataset = sensor->get_recordedData(0, 0);
+  int progress;
+
+  do {
+    progress = dataset.loadMore();
+  } while (progress >= 0 && progress < 100);
+  streams = dataset.get_privateDataStreams();
+  return (progress < 0 ? progress : (int)dataset.get_measures().size());
+}
+
+int main(int argc, const char * argv[])
+{
+  string errmsg, mode, cachedir, cachefile;
+  vector<YDataStream*> streams;
+  YTemperature *sensor;
+  int measures, before, res;
+  long expected;
+  size_t i;
+
+  if (argc < 5) {
+    cerr << "usage: test_dlcache fill|check <hub_url> <request_log> <cache_dir>" << endl;
+    return 1;
+  }
+  mode = argv[1];
+  cachedir = argv[4];
+  yDisableExceptions();
+  if (yRegisterHub(argv[2], errmsg) != YAPI_SUCCESS) {
+    cerr << "RegisterHub error: " << errmsg << endl;
+    return 1;
+  }
+  sensor = yFirstTemperature();
+  if (sensor == NULL) {
+    cerr << "No temperature sensor found" << endl;
+    return 1;
+  }
+  cachefile = cachedir + "/" + sensor->get_hardwareId() + ".ydl";
+  if (mode == "fill") {
+    if (YAPI::SetDataLoggerCache(cachedir, errmsg) != YAPI_SUCCESS) {
+      cerr << "SetDataLoggerCache error: " << errmsg << endl;
+      return 1;
+    }
+    measures = loadAll(sensor, streams);
+    yFreeAPI();
+    return (measures > 0 ? 0 : 1);
+  }
+
+  res = YAPI::SetDataLoggerCache(cachedir + "/missing", errmsg);
+  check(res == YAPI_INVALID_ARGUMENT && errmsg.find("does not exist") != string::npos,
+        "missing directory rejected (" + errmsg + ")");
+  res = YAPI::SetDataLoggerCache(cachefile, errmsg);
+  check(res == YAPI_INVALID_ARGUMENT && errmsg.find("is not a directory") != string::npos,
+        "file instead of a directory rejected (" + errmsg + ")");
+  res = YAPI::SetDataLoggerCache(cachedir + "/", errmsg);
+  check(res == YAPI_SUCCESS, "existing directory accepted");
+
+  // every stream was stored once by the concurrent "fill" runs
+  before = streamDownloads(argv[3]);
+  measures = loadAll(sensor, streams);
+  check(measures > 0, "data set loaded");
+  check(streamDownloads(argv[3]) == before, "no stream downloaded again");
+  expected = 8;
+  for (i = 0; i < streams.size(); i++) {
+    // 32-bit measures: 2 words per row
+    expected += 16 + ((streams[i]->get_rowCount() * 4 + 3) & ~3);
+  }
+  check(fileSize(cachefile) == expected, "each stream stored once in the cache file");
+  check(YAPI::SetDataLoggerCache("", errmsg) == YAPI_SUCCESS, "cache disabled");
+  yFreeAPI();
+  cout << (failures ? "FAILED" : "PASSED") << endl;
+  return failures ? 1 : 0;
+}
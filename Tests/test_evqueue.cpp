@@ -0,0 +1,208 @@
+/*********************************************************************
+ *
+ * Test of the data event queue (YAPI::EventQueuePolicy)
+ *
+ * The stand-in hub sends a fixed number of notifications, numbered per
+ * function, faster than they are handled, so that the queue fills up.
+ * Checks for the given policy which events are delivered, that they are
+ * delivered in order for each function, and that every event is either
+ * delivered or counted as dropped:
+ *   python3 standin_hub.py --devices 4 --functions 5 --notify-period 2 --notify-value count \
+ *       --notify-count 12000 --notify-delay 2000 \
+ *       -- Binary_Linux/64bits/test_evqueue block 127.0.0.1:4444 12000
+ *
+ * With "api", the events are produced by the thread of the caller of the
+ * API: each forced device list update finds a new advertised value for
+ * more functions than the queue can hold. That thread may not wait for
+ * room, so the update must not stall, no event may be dropped, and
+ * yHandleEvents() must then deliver all of them in order:
+ *   python3 standin_hub.py --devices 250 --functions 20 --enum-count \
+ *       -- Binary_Linux/64bits/test_evqueue api 127.0.0.1:4444 3
+ *
+ *********************************************************************/
+
+#include "yocto_api.h"
+#include "yocto_temperature.h"
+#include "yapi/yapi.h"
+#include <iostream>
+#include <map>
+#include <vector>
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace std;
+
+static int failures = 0;
+static bool recording = false;
+static map<string, vector<int> > received;
+static u32 delivered = 0;
+
+static void check(bool cond, const string& what)
+{
+  cout << (cond ? "ok       " : "FAILED   ") << what << endl;
+  if (!cond) {
+    failures++;
+  }
+}
+
+static void valueCallback(YTemperature *func, const string& value)
+{
+  // skip the value given when the callback is registered
+  if (!recording) {
+    return;
+  }
+  received[func->get_hardwareId()].push_back(atoi(value.c_str()));
+  delivered++;
+}
+
+// Tell if the values received for each function are consecutive, starting
+// with the first one sent if fromFirst, ending with the last one if toLast
+static bool consecutive(int nbFunctions, int sentPerFunction, bool fromFirst, bool toLast)
+{
+  map<string, vector<int> >::iterator it;
+  size_t i;
+
+  if ((int)received.size() != nbFunctions) {
+    return false;
+  }
+  for (it = received.begin(); it != received.end(); it++) {
+    vector<int>& values = it->second;
+    for (i = 1; i < values.size(); i++) {
+      if (values[i] != values[i - 1] + 1) {
+        return false;
+      }
+    }
+    if (fromFirst && values[0] != 1) {
+      return false;
+    }
+    if (toLast && values.back() != sentPerFunction) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Events produced by the device list updates, on the thread of the caller
+static void apiThreadTest(int rounds)
+{
+  char errbuf[YOCTO_ERRMSG_LEN];
+  string errmsg;
+  map<string, vector<int> >::iterator it;
+  YTemperature *sensor;
+  u32 nbFunctions = 0, depth;
+  u64 start, elapsed, maxElapsed = 0;
+  bool ordered = true, allDepths = true;
+  int i;
+
+  for (sensor = yFirstTemperature(); sensor != NULL; sensor = sensor->nextTemperature()) {
+    sensor->registerValueCallback(valueCallback);
+    nbFunctions++;
+  }
+  YAPI::HandleEvents(errmsg);
+  check(nbFunctions > YAPI_DATAEVENT_QUEUE_SIZE, "api: " + to_string(nbFunctions) + " functions, more than the queue");
+  recording = true;
+  for (i = 0; i < rounds; i++) {
+    start = yGetTickCount();
+    yapiUpdateDeviceList(1, errbuf);
+    elapsed = yGetTickCount() - start;
+    maxElapsed = max(maxElapsed, elapsed);
+    depth = YAPI::GetEventQueueDepth();
+    if (depth != nbFunctions) {
+      allDepths = false;
+    }
+    YAPI::HandleEvents(errmsg);
+  }
+  cout << "  longest device list update: " << maxElapsed << " ms" << endl;
+  check(maxElapsed < YAPI_DATAEVENT_BLOCK_TIMEOUT, "api: device list updates did not wait for room");
+  check(allDepths, "api: one event per function queued by each update");
+  check(YAPI::GetEventQueuePeak() > YAPI_DATAEVENT_QUEUE_SIZE, "api: events kept beyond the ring");
+  check(YAPI::GetDroppedEventCount() == 0, "api: no event dropped");
+  check(delivered == nbFunctions * rounds && YAPI::GetEventQueueDepth() == 0, "api: all events delivered");
+  for (it = received.begin(); it != received.end(); it++) {
+    vector<int>& values = it->second;
+    if ((int)values.size() != rounds || values.back() != received.begin()->second.back()) {
+      ordered = false;
+      continue;
+    }
+    for (i = 1; i < (int)values.size(); i++) {
+      if (values[i] <= values[i - 1]) {
+        ordered = false;
+      }
+    }
+  }
+  check(received.size() == nbFunctions && ordered, "api: in order for each function");
+}
+
+int main(int argc, const char * argv[])
+{
+  string errmsg, policy;
+  YTemperature *sensor;
+  int total, nbFunctions = 0;
+  u64 deadline;
+
+  if (argc < 4) {
+    cerr << "usage: test_evqueue block|drop_oldest|drop_newest <hub_url> <notifications>" << endl;
+    cerr << "       test_evqueue api <hub_url> <updates>" << endl;
+    return 1;
+  }
+  policy = argv[1];
+  total = atoi(argv[3]);
+  if (policy == "block" || policy == "api") {
+    YAPI::EventQueuePolicy = YAPI::EVENTQUEUE_BLOCK;
+  } else if (policy == "drop_oldest") {
+    YAPI::EventQueuePolicy = YAPI::EVENTQUEUE_DROP_OLDEST;
+  } else {
+    YAPI::EventQueuePolicy = YAPI::EVENTQUEUE_DROP_NEWEST;
+  }
+  yDisableExceptions();
+  if (yRegisterHub(argv[2], errmsg) != YAPI_SUCCESS) {
+    cerr << "RegisterHub error: " << errmsg << endl;
+    return 1;
+  }
+  if (policy == "api") {
+    apiThreadTest(total);
+    yFreeAPI();
+    cout << (failures ? "FAILED" : "PASSED") << endl;
+    return failures ? 1 : 0;
+  }
+  for (sensor = yFirstTemperature(); sensor != NULL; sensor = sensor->nextTemperature()) {
+    sensor->registerValueCallback(valueCallback);
+    nbFunctions++;
+  }
+  recording = true;
+  // the hub sends its notifications after --notify-delay
+  deadline = yGetTickCount() + 60000;
+
+  if (policy == "block") {
+    // handle the events each time the queue is full, which blocks the
+    // producer, well before it gives up waiting for room
+    while (delivered + YAPI::GetDroppedEventCount() < (u32)total && yGetTickCount() < deadline) {
+      usleep(10000);
+      if (YAPI::GetEventQueueDepth() == YAPI_DATAEVENT_QUEUE_SIZE ||
+          delivered + YAPI::GetEventQueueDepth() == (u32)total) {
+        YAPI::HandleEvents(errmsg);
+      }
+    }
+    check(YAPI::GetEventQueuePeak() == YAPI_DATAEVENT_QUEUE_SIZE, "block: queue filled up");
+    check(YAPI::GetDroppedEventCount() == 0, "block: no event dropped");
+    check(delivered == (u32)total, "block: all events delivered");
+    check(consecutive(nbFunctions, total / nbFunctions, true, true), "block: in order for each function");
+  } else {
+    // let the queue overflow, then handle all the events at once
+    while (YAPI::GetEventQueueDepth() + YAPI::GetDroppedEventCount() < (u32)total && yGetTickCount() < deadline) {
+      usleep(100000);
+    }
+    check(YAPI::GetEventQueueDepth() == YAPI_DATAEVENT_QUEUE_SIZE, policy + ": queue full");
+    YAPI::HandleEvents(errmsg);
+    check(delivered == YAPI_DATAEVENT_QUEUE_SIZE, policy + ": a queue of events delivered");
+    check(delivered + YAPI::GetDroppedEventCount() == (u32)total, policy + ": other events counted as dropped");
+    if (policy == "drop_oldest") {
+      check(consecutive(nbFunctions, total / nbFunctions, false, true), policy + ": newest events kept, in order");
+    } else {
+      check(consecutive(nbFunctions, total / nbFunctions, true, false), policy + ": oldest events kept, in order");
+    }
+  }
+  yFreeAPI();
+  cout << (failures ? "FAILED" : "PASSED") << endl;
+  return failures ? 1 : 0;
+}
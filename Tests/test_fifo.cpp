@@ -0,0 +1,184 @@
+/*********************************************************************
+ *
+ * Test of the pattern searches (ymemfindEx, ySeekFifoEx, ySeekFifo32)
+ *
+ * Compares the searches with a plain byte-by-byte search, on random
+ * data made of a few letters so that partial matches are frequent, and
+ * on fifos whose content wraps around the end of their buffer, with
+ * matches placed across the wrap point. No hub is needed:
+ *   Binary_Linux/64bits/test_fifo
+ *
+ *********************************************************************/
+
+extern "C" {
+#include "yapi/yproto.h"
+}
+#include <iostream>
+#include <string>
+#include <stdlib.h>
+
+using namespace std;
+
+#define FIFO_SIZE   64
+
+static int failures = 0;
+
+static void check(bool cond, const string& what)
+{
+  cout << (cond ? "ok       " : "FAILED   ") << what << endl;
+  if (!cond) {
+    failures++;
+  }
+}
+
+static u8 fold(u8 c, bool textCompare)
+{
+  return (textCompare && c >= 'a' && c <= 'z' ? (u8)(c - 32) : c);
+}
+
+// First position of pattern in data[0..len), or -1
+static int refFind(const u8 *data, int len, const u8 *pattern, int patlen, bool textCompare)
+{
+  for (int pos = 0; pos + patlen <= len; pos++) {
+    int i = 0;
+    while (i < patlen && fold(data[pos + i], textCompare) == fold(pattern[i], textCompare)) {
+      i++;
+    }
+    if (i == patlen) {
+      return pos;
+    }
+  }
+  return -1;
+}
+
+static void randomText(u8 *data, int len)
+{
+  static const char letters[] = "aAbB\r\n";
+
+  for (int i = 0; i < len; i++) {
+    data[i] = letters[rand() % 6];
+  }
+}
+
+// Fill a fifo so that its content starts at offset head of its buffer
+static void fillFifo(yFifoBuf *fifo, u8 *buffer, int head, const u8 *data, int len)
+{
+  u8 skip[FIFO_SIZE];
+
+  yFifoInit(fifo, buffer, FIFO_SIZE);
+  yPushFifoEx(fifo, skip, (u16)head);
+  yPopFifoEx(fifo, NULL, (u16)head);
+  yPushFifoEx(fifo, data, (u16)len);
+}
+
+static void fillFifo32(yFifoBuf32 *fifo, u8 *buffer, int head, const u8 *data, int len)
+{
+  u8 skip[FIFO_SIZE];
+
+  yFifoInit32(fifo, buffer, FIFO_SIZE, YFIFO32_LOCKED);
+  yPushFifo32(fifo, skip, head);
+  yPopFifo32(fifo, NULL, head);
+  yPushFifo32(fifo, data, len);
+}
+
+int main(int argc, const char * argv[])
+{
+  u8 data[200], pattern[8], buffer[FIFO_SIZE];
+  yFifoBuf fifo;
+  yFifoBuf32 fifo32;
+  int i, len, patlen, head, pos, start, searchlen, expected, res;
+  int errors = 0, straddling = 0, wrapped = 0;
+  bool textCompare;
+
+  srand(1234);
+
+  // contiguous buffers, long enough to use the SIMD loop and its tail
+  for (i = 0; i < 200000; i++) {
+    len = rand() % 200;
+    patlen = 1 + rand() % 6;
+    textCompare = (rand() & 1) != 0;
+    randomText(data, len);
+    randomText(pattern, patlen);
+    if (ymemfindEx(data, len, pattern, patlen, textCompare) != refFind(data, len, pattern, patlen, textCompare)) {
+      errors++;
+    }
+  }
+  check(errors == 0, "ymemfindEx: same results as a byte-by-byte search");
+
+  // overlapping partial matches and a match at the last position
+  check(ymemfind((const u8*)"aaab", 4, (const u8*)"aab", 3) == 1, "ymemfind: self-overlapping pattern");
+  check(ymemfind((const u8*)"0123456789abcdefXY", 18, (const u8*)"XY", 2) == 16, "ymemfind: match at the last position");
+  check(ymemfindEx((const u8*)"Content-LENGTH: 12", 18, (const u8*)"content-length", 14, 1) == 0,
+        "ymemfindEx: case-insensitive match");
+
+  // fifos with random content at every position of the buffer
+  errors = 0;
+  for (i = 0; i < 100000; i++) {
+    head = rand() % FIFO_SIZE;
+    len = rand() % (FIFO_SIZE + 1);
+    patlen = 1 + rand() % 6;
+    start = (len ? rand() % len : 0);
+    searchlen = rand() % (FIFO_SIZE + 1);
+    textCompare = (rand() & 1) != 0;
+    randomText(data, len);
+    randomText(pattern, patlen);
+    if (head + len > FIFO_SIZE) {
+      wrapped++;
+    }
+    if (searchlen == 0 || searchlen > len - start) {
+      expected = refFind(data + start, len - start, pattern, patlen, textCompare);
+    } else {
+      expected = refFind(data + start, searchlen, pattern, patlen, textCompare);
+    }
+    expected = (expected < 0 ? 0xffff : start + expected);
+    fillFifo(&fifo, buffer, head, data, len);
+    if (ySeekFifoEx(&fifo, pattern, (u16)patlen, (u16)start, (u16)searchlen, textCompare) != expected) {
+      errors++;
+    }
+    yFifoCleanup(&fifo);
+    fillFifo32(&fifo32, buffer, head, data, len);
+    res = (int)ySeekFifo32(&fifo32, pattern, patlen, start, searchlen, textCompare);
+    yFifoCleanup32(&fifo32);
+    if (res != (expected == 0xffff ? (int)YFIFO32_NOT_FOUND : expected)) {
+      errors++;
+    }
+  }
+  check(wrapped > 10000 && errors == 0, "ySeekFifoEx, ySeekFifo32: same results as a byte-by-byte search");
+
+  // a single match across the wrap point, for every split of the pattern
+  errors = 0;
+  for (patlen = 2; patlen <= 6; patlen++) {
+    for (head = FIFO_SIZE - 20; head < FIFO_SIZE; head++) {
+      for (pos = 0; pos < 20; pos++) {
+        len = 20 + patlen;
+        memset(data, '.', len);
+        memcpy(pattern, "\r\nAbab", patlen);
+        memcpy(data + pos, pattern, patlen);
+        if (head + pos < FIFO_SIZE && head + pos + patlen > FIFO_SIZE) {
+          straddling++;
+        }
+        fillFifo(&fifo, buffer, head, data, len);
+        if (ySeekFifoEx(&fifo, pattern, (u16)patlen, 0, 0, 0) != pos) {
+          errors++;
+        }
+        if (ySeekFifoEx(&fifo, (const u8*)"\r\nABAB", (u16)patlen, 0, 0, 1) != pos) {
+          errors++;
+        }
+        // the match is outside a window which ends before its last byte
+        if (ySeekFifoEx(&fifo, pattern, (u16)patlen, 0, (u16)(pos + patlen - 1), 0) != 0xffff) {
+          errors++;
+        }
+        yFifoCleanup(&fifo);
+        fillFifo32(&fifo32, buffer, head, data, len);
+        if (ySeekFifo32(&fifo32, pattern, patlen, 0, 0, 0) != (u32)pos) {
+          errors++;
+        }
+        yFifoCleanup32(&fifo32);
+      }
+    }
+  }
+  check(straddling > 0 && errors == 0, "ySeekFifoEx, ySeekFifo32: matches across the wrap point");
+
+  cout << (failures ? "FAILED" : "PASSED") << endl;
+  return failures ? 1 : 0;
+}
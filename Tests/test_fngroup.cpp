@@ -0,0 +1,225 @@
+/*********************************************************************
+ *
+ * Test of the function groups (YFunctionGroup)
+ *
+ * Reads groups of temperature sensors spread over several hubs, and
+ * checks that each device gets a single request: the json of the
+ * function when the group has only one function on the device, the
+ * whole api.json otherwise. Checks the value read for each member, and
+ * that the members which cannot be loaded (device rejecting the
+ * requests, unknown device) get their own error and the invalid value,
+ * without affecting the other members. The stand-in hubs log the path of
+ * each request and reject the requests to the device TMPSENS1-00003:
+ *   python3 standin_hub.py --hubs 3 --devices 2 --functions 3 --fail TMPSENS1-00003 \
+ *       --log /tmp/requests.log -- Binary_Linux/64bits/test_fngroup 4444 3 /tmp/requests.log
+ *
+ *********************************************************************/
+
+#include "yocto_api.h"
+#include "yocto_temperature.h"
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+using namespace std;
+
+#define DEVICES     2       // devices per hub
+#define FUNCTIONS   3       // functions per device
+#define REJECTED    3       // device rejecting the requests
+
+static int failures = 0;
+
+static void check(bool cond, const string& what)
+{
+  cout << (cond ? "ok       " : "FAILED   ") << what << endl;
+  if (!cond) {
+    failures++;
+  }
+}
+
+// Return the paths of the requests to devices logged since line "skip"
+static vector<string> devicePaths(const string& logfile, size_t skip)
+{
+  vector<string> paths;
+  ifstream log(logfile.c_str());
+  string line;
+  size_t lines = 0, pos;
+
+  while (getline(log, line)) {
+    if (lines++ < skip) {
+      continue;
+    }
+    pos = line.find(' ');
+    if (pos != string::npos && line.compare(pos + 1, 10, "/bySerial/") == 0) {
+      paths.push_back(line.substr(pos + 1));
+    }
+  }
+  return paths;
+}
+
+static size_t logLines(const string& logfile)
+{
+  ifstream log(logfile.c_str());
+  string line;
+  size_t lines = 0;
+
+  while (getline(log, line)) {
+    lines++;
+  }
+  return lines;
+}
+
+static string serialOf(int device)
+{
+  char serial[32];
+
+  snprintf(serial, sizeof(serial), "TMPSENS1-%05d", device);
+  return serial;
+}
+
+// Value given by the stand-in hub to a function (numbered from 1)
+static double expectedValue(int device, int function)
+{
+  return 20.0 + (((device % DEVICES) * FUNCTIONS + function - 1) % 100) / 10.0;
+}
+
+// Read a group, and check the value and the error of each member. The
+// members are given as device and function numbers, device -1 for an
+// unknown device.
+static void readGroup(const string& name, const vector< pair<int,int> >& members,
+                      const string& logfile, const vector<string>& expectedPaths)
+{
+  YFunctionGroup<YTemperature> group;
+  vector<double> values;
+  vector<string> paths;
+  bool valuesOk = true, errorsOk = true, pathsOk;
+  size_t skip, i;
+  YRETCODE res, expectedRes = YAPI_SUCCESS;
+
+  for (i = 0; i < members.size(); i++) {
+    if (members[i].first < 0) {
+      group.add(yFindTemperature("NOSUCHDV-00000.temperature" + to_string(members[i].second)));
+    } else {
+      group.add(yFindTemperature(serialOf(members[i].first) + ".temperature" + to_string(members[i].second)));
+    }
+  }
+  skip = logLines(logfile);
+  values = group.read(&YTemperature::get_currentValue, YTemperature::CURRENTVALUE_INVALID);
+  paths = devicePaths(logfile, skip);
+  for (i = 0; i < members.size(); i++) {
+    int device = members[i].first;
+    res = group.get_errorType((int)i);
+    if (device < 0 || device == REJECTED) {
+      if (values[i] != YTemperature::CURRENTVALUE_INVALID) {
+        valuesOk = false;
+      }
+      if (res != (device < 0 ? YAPI_DEVICE_NOT_FOUND : YAPI_UNAUTHORIZED) || group.get_errorMessage((int)i) == "") {
+        errorsOk = false;
+      }
+    } else {
+      if (fabs(values[i] - expectedValue(device, members[i].second)) > 0.001) {
+        valuesOk = false;
+      }
+      if (res != YAPI_SUCCESS || group.get_errorMessage((int)i) != "") {
+        errorsOk = false;
+      }
+    }
+  }
+  check(values.size() == members.size() && valuesOk, name + ": value of each member, invalid value for the failed ones");
+  check(errorsOk, name + ": error of each member");
+  pathsOk = (paths.size() == expectedPaths.size());
+  for (i = 0; pathsOk && i < expectedPaths.size(); i++) {
+    size_t n = 0;
+    for (size_t k = 0; k < paths.size(); k++) {
+      if (paths[k] == expectedPaths[i]) {
+        n++;
+      }
+    }
+    pathsOk = (n == 1);
+  }
+  if (!pathsOk) {
+    for (i = 0; i < paths.size(); i++) {
+      cout << "  " << paths[i] << endl;
+    }
+  }
+  check(pathsOk, name + ": " + to_string(paths.size()) + " requests, one per device");
+  res = group.load(1000);
+  for (i = 0; i < members.size(); i++) {
+    if (YISERR(group.get_errorType((int)i))) {
+      expectedRes = group.get_errorType((int)i);
+      break;
+    }
+  }
+  check(res == expectedRes, name + ": load() returns the error of the first failed member");
+}
+
+int main(int argc, const char * argv[])
+{
+  string errmsg, logfile;
+  vector< pair<int,int> > members;
+  vector<string> expected;
+  char url[32];
+  int port, nbHubs, nbDevices, d, f;
+
+  if (argc < 4) {
+    cerr << "usage: test_fngroup <first_port> <hubs> <request_log>" << endl;
+    return 1;
+  }
+  port = atoi(argv[1]);
+  nbHubs = atoi(argv[2]);
+  logfile = argv[3];
+  nbDevices = nbHubs * DEVICES;
+  yDisableExceptions();
+  for (int i = 0; i < nbHubs; i++) {
+    snprintf(url, sizeof(url), "127.0.0.1:%d", port + i);
+    if (yRegisterHub(url, errmsg) != YAPI_SUCCESS) {
+      cerr << "RegisterHub error: " << errmsg << endl;
+      return 1;
+    }
+  }
+
+  // one function per device: the json of the function
+  members.clear();
+  expected.clear();
+  for (d = 0; d < nbDevices; d++) {
+    members.push_back(make_pair(d, 1 + d % FUNCTIONS));
+    expected.push_back("/bySerial/" + serialOf(d) + "/api/temperature" + to_string(1 + d % FUNCTIONS) + ".json");
+  }
+  members.push_back(make_pair(-1, 1));
+  readGroup("one function per device", members, logfile, expected);
+
+  // all the functions of each device: api.json
+  members.clear();
+  expected.clear();
+  for (d = 0; d < nbDevices; d++) {
+    for (f = 1; f <= FUNCTIONS; f++) {
+      members.push_back(make_pair(d, f));
+    }
+    expected.push_back("/bySerial/" + serialOf(d) + "/api.json");
+  }
+  members.push_back(make_pair(-1, 2));
+  readGroup("all the functions", members, logfile, expected);
+
+  // several functions on some devices, one on the others, a function added twice
+  members.clear();
+  expected.clear();
+  for (d = 0; d < nbDevices; d++) {
+    if (d % 2 == 0) {
+      members.push_back(make_pair(d, 1));
+      members.push_back(make_pair(d, 3));
+      expected.push_back("/bySerial/" + serialOf(d) + "/api.json");
+    } else {
+      members.push_back(make_pair(d, 2));
+      members.push_back(make_pair(d, 2));
+      expected.push_back("/bySerial/" + serialOf(d) + "/api/temperature2.json");
+    }
+  }
+  readGroup("mixed", members, logfile, expected);
+
+  yFreeAPI();
+  cout << (failures ? "FAILED" : "PASSED") << endl;
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,203 @@
+/*********************************************************************
+ *
+ * Test of the indexed white and yellow page lookups (yhash.c)
+ *
+ * Registers several hubs whose devices and functions all have a logical
+ * name, then walks the pages with yapiGetAllDevices and
+ * yapiGetFunctionsByClass, which scan the block lists, and checks that
+ * the indexed lookups (yapiGetDevice, yapiGetFunction) resolve every
+ * serial number, logical name, hardware id and mixed name to the same
+ * entry, for the class of the function and for its abstract class only.
+ * Then renames a function and unregisters a hub, and checks that the
+ * indexes follow. The stand-in hub must give names (--names):
+ *   python3 standin_hub.py --hubs 4 --devices 200 --functions 4 --names \
+ *       -- Binary_Linux/64bits/test_index 4444 4 200 4
+ *
+ *********************************************************************/
+
+#include "yocto_api.h"
+#include "yocto_temperature.h"
+#include "yapi/yapi.h"
+#include <iostream>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool cond, const string& what)
+{
+  cout << (cond ? "ok       " : "FAILED   ") << what << endl;
+  if (!cond) {
+    failures++;
+  }
+}
+
+// All the functions of a class, in the order of the yellow pages
+static vector<YAPI_FUNCTION> functionsByClass(const char *classname)
+{
+  char errmsg[YOCTO_ERRMSG_LEN];
+  vector<YAPI_FUNCTION> res;
+  int size = 0, n;
+
+  if (yapiGetFunctionsByClass(classname, 0, NULL, 0, &size, errmsg) < 0 || size == 0) {
+    return res;
+  }
+  res.resize(size / sizeof(YAPI_FUNCTION));
+  n = yapiGetFunctionsByClass(classname, 0, res.data(), size, &size, errmsg);
+  res.resize(n < 0 ? 0 : n);
+  return res;
+}
+
+// All the registered devices
+static vector<YAPI_DEVICE> allDevices(void)
+{
+  char errmsg[YOCTO_ERRMSG_LEN];
+  vector<YAPI_DEVICE> res;
+  int size = 0, n;
+
+  if (yapiGetAllDevices(NULL, 0, &size, errmsg) < 0 || size == 0) {
+    return res;
+  }
+  res.resize(size / sizeof(YAPI_DEVICE));
+  n = yapiGetAllDevices(res.data(), size, &size, errmsg);
+  res.resize(n < 0 ? 0 : n);
+  return res;
+}
+
+// Number of functions of a device, module excluded
+static int functionCount(YAPI_DEVICE dev)
+{
+  char errmsg[YOCTO_ERRMSG_LEN];
+  int size = 0;
+
+  if (yapiGetFunctionsByDevice(dev, 0, NULL, 0, &size, errmsg) < 0) {
+    return -1;
+  }
+  return size / (int)sizeof(YAPI_FUNCTION);
+}
+
+int main(int argc, const char * argv[])
+{
+  char errmsg[YOCTO_ERRMSG_LEN];
+  char serial[YOCTO_SERIAL_LEN], funcId[YOCTO_FUNCTION_LEN], funcName[YOCTO_LOGICAL_LEN];
+  char url[32];
+  string err, hwid, oldName;
+  vector<YAPI_DEVICE> devices;
+  vector<YAPI_FUNCTION> functions;
+  yDeviceSt infos;
+  YAPI_DEVICE dev;
+  int port, nbHubs, nbDevices, nbFunctions, i;
+  int badSerial = 0, badName = 0, badHwid = 0, badFunName = 0, badMixed = 0;
+  int badAbstract = 0, badOtherClass = 0, badModule = 0;
+
+  if (argc < 5) {
+    cerr << "usage: test_index <first_port> <hubs> <devices> <functions>" << endl;
+    return 1;
+  }
+  port = atoi(argv[1]);
+  nbHubs = atoi(argv[2]);
+  nbDevices = atoi(argv[3]);
+  nbFunctions = atoi(argv[4]);
+  yDisableExceptions();
+  for (i = 0; i < nbHubs; i++) {
+    snprintf(url, sizeof(url), "127.0.0.1:%d", port + i);
+    if (yRegisterHub(url, err) != YAPI_SUCCESS) {
+      cerr << "RegisterHub error: " << err << endl;
+      return 1;
+    }
+  }
+
+  // devices: by serial number and by logical name
+  devices = allDevices();
+  check((int)devices.size() == nbHubs * (nbDevices + 1),
+        to_string(devices.size()) + " devices registered");
+  for (i = 0; i < (int)devices.size(); i++) {
+    yapiGetDeviceInfo(devices[i], &infos, errmsg);
+    if (yapiGetDevice(infos.serial, errmsg) != devices[i]) {
+      badSerial++;
+    }
+    if (infos.logicalname[0] && yapiGetDevice(infos.logicalname, errmsg) != devices[i]) {
+      badName++;
+    }
+    if (string(infos.serial).compare(0, 8, "VIRTHUB0") != 0) {
+      if (functionCount(devices[i]) != nbFunctions ||
+          yapiGetFunction("Module", infos.logicalname, errmsg) !=
+          yapiGetFunction("Module", (string(infos.serial) + ".module").c_str(), errmsg)) {
+        badModule++;
+      }
+    }
+  }
+  check(badSerial == 0, "each device found by its serial number");
+  check(badName == 0, "each device found by its logical name");
+  check(badModule == 0, "functions of each device listed, module found by device name");
+
+  // functions: by hardware id, logical name and device name + function id
+  functions = functionsByClass("Temperature");
+  check((int)functions.size() == nbHubs * nbDevices * nbFunctions,
+        to_string(functions.size()) + " temperature functions registered");
+  for (i = 0; i < (int)functions.size(); i++) {
+    yapiGetFunctionInfo(functions[i], &dev, serial, funcId, funcName, NULL, errmsg);
+    yapiGetDeviceInfo(dev, &infos, errmsg);
+    hwid = string(serial) + "." + funcId;
+    if (yapiGetFunction("Temperature", hwid.c_str(), errmsg) != functions[i]) {
+      badHwid++;
+    }
+    if (yapiGetFunction("Temperature", funcName, errmsg) != functions[i]) {
+      badFunName++;
+    }
+    if (yapiGetFunction("Temperature", (string(infos.logicalname) + "." + funcId).c_str(), errmsg) != functions[i]) {
+      badMixed++;
+    }
+    if (yapiGetFunction("Sensor", hwid.c_str(), errmsg) != functions[i] ||
+        yapiGetFunction("Sensor", funcName, errmsg) != functions[i]) {
+      badAbstract++;
+    }
+    if (!YISERR(yapiGetFunction("Relay", hwid.c_str(), errmsg)) ||
+        !YISERR(yapiGetFunction("Relay", funcName, errmsg))) {
+      badOtherClass++;
+    }
+  }
+  check(badHwid == 0, "each function found by its hardware id");
+  check(badFunName == 0, "each function found by its logical name");
+  check(badMixed == 0, "each function found by device name and function id");
+  check(badAbstract == 0, "each function found through its abstract class");
+  check(badOtherClass == 0, "no function found through another class");
+  check(functionsByClass("Sensor").size() == functions.size(), "abstract class lists the same functions");
+
+  // a renamed function is found by its new name only
+  yapiGetFunctionInfo(functions[1], &dev, serial, funcId, funcName, NULL, errmsg);
+  hwid = string(serial) + "." + funcId;
+  oldName = funcName;
+  yFindTemperature(hwid)->set_logicalName("renamedTemp");
+  yapiUpdateDeviceList(1, errmsg);
+  check(yapiGetFunction("Temperature", "renamedTemp", errmsg) == functions[1], "function found by its new name");
+  check(YISERR(yapiGetFunction("Temperature", oldName.c_str(), errmsg)), "function no more found by its old name");
+  yFindTemperature(hwid)->set_logicalName(oldName);
+  yapiUpdateDeviceList(1, errmsg);
+  check(yapiGetFunction("Temperature", oldName.c_str(), errmsg) == functions[1], "function found again by its first name");
+
+  // the devices of an unregistered hub are no more found
+  if (nbHubs > 1) {
+    snprintf(url, sizeof(url), "127.0.0.1:%d", port + nbHubs - 1);
+    yapiGetFunctionInfo(functions.back(), &dev, serial, funcId, funcName, NULL, errmsg);
+    yapiGetDeviceInfo(dev, &infos, errmsg);
+    yUnregisterHub(url);
+    yapiUpdateDeviceList(1, errmsg);
+    check((int)allDevices().size() == (nbHubs - 1) * (nbDevices + 1), "devices of the hub removed");
+    check((int)functionsByClass("Temperature").size() == (nbHubs - 1) * nbDevices * nbFunctions,
+          "functions of the hub removed");
+    check(YISERR(yapiGetDevice(infos.serial, errmsg)) && YISERR(yapiGetDevice(infos.logicalname, errmsg)),
+          "removed device no more found");
+    check(YISERR(yapiGetFunction("Temperature", funcName, errmsg)) &&
+          YISERR(yapiGetFunction("Sensor", (string(serial) + "." + funcId).c_str(), errmsg)),
+          "removed function no more found");
+    check(yapiGetFunction("Temperature", oldName.c_str(), errmsg) == functions[1], "other hubs still found");
+  }
+
+  yFreeAPI();
+  cout << (failures ? "FAILED" : "PASSED") << endl;
+  return failures ? 1 : 0;
+}
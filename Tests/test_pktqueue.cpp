@@ -0,0 +1,243 @@
+/*********************************************************************
+ *
+ * Test of the USB packet queues (ystream.c)
+ *
+ * The packets of an interface go through a preallocated ring of
+ * PKT_QUEUE_SLOTS slots, and through an overflow list once the ring is
+ * full. Checks that the packets keep their order through the ring and
+ * the overflow list, that a popped slot is not reused before it is
+ * released, that the statistics count the packets which overflowed, and
+ * that an error set on the queue is seen on both sides. Then a producer
+ * thread pushes bursts of packets to a consumer which stalls from time
+ * to time, and every packet must come out once and in order:
+ *   Binary_Linux/64bits/test_pktqueue
+ *
+ *********************************************************************/
+
+extern "C" {
+#include "yapi/yproto.h"
+}
+#include <string>
+#include <iostream>
+#include <vector>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace std;
+
+#define THREADED_PACKETS    200000
+
+static int failures = 0;
+
+static void check(bool cond, const string& what)
+{
+  cout << (cond ? "ok       " : "FAILED   ") << what << endl;
+  if (!cond) {
+    failures++;
+  }
+}
+
+static void initQueues(yInterfaceSt *iface)
+{
+  memset(iface, 0, sizeof(yInterfaceSt));
+  yPktQueueInit(&iface->rxQueue);
+  yPktQueueInit(&iface->txQueue);
+}
+
+static void freeQueues(yInterfaceSt *iface)
+{
+  yPktQueueFree(&iface->rxQueue);
+  yPktQueueFree(&iface->txQueue);
+}
+
+// Push count packets numbered from seq
+static bool pushPackets(yInterfaceSt *iface, u32 seq, u32 count)
+{
+  char errmsg[YOCTO_ERRMSG_LEN];
+  USB_Packet pkt;
+
+  memset(&pkt, 0, sizeof(pkt));
+  for (u32 i = 0; i < count; i++) {
+    *(u32*)&pkt = seq + i;
+    if (yPktQueuePushD2H(iface, &pkt, errmsg) != YAPI_SUCCESS) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Pop and release count packets, check that they are numbered from seq
+static bool popPackets(yInterfaceSt *iface, u32 seq, u32 count)
+{
+  char errmsg[YOCTO_ERRMSG_LEN];
+  pktItem *item;
+  bool ordered = true;
+
+  for (u32 i = 0; i < count; i++) {
+    if (yPktQueueWaitAndPopD2H(iface, &item, 0, errmsg) != YAPI_SUCCESS || item == NULL) {
+      return false;
+    }
+    if (*(u32*)&item->pkt != seq + i) {
+      ordered = false;
+    }
+    yPktQueueReleaseD2H(iface, item);
+  }
+  return ordered;
+}
+
+static bool isEmpty(yInterfaceSt *iface)
+{
+  char errmsg[YOCTO_ERRMSG_LEN];
+  pktItem *item;
+
+  return yPktQueueWaitAndPopD2H(iface, &item, 0, errmsg) == YAPI_SUCCESS && item == NULL;
+}
+
+static void* producerThread(void *arg)
+{
+  yInterfaceSt *iface = (yInterfaceSt*)arg;
+  u32 seq = 0, burst;
+
+  while (seq < THREADED_PACKETS) {
+    burst = 1 + (seq * 7919) % (PKT_QUEUE_SLOTS * 3);
+    if (burst > THREADED_PACKETS - seq) {
+      burst = THREADED_PACKETS - seq;
+    }
+    if (!pushPackets(iface, seq, burst)) {
+      break;
+    }
+    seq += burst;
+    if (seq % 5 == 0) {
+      usleep(50);
+    }
+  }
+  return NULL;
+}
+
+int main(int argc, const char * argv[])
+{
+  char errmsg[YOCTO_ERRMSG_LEN];
+  yInterfaceSt iface;
+  vector<pktItem*> held;
+  pktItem *item;
+  pthread_t producer;
+  u32 highWater, i, expected, received;
+  u64 overflow;
+  bool ok;
+
+  // a full ring spills into the overflow list, in order
+  initQueues(&iface);
+  check(pushPackets(&iface, 0, PKT_QUEUE_SLOTS + 100), "push beyond the ring");
+  yPktQueueGetStats(&iface.rxQueue, &highWater, &overflow);
+  check(highWater == PKT_QUEUE_SLOTS && overflow == 100,
+        "ring filled, " + to_string(overflow) + " packets in the overflow list");
+  check(popPackets(&iface, 0, PKT_QUEUE_SLOTS + 100), "ring then overflow list popped in order");
+  check(isEmpty(&iface), "queue empty");
+
+  // slots freed while the overflow list is not empty are not used before it is drained
+  check(pushPackets(&iface, 0, PKT_QUEUE_SLOTS + 10) && popPackets(&iface, 0, 20) &&
+        pushPackets(&iface, PKT_QUEUE_SLOTS + 10, 30), "pop part of the ring, push more");
+  yPktQueueGetStats(&iface.rxQueue, NULL, &overflow);
+  check(overflow == 100 + 10 + 30, "new packets queued after the overflow list");
+  check(popPackets(&iface, 20, PKT_QUEUE_SLOTS + 20), "remaining packets popped in order");
+  check(isEmpty(&iface), "queue empty");
+  check(pushPackets(&iface, 0, PKT_QUEUE_SLOTS) && popPackets(&iface, 0, PKT_QUEUE_SLOTS), "ring used again once drained");
+  yPktQueueGetStats(&iface.rxQueue, NULL, &overflow);
+  check(overflow == 140, "no overflow on an empty ring");
+
+  // a popped slot is kept until it is released
+  check(pushPackets(&iface, 0, PKT_QUEUE_SLOTS), "fill the ring");
+  for (i = 0; i < 10; i++) {
+    yPktQueueWaitAndPopD2H(&iface, &item, 0, errmsg);
+    held.push_back(item);
+  }
+  check(pushPackets(&iface, PKT_QUEUE_SLOTS, 10), "push while 10 popped packets are not released");
+  yPktQueueGetStats(&iface.rxQueue, NULL, &overflow);
+  ok = (overflow == 150);
+  for (i = 0; i < held.size(); i++) {
+    if (*(u32*)&held[i]->pkt != i) {
+      ok = false;
+    }
+    yPktQueueReleaseD2H(&iface, held[i]);
+  }
+  held.clear();
+  check(ok, "held packets not overwritten, new packets in the overflow list");
+  check(popPackets(&iface, 10, PKT_QUEUE_SLOTS), "remaining packets popped in order");
+  check(isEmpty(&iface), "queue empty");
+
+  // the packets to send are peeked across the ring and the overflow list
+  ok = true;
+  for (i = 0; i < PKT_QUEUE_SLOTS + 20; i++) {
+    USB_Packet pkt;
+    memset(&pkt, 0, sizeof(pkt));
+    *(u32*)&pkt = i;
+    yPktQueuePushH2D(&iface, &pkt, errmsg);
+  }
+  for (i = 0; i < PKT_QUEUE_SLOTS + 20; i++) {
+    if (yPktQueuePeekNthH2D(&iface, i, &item) != YAPI_SUCCESS || item == NULL || *(u32*)&item->pkt != i) {
+      ok = false;
+    }
+  }
+  yPktQueuePeekNthH2D(&iface, PKT_QUEUE_SLOTS + 20, &item);
+  check(ok && item == NULL, "n-th packet to send peeked in the ring and in the overflow list");
+  for (i = 0; i < PKT_QUEUE_SLOTS + 20; i++) {
+    if (yPktQueuePopH2D(&iface, &item) != YAPI_SUCCESS || item == NULL || *(u32*)&item->pkt != i) {
+      ok = false;
+      break;
+    }
+    yPktQueueReleaseH2D(&iface, item);
+  }
+  check(ok, "packets to send popped in order");
+
+  // an error is seen by the producer and the consumer
+  pushPackets(&iface, 0, 5);
+  yPktQueueSetError(&iface.rxQueue, YAPI_IO_ERROR, "device lost");
+  check(!pushPackets(&iface, 5, 1), "push refused after an error");
+  errmsg[0] = 0;
+  check(yPktQueueWaitAndPopD2H(&iface, &item, 100, errmsg) == YAPI_IO_ERROR && item == NULL &&
+        string(errmsg) == "device lost", "pop returns the error");
+  freeQueues(&iface);
+
+  // a producer thread and a slow consumer
+  initQueues(&iface);
+  pthread_create(&producer, NULL, producerThread, &iface);
+  expected = 0;
+  received = 0;
+  ok = true;
+  while (received < THREADED_PACKETS) {
+    if (yPktQueueWaitAndPopD2H(&iface, &item, 1000, errmsg) != YAPI_SUCCESS || item == NULL) {
+      break;
+    }
+    if (*(u32*)&item->pkt != expected) {
+      ok = false;
+    }
+    expected = *(u32*)&item->pkt + 1;
+    received++;
+    // keep a few packets before releasing them, and stall from time to time
+    held.push_back(item);
+    if (held.size() == 8 || received % 3 == 0) {
+      for (i = 0; i < held.size(); i++) {
+        yPktQueueReleaseD2H(&iface, held[i]);
+      }
+      held.clear();
+    }
+    if (received % 2000 == 0) {
+      usleep(2000);
+    }
+  }
+  for (i = 0; i < held.size(); i++) {
+    yPktQueueReleaseD2H(&iface, held[i]);
+  }
+  pthread_join(producer, NULL);
+  yPktQueueGetStats(&iface.rxQueue, &highWater, &overflow);
+  cout << "  " << received << " packets, ring high water " << highWater << ", "
+       << overflow << " packets in the overflow list" << endl;
+  check(received == THREADED_PACKETS && ok, "threaded: every packet popped once and in order");
+  check(highWater == PKT_QUEUE_SLOTS && overflow > 0, "threaded: ring filled and overflow list used");
+  check(isEmpty(&iface), "threaded: queue empty");
+  freeQueues(&iface);
+
+  cout << (failures ? "FAILED" : "PASSED") << endl;
+  return failures ? 1 : 0;
+}
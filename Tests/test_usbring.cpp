@@ -0,0 +1,585 @@
+/*********************************************************************
+ *
+ * Test of the ring of USB transfers of the Linux backend (ypkt_lin.c)
+ *
+ * No hardware is needed: this program provides its own libusb, with a
+ * simulated device whose transfers are completed in order by a thread
+ * of the test, as libusb_handle_events would do. Checks that all the
+ * read and write transfers of the ring are used, that the packets keep
+ * their order both ways, and that a failed write is seen by the sender.
+ *
+ * Then 20 simulated devices send timed reports at 1 kHz all together.
+ * As with a real endpoint, a device keeps one report while no transfer
+ * is submitted and loses the next ones; the simulated libusb event
+ * thread stalls regularly, like a late event thread, and only then runs
+ * the callbacks which resubmit the transfers. The number of lost and
+ * late reports (received more than STRESS_LATE_MS after they were sent)
+ * is shown and checked against STRESS_MAX_LOST and STRESS_MAX_LATE
+ * (Linux only, linked without -lusb-1.0):
+ *   Binary_Linux/64bits/test_usbring
+ *
+ *********************************************************************/
+
+extern "C" {
+#include "yapi/yproto.h"
+}
+#include <string>
+#include <iostream>
+#include <algorithm>
+#include <deque>
+#include <vector>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+
+using namespace std;
+
+#define RD_ENDPOINT 0x81
+#define WR_ENDPOINT 0x01
+
+#define STRESS_DEVICES      20
+#define STRESS_RATE         1000    // reports per second, all devices together
+#define STRESS_SECONDS      4
+#define STRESS_STALL_EVERY  250     // the event thread stalls every ... ms
+#define STRESS_STALL_MS     40      // ... for this long
+#define STRESS_LATE_MS      100
+#define STRESS_MAX_LOST     0       // per thousand
+#define STRESS_MAX_LATE     5       // per thousand
+
+static int failures = 0;
+
+static void check(bool cond, const string& what)
+{
+  cout << (cond ? "ok       " : "FAILED   ") << what << endl;
+  if (!cond) {
+    failures++;
+  }
+}
+
+// The simulated device
+static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+static deque<libusb_transfer*> rdPending, wrPending, cancelled;
+static vector<u32> received;          // sequence numbers of the packets written
+static u32 toSend = 0, nextSeq = 0;   // packets the device has to send
+static int nbWrites = 0, failWrite = -1;
+static size_t maxRdInFlight = 0, maxWrInFlight = 0;
+static int nbAlloc = 0, nbFree = 0;
+static volatile bool pumpStop = false;
+static char fakeHandle, fakeDevice;
+
+static struct libusb_endpoint_descriptor endpoints[2];
+static struct libusb_interface_descriptor altsetting;
+static struct libusb_interface interfaces;
+static struct libusb_config_descriptor config;
+
+// The devices of the stress test, the address of each is its device and handle
+struct StressDev {
+  char                    handle;
+  deque<libusb_transfer*> submitted;  // transfers waiting for a report
+  bool                    buffered;   // the report kept by the endpoint
+  u32                     bufSeq;
+  u32                     nextSeq;
+  u32                     lost;
+  vector<double>          sentAt;     // send time of each report
+};
+static StressDev stressDevs[STRESS_DEVICES];
+static deque<libusb_transfer*> stressDone;  // completed by the devices, callback not yet run
+static deque<libusb_transfer*> stressCancelled;  // cancelled, callback not yet run
+static int stressInCallback = 0;
+static volatile bool stressStop = false;
+static volatile bool stressEventsStop = false;
+
+static StressDev* stressDev(libusb_device_handle *h)
+{
+  char *p = (char*)h;
+
+  for (int i = 0; i < STRESS_DEVICES; i++) {
+    if (p == &stressDevs[i].handle) {
+      return &stressDevs[i];
+    }
+  }
+  return NULL;
+}
+
+// monotonic time in [ms]
+static double now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static bool removeFrom(deque<libusb_transfer*>& list, libusb_transfer *tr)
+{
+  for (size_t i = 0; i < list.size(); i++) {
+    if (list[i] == tr) {
+      list.erase(list.begin() + i);
+      return true;
+    }
+  }
+  return false;
+}
+
+// Complete the transfers in order, one per endpoint at a time
+static void* pumpThread(void *arg)
+{
+  libusb_transfer *tr;
+
+  while (!pumpStop) {
+    tr = NULL;
+    pthread_mutex_lock(&mtx);
+    if (!cancelled.empty()) {
+      tr = cancelled.front();
+      cancelled.pop_front();
+      tr->status = LIBUSB_TRANSFER_CANCELLED;
+      tr->actual_length = 0;
+    } else if (!wrPending.empty()) {
+      tr = wrPending.front();
+      wrPending.pop_front();
+      if (nbWrites++ == failWrite) {
+        tr->status = LIBUSB_TRANSFER_ERROR;
+        tr->actual_length = 0;
+      } else {
+        tr->status = LIBUSB_TRANSFER_COMPLETED;
+        tr->actual_length = tr->length;
+        received.push_back(*(u32*)tr->buffer);
+      }
+    } else if (!rdPending.empty() && toSend > 0) {
+      tr = rdPending.front();
+      rdPending.pop_front();
+      toSend--;
+      memset(tr->buffer, 0, tr->length);
+      *(u32*)tr->buffer = nextSeq++;
+      tr->status = LIBUSB_TRANSFER_COMPLETED;
+      tr->actual_length = tr->length;
+    }
+    pthread_mutex_unlock(&mtx);
+    if (tr) {
+      tr->callback(tr);
+    } else {
+      usleep(100);
+    }
+  }
+  return NULL;
+}
+
+// Fill a submitted transfer with a report, the kernel does it without the event thread
+static void stressFill(StressDev *sd, libusb_transfer *tr, u32 seq)
+{
+  memset(tr->buffer, 0, tr->length);
+  *(u32*)tr->buffer = seq;
+  tr->status = LIBUSB_TRANSFER_COMPLETED;
+  tr->actual_length = tr->length;
+  stressDone.push_back(tr);
+}
+
+// The devices: one report at a time, in turn, at STRESS_RATE
+static void* stressDevicesThread(void *arg)
+{
+  struct timespec ts;
+  StressDev *sd;
+  u64 tick = 0;
+  double next = now();
+  u32 seq;
+
+  while (!stressStop) {
+    next += 1000.0 / STRESS_RATE;
+    ts.tv_sec = (time_t)(next / 1000);
+    ts.tv_nsec = (long)((next - ts.tv_sec * 1000.0) * 1e6);
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    pthread_mutex_lock(&mtx);
+    sd = &stressDevs[tick++ % STRESS_DEVICES];
+    seq = sd->nextSeq++;
+    sd->sentAt.push_back(now());
+    if (!sd->submitted.empty()) {
+      stressFill(sd, sd->submitted.front(), seq);
+      sd->submitted.pop_front();
+    } else if (!sd->buffered) {
+      sd->buffered = true;
+      sd->bufSeq = seq;
+    } else {
+      sd->lost++;
+    }
+    pthread_mutex_unlock(&mtx);
+  }
+  return NULL;
+}
+
+// The libusb event thread: runs the callbacks, stalls regularly
+static void* stressEventThread(void *arg)
+{
+  libusb_transfer *tr;
+  double nextStall = now() + STRESS_STALL_EVERY;
+
+  while (!stressEventsStop) {
+    if (!stressStop && now() >= nextStall) {
+      usleep(STRESS_STALL_MS * 1000);
+      nextStall += STRESS_STALL_EVERY;
+    }
+    tr = NULL;
+    pthread_mutex_lock(&mtx);
+    if (!stressCancelled.empty()) {
+      // as libusb, the status is only changed when the callback is run; the
+      // lock keeps the transfer from being freed before the callback returns
+      tr = stressCancelled.front();
+      stressCancelled.pop_front();
+      tr->status = LIBUSB_TRANSFER_CANCELLED;
+      tr->actual_length = 0;
+      tr->callback(tr);
+      pthread_mutex_unlock(&mtx);
+      continue;
+    }
+    if (!stressDone.empty()) {
+      tr = stressDone.front();
+      stressDone.pop_front();
+      stressInCallback++;
+    }
+    pthread_mutex_unlock(&mtx);
+    if (tr) {
+      tr->callback(tr);
+      pthread_mutex_lock(&mtx);
+      stressInCallback--;
+      pthread_mutex_unlock(&mtx);
+    } else {
+      usleep(100);
+    }
+  }
+  return NULL;
+}
+
+extern "C" {
+
+int libusb_init(libusb_context **ctx) { *ctx = NULL; return 0; }
+void libusb_exit(libusb_context *ctx) { }
+int libusb_handle_events_timeout(libusb_context *ctx, struct timeval *tv) { usleep(10000); return 0; }
+ssize_t libusb_get_device_list(libusb_context *ctx, libusb_device ***list)
+{
+  *list = (libusb_device**)calloc(1, sizeof(libusb_device*));
+  return 0;
+}
+void libusb_free_device_list(libusb_device **list, int unref) { free(list); }
+int libusb_get_device_descriptor(libusb_device *dev, struct libusb_device_descriptor *desc) { return LIBUSB_ERROR_IO; }
+int libusb_get_active_config_descriptor(libusb_device *dev, struct libusb_config_descriptor **c)
+{
+  *c = &config;
+  return 0;
+}
+int libusb_get_config_descriptor(libusb_device *dev, uint8_t idx, struct libusb_config_descriptor **c)
+{
+  *c = &config;
+  return 0;
+}
+void libusb_free_config_descriptor(struct libusb_config_descriptor *c) { }
+libusb_device *libusb_ref_device(libusb_device *dev) { return dev; }
+int libusb_open(libusb_device *dev, libusb_device_handle **h)
+{
+  *h = (libusb_device_handle*)(stressDev((libusb_device_handle*)dev) ? (char*)dev : &fakeHandle);
+  return 0;
+}
+void libusb_close(libusb_device_handle *h) { }
+int libusb_reset_device(libusb_device_handle *h) { return 0; }
+int libusb_kernel_driver_active(libusb_device_handle *h, int i) { return 0; }
+int libusb_detach_kernel_driver(libusb_device_handle *h, int i) { return 0; }
+int libusb_attach_kernel_driver(libusb_device_handle *h, int i) { return 0; }
+int libusb_claim_interface(libusb_device_handle *h, int i) { return 0; }
+int libusb_release_interface(libusb_device_handle *h, int i) { return 0; }
+int libusb_clear_halt(libusb_device_handle *h, unsigned char ep) { return 0; }
+int libusb_control_transfer(libusb_device_handle *h, uint8_t rt, uint8_t r, uint16_t v, uint16_t i,
+                            unsigned char *d, uint16_t l, unsigned int to)
+{
+  return LIBUSB_ERROR_IO;
+}
+
+struct libusb_transfer *libusb_alloc_transfer(int n)
+{
+  pthread_mutex_lock(&mtx);
+  nbAlloc++;
+  pthread_mutex_unlock(&mtx);
+  return (struct libusb_transfer*)calloc(1, sizeof(struct libusb_transfer));
+}
+
+void libusb_free_transfer(struct libusb_transfer *tr)
+{
+  pthread_mutex_lock(&mtx);
+  nbFree++;
+  // a transfer freed before its callback is run is forgotten
+  removeFrom(stressDone, tr);
+  removeFrom(stressCancelled, tr);
+  pthread_mutex_unlock(&mtx);
+  free(tr);
+}
+
+int libusb_submit_transfer(struct libusb_transfer *tr)
+{
+  StressDev *sd = stressDev(tr->dev_handle);
+
+  pthread_mutex_lock(&mtx);
+  if (sd) {
+    if (tr->endpoint != RD_ENDPOINT) {
+      tr->status = LIBUSB_TRANSFER_COMPLETED;
+      tr->actual_length = tr->length;
+      stressDone.push_back(tr);
+    } else if (sd->buffered) {
+      sd->buffered = false;
+      stressFill(sd, tr, sd->bufSeq);
+    } else {
+      sd->submitted.push_back(tr);
+    }
+  } else if (tr->endpoint == RD_ENDPOINT) {
+    rdPending.push_back(tr);
+    maxRdInFlight = max(maxRdInFlight, rdPending.size());
+  } else {
+    wrPending.push_back(tr);
+    maxWrInFlight = max(maxWrInFlight, wrPending.size());
+  }
+  pthread_mutex_unlock(&mtx);
+  return 0;
+}
+
+int libusb_cancel_transfer(struct libusb_transfer *tr)
+{
+  int res = LIBUSB_ERROR_NOT_FOUND;
+
+  StressDev *sd = stressDev(tr->dev_handle);
+
+  pthread_mutex_lock(&mtx);
+  if (sd && removeFrom(sd->submitted, tr)) {
+    stressCancelled.push_back(tr);
+    res = 0;
+  } else if (removeFrom(rdPending, tr) || removeFrom(wrPending, tr)) {
+    cancelled.push_back(tr);
+    res = 0;
+  }
+  pthread_mutex_unlock(&mtx);
+  return res;
+}
+
+}
+
+// Push count packets numbered from seq and wait until they are all sent
+static int writePackets(yInterfaceSt *iface, u32 seq, int count, char *errmsg)
+{
+  USB_Packet pkt;
+  int res;
+
+  memset(&pkt, 0, sizeof(pkt));
+  for (int i = 0; i < count - 1; i++) {
+    *(u32*)&pkt = seq++;
+    res = yPktQueuePushH2D(iface, &pkt, errmsg);
+    if (res < 0) {
+      return res;
+    }
+  }
+  res = yyySignalOutPkt(iface, errmsg);
+  if (res < 0) {
+    return res;
+  }
+  *(u32*)&pkt = seq;
+  return yyySendPacket(iface, &pkt, errmsg);
+}
+
+static bool increasing(const vector<u32>& values)
+{
+  for (size_t i = 1; i < values.size(); i++) {
+    if (values[i] <= values[i - 1]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// 20 devices at 1 kHz all together, with a late event thread
+static void stressTest(void)
+{
+  char err[YOCTO_ERRMSG_LEN];
+  static yInterfaceSt ifaces[STRESS_DEVICES];
+  pthread_t devices, events;
+  pktItem *item;
+  u32 expected[STRESS_DEVICES];
+  u32 sent = 0, received = 0, lost = 0, late = 0, outOfOrder = 0, seq;
+  double stop, delay, maxDelay = 0;
+  int i, res, setupErrors = 0;
+
+  for (i = 0; i < STRESS_DEVICES; i++) {
+    memset(&ifaces[i], 0, sizeof(yInterfaceSt));
+    ifaces[i].devref = (libusb_device*)&stressDevs[i].handle;
+    snprintf(ifaces[i].serial, sizeof(ifaces[i].serial), "STRESSUSB-%05d", i + 1);
+    res = yyySetup(&ifaces[i], err);
+    if (res != YAPI_SUCCESS) {
+      setupErrors++;
+    }
+    expected[i] = 0;
+  }
+  check(setupErrors == 0, "stress: setup of " + to_string(STRESS_DEVICES) + " interfaces");
+  pthread_create(&devices, NULL, stressDevicesThread, NULL);
+  pthread_create(&events, NULL, stressEventThread, NULL);
+  // the consumer polls all the queues, as the device threads of the library do
+  stop = now() + STRESS_SECONDS * 1000.0;
+  while (now() < stop + STRESS_LATE_MS * 2) {
+    if (now() >= stop && !stressStop) {
+      stressStop = true;
+      pthread_join(devices, NULL);
+    }
+    bool any = false;
+    for (i = 0; i < STRESS_DEVICES; i++) {
+      while (yPktQueueWaitAndPopD2H(&ifaces[i], &item, 0, err) == YAPI_SUCCESS && item != NULL) {
+        seq = *(u32*)&item->pkt;
+        yPktQueueReleaseD2H(&ifaces[i], item);
+        pthread_mutex_lock(&mtx);
+        delay = now() - stressDevs[i].sentAt[seq];
+        pthread_mutex_unlock(&mtx);
+        if (seq < expected[i]) {
+          outOfOrder++;
+        } else {
+          expected[i] = seq + 1;
+        }
+        received++;
+        maxDelay = max(maxDelay, delay);
+        if (delay > STRESS_LATE_MS) {
+          late++;
+        }
+        any = true;
+      }
+    }
+    if (!any) {
+      usleep(500);
+    }
+  }
+  for (i = 0; i < STRESS_DEVICES; i++) {
+    sent += stressDevs[i].nextSeq;
+    lost += stressDevs[i].lost;
+    // a report kept by the endpoint at the end is not lost
+    if (stressDevs[i].buffered) {
+      sent--;
+    }
+  }
+  cout << "  " << STRESS_DEVICES << " devices, " << STRESS_RATE << " reports/s, event thread stalled "
+       << STRESS_STALL_MS << " ms every " << STRESS_STALL_EVERY << " ms, " << NB_LINUX_USB_TR
+       << " read transfers per interface" << endl;
+  cout << "  " << sent << " reports sent, " << received << " received, " << lost << " lost, "
+       << late << " late (> " << STRESS_LATE_MS << " ms), max delay " << maxDelay << " ms" << endl;
+  check(received + lost == sent && outOfOrder == 0, "stress: every report received once and in order, or lost");
+  check(lost * 1000 <= sent * STRESS_MAX_LOST, "stress: lost reports within " + to_string(STRESS_MAX_LOST) + " per thousand");
+  check(late * 1000 <= sent * STRESS_MAX_LATE, "stress: late reports within " + to_string(STRESS_MAX_LATE) + " per thousand");
+  // let the event thread run the callbacks of the completed transfers, which
+  // are freed by the shutdown
+  for (bool idle = false; !idle; usleep(1000)) {
+    pthread_mutex_lock(&mtx);
+    idle = stressDone.empty() && stressInCallback == 0;
+    pthread_mutex_unlock(&mtx);
+  }
+  for (i = 0; i < STRESS_DEVICES; i++) {
+    yyyPacketShutdown(&ifaces[i]);
+  }
+  stressEventsStop = true;
+  pthread_join(events, NULL);
+}
+
+int main(int argc, const char * argv[])
+{
+  char err[YOCTO_ERRMSG_LEN];
+  yInterfaceSt iface;
+  pktItem *item;
+  pthread_t pump;
+  vector<u32> values;
+  u32 seq, failed;
+  double deadline;
+  int i, res;
+  bool ordered = true;
+
+  endpoints[0].bEndpointAddress = RD_ENDPOINT;
+  endpoints[1].bEndpointAddress = WR_ENDPOINT;
+  altsetting.bNumEndpoints = 2;
+  altsetting.endpoint = endpoints;
+  interfaces.altsetting = &altsetting;
+  interfaces.num_altsetting = 1;
+  config.bNumInterfaces = 1;
+  config.interface = &interfaces;
+
+  if (yapiInitAPI(Y_DETECT_NONE, err) != YAPI_SUCCESS) {
+    cerr << "InitAPI error: " << err << endl;
+    return 1;
+  }
+  pthread_create(&pump, NULL, pumpThread, NULL);
+  memset(&iface, 0, sizeof(iface));
+  iface.devref = (libusb_device*)&fakeDevice;
+  strcpy(iface.serial, "FAKEUSB1-00001");
+  res = yyySetup(&iface, err);
+  check(res == YAPI_SUCCESS, "setup");
+  check(maxRdInFlight == NB_LINUX_USB_TR, "read: all the transfers of the ring submitted");
+
+  // the device sends a burst of packets
+  pthread_mutex_lock(&mtx);
+  toSend = 5000;
+  pthread_mutex_unlock(&mtx);
+  // the event wait runs on the wall clock, the one second without packet
+  // is measured on the monotonic clock
+  deadline = now() + 1000;
+  while (values.size() < 5000 && now() < deadline) {
+    if (yPktQueueWaitAndPopD2H(&iface, &item, 100, err) == YAPI_SUCCESS && item != NULL) {
+      values.push_back(*(u32*)&item->pkt);
+      yPktQueueReleaseD2H(&iface, item);
+      deadline = now() + 1000;
+    }
+  }
+  for (i = 0; i < (int)values.size(); i++) {
+    if (values[i] != (u32)i) {
+      ordered = false;
+    }
+  }
+  check(values.size() == 5000 && ordered, "read: all packets received, in order");
+  usleep(10000);
+  pthread_mutex_lock(&mtx);
+  check(rdPending.size() == NB_LINUX_USB_TR, "read: transfers resubmitted by their callback");
+  pthread_mutex_unlock(&mtx);
+
+  // the host sends bursts of packets
+  for (seq = 0, res = YAPI_SUCCESS; seq < 2000 && res == YAPI_SUCCESS; seq += 10) {
+    res = writePackets(&iface, seq, 10, err);
+  }
+  check(res == YAPI_SUCCESS, "write: no error");
+  pthread_mutex_lock(&mtx);
+  values = received;
+  pthread_mutex_unlock(&mtx);
+  ordered = true;
+  for (i = 0; i < (int)values.size(); i++) {
+    if (values[i] != (u32)i) {
+      ordered = false;
+    }
+  }
+  check(values.size() == 2000 && ordered, "write: all packets sent, in order");
+  check(maxWrInFlight == NB_LINUX_USB_WR_TR, "write: all the transfers of the ring used");
+
+  // the third packet of the next burst fails
+  pthread_mutex_lock(&mtx);
+  failWrite = nbWrites + 2;
+  received.clear();
+  pthread_mutex_unlock(&mtx);
+  failed = seq + 2;
+  res = writePackets(&iface, seq, 10, err);
+  check(res == YAPI_IO_ERROR, "write failure: error seen by the sender");
+  usleep(10000);
+  pthread_mutex_lock(&mtx);
+  values = received;
+  pthread_mutex_unlock(&mtx);
+  check(increasing(values) && find(values.begin(), values.end(), failed) == values.end() &&
+        values.size() <= 2 + NB_LINUX_USB_WR_TR - 1,
+        "write failure: packet not retried, only the packets in flight sent after it");
+  res = writePackets(&iface, seq + 10, 1, err);
+  check(res == YAPI_IO_ERROR, "write failure: error kept until the next setup");
+
+  yyyPacketShutdown(&iface);
+  pthread_mutex_lock(&mtx);
+  check(rdPending.empty() && wrPending.empty() && cancelled.empty(), "shutdown: all transfers cancelled");
+  check(nbAlloc == nbFree && nbAlloc == NB_LINUX_USB_TR + NB_LINUX_USB_WR_TR, "shutdown: all transfers freed");
+  pthread_mutex_unlock(&mtx);
+
+  pumpStop = true;
+  pthread_join(pump, NULL);
+
+  stressTest();
+  yapiFreeAPI();
+  cout << (failures ? "FAILED" : "PASSED") << endl;
+  return failures ? 1 : 0;
+}
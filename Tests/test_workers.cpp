@@ -0,0 +1,139 @@
+/*********************************************************************
+ *
+ * Test of the callback workers (YAPI::SetCallbackWorkers)
+ *
+ * The stand-in hub sends a fixed number of notifications, numbered per
+ * function. The value callbacks are slow, so that events wait in the
+ * worker queues. Checks that stopping the workers runs the events routed
+ * to them first, and that the events of each function are delivered in
+ * order, with and without workers:
+ *   python3 standin_hub.py --devices 4 --functions 5 --notify-period 20 --notify-value count \
+ *       --notify-count 3000 --notify-delay 2000 \
+ *       -- Binary_Linux/64bits/test_workers 127.0.0.1:4444 3000
+ *
+ *********************************************************************/
+
+#include "yocto_api.h"
+#include "yocto_temperature.h"
+#include <iostream>
+#include <map>
+#include <vector>
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace std;
+
+static int failures = 0;
+static bool recording = false;
+static map<string, vector<int> > received;  // entries created before the callbacks run
+static volatile u32 delivered = 0;
+
+static void check(bool cond, const string& what)
+{
+  cout << (cond ? "ok       " : "FAILED   ") << what << endl;
+  if (!cond) {
+    failures++;
+  }
+}
+
+static void valueCallback(YTemperature *func, const string& value)
+{
+  // skip the value given when the callback is registered
+  if (!recording) {
+    return;
+  }
+  usleep(3000);
+  // the events of a function are all handled by the same thread
+  received[func->get_hardwareId()].push_back(atoi(value.c_str()));
+  __sync_fetch_and_add(&delivered, 1);
+}
+
+// Number of events routed to the workers: run or waiting
+static u32 routed(u32& pending)
+{
+  vector<yapiWorkerStats> stats;
+  u32 res = 0;
+
+  YAPI::GetCallbackWorkerStats(stats);
+  pending = 0;
+  for (size_t i = 0; i < stats.size(); i++) {
+    res += stats[i].processed + stats[i].pending;
+    pending += stats[i].pending;
+  }
+  return res;
+}
+
+int main(int argc, const char * argv[])
+{
+  string errmsg;
+  YTemperature *sensor;
+  map<string, vector<int> >::iterator it;
+  int total, nbFunctions = 0;
+  u32 expected, pending, stopped;
+  bool ordered = true;
+  u64 deadline;
+
+  if (argc < 3) {
+    cerr << "usage: test_workers <hub_url> <notifications>" << endl;
+    return 1;
+  }
+  total = atoi(argv[2]);
+  yDisableExceptions();
+  if (yRegisterHub(argv[1], errmsg) != YAPI_SUCCESS) {
+    cerr << "RegisterHub error: " << errmsg << endl;
+    return 1;
+  }
+  if (YAPI::SetCallbackWorkers(4, errmsg) != YAPI_SUCCESS) {
+    cerr << "SetCallbackWorkers error: " << errmsg << endl;
+    return 1;
+  }
+  for (sensor = yFirstTemperature(); sensor != NULL; sensor = sensor->nextTemperature()) {
+    received[sensor->get_hardwareId()].clear();
+    sensor->registerValueCallback(valueCallback);
+    nbFunctions++;
+  }
+  recording = true;
+  // the hub sends its notifications after --notify-delay
+  deadline = yGetTickCount() + 60000;
+
+  // route about half of the events to the workers
+  while (routed(pending) < (u32)total / 2 && yGetTickCount() < deadline) {
+    usleep(10000);
+    YAPI::HandleEvents(errmsg);
+  }
+  // let events accumulate and route them at once, then stop the workers
+  usleep(200000);
+  YAPI::HandleEvents(errmsg);
+  expected = routed(pending);
+  YAPI::SetCallbackWorkers(0, errmsg);
+  stopped = delivered;
+  check(pending > 0, "shutdown: events waiting for the workers when stopped");
+  // the events being run when the stats were taken are not counted yet
+  check(stopped >= expected, "shutdown: events routed to the workers all run");
+  usleep(100000);
+  check(delivered == stopped, "shutdown: no callback run once the workers are stopped");
+
+  // the other events are handled within HandleEvents
+  while (delivered < (u32)total && yGetTickCount() < deadline) {
+    YAPI::Sleep(100, errmsg);
+  }
+  check(delivered == (u32)total && YAPI::GetDroppedEventCount() == 0, "all events delivered");
+  for (it = received.begin(); it != received.end(); it++) {
+    vector<int>& values = it->second;
+    for (size_t i = 0; i < values.size(); i++) {
+      if (values[i] != (int)i + 1) {
+        ordered = false;
+      }
+    }
+    if ((int)values.size() != total / nbFunctions) {
+      ordered = false;
+    }
+  }
+  check(ordered, "events of each function in order, with and without workers");
+
+  // stopping workers with events waiting is also done by yFreeAPI
+  YAPI::SetCallbackWorkers(2, errmsg);
+  yFreeAPI();
+  cout << (failures ? "FAILED" : "PASSED") << endl;
+  return failures ? 1 : 0;
+}
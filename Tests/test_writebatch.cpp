@@ -0,0 +1,217 @@
+/*********************************************************************
+ *
+ * Test of the write batches (YFunction::beginBatch / commitBatch)
+ *
+ * The stand-in hub logs the path of each request, and rejects with 401
+ * the requests which contain the text "failme":
+ *   python3 standin_hub.py --log /tmp/requests.log --fail failme \
+ *       -- Binary_Linux/64bits/test_writebatch 127.0.0.1:4444 /tmp/requests.log
+ *
+ *********************************************************************/
+
+#include "yocto_api.h"
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+
+using namespace std;
+
+// Gives access to _setAttr, to batch arbitrary attributes
+class YBatchProbe : public YFunction {
+public:
+  YBatchProbe(const string& func) : YFunction(func) {}
+  int set(const string& attr, const string& value)
+  {
+    return _setAttr(attr, value);
+  }
+};
+
+static int failures = 0;
+
+static void check(bool cond, const string& what)
+{
+  cout << (cond ? "ok       " : "FAILED   ") << what << endl;
+  if (!cond) {
+    failures++;
+  }
+}
+
+// Return the query strings of the write requests logged since line "skip"
+static vector<string> loggedQueries(const string& logfile, size_t skip, size_t& lines)
+{
+  vector<string> queries;
+  ifstream log(logfile.c_str());
+  string line;
+  size_t pos;
+
+  lines = 0;
+  while (getline(log, line)) {
+    if (lines++ < skip) {
+      continue;
+    }
+    pos = line.find('?');
+    if (line.find("/api/temperature1/") == string::npos || pos == string::npos) {
+      continue;
+    }
+    line = line.substr(pos + 1);
+    if (line.length() >= 2 && line.substr(line.length() - 2) == "&.") {
+      line = line.substr(0, line.length() - 2);
+    }
+    queries.push_back(line);
+  }
+  return queries;
+}
+
+static size_t logLength(const string& logfile)
+{
+  size_t lines;
+  loggedQueries(logfile, 0, lines);
+  return lines;
+}
+
+static string join(const vector<string>& items, const string& sep)
+{
+  string res;
+  for (size_t i = 0; i < items.size(); i++) {
+    res += (i ? sep : "") + items[i];
+  }
+  return res;
+}
+
+// Changes to a repeated attribute go to a new request, in order
+static void testRepeatedAttribute(YBatchProbe& probe, const string& logfile)
+{
+  size_t skip = logLength(logfile), lines;
+  vector<yapiAttrWrite> results;
+  vector<string> queries;
+  int res;
+
+  probe.beginBatch();
+  probe.set("luminosity", "10");
+  probe.set("beacon", "1");
+  probe.set("luminosity", "20");
+  probe.set("userVar", "3");
+  res = probe.commitBatch();
+  queries = loggedQueries(logfile, skip, lines);
+  results = probe.get_batchResults();
+  check(res == YAPI_SUCCESS, "repeated attribute: commit succeeds");
+  check(join(queries, " | ") == "luminosity=10&beacon=1 | luminosity=20&userVar=3",
+        "repeated attribute: split in two requests (" + join(queries, " | ") + ")");
+  check(results.size() == 4 && results[3].errorType == YAPI_SUCCESS,
+        "repeated attribute: one result per change");
+}
+
+// Queries never exceed YAPI_BATCH_MAX_QUERY, and each one is filled up
+static void testQueryLength(YBatchProbe& probe, const string& logfile)
+{
+  size_t skip = logLength(logfile), lines, i, sent = 0;
+  vector<string> items, queries;
+  string big(600, 'b');
+  char buff[64];
+  bool sizeOk = true, fullOk = true;
+  int res;
+
+  probe.beginBatch();
+  for (i = 0; i < 40; i++) {
+    snprintf(buff, sizeof(buff), "attr%02d", (int)i);
+    items.push_back(string(buff) + "=" + string(20, 'a' + (char)(i % 26)));
+    probe.set(buff, string(20, 'a' + (char)(i % 26)));
+  }
+  res = probe.commitBatch();
+  queries = loggedQueries(logfile, skip, lines);
+  check(res == YAPI_SUCCESS, "query length: commit succeeds");
+  check(queries.size() > 1, "query length: 40 changes of 27 bytes need several requests");
+  for (i = 0; i < queries.size(); i++) {
+    if (queries[i].length() > YAPI_BATCH_MAX_QUERY) {
+      sizeOk = false;
+    }
+    // the next change would not have fit in this request
+    sent += (size_t)count(queries[i].begin(), queries[i].end(), '&') + 1;
+    if (sent < items.size() && queries[i].length() + 1 + items[sent].length() <= YAPI_BATCH_MAX_QUERY) {
+      fullOk = false;
+    }
+  }
+  check(sizeOk, "query length: no query longer than YAPI_BATCH_MAX_QUERY");
+  check(fullOk, "query length: requests are filled up before splitting");
+  check(join(queries, "&") == join(items, "&"), "query length: all changes sent once, in order");
+
+  // a change longer than the limit is sent alone
+  skip = lines;
+  probe.beginBatch();
+  probe.set("before", "1");
+  probe.set("big", big);
+  probe.set("after", "2");
+  res = probe.commitBatch();
+  queries = loggedQueries(logfile, skip, lines);
+  check(res == YAPI_SUCCESS && queries.size() == 3 && queries[1] == "big=" + big,
+        "query length: oversized change sent in its own request");
+}
+
+// A failed request only marks the changes it carried
+static void testErrors(YBatchProbe& probe, const string& logfile)
+{
+  size_t skip = logLength(logfile), lines;
+  vector<yapiAttrWrite> results;
+  vector<string> queries;
+  int res;
+
+  probe.beginBatch();
+  probe.set("luminosity", "10");
+  probe.set("logicalName", "failme");
+  probe.set("luminosity", "20");
+  probe.set("userVar", "3");
+  res = probe.commitBatch();
+  queries = loggedQueries(logfile, skip, lines);
+  results = probe.get_batchResults();
+  check(res == YAPI_UNAUTHORIZED, "errors: commit returns the first error");
+  check(!queries.empty() && queries.back() == "luminosity=20&userVar=3",
+        "errors: the request after the failed one is still sent");
+  check(results.size() == 4 &&
+        results[0].errorType == YAPI_UNAUTHORIZED && results[0].errorMessage != "" &&
+        results[1].errorType == YAPI_UNAUTHORIZED && results[1].errorMessage != "" &&
+        results[2].errorType == YAPI_SUCCESS && results[2].errorMessage == "" &&
+        results[3].errorType == YAPI_SUCCESS && results[3].errorMessage == "",
+        "errors: reported per request");
+}
+
+// A cancelled batch sends nothing
+static void testCancel(YBatchProbe& probe, const string& logfile)
+{
+  size_t skip = logLength(logfile), lines;
+
+  probe.beginBatch();
+  probe.set("luminosity", "10");
+  probe.cancelBatch();
+  check(loggedQueries(logfile, skip, lines).empty(), "cancel: nothing sent");
+}
+
+int main(int argc, const char * argv[])
+{
+  string errmsg;
+
+  if (argc < 3) {
+    cerr << "usage: test_writebatch <hub_url> <request_log>" << endl;
+    return 1;
+  }
+  yDisableExceptions();
+  if (yRegisterHub(argv[1], errmsg) != YAPI_SUCCESS) {
+    cerr << "RegisterHub error: " << errmsg << endl;
+    return 1;
+  }
+  {
+    YBatchProbe probe("TMPSENS1-00000.temperature1");
+    if (!probe.isOnline()) {
+      cerr << "TMPSENS1-00000.temperature1 not found" << endl;
+      return 1;
+    }
+    testRepeatedAttribute(probe, argv[2]);
+    testQueryLength(probe, argv[2]);
+    testErrors(probe, argv[2]);
+    testCancel(probe, argv[2]);
+  }
+  yFreeAPI();
+  cout << (failures ? "FAILED" : "PASSED") << endl;
+  return failures ? 1 : 0;
+}